@@ -0,0 +1,55 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#pragma once
+
+/*
+	The individual micro-benchmarks. Each runs with the given iteration count, prints its results
+	and returns false if a sanity check of its results failed (not if it was slow).
+*/
+
+bool RunStereoProjectionBenchmark(unsigned int iterations);
+bool RunEyeMatrixBenchmark(unsigned int iterations);
+bool RunConstantRingBenchmark(unsigned int iterations);
+bool RunSceneBenchmark(unsigned int iterations);
+bool RunThreadScalingBenchmark(unsigned int iterations);
+bool RunLateLatchBenchmark(unsigned int iterations);
+bool RunResolutionBenchmark(unsigned int iterations);
+bool RunFoveationBenchmark(unsigned int iterations);
+bool RunSoftwareRasterBenchmark(unsigned int iterations);
+bool RunShaderCacheBenchmark(unsigned int iterations);
+bool RunStreamingBenchmark(unsigned int iterations);
+bool RunRenderTargetBenchmark(unsigned int iterations);
+bool RunFrameGraphBenchmark(unsigned int iterations);
+bool RunDrawPacketBenchmark(unsigned int iterations);
+bool RunGpuDrivenBenchmark(unsigned int iterations);
+bool RunPosePredictionBenchmark(unsigned int iterations);
+bool RunFramePacingBenchmark(unsigned int iterations);
+bool RunDistortionBenchmark(unsigned int iterations);
+bool RunFusedResolveBenchmark(unsigned int iterations);
+bool RunHiddenAreaBenchmark(unsigned int iterations);
+bool RunCommandCaptureBenchmark(unsigned int iterations);
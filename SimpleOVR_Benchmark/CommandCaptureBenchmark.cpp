@@ -0,0 +1,219 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#include "Benchmarks.h"
+#include "Clock.h"
+#include "CommandCapture.h"
+#include "FrameLoop.h"
+#include "JobSystem.h"
+#include "NullRenderDevice.h"
+#include "Scene.h"
+#include "SimulatedHmd.h"
+#include "SoftwareRenderDevice.h"
+#include "VrMath.h"
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+/*
+	Command captures (CommandCapture.h). The frame loop draws a scattered scene with late latching
+	on recording contexts, on the null device, with and without capturing it; the capture is
+	then replayed on a null device of its own. Every statistic of the replaying device has to be
+	what the captured one counted. Timed are the frames without the capture, with it, and replayed.
+
+	On the software device, with own distortion, timewarp and the hidden area mask, the replayed
+	display has to be exactly the one the frame loop drew. A capture cut off in the middle of its
+	last frame has to replay the frames before it.
+*/
+
+namespace {
+	const char* CapturePath = "SimpleOVR_CommandCaptureBenchmark.bin";
+	const char* TruncatedCapturePath = "SimpleOVR_CommandCaptureBenchmark_truncated.bin";
+	const int MultisampleCount = 4;
+	const int ThreadCount = 4;
+	const unsigned int CapturedFrames = 200;
+	const unsigned int SoftwareFrames = 4;
+	const unsigned int SceneObjectCount = 500;
+
+	float NextRandom(unsigned int& state) {
+		state = state * 1664525u + 1013904223u;
+		return (state >> 8) * (1.0f / 16777216.0f);
+	}
+
+	// Renders the frames of the default pose script on device, through a capture if there is
+	// one. Returns the seconds per frame.
+	double RenderFrames(unsigned int frameCount, StereoSetup& setup, RenderDevice& device, CommandCaptureDevice* capture, const Scene& scene) {
+		PoseScript script;
+		SimulatedHmd hmd(script);
+		JobSystem jobs(ThreadCount);
+		RenderDevice& frameDevice = capture != nullptr ? static_cast<RenderDevice&>(*capture) : device;
+		setup.CommandCapture = capture;
+		frameDevice.SetSceneVertices(&scene.GetVertices()[0], static_cast<unsigned int>(scene.GetVertices().size()));
+		auto start = ReadClock();
+		for (unsigned int frame = 0; frame < frameCount; frame++) {
+			RenderFrame(hmd, frameDevice, setup, scene, jobs);
+		}
+		return ClockTicksToSeconds(ReadClock() - start) / frameCount;
+	}
+
+	// Replays every frame of the capture at path on device. Returns the seconds per frame, or a
+	// negative number if it didn't replay.
+	double ReplayFrames(const char* path, RenderDevice& device, unsigned int& outFrameCount) {
+		CommandCapture capture;
+		outFrameCount = 0;
+		if (!capture.Load(path)) {
+			return -1.0;
+		}
+		auto start = ReadClock();
+		for (unsigned int frame = 0; frame < capture.GetFrameCount(); frame++) {
+			if (!capture.ReplayFrame(frame, device)) {
+				return -1.0;
+			}
+		}
+		double seconds = ClockTicksToSeconds(ReadClock() - start);
+		outFrameCount = capture.GetFrameCount();
+		return outFrameCount > 0 ? seconds / outFrameCount : 0.0;
+	}
+
+	// Copies path without the last bytes of it.
+	bool WriteTruncated(const char* path, const char* truncatedPath, size_t cutBytes) {
+		FILE* in = std::fopen(path, "rb");
+		if (in == nullptr) {
+			return false;
+		}
+		std::vector<unsigned char> data;
+		unsigned char buffer[65536];
+		size_t read;
+		while ((read = std::fread(buffer, 1, sizeof(buffer), in)) > 0) {
+			data.insert(data.end(), buffer, buffer + read);
+		}
+		std::fclose(in);
+		FILE* out = std::fopen(truncatedPath, "wb");
+		if (out == nullptr || data.size() < cutBytes) {
+			if (out != nullptr) {
+				std::fclose(out);
+			}
+			return false;
+		}
+		bool written = std::fwrite(&data[0], 1, data.size() - cutBytes, out) == data.size() - cutBytes;
+		return std::fclose(out) == 0 && written;
+	}
+}
+
+bool RunCommandCaptureBenchmark(unsigned int iterations) {
+	bool passed = true;
+
+	Scene scene;
+	AddDefaultSceneContent(scene);
+	unsigned int state = 4321;
+	const Vector3 up = { 0.0f, 1.0f, 0.0f };
+	for (unsigned int i = 0; i < SceneObjectCount; i++) {
+		Vector3 position = { (NextRandom(state) * 2.0f - 1.0f) * 30.0f, (NextRandom(state) * 2.0f - 1.0f) * 10.0f, (NextRandom(state) * 2.0f - 1.0f) * 30.0f };
+		unsigned int object = scene.AddObject(0, position, QuaternionFromAxisAngle(up, NextRandom(state) * 6.2831853f), 0.5f + NextRandom(state));
+		scene.SetObjectMaterial(object, static_cast<int>(NextRandom(state) * 4.0f) % 4);
+	}
+
+	// The null device: the same frames with and without the capture, and replayed.
+	{
+		PoseScript script;
+		SimulatedHmd hmd(script);
+		StereoSetup setup = CreateStereoSetup(hmd, 1.0f);
+		setup.LateLatch = true;
+		NullRenderDevice plainDevice(setup.RenderTargetSize, MultisampleCount);
+		double plainSeconds = RenderFrames(CapturedFrames, setup, plainDevice, nullptr, scene);
+
+		setup = CreateStereoSetup(hmd, 1.0f);
+		setup.LateLatch = true;
+		NullRenderDevice capturedDevice(setup.RenderTargetSize, MultisampleCount);
+		CommandCaptureDevice capture(capturedDevice);
+		if (!capture.Open(CapturePath)) {
+			std::printf("  FAILED: can't create %s\n", CapturePath);
+			return false;
+		}
+		double capturingSeconds = RenderFrames(CapturedFrames, setup, capturedDevice, &capture, scene);
+		bool written = capture.Close();
+
+		NullRenderDevice replayDevice(setup.RenderTargetSize, MultisampleCount);
+		unsigned int replayedFrames = 0;
+		double replaySeconds = written ? ReplayFrames(CapturePath, replayDevice, replayedFrames) : -1.0;
+		const NullRenderDevice::Statistics& captured = capturedDevice.GetStatistics();
+		const NullRenderDevice::Statistics& replayed = replayDevice.GetStatistics();
+		std::printf("Null device: %u frames, %llu KB captured (%.1f KB per frame), %llu draws, %llu recorded commands\n", capture.GetFrameCount(),
+			capture.GetCapturedBytes() / 1024, capture.GetCapturedBytes() / 1024.0 / CapturedFrames, captured.Draws, captured.RecordedCommands);
+		std::printf("Per frame: %.2f us frame loop, %.2f us capturing, %.2f us replayed\n", plainSeconds * 1e6, capturingSeconds * 1e6, replaySeconds * 1e6);
+		if (replaySeconds < 0.0 || replayedFrames != CapturedFrames) {
+			std::printf("  FAILED: the capture doesn't replay, %u of %u frames\n", replayedFrames, CapturedFrames);
+			passed = false;
+		}
+		else if (std::memcmp(&captured, &replayed, sizeof(captured)) != 0 || std::memcmp(&captured, &plainDevice.GetStatistics(), sizeof(captured)) != 0) {
+			std::printf("  FAILED: the replayed commands aren't the captured ones\n");
+			passed = false;
+		}
+
+		// Cut off in the middle of the last frame's EndFrame.
+		unsigned int truncatedFrames = 0;
+		bool truncated = WriteTruncated(CapturePath, TruncatedCapturePath, 4);
+		NullRenderDevice truncatedDevice(setup.RenderTargetSize, MultisampleCount);
+		if (!truncated || ReplayFrames(TruncatedCapturePath, truncatedDevice, truncatedFrames) < 0.0 || truncatedFrames != CapturedFrames - 1) {
+			std::printf("  FAILED: a truncated capture replays %u frames, not %u\n", truncatedFrames, CapturedFrames - 1);
+			passed = false;
+		}
+		std::remove(CapturePath);
+		std::remove(TruncatedCapturePath);
+	}
+
+	// The software device: the replayed display is the one drawn.
+	{
+		PoseScript script;
+		SimulatedHmd hmd(script);
+		StereoSetup setup = CreateStereoSetup(hmd, 1.0f);
+		setup.LateLatch = true;
+		setup.OwnDistortion = true;
+		setup.Timewarp = true;
+		setup.HiddenAreaMask = true;
+		JobSystem jobs(JobSystem::GetHardwareThreadCount());
+		SoftwareRenderDevice drawnDevice(hmd.GetResolution(), setup.RenderTargetSize, MultisampleCount, jobs);
+		CommandCaptureDevice capture(drawnDevice);
+		bool written = capture.Open(CapturePath);
+		double drawnSeconds = written ? RenderFrames(SoftwareFrames, setup, drawnDevice, &capture, scene) : 0.0;
+		written = capture.Close() && written;
+
+		SoftwareRenderDevice replayDevice(hmd.GetResolution(), setup.RenderTargetSize, MultisampleCount, jobs);
+		unsigned int replayedFrames = 0;
+		double replaySeconds = written ? ReplayFrames(CapturePath, replayDevice, replayedFrames) : -1.0;
+		std::remove(CapturePath);
+		const Image& drawn = drawnDevice.GetDisplayImage();
+		ImageDifference difference = CompareImages(drawn, replayDevice.GetDisplayImage(), 0);
+		std::printf("Software device: %u frames, %.2f ms drawn, %.2f ms replayed per frame, %llu of %u display pixels differ\n", replayedFrames,
+			drawnSeconds * 1e3, replaySeconds * 1e3, difference.DifferentPixels, static_cast<unsigned int>(drawn.Pixels.size()));
+		if (replaySeconds < 0.0 || replayedFrames != SoftwareFrames || difference.DifferentPixels != 0 || drawnDevice.GetStatistics().DistortedPresents != SoftwareFrames) {
+			std::printf("  FAILED: the replayed display isn't the one drawn\n");
+			passed = false;
+		}
+	}
+	return passed;
+}
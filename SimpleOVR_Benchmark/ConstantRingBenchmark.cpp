@@ -0,0 +1,169 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#include "Benchmarks.h"
+#include "Clock.h"
+#include "ConstantRingAllocator.h"
+#include <cstdio>
+#include <deque>
+#include <vector>
+
+/*
+	ConstantRingAllocator, first driven by a pretend GPU that finishes frames after a varying
+	number of frames while a shadow copy of everything still in use checks that no allocation ever
+	overlaps memory a frame in flight owns. Then the cost of an allocation in a steady state.
+*/
+
+namespace {
+	// Deterministic, so every run checks the same sequence.
+	class Random {
+	public:
+		Random() : state(54321) {}
+
+		unsigned int Next(unsigned int count) {
+			state = state * 1664525u + 1013904223u;
+			return (state >> 8) % count;
+		}
+
+	private:
+		unsigned int state;
+	};
+
+	struct LiveAllocation {
+		unsigned long long Frame;
+		unsigned int Offset;
+		unsigned int Size;
+	};
+
+	bool Overlaps(const LiveAllocation& a, unsigned int offset, unsigned int size) {
+		return offset < a.Offset + a.Size && a.Offset < offset + size;
+	}
+
+	bool CheckAllocator() {
+		const unsigned int capacity = 64 * 1024;
+		ConstantRingAllocator allocator(capacity);
+		std::deque<LiveAllocation> live;
+		std::deque<unsigned long long> submitted;
+		Random random;
+		int errors = 0;
+
+		for (unsigned long long frame = 1; frame <= 20000; frame++) {
+			allocator.BeginFrame(frame);
+			unsigned int count = random.Next(20);
+			for (unsigned int i = 0; i < count; i++) {
+				unsigned int size = 1 + random.Next(4096);
+				unsigned int offset;
+				while (!allocator.Allocate(size, offset)) {
+					// Full, wait for the GPU. There has to be something to wait for.
+					if (allocator.GetFramesInFlight() == 0 || submitted.empty()) {
+						std::printf("  frame %llu: allocation of %u bytes failed with nothing in flight\n", frame, size);
+						return false;
+					}
+					unsigned long long oldest = submitted.front();
+					submitted.pop_front();
+					allocator.RetireFrames(oldest);
+					while (!live.empty() && live.front().Frame <= oldest) {
+						live.pop_front();
+					}
+				}
+
+				unsigned int alignedSize = ConstantRingAllocator::Align(size);
+				if (offset % ConstantRingAllocator::ConstantAlignment != 0 || offset + alignedSize > allocator.GetCapacity()) {
+					std::printf("  frame %llu: bad allocation at %u (%u bytes)\n", frame, offset, size);
+					errors++;
+				}
+				for (size_t j = 0; j < live.size(); j++) {
+					if (Overlaps(live[j], offset, alignedSize)) {
+						std::printf("  frame %llu: allocation at %u overlaps one of frame %llu at %u\n", frame, offset, live[j].Frame, live[j].Offset);
+						errors++;
+					}
+				}
+				LiveAllocation allocation = { frame, offset, alignedSize };
+				live.push_back(allocation);
+			}
+			allocator.EndFrame();
+			submitted.push_back(frame);
+
+			// The GPU runs zero to three frames behind.
+			unsigned int latency = random.Next(4);
+			while (submitted.size() > latency) {
+				unsigned long long completed = submitted.front();
+				submitted.pop_front();
+				allocator.RetireFrames(completed);
+				while (!live.empty() && live.front().Frame <= completed) {
+					live.pop_front();
+				}
+			}
+			if (errors > 10) {
+				return false;
+			}
+		}
+
+		// Once the GPU is idle everything must be free again.
+		allocator.RetireFrames(~0ull);
+		unsigned int offset;
+		allocator.BeginFrame(20001);
+		if (allocator.GetUsedBytes() != 0 || !allocator.Allocate(capacity, offset)) {
+			std::printf("  ring not empty after retiring every frame\n");
+			errors++;
+		}
+
+		const ConstantRingAllocator::Statistics& statistics = allocator.GetStatistics();
+		std::printf("Checked %llu allocations: %llu wraps, %llu bytes skipped, %llu waits for the GPU\n",
+			statistics.Allocations, statistics.Wraps, statistics.WastedBytes, statistics.Failures);
+		return errors == 0 && statistics.Wraps > 0 && statistics.Failures > 0;
+	}
+}
+
+bool RunConstantRingBenchmark(unsigned int iterations) {
+	bool passed = CheckAllocator();
+
+	// Steady state: 100 draws worth of 64 byte constants per frame, GPU two frames behind.
+	const unsigned int drawsPerFrame = 100;
+	ConstantRingAllocator allocator(ConstantRingAllocator::DefaultCapacity);
+	unsigned long long frameCount = iterations / drawsPerFrame + 1;
+	unsigned long long checksum = 0;
+	auto start = ReadClock();
+	for (unsigned long long frame = 1; frame <= frameCount; frame++) {
+		if (frame > 2) {
+			allocator.RetireFrames(frame - 3);
+		}
+		allocator.BeginFrame(frame);
+		for (unsigned int draw = 0; draw < drawsPerFrame; draw++) {
+			unsigned int offset = 0;
+			allocator.Allocate(64, offset);
+			checksum += offset;
+		}
+		allocator.EndFrame();
+	}
+	double elapsed = ClockTicksToSeconds(ReadClock() - start);
+	std::printf("Allocation: %.1f ns (%u per frame, GPU 2 frames behind, %llu waits)\n",
+		elapsed * 1e9 / (frameCount * drawsPerFrame), drawsPerFrame, allocator.GetStatistics().Failures);
+	std::printf("Checksum: %llu\n", checksum);
+
+	return passed;
+}
@@ -0,0 +1,358 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#include "Benchmarks.h"
+#include "Clock.h"
+#include "Distortion.h"
+#include "FrameLoop.h"
+#include "JobSystem.h"
+#include "NullRenderDevice.h"
+#include "SimulatedHmd.h"
+#include "VrMath.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+/*
+	Own distortion and timewarp. The simulated HMD's meshes have to survive packing into
+	DistortionVertex, and timewarp has to turn a direction exactly as far as the head turned:
+	yawing by a, a point at tangent tan(b) has to be looked up at tan(b - a). DrawDistortionMeshes
+	then distorts an eye texture with smooth content; the pixel at the lens center has to show the
+	eye's center, the display's corners have to be black, and away from the vignette the image
+	has to match distorting every pixel exactly, which the mesh only approximates between its
+	vertices. The frame loop has to hand the meshes to the device once and present every frame,
+	and the device has to refuse meshes whose indices aren't whole triangles of their vertices.
+
+	Timed are making the meshes, the constants of a frame, and distorting a frame with the mesh
+	against the exact per-pixel version, apart from drawing the scene.
+*/
+
+namespace {
+	const float PackTolerance = 1e-4f;
+	const float TimewarpTolerance = 1e-5f;
+	const int CenterTolerance = 2;
+	const int ReferenceTolerance = 3; // Per channel, the mesh interpolates the lens between vertices
+	const double MaxReferenceMismatch = 0.005; // Of the pixels away from the vignette
+
+	// The vignette changes faster than a mesh cell, so the mesh only matches the reference away
+	// from it: this far inside the FOV and the lens, in tangents, and inside the eye's half of the
+	// display, in NDC.
+	const float FovMargin = 0.25f;
+	const float ScreenMargin = 0.05f;
+
+	int ChannelDifference(unsigned int a, unsigned int b) {
+		int difference = 0;
+		for (int channel = 0; channel < 3; channel++) {
+			int ca = (a >> (channel * 8)) & 0xff;
+			int cb = (b >> (channel * 8)) & 0xff;
+			difference = std::max(difference, std::abs(ca - cb));
+		}
+		return difference;
+	}
+
+	// Gradients with no edges, so linear interpolation and bilinear filtering barely matter.
+	Image MakeEyeTexture(Size2i size) {
+		Image image;
+		image.Size = size;
+		image.Pixels.resize(size.w * size.h);
+		for (int y = 0; y < size.h; y++) {
+			for (int x = 0; x < size.w; x++) {
+				unsigned int red = static_cast<unsigned int>(255.0f * x / size.w);
+				unsigned int green = static_cast<unsigned int>(255.0f * y / size.h);
+				unsigned int blue = static_cast<unsigned int>(127.5f + 127.0f * std::sin(x * 0.01f) * std::cos(y * 0.013f));
+				image.Pixels[y * size.w + x] = 0xff000000u | (blue << 16) | (green << 8) | red;
+			}
+		}
+		return image;
+	}
+
+	bool IsAwayFromVignette(const DistortionPoint& point, const LensDistortion& lens, int eye, const FovPort& fov) {
+		float edge2 = lens.MaxRadius * lens.MaxRadius;
+		float lensTan = lens.MaxRadius * (lens.K[0] + edge2 * (lens.K[1] + edge2 * lens.K[2]));
+		float halfLeft = eye == 0 ? -1.0f : 0.0f;
+		float ndcX = point.ScreenPosNdc[0];
+		float ndcY = point.ScreenPosNdc[1];
+		float tanX = point.TanEyeAngles[1][0];
+		float tanY = point.TanEyeAngles[1][1];
+		return ndcX - halfLeft > ScreenMargin && halfLeft + 1.0f - ndcX > ScreenMargin && 1.0f - std::fabs(ndcY) > ScreenMargin &&
+			tanX > FovMargin - fov.LeftTan && tanX < fov.RightTan - FovMargin && tanY > FovMargin - fov.DownTan && tanY < fov.UpTan - FovMargin &&
+			std::sqrt(tanX * tanX + tanY * tanY) < lensTan - FovMargin;
+	}
+
+	// The exact version: every pixel's point worked out from the lens and warped by itself.
+	void DistortReference(const LensDistortion& lens, const FovPort fov[EyeCount], const DistortionSource& eyeTexture, const DistortionConstants constants[EyeCount], Image& display) {
+		for (int y = 0; y < display.Size.h; y++) {
+			float ndcY = 1.0f - 2.0f * (y + 0.5f) / display.Size.h;
+			for (int x = 0; x < display.Size.w; x++) {
+				float ndcX = 2.0f * (x + 0.5f) / display.Size.w - 1.0f;
+				int eye = ndcX < 0.0f ? 0 : 1;
+				DistortionPoint point = ComputeDistortionPoint(lens, eye, fov[eye], ndcX, ndcY);
+				float uv[3][2];
+				WarpDistortionPoint(point, constants[eye], uv);
+				display.Pixels[y * display.Size.w + x] = SampleDistortedColor(eyeTexture, uv, point.Vignette);
+			}
+		}
+	}
+
+	bool CheckPacking(const std::vector<DistortionPoint>& points, float& outMaxError) {
+		outMaxError = 0.0f;
+		for (size_t i = 0; i < points.size(); i++) {
+			const DistortionPoint& point = points[i];
+			DistortionPoint unpacked = UnpackDistortionVertex(PackDistortionVertex(point));
+			float error = std::max(std::fabs(unpacked.ScreenPosNdc[0] - point.ScreenPosNdc[0]), std::fabs(unpacked.ScreenPosNdc[1] - point.ScreenPosNdc[1]));
+			for (int color = 0; color < 3; color++) {
+				error = std::max(error, std::fabs(unpacked.TanEyeAngles[color][0] - point.TanEyeAngles[color][0]));
+				error = std::max(error, std::fabs(unpacked.TanEyeAngles[color][1] - point.TanEyeAngles[color][1]));
+			}
+			outMaxError = std::max(outMaxError, error);
+			if (std::fabs(unpacked.TimewarpFactor - point.TimewarpFactor) > 0.5f / 255.0f + 1e-6f || std::fabs(unpacked.Vignette - point.Vignette) > 0.5f / 255.0f + 1e-6f) {
+				return false;
+			}
+		}
+		return outMaxError <= PackTolerance;
+	}
+
+	// Yaws the head between drawing and scanout and checks where tangents are looked up.
+	bool CheckTimewarp(float& outMaxError) {
+		const FovPort fov = { 1.0f, 1.0f, 1.0f, 1.0f };
+		const Size2i textureSize = { 1000, 1000 };
+		const Rect2i viewport = { { 0, 0 }, textureSize };
+		const Vector3 up = { 0.0f, 1.0f, 0.0f };
+		const float yaws[] = { -0.1f, -0.02f, 0.0f, 0.01f, 0.05f, 0.2f };
+		const float tangents[] = { -0.9f, -0.4f, 0.0f, 0.3f, 0.8f };
+		outMaxError = 0.0f;
+		for (size_t y = 0; y < sizeof(yaws) / sizeof(yaws[0]); y++) {
+			Quaternion render = QuaternionFromAxisAngle(up, 0.7f);
+			Quaternion late = QuaternionFromAxisAngle(up, 0.7f + yaws[y]);
+			DistortionConstants constants = ComputeDistortionConstants(fov, textureSize, viewport, render, render, late);
+			for (size_t t = 0; t < sizeof(tangents) / sizeof(tangents[0]); t++) {
+				for (int factor = 0; factor <= 1; factor++) {
+					DistortionPoint point = {};
+					point.TimewarpFactor = static_cast<float>(factor);
+					for (int color = 0; color < 3; color++) {
+						point.TanEyeAngles[color][0] = tangents[t];
+						point.TanEyeAngles[color][1] = 0.5f * tangents[t];
+					}
+					float uv[3][2];
+					WarpDistortionPoint(point, constants, uv);
+
+					// Back from texture coordinates to the tangent looked up.
+					float tanX = (uv[1][0] - constants.UvScaleOffset[2]) / constants.UvScaleOffset[0];
+					float tanY = (uv[1][1] - constants.UvScaleOffset[3]) / constants.UvScaleOffset[1];
+					double angle = std::atan(static_cast<double>(tangents[t])) - (factor == 1 ? yaws[y] : 0.0);
+					double expectedX = std::tan(angle);
+					double expectedY = 0.5 * tangents[t] / (std::cos(yaws[y] * factor) + tangents[t] * std::sin(yaws[y] * factor));
+					outMaxError = std::max(outMaxError, static_cast<float>(std::fabs(tanX - expectedX)));
+					outMaxError = std::max(outMaxError, static_cast<float>(std::fabs(tanY - expectedY)));
+				}
+			}
+		}
+		return outMaxError <= TimewarpTolerance;
+	}
+}
+
+bool RunDistortionBenchmark(unsigned int iterations) {
+	bool passed = true;
+	PoseScript script;
+	SimulatedHmd hmd(script);
+	StereoSetup setup = CreateStereoSetup(hmd, 1.0f);
+	const LensDistortion& lens = SimulatedHmd::LensModel;
+	FovPort fov[EyeCount] = { setup.EyeFov[0], setup.EyeFov[1] };
+
+	DistortionMesh meshes[EyeCount];
+	float packError = 0.0f;
+	for (int eye = 0; eye < EyeCount; eye++) {
+		std::vector<DistortionPoint> points;
+		std::vector<unsigned short> indices;
+		hmd.GetDistortionMesh(eye, fov[eye], points, indices);
+		float eyeError;
+		if (!CheckPacking(points, eyeError)) {
+			passed = false;
+		}
+		packError = std::max(packError, eyeError);
+		PackDistortionMesh(points, indices, meshes[eye]);
+	}
+	size_t vertexCount = meshes[0].Vertices.size();
+	std::printf("Mesh: %u vertices and %u triangles per eye, %u bytes per vertex instead of %u, max packing error %.6f\n",
+		static_cast<unsigned int>(vertexCount), static_cast<unsigned int>(meshes[0].Indices.size() / 3),
+		static_cast<unsigned int>(sizeof(DistortionVertex)), static_cast<unsigned int>(sizeof(DistortionPoint)), packError);
+	if (packError > PackTolerance) {
+		std::printf("  FAILED: packed vertices are off\n");
+	}
+
+	// The device takes the meshes, but nothing with an index past the vertices or half a triangle.
+	NullRenderDevice checkDevice(setup.RenderTargetSize, 1);
+	DistortionMesh pastVertices = meshes[0];
+	pastVertices.Indices[pastVertices.Indices.size() / 2] = static_cast<unsigned short>(pastVertices.Vertices.size());
+	DistortionMesh partialTriangle = meshes[0];
+	partialTriangle.Indices.pop_back();
+	if (!checkDevice.SetDistortionMesh(0, meshes[0]) || !checkDevice.SetDistortionMesh(1, meshes[1]) ||
+		checkDevice.SetDistortionMesh(0, pastVertices) || checkDevice.SetDistortionMesh(0, partialTriangle)) {
+		std::printf("  FAILED: the device doesn't tell valid meshes from broken ones\n");
+		passed = false;
+	}
+
+	float timewarpError;
+	bool timewarpPassed = CheckTimewarp(timewarpError);
+	std::printf("Timewarp: max tangent error %.7f against the analytic yaw\n", timewarpError);
+	if (!timewarpPassed) {
+		std::printf("  FAILED: timewarp turns by the wrong angle\n");
+		passed = false;
+	}
+
+	// A frame distorted without timewarp, by the mesh and by the reference.
+	Image eyeImage = MakeEyeTexture(setup.RenderTargetSize);
+	DistortionSource eyeTexture = GetDistortionSource(eyeImage);
+	DistortionConstants constants[EyeCount];
+	for (int eye = 0; eye < EyeCount; eye++) {
+		constants[eye] = ComputeDistortionConstants(fov[eye], setup.RenderTargetSize, setup.EyeRenderViewport[eye], QuaternionIdentity(), QuaternionIdentity(), QuaternionIdentity());
+	}
+	Image display;
+	display.Size = lens.Resolution;
+	display.Pixels.resize(display.Size.w * display.Size.h);
+	Image reference = display;
+	JobSystem jobs(JobSystem::GetHardwareThreadCount());
+	const DistortionMesh* meshPointers[EyeCount] = { &meshes[0], &meshes[1] };
+	DrawDistortionMeshes(eyeTexture, meshPointers, constants, display, jobs);
+	DistortReference(lens, fov, eyeTexture, constants, reference);
+
+	int centerDifference = 0;
+	for (int eye = 0; eye < EyeCount; eye++) {
+		// The pixel closest to the lens center looks at the eye's center.
+		float lensNdcX = (eye == 0 ? -1.0f : 1.0f) * lens.LensSeparationInMeters / lens.ScreenSizeInMeters[0];
+		int x = static_cast<int>((lensNdcX + 1.0f) * 0.5f * display.Size.w);
+		int y = display.Size.h / 2;
+		DistortionPoint point = ComputeDistortionPoint(lens, eye, fov[eye], 2.0f * (x + 0.5f) / display.Size.w - 1.0f, 1.0f - 2.0f * (y + 0.5f) / display.Size.h);
+		float uv[3][2];
+		for (int color = 0; color < 3; color++) {
+			uv[color][0] = point.TanEyeAngles[color][0] * constants[eye].UvScaleOffset[0] + constants[eye].UvScaleOffset[2];
+			uv[color][1] = point.TanEyeAngles[color][1] * constants[eye].UvScaleOffset[1] + constants[eye].UvScaleOffset[3];
+		}
+		centerDifference = std::max(centerDifference, ChannelDifference(display.Pixels[y * display.Size.w + x], SampleDistortedColor(eyeTexture, uv, 1.0f)));
+	}
+	unsigned int corners[4] = {
+		display.Pixels[0], display.Pixels[display.Size.w - 1],
+		display.Pixels[(display.Size.h - 1) * display.Size.w], display.Pixels[display.Size.h * display.Size.w - 1]
+	};
+	bool cornersBlack = true;
+	for (int i = 0; i < 4; i++) {
+		cornersBlack = cornersBlack && (corners[i] & 0xffffff) == 0;
+	}
+	unsigned long long inside = 0;
+	unsigned long long mismatched = 0;
+	int maxDifference = 0;
+	int maxEdgeDifference = 0;
+	for (int y = 0; y < display.Size.h; y++) {
+		for (int x = 0; x < display.Size.w; x++) {
+			int eye = x < display.Size.w / 2 ? 0 : 1;
+			DistortionPoint point = ComputeDistortionPoint(lens, eye, fov[eye], 2.0f * (x + 0.5f) / display.Size.w - 1.0f, 1.0f - 2.0f * (y + 0.5f) / display.Size.h);
+			int difference = ChannelDifference(display.Pixels[y * display.Size.w + x], reference.Pixels[y * display.Size.w + x]);
+			if (!IsAwayFromVignette(point, lens, eye, fov[eye])) {
+				maxEdgeDifference = std::max(maxEdgeDifference, difference);
+				continue;
+			}
+			inside++;
+			maxDifference = std::max(maxDifference, difference);
+			if (difference > ReferenceTolerance) {
+				mismatched++;
+			}
+		}
+	}
+	double mismatchRatio = inside > 0 ? static_cast<double>(mismatched) / inside : 1.0;
+	std::printf("Display %dx%d: lens centers off by %d, corners %s\n", display.Size.w, display.Size.h, centerDifference, cornersBlack ? "black" : "not black");
+	std::printf("Against the reference: %.3f%% of %.0f%% of pixels off by more than %d (up to %d), up to %d in the vignette\n",
+		100.0 * mismatchRatio, 100.0 * inside / display.Pixels.size(), ReferenceTolerance, maxDifference, maxEdgeDifference);
+	if (centerDifference > CenterTolerance || !cornersBlack || mismatchRatio > MaxReferenceMismatch) {
+		std::printf("  FAILED: the distorted image is wrong\n");
+		passed = false;
+	}
+
+	// The frame loop hands the meshes over once and presents every frame.
+	{
+		NullRenderDevice device(setup.RenderTargetSize, 1);
+		StereoSetup loopSetup = CreateStereoSetup(hmd, 1.0f);
+		loopSetup.OwnDistortion = true;
+		loopSetup.Timewarp = true;
+		Scene scene;
+		AddDefaultSceneContent(scene);
+		device.SetSceneVertices(&scene.GetVertices()[0], static_cast<unsigned int>(scene.GetVertices().size()));
+		const unsigned int frames = 30;
+		for (unsigned int frame = 0; frame < frames; frame++) {
+			RenderFrame(hmd, device, loopSetup, scene, jobs);
+		}
+		bool loopPassed = loopSetup.DistortionAccepted && device.GetStatistics().DistortedPresents == frames &&
+			device.GetDistortionMesh(1).Vertices.size() == vertexCount;
+		std::printf("Frame loop: %llu of %u frames presented distorted\n", device.GetStatistics().DistortedPresents, frames);
+		if (!loopPassed) {
+			std::printf("  FAILED: the frame loop didn't distort every frame\n");
+			passed = false;
+		}
+	}
+
+	// Timings.
+	unsigned int meshRuns = iterations / 100000 + 1;
+	std::vector<DistortionPoint> points;
+	std::vector<unsigned short> indices;
+	unsigned long long checksum = 0;
+	auto start = ReadClock();
+	for (unsigned int i = 0; i < meshRuns; i++) {
+		GenerateDistortionMesh(lens, i & 1, fov[i & 1], DistortionMeshColumns, DistortionMeshRows, points, indices);
+		checksum += points.size();
+	}
+	double meshSeconds = ClockTicksToSeconds(ReadClock() - start) / meshRuns;
+
+	const Vector3 up = { 0.0f, 1.0f, 0.0f };
+	start = ReadClock();
+	for (unsigned int i = 0; i < iterations; i++) {
+		Quaternion late = QuaternionFromAxisAngle(up, (i & 15) * 0.001f);
+		DistortionConstants frameConstants = ComputeDistortionConstants(fov[i & 1], setup.RenderTargetSize, setup.EyeRenderViewport[i & 1],
+			QuaternionIdentity(), late, late);
+		checksum += static_cast<unsigned long long>(frameConstants.TimewarpEnd.M[0][2] * 1e6f);
+	}
+	double constantSeconds = ClockTicksToSeconds(ReadClock() - start);
+
+	unsigned int frameRuns = iterations / 200000 + 1;
+	start = ReadClock();
+	for (unsigned int i = 0; i < frameRuns; i++) {
+		DrawDistortionMeshes(eyeTexture, meshPointers, constants, display, jobs);
+		checksum += display.Pixels[display.Pixels.size() / 2];
+	}
+	double meshFrameSeconds = ClockTicksToSeconds(ReadClock() - start) / frameRuns;
+	start = ReadClock();
+	for (unsigned int i = 0; i < frameRuns; i++) {
+		DistortReference(lens, fov, eyeTexture, constants, reference);
+		checksum += reference.Pixels[reference.Pixels.size() / 2];
+	}
+	double referenceFrameSeconds = ClockTicksToSeconds(ReadClock() - start) / frameRuns;
+
+	std::printf("Making both meshes: %.3f ms; constants: %.1f ns per eye\n", meshSeconds * 2e3, iterations > 0 ? constantSeconds * 1e9 / iterations : 0.0);
+	std::printf("Distorting a frame on the CPU (%d threads): %.2f ms by mesh, %.2f ms per pixel\n", jobs.GetThreadCount(), meshFrameSeconds * 1e3, referenceFrameSeconds * 1e3);
+	std::printf("Checksum: %llu\n", checksum);
+	return passed;
+}
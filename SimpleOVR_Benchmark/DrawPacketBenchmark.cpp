@@ -0,0 +1,237 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#include "Benchmarks.h"
+#include "Clock.h"
+#include "DrawQueue.h"
+#include "NullRenderDevice.h"
+#include "StateCache.h"
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+/*
+	Sorting draw packets and filtering redundant state, see DrawQueue.h and StateCache.h. 50k
+	packets with random passes, pipelines, materials and depths are sorted with the radix sort,
+	which has to give exactly what a stable std::sort by key gives, and both are timed.
+
+	Then the packets are drawn the way a renderer that binds everything per draw would: input
+	layout, vertex buffer, topology, both shaders, render targets and viewport, the material's and
+	the pass's constants and the object's, ten calls per packet through a StateCache. In the order
+	they were added only a few of the calls are redundant, sorted most are. Sorted, the pipeline
+	can only change once per pass and pipeline, the material once per pass, pipeline and material.
+
+	Finally DrawQueue submits the packets to a NullRenderDevice, which has to see every draw once
+	and a material change only where the sorted packets change material.
+*/
+
+namespace {
+	const unsigned int PacketCount = 50000;
+	const int PassCount = 4;
+	const int PipelineCount = 8;
+	const float MaxDepth = 100.0f;
+
+	float NextRandom(unsigned int& state) {
+		state = state * 1664525u + 1013904223u;
+		return (state >> 8) * (1.0f / 16777216.0f);
+	}
+
+	struct KeyedPacket {
+		unsigned long long Key;
+		unsigned int Packet;
+	};
+
+	bool KeyLess(const KeyedPacket& a, const KeyedPacket& b) {
+		return a.Key < b.Key;
+	}
+
+	int GetPipeline(const DrawPacket& packet) {
+		return static_cast<int>(packet.Key >> (DrawKeyMaterialBits + DrawKeyDepthBits) & ((1u << DrawKeyShaderBits) - 1));
+	}
+
+	// Stand-ins for the objects a D3D11 renderer would bind, only their addresses matter.
+	struct PretendObjects {
+		char InputLayout;
+		char VertexBuffer;
+		char RenderTargets;
+		char VertexShaders[PipelineCount];
+		char PixelShaders[PipelineCount];
+		char Materials[MaxMaterials];
+		char FrameConstants[PassCount];
+	};
+
+	// Binds everything each packet needs before drawing it, in the given order.
+	void BindEverything(const std::vector<DrawPacket>& packets, const std::vector<unsigned int>& order, StateCache& cache) {
+		static PretendObjects objects;
+		cache.Invalidate();
+		for (size_t i = 0; i < order.size(); i++) {
+			const DrawPacket& packet = packets[order[i]];
+			int pipeline = GetPipeline(packet);
+			Rect2i viewport = { { packet.Pass * 100, 0 }, { 100, 100 } };
+			cache.Change(StateSlot_InputLayout, &objects.InputLayout);
+			cache.Change(StateSlot_VertexBuffer, &objects.VertexBuffer, sizeof(Vertex));
+			cache.Change(StateSlot_Topology, nullptr, 4);
+			cache.Change(StateSlot_VertexShader, &objects.VertexShaders[pipeline]);
+			cache.Change(StateSlot_PixelShader, &objects.PixelShaders[pipeline]);
+			cache.Change(StateSlot_RenderTargets, &objects.RenderTargets);
+			cache.ChangeViewport(viewport);
+			cache.Change(StateSlot_PixelConstants, &objects.Materials[packet.Material]);
+			cache.Change(static_cast<StateSlot>(StateSlot_VertexConstants + ConstantSlot_Frame), &objects.FrameConstants[packet.Pass]);
+			cache.Change(static_cast<StateSlot>(StateSlot_VertexConstants + ConstantSlot_Object), nullptr, packet.ObjectOffset);
+		}
+	}
+
+	void PrintCalls(const char* order, const StateCache::Statistics& statistics) {
+		std::printf("%s: %llu calls issued, %llu filtered (%llu shader, %llu material, %llu viewport changes)\n", order,
+			statistics.TotalIssued, statistics.TotalFiltered, statistics.Issued[StateSlot_VertexShader],
+			statistics.Issued[StateSlot_PixelConstants], statistics.Issued[StateSlot_Viewport]);
+	}
+}
+
+bool RunDrawPacketBenchmark(unsigned int iterations) {
+	bool passed = true;
+
+	unsigned int state = 4242;
+	DrawQueue queue;
+	std::vector<DrawPacket> packets(PacketCount);
+	for (unsigned int i = 0; i < PacketCount; i++) {
+		DrawPacket& packet = packets[i];
+		packet.Pass = static_cast<int>(NextRandom(state) * PassCount) % PassCount;
+		packet.Material = static_cast<int>(NextRandom(state) * MaxMaterials) % MaxMaterials;
+		int pipeline = static_cast<int>(NextRandom(state) * PipelineCount) % PipelineCount;
+		packet.Key = MakeDrawKey(packet.Pass, pipeline, packet.Material, NextRandom(state) * MaxDepth);
+		packet.ObjectOffset = i * 256;
+		packet.VertexCount = 3;
+		packet.StartVertex = 0;
+		queue.Add(packet);
+	}
+
+	// The radix sort against a stable std::sort of the same keys.
+	std::vector<KeyedPacket> reference(PacketCount);
+	for (unsigned int i = 0; i < PacketCount; i++) {
+		reference[i].Key = packets[i].Key;
+		reference[i].Packet = i;
+	}
+	std::stable_sort(reference.begin(), reference.end(), KeyLess);
+	queue.Sort();
+	bool same = queue.GetPacketCount() == PacketCount;
+	for (unsigned int i = 0; same && i < PacketCount; i++) {
+		same = queue.GetPacket(i).ObjectOffset == packets[reference[i].Packet].ObjectOffset;
+	}
+	std::printf("Radix sort of %u packets: %s, %llu of 8 rounds needed\n", PacketCount, same ? "same order as std::stable_sort" : "FAILED, differs from std::stable_sort",
+		queue.GetStatistics().SortRounds);
+	passed = passed && same;
+
+	unsigned int sortRuns = std::max(1u, iterations / 20000);
+	std::vector<unsigned long long> keys(PacketCount);
+	std::vector<unsigned int> values(PacketCount);
+	std::vector<unsigned long long> scratchKeys(PacketCount);
+	std::vector<unsigned int> scratchValues(PacketCount);
+	auto start = ReadClock();
+	for (unsigned int run = 0; run < sortRuns; run++) {
+		for (unsigned int i = 0; i < PacketCount; i++) {
+			keys[i] = packets[i].Key;
+			values[i] = i;
+		}
+		RadixSortKeys(&keys[0], &values[0], &scratchKeys[0], &scratchValues[0], PacketCount);
+	}
+	double radixSeconds = ClockTicksToSeconds(ReadClock() - start);
+
+	std::vector<KeyedPacket> sorted(PacketCount);
+	start = ReadClock();
+	for (unsigned int run = 0; run < sortRuns; run++) {
+		for (unsigned int i = 0; i < PacketCount; i++) {
+			sorted[i].Key = packets[i].Key;
+			sorted[i].Packet = i;
+		}
+		std::sort(sorted.begin(), sorted.end(), KeyLess);
+	}
+	double stdSeconds = ClockTicksToSeconds(ReadClock() - start);
+	std::printf("Sorting %u packets: radix %.3f ms, std::sort %.3f ms (%.2fx)\n", PacketCount, radixSeconds * 1e3 / sortRuns,
+		stdSeconds * 1e3 / sortRuns, radixSeconds > 0.0 ? stdSeconds / radixSeconds : 0.0);
+
+	// Binding everything per draw, unsorted and sorted.
+	std::vector<unsigned int> submissionOrder(PacketCount);
+	std::vector<unsigned int> sortedOrder(PacketCount);
+	unsigned int pipelineRuns = 0;
+	unsigned int materialRuns = 0;
+	for (unsigned int i = 0; i < PacketCount; i++) {
+		submissionOrder[i] = i;
+		sortedOrder[i] = reference[i].Packet;
+		const DrawPacket& packet = packets[sortedOrder[i]];
+		const DrawPacket* previous = i > 0 ? &packets[sortedOrder[i - 1]] : nullptr;
+		if (previous == nullptr || GetPipeline(*previous) != GetPipeline(packet)) {
+			pipelineRuns++;
+		}
+		if (previous == nullptr || previous->Material != packet.Material) {
+			materialRuns++;
+		}
+	}
+	StateCache unsortedCache;
+	BindEverything(packets, submissionOrder, unsortedCache);
+	StateCache sortedCache;
+	BindEverything(packets, sortedOrder, sortedCache);
+	const StateCache::Statistics& unsorted = unsortedCache.GetStatistics();
+	const StateCache::Statistics& sortedCalls = sortedCache.GetStatistics();
+	PrintCalls("Binding everything, unsorted", unsorted);
+	PrintCalls("Binding everything, sorted", sortedCalls);
+	bool filtered = unsorted.TotalIssued + unsorted.TotalFiltered == PacketCount * 10 && sortedCalls.TotalIssued + sortedCalls.TotalFiltered == PacketCount * 10 &&
+		sortedCalls.TotalIssued < unsorted.TotalIssued && sortedCalls.Issued[StateSlot_VertexShader] == pipelineRuns &&
+		sortedCalls.Issued[StateSlot_PixelConstants] == materialRuns && pipelineRuns <= PassCount * PipelineCount &&
+		materialRuns <= PassCount * PipelineCount * MaxMaterials;
+	std::printf("API calls: %llu unfiltered, %llu issued sorted and filtered (%.1f%%), %s\n", static_cast<unsigned long long>(PacketCount) * 10,
+		sortedCalls.TotalIssued, 100.0 * sortedCalls.TotalIssued / (PacketCount * 10.0), filtered ? "as expected" : "FAILED");
+	passed = passed && filtered;
+
+	// Sorting and submitting through DrawQueue.
+	const Size2i eyeTextureSize = { 2364, 1464 };
+	NullRenderDevice device(eyeTextureSize, 1);
+	unsigned int submitRuns = std::max(1u, iterations / 20000);
+	start = ReadClock();
+	for (unsigned int run = 0; run < submitRuns; run++) {
+		queue.Clear();
+		for (unsigned int i = 0; i < PacketCount; i++) {
+			queue.Add(packets[i]);
+		}
+		queue.Sort();
+		queue.Submit(device, 1, [&](RenderContext& context, int pass) {
+			Rect2i viewport = { { pass * 100, 0 }, { 100, 100 } };
+			context.SetViewport(viewport);
+			context.BindConstants(ConstantSlot_Frame, pass * 256, sizeof(Matrix4));
+		});
+	}
+	double submitSeconds = ClockTicksToSeconds(ReadClock() - start);
+	const NullRenderDevice::Statistics& deviceStatistics = device.GetStatistics();
+	const StateCache::Statistics& deviceCalls = device.GetStateStatistics();
+	bool submitted = deviceStatistics.Draws == static_cast<unsigned long long>(PacketCount) * submitRuns &&
+		deviceCalls.Issued[StateSlot_PixelConstants] <= static_cast<unsigned long long>(materialRuns) * submitRuns;
+	std::printf("DrawQueue: %.3f ms to sort and submit %u packets, %llu material binds per frame, %s\n", submitSeconds * 1e3 / submitRuns, PacketCount,
+		deviceCalls.Issued[StateSlot_PixelConstants] / submitRuns, submitted ? "every packet drawn" : "FAILED");
+	passed = passed && submitted;
+
+	return passed;
+}
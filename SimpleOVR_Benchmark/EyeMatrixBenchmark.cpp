@@ -0,0 +1,227 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#include "Benchmarks.h"
+#include "Clock.h"
+#include "EyeMatrixPipeline.h"
+#include "FrameLoop.h"
+#include "NullRenderDevice.h"
+#include "SimulatedHmd.h"
+#include "VrMath.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+/*
+	EyeMatrixPipeline against the per-eye scalar math it replaced (ComputeEyeViewProjection and
+	ComputeStereoConstants, which follow OVR_Math operation for operation).
+
+	The results can't be bit identical, the pipeline takes a different route to the same view
+	matrix, so each element may differ by a few ulps relative to the largest elements of the
+	matrix. Anything above Tolerance is a bug.
+*/
+
+namespace {
+	const float Tolerance = 1e-5f;
+	const int PoseSetCount = 64;
+
+	// Deterministic, so every run checks the same poses.
+	class Random {
+	public:
+		Random() : state(12345) {}
+
+		float Next(float low, float high) {
+			state = state * 1664525u + 1013904223u;
+			return low + (high - low) * ((state >> 8) / 16777216.0f);
+		}
+
+	private:
+		unsigned int state;
+	};
+
+	Pose RandomPose(Random& random) {
+		Quaternion q = { random.Next(-1, 1), random.Next(-1, 1), random.Next(-1, 1), random.Next(-1, 1) };
+		Pose pose;
+		pose.Orientation = Normalized(q);
+		pose.Position.x = random.Next(-2, 2);
+		pose.Position.y = random.Next(-2, 2);
+		pose.Position.z = random.Next(-2, 2);
+		return pose;
+	}
+
+	// Largest difference between two matrices, relative to the largest element of the reference.
+	float RelativeError(const Matrix4& result, const Matrix4& reference) {
+		float largest = 0.0f;
+		float error = 0.0f;
+		for (int i = 0; i < 4; i++) {
+			for (int j = 0; j < 4; j++) {
+				largest = std::max(largest, std::fabs(reference.M[i][j]));
+				error = std::max(error, std::fabs(result.M[i][j] - reference.M[i][j]));
+			}
+		}
+		return largest > 0.0f ? error / largest : error;
+	}
+
+	float CheckRandomPoses(StereoSetup& setup, const EyeRenderDesc eyeRenderDesc[EyeCount]) {
+		Random random;
+		for (int eye = 0; eye < EyeCount; eye++) {
+			setup.EyeMatrices.SetView(eye, eyeRenderDesc[eye].Fov, ZNear, ZFar, MatrixIdentity());
+		}
+
+		float maxError = 0.0f;
+		for (int i = 0; i < 100000; i++) {
+			Pose poses[EyeCount] = { RandomPose(random), RandomPose(random) };
+			Matrix4 result[EyeCount];
+			setup.EyeMatrices.Compute(poses, result);
+			for (int eye = 0; eye < EyeCount; eye++) {
+				maxError = std::max(maxError, RelativeError(result[eye], Transposed(ComputeEyeViewProjection(eyeRenderDesc[eye], poses[eye]))));
+			}
+		}
+		return maxError;
+	}
+
+	// Runs the real frame loop and compares what it uploaded with the reference for the same poses.
+	float CheckFrameLoop(StereoMode mode) {
+		PoseScript script;
+		SimulatedHmd hmd(script);
+		StereoSetup setup = CreateStereoSetup(hmd, 1.0f);
+		setup.Mode = mode;
+		NullRenderDevice device(setup.RenderTargetSize, 1);
+		Scene scene;
+		AddDefaultSceneContent(scene);
+		JobSystem jobs(1);
+		EyeRenderDesc eyeRenderDesc[EyeCount] = { hmd.GetEyeRenderDesc(0), hmd.GetEyeRenderDesc(1) };
+		Vector3 hmdToEyeViewOffset[EyeCount] = { eyeRenderDesc[0].HmdToEyeViewOffset, eyeRenderDesc[1].HmdToEyeViewOffset };
+
+		float maxError = 0.0f;
+		for (int frame = 0; frame < 1000; frame++) {
+			Pose poses[EyeCount];
+			hmd.GetEyePoses(hmd.GetFrameIndex(), hmdToEyeViewOffset, poses);
+			RenderFrame(hmd, device, setup, scene, jobs);
+
+			const unsigned char* uploaded = device.GetConstants(ConstantSlot_Frame);
+			if (mode == StereoMode_Instanced) {
+				StereoConstants result;
+				std::memcpy(&result, uploaded, sizeof(result));
+				StereoConstants reference = ComputeStereoConstants(setup, eyeRenderDesc, poses);
+				for (int eye = 0; eye < EyeCount; eye++) {
+					maxError = std::max(maxError, RelativeError(result.ViewProjection[eye], reference.ViewProjection[eye]));
+					if (std::memcmp(result.ClipRect[eye], reference.ClipRect[eye], sizeof(result.ClipRect[eye])) != 0) {
+						maxError = 1.0f;
+					}
+				}
+			}
+			else {
+				// Only the last eye's matrix is left in the constant buffer.
+				int eye = hmd.GetEyeRenderOrder(EyeCount - 1);
+				Matrix4 result;
+				std::memcpy(&result, uploaded, sizeof(result));
+				maxError = std::max(maxError, RelativeError(result, Transposed(ComputeEyeViewProjection(eyeRenderDesc[eye], poses[eye]))));
+			}
+		}
+		return maxError;
+	}
+
+	double TimeReference(const EyeRenderDesc eyeRenderDesc[EyeCount], const Pose poses[][EyeCount], unsigned int iterations, float& checksum) {
+		auto start = ReadClock();
+		for (unsigned int i = 0; i < iterations; i++) {
+			const Pose* framePoses = poses[i % PoseSetCount];
+			for (int eye = 0; eye < EyeCount; eye++) {
+				Matrix4 transposedMvp = Transposed(ComputeEyeViewProjection(eyeRenderDesc[eye], framePoses[eye]));
+				checksum += transposedMvp.M[3][2];
+			}
+		}
+		return ClockTicksToSeconds(ReadClock() - start);
+	}
+
+	double TimePipeline(const EyeMatrixPipeline& pipeline, const std::vector<Pose>& poses, unsigned int iterations, float& checksum) {
+		int viewCount = pipeline.GetViewCount();
+		std::vector<Matrix4> result(viewCount);
+		auto start = ReadClock();
+		for (unsigned int i = 0; i < iterations; i++) {
+			pipeline.Compute(&poses[(i % PoseSetCount) * viewCount], result.data());
+			checksum += result[viewCount - 1].M[3][2];
+		}
+		return ClockTicksToSeconds(ReadClock() - start);
+	}
+}
+
+bool RunEyeMatrixBenchmark(unsigned int iterations) {
+	PoseScript script;
+	SimulatedHmd hmd(script);
+	StereoSetup setup = CreateStereoSetup(hmd, 1.0f);
+	EyeRenderDesc eyeRenderDesc[EyeCount] = { hmd.GetEyeRenderDesc(0), hmd.GetEyeRenderDesc(1) };
+
+	float randomError = CheckRandomPoses(setup, eyeRenderDesc);
+	float multiPassError = CheckFrameLoop(StereoMode_MultiPass);
+	float instancedError = CheckFrameLoop(StereoMode_Instanced);
+	std::printf("Max relative error vs reference (tolerance %g):\n", Tolerance);
+	std::printf("  random poses: %g\n", randomError);
+	std::printf("  frame loop, multi-pass: %g\n", multiPassError);
+	std::printf("  frame loop, instanced: %g\n", instancedError);
+
+	Random random;
+	Pose poses[PoseSetCount][EyeCount];
+	std::vector<Pose> stereoPoses;
+	for (int i = 0; i < PoseSetCount; i++) {
+		for (int eye = 0; eye < EyeCount; eye++) {
+			poses[i][eye] = RandomPose(random);
+			stereoPoses.push_back(poses[i][eye]);
+		}
+	}
+
+	float checksum = 0.0f;
+	double referenceTime = TimeReference(eyeRenderDesc, poses, iterations, checksum);
+	double pipelineTime = TimePipeline(setup.EyeMatrices, stereoPoses, iterations, checksum);
+	std::printf("Both eyes, per frame:\n");
+	std::printf("  reference: %.1f ns\n", referenceTime * 1e9 / iterations);
+	std::printf("  pipeline:  %.1f ns (%.2fx)\n", pipelineTime * 1e9 / iterations, referenceTime / pipelineTime);
+
+	std::printf("N views, per view:\n");
+	const int viewCounts[] = { 1, 2, 4, 8, 16 };
+	for (int viewCount : viewCounts) {
+		EyeMatrixPipeline pipeline;
+		pipeline.SetViewCount(viewCount);
+		for (int view = 0; view < viewCount; view++) {
+			pipeline.SetView(view, eyeRenderDesc[view % EyeCount].Fov, ZNear, ZFar, MatrixIdentity());
+		}
+		std::vector<Pose> viewPoses;
+		for (int i = 0; i < PoseSetCount * viewCount; i++) {
+			viewPoses.push_back(RandomPose(random));
+		}
+		unsigned int batchIterations = std::max(1u, iterations / viewCount);
+		double time = TimePipeline(pipeline, viewPoses, batchIterations, checksum);
+		std::printf("  %2d views: %.1f ns\n", viewCount, time * 1e9 / (static_cast<double>(batchIterations) * viewCount));
+	}
+
+	// Printed so the compiler can't throw the work away.
+	std::printf("Checksum: %g\n", checksum);
+
+	return randomError <= Tolerance && multiPassError <= Tolerance && instancedError <= Tolerance;
+}
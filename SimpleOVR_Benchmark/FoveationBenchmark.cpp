@@ -0,0 +1,369 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+
+#include "Benchmarks.h"
+#include "Clock.h"
+#include "FoveatedLayout.h"
+#include "FrameLoop.h"
+#include "JobSystem.h"
+#include "NullRenderDevice.h"
+#include "SimulatedHmd.h"
+#include "VrMath.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+/*
+	Fixed foveated rendering. The layouts have to tile each eye viewport exactly, with the regions
+	not overlapping in the foveated target and the target fitting in the eye texture. Then the
+	frame loop draws foveated frames on NullRenderDevice: a point drawn with a pass's (late
+	latched) matrix into its viewport and stretched back by the composite has to land on the same
+	pixel of the eye texture as with the eye's plain view-projection, in both stereo modes.
+
+	The pixels saved are reported for a range of settings, along with what the extra passes cost
+	the CPU.
+*/
+
+namespace {
+	const float PixelTolerance = 0.05f;
+	const unsigned int PointCount = 20000;
+	const unsigned int SceneObjectCount = 4000;
+
+	// Deterministic, so every run checks the same points.
+	float NextRandom(unsigned int& state) {
+		state = state * 1664525u + 1013904223u;
+		return (state >> 8) * (1.0f / 16777216.0f);
+	}
+
+	bool Contains(const Rect2i& rect, float x, float y) {
+		return x >= rect.Pos.x && x < rect.Pos.x + rect.Size.w && y >= rect.Pos.y && y < rect.Pos.y + rect.Size.h;
+	}
+
+	// Counts how often each pixel of an area of size is covered by the rectangles. False if any is outside.
+	bool Cover(std::vector<unsigned char>& coverage, Size2i size, const Rect2i& rect) {
+		if (rect.Pos.x < 0 || rect.Pos.y < 0 || rect.Pos.x + rect.Size.w > size.w || rect.Pos.y + rect.Size.h > size.h) {
+			return false;
+		}
+		for (int y = rect.Pos.y; y < rect.Pos.y + rect.Size.h; y++) {
+			for (int x = rect.Pos.x; x < rect.Pos.x + rect.Size.w; x++) {
+				coverage[y * size.w + x]++;
+			}
+		}
+		return true;
+	}
+
+	bool CheckLayout(Size2i textureSize, const Rect2i eyeViewport[EyeCount], const FoveationSettings& settings) {
+		FoveatedLayout layout;
+		ComputeFoveatedLayout(eyeViewport, settings, layout);
+		if (layout.TargetSize.w > textureSize.w || layout.TargetSize.h > textureSize.h) {
+			return false;
+		}
+
+		std::vector<unsigned char> eyeCoverage(textureSize.w * textureSize.h, 0);
+		std::vector<unsigned char> targetCoverage(textureSize.w * textureSize.h, 0);
+		for (int eye = 0; eye < EyeCount; eye++) {
+			for (int i = 0; i < FoveatedRegionCount; i++) {
+				const FoveatedRegion& region = layout.Regions[eye][i];
+				if (!Cover(eyeCoverage, textureSize, region.Eye) || !Cover(targetCoverage, textureSize, region.Target) ||
+					region.Target.Size.w > region.Eye.Size.w || region.Target.Size.h > region.Eye.Size.h ||
+					(region.Target.Size.w == 0) != (region.Eye.Size.w == 0) || (region.Target.Size.h == 0) != (region.Eye.Size.h == 0)) {
+					return false;
+				}
+			}
+		}
+
+		// Every pixel of the eye viewports exactly once, nothing else.
+		for (int y = 0; y < textureSize.h; y++) {
+			for (int x = 0; x < textureSize.w; x++) {
+				bool inEye = Contains(eyeViewport[0], static_cast<float>(x), static_cast<float>(y)) || Contains(eyeViewport[1], static_cast<float>(x), static_cast<float>(y));
+				if (eyeCoverage[y * textureSize.w + x] != (inEye ? 1 : 0) || targetCoverage[y * textureSize.w + x] > 1) {
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+
+	bool CheckLayouts() {
+		const FoveationSettings settings[] = {
+			{ 0.6f, 0.5f, false },
+			{ 0.4f, 0.25f, false },
+			{ 0.33f, 0.1f, false },
+			{ 1.0f, 0.5f, false }, // Nothing but the center
+			{ 0.0f, 0.5f, false }, // No center at all
+			{ 0.5f, 1.0f, false },
+		};
+		const Size2i textureSizes[] = { { 2364, 1464 }, { 1001, 999 }, { 4, 3 } };
+
+		for (size_t t = 0; t < sizeof(textureSizes) / sizeof(textureSizes[0]); t++) {
+			Size2i size = textureSizes[t];
+			Rect2i eyeViewport[EyeCount];
+			eyeViewport[0].Pos.x = 0;
+			eyeViewport[0].Pos.y = 0;
+			eyeViewport[0].Size.w = size.w / 2;
+			eyeViewport[0].Size.h = size.h;
+			eyeViewport[1].Pos.x = (size.w + 1) / 2;
+			eyeViewport[1].Pos.y = 0;
+			eyeViewport[1].Size = eyeViewport[0].Size;
+
+			// Also as adaptive resolution would leave them.
+			Rect2i scaledViewport[EyeCount];
+			for (int eye = 0; eye < EyeCount; eye++) {
+				scaledViewport[eye].Pos = eyeViewport[eye].Pos;
+				scaledViewport[eye].Size.w = (eyeViewport[eye].Size.w * 7 + 5) / 10;
+				scaledViewport[eye].Size.h = (eyeViewport[eye].Size.h * 7 + 5) / 10;
+			}
+
+			for (size_t s = 0; s < sizeof(settings) / sizeof(settings[0]); s++) {
+				if (!CheckLayout(size, eyeViewport, settings[s]) || !CheckLayout(size, scaledViewport, settings[s])) {
+					std::printf("  Bad layout for %dx%d, center %.2f, density %.2f\n", size.w, size.h, settings[s].CenterSize, settings[s].PeripheryDensity);
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+
+	// The pixel a point in NDC lands on in viewport. Pixel rows go down, NDC goes up.
+	void NdcToPixel(const Rect2i& viewport, float x, float y, float outPixel[2]) {
+		outPixel[0] = viewport.Pos.x + (x + 1.0f) * 0.5f * viewport.Size.w;
+		outPixel[1] = viewport.Pos.y + (1.0f - y) * 0.5f * viewport.Size.h;
+	}
+
+	// Projects with a matrix as uploaded for the shader (transposed). False if behind the eye.
+	bool Project(const Matrix4& transposed, const Vector3& point, float outNdc[2]) {
+		float clip[4];
+		for (int i = 0; i < 4; i++) {
+			clip[i] = transposed.M[0][i] * point.x + transposed.M[1][i] * point.y + transposed.M[2][i] * point.z + transposed.M[3][i];
+		}
+		if (clip[3] <= 0.0f) {
+			return false;
+		}
+		outNdc[0] = clip[0] / clip[3];
+		outNdc[1] = clip[1] / clip[3];
+		return true;
+	}
+
+	struct FrameCheck {
+		bool Passed;
+		unsigned int PointsChecked;
+		float MaxError; // Pixels
+		unsigned long long Draws;
+	};
+
+	/*
+		Draws a late latched foveated frame, so the matrices of every pass are still around in
+		the latched constants afterwards, and projects random points with them.
+	*/
+	FrameCheck CheckFrame(StereoMode mode, const Scene& scene) {
+		PoseScript script;
+		SimulatedHmd hmd(script);
+		StereoSetup setup = CreateStereoSetup(hmd, 1.0f);
+		setup.Mode = mode;
+		setup.LateLatch = true;
+		setup.Foveated = true;
+		NullRenderDevice device(setup.RenderTargetSize, 1);
+		device.SetSceneVertices(&scene.GetVertices()[0], static_cast<unsigned int>(scene.GetVertices().size()));
+		JobSystem jobs(1);
+
+		EyeRenderDesc eyeRenderDesc[EyeCount] = { hmd.GetEyeRenderDesc(0), hmd.GetEyeRenderDesc(1) };
+		Vector3 hmdToEyeViewOffset[EyeCount] = { eyeRenderDesc[0].HmdToEyeViewOffset, eyeRenderDesc[1].HmdToEyeViewOffset };
+		Pose eyePose[EyeCount];
+		hmd.GetEyePoses(0, hmdToEyeViewOffset, eyePose);
+		RenderFrame(hmd, device, setup, scene, jobs);
+
+		FrameCheck check;
+		check.Passed = device.GetFoveatedLayout() != nullptr && device.GetStatistics().Composites == 1;
+		check.PointsChecked = 0;
+		check.MaxError = 0.0f;
+		check.Draws = device.GetStatistics().Draws;
+		if (!check.Passed) {
+			return check;
+		}
+		const FoveatedLayout& layout = *device.GetFoveatedLayout();
+
+		// The latched part of each eye's regions, in the order RenderFrame adds the passes.
+		int part[EyeCount][FoveatedRegionCount];
+		int passCount = 0;
+		for (int e = 0; e < EyeCount; e++) {
+			int eye = mode == StereoMode_Instanced ? e : hmd.GetEyeRenderOrder(e);
+			for (int i = 0; i < FoveatedRegionCount; i++) {
+				const FoveatedRegion& region = layout.Regions[eye][i];
+				bool empty = region.Target.Size.w == 0 || region.Target.Size.h == 0;
+				part[eye][i] = empty ? -1 : (mode == StereoMode_Instanced ? (e == 0 ? passCount++ : part[0][i]) : passCount++);
+			}
+		}
+		unsigned long long expectedDraws = setup.VisibleObjects.size() * passCount;
+		if (check.Draws != expectedDraws) {
+			check.Passed = false;
+		}
+
+		unsigned int state = 4321;
+		Rect2i fullTarget = { { 0, 0 }, setup.RenderTargetSize };
+		for (unsigned int p = 0; p < PointCount; p++) {
+			Vector3 point = { (NextRandom(state) * 2.0f - 1.0f) * 30.0f, (NextRandom(state) * 2.0f - 1.0f) * 10.0f, (NextRandom(state) * 2.0f - 1.0f) * 30.0f };
+			for (int eye = 0; eye < EyeCount; eye++) {
+				float ndc[2];
+				if (!Project(Transposed(ComputeEyeViewProjection(eyeRenderDesc[eye], eyePose[eye])), point, ndc) || std::fabs(ndc[0]) >= 1.0f || std::fabs(ndc[1]) >= 1.0f) {
+					continue;
+				}
+				float expected[2];
+				NdcToPixel(setup.EyeRenderViewport[eye], ndc[0], ndc[1], expected);
+
+				int i = 0;
+				while (i < FoveatedRegionCount && !Contains(layout.Regions[eye][i].Eye, expected[0], expected[1])) {
+					i++;
+				}
+				if (i == FoveatedRegionCount || part[eye][i] < 0) {
+					check.Passed = false;
+					continue;
+				}
+				const FoveatedRegion& region = layout.Regions[eye][i];
+
+				// Into the pass's viewport in the foveated target: the region's own, or all of it
+				// with StereoMode_Instanced.
+				const unsigned char* latched = device.GetLatchedConstants(part[eye][i]);
+				Matrix4 transposedMvp;
+				std::memcpy(&transposedMvp, latched + (mode == StereoMode_Instanced ? eye * sizeof(Matrix4) : 0), sizeof(Matrix4));
+				float passNdc[2];
+				float target[2];
+				if (!Project(transposedMvp, point, passNdc)) {
+					check.Passed = false;
+					continue;
+				}
+				NdcToPixel(mode == StereoMode_Instanced ? fullTarget : region.Target, passNdc[0], passNdc[1], target);
+
+				// And stretched back by the composite.
+				float pixel[2] = {
+					region.Eye.Pos.x + (target[0] - region.Target.Pos.x) * region.Eye.Size.w / region.Target.Size.w,
+					region.Eye.Pos.y + (target[1] - region.Target.Pos.y) * region.Eye.Size.h / region.Target.Size.h
+				};
+				float error = std::max(std::fabs(pixel[0] - expected[0]), std::fabs(pixel[1] - expected[1]));
+				check.MaxError = std::max(check.MaxError, error);
+				check.PointsChecked++;
+			}
+		}
+		if (check.MaxError > PixelTolerance || check.PointsChecked == 0) {
+			check.Passed = false;
+		}
+		return check;
+	}
+
+	// Mean CPU time of a frame on NullRenderDevice.
+	double TimeFrames(StereoMode mode, bool foveated, const Scene& scene, unsigned int frameCount) {
+		PoseScript script;
+		SimulatedHmd hmd(script);
+		StereoSetup setup = CreateStereoSetup(hmd, 1.0f);
+		setup.Mode = mode;
+		setup.Foveated = foveated;
+		NullRenderDevice device(setup.RenderTargetSize, 1);
+		device.SetSceneVertices(&scene.GetVertices()[0], static_cast<unsigned int>(scene.GetVertices().size()));
+		JobSystem jobs(1);
+
+		auto start = ReadClock();
+		for (unsigned int frame = 0; frame < frameCount; frame++) {
+			RenderFrame(hmd, device, setup, scene, jobs);
+		}
+		return ClockTicksToSeconds(ReadClock() - start) / frameCount;
+	}
+}
+
+bool RunFoveationBenchmark(unsigned int iterations) {
+	bool passed = CheckLayouts();
+	if (passed) {
+		std::printf("Layouts: regions tile the eyes exactly and fit the target\n");
+	}
+
+	Scene scene;
+	AddDefaultSceneContent(scene);
+	unsigned int state = 1234;
+	const Vector3 up = { 0.0f, 1.0f, 0.0f };
+	for (unsigned int i = 0; i < SceneObjectCount; i++) {
+		Vector3 position = { (NextRandom(state) * 2.0f - 1.0f) * 30.0f, (NextRandom(state) * 2.0f - 1.0f) * 10.0f, (NextRandom(state) * 2.0f - 1.0f) * 30.0f };
+		scene.AddObject(0, position, QuaternionFromAxisAngle(up, NextRandom(state) * 6.2831853f), 0.5f + NextRandom(state));
+	}
+
+	const StereoMode modes[] = { StereoMode_MultiPass, StereoMode_Instanced };
+	for (int m = 0; m < 2; m++) {
+		FrameCheck check = CheckFrame(modes[m], scene);
+		std::printf("Frame loop, %-11s %u points, max error %.4f pixels, %llu draws\n",
+			modes[m] == StereoMode_Instanced ? "instanced:" : "multi-pass:", check.PointsChecked, check.MaxError, check.Draws);
+		if (!check.Passed) {
+			std::printf("  Foveated frame does not match the eye's view\n");
+			passed = false;
+		}
+	}
+
+	// What the settings save, for the DK2's eye texture.
+	PoseScript script;
+	SimulatedHmd hmd(script);
+	StereoSetup setup = CreateStereoSetup(hmd, 1.0f);
+	const float centerSizes[] = { 0.8f, 0.6f, 0.4f };
+	const float densities[] = { 0.5f, 0.33f, 0.25f };
+	std::printf("Pixels shaded relative to %dx%d (center size x periphery density):\n", setup.RenderTargetSize.w, setup.RenderTargetSize.h);
+	std::printf("        ");
+	for (int d = 0; d < 3; d++) {
+		std::printf(" %7.2f", densities[d]);
+	}
+	std::printf("\n");
+	for (int c = 0; c < 3; c++) {
+		std::printf("  %5.2f:", centerSizes[c]);
+		for (int d = 0; d < 3; d++) {
+			FoveationSettings settings = { centerSizes[c], densities[d], false };
+			FoveatedLayout layout;
+			ComputeFoveatedLayout(setup.EyeRenderViewport, settings, layout);
+			std::printf(" %6.1f%%", 100.0 * GetFoveatedPixelCount(layout) / GetFullPixelCount(layout));
+		}
+		std::printf("\n");
+	}
+
+	// The extra passes are paid for in draw calls.
+	unsigned int frameCount = iterations / 20000 + 1;
+	std::printf("CPU per frame, %u objects:\n", SceneObjectCount);
+	for (int m = 0; m < 2; m++) {
+		double plain = TimeFrames(modes[m], false, scene, frameCount);
+		double foveated = TimeFrames(modes[m], true, scene, frameCount);
+		std::printf("  %-11s %8.1f us plain, %8.1f us foveated\n", modes[m] == StereoMode_Instanced ? "instanced:" : "multi-pass:", plain * 1e6, foveated * 1e6);
+	}
+
+	FoveatedLayout layout;
+	FoveationSettings settings = GetDefaultFoveationSettings();
+	unsigned long long pixelSum = 0;
+	auto start = ReadClock();
+	for (unsigned int i = 0; i < iterations; i++) {
+		settings.CenterSize = 0.5f + (i & 7) * 0.01f;
+		ComputeFoveatedLayout(setup.EyeRenderViewport, settings, layout);
+		pixelSum += layout.TargetSize.w;
+	}
+	double seconds = ClockTicksToSeconds(ReadClock() - start);
+	std::printf("ComputeFoveatedLayout: %.1f ns (mean target width %.1f)\n", iterations > 0 ? seconds * 1e9 / iterations : 0.0,
+		iterations > 0 ? static_cast<double>(pixelSum) / iterations : 0.0);
+	return passed;
+}
@@ -0,0 +1,431 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#include "Benchmarks.h"
+#include "Clock.h"
+#include "FrameGraph.h"
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+/*
+	The frame graph's scheduler, see FrameGraph.h, checked against FrameGraphRecorder. Every
+	schedule has to be consistent: barriers go from the state a resource is in to the one it is
+	used in next, and every resolve is read before its target is written again. Small graphs with
+	a known answer check the culling, clear merging and ordering, and the eye graph of each
+	configuration has to resolve and composite exactly what it did before the graph.
+
+	Random graphs are then run both in the order they were declared and as scheduled, and each
+	pass that wasn't culled has to see the same contents either way, as do the outputs.
+
+	Then declaring, compiling and executing the eye graph is timed, with the compilation cached
+	and with a new configuration every frame.
+*/
+
+namespace {
+	float NextRandom(unsigned int& state) {
+		state = state * 1664525u + 1013904223u;
+		return (state >> 8) * (1.0f / 16777216.0f);
+	}
+
+	FrameGraphClearValue MakeClearValue(float value) {
+		FrameGraphClearValue clear;
+		std::memset(&clear, 0, sizeof(clear));
+		clear.Color[0] = value;
+		clear.Depth = value;
+		return clear;
+	}
+
+	// The barriers have to be consistent and every resolve read; the recorder has to see the
+	// same commands as the graph.
+	bool IsValid(const FrameGraph& graph, const std::vector<int>& outputs) {
+		int resourceCount = graph.GetResourceCount();
+		std::vector<FrameGraphState> states(resourceCount, FrameGraphState_Undefined);
+		std::vector<bool> isOutput(resourceCount, false);
+		for (size_t output = 0; output < outputs.size(); output++) {
+			int resource = graph.GetOutputResource(outputs[output]);
+			states[resource] = FrameGraphState_ShaderResource;
+			isOutput[resource] = true;
+		}
+
+		std::vector<bool> unreadResolve(resourceCount, false);
+		for (int i = 0; i < graph.GetCommandCount(); i++) {
+			const FrameGraphCommand& command = graph.GetCommand(i);
+			if (command.Type == FrameGraphCommand_Barrier) {
+				if (command.Before != states[command.Resource] || command.Before == command.After) {
+					return false;
+				}
+				states[command.Resource] = command.After;
+			}
+			else if (command.Type == FrameGraphCommand_Clear) {
+				FrameGraphState state = graph.GetResourceDesc(command.Resource).Format == RenderTargetFormat_DepthStencil ? FrameGraphState_DepthStencil : FrameGraphState_RenderTarget;
+				if (states[command.Resource] != state || unreadResolve[command.Resource]) {
+					return false;
+				}
+			}
+			else if (command.Type == FrameGraphCommand_Resolve) {
+				if (states[command.Source] != FrameGraphState_ResolveSource || states[command.Resource] != FrameGraphState_ResolveDestination ||
+					unreadResolve[command.Resource] || graph.GetResourceDesc(command.Source).SampleCount <= 1) {
+					return false;
+				}
+				unreadResolve[command.Resource] = true;
+			}
+			else {
+				for (int use = 0; use < graph.GetPassUseCount(command.Pass); use++) {
+					const FrameGraphUse& passUse = graph.GetPassUse(command.Pass, use);
+					const RenderTargetDesc& desc = graph.GetResourceDesc(passUse.Resource);
+					FrameGraphState state = FrameGraphState_ShaderResource;
+					if (passUse.Write) {
+						state = desc.Format == RenderTargetFormat_DepthStencil ? FrameGraphState_DepthStencil : FrameGraphState_RenderTarget;
+					}
+					else if (desc.SampleCount > 1) {
+						return false;
+					}
+					if (states[passUse.Resource] != state || (passUse.Write && unreadResolve[passUse.Resource])) {
+						return false;
+					}
+					if (!passUse.Write) {
+						unreadResolve[passUse.Resource] = false;
+					}
+				}
+			}
+		}
+		for (int resource = 0; resource < resourceCount; resource++) {
+			if (unreadResolve[resource] && !isOutput[resource]) {
+				return false;
+			}
+			if (states[resource] != (isOutput[resource] ? FrameGraphState_ShaderResource : FrameGraphState_Undefined)) {
+				return false;
+			}
+		}
+
+		FrameGraphRecorder recorder;
+		graph.Execute(recorder);
+		const std::vector<FrameGraphCommand>& recorded = recorder.GetCommands();
+		if (recorded.size() != static_cast<size_t>(graph.GetCommandCount())) {
+			return false;
+		}
+		int clears = 0;
+		for (size_t i = 0; i < recorded.size(); i++) {
+			const FrameGraphCommand& command = graph.GetCommand(static_cast<int>(i));
+			if (recorded[i].Type != command.Type || recorded[i].Resource != command.Resource || recorded[i].Source != command.Source) {
+				return false;
+			}
+			if (command.Type == FrameGraphCommand_Pass && recorded[i].Pass != command.Pass) {
+				return false;
+			}
+			if (command.Type == FrameGraphCommand_Barrier && (recorded[i].Before != command.Before || recorded[i].After != command.After)) {
+				return false;
+			}
+			if (command.Type == FrameGraphCommand_Clear &&
+				std::memcmp(&recorder.GetClearValues()[clears++], &graph.GetClearValue(command.ClearValue), sizeof(FrameGraphClearValue)) != 0) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool CheckEyeGraphs() {
+		bool passed = true;
+		FrameGraph graph;
+		FrameGraphClearValue clear = MakeClearValue(1.0f);
+		for (int multisampleCount = 1; multisampleCount <= 4; multisampleCount += 3) {
+			for (int foveated = 0; foveated < 2; foveated++) {
+				DeclareEyeFrameGraph(Size2i{ 2364, 1464 }, multisampleCount, foveated != 0, false, &clear, &clear, graph);
+				graph.Compile();
+				const FrameGraph::Statistics& statistics = graph.GetStatistics();
+				EyeTarget distortionSource = multisampleCount > 1 ? EyeTarget_Intermediary : EyeTarget_Eye;
+				std::vector<int> outputs(1, foveated ? distortionSource : EyeTarget_Eye);
+				bool ok = IsValid(graph, outputs) && graph.IsPassCulled(EyeGraphPass_Composite) == !foveated &&
+					statistics.Resolves == (multisampleCount > 1 ? 1 : 0) && statistics.Clears == 2 &&
+					graph.GetOutputResource(outputs[0]) == distortionSource;
+				std::printf("Eye graph, %dx MSAA%s: %d commands, %d clears, %d resolves, %d barriers, %d culled, %s\n", multisampleCount,
+					foveated ? ", foveated" : "", graph.GetCommandCount(), statistics.Clears, statistics.Resolves, statistics.Barriers,
+					statistics.CulledPasses, ok ? "as expected" : "FAILED");
+				passed = passed && ok;
+			}
+		}
+
+		// A fused resolve leaves the eye texture multisampled for the distortion, unless foveated.
+		for (int foveated = 0; foveated < 2; foveated++) {
+			DeclareEyeFrameGraph(Size2i{ 2364, 1464 }, 4, foveated != 0, true, &clear, &clear, graph);
+			graph.Compile();
+			const FrameGraph::Statistics& statistics = graph.GetStatistics();
+			std::vector<int> outputs(1, foveated ? EyeTarget_Intermediary : EyeTarget_Eye);
+			RenderTargetPlan plan;
+			graph.BuildTargetPlan(plan);
+			bool ok = IsValid(graph, outputs) && statistics.Resolves == (foveated ? 1 : 0) &&
+				graph.GetOutputResource(outputs[0]) == outputs[0] && plan.IsTargetUsed(EyeTarget_Intermediary) == (foveated != 0);
+			std::printf("Eye graph, 4x MSAA%s, fused resolve: %d commands, %d resolves, %d barriers, %s\n", foveated ? ", foveated" : "",
+				graph.GetCommandCount(), statistics.Resolves, statistics.Barriers, ok ? "as expected" : "FAILED");
+			passed = passed && ok;
+		}
+		return passed;
+	}
+
+	bool CheckKnownGraph() {
+		RenderTargetDesc color = { { 100, 100 }, RenderTargetFormat_Color, 1, RenderTargetBind_RenderTarget | RenderTargetBind_ShaderResource };
+		FrameGraph graph;
+		graph.Reset();
+		int first = graph.AddResource(color);
+		int second = graph.AddResource(color);
+		int result = graph.AddResource(color);
+		int unread = graph.AddResource(color);
+
+		// A, B and C draw to first, second and first again; D combines them, E is never read.
+		graph.ClearTarget(first, MakeClearValue(0.25f));
+		graph.ClearTarget(first, MakeClearValue(0.5f));
+		int a = graph.AddPass("A");
+		graph.WriteTarget(a, first, FrameGraphLoad_Keep);
+		graph.ClearTarget(second, MakeClearValue(0.75f));
+		int b = graph.AddPass("B");
+		graph.WriteTarget(b, second, FrameGraphLoad_Keep);
+		int c = graph.AddPass("C");
+		graph.WriteTarget(c, first, FrameGraphLoad_Keep);
+		graph.ClearTarget(result, MakeClearValue(1.0f));
+		int d = graph.AddPass("D");
+		graph.ReadTexture(d, first);
+		graph.ReadTexture(d, second);
+		graph.WriteTarget(d, result, FrameGraphLoad_DontCare);
+		graph.ClearTarget(unread, MakeClearValue(1.0f));
+		int e = graph.AddPass("E");
+		graph.WriteTarget(e, unread, FrameGraphLoad_Keep);
+		graph.ReadOutput(result);
+		graph.Compile();
+
+		const FrameGraph::Statistics& statistics = graph.GetStatistics();
+		bool ok = IsValid(graph, std::vector<int>(1, result)) && graph.IsPassCulled(e) && !graph.IsPassCulled(a) &&
+			graph.GetPassCommand(a) < graph.GetPassCommand(c) && graph.GetPassCommand(c) < graph.GetPassCommand(b) &&
+			graph.GetPassCommand(b) < graph.GetPassCommand(d) && statistics.TargetChanges == 3 &&
+			statistics.Clears == 2 && statistics.MergedClears == 1 && statistics.DroppedClears == 2 && statistics.Resolves == 0;
+		for (int i = 0; i < graph.GetCommandCount() && ok; i++) {
+			const FrameGraphCommand& command = graph.GetCommand(i);
+			if (command.Type == FrameGraphCommand_Clear && command.Resource == first) {
+				ok = graph.GetClearValue(command.ClearValue).Color[0] == 0.5f;
+			}
+		}
+		std::printf("Known graph: %d commands, %d target changes, %d clears (%d merged, %d dropped), %d culled, %s\n",
+			graph.GetCommandCount(), statistics.TargetChanges, statistics.Clears, statistics.MergedClears, statistics.DroppedClears,
+			statistics.CulledPasses, ok ? "as expected" : "FAILED");
+		return ok;
+	}
+
+	bool CheckCaching() {
+		FrameGraph graph;
+		FrameGraphRecorder recorder;
+		FrameGraphClearValue clear = MakeClearValue(0.5f);
+		DeclareEyeFrameGraph(Size2i{ 1000, 800 }, 4, false, false, &clear, &clear, graph);
+		bool ok = graph.Compile();
+
+		// Only the clear value differs, which the cached schedule picks up when executed.
+		clear = MakeClearValue(0.25f);
+		DeclareEyeFrameGraph(Size2i{ 1000, 800 }, 4, false, false, &clear, &clear, graph);
+		ok = ok && !graph.Compile();
+		graph.Execute(recorder);
+		ok = ok && recorder.GetClearValues().size() == 2 && recorder.GetClearValues()[0].Color[0] == 0.25f;
+
+		DeclareEyeFrameGraph(Size2i{ 1000, 800 }, 4, true, false, &clear, &clear, graph);
+		ok = ok && graph.Compile();
+		DeclareEyeFrameGraph(Size2i{ 1000, 800 }, 4, true, false, &clear, nullptr, graph);
+		ok = ok && graph.Compile() && graph.GetStatistics().Clears == 1;
+		ok = ok && graph.GetStatistics().Compilations == 3 && graph.GetStatistics().CacheHits == 1;
+		std::printf("Caching: %llu compilations, %llu cached, %s\n", graph.GetStatistics().Compilations, graph.GetStatistics().CacheHits,
+			ok ? "as expected" : "FAILED");
+		return ok;
+	}
+
+	// A declared use of a random graph, to run it in the declared order.
+	struct TestUse {
+		int Resource;
+		bool Write;
+		bool Keep;
+	};
+
+	// Contents are labeled by the use that wrote them, or with ClearedBy added, cleared them.
+	const int UsesPerPass = 4;
+	const int ClearedBy = 1 << 20;
+
+	int GetWriteLabel(int pass, int use) {
+		return pass * UsesPerPass + use + 1;
+	}
+
+	bool CheckRandomGraph(unsigned int& random, int& outCulled) {
+		const int maxResources = 8;
+		int resourceCount = 3 + static_cast<int>(NextRandom(random) * (maxResources - 3));
+		int passCount = 2 + static_cast<int>(NextRandom(random) * 10);
+		std::vector<RenderTargetDesc> descs(resourceCount);
+		for (int resource = 0; resource < resourceCount; resource++) {
+			RenderTargetDesc& desc = descs[resource];
+			desc.Size.w = 64;
+			desc.Size.h = 64;
+			desc.Format = NextRandom(random) < 0.2f ? RenderTargetFormat_DepthStencil : RenderTargetFormat_Color;
+			desc.SampleCount = NextRandom(random) < 0.4f ? 4 : 1;
+			desc.BindFlags = desc.Format == RenderTargetFormat_DepthStencil ? RenderTargetBind_DepthStencil : RenderTargetBind_RenderTarget | RenderTargetBind_ShaderResource;
+		}
+
+		// Declare it, and run it as declared.
+		FrameGraph graph;
+		graph.Reset();
+		for (int resource = 0; resource < resourceCount; resource++) {
+			graph.AddResource(descs[resource]);
+		}
+		std::vector<std::vector<TestUse> > passes(passCount);
+		std::vector<std::vector<int> > expected(passCount);
+		std::vector<int> contents(resourceCount, 0);
+		std::vector<bool> pendingClear(resourceCount, false);
+		for (int pass = 0; pass < passCount; pass++) {
+			while (NextRandom(random) < 0.3f) {
+				int resource = static_cast<int>(NextRandom(random) * resourceCount);
+				graph.ClearTarget(resource, MakeClearValue(NextRandom(random)));
+				pendingClear[resource] = true;
+			}
+
+			graph.AddPass("Random");
+			int useCount = 1 + static_cast<int>(NextRandom(random) * (UsesPerPass - 1));
+			for (int use = 0; use < useCount; use++) {
+				TestUse testUse;
+				testUse.Resource = static_cast<int>(NextRandom(random) * resourceCount);
+				bool taken = false;
+				for (size_t other = 0; other < passes[pass].size(); other++) {
+					taken = taken || passes[pass][other].Resource == testUse.Resource;
+				}
+				if (taken) {
+					continue;
+				}
+				testUse.Write = descs[testUse.Resource].Format == RenderTargetFormat_DepthStencil || NextRandom(random) < 0.5f;
+				testUse.Keep = NextRandom(random) < 0.7f;
+				int label = GetWriteLabel(pass, static_cast<int>(passes[pass].size()));
+				passes[pass].push_back(testUse);
+
+				int& content = contents[testUse.Resource];
+				if (testUse.Write) {
+					graph.WriteTarget(pass, testUse.Resource, testUse.Keep ? FrameGraphLoad_Keep : FrameGraphLoad_DontCare);
+					if (pendingClear[testUse.Resource] && testUse.Keep) {
+						content = label + ClearedBy;
+					}
+					pendingClear[testUse.Resource] = false;
+					expected[pass].push_back(testUse.Keep ? content : -1);
+					content = label;
+				}
+				else {
+					graph.ReadTexture(pass, testUse.Resource);
+					expected[pass].push_back(content);
+				}
+			}
+		}
+		std::vector<int> outputs;
+		std::vector<int> expectedOutputs;
+		for (int resource = 0; resource < resourceCount; resource++) {
+			if (descs[resource].Format == RenderTargetFormat_Color && (outputs.empty() || NextRandom(random) < 0.3f)) {
+				graph.ReadOutput(resource);
+				outputs.push_back(resource);
+				expectedOutputs.push_back(contents[resource]);
+			}
+		}
+		if (outputs.empty()) {
+			return true;
+		}
+		graph.Compile();
+		if (!IsValid(graph, outputs)) {
+			return false;
+		}
+
+		// Run the schedule: the passes that are left have to see the same.
+		contents.assign(graph.GetResourceCount(), 0);
+		for (int i = 0; i < graph.GetCommandCount(); i++) {
+			const FrameGraphCommand& command = graph.GetCommand(i);
+			if (command.Type == FrameGraphCommand_Clear) {
+				for (size_t use = 0; use < passes[command.Pass].size(); use++) {
+					if (passes[command.Pass][use].Write && passes[command.Pass][use].Resource == command.Resource) {
+						contents[command.Resource] = GetWriteLabel(command.Pass, static_cast<int>(use)) + ClearedBy;
+					}
+				}
+			}
+			else if (command.Type == FrameGraphCommand_Resolve) {
+				contents[command.Resource] = contents[command.Source];
+			}
+			else if (command.Type == FrameGraphCommand_Pass) {
+				for (size_t use = 0; use < passes[command.Pass].size(); use++) {
+					const TestUse& testUse = passes[command.Pass][use];
+					int& content = contents[graph.GetPassUse(command.Pass, static_cast<int>(use)).Resource];
+					int seen = testUse.Write && !testUse.Keep ? -1 : content;
+					if (seen != expected[command.Pass][use]) {
+						return false;
+					}
+					if (testUse.Write) {
+						content = GetWriteLabel(command.Pass, static_cast<int>(use));
+					}
+				}
+			}
+		}
+		for (size_t output = 0; output < outputs.size(); output++) {
+			if (contents[graph.GetOutputResource(outputs[output])] != expectedOutputs[output]) {
+				return false;
+			}
+		}
+		outCulled += graph.GetStatistics().CulledPasses;
+		return true;
+	}
+}
+
+bool RunFrameGraphBenchmark(unsigned int iterations) {
+	bool passed = CheckKnownGraph();
+	passed = CheckEyeGraphs() && passed;
+	passed = CheckCaching() && passed;
+
+	{
+		unsigned int random = 4711;
+		int graphs = 1000;
+		int culled = 0;
+		bool ok = true;
+		for (int i = 0; i < graphs && ok; i++) {
+			ok = CheckRandomGraph(random, culled);
+		}
+		std::printf("Random graphs: %d, %d passes culled, %s\n", graphs, culled, ok ? "same contents as declared" : "FAILED");
+		passed = passed && ok;
+	}
+
+	// A frame's worth of graph work on the CPU, as the devices do it.
+	FrameGraph graph;
+	FrameGraphRecorder recorder;
+	FrameGraphClearValue clear = MakeClearValue(0.5f);
+	Size2i eyeTextureSize = { 2364, 1464 };
+	for (int compile = 0; compile < 2; compile++) {
+		auto start = ReadClock();
+		for (unsigned int i = 0; i < iterations; i++) {
+			DeclareEyeFrameGraph(eyeTextureSize, 4, compile != 0 && (i & 1) != 0, false, &clear, &clear, graph);
+			graph.Compile();
+			recorder.Reset();
+			graph.Execute(recorder);
+		}
+		double seconds = ClockTicksToSeconds(ReadClock() - start);
+		std::printf("Declare, compile and execute%s: %.3f us\n", compile != 0 ? ", compiling every frame" : ", cached",
+			iterations > 0 ? seconds * 1e6 / iterations : 0.0);
+	}
+
+	return passed;
+}
@@ -0,0 +1,224 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#include "Benchmarks.h"
+#include "Clock.h"
+#include "FrameLoop.h"
+#include "FrameScheduler.h"
+#include "JobSystem.h"
+#include "NullRenderDevice.h"
+#include "SimulatedHmd.h"
+#include "TripleBuffer.h"
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+/*
+	FramePacer against made-up frame times on a FakeVsyncClock at the DK2's 75 Hz. A light load
+	has to make every vsync with no jitter. A load too heavy for one vsync makes the policies part
+	ways: reprojecting keeps missing deadlines, dropping gives vsyncs up instead and makes the
+	rest. Spikes nobody could have seen coming are missed either way.
+
+	Then the frame loop runs paced on the scheduler's render thread, still on the fake clock,
+	while this thread publishes states as fast as it can: every state the render thread gets has
+	to be complete and newer than the last, and the simulated HMD has to be told each frame's
+	vsync. Last, handing a state over through the TripleBuffer is timed against copying it in and
+	out under a mutex.
+*/
+
+namespace {
+	const double RefreshRate = 75.0;
+	const unsigned int TraceFrames = 300;
+	const unsigned int ScheduledFrames = 200;
+
+	struct Load {
+		const char* Name;
+		double FrameTime; // Seconds
+		double SpikeTime; // Every SpikeInterval-th frame instead, if not 0
+		unsigned int SpikeInterval;
+	};
+
+	FramePacer RunTrace(const Load& load, LateFramePolicy policy) {
+		FramePacer::Settings settings = FramePacer::GetDefaultSettings(RefreshRate);
+		settings.Policy = policy;
+		FramePacer pacer(settings);
+		FakeVsyncClock clock(0.0);
+		for (unsigned int frame = 0; frame < TraceFrames; frame++) {
+			PacedFrame paced = pacer.BeginFrame(clock.GetTime());
+			clock.WaitUntil(paced.StartTime);
+			bool spike = load.SpikeInterval != 0 && frame % load.SpikeInterval == load.SpikeInterval - 1;
+			clock.Advance(spike ? load.SpikeTime : load.FrameTime);
+			pacer.EndFrame(clock.GetTime());
+		}
+		return pacer;
+	}
+
+	bool CheckTraces() {
+		const Load Light = { "light", 0.005, 0.0, 0 };
+		const Load Heavy = { "heavy", 0.018, 0.0, 0 };
+		const Load Spikes = { "spikes", 0.005, 0.030, 10 };
+		const Load* const Loads[] = { &Light, &Heavy, &Spikes };
+		bool passed = true;
+		for (int i = 0; i < 3; i++) {
+			const Load& load = *Loads[i];
+			FramePacer paced[LateFramePolicyCount];
+			for (int policy = 0; policy < LateFramePolicyCount; policy++) {
+				paced[policy] = RunTrace(load, static_cast<LateFramePolicy>(policy));
+				const FramePacer::Statistics& statistics = paced[policy].GetStatistics();
+				std::printf("  %-6s %-9s: %3llu missed deadlines, %3llu vsyncs dropped, %3llu repeated, %6.3f ms jitter\n", load.Name,
+					GetLateFramePolicyName(static_cast<LateFramePolicy>(policy)), statistics.MissedDeadlines, statistics.DroppedVsyncs,
+					statistics.RepeatedVsyncs, paced[policy].GetJitter() * 1000.0);
+			}
+			const FramePacer::Statistics& reprojected = paced[LateFramePolicy_Reproject].GetStatistics();
+			const FramePacer::Statistics& dropped = paced[LateFramePolicy_Drop].GetStatistics();
+			bool expected = reprojected.Frames == TraceFrames && dropped.Frames == TraceFrames && reprojected.DroppedVsyncs == 0;
+			if (&load == &Light) {
+				for (int policy = 0; policy < LateFramePolicyCount; policy++) {
+					const FramePacer::Statistics& statistics = paced[policy].GetStatistics();
+					expected = expected && statistics.MissedDeadlines == 0 && statistics.DroppedVsyncs == 0 && statistics.RepeatedVsyncs == 0 &&
+						paced[policy].GetJitter() < 1e-6;
+				}
+			}
+			else if (&load == &Heavy) {
+				// Only the first frame, before there is anything to estimate from, may miss when dropping.
+				expected = expected && reprojected.MissedDeadlines > TraceFrames / 4 && dropped.MissedDeadlines <= 1 && dropped.DroppedVsyncs > 0;
+			}
+			else {
+				unsigned int spikes = TraceFrames / load.SpikeInterval;
+				expected = expected && reprojected.MissedDeadlines == spikes && dropped.MissedDeadlines == spikes &&
+					paced[LateFramePolicy_Reproject].GetJitter() > 0.001;
+			}
+			if (!expected) {
+				std::printf("  Unexpected pacing of the %s load\n", load.Name);
+				passed = false;
+			}
+		}
+		return passed;
+	}
+
+	// The frame loop on the scheduler's render thread, with states published as fast as possible.
+	bool CheckScheduler() {
+		PoseScript script;
+		SimulatedHmd hmd(script);
+		StereoSetup setup = CreateStereoSetup(hmd, 1.0f);
+		NullRenderDevice device(setup.RenderTargetSize, 1);
+		Scene scene;
+		AddDefaultSceneContent(scene);
+		device.SetSceneVertices(&scene.GetVertices()[0], static_cast<unsigned int>(scene.GetVertices().size()));
+		JobSystem jobs(1);
+
+		FakeVsyncClock clock(0.0);
+		FrameScheduler scheduler(clock, FramePacer::GetDefaultSettings(hmd.GetRefreshRate()));
+		setup.SubmitClock = &clock;
+		unsigned int frames = 0;
+		unsigned long long lastTick = 0;
+		unsigned long long statesSeen = 0;
+		bool consistent = true;
+		scheduler.Start([&](const SimulationState& state, const PacedFrame& frame) -> double {
+			if (state.ProfileRequests != ~state.RecenterRequests || state.RecenterRequests != static_cast<unsigned int>(state.Tick) ||
+				state.Tick < lastTick) {
+				consistent = false;
+			}
+			statesSeen += state.Tick != lastTick ? 1 : 0;
+			lastTick = state.Tick;
+
+			setup.FrameIndex = static_cast<unsigned int>(frame.Vsync);
+			clock.Advance(0.004);
+			RenderFrame(hmd, device, setup, scene, jobs);
+			if (hmd.GetFrameIndex() != frame.Vsync + 1 || setup.SubmitTime != clock.GetTime()) {
+				consistent = false;
+			}
+			// Let the simulation have a turn, drawing for real would leave it plenty.
+			std::this_thread::yield();
+			if (++frames == ScheduledFrames) {
+				scheduler.RequestStop();
+			}
+			return setup.SubmitTime;
+		});
+		while (!scheduler.IsStopping()) {
+			SimulationState& state = scheduler.GetState();
+			state.RecenterRequests = static_cast<unsigned int>(state.Tick);
+			state.ProfileRequests = ~state.RecenterRequests;
+			scheduler.Publish();
+			std::this_thread::yield();
+		}
+		scheduler.Stop();
+
+		FramePacer::Statistics statistics = scheduler.GetStatistics();
+		std::printf("  Scheduler: %llu frames, %llu missed deadlines, %llu states published, %llu new ones rendered\n", statistics.Frames,
+			statistics.MissedDeadlines, scheduler.GetState().Tick, statesSeen);
+		if (!consistent) {
+			std::printf("  The render thread got a torn or stale state, or the HMD the wrong frame\n");
+		}
+		return consistent && statistics.Frames == ScheduledFrames && statistics.MissedDeadlines == 0;
+	}
+}
+
+bool RunFramePacingBenchmark(unsigned int iterations) {
+	bool passed = CheckTraces();
+	passed = CheckScheduler() && passed;
+
+	// One thread playing both sides, so this is only what the handoff itself costs.
+	SimulationState state;
+	std::memset(&state, 0, sizeof(state));
+	unsigned long long checksum = 0;
+	TripleBuffer<SimulationState> buffer;
+	auto start = ReadClock();
+	for (unsigned int i = 0; i < iterations; i++) {
+		state.Tick = i;
+		buffer.GetWriteBuffer() = state;
+		buffer.Publish();
+		buffer.Update();
+		checksum += buffer.GetReadBuffer().Tick;
+	}
+	double tripleSeconds = ClockTicksToSeconds(ReadClock() - start);
+
+	std::mutex mutex;
+	SimulationState shared = state;
+	SimulationState read = state;
+	start = ReadClock();
+	for (unsigned int i = 0; i < iterations; i++) {
+		state.Tick = i;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			shared = state;
+		}
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			read = shared;
+		}
+		checksum += read.Tick;
+	}
+	double mutexSeconds = ClockTicksToSeconds(ReadClock() - start);
+
+	if (iterations > 0) {
+		std::printf("Handoff: %.1f ns with a triple buffer, %.1f ns under a mutex\n", tripleSeconds * 1e9 / iterations, mutexSeconds * 1e9 / iterations);
+	}
+	std::printf("Checksum: %llu\n", checksum);
+	return passed;
+}
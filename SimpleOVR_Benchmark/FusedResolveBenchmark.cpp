@@ -0,0 +1,166 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#include "Benchmarks.h"
+#include "Clock.h"
+#include "FrameGraph.h"
+#include "FrameLoop.h"
+#include "JobSystem.h"
+#include "NullRenderDevice.h"
+#include "Scene.h"
+#include "SimulatedHmd.h"
+#include "SoftwareRenderDevice.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+/*
+	Fusing the MSAA resolve into the distortion. Drawn by the software device, the display has to
+	come out as it does with a separate resolve, give or take the rounding of the averaged samples
+	the fused resolve skips. On the null device a fused frame must not resolve at all, the
+	distortion has to read the same texels with all their samples, and the targets have to shrink
+	by the intermediary.
+
+	Then the eye texture traffic and memory of both ways are compared, and the software device is
+	timed drawing frames both ways. On the CPU, without a GPU's texture caches, reading every
+	sample for every lookup costs more than resolving once; what fusing saves is GPU bandwidth.
+*/
+
+namespace {
+	const int MultisampleCount = 4;
+	const unsigned int SoftwareFrames = 4;
+	const unsigned int CountedFrames = 100;
+	const int MaxFusedDifference = 1;
+
+	struct Traffic {
+		unsigned long long ResolveBytes; // Per frame
+		unsigned long long DistortionBytes;
+		unsigned long long TargetBytes;
+		bool Fused;
+	};
+
+	// The first frames of the default pose script distorted on the software device. Returns the
+	// seconds per frame, leaving out the first, which resolves separately either way.
+	double RenderDistorted(bool fused, const Scene& scene, Image& outDisplay) {
+		PoseScript script;
+		SimulatedHmd hmd(script);
+		StereoSetup setup = CreateStereoSetup(hmd, 1.0f);
+		setup.OwnDistortion = true;
+		setup.FusedResolve = fused;
+		JobSystem jobs(JobSystem::GetHardwareThreadCount());
+		SoftwareRenderDevice device(hmd.GetResolution(), setup.RenderTargetSize, MultisampleCount, jobs);
+		device.SetSceneVertices(&scene.GetVertices()[0], static_cast<unsigned int>(scene.GetVertices().size()));
+
+		RenderFrame(hmd, device, setup, scene, jobs);
+		auto start = ReadClock();
+		for (unsigned int frame = 1; frame < SoftwareFrames; frame++) {
+			RenderFrame(hmd, device, setup, scene, jobs);
+		}
+		double seconds = ClockTicksToSeconds(ReadClock() - start);
+		outDisplay = device.GetDisplayImage();
+		return seconds / (SoftwareFrames - 1);
+	}
+
+	Traffic CountTraffic(bool fused, const Scene& scene) {
+		PoseScript script;
+		SimulatedHmd hmd(script);
+		StereoSetup setup = CreateStereoSetup(hmd, 1.0f);
+		setup.OwnDistortion = true;
+		setup.FusedResolve = fused;
+		JobSystem jobs(1);
+		NullRenderDevice device(setup.RenderTargetSize, MultisampleCount);
+		device.SetSceneVertices(&scene.GetVertices()[0], static_cast<unsigned int>(scene.GetVertices().size()));
+
+		RenderFrame(hmd, device, setup, scene, jobs);
+		NullRenderDevice::Statistics first = device.GetStatistics();
+		for (unsigned int frame = 1; frame < CountedFrames; frame++) {
+			RenderFrame(hmd, device, setup, scene, jobs);
+		}
+		const NullRenderDevice::Statistics& statistics = device.GetStatistics();
+		RenderTargetPlan plan;
+		device.GetFrameGraph().BuildTargetPlan(plan);
+
+		Traffic traffic;
+		traffic.ResolveBytes = (statistics.ResolveBytes - first.ResolveBytes) / (CountedFrames - 1);
+		traffic.DistortionBytes = (statistics.DistortionBytes - first.DistortionBytes) / (CountedFrames - 1);
+		traffic.TargetBytes = plan.GetStatistics().AllocatedBytes;
+		traffic.Fused = device.IsResolveFused();
+		return traffic;
+	}
+
+	void PrintTraffic(const char* name, const Traffic& traffic) {
+		std::printf("%s: %llu KB resolved, %llu KB sampled, %llu KB in all per frame; %llu KB of targets\n", name, traffic.ResolveBytes / 1024,
+			traffic.DistortionBytes / 1024, (traffic.ResolveBytes + traffic.DistortionBytes) / 1024, traffic.TargetBytes / 1024);
+	}
+}
+
+bool RunFusedResolveBenchmark(unsigned int iterations) {
+	bool passed = true;
+	Scene scene;
+	AddDefaultSceneContent(scene);
+
+	Traffic separate = CountTraffic(false, scene);
+	Traffic fused = CountTraffic(true, scene);
+	PrintTraffic("Separate resolve", separate);
+	PrintTraffic("Fused resolve", fused);
+	PoseScript script;
+	SimulatedHmd hmd(script);
+	StereoSetup setup = CreateStereoSetup(hmd, 1.0f);
+	RenderTargetDesc intermediary = { setup.RenderTargetSize, RenderTargetFormat_Color, 1, RenderTargetBind_RenderTarget | RenderTargetBind_ShaderResource };
+	bool countsPassed = fused.Fused && !separate.Fused && fused.ResolveBytes == 0 && separate.ResolveBytes > 0 &&
+		fused.DistortionBytes == separate.DistortionBytes * MultisampleCount &&
+		fused.TargetBytes + GetRenderTargetBytes(intermediary) == separate.TargetBytes;
+	if (!countsPassed) {
+		std::printf("  FAILED: the fused resolve doesn't save what it should\n");
+		passed = false;
+	}
+
+	// The software device: the same display both ways, apart from rounding.
+	Image separateDisplay;
+	Image fusedDisplay;
+	double separateSeconds = RenderDistorted(false, scene, separateDisplay);
+	double fusedSeconds = RenderDistorted(true, scene, fusedDisplay);
+	int maxDifference = 0;
+	unsigned long long differing = 0;
+	for (size_t i = 0; i < separateDisplay.Pixels.size(); i++) {
+		for (int shift = 0; shift < 24; shift += 8) {
+			int difference = std::abs(static_cast<int>((separateDisplay.Pixels[i] >> shift) & 0xff) - static_cast<int>((fusedDisplay.Pixels[i] >> shift) & 0xff));
+			maxDifference = std::max(maxDifference, difference);
+			if (difference > 0) {
+				differing++;
+				break;
+			}
+		}
+	}
+	std::printf("Software display: %llu of %u pixels differ, by up to %d\n", differing, static_cast<unsigned int>(separateDisplay.Pixels.size()), maxDifference);
+	if (maxDifference > MaxFusedDifference) {
+		std::printf("  FAILED: the fused resolve changes the image\n");
+		passed = false;
+	}
+	std::printf("Software frames: %.2f ms with a separate resolve, %.2f ms fused\n", separateSeconds * 1e3, fusedSeconds * 1e3);
+	return passed;
+}
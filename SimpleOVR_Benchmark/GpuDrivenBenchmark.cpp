@@ -0,0 +1,190 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#include "Benchmarks.h"
+#include "Clock.h"
+#include "FrameLoop.h"
+#include "JobSystem.h"
+#include "NullRenderDevice.h"
+#include "SimulatedHmd.h"
+#include "VrMath.h"
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+/*
+	GPU driven drawing against drawing object by object, see RenderDevice::SetSceneInstances.
+	Scenes of 1k, 10k and 100k objects using two meshes are rendered on two NullRenderDevices,
+	one frame loop drawing object by object and one GPU driven, with the same head movement.
+
+	Every frame the instances the device cull listed have to be exactly the objects the frame
+	loop's own cull found, each in its mesh's part of the list, and both devices have to draw the
+	same instances and vertices. The scene is uploaded once, and again after an object moves.
+
+	The GPU driven frame is timed both with and without the null device's cull, which a real
+	device runs on the GPU: what is left is what the CPU still pays per frame.
+*/
+
+namespace {
+	const unsigned int ObjectCounts[] = { 1000, 10000, 100000 };
+
+	float NextRandom(unsigned int& state) {
+		state = state * 1664525u + 1013904223u;
+		return (state >> 8) * (1.0f / 16777216.0f);
+	}
+
+	// Times the cull the GPU would do.
+	class TimedCullDevice : public NullRenderDevice {
+	public:
+		TimedCullDevice(Size2i eyeTextureSize) : NullRenderDevice(eyeTextureSize, 1), CullSeconds(0.0) {
+		}
+
+		void CullSceneInstances(const Frustum& frustum) {
+			auto start = ReadClock();
+			NullRenderDevice::CullSceneInstances(frustum);
+			CullSeconds += ClockTicksToSeconds(ReadClock() - start);
+		}
+
+		double CullSeconds;
+	};
+
+	void BuildScene(unsigned int objectCount, Scene& scene) {
+		AddDefaultSceneContent(scene);
+		const Vertex quad[] = {
+			{ { -0.5f, -0.5f, 0.0f } }, { { 0.5f, -0.5f, 0.0f } }, { { 0.5f, 0.5f, 0.0f } },
+			{ { -0.5f, -0.5f, 0.0f } }, { { 0.5f, 0.5f, 0.0f } }, { { -0.5f, 0.5f, 0.0f } }
+		};
+		int quadMesh = scene.AddMesh(quad, 6);
+		unsigned int state = 4242;
+		const Vector3 up = { 0.0f, 1.0f, 0.0f };
+		while (scene.GetObjectCount() < objectCount) {
+			Vector3 position = { (NextRandom(state) * 2.0f - 1.0f) * 50.0f, (NextRandom(state) * 2.0f - 1.0f) * 10.0f, (NextRandom(state) * 2.0f - 1.0f) * 50.0f };
+			int mesh = NextRandom(state) < 0.5f ? 0 : quadMesh;
+			unsigned int object = scene.AddObject(mesh, position, QuaternionFromAxisAngle(up, NextRandom(state) * 6.2831853f), 0.5f + NextRandom(state));
+			scene.SetObjectMaterial(object, static_cast<int>(NextRandom(state) * MaxMaterials) % MaxMaterials);
+		}
+	}
+
+	// The visible instances the device listed, which have to be in their mesh's part of the list.
+	bool GetListedInstances(const NullRenderDevice& device, unsigned int instanceMultiplier, std::vector<unsigned int>& outListed) {
+		const std::vector<SceneInstance>& instances = device.GetSceneInstances();
+		const std::vector<IndirectDrawArgs>& draws = device.GetCulledDraws();
+		const std::vector<unsigned int>& visible = device.GetVisibleInstances();
+		outListed.clear();
+		for (size_t mesh = 0; mesh < draws.size(); mesh++) {
+			for (unsigned int i = 0; i < draws[mesh].InstanceCount / instanceMultiplier; i++) {
+				unsigned int instance = visible[draws[mesh].StartInstanceLocation + i];
+				if (instance >= instances.size() || instances[instance].Mesh != mesh) {
+					return false;
+				}
+				outListed.push_back(instance);
+			}
+		}
+		std::sort(outListed.begin(), outListed.end());
+		return true;
+	}
+}
+
+bool RunGpuDrivenBenchmark(unsigned int iterations) {
+	bool passed = true;
+	unsigned int frameCount = iterations / 20000 + 1;
+	std::printf("%u frames, %d hardware threads\n", frameCount, JobSystem::GetHardwareThreadCount());
+	JobSystem jobs(JobSystem::GetHardwareThreadCount());
+
+	const StereoMode modes[] = { StereoMode_MultiPass, StereoMode_Instanced };
+	for (int m = 0; m < 2; m++) {
+		std::printf("%s:\n", modes[m] == StereoMode_Instanced ? "Instanced" : "Multi-pass");
+		unsigned int instanceMultiplier = modes[m] == StereoMode_Instanced ? EyeCount : 1;
+		for (size_t c = 0; c < sizeof(ObjectCounts) / sizeof(ObjectCounts[0]); c++) {
+			Scene scene;
+			BuildScene(ObjectCounts[c], scene);
+
+			PoseScript objectScript;
+			SimulatedHmd objectHmd(objectScript);
+			StereoSetup objectSetup = CreateStereoSetup(objectHmd, 1.0f);
+			objectSetup.Mode = modes[m];
+			NullRenderDevice objectDevice(objectSetup.RenderTargetSize, 1);
+			objectDevice.SetSceneVertices(&scene.GetVertices()[0], static_cast<unsigned int>(scene.GetVertices().size()));
+
+			PoseScript gpuScript;
+			SimulatedHmd gpuHmd(gpuScript);
+			StereoSetup gpuSetup = CreateStereoSetup(gpuHmd, 1.0f);
+			gpuSetup.Mode = modes[m];
+			gpuSetup.GpuDriven = true;
+			TimedCullDevice gpuDevice(gpuSetup.RenderTargetSize);
+			gpuDevice.SetSceneVertices(&scene.GetVertices()[0], static_cast<unsigned int>(scene.GetVertices().size()));
+
+			// Once untimed, for the scratch buffers and the upload.
+			RenderFrame(objectHmd, objectDevice, objectSetup, scene, jobs);
+			RenderFrame(gpuHmd, gpuDevice, gpuSetup, scene, jobs);
+
+			// Checked frame by frame, timed separately below.
+			bool sameVisible = true;
+			unsigned long long visibleCount = 0;
+			std::vector<unsigned int> objectVisible;
+			std::vector<unsigned int> listed;
+			for (unsigned int frame = 0; frame < frameCount; frame++) {
+				RenderFrame(objectHmd, objectDevice, objectSetup, scene, jobs);
+				RenderFrame(gpuHmd, gpuDevice, gpuSetup, scene, jobs);
+				objectVisible = objectSetup.VisibleObjects;
+				std::sort(objectVisible.begin(), objectVisible.end());
+				sameVisible = sameVisible && GetListedInstances(gpuDevice, instanceMultiplier, listed) && listed == objectVisible;
+				visibleCount += objectVisible.size();
+			}
+			const NullRenderDevice::Statistics& objectStatistics = objectDevice.GetStatistics();
+			const NullRenderDevice::Statistics& gpuStatistics = gpuDevice.GetStatistics();
+			bool sameDraws = objectStatistics.Instances == gpuStatistics.Instances && objectStatistics.Vertices == gpuStatistics.Vertices;
+
+			// Uploaded by the first frame only, until an object moves.
+			bool uploadedOnce = gpuStatistics.InstanceUploads == 1;
+			scene.SetObjectTransform(0, scene.GetObjectPosition(0), QuaternionIdentity(), 1.0f);
+			RenderFrame(gpuHmd, gpuDevice, gpuSetup, scene, jobs);
+			uploadedOnce = uploadedOnce && gpuDevice.GetStatistics().InstanceUploads == 2;
+
+			auto start = ReadClock();
+			for (unsigned int frame = 0; frame < frameCount; frame++) {
+				RenderFrame(objectHmd, objectDevice, objectSetup, scene, jobs);
+			}
+			double objectSeconds = ClockTicksToSeconds(ReadClock() - start);
+			gpuDevice.CullSeconds = 0.0;
+			start = ReadClock();
+			for (unsigned int frame = 0; frame < frameCount; frame++) {
+				RenderFrame(gpuHmd, gpuDevice, gpuSetup, scene, jobs);
+			}
+			double gpuSeconds = ClockTicksToSeconds(ReadClock() - start);
+			double cpuSeconds = gpuSeconds - gpuDevice.CullSeconds;
+
+			std::printf("  %6u objects: object by object %8.1f us/frame, GPU driven %8.1f us/frame, %6.1f us without the device cull (%.1fx), %.0f visible, %s\n",
+				ObjectCounts[c], objectSeconds * 1e6 / frameCount, gpuSeconds * 1e6 / frameCount, cpuSeconds * 1e6 / frameCount,
+				cpuSeconds > 0.0 ? objectSeconds / cpuSeconds : 0.0, static_cast<double>(visibleCount) / frameCount,
+				!sameVisible ? "FAILED, culled differently" : !sameDraws ? "FAILED, drew differently" : !uploadedOnce ? "FAILED, uploaded when unchanged" : "same instances drawn");
+			passed = passed && sameVisible && sameDraws && uploadedOnce;
+		}
+	}
+
+	return passed;
+}
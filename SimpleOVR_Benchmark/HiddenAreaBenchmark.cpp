@@ -0,0 +1,219 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+
+#include "Benchmarks.h"
+#include "Clock.h"
+#include "Distortion.h"
+#include "FrameLoop.h"
+#include "HiddenArea.h"
+#include "JobSystem.h"
+#include "NullRenderDevice.h"
+#include "Scene.h"
+#include "SimulatedHmd.h"
+#include "SoftwareRenderDevice.h"
+#include "VrMath.h"
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+/*
+	Hidden area masks. Printed is how much of each eye a mask hides for a few lens apertures and
+	FOVs, the simulated HMD's first. On the null device the frame loop has to mask every frame,
+	an eye at a time, as many pixels as the mask's fraction of the viewports.
+
+	The software device then draws a scattered scene with own distortion, timewarp and 4x MSAA
+	with and without the mask. The display has to come out exactly the same, the lookups never
+	reach the hidden area; and the masked eye texture has to be left as it was before the first
+	frame there, neither cleared nor drawn, while the unmasked one isn't. Both are timed.
+*/
+
+namespace {
+	const int MultisampleCount = 4;
+	const unsigned int SoftwareFrames = 4;
+	const unsigned int CountedFrames = 100;
+	const unsigned int SceneObjectCount = 300;
+	const float MaxMaskedPixelError = 0.01f; // Of the viewports, the mask's edges are rounded to pixels
+
+	struct Profile {
+		const char* Name;
+		float MaxRadius;
+		float FovScale;
+	};
+
+	float NextRandom(unsigned int& state) {
+		state = state * 1664525u + 1013904223u;
+		return (state >> 8) * (1.0f / 16777216.0f);
+	}
+
+	float GetProfileFraction(const Profile& profile, int eye) {
+		PoseScript script;
+		SimulatedHmd hmd(script);
+		LensDistortion lens = SimulatedHmd::LensModel;
+		lens.MaxRadius = profile.MaxRadius;
+		FovPort fov = hmd.GetDefaultEyeFov(eye);
+		fov.LeftTan *= profile.FovScale;
+		fov.RightTan *= profile.FovScale;
+		fov.UpTan *= profile.FovScale;
+		fov.DownTan *= profile.FovScale;
+		std::vector<DistortionPoint> points;
+		std::vector<unsigned short> indices;
+		GenerateDistortionMesh(lens, eye, fov, DistortionMeshColumns, DistortionMeshRows, points, indices);
+		HiddenAreaMesh mesh;
+		GenerateHiddenAreaMesh(points, indices, fov, mesh);
+		return GetHiddenAreaFraction(mesh);
+	}
+
+	// The first frames of the default pose script on the software device. Returns the seconds
+	// per frame, leaving out the first.
+	double RenderMasked(bool masked, const Scene& scene, Image& outEyeImage, Image& outDisplay, std::vector<Rect2i>& outMaskedPixels) {
+		PoseScript script;
+		SimulatedHmd hmd(script);
+		StereoSetup setup = CreateStereoSetup(hmd, 1.0f);
+		setup.OwnDistortion = true;
+		setup.Timewarp = true;
+		setup.HiddenAreaMask = masked;
+		JobSystem jobs(JobSystem::GetHardwareThreadCount());
+		SoftwareRenderDevice device(hmd.GetResolution(), setup.RenderTargetSize, MultisampleCount, jobs);
+		device.SetSceneVertices(&scene.GetVertices()[0], static_cast<unsigned int>(scene.GetVertices().size()));
+
+		RenderFrame(hmd, device, setup, scene, jobs);
+		auto start = ReadClock();
+		for (unsigned int frame = 1; frame < SoftwareFrames; frame++) {
+			RenderFrame(hmd, device, setup, scene, jobs);
+		}
+		double seconds = ClockTicksToSeconds(ReadClock() - start);
+		outEyeImage = device.GetImage();
+		outDisplay = device.GetDisplayImage();
+		outMaskedPixels.clear();
+		for (int eye = 0; eye < EyeCount; eye++) {
+			for (size_t i = 0; i < setup.HiddenArea[eye].Rects.size(); i++) {
+				outMaskedPixels.push_back(GetHiddenAreaPixels(setup.HiddenArea[eye].Rects[i], setup.EyeRenderViewport[eye]));
+			}
+		}
+		return seconds / (SoftwareFrames - 1);
+	}
+
+	// The pixels of image in rects that aren't 0, as the eye texture starts out.
+	unsigned long long CountTouchedPixels(const Image& image, const std::vector<Rect2i>& rects) {
+		unsigned long long touched = 0;
+		for (size_t i = 0; i < rects.size(); i++) {
+			for (int y = rects[i].Pos.y; y < rects[i].Pos.y + rects[i].Size.h; y++) {
+				for (int x = rects[i].Pos.x; x < rects[i].Pos.x + rects[i].Size.w; x++) {
+					if (image.Pixels[y * image.Size.w + x] != 0) {
+						touched++;
+					}
+				}
+			}
+		}
+		return touched;
+	}
+}
+
+bool RunHiddenAreaBenchmark(unsigned int iterations) {
+	bool passed = true;
+
+	const Profile profiles[] = {
+		{ "Simulated HMD", SimulatedHmd::LensModel.MaxRadius, 1.0f },
+		{ "Wide lens", 1.0f, 1.0f },
+		{ "Narrow lens", 0.75f, 1.0f },
+		{ "Simulated HMD, 80% FOV", SimulatedHmd::LensModel.MaxRadius, 0.8f },
+		{ "Simulated HMD, 120% FOV", SimulatedHmd::LensModel.MaxRadius, 1.2f },
+	};
+	const int profileCount = sizeof(profiles) / sizeof(profiles[0]);
+	for (int p = 0; p < profileCount; p++) {
+		std::printf("%s (lens r %.3f): %.1f%% of the left eye, %.1f%% of the right eye hidden\n", profiles[p].Name, profiles[p].MaxRadius,
+			GetProfileFraction(profiles[p], 0) * 100.0f, GetProfileFraction(profiles[p], 1) * 100.0f);
+	}
+
+	Scene scene;
+	AddDefaultSceneContent(scene);
+	unsigned int state = 1234;
+	const Vector3 up = { 0.0f, 1.0f, 0.0f };
+	for (unsigned int i = 0; i < SceneObjectCount; i++) {
+		Vector3 position = { (NextRandom(state) * 2.0f - 1.0f) * 30.0f, (NextRandom(state) * 2.0f - 1.0f) * 10.0f, (NextRandom(state) * 2.0f - 1.0f) * 30.0f };
+		scene.AddObject(0, position, QuaternionFromAxisAngle(up, NextRandom(state) * 6.2831853f), 0.5f + NextRandom(state));
+	}
+
+	// The null device: every frame masks both eyes.
+	{
+		PoseScript script;
+		SimulatedHmd hmd(script);
+		StereoSetup setup = CreateStereoSetup(hmd, 1.0f);
+		setup.OwnDistortion = true;
+		setup.HiddenAreaMask = true;
+		JobSystem jobs(1);
+		NullRenderDevice device(setup.RenderTargetSize, MultisampleCount);
+		device.SetSceneVertices(&scene.GetVertices()[0], static_cast<unsigned int>(scene.GetVertices().size()));
+		for (unsigned int frame = 0; frame < CountedFrames; frame++) {
+			RenderFrame(hmd, device, setup, scene, jobs);
+		}
+		const NullRenderDevice::Statistics& statistics = device.GetStatistics();
+		float expected = 0.0f;
+		float viewportPixels = 0.0f;
+		for (int eye = 0; eye < EyeCount; eye++) {
+			float pixels = static_cast<float>(setup.EyeRenderViewport[eye].Size.w) * setup.EyeRenderViewport[eye].Size.h;
+			expected += GetHiddenAreaFraction(setup.HiddenArea[eye]) * pixels;
+			viewportPixels += pixels;
+		}
+		float masked = static_cast<float>(statistics.MaskedPixels) / CountedFrames;
+		std::printf("Null device: %llu hidden area draws in %u frames, %.0f pixels masked per frame (%.1f%% of the viewports)\n",
+			statistics.HiddenAreaDraws, CountedFrames, masked, masked / viewportPixels * 100.0f);
+		if (!setup.HiddenAreaAccepted || statistics.HiddenAreaDraws != CountedFrames * EyeCount || std::fabs(masked - expected) > MaxMaskedPixelError * viewportPixels) {
+			std::printf("  FAILED: the frame loop doesn't mask what it should\n");
+			passed = false;
+		}
+	}
+
+	// The software device: the same display either way, and nothing touched behind the mask.
+	Image eyeImages[2];
+	Image displays[2];
+	std::vector<Rect2i> maskedPixels;
+	std::vector<Rect2i> unusedPixels;
+	double unmaskedSeconds = RenderMasked(false, scene, eyeImages[0], displays[0], unusedPixels);
+	double maskedSeconds = RenderMasked(true, scene, eyeImages[1], displays[1], maskedPixels);
+	unsigned long long differing = 0;
+	for (size_t i = 0; i < displays[0].Pixels.size(); i++) {
+		if (displays[0].Pixels[i] != displays[1].Pixels[i]) {
+			differing++;
+		}
+	}
+	unsigned long long unmaskedTouched = CountTouchedPixels(eyeImages[0], maskedPixels);
+	unsigned long long maskedTouched = CountTouchedPixels(eyeImages[1], maskedPixels);
+	std::printf("Software display: %llu of %u pixels differ with the mask\n", differing, static_cast<unsigned int>(displays[0].Pixels.size()));
+	std::printf("Hidden area of the eye texture: %llu pixels drawn without the mask, %llu with it\n", unmaskedTouched, maskedTouched);
+	if (differing != 0) {
+		std::printf("  FAILED: the mask changes the display\n");
+		passed = false;
+	}
+	if (maskedTouched != 0 || unmaskedTouched == 0) {
+		std::printf("  FAILED: the mask doesn't keep the hidden area from being cleared and drawn\n");
+		passed = false;
+	}
+	std::printf("Software frames: %.2f ms without the mask, %.2f ms with it\n", unmaskedSeconds * 1e3, maskedSeconds * 1e3);
+	return passed;
+}
@@ -0,0 +1,170 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#include "Benchmarks.h"
+#include "FrameLoop.h"
+#include "JobSystem.h"
+#include "NullRenderDevice.h"
+#include "Profiler.h"
+#include "SimulatedHmd.h"
+#include "VrMath.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+/*
+	Late latching against the normal frame loop, on NullRenderDevice. The simulated HMD returns the
+	same pose for every query within a frame, so a late latched frame has to end up with exactly
+	the view constants of a normal one, latched for each eye, and draw at least the objects the normal one does (its
+	cull is a bit wider). That includes a scene too large for the constant ring, where late
+	latching has to give up and draw part of the frame early.
+
+	What it is all for is measured with ProfileStage_PoseToSubmit: how long the pose a frame is
+	drawn with has been around when the frame is submitted.
+*/
+
+namespace {
+	const unsigned int SmallObjectCount = 4000; // Fits in the constant ring
+	const unsigned int LargeObjectCount = 30000; // Doesn't
+	const int ThreadCounts[] = { 1, 4 };
+
+	// Deterministic, so every run uses the same scene.
+	float NextRandom(unsigned int& state) {
+		state = state * 1664525u + 1013904223u;
+		return (state >> 8) * (1.0f / 16777216.0f);
+	}
+
+	void CreateScene(Scene& scene, unsigned int objectCount) {
+		AddDefaultSceneContent(scene);
+		unsigned int state = 1234;
+		const Vector3 up = { 0.0f, 1.0f, 0.0f };
+		for (unsigned int i = 0; i < objectCount; i++) {
+			Vector3 position = { (NextRandom(state) * 2.0f - 1.0f) * 30.0f, (NextRandom(state) * 2.0f - 1.0f) * 10.0f, (NextRandom(state) * 2.0f - 1.0f) * 30.0f };
+			scene.AddObject(0, position, QuaternionFromAxisAngle(up, NextRandom(state) * 6.2831853f), 0.5f + NextRandom(state));
+		}
+	}
+
+	struct LatchResult {
+		bool Matched;
+		double PoseToSubmit[2]; // Mean in microseconds, normal and late latched
+		unsigned long long Visible[2];
+		unsigned long long Latches;
+	};
+
+	// Runs both frame loops side by side, comparing each frame.
+	LatchResult RunFrames(const Scene& scene, StereoMode mode, int threadCount, unsigned int frameCount) {
+		PoseScript script;
+		SimulatedHmd hmd[2] = { SimulatedHmd(script), SimulatedHmd(script) };
+		StereoSetup setup[2] = { CreateStereoSetup(hmd[0], 1.0f), CreateStereoSetup(hmd[1], 1.0f) };
+		NullRenderDevice device[2] = { NullRenderDevice(setup[0].RenderTargetSize, 1), NullRenderDevice(setup[1].RenderTargetSize, 1) };
+		JobSystem jobs(threadCount);
+		size_t frameConstantSize = mode == StereoMode_Instanced ? sizeof(StereoConstants) : sizeof(Matrix4);
+
+		LatchResult result;
+		result.Matched = true;
+		for (int i = 0; i < 2; i++) {
+			setup[i].Mode = mode;
+			setup[i].LateLatch = i == 1;
+			device[i].SetSceneVertices(&scene.GetVertices()[0], static_cast<unsigned int>(scene.GetVertices().size()));
+			result.Visible[i] = 0;
+			result.PoseToSubmit[i] = 0.0;
+		}
+
+		Vector3 hmdToEyeViewOffset[EyeCount];
+		for (int eye = 0; eye < EyeCount; eye++) {
+			hmdToEyeViewOffset[eye] = hmd[1].GetEyeRenderDesc(eye).HmdToEyeViewOffset;
+		}
+
+		for (unsigned int frame = 0; frame < frameCount; frame++) {
+			Pose eyePose[EyeCount];
+			hmd[1].GetEyePoses(0, hmdToEyeViewOffset, eyePose);
+
+			for (int i = 0; i < 2; i++) {
+				Profiler::Reset();
+				RenderFrame(hmd[i], device[i], setup[i], scene, jobs);
+				Profiler::Collect();
+				result.PoseToSubmit[i] += Profiler::GetHistogram(ProfileStage_PoseToSubmit).GetMean() / 1000.0 / frameCount;
+				result.Visible[i] += setup[i].VisibleObjects.size();
+			}
+
+			// Each eye's latched matrix has to be the one for the frame's pose.
+			Matrix4 transposedMvp[EyeCount];
+			setup[1].EyeMatrices.Compute(eyePose, transposedMvp);
+			for (int eye = 0; eye < EyeCount; eye++) {
+				const unsigned char* latched = mode == StereoMode_Instanced ? device[1].GetLatchedConstants(0) + eye * sizeof(Matrix4) : device[1].GetLatchedConstants(eye);
+				if (std::memcmp(latched, &transposedMvp[eye], sizeof(Matrix4)) != 0) {
+					result.Matched = false;
+				}
+			}
+
+			// Both lists are in scene order.
+			const std::vector<unsigned int>& normal = setup[0].VisibleObjects;
+			const std::vector<unsigned int>& late = setup[1].VisibleObjects;
+			if (std::memcmp(device[0].GetConstants(ConstantSlot_Frame), device[1].GetConstants(ConstantSlot_Frame), frameConstantSize) != 0 ||
+				!std::includes(late.begin(), late.end(), normal.begin(), normal.end())) {
+				result.Matched = false;
+			}
+		}
+
+		// Every visible object drawn once per eye, or once with both.
+		const NullRenderDevice::Statistics& statistics = device[1].GetStatistics();
+		unsigned long long expectedDraws = mode == StereoMode_Instanced ? result.Visible[1] : result.Visible[1] * EyeCount;
+		if (statistics.Draws != expectedDraws) {
+			result.Matched = false;
+		}
+		result.Latches = statistics.Latches;
+		return result;
+	}
+}
+
+bool RunLateLatchBenchmark(unsigned int iterations) {
+	bool passed = true;
+	unsigned int frameCount = iterations / 20000 + 1;
+	const unsigned int objectCounts[] = { SmallObjectCount, LargeObjectCount };
+	const StereoMode modes[] = { StereoMode_MultiPass, StereoMode_Instanced };
+	std::printf("%u frames, mean pose-to-submit in us\n", frameCount);
+	for (int o = 0; o < 2; o++) {
+		Scene scene;
+		CreateScene(scene, objectCounts[o]);
+		for (int m = 0; m < 2; m++) {
+			for (size_t t = 0; t < sizeof(ThreadCounts) / sizeof(ThreadCounts[0]); t++) {
+				LatchResult result = RunFrames(scene, modes[m], ThreadCounts[t], frameCount);
+				if (!result.Matched) {
+					std::printf("  Late latched frames differ from normal ones\n");
+					passed = false;
+				}
+				std::printf("  %5u objects, %-10s %d threads: %8.1f normal, %8.1f late latched, %.0f/%.0f visible, %llu latches\n",
+					objectCounts[o], modes[m] == StereoMode_Instanced ? "instanced," : "multi-pass,", ThreadCounts[t],
+					result.PoseToSubmit[0], result.PoseToSubmit[1],
+					static_cast<double>(result.Visible[0]) / frameCount, static_cast<double>(result.Visible[1]) / frameCount,
+					result.Latches);
+			}
+		}
+	}
+	return passed;
+}
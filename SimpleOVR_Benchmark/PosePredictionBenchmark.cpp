@@ -0,0 +1,247 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#include "Benchmarks.h"
+#include "Clock.h"
+#include "FrameLoop.h"
+#include "NullRenderDevice.h"
+#include "PosePrediction.h"
+#include "SimulatedHmd.h"
+#include "TrackingLog.h"
+#include "VrMath.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+/*
+	The pose predictors of PosePrediction.h and the tracking log of TrackingLog.h.
+
+	Predicting 20 ms ahead, a head turning and moving at constant speed has to be predicted
+	exactly by every method but PredictionMethod_None, and a head accelerating by
+	ConstantAcceleration. With noise on the measured velocities the filtered method has to be
+	closer on average than ConstantVelocity, which passes the noise on.
+
+	A log recorded by the frame loop with its own prediction is read back, where the poses the
+	frames were drawn with have to be what the same predictor gives when replayed, also with late
+	latching, which samples the poses twice but draws with the second. A log cut off in the
+	middle of a record has to read up to that record.
+*/
+
+namespace {
+	const char* LogPath = "SimpleOVR_PosePredictionBenchmark.bin";
+	const char* TruncatedLogPath = "SimpleOVR_PosePredictionBenchmark_truncated.bin";
+	const double SampleInterval = 0.001; // 1000 Hz, like the DK2's tracker
+	const float PredictionTime = 0.02f;
+	const unsigned int SampleCount = 2000;
+	const float ExactTolerance = 1e-4f; // Radians and meters
+
+	float NextRandom(unsigned int& state) {
+		state = state * 1664525u + 1013904223u;
+		return (state >> 8) * (1.0f / 16777216.0f);
+	}
+
+	// A head turning around a fixed axis and moving in a straight line, optionally speeding up.
+	struct Motion {
+		Vector3 Axis;
+		float AngularVelocity;
+		float AngularAcceleration;
+		Vector3 Direction;
+		float LinearVelocity;
+		float LinearAcceleration;
+
+		PoseState GetState(double time) const {
+			float t = static_cast<float>(time);
+			float angle = AngularVelocity * t + 0.5f * AngularAcceleration * t * t;
+			float distance = LinearVelocity * t + 0.5f * LinearAcceleration * t * t;
+			PoseState state;
+			state.ThePose.Orientation = QuaternionFromAxisAngle(Axis, angle);
+			state.ThePose.Position = Direction * distance;
+			state.AngularVelocity = Axis * (AngularVelocity + AngularAcceleration * t);
+			state.LinearVelocity = Direction * (LinearVelocity + LinearAcceleration * t);
+			state.AngularAcceleration = Axis * AngularAcceleration;
+			state.LinearAcceleration = Direction * LinearAcceleration;
+			state.TimeInSeconds = time;
+			return state;
+		}
+	};
+
+	struct MeanErrors {
+		float Angle;
+		float Distance;
+		float MaxAngle;
+	};
+
+	// Feeds the states one by one and predicts PredictionTime ahead from each.
+	MeanErrors Replay(const Motion& motion, PredictionMethod method, float velocityNoise) {
+		PosePredictor predictor(method, PosePredictor::DefaultSmoothingTime);
+		unsigned int state = 777;
+		MeanErrors errors = { 0.0f, 0.0f, 0.0f };
+		for (unsigned int i = 0; i < SampleCount; i++) {
+			PoseState sample = motion.GetState(i * SampleInterval);
+			Vector3 angularNoise = { NextRandom(state) - 0.5f, NextRandom(state) - 0.5f, NextRandom(state) - 0.5f };
+			Vector3 linearNoise = { NextRandom(state) - 0.5f, NextRandom(state) - 0.5f, NextRandom(state) - 0.5f };
+			sample.AngularVelocity = sample.AngularVelocity + angularNoise * (2.0f * velocityNoise);
+			sample.LinearVelocity = sample.LinearVelocity + linearNoise * (2.0f * velocityNoise);
+			predictor.AddSample(sample);
+
+			double time = sample.TimeInSeconds + PredictionTime;
+			Pose predicted = predictor.Predict(time);
+			PoseState actual = motion.GetState(time);
+			Vector3 offset = predicted.Position - actual.ThePose.Position;
+			float angle = AngleBetween(predicted.Orientation, actual.ThePose.Orientation);
+			errors.Angle += angle / SampleCount;
+			errors.Distance += std::sqrt(Dot(offset, offset)) / SampleCount;
+			errors.MaxAngle = std::max(errors.MaxAngle, angle);
+		}
+		return errors;
+	}
+
+	bool CheckLog(bool lateLatch) {
+		// Recorded by the frame loop, predicting on its own.
+		PoseScript script;
+		SimulatedHmd hmd(script);
+		StereoSetup setup = CreateStereoSetup(hmd, 1.0f);
+		NullRenderDevice device(setup.RenderTargetSize, 1);
+		Scene scene;
+		AddDefaultSceneContent(scene);
+		device.SetSceneVertices(&scene.GetVertices()[0], static_cast<unsigned int>(scene.GetVertices().size()));
+		JobSystem jobs(1);
+		setup.LateLatch = lateLatch;
+		setup.OwnPrediction = true;
+		setup.Predictor = PosePredictor(PredictionMethod_ConstantAcceleration, PosePredictor::DefaultSmoothingTime);
+		TrackingLogWriter writer;
+		const unsigned int frameCount = 200;
+		if (!writer.Open(LogPath)) {
+			std::printf("Tracking log: FAILED, can't create %s\n", LogPath);
+			return false;
+		}
+		setup.TrackingLog = &writer;
+		for (unsigned int frame = 0; frame < frameCount; frame++) {
+			RenderFrame(hmd, device, setup, scene, jobs);
+		}
+		bool written = writer.Close();
+
+		TrackingLog log;
+		bool loaded = written && log.Load(LogPath) && log.GetFrames().size() == frameCount && log.GetSamples().size() > frameCount;
+		bool replayed = loaded;
+		PosePredictor predictor(PredictionMethod_ConstantAcceleration, PosePredictor::DefaultSmoothingTime);
+		unsigned int nextSample = 0;
+		for (size_t i = 0; replayed && i < log.GetFrames().size(); i++) {
+			const TrackedFrame& frame = log.GetFrames()[i];
+			for (; nextSample <= frame.PredictionSample; nextSample++) {
+				predictor.AddSample(log.GetSamples()[nextSample]);
+			}
+			Pose predicted = predictor.Predict(frame.Timing.ScanoutMidpointSeconds);
+			Vector3 offset = predicted.Position - frame.PredictedHeadPose.Position;
+			replayed = frame.Predicted && AngleBetween(predicted.Orientation, frame.PredictedHeadPose.Orientation) < ExactTolerance &&
+				std::sqrt(Dot(offset, offset)) < ExactTolerance;
+		}
+
+		// Cut off two bytes into the last record.
+		bool truncated = false;
+		FILE* in = std::fopen(LogPath, "rb");
+		if (in != nullptr) {
+			std::vector<unsigned char> data(1 << 20);
+			size_t size = std::fread(&data[0], 1, data.size(), in);
+			std::fclose(in);
+			FILE* out = std::fopen(TruncatedLogPath, "wb");
+			if (out != nullptr) {
+				size_t lastRecord = sizeof(unsigned int) + sizeof(PoseState);
+				std::fwrite(&data[0], 1, size - lastRecord + 2, out);
+				std::fclose(out);
+				TrackingLog cut;
+				truncated = cut.Load(TruncatedLogPath) && cut.GetFrames().size() == log.GetFrames().size() &&
+					cut.GetSamples().size() == log.GetSamples().size() - 1;
+			}
+		}
+		std::remove(LogPath);
+		std::remove(TruncatedLogPath);
+
+		std::printf("Tracking log%s: %u frames, %u states, %s\n", lateLatch ? ", late latched" : "", static_cast<unsigned int>(log.GetFrames().size()),
+			static_cast<unsigned int>(log.GetSamples().size()),
+			!loaded ? "FAILED to read back" : !replayed ? "FAILED, replayed predictions differ" : !truncated ? "FAILED to read a truncated log" : "replays the frame loop's predictions");
+		return loaded && replayed && truncated;
+	}
+}
+
+bool RunPosePredictionBenchmark(unsigned int iterations) {
+	bool passed = true;
+	const Vector3 axis = Normalized(Vector3{ 0.2f, 1.0f, 0.1f });
+	const Vector3 direction = Normalized(Vector3{ 1.0f, 0.0f, -0.5f });
+
+	// 120 degrees per second and 0.5 m/s, accelerating by 300 degrees/s^2 and 2 m/s^2.
+	Motion steady = { axis, 2.0944f, 0.0f, direction, 0.5f, 0.0f };
+	Motion accelerating = { axis, 0.0f, 5.236f, direction, 0.0f, 2.0f };
+	std::printf("Mean error predicting %.0f ms ahead, degrees and mm: steady / accelerating / steady with noisy velocities\n", PredictionTime * 1000.0f);
+	MeanErrors results[PredictionMethodCount][3];
+	for (int method = 0; method < PredictionMethodCount; method++) {
+		PredictionMethod predictionMethod = static_cast<PredictionMethod>(method);
+		results[method][0] = Replay(steady, predictionMethod, 0.0f);
+		results[method][1] = Replay(accelerating, predictionMethod, 0.0f);
+		results[method][2] = Replay(steady, predictionMethod, 0.5f);
+		std::printf("  %-12s", GetPredictionMethodName(predictionMethod));
+		for (int motion = 0; motion < 3; motion++) {
+			std::printf("  %7.3f %7.2f", results[method][motion].Angle * 57.29578f, results[method][motion].Distance * 1000.0f);
+		}
+		std::printf("\n");
+	}
+	bool steadyExact = true;
+	for (int method = PredictionMethod_ConstantVelocity; method < PredictionMethodCount; method++) {
+		// Filtered starts from the first state's velocities too, so it is exact from the start.
+		steadyExact = steadyExact && results[method][0].MaxAngle < ExactTolerance && results[method][0].Distance < ExactTolerance;
+	}
+	bool acceleratingExact = results[PredictionMethod_ConstantAcceleration][1].MaxAngle < ExactTolerance &&
+		results[PredictionMethod_ConstantAcceleration][1].Distance < ExactTolerance &&
+		results[PredictionMethod_ConstantVelocity][1].Angle > ExactTolerance;
+	bool filteredSmoother = results[PredictionMethod_Filtered][2].Angle < results[PredictionMethod_ConstantVelocity][2].Angle &&
+		results[PredictionMethod_Filtered][2].Distance < results[PredictionMethod_ConstantVelocity][2].Distance;
+	std::printf("Steady motion %s, acceleration %s, noise %s\n", steadyExact ? "predicted exactly" : "FAILED",
+		acceleratingExact ? "predicted exactly" : "FAILED", filteredSmoother ? "reduced by filtering" : "FAILED, not reduced by filtering");
+	passed = passed && steadyExact && acceleratingExact && filteredSmoother;
+
+	// A state and a prediction per frame is all the frame loop adds.
+	unsigned int runs = std::max(1000u, iterations * 10);
+	float checksum = 0.0f;
+	for (int method = 0; method < PredictionMethodCount; method++) {
+		PosePredictor predictor(static_cast<PredictionMethod>(method), PosePredictor::DefaultSmoothingTime);
+		PoseState sample = steady.GetState(0.0);
+		auto start = ReadClock();
+		for (unsigned int i = 0; i < runs; i++) {
+			sample.TimeInSeconds = i * SampleInterval;
+			predictor.AddSample(sample);
+			checksum += predictor.Predict(sample.TimeInSeconds + PredictionTime).Orientation.w;
+		}
+		double seconds = ClockTicksToSeconds(ReadClock() - start);
+		std::printf("%-12s %6.1f ns per state and prediction\n", GetPredictionMethodName(static_cast<PredictionMethod>(method)), seconds * 1e9 / runs);
+	}
+	std::printf("Checksum: %.0f\n", checksum);
+
+	passed = CheckLog(false) && passed;
+	passed = CheckLog(true) && passed;
+	return passed;
+}
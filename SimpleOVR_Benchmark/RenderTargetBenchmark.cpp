@@ -0,0 +1,202 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#include "Benchmarks.h"
+#include "Clock.h"
+#include "FrameGraph.h"
+#include "RenderTargetPool.h"
+#include <cstdio>
+#include <vector>
+
+/*
+	Planning render targets and keeping them in the pool, see RenderTargetPool.h. A small graph
+	with a known answer is checked first, then every plan (the eye targets in each configuration,
+	and random graphs) has to be valid: targets sharing a texture are created alike and never live
+	at the same time, and the textures take no less than the peak and no more than what was asked
+	for. Switching foveation on and off has to keep the distortion source's texture, and with
+	multisampling create nothing but the foveated resolve target.
+
+	Then planning the eye targets and applying the plan to a pool is timed.
+*/
+
+namespace {
+	const Size2i EyeTextureSize = { 2364, 1464 };
+
+	float NextRandom(unsigned int& state) {
+		state = state * 1664525u + 1013904223u;
+		return (state >> 8) * (1.0f / 16777216.0f);
+	}
+
+	bool IsValid(const RenderTargetPlan& plan) {
+		const RenderTargetPlan::Statistics& statistics = plan.GetStatistics();
+		if (statistics.AllocatedBytes < statistics.PeakBytes || statistics.AllocatedBytes > statistics.RequestedBytes) {
+			return false;
+		}
+		for (int a = 0; a < plan.GetTargetCount(); a++) {
+			if (plan.IsTargetUsed(a) != (plan.GetTexture(a) >= 0)) {
+				return false;
+			}
+			if (!plan.IsTargetUsed(a)) {
+				continue;
+			}
+			if (!(plan.GetTextureDesc(plan.GetTexture(a)) == plan.GetTargetDesc(a))) {
+				return false;
+			}
+			for (int b = a + 1; b < plan.GetTargetCount(); b++) {
+				bool overlap = plan.IsTargetUsed(b) && plan.GetFirstPass(a) <= plan.GetLastPass(b) && plan.GetFirstPass(b) <= plan.GetLastPass(a);
+				if (overlap && plan.GetTexture(a) == plan.GetTexture(b)) {
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+
+	bool CheckKnownPlan() {
+		RenderTargetDesc color = { { 100, 100 }, RenderTargetFormat_Color, 1, RenderTargetBind_RenderTarget | RenderTargetBind_ShaderResource };
+		RenderTargetDesc depth = { { 100, 100 }, RenderTargetFormat_DepthStencil, 1, RenderTargetBind_DepthStencil };
+		RenderTargetPlan plan;
+		int a = plan.AddTarget(color);
+		int b = plan.AddTarget(color);
+		int c = plan.AddTarget(color);
+		int d = plan.AddTarget(depth);
+		int unused = plan.AddTarget(color);
+		plan.UseTarget(b, 3);
+		plan.UseTarget(b, 2);
+		plan.UseTarget(a, 0);
+		plan.UseTarget(a, 1);
+		plan.UseTarget(c, 1);
+		plan.UseTarget(c, 2);
+		plan.UseTarget(d, 2);
+		plan.Compile();
+
+		// a and b share, c overlaps both, d is another kind.
+		const unsigned long long size = 100 * 100 * 4;
+		const RenderTargetPlan::Statistics& statistics = plan.GetStatistics();
+		return IsValid(plan) && plan.GetTextureCount() == 3 && plan.GetTexture(a) == plan.GetTexture(b) && plan.GetTexture(c) != plan.GetTexture(a) &&
+			plan.GetTexture(unused) == -1 && statistics.RequestedBytes == 4 * size && statistics.AllocatedBytes == 3 * size &&
+			statistics.AliasedBytes == size && statistics.PeakBytes == 3 * size;
+	}
+
+	bool CheckRandomPlans(int count) {
+		unsigned int state = 777;
+		RenderTargetPlan plan;
+		for (int i = 0; i < count; i++) {
+			plan.Clear();
+			int targets = 1 + static_cast<int>(NextRandom(state) * 12);
+			for (int t = 0; t < targets; t++) {
+				RenderTargetDesc desc = { { 64, 32 }, NextRandom(state) < 0.3f ? RenderTargetFormat_DepthStencil : RenderTargetFormat_Color,
+					NextRandom(state) < 0.5f ? 1 : 4, RenderTargetBind_RenderTarget };
+				plan.AddTarget(desc);
+				int uses = static_cast<int>(NextRandom(state) * 3);
+				for (int u = 0; u < uses; u++) {
+					plan.UseTarget(t, static_cast<int>(NextRandom(state) * 8));
+				}
+			}
+			plan.Compile();
+			if (!IsValid(plan)) {
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
+bool RunRenderTargetBenchmark(unsigned int iterations) {
+	bool passed = CheckKnownPlan();
+	std::printf("Known plan: %s\n", passed ? "as expected" : "FAILED");
+	bool random = CheckRandomPlans(10000);
+	std::printf("Random plans: %s\n", random ? "all valid" : "FAILED, targets alive at the same time share a texture");
+	passed = passed && random;
+
+	RenderTargetPlan plan;
+	for (int multisampleCount = 1; multisampleCount <= 4; multisampleCount *= 4) {
+		for (int foveated = 0; foveated < 2; foveated++) {
+			PlanEyeTargets(EyeTextureSize, multisampleCount, foveated != 0, false, plan);
+			const RenderTargetPlan::Statistics& statistics = plan.GetStatistics();
+			bool valid = IsValid(plan);
+			std::printf("%dx%d, %dx MSAA%s: %d textures, %llu KB (%llu KB peak), %llu KB aliased%s\n", EyeTextureSize.w, EyeTextureSize.h,
+				multisampleCount, foveated != 0 ? ", foveated" : "", statistics.Textures, statistics.AllocatedBytes / 1024, statistics.PeakBytes / 1024,
+				statistics.AliasedBytes / 1024, valid ? "" : ", FAILED to validate");
+			passed = passed && valid;
+		}
+	}
+
+	// Own distortion resolving the eye texture itself needs no intermediary.
+	{
+		PlanEyeTargets(EyeTextureSize, 4, false, true, plan);
+		const RenderTargetPlan::Statistics& statistics = plan.GetStatistics();
+		bool valid = IsValid(plan) && statistics.Textures == 2 && plan.GetTexture(EyeTarget_Intermediary) < 0;
+		std::printf("%dx%d, 4x MSAA, fused resolve: %d textures, %llu KB (%llu KB peak), %llu KB aliased%s\n", EyeTextureSize.w, EyeTextureSize.h,
+			statistics.Textures, statistics.AllocatedBytes / 1024, statistics.PeakBytes / 1024, statistics.AliasedBytes / 1024,
+			valid ? "" : ", FAILED, the intermediary is still there");
+		passed = passed && valid;
+	}
+
+	// Foveation on and off with multisampling, then a new eye texture size.
+	{
+		RenderTargetPool pool;
+		std::vector<int> created;
+		std::vector<int> released;
+		PlanEyeTargets(EyeTextureSize, 4, false, false, plan);
+		pool.Apply(plan, created, released);
+		int source = pool.GetSlot(plan.GetTexture(EyeTarget_Intermediary));
+		bool ok = created.size() == 3 && released.empty();
+
+		PlanEyeTargets(EyeTextureSize, 4, true, false, plan);
+		pool.Apply(plan, created, released);
+		int foveatedCreated = static_cast<int>(created.size());
+		ok = ok && created.size() == 1 && released.empty() && pool.GetSlot(plan.GetTexture(EyeTarget_Intermediary)) == source;
+
+		PlanEyeTargets(EyeTextureSize, 4, false, false, plan);
+		pool.Apply(plan, created, released);
+		ok = ok && created.empty() && released.size() == 1 && pool.GetSlot(plan.GetTexture(EyeTarget_Intermediary)) == source;
+
+		Size2i smaller = { EyeTextureSize.w / 2, EyeTextureSize.h / 2 };
+		PlanEyeTargets(smaller, 4, false, false, plan);
+		pool.Apply(plan, created, released);
+		ok = ok && created.size() == 3 && released.size() == 3 && pool.GetStatistics().Bytes == plan.GetStatistics().AllocatedBytes;
+
+		std::printf("Pool: %d created switching foveation on, %llu created and %llu released in all, %s\n", foveatedCreated,
+			pool.GetStatistics().Creations, pool.GetStatistics().Releases, ok ? "distortion source kept" : "FAILED");
+		passed = passed && ok;
+	}
+
+	// What switching foveation costs on the CPU.
+	RenderTargetPool pool;
+	std::vector<int> created;
+	std::vector<int> released;
+	auto start = ReadClock();
+	for (unsigned int i = 0; i < iterations; i++) {
+		PlanEyeTargets(EyeTextureSize, 4, (i & 1) != 0, false, plan);
+		pool.Apply(plan, created, released);
+	}
+	double seconds = ClockTicksToSeconds(ReadClock() - start);
+	std::printf("Plan and apply: %.3f us\n", iterations > 0 ? seconds * 1e6 / iterations : 0.0);
+
+	return passed;
+}
@@ -0,0 +1,231 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#include "Benchmarks.h"
+#include "Clock.h"
+#include "FrameLoop.h"
+#include "JobSystem.h"
+#include "NullRenderDevice.h"
+#include "ResolutionController.h"
+#include "SimulatedHmd.h"
+#include <cstdio>
+#include <deque>
+
+/*
+	ResolutionController against synthetic frame-time traces. The pretend GPU takes a fixed time
+	plus a time per pixel, reported a few frames late and with some noise, like timestamp queries
+	would. The controller has to settle inside its band without hunting, stay at the largest
+	scale when there is time to spare, give up at the smallest when there isn't, and react to a
+	sudden increase in load within a few frames. Then the frame loop is checked to hand the scaled
+	viewports to the HMD, and the cost of an update is timed.
+*/
+
+namespace {
+	const unsigned int TraceFrames = 600;
+	const unsigned int ResultLatency = 3; // Frames until a GPU time comes back
+	const double Noise = 0.1; // Peak to peak, relative
+
+	struct Load {
+		double FixedTime; // Seconds
+		double FullScaleTime; // Seconds per frame spent on pixels at scale 1
+		unsigned int StepFrame; // From this frame on, the pixel time is multiplied by StepFactor
+		double StepFactor;
+	};
+
+	struct TraceResult {
+		float Scale[TraceFrames]; // Scale each frame was drawn at
+		double FrameTime[TraceFrames];
+		unsigned int DirectionChanges; // In the second half of the trace
+	};
+
+	// Deterministic, so every run checks the same trace.
+	double NextNoise(unsigned int& state) {
+		state = state * 1664525u + 1013904223u;
+		return ((state >> 8) * (1.0 / 16777216.0) - 0.5) * Noise;
+	}
+
+	void RunTrace(ResolutionController& controller, const Load& load, TraceResult& result) {
+		unsigned int state = 777;
+		std::deque<float> pipeline(ResultLatency, controller.GetScale());
+		int direction = 0;
+		result.DirectionChanges = 0;
+		for (unsigned int frame = 0; frame < TraceFrames; frame++) {
+			float scale = pipeline.front();
+			pipeline.pop_front();
+			double pixelTime = load.FullScaleTime * (frame >= load.StepFrame ? load.StepFactor : 1.0);
+			double frameTime = (load.FixedTime + pixelTime * scale * scale) * (1.0 + NextNoise(state));
+			result.Scale[frame] = scale;
+			result.FrameTime[frame] = frameTime;
+
+			float previous = controller.GetScale();
+			float next = controller.Update(frameTime);
+			pipeline.push_back(next);
+
+			int change = next > previous ? 1 : (next < previous ? -1 : 0);
+			if (change != 0) {
+				if (direction != 0 && change != direction && frame >= TraceFrames / 2) {
+					result.DirectionChanges++;
+				}
+				direction = change;
+			}
+		}
+	}
+
+	double MeanFrameTime(const TraceResult& result, unsigned int first, unsigned int end) {
+		double sum = 0.0;
+		for (unsigned int frame = first; frame < end; frame++) {
+			sum += result.FrameTime[frame];
+		}
+		return sum / (end - first);
+	}
+
+	bool CheckTraces() {
+		const ResolutionController::Settings settings = ResolutionController::GetDefaultSettings(75.0);
+		double target = settings.TargetFrameTime;
+		double bandBottom = target * (1.0 - settings.Headroom);
+		bool passed = true;
+		TraceResult result;
+
+		// Too slow at full resolution, fine somewhere in between.
+		{
+			ResolutionController controller(settings);
+			Load load = { 0.002, 0.016, TraceFrames, 1.0 };
+			RunTrace(controller, load, result);
+			double mean = MeanFrameTime(result, TraceFrames / 2, TraceFrames);
+			std::printf("  Over budget: settled at %.3f, %.2f ms (band %.2f to %.2f ms), %u direction changes\n",
+				result.Scale[TraceFrames - 1], mean * 1000.0, bandBottom * 1000.0, target * 1000.0, result.DirectionChanges);
+			if (mean > target || mean < bandBottom * 0.95 || result.DirectionChanges > 4) {
+				std::printf("  Did not settle in the band\n");
+				passed = false;
+			}
+		}
+
+		// Plenty of time, the scale never moves.
+		{
+			ResolutionController controller(settings);
+			Load load = { 0.002, 0.006, TraceFrames, 1.0 };
+			RunTrace(controller, load, result);
+			for (unsigned int frame = 0; frame < TraceFrames; frame++) {
+				if (result.Scale[frame] != settings.MaxScale) {
+					std::printf("  Under budget: scale left %.3f at frame %u\n", settings.MaxScale, frame);
+					passed = false;
+					break;
+				}
+			}
+		}
+
+		// Hopeless, the scale ends at the minimum.
+		{
+			ResolutionController controller(settings);
+			Load load = { 0.002, 0.05, TraceFrames, 1.0 };
+			RunTrace(controller, load, result);
+			std::printf("  Hopeless: ended at %.3f\n", result.Scale[TraceFrames - 1]);
+			if (result.Scale[TraceFrames - 1] != settings.MinScale) {
+				passed = false;
+			}
+		}
+
+		// The load jumps by 60% halfway through, the frame time has to be back under the target soon.
+		{
+			ResolutionController controller(settings);
+			Load load = { 0.002, 0.012, TraceFrames / 2, 1.6 };
+			RunTrace(controller, load, result);
+			unsigned int recovered = TraceFrames / 2;
+			while (recovered < TraceFrames) {
+				// Five frames in a row under the target, give or take the noise.
+				unsigned int under = 0;
+				while (under < 5 && recovered + under < TraceFrames && result.FrameTime[recovered + under] <= target * (1.0 + Noise / 2)) {
+					under++;
+				}
+				if (under == 5) {
+					break;
+				}
+				recovered++;
+			}
+			std::printf("  Load step: back under the target after %u frames, scale %.3f -> %.3f\n",
+				recovered - TraceFrames / 2, result.Scale[TraceFrames / 2 - 1], result.Scale[TraceFrames - 1]);
+			if (recovered - TraceFrames / 2 > 30) {
+				passed = false;
+			}
+		}
+		return passed;
+	}
+
+	// The frame loop has to size the viewports by the controller's scale and tell the HMD.
+	bool CheckFrameLoop() {
+		PoseScript script;
+		SimulatedHmd hmd(script);
+		StereoSetup setup = CreateStereoSetup(hmd, 1.0f);
+		setup.AdaptiveResolution = true;
+
+		// NullRenderDevice has no GPU time, the CPU time of any frame is way over this target.
+		ResolutionController::Settings settings = ResolutionController::GetDefaultSettings(75.0);
+		settings.TargetFrameTime = 1e-9;
+		setup.Resolution = ResolutionController(settings);
+
+		NullRenderDevice device(setup.RenderTargetSize, 1);
+		Scene scene;
+		AddDefaultSceneContent(scene);
+		device.SetSceneVertices(&scene.GetVertices()[0], static_cast<unsigned int>(scene.GetVertices().size()));
+		JobSystem jobs(1);
+		for (int frame = 0; frame < 50; frame++) {
+			RenderFrame(hmd, device, setup, scene, jobs);
+		}
+
+		bool passed = setup.Resolution.GetScale() == settings.MinScale;
+		for (int eye = 0; eye < EyeCount; eye++) {
+			const Rect2i& viewport = setup.EyeRenderViewport[eye];
+			const Rect2i& hmdViewport = hmd.GetEyeRenderViewport(eye);
+			if (viewport.Size.w > setup.MaxEyeRenderViewport[eye].Size.w * 0.6f ||
+				viewport.Pos.x != setup.MaxEyeRenderViewport[eye].Pos.x ||
+				hmdViewport.Pos.x != viewport.Pos.x || hmdViewport.Size.w != viewport.Size.w || hmdViewport.Size.h != viewport.Size.h) {
+				passed = false;
+			}
+		}
+		std::printf("  Frame loop: left eye %dx%d of %dx%d\n", setup.EyeRenderViewport[0].Size.w, setup.EyeRenderViewport[0].Size.h,
+			setup.MaxEyeRenderViewport[0].Size.w, setup.MaxEyeRenderViewport[0].Size.h);
+		return passed;
+	}
+}
+
+bool RunResolutionBenchmark(unsigned int iterations) {
+	bool passed = CheckTraces();
+	if (!CheckFrameLoop()) {
+		std::printf("  The frame loop did not apply the scale\n");
+		passed = false;
+	}
+
+	ResolutionController controller(ResolutionController::GetDefaultSettings(75.0));
+	float scaleSum = 0.0f;
+	auto start = ReadClock();
+	for (unsigned int i = 0; i < iterations; i++) {
+		scaleSum += controller.Update(0.008 + (i & 15) * 0.0005);
+	}
+	double seconds = ClockTicksToSeconds(ReadClock() - start);
+	std::printf("Update: %.1f ns (mean scale %.3f)\n", iterations > 0 ? seconds * 1e9 / iterations : 0.0, iterations > 0 ? scaleSum / iterations : 0.0f);
+	return passed;
+}
@@ -0,0 +1,352 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+
+#include "Benchmarks.h"
+#include "Clock.h"
+#include "Culling.h"
+#include "Scene.h"
+#include "VrMath.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+/*
+	Scene culling and mesh loading. A scene of 100k+ objects is culled once per frame with the
+	combined stereo frustum, which is checked to never lose an object either eye's own frustum
+	would keep, and timed against culling each eye separately. The mesh file loader is checked to
+	round trip a scene and to reject damaged files.
+*/
+
+namespace {
+	const unsigned int ObjectCount = 131072;
+	const float WorldRadius = 100.0f;
+	const float ZNear = 0.01f;
+	const float ZFar = 10000.0f;
+	const char* const TemporaryMeshPath = "SceneBenchmark.mesh";
+
+	// Roughly the DK2's FOV.
+	const FovPort EyeFov[EyeCount] = {
+		{ 1.33f, 1.33f, 1.06f, 1.09f },
+		{ 1.33f, 1.33f, 1.09f, 1.06f }
+	};
+
+	// Deterministic, so every run checks the same scene.
+	class Random {
+	public:
+		Random() : state(98765) {}
+
+		float Next() {
+			state = state * 1664525u + 1013904223u;
+			return (state >> 8) * (1.0f / 16777216.0f);
+		}
+
+		float Next(float low, float high) {
+			return low + (high - low) * Next();
+		}
+
+	private:
+		unsigned int state;
+	};
+
+	Quaternion RandomOrientation(Random& random) {
+		Quaternion q = { random.Next(-1.0f, 1.0f), random.Next(-1.0f, 1.0f), random.Next(-1.0f, 1.0f), random.Next(-1.0f, 1.0f) };
+		return Normalized(q);
+	}
+
+	void AddTestMeshes(Scene& scene) {
+		const Vertex triangle[] = {
+			{ { 0.0f, 0.5f, 0.0f } }, { { 0.5f, -0.5f, 0.0f } }, { { -0.5f, -0.5f, 0.0f } }
+		};
+		const Vertex quad[] = {
+			{ { -1.0f, 0.0f, -1.0f } }, { { 1.0f, 0.0f, -1.0f } }, { { 1.0f, 0.0f, 1.0f } },
+			{ { -1.0f, 0.0f, -1.0f } }, { { 1.0f, 0.0f, 1.0f } }, { { -1.0f, 0.0f, 1.0f } }
+		};
+		const Vertex sliver[] = {
+			{ { 2.0f, 0.0f, 0.0f } }, { { 6.0f, 0.1f, 0.0f } }, { { 2.0f, 0.2f, 0.0f } }
+		};
+		scene.AddMesh(triangle, sizeof(triangle) / sizeof(triangle[0]));
+		scene.AddMesh(quad, sizeof(quad) / sizeof(quad[0]));
+		scene.AddMesh(sliver, sizeof(sliver) / sizeof(sliver[0]));
+	}
+
+	void ScatterObjects(Scene& scene, Random& random) {
+		for (unsigned int i = 0; i < ObjectCount; i++) {
+			Vector3 position = { random.Next(-WorldRadius, WorldRadius), random.Next(-WorldRadius, WorldRadius), random.Next(-WorldRadius, WorldRadius) };
+			int mesh = static_cast<int>(random.Next() * scene.GetMeshCount()) % scene.GetMeshCount();
+			scene.AddObject(mesh, position, RandomOrientation(random), random.Next(0.1f, 3.0f));
+		}
+	}
+
+	// Both eyes of a head at a random pose, 64 mm apart.
+	void RandomEyePoses(Random& random, Pose eyePose[EyeCount]) {
+		Quaternion orientation = RandomOrientation(random);
+		Vector3 head = { random.Next(-10.0f, 10.0f), random.Next(-10.0f, 10.0f), random.Next(-10.0f, 10.0f) };
+		const Vector3 eyeOffset[EyeCount] = { { -0.032f, 0.0f, 0.0f }, { 0.032f, 0.0f, 0.0f } };
+		for (int eye = 0; eye < EyeCount; eye++) {
+			eyePose[eye].Orientation = orientation;
+			eyePose[eye].Position = head + Rotate(orientation, eyeOffset[eye]);
+		}
+	}
+
+	float PlaneDistance(const Plane& plane, const Vector3& point) {
+		return Dot(plane.Normal, point) + plane.Distance;
+	}
+
+	/*
+		The combined frustum is only conservative if it contains both eyes' frusta, which is checked
+		with their corners. The sphere tests themselves can't be compared directly: a sphere next to
+		a corner of an eye's frustum can pass each of its planes without touching the frustum, and
+		still be culled by the combined frustum, correctly. Points don't have that problem, so
+		random points inside either eye's frustum have to be kept too.
+	*/
+	bool CheckConservative(const Scene& scene, Random& random, double& extraFraction) {
+		const unsigned int pointCount = 4096;
+		std::vector<float> pointX(pointCount), pointY(pointCount), pointZ(pointCount), zeroRadius(pointCount, 0.0f);
+		std::vector<unsigned int> combined, perEye;
+		std::vector<unsigned char> inCombined(pointCount);
+		unsigned long long combinedTotal = 0, perEyeTotal = 0;
+		int errors = 0;
+
+		for (int i = 0; i < 100; i++) {
+			Pose eyePose[EyeCount];
+			RandomEyePoses(random, eyePose);
+			Frustum combinedFrustum = ComputeStereoCullFrustum(eyePose, EyeFov, ZNear, ZFar);
+
+			for (int eye = 0; eye < EyeCount; eye++) {
+				const FovPort& fov = EyeFov[eye];
+				const float depths[2] = { ZNear, ZFar };
+				for (int corner = 0; corner < 8; corner++) {
+					float depth = depths[corner >> 2];
+					Vector3 local = { (corner & 1 ? fov.RightTan : -fov.LeftTan) * depth, (corner & 2 ? fov.UpTan : -fov.DownTan) * depth, -depth };
+					Vector3 point = eyePose[eye].Position + Rotate(eyePose[eye].Orientation, local);
+					for (int p = 0; p < 6; p++) {
+						if (PlaneDistance(combinedFrustum.Planes[p], point) < -1e-5f * (1.0f + depth)) {
+							if (errors++ < 10) {
+								std::printf("  corner %d of eye %d is outside plane %d\n", corner, eye, p);
+							}
+						}
+					}
+				}
+			}
+
+			for (unsigned int j = 0; j < pointCount; j++) {
+				pointX[j] = eyePose[0].Position.x + random.Next(-2.0f, 2.0f);
+				pointY[j] = eyePose[0].Position.y + random.Next(-2.0f, 2.0f);
+				pointZ[j] = eyePose[0].Position.z + random.Next(-2.0f, 2.0f);
+			}
+			combined.clear();
+			CullSpheres(combinedFrustum, &pointX[0], &pointY[0], &pointZ[0], &zeroRadius[0], pointCount, combined);
+			std::fill(inCombined.begin(), inCombined.end(), 0);
+			for (size_t j = 0; j < combined.size(); j++) {
+				inCombined[combined[j]] = 1;
+			}
+			for (int eye = 0; eye < EyeCount; eye++) {
+				perEye.clear();
+				CullSpheres(ComputeFrustum(eyePose[eye], EyeFov[eye], ZNear, ZFar), &pointX[0], &pointY[0], &pointZ[0], &zeroRadius[0], pointCount, perEye);
+				for (size_t j = 0; j < perEye.size(); j++) {
+					if (!inCombined[perEye[j]] && errors++ < 10) {
+						std::printf("  point %u inside eye %d's frustum was culled\n", perEye[j], eye);
+					}
+				}
+			}
+
+			// How much more the combined cull keeps than culling per eye would, with the scene.
+			combined.clear();
+			scene.Cull(combinedFrustum, combined);
+			std::vector<unsigned char> inEither(scene.GetObjectCount());
+			for (int eye = 0; eye < EyeCount; eye++) {
+				perEye.clear();
+				scene.Cull(ComputeFrustum(eyePose[eye], EyeFov[eye], ZNear, ZFar), perEye);
+				for (size_t j = 0; j < perEye.size(); j++) {
+					inEither[perEye[j]] = 1;
+				}
+			}
+			for (size_t j = 0; j < inEither.size(); j++) {
+				perEyeTotal += inEither[j];
+			}
+			combinedTotal += combined.size();
+		}
+
+		extraFraction = perEyeTotal > 0 ? (static_cast<double>(combinedTotal) - perEyeTotal) / perEyeTotal : 0.0;
+		return errors == 0;
+	}
+
+	bool WriteBytes(const char* path, const std::vector<unsigned char>& bytes) {
+		FILE* file = fopen(path, "wb");
+		if (file == nullptr) {
+			return false;
+		}
+		bool written = bytes.empty() || fwrite(&bytes[0], 1, bytes.size(), file) == bytes.size();
+		return fclose(file) == 0 && written;
+	}
+
+	bool ReadBytes(const char* path, std::vector<unsigned char>& bytes) {
+		FILE* file = fopen(path, "rb");
+		if (file == nullptr) {
+			return false;
+		}
+		bytes.clear();
+		unsigned char buffer[4096];
+		size_t count;
+		while ((count = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+			bytes.insert(bytes.end(), buffer, buffer + count);
+		}
+		fclose(file);
+		return true;
+	}
+
+	// Loading a damaged file has to fail and leave the scene alone.
+	bool CheckRejected(const char* what, const std::vector<unsigned char>& bytes) {
+		Scene scene;
+		if (!WriteBytes(TemporaryMeshPath, bytes) || scene.LoadMeshFile(TemporaryMeshPath) || scene.GetMeshCount() != 0 || !scene.GetVertices().empty()) {
+			std::printf("  %s was not rejected\n", what);
+			return false;
+		}
+		return true;
+	}
+
+	bool CheckMeshFile() {
+		Scene original;
+		AddTestMeshes(original);
+		if (!SaveMeshFile(TemporaryMeshPath, original)) {
+			std::printf("  failed writing %s\n", TemporaryMeshPath);
+			return false;
+		}
+
+		// Load twice into the same scene, the second copy's vertex ranges are offset.
+		Scene loaded;
+		bool passed = loaded.LoadMeshFile(TemporaryMeshPath) && loaded.LoadMeshFile(TemporaryMeshPath);
+		unsigned int vertexCount = static_cast<unsigned int>(original.GetVertices().size());
+		if (!passed || loaded.GetMeshCount() != 2 * original.GetMeshCount() || loaded.GetVertices().size() != 2 * vertexCount) {
+			std::printf("  loaded scene does not match the saved one\n");
+			passed = false;
+		}
+		for (int i = 0; passed && i < loaded.GetMeshCount(); i++) {
+			const Mesh& a = original.GetMesh(i % original.GetMeshCount());
+			const Mesh& b = loaded.GetMesh(i);
+			unsigned int offset = i < original.GetMeshCount() ? 0 : vertexCount;
+			if (b.FirstVertex != a.FirstVertex + offset || b.VertexCount != a.VertexCount || b.BoundsRadius != a.BoundsRadius ||
+				std::memcmp(&original.GetVertices()[a.FirstVertex], &loaded.GetVertices()[b.FirstVertex], a.VertexCount * sizeof(Vertex)) != 0) {
+				std::printf("  mesh %d does not match the saved one\n", i);
+				passed = false;
+			}
+		}
+
+		std::vector<unsigned char> bytes;
+		if (!ReadBytes(TemporaryMeshPath, bytes)) {
+			std::printf("  failed reading %s\n", TemporaryMeshPath);
+			return false;
+		}
+
+		std::vector<unsigned char> damaged = bytes;
+		damaged[0] = 'X';
+		passed &= CheckRejected("bad magic", damaged);
+
+		damaged = bytes;
+		damaged.pop_back();
+		passed &= CheckRejected("truncated file", damaged);
+
+		damaged = bytes;
+		damaged.push_back(0);
+		passed &= CheckRejected("trailing garbage", damaged);
+
+		// A vertex count that overflows 32 bits worth of bytes once multiplied.
+		damaged = bytes;
+		unsigned int hugeCount = 0x10000000u + vertexCount;
+		std::memcpy(&damaged[offsetof(MeshFileHeader, VertexCount)], &hugeCount, sizeof(hugeCount));
+		passed &= CheckRejected("overflowing vertex count", damaged);
+
+		// A mesh reaching past the end of the vertices.
+		damaged = bytes;
+		MeshFileEntry entry;
+		std::memcpy(&entry, &damaged[sizeof(MeshFileHeader)], sizeof(entry));
+		entry.VertexCount = vertexCount;
+		entry.FirstVertex = 1;
+		std::memcpy(&damaged[sizeof(MeshFileHeader)], &entry, sizeof(entry));
+		passed &= CheckRejected("out of range mesh", damaged);
+
+		passed &= CheckRejected("empty file", std::vector<unsigned char>());
+
+		std::remove(TemporaryMeshPath);
+		return passed;
+	}
+}
+
+bool RunSceneBenchmark(unsigned int iterations) {
+	bool passed = CheckMeshFile();
+	if (passed) {
+		std::printf("Mesh file: round trip and damaged file checks passed\n");
+	}
+
+	Scene scene;
+	AddTestMeshes(scene);
+	Random random;
+	ScatterObjects(scene, random);
+
+	double extraFraction = 0.0;
+	passed &= CheckConservative(scene, random, extraFraction);
+	std::printf("Combined frustum contains both eyes' frusta, keeps %.2f%% more objects than culling per eye\n", extraFraction * 100.0);
+
+	// Each frame is a full cull of the scene, so far fewer of them than other benchmarks run.
+	unsigned int frameCount = iterations / 10000 + 1;
+	std::vector<Pose> poses(frameCount * EyeCount);
+	for (unsigned int i = 0; i < frameCount; i++) {
+		RandomEyePoses(random, &poses[i * EyeCount]);
+	}
+
+	std::vector<unsigned int> visible;
+	visible.reserve(scene.GetObjectCount());
+	unsigned long long combinedVisible = 0;
+	auto start = ReadClock();
+	for (unsigned int i = 0; i < frameCount; i++) {
+		visible.clear();
+		scene.Cull(ComputeStereoCullFrustum(&poses[i * EyeCount], EyeFov, ZNear, ZFar), visible);
+		combinedVisible += visible.size();
+	}
+	double combinedTime = ClockTicksToSeconds(ReadClock() - start) / frameCount;
+
+	unsigned long long perEyeVisible = 0;
+	start = ReadClock();
+	for (unsigned int i = 0; i < frameCount; i++) {
+		for (int eye = 0; eye < EyeCount; eye++) {
+			visible.clear();
+			scene.Cull(ComputeFrustum(poses[i * EyeCount + eye], EyeFov[eye], ZNear, ZFar), visible);
+			perEyeVisible += visible.size();
+		}
+	}
+	double perEyeTime = ClockTicksToSeconds(ReadClock() - start) / frameCount;
+
+	std::printf("%u objects, %u frames\n", scene.GetObjectCount(), frameCount);
+	std::printf("Per-eye culls:  %8.1f us/frame (%.0f visible per eye)\n", perEyeTime * 1e6, static_cast<double>(perEyeVisible) / (frameCount * EyeCount));
+	std::printf("Combined cull:  %8.1f us/frame (%.0f visible, %.2f ns/object)\n", combinedTime * 1e6,
+		static_cast<double>(combinedVisible) / frameCount, combinedTime * 1e9 / scene.GetObjectCount());
+
+	return passed;
+}
@@ -0,0 +1,254 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+
+#include "Benchmarks.h"
+#include "Clock.h"
+#include "ShaderCache.h"
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <unistd.h>
+#endif
+
+/*
+	The shader cache, with a stand-in for the compiler that makes up bytecode from the key and
+	counts how often it is called. A cold cache compiles every shader once, a warm one (a new
+	ShaderCache on the same directory, like the next start) none and returns the same bytes.
+	Changing any part of a key, or the compiler tag, has to miss; a corrupted or truncated file
+	has to be compiled again and replaced.
+
+	Then warm lookups are timed, which is what a start costs with a warm cache.
+*/
+
+namespace {
+	const char* CacheDirectory = "SimpleOVR_ShaderCacheBenchmark";
+	const char* CompilerTag = "benchmark-compiler-1";
+	const int ShaderCount = 16;
+	const size_t BytecodeSize = 8192;
+
+	unsigned int compileCount = 0;
+
+	// Bytecode that depends on everything in the key, like the real thing.
+	bool FakeCompile(const ShaderKey& key, std::vector<unsigned char>& outBytecode) {
+		compileCount++;
+		std::string text = std::string(key.Source) + key.EntryPoint + key.Profile + (key.Defines != nullptr ? key.Defines : "");
+		unsigned int state = key.Flags;
+		for (size_t i = 0; i < text.size(); i++) {
+			state = state * 31 + static_cast<unsigned char>(text[i]);
+		}
+		outBytecode.resize(BytecodeSize);
+		for (size_t i = 0; i < BytecodeSize; i++) {
+			state = state * 1664525u + 1013904223u;
+			outBytecode[i] = static_cast<unsigned char>(state >> 24);
+		}
+		return true;
+	}
+
+	struct Shaders {
+		std::vector<std::string> Sources;
+		std::vector<ShaderKey> Keys;
+	};
+
+	void MakeShaders(Shaders& shaders) {
+		shaders.Sources.resize(ShaderCount);
+		shaders.Keys.resize(ShaderCount);
+		for (int i = 0; i < ShaderCount; i++) {
+			char source[128];
+			std::sprintf(source, "float4 main() : SV_Target { return float4(%d, 0, 0, 1); }", i);
+			shaders.Sources[i] = source;
+			ShaderKey key = { shaders.Sources[i].c_str(), "main", i % 2 == 0 ? "vs_4_0" : "ps_4_0", i % 3 == 0 ? "STEREO=1" : nullptr, 0 };
+			shaders.Keys[i] = key;
+		}
+	}
+
+	// Compiles or loads every shader, false if any bytecode differs from a fresh compile.
+	bool LoadAll(ShaderCache& cache, const Shaders& shaders) {
+		bool same = true;
+		for (int i = 0; i < ShaderCount; i++) {
+			ShaderBytecode bytecode;
+			if (!cache.GetOrCompile(shaders.Keys[i], FakeCompile, bytecode)) {
+				return false;
+			}
+			std::vector<unsigned char> expected;
+			unsigned int compiles = compileCount;
+			FakeCompile(shaders.Keys[i], expected);
+			compileCount = compiles;
+			same = same && bytecode.Size == expected.size() && std::memcmp(bytecode.Data, expected.data(), expected.size()) == 0;
+		}
+		return same;
+	}
+
+	void RemoveCache(const Shaders& shaders) {
+		ShaderCache cache(CacheDirectory, CompilerTag);
+		for (int i = 0; i < ShaderCount; i++) {
+			std::remove(cache.GetPath(shaders.Keys[i]).c_str());
+		}
+#ifdef _WIN32
+		_rmdir(CacheDirectory);
+#else
+		rmdir(CacheDirectory);
+#endif
+	}
+
+	// Changes a file of the cache on disk: flips a byte, or cuts it short.
+	bool DamageFile(const std::string& path, bool truncate) {
+		std::vector<unsigned char> contents;
+		FILE* file = std::fopen(path.c_str(), "rb");
+		if (file == nullptr) {
+			return false;
+		}
+		unsigned char buffer[4096];
+		size_t read;
+		while ((read = std::fread(buffer, 1, sizeof(buffer), file)) > 0) {
+			contents.insert(contents.end(), buffer, buffer + read);
+		}
+		std::fclose(file);
+		if (truncate) {
+			contents.resize(contents.size() / 2);
+		}
+		else {
+			contents[contents.size() - 100] ^= 0x40;
+		}
+		file = std::fopen(path.c_str(), "wb");
+		if (file == nullptr) {
+			return false;
+		}
+		bool written = std::fwrite(contents.data(), contents.size(), 1, file) == 1;
+		return std::fclose(file) == 0 && written;
+	}
+
+	bool CheckKeys() {
+		ShaderCache cache(CacheDirectory, CompilerTag);
+		ShaderCache otherCompiler(CacheDirectory, "benchmark-compiler-2");
+		std::string source = "float4 main() : SV_Target { return 1; }";
+		std::string copy = source;
+		ShaderKey base = { source.c_str(), "main", "ps_4_0", "A=1", 0 };
+		ShaderKey same = { copy.c_str(), "main", "ps_4_0", "A=1", 0 };
+		ShaderKey variants[] = {
+			{ "float4 main() : SV_Target { return 2; }", "main", "ps_4_0", "A=1", 0 },
+			{ source.c_str(), "PSMain", "ps_4_0", "A=1", 0 },
+			{ source.c_str(), "main", "ps_5_0", "A=1", 0 },
+			{ source.c_str(), "main", "ps_4_0", "A=2", 0 },
+			{ source.c_str(), "main", "ps_4_0", nullptr, 0 },
+			{ source.c_str(), "main", "ps_4_0", "A=1", 1 },
+			// Fields running into each other
+			{ source.c_str(), "mai", "nps_4_0", "A=1", 0 },
+		};
+		if (cache.GetHash(base) != cache.GetHash(same) || cache.GetHash(base) == otherCompiler.GetHash(base)) {
+			return false;
+		}
+		for (size_t i = 0; i < sizeof(variants) / sizeof(variants[0]); i++) {
+			if (cache.GetHash(variants[i]) == cache.GetHash(base)) {
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
+bool RunShaderCacheBenchmark(unsigned int iterations) {
+	bool passed = CheckKeys();
+	std::printf("Keys: %s\n", passed ? "every field changes the hash" : "FAILED to tell keys apart");
+
+	Shaders shaders;
+	MakeShaders(shaders);
+	RemoveCache(shaders);
+
+	// A cold start, then a warm one.
+	{
+		compileCount = 0;
+		ShaderCache cache(CacheDirectory, CompilerTag);
+		bool same = LoadAll(cache, shaders);
+		const ShaderCache::Statistics& statistics = cache.GetStatistics();
+		std::printf("Cold: %u compiles, %u hits, %u stores\n", compileCount, statistics.Hits, statistics.Stores);
+		if (!same || compileCount != ShaderCount || statistics.Stores != ShaderCount || statistics.Hits != 0) {
+			passed = false;
+		}
+	}
+	{
+		compileCount = 0;
+		ShaderCache cache(CacheDirectory, CompilerTag);
+		bool same = LoadAll(cache, shaders);
+		const ShaderCache::Statistics& statistics = cache.GetStatistics();
+		std::printf("Warm: %u compiles, %u hits%s\n", compileCount, statistics.Hits, same ? "" : ", bytecode differs");
+		if (!same || compileCount != 0 || statistics.Hits != ShaderCount) {
+			passed = false;
+		}
+	}
+
+	// Damaged files are replaced, a new compiler misses everything and leaves the old files alone.
+	for (int truncate = 0; truncate < 2; truncate++) {
+		compileCount = 0;
+		ShaderCache cache(CacheDirectory, CompilerTag);
+		bool damaged = DamageFile(cache.GetPath(shaders.Keys[3]), truncate != 0);
+		bool same = LoadAll(cache, shaders);
+		const ShaderCache::Statistics& statistics = cache.GetStatistics();
+		std::printf("%s file: %u compiles, %u invalid, %u stores\n", truncate != 0 ? "Truncated" : "Corrupted", compileCount, statistics.Invalid, statistics.Stores);
+		if (!damaged || !same || compileCount != 1 || statistics.Invalid != 1 || statistics.Stores != 1) {
+			passed = false;
+		}
+	}
+	{
+		compileCount = 0;
+		ShaderCache cache(CacheDirectory, "benchmark-compiler-2");
+		bool same = LoadAll(cache, shaders);
+		std::printf("Other compiler: %u compiles, %u misses\n", compileCount, cache.GetStatistics().Misses);
+		if (!same || compileCount != ShaderCount || cache.GetStatistics().Misses != ShaderCount) {
+			passed = false;
+		}
+		for (int i = 0; i < ShaderCount; i++) {
+			std::remove(cache.GetPath(shaders.Keys[i]).c_str());
+		}
+	}
+
+	// What a warm start costs per shader: open, map and verify.
+	unsigned int starts = iterations / 10000 + 1;
+	compileCount = 0;
+	auto start = ReadClock();
+	for (unsigned int i = 0; i < starts; i++) {
+		ShaderCache cache(CacheDirectory, CompilerTag);
+		for (int s = 0; s < ShaderCount; s++) {
+			ShaderBytecode bytecode;
+			cache.GetOrCompile(shaders.Keys[s], FakeCompile, bytecode);
+		}
+	}
+	double seconds = ClockTicksToSeconds(ReadClock() - start);
+	std::printf("Warm lookup: %.2f us per %u KB shader, %u compiles over %u starts\n", seconds * 1e6 / (starts * ShaderCount),
+		static_cast<unsigned int>(BytecodeSize / 1024), compileCount, starts);
+	if (compileCount != 0) {
+		passed = false;
+	}
+
+	RemoveCache(shaders);
+	return passed;
+}
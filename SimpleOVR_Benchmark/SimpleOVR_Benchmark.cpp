@@ -0,0 +1,129 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+/*
+	Micro-benchmarks for the hot parts of the frame loop. Unlike SimpleOVR_Headless, which measures
+	whole frames, each benchmark here hammers a single piece of code and compares it against the
+	straightforward version it replaces, checking that both give the same results.
+
+	https://github.com/poppeman/SimpleOVR
+
+	Building:
+
+	Visual Studio 2013:
+		Build the SimpleOVR_Benchmark project (Release, or the numbers are meaningless).
+
+	Linux (or anything else with a C++11 compiler):
+		g++ -std=c++11 -O2 -pthread -I../SimpleOVR_Common -o SimpleOVR_Benchmark [A-Z]*.cpp ../SimpleOVR_Common/[A-Z]*.cpp
+
+	Usage:
+		SimpleOVR_Benchmark [--iterations N] [benchmark...]
+
+	Runs every benchmark unless some are named. Exits with a failure if any results did not match.
+*/
+
+#include "Benchmarks.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+	struct Benchmark {
+		const char* Name;
+		bool (*Run)(unsigned int iterations);
+	};
+
+	const Benchmark AllBenchmarks[] = {
+		{ "stereo-projection", RunStereoProjectionBenchmark },
+		{ "eye-matrices", RunEyeMatrixBenchmark },
+		{ "constant-ring", RunConstantRingBenchmark },
+		{ "scene-culling", RunSceneBenchmark },
+		{ "thread-scaling", RunThreadScalingBenchmark },
+		{ "late-latch", RunLateLatchBenchmark },
+		{ "adaptive-resolution", RunResolutionBenchmark },
+		{ "foveation", RunFoveationBenchmark },
+		{ "software-raster", RunSoftwareRasterBenchmark },
+		{ "shader-cache", RunShaderCacheBenchmark },
+		{ "streaming", RunStreamingBenchmark },
+		{ "render-targets", RunRenderTargetBenchmark },
+		{ "frame-graph", RunFrameGraphBenchmark },
+		{ "draw-packets", RunDrawPacketBenchmark },
+		{ "gpu-driven", RunGpuDrivenBenchmark },
+		{ "pose-prediction", RunPosePredictionBenchmark },
+		{ "frame-pacing", RunFramePacingBenchmark },
+		{ "distortion", RunDistortionBenchmark },
+		{ "fused-resolve", RunFusedResolveBenchmark },
+		{ "hidden-area", RunHiddenAreaBenchmark },
+		{ "command-capture", RunCommandCaptureBenchmark },
+	};
+	const int BenchmarkCount = sizeof(AllBenchmarks) / sizeof(AllBenchmarks[0]);
+}
+
+int main(int argc, char* argv[]) {
+	unsigned int iterations = 1000000;
+	bool selected[BenchmarkCount] = {};
+	bool anySelected = false;
+
+	for (int i = 1; i < argc; i++) {
+		if (std::strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+			iterations = static_cast<unsigned int>(std::strtoul(argv[++i], nullptr, 10));
+			continue;
+		}
+
+		int found = -1;
+		for (int b = 0; b < BenchmarkCount; b++) {
+			if (std::strcmp(argv[i], AllBenchmarks[b].Name) == 0) {
+				found = b;
+			}
+		}
+		if (found < 0) {
+			std::fprintf(stderr, "Usage: %s [--iterations N] [benchmark...]\nBenchmarks:", argv[0]);
+			for (int b = 0; b < BenchmarkCount; b++) {
+				std::fprintf(stderr, " %s", AllBenchmarks[b].Name);
+			}
+			std::fprintf(stderr, "\n");
+			return EXIT_FAILURE;
+		}
+		selected[found] = true;
+		anySelected = true;
+	}
+
+	bool passed = true;
+	for (int b = 0; b < BenchmarkCount; b++) {
+		if (anySelected && !selected[b]) {
+			continue;
+		}
+		std::printf("== %s ==\n", AllBenchmarks[b].Name);
+		if (!AllBenchmarks[b].Run(iterations)) {
+			std::printf("FAILED\n");
+			passed = false;
+		}
+		std::printf("\n");
+	}
+
+	return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,239 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+
+#include "Benchmarks.h"
+#include "Clock.h"
+#include "FrameLoop.h"
+#include "Image.h"
+#include "JobSystem.h"
+#include "SimulatedHmd.h"
+#include "SoftwareRasterizer.h"
+#include "SoftwareRenderDevice.h"
+#include "VrMath.h"
+#include <cstdio>
+#include <vector>
+
+/*
+	The software rasterizer. The tiled SIMD path has to produce exactly the image of the reference
+	mode, pixel by pixel over each triangle's bounding box, for frames of a busy scene with and
+	without multisampling, in both stereo modes and foveated, and regardless of the thread count.
+	Triangles sharing edges have to cover every pixel exactly once. The two stereo modes, and
+	foveation at full density, only differ in a few pixels along the eye and region boundaries.
+
+	Then both paths are timed on the same frames, and the tiled one with more threads.
+*/
+
+namespace {
+	const unsigned int SceneObjectCount = 2000;
+
+	// Stereo modes and foveation may only change this fraction of the pixels.
+	const double MaxDifferentPixels = 0.001;
+
+	float NextRandom(unsigned int& state) {
+		state = state * 1664525u + 1013904223u;
+		return (state >> 8) * (1.0f / 16777216.0f);
+	}
+
+	struct RenderSettings {
+		StereoMode Mode;
+		int SampleCount;
+		bool Foveated;
+		float PeripheryDensity;
+		bool Reference;
+		int Threads;
+	};
+
+	// Renders the first frames of the default pose script, returns the seconds per frame.
+	double Render(const RenderSettings& settings, const Scene& scene, unsigned int frameCount, Image& outImage) {
+		PoseScript script;
+		SimulatedHmd hmd(script);
+		StereoSetup setup = CreateStereoSetup(hmd, 1.0f);
+		setup.Mode = settings.Mode;
+		setup.Foveated = settings.Foveated;
+		setup.Foveation.PeripheryDensity = settings.PeripheryDensity;
+		JobSystem jobs(settings.Threads);
+		SoftwareRenderDevice device(hmd.GetResolution(), setup.RenderTargetSize, settings.SampleCount, jobs);
+		device.SetReferenceMode(settings.Reference);
+		device.SetSceneVertices(&scene.GetVertices()[0], static_cast<unsigned int>(scene.GetVertices().size()));
+
+		auto start = ReadClock();
+		for (unsigned int frame = 0; frame < frameCount; frame++) {
+			RenderFrame(hmd, device, setup, scene, jobs);
+		}
+		double seconds = ClockTicksToSeconds(ReadClock() - start);
+		outImage = device.GetImage();
+		return seconds / frameCount;
+	}
+
+	const char* Describe(const RenderSettings& settings) {
+		static char description[64];
+		std::sprintf(description, "%s, %dx MSAA%s", settings.Mode == StereoMode_Instanced ? "instanced" : "multi-pass", settings.SampleCount,
+			settings.Foveated ? (settings.PeripheryDensity < 1.0f ? ", foveated" : ", foveated at full density") : "");
+		return description;
+	}
+
+	/*
+		A fan of triangles around a point inside a rectangle, drawn one at a time: every pixel of
+		the rectangle has to be covered by exactly one of them. All edges run through pixel
+		centers, where the top-left rule decides which triangle gets the pixel.
+	*/
+	bool CheckSharedEdges(bool reference) {
+		const Size2i size = { 64, 48 };
+		const Rect2i viewport = { { 0, 0 }, size };
+		SoftwareRasterizer rasterizer(size, 1, 1, nullptr);
+		rasterizer.SetReferenceMode(reference);
+
+		// Rim of the fan in pixels, clockwise on screen, and the center.
+		const float left = 16.5f;
+		const float top = 12.5f;
+		const float right = 48.5f;
+		const float bottom = 35.5f;
+		const float rim[][2] = {
+			{ left, top }, { 32.5f, top }, { right, top }, { right, 24.5f }, { right, bottom },
+			{ 20.5f, bottom }, { left, bottom }, { left, 20.5f }
+		};
+		const int rimCount = sizeof(rim) / sizeof(rim[0]);
+		const float center[2] = { 30.5f, 21.5f };
+
+		std::vector<int> coverage(size.w * size.h, 0);
+		Image image;
+		for (int i = 0; i < rimCount; i++) {
+			const float* a = rim[i];
+			const float* b = rim[(i + 1) % rimCount];
+			const float* pixels[3] = { center, a, b };
+			float clip[3][4];
+			for (int v = 0; v < 3; v++) {
+				clip[v][0] = pixels[v][0] * 2.0f / size.w - 1.0f;
+				clip[v][1] = 1.0f - pixels[v][1] * 2.0f / size.h;
+				clip[v][2] = 0.5f;
+				clip[v][3] = 1.0f;
+			}
+			rasterizer.ClearTarget(0);
+			rasterizer.ClearDepth(1.0f);
+			rasterizer.DrawTriangle(clip, viewport, viewport, 0xffffffff);
+			rasterizer.Resolve(0, image);
+			for (int p = 0; p < size.w * size.h; p++) {
+				coverage[p] += image.Pixels[p] != 0 ? 1 : 0;
+			}
+		}
+
+		// Pixels on the left and top edges of the rectangle are inside, on the right and bottom not.
+		for (int y = 0; y < size.h; y++) {
+			for (int x = 0; x < size.w; x++) {
+				bool inside = x + 0.5f >= left && x + 0.5f < right && y + 0.5f >= top && y + 0.5f < bottom;
+				if (coverage[y * size.w + x] != (inside ? 1 : 0)) {
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+}
+
+bool RunSoftwareRasterBenchmark(unsigned int iterations) {
+	bool passed = true;
+	for (int r = 0; r < 2; r++) {
+		if (!CheckSharedEdges(r == 1)) {
+			std::printf("  Shared edges covered twice or not at all (%s)\n", r == 1 ? "reference" : "tiled");
+			passed = false;
+		}
+	}
+	if (passed) {
+		std::printf("Shared edges: every pixel covered once\n");
+	}
+
+	Scene scene;
+	AddDefaultSceneContent(scene);
+	unsigned int state = 1234;
+	const Vector3 up = { 0.0f, 1.0f, 0.0f };
+	for (unsigned int i = 0; i < SceneObjectCount; i++) {
+		Vector3 position = { (NextRandom(state) * 2.0f - 1.0f) * 30.0f, (NextRandom(state) * 2.0f - 1.0f) * 10.0f, (NextRandom(state) * 2.0f - 1.0f) * 30.0f };
+		scene.AddObject(0, position, QuaternionFromAxisAngle(up, NextRandom(state) * 6.2831853f), 0.5f + NextRandom(state));
+	}
+
+	// Tiled against reference, and on more threads.
+	const RenderSettings configurations[] = {
+		{ StereoMode_MultiPass, 4, false, 1.0f, false, 1 },
+		{ StereoMode_Instanced, 4, false, 1.0f, false, 1 },
+		{ StereoMode_MultiPass, 1, false, 1.0f, false, 1 },
+		{ StereoMode_MultiPass, 4, true, 0.5f, false, 1 },
+		{ StereoMode_Instanced, 1, true, 0.5f, false, 1 },
+		{ StereoMode_MultiPass, 4, true, 1.0f, false, 1 },
+	};
+	const int configurationCount = sizeof(configurations) / sizeof(configurations[0]);
+	Image images[configurationCount];
+	for (int c = 0; c < configurationCount; c++) {
+		Render(configurations[c], scene, 1, images[c]);
+		RenderSettings reference = configurations[c];
+		reference.Reference = true;
+		Image referenceImage;
+		Render(reference, scene, 1, referenceImage);
+		RenderSettings threaded = configurations[c];
+		threaded.Threads = 4;
+		Image threadedImage;
+		Render(threaded, scene, 1, threadedImage);
+
+		ImageDifference referenceDifference = CompareImages(images[c], referenceImage, 0);
+		ImageDifference threadedDifference = CompareImages(images[c], threadedImage, 0);
+		std::printf("%-46s %llu pixels differ from reference, %llu with 4 threads\n", Describe(configurations[c]),
+			referenceDifference.DifferentPixels, threadedDifference.DifferentPixels);
+		if (referenceDifference.DifferentPixels > 0 || threadedDifference.DifferentPixels > 0) {
+			passed = false;
+		}
+	}
+
+	// The same frame drawn differently.
+	const int comparisons[][2] = { { 0, 1 }, { 0, 5 } };
+	for (int i = 0; i < 2; i++) {
+		const Image& a = images[comparisons[i][0]];
+		ImageDifference difference = CompareImages(a, images[comparisons[i][1]], 0);
+		double fraction = static_cast<double>(difference.DifferentPixels) / (a.Size.w * a.Size.h);
+		std::printf("%s against ", Describe(configurations[comparisons[i][0]]));
+		std::printf("%s: %.4f%% of pixels differ\n", Describe(configurations[comparisons[i][1]]), fraction * 100.0);
+		if (fraction > MaxDifferentPixels) {
+			passed = false;
+		}
+	}
+
+	// Throughput on whole frames, CPU side of the frame loop included.
+	unsigned int frameCount = iterations / 100000 + 1;
+	std::printf("Per frame, %u objects, %dx%d:\n", SceneObjectCount, images[0].Size.w, images[0].Size.h);
+	const int sampleCounts[] = { 1, 4 };
+	for (int s = 0; s < 2; s++) {
+		RenderSettings settings = { StereoMode_MultiPass, sampleCounts[s], false, 1.0f, true, 1 };
+		Image image;
+		double reference = Render(settings, scene, frameCount, image);
+		settings.Reference = false;
+		double tiled = Render(settings, scene, frameCount, image);
+		settings.Threads = 4;
+		double threaded = Render(settings, scene, frameCount, image);
+		std::printf("  %dx MSAA: %8.2f ms reference, %8.2f ms tiled (%.1fx), %8.2f ms tiled on 4 threads\n", sampleCounts[s],
+			reference * 1000.0, tiled * 1000.0, reference / tiled, threaded * 1000.0);
+	}
+	return passed;
+}
@@ -0,0 +1,193 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#include "Benchmarks.h"
+#include "Clock.h"
+#include "FrameLoop.h"
+#include "NullRenderDevice.h"
+#include "SimulatedHmd.h"
+#include "VrMath.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+/*
+	StereoMode_Instanced against StereoMode_MultiPass. Random points are projected for random eye
+	poses through each eye's own view-projection and viewport, as multi-pass draws them, and
+	through ComputeStereoConstants' matrix for the whole eye texture with its clip rectangle, as
+	instanced draws them. Both have to put every point on the same pixel, within Tolerance, and
+	agree on whether it is inside the eye's viewport, except for points within Tolerance of its
+	edges. This is checked at full resolution and at a scale that makes the viewports odd sized.
+
+	Then the frame loop draws a scattered scene both ways on the null device, which times how much
+	CPU instancing saves per frame.
+*/
+
+namespace {
+	const float Tolerance = 0.015f; // Pixels
+	const int PoseCount = 200;
+	const int PointsPerPose = 1000;
+	const float MinW = 0.1f; // Closer to the eye the projection magnifies rounding without bound
+	const float PointRange = 20.0f;
+	const unsigned int TimedFrames = 1000;
+	const unsigned int SceneObjectCount = 1000;
+
+	// Deterministic, so every run checks the same points.
+	float NextRandom(unsigned int& state, float low, float high) {
+		state = state * 1664525u + 1013904223u;
+		return low + (high - low) * ((state >> 8) / 16777216.0f);
+	}
+
+	struct ClipPosition {
+		float x, y, z, w;
+	};
+
+	ClipPosition Multiply(const Matrix4& m, const Vector3& p) {
+		ClipPosition result;
+		result.x = m.M[0][0] * p.x + m.M[0][1] * p.y + m.M[0][2] * p.z + m.M[0][3];
+		result.y = m.M[1][0] * p.x + m.M[1][1] * p.y + m.M[1][2] * p.z + m.M[1][3];
+		result.z = m.M[2][0] * p.x + m.M[2][1] * p.y + m.M[2][2] * p.z + m.M[2][3];
+		result.w = m.M[3][0] * p.x + m.M[3][1] * p.y + m.M[3][2] * p.z + m.M[3][3];
+		return result;
+	}
+
+	struct ProjectionErrors {
+		float MaxPixelError;
+		unsigned int InsidePoints;
+		unsigned int Mismatches; // Inside one way and not the other
+	};
+
+	ProjectionErrors CheckProjections(const StereoSetup& setup, const EyeRenderDesc eyeRenderDesc[EyeCount]) {
+		ProjectionErrors errors = { 0.0f, 0, 0 };
+		unsigned int state = 2468;
+		float targetWidth = static_cast<float>(setup.RenderTargetSize.w);
+		float targetHeight = static_cast<float>(setup.RenderTargetSize.h);
+		for (int i = 0; i < PoseCount; i++) {
+			Pose poses[EyeCount];
+			for (int eye = 0; eye < EyeCount; eye++) {
+				Quaternion q = { NextRandom(state, -1, 1), NextRandom(state, -1, 1), NextRandom(state, -1, 1), NextRandom(state, -1, 1) };
+				poses[eye].Orientation = Normalized(q);
+				poses[eye].Position.x = NextRandom(state, -1, 1);
+				poses[eye].Position.y = NextRandom(state, -1, 1);
+				poses[eye].Position.z = NextRandom(state, -1, 1);
+			}
+			StereoConstants stereo = ComputeStereoConstants(setup, eyeRenderDesc, poses);
+
+			for (int eye = 0; eye < EyeCount; eye++) {
+				Matrix4 multiPass = ComputeEyeViewProjection(eyeRenderDesc[eye], poses[eye]);
+				Matrix4 instanced = Transposed(stereo.ViewProjection[eye]);
+				const Rect2i& viewport = setup.EyeRenderViewport[eye];
+				const float* clipRect = stereo.ClipRect[eye];
+				for (int j = 0; j < PointsPerPose; j++) {
+					Vector3 point = { NextRandom(state, -PointRange, PointRange), NextRandom(state, -PointRange, PointRange), NextRandom(state, -PointRange, PointRange) };
+					ClipPosition a = Multiply(multiPass, point);
+					ClipPosition b = Multiply(instanced, point);
+					if (a.w < MinW) {
+						continue;
+					}
+
+					// Multi-pass: the eye's viewport. Instanced: the whole texture, clipped to the eye.
+					float ax = viewport.Pos.x + (a.x / a.w * 0.5f + 0.5f) * viewport.Size.w;
+					float ay = viewport.Pos.y + (0.5f - a.y / a.w * 0.5f) * viewport.Size.h;
+					float bx = (b.x / b.w * 0.5f + 0.5f) * targetWidth;
+					float by = (0.5f - b.y / b.w * 0.5f) * targetHeight;
+					bool insideA = std::fabs(a.x) <= a.w && std::fabs(a.y) <= a.w;
+					bool insideB = b.x >= clipRect[0] * b.w && b.x <= clipRect[1] * b.w && b.y >= clipRect[2] * b.w && b.y <= clipRect[3] * b.w;
+
+					float edgeDistance = std::min(std::min(std::fabs(ax - viewport.Pos.x), std::fabs(ax - viewport.Pos.x - viewport.Size.w)),
+						std::min(std::fabs(ay - viewport.Pos.y), std::fabs(ay - viewport.Pos.y - viewport.Size.h)));
+					if (insideA != insideB && edgeDistance > Tolerance) {
+						errors.Mismatches++;
+					}
+					if (insideA) {
+						errors.InsidePoints++;
+						errors.MaxPixelError = std::max(errors.MaxPixelError, std::max(std::fabs(ax - bx), std::fabs(ay - by)));
+					}
+				}
+			}
+		}
+		return errors;
+	}
+
+	// Seconds per frame, and the draws of the last frame's device.
+	double TimeFrameLoop(StereoMode mode, const Scene& scene, unsigned long long& outDraws) {
+		PoseScript script;
+		SimulatedHmd hmd(script);
+		StereoSetup setup = CreateStereoSetup(hmd, 1.0f);
+		setup.Mode = mode;
+		NullRenderDevice device(setup.RenderTargetSize, 1);
+		JobSystem jobs(1);
+		auto start = ReadClock();
+		for (unsigned int frame = 0; frame < TimedFrames; frame++) {
+			RenderFrame(hmd, device, setup, scene, jobs);
+		}
+		outDraws = device.GetStatistics().Draws;
+		return ClockTicksToSeconds(ReadClock() - start) / TimedFrames;
+	}
+}
+
+bool RunStereoProjectionBenchmark(unsigned int iterations) {
+	bool passed = true;
+	PoseScript script;
+	SimulatedHmd hmd(script);
+	EyeRenderDesc eyeRenderDesc[EyeCount] = { hmd.GetEyeRenderDesc(0), hmd.GetEyeRenderDesc(1) };
+
+	// At full size and at one that leaves odd widths and heights.
+	const float scales[] = { 1.0f, 0.737f };
+	for (int s = 0; s < 2; s++) {
+		StereoSetup setup = CreateStereoSetup(hmd, 1.0f);
+		SetResolutionScale(setup, scales[s]);
+		ProjectionErrors errors = CheckProjections(setup, eyeRenderDesc);
+		std::printf("Viewports %dx%d and %dx%d in %dx%d: %u points inside, max %.4f px apart, %u inside one way only\n",
+			setup.EyeRenderViewport[0].Size.w, setup.EyeRenderViewport[0].Size.h, setup.EyeRenderViewport[1].Size.w, setup.EyeRenderViewport[1].Size.h,
+			setup.RenderTargetSize.w, setup.RenderTargetSize.h, errors.InsidePoints, errors.MaxPixelError, errors.Mismatches);
+		if (errors.InsidePoints == 0 || errors.MaxPixelError > Tolerance || errors.Mismatches > 0) {
+			std::printf("  FAILED: instanced stereo doesn't put points where multi-pass does\n");
+			passed = false;
+		}
+	}
+
+	Scene scene;
+	AddDefaultSceneContent(scene);
+	unsigned int state = 1357;
+	const Vector3 up = { 0.0f, 1.0f, 0.0f };
+	for (unsigned int i = 0; i < SceneObjectCount; i++) {
+		Vector3 position = { NextRandom(state, -30.0f, 30.0f), NextRandom(state, -10.0f, 10.0f), NextRandom(state, -30.0f, 30.0f) };
+		scene.AddObject(0, position, QuaternionFromAxisAngle(up, NextRandom(state, 0.0f, 6.2831853f)), NextRandom(state, 0.5f, 1.5f));
+	}
+	unsigned long long multiPassDraws = 0;
+	unsigned long long instancedDraws = 0;
+	double multiPassSeconds = TimeFrameLoop(StereoMode_MultiPass, scene, multiPassDraws);
+	double instancedSeconds = TimeFrameLoop(StereoMode_Instanced, scene, instancedDraws);
+	std::printf("Frame loop, %u objects: multi-pass %.2f us (%llu draws), instanced %.2f us (%llu draws) per frame\n", SceneObjectCount,
+		multiPassSeconds * 1e6, multiPassDraws / TimedFrames, instancedSeconds * 1e6, instancedDraws / TimedFrames);
+	if (instancedDraws * 2 != multiPassDraws) {
+		std::printf("  FAILED: instancing doesn't draw each object once for both eyes\n");
+		passed = false;
+	}
+	return passed;
+}
@@ -0,0 +1,216 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#include "Benchmarks.h"
+#include "Clock.h"
+#include "NullRenderDevice.h"
+#include "ResourceStreamer.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+/*
+	Streaming a mesh file in with ResourceStreamer, compared with Scene::LoadMeshFile. The file
+	has meshes from empty to several blocks long. Once streamed, the scene has to hold the same
+	meshes with the same vertices and bounds as a synchronous load, all resident, and the device
+	has to have received every vertex. No frame may commit more than its budget (or one block),
+	however far the background threads get ahead. Files that don't exist or are cut short fail
+	without holding up the ones queued after them.
+
+	The staging ring is kept small so the threads run into it, then the frames it takes and the
+	cost of CommitUploads are timed, the latter being what the frame loop pays.
+*/
+
+namespace {
+	const char* MeshPath = "SimpleOVR_StreamingBenchmark.mesh";
+	const char* TruncatedPath = "SimpleOVR_StreamingBenchmark_truncated.mesh";
+	const int MeshCount = 40;
+	const unsigned int MaxMeshVertices = 30000;
+	const unsigned int StagingCapacity = 256 * 1024;
+	const unsigned int BytesPerFrame = 128 * 1024;
+	const unsigned int MaxFrames = 1000000;
+	const Size2i EyeTextureSize = { 64, 64 };
+
+	float NextRandom(unsigned int& state) {
+		state = state * 1664525u + 1013904223u;
+		return (state >> 8) * (1.0f / 16777216.0f);
+	}
+
+	bool WriteMeshFiles() {
+		Scene scene;
+		unsigned int state = 4321;
+		std::vector<Vertex> vertices;
+		for (int i = 0; i < MeshCount; i++) {
+			// The first one is empty, a few are exactly one block.
+			unsigned int count = i == 0 ? 0 : i % 7 == 0 ? ResourceStreamer::BlockSize / sizeof(Vertex) : static_cast<unsigned int>(NextRandom(state) * MaxMeshVertices) / 3 * 3;
+			vertices.resize(count);
+			for (unsigned int v = 0; v < count; v++) {
+				for (int axis = 0; axis < 3; axis++) {
+					vertices[v].Position[axis] = NextRandom(state) * 10.0f - 5.0f + i;
+				}
+			}
+			scene.AddMesh(vertices.empty() ? nullptr : vertices.data(), count);
+		}
+		if (!SaveMeshFile(MeshPath, scene)) {
+			return false;
+		}
+
+		// Same file, cut off in the middle of the vertices.
+		FILE* in = std::fopen(MeshPath, "rb");
+		if (in == nullptr) {
+			return false;
+		}
+		std::vector<unsigned char> contents;
+		unsigned char buffer[4096];
+		size_t read;
+		while ((read = std::fread(buffer, 1, sizeof(buffer), in)) > 0) {
+			contents.insert(contents.end(), buffer, buffer + read);
+		}
+		std::fclose(in);
+		FILE* out = std::fopen(TruncatedPath, "wb");
+		if (out == nullptr) {
+			return false;
+		}
+		bool written = std::fwrite(contents.data(), contents.size() / 2, 1, out) == 1;
+		return std::fclose(out) == 0 && written;
+	}
+
+	bool SameMesh(const Scene& expectedScene, int expectedMesh, const Scene& scene, int mesh) {
+		const Mesh& expected = expectedScene.GetMesh(expectedMesh);
+		const Mesh& actual = scene.GetMesh(mesh);
+		if (!actual.Resident || actual.VertexCount != expected.VertexCount || actual.BoundsRadius != expected.BoundsRadius ||
+			actual.BoundsCenter.x != expected.BoundsCenter.x || actual.BoundsCenter.y != expected.BoundsCenter.y || actual.BoundsCenter.z != expected.BoundsCenter.z) {
+			return false;
+		}
+		return expected.VertexCount == 0 ||
+			std::memcmp(&expectedScene.GetVertices()[expected.FirstVertex], &scene.GetVertices()[actual.FirstVertex], expected.VertexCount * sizeof(Vertex)) == 0;
+	}
+
+	struct StreamResult {
+		bool Completed;
+		bool WithinBudget;
+		unsigned int Frames;
+		double CommitSeconds;
+		double MaxCommitSeconds;
+		ResourceStreamer::Statistics Statistics;
+	};
+
+	// Commits once per "frame" until request is done, or has failed.
+	StreamResult Stream(ResourceStreamer& streamer, int request, Scene& scene, NullRenderDevice& device) {
+		StreamResult result;
+		std::memset(&result, 0, sizeof(result));
+		result.WithinBudget = true;
+		unsigned int limit = std::max(streamer.GetBytesPerFrame(), ResourceStreamer::BlockSize);
+		while (!streamer.IsComplete(request) && !streamer.IsFailed(request) && result.Frames < MaxFrames) {
+			auto start = ReadClock();
+			streamer.CommitUploads(scene, device);
+			double seconds = ClockTicksToSeconds(ReadClock() - start);
+			result.CommitSeconds += seconds;
+			result.MaxCommitSeconds = std::max(result.MaxCommitSeconds, seconds);
+			if (streamer.GetStatistics().LastFrameBytes > limit) {
+				result.WithinBudget = false;
+			}
+			result.Frames++;
+			// The rest of the frame, leaving the threads some time even on a single core.
+			std::this_thread::yield();
+		}
+		result.Completed = streamer.IsComplete(request);
+		result.Statistics = streamer.GetStatistics();
+		return result;
+	}
+}
+
+bool RunStreamingBenchmark(unsigned int iterations) {
+	if (!WriteMeshFiles()) {
+		std::printf("FAILED writing %s\n", MeshPath);
+		return false;
+	}
+
+	Scene expected;
+	auto loadStart = ReadClock();
+	bool loaded = expected.LoadMeshFile(MeshPath);
+	double loadSeconds = ClockTicksToSeconds(ReadClock() - loadStart);
+	unsigned long long fileBytes = expected.GetVertices().size() * sizeof(Vertex);
+	bool passed = loaded;
+
+	// Two broken files ahead of the real one.
+	{
+		Scene scene;
+		NullRenderDevice device(EyeTextureSize, 1);
+		ResourceStreamer streamer(2, StagingCapacity, BytesPerFrame);
+		int missing = streamer.RequestMeshFile("SimpleOVR_StreamingBenchmark_missing.mesh");
+		int truncated = streamer.RequestMeshFile(TruncatedPath);
+		int request = streamer.RequestMeshFile(MeshPath);
+		StreamResult result = Stream(streamer, request, scene, device);
+
+		bool same = result.Completed && streamer.GetMeshCount(request) == expected.GetMeshCount() && scene.GetMeshCount() == expected.GetMeshCount();
+		for (int i = 0; same && i < expected.GetMeshCount(); i++) {
+			same = SameMesh(expected, i, scene, streamer.GetSceneMesh(request, i));
+		}
+		bool uploaded = device.GetSceneVertexCount() == scene.GetVertices().size() && device.GetStatistics().UploadBytes == fileBytes;
+		bool failed = streamer.IsFailed(missing) && streamer.IsFailed(truncated) && result.Statistics.Failures == 2;
+
+		std::printf("Streamed %d meshes, %llu KB in %u frames: %s, %s, %s, %s\n", scene.GetMeshCount(), fileBytes / 1024, result.Frames,
+			same ? "same as a synchronous load" : "FAILED to match a synchronous load",
+			uploaded ? "all uploaded" : "FAILED to upload everything",
+			result.WithinBudget ? "within budget" : "FAILED to keep to the budget",
+			failed ? "broken files failed" : "FAILED to reject broken files");
+		std::printf("  %llu uploads, %llu staging stalls, %llu budget stalls, %u blocks and %u bytes left staged\n", result.Statistics.Uploads,
+			result.Statistics.StagingStalls, result.Statistics.BudgetStalls, result.Statistics.QueueDepth, result.Statistics.StagingBytes);
+		if (!same || !uploaded || !result.WithinBudget || !failed || result.Statistics.QueueDepth != 0 || result.Statistics.StagingBytes != 0) {
+			passed = false;
+		}
+	}
+
+	// Timing, with a budget that doesn't hold the threads back.
+	unsigned int runs = iterations / 20000 + 1;
+	double streamSeconds = 0.0;
+	double commitSeconds = 0.0;
+	double maxCommitSeconds = 0.0;
+	unsigned long long frames = 0;
+	for (unsigned int run = 0; run < runs; run++) {
+		Scene scene;
+		NullRenderDevice device(EyeTextureSize, 1);
+		auto start = ReadClock();
+		ResourceStreamer streamer(2, StagingCapacity, StagingCapacity);
+		StreamResult result = Stream(streamer, streamer.RequestMeshFile(MeshPath), scene, device);
+		streamSeconds += ClockTicksToSeconds(ReadClock() - start);
+		commitSeconds += result.CommitSeconds;
+		maxCommitSeconds = std::max(maxCommitSeconds, result.MaxCommitSeconds);
+		frames += result.Frames;
+		passed = passed && result.Completed;
+	}
+	std::printf("Synchronous load: %.3f ms, streamed: %.3f ms in %.1f frames, CommitUploads %.2f us per frame, %.2f us at most\n",
+		loadSeconds * 1000.0, streamSeconds * 1000.0 / runs, static_cast<double>(frames) / runs,
+		frames > 0 ? commitSeconds * 1e6 / frames : 0.0, maxCommitSeconds * 1e6);
+
+	std::remove(MeshPath);
+	std::remove(TruncatedPath);
+	return passed;
+}
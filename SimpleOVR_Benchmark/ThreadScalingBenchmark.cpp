@@ -0,0 +1,181 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+
+#include "Benchmarks.h"
+#include "Clock.h"
+#include "FrameLoop.h"
+#include "JobSystem.h"
+#include "NullRenderDevice.h"
+#include "SimulatedHmd.h"
+#include "VrMath.h"
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+/*
+	The frame loop on 1 to 16 threads with a large scene, against NullRenderDevice. Culling and
+	the record jobs (world matrices and draws) are spread over the threads, so that is what
+	scales; the rest of the frame stays on the calling thread. Every thread count has to draw
+	exactly what the single threaded frame loop does, and none of it while the constants are still
+	mapped.
+
+	The JobSystem itself is checked first: uneven jobs, every index run exactly once.
+*/
+
+namespace {
+	const unsigned int ObjectCount = 100000;
+	const int ThreadCounts[] = { 1, 2, 4, 8, 16 };
+
+	// Deterministic, so every run uses the same scene.
+	float NextRandom(unsigned int& state) {
+		state = state * 1664525u + 1013904223u;
+		return (state >> 8) * (1.0f / 16777216.0f);
+	}
+
+	bool CheckJobSystem() {
+		const unsigned int count = 10000;
+		std::vector<std::atomic<unsigned int> > runs(count);
+		bool passed = true;
+		for (size_t t = 0; t < sizeof(ThreadCounts) / sizeof(ThreadCounts[0]); t++) {
+			JobSystem jobs(ThreadCounts[t]);
+			for (int round = 0; round < 20; round++) {
+				for (unsigned int i = 0; i < count; i++) {
+					runs[i].store(0);
+				}
+				std::atomic<int> badThread(0);
+				jobs.ParallelFor(count, [&](unsigned int index, int thread) {
+					// The first indices take much longer, so the other threads have to steal them.
+					if (index < count / 16) {
+						volatile float x = 1.0f;
+						for (int spin = 0; spin < 200; spin++) {
+							x = x * 1.0001f;
+						}
+					}
+					if (thread < 0 || thread >= jobs.GetThreadCount()) {
+						badThread++;
+					}
+					runs[index]++;
+				});
+				for (unsigned int i = 0; i < count; i++) {
+					if (runs[i].load() != 1) {
+						std::printf("  %d threads: index %u ran %u times\n", ThreadCounts[t], i, runs[i].load());
+						return false;
+					}
+				}
+				if (badThread.load() != 0) {
+					std::printf("  %d threads: bad thread index\n", ThreadCounts[t]);
+					passed = false;
+				}
+			}
+		}
+		return passed;
+	}
+
+	struct FrameResult {
+		double Seconds;
+		NullRenderDevice::Statistics Statistics;
+		unsigned long long Visible;
+		unsigned char ObjectConstants[sizeof(Matrix4)];
+	};
+
+	FrameResult RunFrames(const Scene& scene, int threadCount, StereoMode mode, unsigned int frameCount) {
+		PoseScript script;
+		SimulatedHmd hmd(script);
+		StereoSetup setup = CreateStereoSetup(hmd, 1.0f);
+		setup.Mode = mode;
+		NullRenderDevice device(setup.RenderTargetSize, 1);
+		device.SetSceneVertices(&scene.GetVertices()[0], static_cast<unsigned int>(scene.GetVertices().size()));
+		JobSystem jobs(threadCount);
+
+		FrameResult result;
+		result.Visible = 0;
+		auto start = ReadClock();
+		for (unsigned int frame = 0; frame < frameCount; frame++) {
+			RenderFrame(hmd, device, setup, scene, jobs);
+			result.Visible += setup.VisibleObjects.size();
+		}
+		result.Seconds = ClockTicksToSeconds(ReadClock() - start);
+		result.Statistics = device.GetStatistics();
+		std::memcpy(result.ObjectConstants, device.GetConstants(ConstantSlot_Object), sizeof(result.ObjectConstants));
+		return result;
+	}
+
+	// Each record job sets its viewport, so only the viewport changes may differ.
+	bool SameFrames(const FrameResult& a, const FrameResult& b) {
+		const NullRenderDevice::Statistics& x = a.Statistics;
+		const NullRenderDevice::Statistics& y = b.Statistics;
+		return a.Visible == b.Visible && x.Draws == y.Draws && x.Instances == y.Instances && x.Vertices == y.Vertices &&
+			x.ConstantBytes == y.ConstantBytes &&
+			std::memcmp(a.ObjectConstants, b.ObjectConstants, sizeof(a.ObjectConstants)) == 0;
+	}
+}
+
+bool RunThreadScalingBenchmark(unsigned int iterations) {
+	bool passed = CheckJobSystem();
+	if (passed) {
+		std::printf("Job system: every index ran once with 1 to 16 threads\n");
+	}
+
+	Scene scene;
+	AddDefaultSceneContent(scene);
+	unsigned int state = 4242;
+	const Vector3 up = { 0.0f, 1.0f, 0.0f };
+	for (unsigned int i = 0; i < ObjectCount; i++) {
+		Vector3 position = { (NextRandom(state) * 2.0f - 1.0f) * 50.0f, (NextRandom(state) * 2.0f - 1.0f) * 10.0f, (NextRandom(state) * 2.0f - 1.0f) * 50.0f };
+		scene.AddObject(0, position, QuaternionFromAxisAngle(up, NextRandom(state) * 6.2831853f), 0.5f + NextRandom(state));
+	}
+
+	unsigned int frameCount = iterations / 20000 + 1;
+	std::printf("%u objects, %u frames, %d hardware threads\n", scene.GetObjectCount(), frameCount, JobSystem::GetHardwareThreadCount());
+	const StereoMode modes[] = { StereoMode_MultiPass, StereoMode_Instanced };
+	for (int m = 0; m < 2; m++) {
+		std::printf("%s:\n", modes[m] == StereoMode_Instanced ? "Instanced" : "Multi-pass");
+		FrameResult single;
+		for (size_t t = 0; t < sizeof(ThreadCounts) / sizeof(ThreadCounts[0]); t++) {
+			// Once untimed, so the scratch buffers are allocated and the threads are up.
+			RunFrames(scene, ThreadCounts[t], modes[m], 1);
+			FrameResult result = RunFrames(scene, ThreadCounts[t], modes[m], frameCount);
+			if (t == 0) {
+				single = result;
+			}
+			else if (!SameFrames(single, result)) {
+				std::printf("  %d threads drew something else than 1 thread\n", ThreadCounts[t]);
+				passed = false;
+			}
+			if (result.Statistics.MappedDraws > 0) {
+				std::printf("  FAILED: %d threads drew %llu times with the constants mapped\n", ThreadCounts[t], result.Statistics.MappedDraws);
+				passed = false;
+			}
+			std::printf("  %2d threads: %8.1f us/frame (%.2fx), %.0f visible\n", ThreadCounts[t], result.Seconds * 1e6 / frameCount,
+				single.Seconds / result.Seconds, static_cast<double>(result.Visible) / frameCount);
+		}
+	}
+
+	return passed;
+}
@@ -0,0 +1,222 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+/*
+	Replays command captures (see CommandCapture.h) on a device of its own, without the frame
+	loop, the scene or a headset, so what a run asked of the device can be timed, inspected and
+	drawn again offline, as often as needed and exactly the same every time.
+
+	Building:
+
+	Visual Studio 2013:
+		Build the SimpleOVR_CommandReplay project. It does not need LibOVR.
+
+	Linux (or anything else with a C++11 compiler):
+		g++ -std=c++11 -O2 -pthread -I../SimpleOVR_Common -o SimpleOVR_CommandReplay SimpleOVR_CommandReplay.cpp ../SimpleOVR_Common/[A-Z]*.cpp
+
+	Usage:
+		SimpleOVR_CommandReplay [--device null|software] [--threads N] [--first N] [--count N] [--repeat N] [--write-image FILE] [--compare-image FILE] FILE
+
+	Captures are written by the D3D11 sample (CommandCapturePath) and by SimpleOVR_Headless
+	(--capture).
+
+	Frames before --first are replayed untimed, since later frames depend on the state they set.
+	The --count frames after that (all of them by default) are replayed --repeat times, 1 by
+	default, and each replay of a frame is timed. The device is NullRenderDevice unless
+	--device software asks for SoftwareRenderDevice, drawing with --threads threads.
+
+	--write-image and --compare-image work like SimpleOVR_Headless': with the software device the
+	image is what the display showed last, or the eye texture if nothing was presented.
+*/
+
+#include "Clock.h"
+#include "CommandCapture.h"
+#include "JobSystem.h"
+#include "NullRenderDevice.h"
+#include "SimulatedHmd.h"
+#include "SoftwareRenderDevice.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+namespace {
+	// Of sorted times, in microseconds.
+	double Percentile(const std::vector<double>& sorted, double fraction) {
+		size_t index = static_cast<size_t>(fraction * (sorted.size() - 1) + 0.5);
+		return sorted[index] * 1e6;
+	}
+}
+
+int main(int argc, char* argv[]) {
+	bool software = false;
+	int threadCount = 1;
+	unsigned int first = 0;
+	unsigned int count = 0;
+	bool countGiven = false;
+	unsigned int repeat = 1;
+	const char* writeImagePath = nullptr;
+	const char* compareImagePath = nullptr;
+	const char* path = nullptr;
+
+	for (int i = 1; i < argc; i++) {
+		if (std::strcmp(argv[i], "--device") == 0 && i + 1 < argc) {
+			software = std::strcmp(argv[++i], "software") == 0;
+		}
+		else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+			threadCount = std::atoi(argv[++i]);
+		}
+		else if (std::strcmp(argv[i], "--first") == 0 && i + 1 < argc) {
+			first = static_cast<unsigned int>(std::strtoul(argv[++i], nullptr, 10));
+		}
+		else if (std::strcmp(argv[i], "--count") == 0 && i + 1 < argc) {
+			count = static_cast<unsigned int>(std::strtoul(argv[++i], nullptr, 10));
+			countGiven = true;
+		}
+		else if (std::strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+			repeat = std::max(1u, static_cast<unsigned int>(std::strtoul(argv[++i], nullptr, 10)));
+		}
+		else if (std::strcmp(argv[i], "--write-image") == 0 && i + 1 < argc) {
+			writeImagePath = argv[++i];
+			software = true;
+		}
+		else if (std::strcmp(argv[i], "--compare-image") == 0 && i + 1 < argc) {
+			compareImagePath = argv[++i];
+			software = true;
+		}
+		else if (argv[i][0] != '-' && path == nullptr) {
+			path = argv[i];
+		}
+		else {
+			path = nullptr;
+			break;
+		}
+	}
+	if (path == nullptr) {
+		std::fprintf(stderr, "Usage: %s [--device null|software] [--threads N] [--first N] [--count N] [--repeat N] [--write-image FILE] [--compare-image FILE] FILE\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	CommandCapture capture;
+	if (!capture.Load(path)) {
+		std::fprintf(stderr, "Failed loading command capture %s\n", path);
+		return EXIT_FAILURE;
+	}
+	unsigned int frameCount = capture.GetFrameCount();
+	first = std::min(first, frameCount);
+	if (!countGiven || first + count > frameCount) {
+		count = frameCount - first;
+	}
+
+	// The capture doesn't know the display, it is the simulated HMD's like in SimpleOVR_Headless.
+	JobSystem jobs(threadCount);
+	std::unique_ptr<NullRenderDevice> deviceOwner;
+	SoftwareRenderDevice* softwareDevice = nullptr;
+	if (software) {
+		SimulatedHmd hmd((PoseScript()));
+		softwareDevice = new SoftwareRenderDevice(hmd.GetResolution(), capture.GetEyeTextureSize(), capture.GetMultisampleCount(), jobs);
+		deviceOwner.reset(softwareDevice);
+	}
+	else {
+		deviceOwner.reset(new NullRenderDevice(capture.GetEyeTextureSize(), capture.GetMultisampleCount()));
+	}
+	NullRenderDevice& device = *deviceOwner;
+
+	for (unsigned int frame = 0; frame < first; frame++) {
+		if (!capture.ReplayFrame(frame, device)) {
+			std::fprintf(stderr, "Failed replaying frame %u of %s\n", frame, path);
+			return EXIT_FAILURE;
+		}
+	}
+	std::vector<double> times;
+	times.reserve(static_cast<size_t>(count) * repeat);
+	size_t replayedBytes = 0;
+	for (unsigned int round = 0; round < repeat; round++) {
+		for (unsigned int frame = first; frame < first + count; frame++) {
+			ClockTicks start = ReadClock();
+			bool replayed = capture.ReplayFrame(frame, device);
+			times.push_back(ClockTicksToSeconds(ReadClock() - start));
+			if (!replayed) {
+				std::fprintf(stderr, "Failed replaying frame %u of %s\n", frame, path);
+				return EXIT_FAILURE;
+			}
+			replayedBytes += capture.GetFrameSize(frame);
+		}
+	}
+
+	std::printf("Capture: %s, %u frames, eye texture %dx%d, %dx MSAA\n", path, frameCount, capture.GetEyeTextureSize().w,
+		capture.GetEyeTextureSize().h, capture.GetMultisampleCount());
+	std::printf("Replayed: frames %u to %u, %u times, on the %s device, %.1f KB of records per frame\n", first, first + count, repeat,
+		software ? "software" : "null", times.empty() ? 0.0 : replayedBytes / 1024.0 / times.size());
+	if (!times.empty()) {
+		double total = 0.0;
+		for (size_t i = 0; i < times.size(); i++) {
+			total += times[i];
+		}
+		std::sort(times.begin(), times.end());
+		std::printf("Per frame: %.3f us mean, %.3f us median, %.3f us p99, %.3f us max\n", total * 1e6 / times.size(),
+			Percentile(times, 0.5), Percentile(times, 0.99), times.back() * 1e6);
+	}
+	const NullRenderDevice::Statistics& statistics = device.GetStatistics();
+	std::printf("Draws: %llu (%llu instances), constant uploads: %llu (%llu bytes, %llu maps), resolves: %llu, recorded commands: %llu, latches: %llu\n",
+		statistics.Draws, statistics.Instances, statistics.ConstantUpdates, statistics.ConstantBytes, statistics.ConstantMaps, statistics.Resolves,
+		statistics.RecordedCommands, statistics.Latches);
+	if (statistics.IndirectDraws > 0) {
+		std::printf("GPU: %llu instance uploads, %llu culls, %llu indirect draws\n", statistics.InstanceUploads, statistics.InstanceCulls,
+			statistics.IndirectDraws);
+	}
+	if (statistics.DistortedPresents > 0 || statistics.MaskedPixels > 0) {
+		std::printf("Presents: %llu distorted, %llu pixels masked\n", statistics.DistortedPresents, statistics.MaskedPixels);
+	}
+	const StateCache::Statistics& stateStatistics = device.GetStateStatistics();
+	std::printf("State: %llu calls issued, %llu filtered\n", stateStatistics.TotalIssued, stateStatistics.TotalFiltered);
+
+	if (softwareDevice == nullptr) {
+		return EXIT_SUCCESS;
+	}
+	const Image& finalImage = statistics.DistortedPresents > 0 ? softwareDevice->GetDisplayImage() : softwareDevice->GetImage();
+	if (writeImagePath != nullptr && !WriteImage(finalImage, writeImagePath)) {
+		std::fprintf(stderr, "Failed writing %s\n", writeImagePath);
+		return EXIT_FAILURE;
+	}
+	if (compareImagePath != nullptr) {
+		Image expected;
+		if (!ReadImage(compareImagePath, expected)) {
+			std::fprintf(stderr, "Failed reading %s\n", compareImagePath);
+			return EXIT_FAILURE;
+		}
+		ImageDifference difference = CompareImages(finalImage, expected, 0);
+		std::printf("Compared with %s: %llu pixels differ, by up to %d\n", compareImagePath, difference.DifferentPixels, difference.MaxChannelDifference);
+		if (difference.DifferentPixels > 0) {
+			return EXIT_FAILURE;
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,894 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+
+#include "CommandCapture.h"
+#include <algorithm>
+#include <cstring>
+
+const char CommandCaptureMagic[8] = { 'S', 'O', 'V', 'R', 'C', 'A', 'P', 'T' };
+
+namespace {
+	size_t GetPaddedSize(size_t size) {
+		return (size + 3) & ~static_cast<size_t>(3);
+	}
+
+	// Appends a record with room for size bytes of arguments, zeroed, and returns where they go.
+	unsigned char* AddRecord(std::vector<unsigned char>& records, CaptureCommand command, size_t size) {
+		CaptureRecordHeader header = { static_cast<unsigned int>(command), static_cast<unsigned int>(GetPaddedSize(size)) };
+		size_t start = records.size();
+		records.resize(start + sizeof(header) + header.Size, 0);
+		std::memcpy(&records[start], &header, sizeof(header));
+		return &records[start + sizeof(header)];
+	}
+
+	// Copies an argument into a record and returns where the next one goes.
+	unsigned char* Put(unsigned char* out, const void* data, size_t size) {
+		if (size > 0) {
+			std::memcpy(out, data, size);
+		}
+		return out + GetPaddedSize(size);
+	}
+
+	void AddRecord(std::vector<unsigned char>& records, CaptureCommand command, const void* arguments, size_t size) {
+		Put(AddRecord(records, command, size), arguments, size);
+	}
+
+	// A record's arguments, read in the order they were put.
+	struct ArgumentReader {
+		const unsigned char* Data;
+		size_t Size;
+		size_t Offset;
+
+		ArgumentReader(const unsigned char* data, size_t size) : Data(data), Size(size), Offset(0) {
+		}
+
+		// nullptr if the record is too short.
+		const unsigned char* Get(size_t size) {
+			size_t padded = GetPaddedSize(size);
+			if (padded > Size - Offset) {
+				return nullptr;
+			}
+			const unsigned char* argument = Data + Offset;
+			Offset += padded;
+			return argument;
+		}
+
+		// Arrays are 4 byte aligned, so they are used where they are in the file.
+		template <typename T>
+		const T* GetArray(unsigned int count) {
+			if (count > (Size - Offset) / sizeof(T)) {
+				return nullptr;
+			}
+			return reinterpret_cast<const T*>(Get(count * sizeof(T)));
+		}
+
+		template <typename T>
+		bool Read(T& outValue) {
+			const unsigned char* argument = Get(sizeof(T));
+			if (argument == nullptr) {
+				return false;
+			}
+			std::memcpy(&outValue, argument, sizeof(T));
+			return true;
+		}
+	};
+
+	bool ReadRecordHeader(const unsigned char* records, size_t size, size_t offset, CaptureRecordHeader& outHeader) {
+		if (size - offset < sizeof(outHeader)) {
+			return false;
+		}
+		std::memcpy(&outHeader, records + offset, sizeof(outHeader));
+		return outHeader.Size <= size - offset - sizeof(outHeader);
+	}
+}
+
+void CommandCaptureDevice::CaptureContext::SetViewport(const Rect2i& viewport) {
+	Target->SetViewport(viewport);
+	if (Capturing) {
+		AddRecord(Records, CaptureCommand_SetViewport, &viewport, sizeof(viewport));
+	}
+}
+
+void CommandCaptureDevice::CaptureContext::BindConstants(ConstantSlot slot, unsigned int offset, unsigned int size) {
+	Target->BindConstants(slot, offset, size);
+	if (Capturing) {
+		unsigned int arguments[] = { static_cast<unsigned int>(slot), offset, size };
+		AddRecord(Records, CaptureCommand_BindConstants, arguments, sizeof(arguments));
+	}
+}
+
+void CommandCaptureDevice::CaptureContext::BindLatchedConstants(ConstantSlot slot, int part) {
+	Target->BindLatchedConstants(slot, part);
+	if (Capturing) {
+		int arguments[] = { static_cast<int>(slot), part };
+		AddRecord(Records, CaptureCommand_BindLatchedConstants, arguments, sizeof(arguments));
+	}
+}
+
+void CommandCaptureDevice::CaptureContext::SetMaterial(int material) {
+	Target->SetMaterial(material);
+	if (Capturing) {
+		AddRecord(Records, CaptureCommand_SetMaterial, &material, sizeof(material));
+	}
+}
+
+void CommandCaptureDevice::CaptureContext::Draw(unsigned int vertexCount, unsigned int startVertex) {
+	Target->Draw(vertexCount, startVertex);
+	if (Capturing) {
+		unsigned int arguments[] = { vertexCount, startVertex };
+		AddRecord(Records, CaptureCommand_Draw, arguments, sizeof(arguments));
+	}
+}
+
+void CommandCaptureDevice::CaptureContext::DrawInstanced(unsigned int vertexCount, unsigned int instanceCount, unsigned int startVertex) {
+	Target->DrawInstanced(vertexCount, instanceCount, startVertex);
+	if (Capturing) {
+		unsigned int arguments[] = { vertexCount, instanceCount, startVertex };
+		AddRecord(Records, CaptureCommand_DrawInstanced, arguments, sizeof(arguments));
+	}
+}
+
+CommandCaptureDevice::CommandCaptureDevice(RenderDevice& device) :
+	device(device),
+	file(nullptr),
+	failed(false),
+	frameCount(0),
+	capturedBytes(0),
+	batchOpen(false)
+{
+	for (int i = 0; i < MaxRecordingContexts; i++) {
+		contexts[i].Target = nullptr;
+		contexts[i].Capturing = false;
+	}
+}
+
+CommandCaptureDevice::~CommandCaptureDevice() {
+	Close();
+}
+
+bool CommandCaptureDevice::Open(const char* path) {
+	Close();
+	file = std::fopen(path, "wb");
+	if (file == nullptr) {
+		return false;
+	}
+	failed = false;
+	frameCount = 0;
+	capturedBytes = 0;
+	frameRecords.clear();
+	batchRecords.clear();
+
+	CommandCaptureHeader header;
+	std::memcpy(header.Magic, CommandCaptureMagic, sizeof(header.Magic));
+	header.Version = CommandCaptureVersion;
+	header.EyeTextureSize = device.GetEyeTextureSize();
+	header.MultisampleCount = device.GetMultisampleCount();
+	failed = std::fwrite(&header, sizeof(header), 1, file) != 1;
+	return true;
+}
+
+bool CommandCaptureDevice::Close() {
+	if (file == nullptr) {
+		return !failed;
+	}
+	failed = std::fclose(file) != 0 || failed;
+	file = nullptr;
+	frameRecords.clear();
+	batchRecords.clear();
+	return !failed;
+}
+
+bool CommandCaptureDevice::IsOpen() const {
+	return file != nullptr;
+}
+
+void CommandCaptureDevice::EndFrame(const Pose eyeRenderPose[EyeCount]) {
+	if (file == nullptr) {
+		return;
+	}
+	AddRecord(frameRecords, CaptureCommand_EndFrame, eyeRenderPose, EyeCount * sizeof(Pose));
+	if (std::fwrite(&frameRecords[0], frameRecords.size(), 1, file) != 1) {
+		failed = true;
+	}
+	frameCount++;
+	capturedBytes += frameRecords.size();
+	frameRecords.clear();
+}
+
+unsigned int CommandCaptureDevice::GetFrameCount() const {
+	return frameCount;
+}
+
+unsigned long long CommandCaptureDevice::GetCapturedBytes() const {
+	return capturedBytes;
+}
+
+Size2i CommandCaptureDevice::GetEyeTextureSize() const {
+	return device.GetEyeTextureSize();
+}
+
+int CommandCaptureDevice::GetMultisampleCount() const {
+	return device.GetMultisampleCount();
+}
+
+std::vector<unsigned char>& CommandCaptureDevice::GetRecords() {
+	return batchOpen ? batchRecords : frameRecords;
+}
+
+void CommandCaptureDevice::ClearEyeTexture(const float color[4]) {
+	device.ClearEyeTexture(color);
+	if (file != nullptr) {
+		AddRecord(GetRecords(), CaptureCommand_ClearEyeTexture, color, 4 * sizeof(float));
+	}
+}
+
+void CommandCaptureDevice::ClearDepthStencil(float depth, unsigned char stencil) {
+	device.ClearDepthStencil(depth, stencil);
+	if (file != nullptr) {
+		unsigned int stencilArgument = stencil;
+		unsigned char* arguments = AddRecord(GetRecords(), CaptureCommand_ClearDepthStencil, sizeof(depth) + sizeof(stencilArgument));
+		Put(Put(arguments, &depth, sizeof(depth)), &stencilArgument, sizeof(stencilArgument));
+	}
+}
+
+void CommandCaptureDevice::BindEyeTexture() {
+	device.BindEyeTexture();
+	if (file != nullptr) {
+		AddRecord(GetRecords(), CaptureCommand_BindEyeTexture, 0);
+	}
+}
+
+void CommandCaptureDevice::SetViewport(const Rect2i& viewport) {
+	device.SetViewport(viewport);
+	if (file != nullptr) {
+		AddRecord(GetRecords(), CaptureCommand_SetViewport, &viewport, sizeof(viewport));
+	}
+}
+
+void CommandCaptureDevice::SetStereoMode(StereoMode mode) {
+	device.SetStereoMode(mode);
+	if (file != nullptr) {
+		int argument = mode;
+		AddRecord(GetRecords(), CaptureCommand_SetStereoMode, &argument, sizeof(argument));
+	}
+}
+
+void CommandCaptureDevice::SetSceneVertices(const Vertex* vertices, unsigned int vertexCount) {
+	device.SetSceneVertices(vertices, vertexCount);
+	if (file != nullptr) {
+		unsigned char* arguments = AddRecord(GetRecords(), CaptureCommand_SetSceneVertices, sizeof(vertexCount) + vertexCount * sizeof(Vertex));
+		Put(Put(arguments, &vertexCount, sizeof(vertexCount)), vertices, vertexCount * sizeof(Vertex));
+	}
+}
+
+void CommandCaptureDevice::UploadSceneVertices(unsigned int firstVertex, const Vertex* vertices, unsigned int vertexCount) {
+	device.UploadSceneVertices(firstVertex, vertices, vertexCount);
+	if (file != nullptr) {
+		unsigned int counts[] = { firstVertex, vertexCount };
+		unsigned char* arguments = AddRecord(GetRecords(), CaptureCommand_UploadSceneVertices, sizeof(counts) + vertexCount * sizeof(Vertex));
+		Put(Put(arguments, counts, sizeof(counts)), vertices, vertexCount * sizeof(Vertex));
+	}
+}
+
+void CommandCaptureDevice::BeginConstants() {
+	device.BeginConstants();
+	batchOpen = true;
+	allocations.clear();
+}
+
+void* CommandCaptureDevice::AllocateConstants(unsigned int size, unsigned int& outOffset) {
+	void* constants = device.AllocateConstants(size, outOffset);
+	if (constants != nullptr && file != nullptr) {
+		ConstantAllocation allocation = { static_cast<const unsigned char*>(constants), outOffset, size };
+		allocations.push_back(allocation);
+	}
+	return constants;
+}
+
+void CommandCaptureDevice::EndConstants() {
+	if (file != nullptr) {
+		// The constants are all written by now, and still mapped until the device's EndConstants.
+		unsigned int count = static_cast<unsigned int>(allocations.size());
+		size_t size = sizeof(count) + count * 2 * sizeof(unsigned int);
+		for (size_t i = 0; i < allocations.size(); i++) {
+			size += GetPaddedSize(allocations[i].Size);
+		}
+		unsigned char* arguments = Put(AddRecord(frameRecords, CaptureCommand_ConstantBatch, size), &count, sizeof(count));
+		for (size_t i = 0; i < allocations.size(); i++) {
+			unsigned int range[] = { allocations[i].Offset, allocations[i].Size };
+			arguments = Put(arguments, range, sizeof(range));
+		}
+		for (size_t i = 0; i < allocations.size(); i++) {
+			arguments = Put(arguments, allocations[i].Data, allocations[i].Size);
+		}
+		frameRecords.insert(frameRecords.end(), batchRecords.begin(), batchRecords.end());
+		AddRecord(frameRecords, CaptureCommand_EndConstants, 0);
+	}
+	device.EndConstants();
+	batchOpen = false;
+	batchRecords.clear();
+	allocations.clear();
+}
+
+void CommandCaptureDevice::BindConstants(ConstantSlot slot, unsigned int offset, unsigned int size) {
+	device.BindConstants(slot, offset, size);
+	if (file != nullptr) {
+		unsigned int arguments[] = { static_cast<unsigned int>(slot), offset, size };
+		AddRecord(GetRecords(), CaptureCommand_BindConstants, arguments, sizeof(arguments));
+	}
+}
+
+void CommandCaptureDevice::BindLatchedConstants(ConstantSlot slot, int part) {
+	device.BindLatchedConstants(slot, part);
+	if (file != nullptr) {
+		int arguments[] = { static_cast<int>(slot), part };
+		AddRecord(GetRecords(), CaptureCommand_BindLatchedConstants, arguments, sizeof(arguments));
+	}
+}
+
+void CommandCaptureDevice::SetMaterial(int material) {
+	device.SetMaterial(material);
+	if (file != nullptr) {
+		AddRecord(GetRecords(), CaptureCommand_SetMaterial, &material, sizeof(material));
+	}
+}
+
+void CommandCaptureDevice::Draw(unsigned int vertexCount, unsigned int startVertex) {
+	device.Draw(vertexCount, startVertex);
+	if (file != nullptr) {
+		unsigned int arguments[] = { vertexCount, startVertex };
+		AddRecord(GetRecords(), CaptureCommand_Draw, arguments, sizeof(arguments));
+	}
+}
+
+void CommandCaptureDevice::DrawInstanced(unsigned int vertexCount, unsigned int instanceCount, unsigned int startVertex) {
+	device.DrawInstanced(vertexCount, instanceCount, startVertex);
+	if (file != nullptr) {
+		unsigned int arguments[] = { vertexCount, instanceCount, startVertex };
+		AddRecord(GetRecords(), CaptureCommand_DrawInstanced, arguments, sizeof(arguments));
+	}
+}
+
+RenderContext& CommandCaptureDevice::BeginRecording(int context) {
+	CaptureContext& captureContext = contexts[context];
+	captureContext.Target = &device.BeginRecording(context);
+	captureContext.Capturing = file != nullptr;
+	return captureContext;
+}
+
+void CommandCaptureDevice::EndRecording(int context) {
+	device.EndRecording(context);
+}
+
+void CommandCaptureDevice::ExecuteRecordings(int count) {
+	device.ExecuteRecordings(count);
+	if (file != nullptr) {
+		size_t size = sizeof(count);
+		for (int i = 0; i < count; i++) {
+			size += sizeof(unsigned int) + contexts[i].Records.size();
+		}
+		unsigned char* arguments = Put(AddRecord(GetRecords(), CaptureCommand_ExecuteRecordings, size), &count, sizeof(count));
+		for (int i = 0; i < count; i++) {
+			unsigned int recordsSize = static_cast<unsigned int>(contexts[i].Records.size());
+			arguments = Put(arguments, &recordsSize, sizeof(recordsSize));
+			arguments = Put(arguments, contexts[i].Records.data(), recordsSize);
+		}
+	}
+	for (int i = 0; i < count; i++) {
+		contexts[i].Records.clear();
+	}
+}
+
+void CommandCaptureDevice::LatchConstants(int part, const void* data, unsigned int size) {
+	device.LatchConstants(part, data, size);
+	if (file != nullptr) {
+		int counts[] = { part, static_cast<int>(size) };
+		unsigned char* arguments = AddRecord(GetRecords(), CaptureCommand_LatchConstants, sizeof(counts) + size);
+		Put(Put(arguments, counts, sizeof(counts)), data, size);
+	}
+}
+
+void CommandCaptureDevice::SetFoveatedLayout(const FoveatedLayout* layout) {
+	device.SetFoveatedLayout(layout);
+	if (file != nullptr) {
+		int present = layout != nullptr;
+		unsigned char* arguments = Put(AddRecord(GetRecords(), CaptureCommand_SetFoveatedLayout, sizeof(present) + (present ? sizeof(FoveatedLayout) : 0)), &present, sizeof(present));
+		if (layout != nullptr) {
+			Put(arguments, layout, sizeof(FoveatedLayout));
+		}
+	}
+}
+
+bool CommandCaptureDevice::SetSceneInstances(const SceneInstance* instances, unsigned int instanceCount, const IndirectDrawArgs* meshDraws, unsigned int meshCount) {
+	bool accepted = device.SetSceneInstances(instances, instanceCount, meshDraws, meshCount);
+	if (file != nullptr) {
+		unsigned int counts[] = { instanceCount, meshCount };
+		unsigned char* arguments = AddRecord(GetRecords(), CaptureCommand_SetSceneInstances, sizeof(counts) + instanceCount * sizeof(SceneInstance) + meshCount * sizeof(IndirectDrawArgs));
+		arguments = Put(arguments, counts, sizeof(counts));
+		arguments = Put(arguments, instances, instanceCount * sizeof(SceneInstance));
+		Put(arguments, meshDraws, meshCount * sizeof(IndirectDrawArgs));
+	}
+	return accepted;
+}
+
+void CommandCaptureDevice::CullSceneInstances(const Frustum& frustum) {
+	device.CullSceneInstances(frustum);
+	if (file != nullptr) {
+		AddRecord(GetRecords(), CaptureCommand_CullSceneInstances, &frustum, sizeof(frustum));
+	}
+}
+
+void CommandCaptureDevice::DrawSceneInstances() {
+	device.DrawSceneInstances();
+	if (file != nullptr) {
+		AddRecord(GetRecords(), CaptureCommand_DrawSceneInstances, 0);
+	}
+}
+
+void CommandCaptureDevice::ResolveEyeTexture() {
+	device.ResolveEyeTexture();
+	if (file != nullptr) {
+		AddRecord(GetRecords(), CaptureCommand_ResolveEyeTexture, 0);
+	}
+}
+
+bool CommandCaptureDevice::SetDistortionMesh(int eye, const DistortionMesh& mesh) {
+	bool accepted = device.SetDistortionMesh(eye, mesh);
+	if (file != nullptr) {
+		unsigned int counts[] = { static_cast<unsigned int>(eye), static_cast<unsigned int>(mesh.Vertices.size()), static_cast<unsigned int>(mesh.Indices.size()) };
+		size_t vertexBytes = mesh.Vertices.size() * sizeof(DistortionVertex);
+		size_t indexBytes = mesh.Indices.size() * sizeof(unsigned short);
+		unsigned char* arguments = AddRecord(GetRecords(), CaptureCommand_SetDistortionMesh, sizeof(counts) + GetPaddedSize(vertexBytes) + indexBytes);
+		arguments = Put(arguments, counts, sizeof(counts));
+		arguments = Put(arguments, mesh.Vertices.data(), vertexBytes);
+		Put(arguments, mesh.Indices.data(), indexBytes);
+	}
+	return accepted;
+}
+
+void CommandCaptureDevice::PresentDistorted(const DistortionConstants constants[EyeCount]) {
+	device.PresentDistorted(constants);
+	if (file != nullptr) {
+		AddRecord(GetRecords(), CaptureCommand_PresentDistorted, constants, EyeCount * sizeof(DistortionConstants));
+	}
+}
+
+bool CommandCaptureDevice::SetFusedResolve(bool fused) {
+	bool accepted = device.SetFusedResolve(fused);
+	if (file != nullptr) {
+		int argument = fused;
+		AddRecord(GetRecords(), CaptureCommand_SetFusedResolve, &argument, sizeof(argument));
+	}
+	return accepted;
+}
+
+bool CommandCaptureDevice::SetHiddenAreaMesh(int eye, const HiddenAreaMesh& mesh) {
+	bool accepted = device.SetHiddenAreaMesh(eye, mesh);
+	if (file != nullptr) {
+		unsigned int counts[] = { static_cast<unsigned int>(eye), static_cast<unsigned int>(mesh.Rects.size()) };
+		unsigned char* arguments = AddRecord(GetRecords(), CaptureCommand_SetHiddenAreaMesh, sizeof(counts) + mesh.Rects.size() * sizeof(HiddenAreaRect));
+		Put(Put(arguments, counts, sizeof(counts)), mesh.Rects.data(), mesh.Rects.size() * sizeof(HiddenAreaRect));
+	}
+	return accepted;
+}
+
+void CommandCaptureDevice::SetHiddenAreaViewports(const Rect2i* viewports) {
+	device.SetHiddenAreaViewports(viewports);
+	if (file != nullptr) {
+		int present = viewports != nullptr;
+		unsigned char* arguments = Put(AddRecord(GetRecords(), CaptureCommand_SetHiddenAreaViewports, sizeof(present) + (present ? EyeCount * sizeof(Rect2i) : 0)), &present, sizeof(present));
+		if (viewports != nullptr) {
+			Put(arguments, viewports, EyeCount * sizeof(Rect2i));
+		}
+	}
+}
+
+void CommandCaptureDevice::BeginGpuTimer() {
+	device.BeginGpuTimer();
+	if (file != nullptr) {
+		AddRecord(GetRecords(), CaptureCommand_BeginGpuTimer, 0);
+	}
+}
+
+void CommandCaptureDevice::EndGpuTimer() {
+	device.EndGpuTimer();
+	if (file != nullptr) {
+		AddRecord(GetRecords(), CaptureCommand_EndGpuTimer, 0);
+	}
+}
+
+bool CommandCaptureDevice::GetGpuFrameTime(double& outSeconds) {
+	return device.GetGpuFrameTime(outSeconds);
+}
+
+CommandCapture::CommandCapture() {
+	std::memset(&header, 0, sizeof(header));
+}
+
+bool CommandCapture::Load(const char* path) {
+	frames.clear();
+	replayedAllocations.clear();
+	std::memset(&header, 0, sizeof(header));
+
+	if (!file.Open(path) || file.GetSize() < sizeof(CommandCaptureHeader)) {
+		file.Close();
+		return false;
+	}
+	CommandCaptureHeader fileHeader;
+	std::memcpy(&fileHeader, file.GetData(), sizeof(fileHeader));
+	if (std::memcmp(fileHeader.Magic, CommandCaptureMagic, sizeof(CommandCaptureMagic)) != 0 || fileHeader.Version != CommandCaptureVersion) {
+		file.Close();
+		return false;
+	}
+
+	// Only the frames are indexed, their records are checked as they are replayed.
+	const unsigned char* data = file.GetData();
+	size_t frameBegin = sizeof(fileHeader);
+	size_t offset = frameBegin;
+	CaptureRecordHeader record;
+	while (ReadRecordHeader(data, file.GetSize(), offset, record)) {
+		if (record.Command >= CaptureCommandCount) {
+			frames.clear();
+			file.Close();
+			return false;
+		}
+		offset += sizeof(record) + record.Size;
+		if (record.Command == CaptureCommand_EndFrame) {
+			CapturedFrame frame;
+			frame.Begin = frameBegin;
+			frame.End = offset;
+			if (record.Size != sizeof(frame.EyePoses)) {
+				frames.clear();
+				file.Close();
+				return false;
+			}
+			std::memcpy(frame.EyePoses, data + offset - record.Size, sizeof(frame.EyePoses));
+			frames.push_back(frame);
+			frameBegin = offset;
+		}
+	}
+	header = fileHeader;
+	return true;
+}
+
+Size2i CommandCapture::GetEyeTextureSize() const {
+	return header.EyeTextureSize;
+}
+
+int CommandCapture::GetMultisampleCount() const {
+	return header.MultisampleCount;
+}
+
+unsigned int CommandCapture::GetFrameCount() const {
+	return static_cast<unsigned int>(frames.size());
+}
+
+size_t CommandCapture::GetFrameSize(unsigned int frame) const {
+	return frames[frame].End - frames[frame].Begin;
+}
+
+const Pose* CommandCapture::GetEyePoses(unsigned int frame) const {
+	return frames[frame].EyePoses;
+}
+
+bool CommandCapture::ReplayFrame(unsigned int frame, RenderDevice& device) {
+	return Replay(file.GetData() + frames[frame].Begin, frames[frame].End - frames[frame].Begin, device);
+}
+
+bool CommandCapture::CapturedOffsetLess(const ReplayedAllocation& a, const ReplayedAllocation& b) {
+	return a.CapturedOffset < b.CapturedOffset;
+}
+
+bool CommandCapture::TranslateOffset(unsigned int capturedOffset, unsigned int& outOffset) const {
+	ReplayedAllocation key = { capturedOffset, 0, 0 };
+	std::vector<ReplayedAllocation>::const_iterator next = std::upper_bound(replayedAllocations.begin(), replayedAllocations.end(), key, CapturedOffsetLess);
+	if (next == replayedAllocations.begin()) {
+		return false;
+	}
+	const ReplayedAllocation& allocation = *(next - 1);
+	if (capturedOffset - allocation.CapturedOffset >= allocation.Size) {
+		return false;
+	}
+	outOffset = allocation.Offset + (capturedOffset - allocation.CapturedOffset);
+	return true;
+}
+
+bool CommandCapture::ReplayContext(const CaptureRecordHeader& record, const unsigned char* arguments, RenderContext& context) const {
+	ArgumentReader reader(arguments, record.Size);
+	switch (record.Command) {
+	case CaptureCommand_SetViewport: {
+		Rect2i viewport;
+		if (!reader.Read(viewport)) {
+			return false;
+		}
+		context.SetViewport(viewport);
+		return true;
+	}
+	case CaptureCommand_BindConstants: {
+		unsigned int values[3];
+		unsigned int offset;
+		if (!reader.Read(values) || values[0] >= ConstantSlotCount || !TranslateOffset(values[1], offset)) {
+			return false;
+		}
+		context.BindConstants(static_cast<ConstantSlot>(values[0]), offset, values[2]);
+		return true;
+	}
+	case CaptureCommand_BindLatchedConstants: {
+		int values[2];
+		if (!reader.Read(values) || values[0] < 0 || values[0] >= ConstantSlotCount || values[1] < 0 || values[1] >= LatchedConstantParts) {
+			return false;
+		}
+		context.BindLatchedConstants(static_cast<ConstantSlot>(values[0]), values[1]);
+		return true;
+	}
+	case CaptureCommand_SetMaterial: {
+		int material;
+		if (!reader.Read(material) || material < 0 || material >= MaxMaterials) {
+			return false;
+		}
+		context.SetMaterial(material);
+		return true;
+	}
+	case CaptureCommand_Draw: {
+		unsigned int values[2];
+		if (!reader.Read(values)) {
+			return false;
+		}
+		context.Draw(values[0], values[1]);
+		return true;
+	}
+	case CaptureCommand_DrawInstanced: {
+		unsigned int values[3];
+		if (!reader.Read(values)) {
+			return false;
+		}
+		context.DrawInstanced(values[0], values[1], values[2]);
+		return true;
+	}
+	default:
+		return false;
+	}
+}
+
+bool CommandCapture::Replay(const unsigned char* records, size_t size, RenderDevice& device) {
+	size_t offset = 0;
+	CaptureRecordHeader record;
+	while (ReadRecordHeader(records, size, offset, record)) {
+		const unsigned char* arguments = records + offset + sizeof(record);
+		offset += sizeof(record) + record.Size;
+		ArgumentReader reader(arguments, record.Size);
+
+		switch (record.Command) {
+		case CaptureCommand_ClearEyeTexture: {
+			float color[4];
+			if (!reader.Read(color)) {
+				return false;
+			}
+			device.ClearEyeTexture(color);
+			break;
+		}
+		case CaptureCommand_ClearDepthStencil: {
+			float depth;
+			unsigned int stencil;
+			if (!reader.Read(depth) || !reader.Read(stencil)) {
+				return false;
+			}
+			device.ClearDepthStencil(depth, static_cast<unsigned char>(stencil));
+			break;
+		}
+		case CaptureCommand_BindEyeTexture:
+			device.BindEyeTexture();
+			break;
+		case CaptureCommand_SetStereoMode: {
+			int mode;
+			if (!reader.Read(mode) || (mode != StereoMode_MultiPass && mode != StereoMode_Instanced)) {
+				return false;
+			}
+			device.SetStereoMode(static_cast<StereoMode>(mode));
+			break;
+		}
+		case CaptureCommand_SetSceneVertices: {
+			unsigned int vertexCount;
+			const Vertex* vertices;
+			if (!reader.Read(vertexCount) || (vertices = reader.GetArray<Vertex>(vertexCount)) == nullptr) {
+				return false;
+			}
+			device.SetSceneVertices(vertices, vertexCount);
+			break;
+		}
+		case CaptureCommand_UploadSceneVertices: {
+			unsigned int counts[2];
+			const Vertex* vertices;
+			if (!reader.Read(counts) || (vertices = reader.GetArray<Vertex>(counts[1])) == nullptr) {
+				return false;
+			}
+			device.UploadSceneVertices(counts[0], vertices, counts[1]);
+			break;
+		}
+		case CaptureCommand_ConstantBatch: {
+			unsigned int count;
+			const unsigned int* ranges;
+			if (!reader.Read(count) || count > record.Size / 8 || (ranges = reader.GetArray<unsigned int>(count * 2)) == nullptr) {
+				return false;
+			}
+			device.BeginConstants();
+			replayedAllocations.clear();
+			for (unsigned int i = 0; i < count; i++) {
+				ReplayedAllocation allocation = { ranges[i * 2], 0, ranges[i * 2 + 1] };
+				const unsigned char* data = reader.Get(allocation.Size);
+				void* constants = data != nullptr ? device.AllocateConstants(allocation.Size, allocation.Offset) : nullptr;
+				if (constants == nullptr) {
+					return false;
+				}
+				std::memcpy(constants, data, allocation.Size);
+				replayedAllocations.push_back(allocation);
+			}
+			std::sort(replayedAllocations.begin(), replayedAllocations.end(), CapturedOffsetLess);
+			break;
+		}
+		case CaptureCommand_EndConstants:
+			device.EndConstants();
+			break;
+		case CaptureCommand_ExecuteRecordings: {
+			int count;
+			if (!reader.Read(count) || count < 0 || count > MaxRecordingContexts) {
+				return false;
+			}
+			for (int i = 0; i < count; i++) {
+				unsigned int recordsSize;
+				const unsigned char* contextRecords;
+				if (!reader.Read(recordsSize) || (contextRecords = reader.Get(recordsSize)) == nullptr) {
+					return false;
+				}
+				RenderContext& context = device.BeginRecording(i);
+				size_t contextOffset = 0;
+				CaptureRecordHeader contextRecord;
+				while (ReadRecordHeader(contextRecords, recordsSize, contextOffset, contextRecord)) {
+					if (!ReplayContext(contextRecord, contextRecords + contextOffset + sizeof(contextRecord), context)) {
+						device.EndRecording(i);
+						return false;
+					}
+					contextOffset += sizeof(contextRecord) + contextRecord.Size;
+				}
+				device.EndRecording(i);
+			}
+			device.ExecuteRecordings(count);
+			break;
+		}
+		case CaptureCommand_LatchConstants: {
+			int counts[2];
+			const unsigned char* data;
+			if (!reader.Read(counts) || counts[0] < 0 || counts[0] >= LatchedConstantParts || counts[1] < 0 ||
+				static_cast<unsigned int>(counts[1]) > MaxLatchedConstantsSize || (data = reader.Get(counts[1])) == nullptr) {
+				return false;
+			}
+			device.LatchConstants(counts[0], data, static_cast<unsigned int>(counts[1]));
+			break;
+		}
+		case CaptureCommand_SetFoveatedLayout: {
+			int present;
+			FoveatedLayout layout;
+			if (!reader.Read(present) || (present != 0 && !reader.Read(layout))) {
+				return false;
+			}
+			device.SetFoveatedLayout(present != 0 ? &layout : nullptr);
+			break;
+		}
+		case CaptureCommand_SetSceneInstances: {
+			unsigned int counts[2];
+			const SceneInstance* instances;
+			const IndirectDrawArgs* meshDraws;
+			if (!reader.Read(counts) || (instances = reader.GetArray<SceneInstance>(counts[0])) == nullptr ||
+				(meshDraws = reader.GetArray<IndirectDrawArgs>(counts[1])) == nullptr) {
+				return false;
+			}
+			device.SetSceneInstances(instances, counts[0], meshDraws, counts[1]);
+			break;
+		}
+		case CaptureCommand_CullSceneInstances: {
+			Frustum frustum;
+			if (!reader.Read(frustum)) {
+				return false;
+			}
+			device.CullSceneInstances(frustum);
+			break;
+		}
+		case CaptureCommand_DrawSceneInstances:
+			device.DrawSceneInstances();
+			break;
+		case CaptureCommand_ResolveEyeTexture:
+			device.ResolveEyeTexture();
+			break;
+		case CaptureCommand_SetDistortionMesh: {
+			unsigned int counts[3];
+			const DistortionVertex* vertices;
+			const unsigned short* indices;
+			if (!reader.Read(counts) || counts[0] >= EyeCount || (vertices = reader.GetArray<DistortionVertex>(counts[1])) == nullptr ||
+				(indices = reader.GetArray<unsigned short>(counts[2])) == nullptr) {
+				return false;
+			}
+			distortionMesh.Vertices.assign(vertices, vertices + counts[1]);
+			distortionMesh.Indices.assign(indices, indices + counts[2]);
+			if (!IsValidDistortionMesh(distortionMesh)) {
+				return false;
+			}
+			device.SetDistortionMesh(counts[0], distortionMesh);
+			break;
+		}
+		case CaptureCommand_PresentDistorted: {
+			DistortionConstants constants[EyeCount];
+			if (!reader.Read(constants)) {
+				return false;
+			}
+			device.PresentDistorted(constants);
+			break;
+		}
+		case CaptureCommand_SetFusedResolve: {
+			int fused;
+			if (!reader.Read(fused)) {
+				return false;
+			}
+			device.SetFusedResolve(fused != 0);
+			break;
+		}
+		case CaptureCommand_SetHiddenAreaMesh: {
+			unsigned int counts[2];
+			const HiddenAreaRect* rects;
+			if (!reader.Read(counts) || counts[0] >= EyeCount || (rects = reader.GetArray<HiddenAreaRect>(counts[1])) == nullptr) {
+				return false;
+			}
+			hiddenAreaMesh.Rects.assign(rects, rects + counts[1]);
+			device.SetHiddenAreaMesh(counts[0], hiddenAreaMesh);
+			break;
+		}
+		case CaptureCommand_SetHiddenAreaViewports: {
+			int present;
+			Rect2i viewports[EyeCount];
+			if (!reader.Read(present) || (present != 0 && !reader.Read(viewports))) {
+				return false;
+			}
+			device.SetHiddenAreaViewports(present != 0 ? viewports : nullptr);
+			break;
+		}
+		case CaptureCommand_BeginGpuTimer:
+			device.BeginGpuTimer();
+			break;
+		case CaptureCommand_EndGpuTimer:
+			device.EndGpuTimer();
+			break;
+		case CaptureCommand_EndFrame:
+			break;
+		default:
+			if (!ReplayContext(record, arguments, device)) {
+				return false;
+			}
+			break;
+		}
+	}
+	return true;
+}
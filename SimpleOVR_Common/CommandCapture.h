@@ -0,0 +1,259 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+
+#pragma once
+
+#include "MappedFile.h"
+#include "RenderDevice.h"
+#include <cstdio>
+#include <vector>
+
+/*
+	Binary command capture, little endian, written by CommandCaptureDevice while the frame loop
+	runs (see StereoSetup::CommandCapture) and replayed by CommandCapture on any device:
+
+		CommandCaptureHeader
+		Records until the end of the file, each a CaptureRecordHeader followed by its arguments,
+		padded to a multiple of 4 bytes. A frame is the records up to and including its
+		CaptureCommand_EndFrame, which holds the eye poses the frame was drawn with.
+
+	Every record is 4 byte aligned in the file, so the replay reads vertex, instance and constant
+	data straight from the mapped file without copying it first.
+
+	The constants of a batch are written when it ends, as a CaptureCommand_ConstantBatch with
+	each allocation's offset, size and contents, followed by whatever was called on the device
+	while the batch was open and a CaptureCommand_EndConstants. Replaying the batch allocates
+	the same sizes on the replaying device and binds by the offsets it hands out, so the
+	constants end up the same whatever the device's ring looked like. What was recorded on
+	recording contexts is written with the CaptureCommand_ExecuteRecordings that ran it, and
+	recorded on contexts of the replaying device again.
+
+	A capture cut off in the middle of a frame, by a crash say, replays up to the last whole frame.
+*/
+struct CommandCaptureHeader {
+	char Magic[8]; // CommandCaptureMagic
+	unsigned int Version; // CommandCaptureVersion
+	Size2i EyeTextureSize; // Of the device captured
+	int MultisampleCount;
+};
+
+struct CaptureRecordHeader {
+	unsigned int Command; // CaptureCommand
+	unsigned int Size; // Of the arguments that follow, a multiple of 4
+};
+
+enum CaptureCommand {
+	CaptureCommand_ClearEyeTexture,
+	CaptureCommand_ClearDepthStencil,
+	CaptureCommand_BindEyeTexture,
+	CaptureCommand_SetViewport,
+	CaptureCommand_SetStereoMode,
+	CaptureCommand_SetSceneVertices,
+	CaptureCommand_UploadSceneVertices,
+	CaptureCommand_ConstantBatch,
+	CaptureCommand_EndConstants,
+	CaptureCommand_BindConstants,
+	CaptureCommand_BindLatchedConstants,
+	CaptureCommand_SetMaterial,
+	CaptureCommand_Draw,
+	CaptureCommand_DrawInstanced,
+	CaptureCommand_ExecuteRecordings,
+	CaptureCommand_LatchConstants,
+	CaptureCommand_SetFoveatedLayout,
+	CaptureCommand_SetSceneInstances,
+	CaptureCommand_CullSceneInstances,
+	CaptureCommand_DrawSceneInstances,
+	CaptureCommand_ResolveEyeTexture,
+	CaptureCommand_SetDistortionMesh,
+	CaptureCommand_PresentDistorted,
+	CaptureCommand_SetFusedResolve,
+	CaptureCommand_SetHiddenAreaMesh,
+	CaptureCommand_SetHiddenAreaViewports,
+	CaptureCommand_BeginGpuTimer,
+	CaptureCommand_EndGpuTimer,
+	CaptureCommand_EndFrame,
+	CaptureCommandCount
+};
+
+extern const char CommandCaptureMagic[8];
+const unsigned int CommandCaptureVersion = 1;
+
+/*
+	A device that passes everything on to another device and, while a capture is open, writes
+	it down too. Each frame is buffered and written out by EndFrame, so a frame costs one write.
+
+	The constants of a batch are read back from the device's memory when the batch ends, which on
+	a GPU's write-combined memory is slow: frames being captured cost more than usual on the CPU.
+*/
+class CommandCaptureDevice : public RenderDevice {
+public:
+	explicit CommandCaptureDevice(RenderDevice& device);
+	~CommandCaptureDevice();
+
+	// Returns false if the file can't be created.
+	bool Open(const char* path);
+
+	// Returns false if anything failed to be written. A frame without its EndFrame is dropped.
+	bool Close();
+	bool IsOpen() const;
+
+	// Ends the frame, drawn with the given eye poses, and writes it out.
+	void EndFrame(const Pose eyeRenderPose[EyeCount]);
+	unsigned int GetFrameCount() const;
+	unsigned long long GetCapturedBytes() const;
+
+	Size2i GetEyeTextureSize() const;
+	int GetMultisampleCount() const;
+
+	void ClearEyeTexture(const float color[4]);
+	void ClearDepthStencil(float depth, unsigned char stencil);
+	void BindEyeTexture();
+	void SetViewport(const Rect2i& viewport);
+	void SetStereoMode(StereoMode mode);
+	void SetSceneVertices(const Vertex* vertices, unsigned int vertexCount);
+	void UploadSceneVertices(unsigned int firstVertex, const Vertex* vertices, unsigned int vertexCount);
+	void BeginConstants();
+	void* AllocateConstants(unsigned int size, unsigned int& outOffset);
+	void EndConstants();
+	void BindConstants(ConstantSlot slot, unsigned int offset, unsigned int size);
+	void BindLatchedConstants(ConstantSlot slot, int part);
+	void SetMaterial(int material);
+	void Draw(unsigned int vertexCount, unsigned int startVertex);
+	void DrawInstanced(unsigned int vertexCount, unsigned int instanceCount, unsigned int startVertex);
+	RenderContext& BeginRecording(int context);
+	void EndRecording(int context);
+	void ExecuteRecordings(int count);
+	void LatchConstants(int part, const void* data, unsigned int size);
+	void SetFoveatedLayout(const FoveatedLayout* layout);
+	bool SetSceneInstances(const SceneInstance* instances, unsigned int instanceCount, const IndirectDrawArgs* meshDraws, unsigned int meshCount);
+	void CullSceneInstances(const Frustum& frustum);
+	void DrawSceneInstances();
+	void ResolveEyeTexture();
+	bool SetDistortionMesh(int eye, const DistortionMesh& mesh);
+	void PresentDistorted(const DistortionConstants constants[EyeCount]);
+	bool SetFusedResolve(bool fused);
+	bool SetHiddenAreaMesh(int eye, const HiddenAreaMesh& mesh);
+	void SetHiddenAreaViewports(const Rect2i* viewports);
+	void BeginGpuTimer();
+	void EndGpuTimer();
+	bool GetGpuFrameTime(double& outSeconds);
+
+private:
+	// Writes down what is recorded on one of the device's contexts and passes it on.
+	class CaptureContext : public RenderContext {
+	public:
+		void SetViewport(const Rect2i& viewport);
+		void BindConstants(ConstantSlot slot, unsigned int offset, unsigned int size);
+		void BindLatchedConstants(ConstantSlot slot, int part);
+		void SetMaterial(int material);
+		void Draw(unsigned int vertexCount, unsigned int startVertex);
+		void DrawInstanced(unsigned int vertexCount, unsigned int instanceCount, unsigned int startVertex);
+
+		RenderContext* Target;
+		bool Capturing;
+		std::vector<unsigned char> Records;
+	};
+
+	struct ConstantAllocation {
+		const unsigned char* Data;
+		unsigned int Offset;
+		unsigned int Size;
+	};
+
+	CommandCaptureDevice(const CommandCaptureDevice&);
+	CommandCaptureDevice& operator=(const CommandCaptureDevice&);
+
+	// Where the device's own commands go: held back while a batch of constants is open.
+	std::vector<unsigned char>& GetRecords();
+
+	RenderDevice& device;
+	FILE* file;
+	bool failed;
+	unsigned int frameCount;
+	unsigned long long capturedBytes;
+	std::vector<unsigned char> frameRecords;
+	std::vector<unsigned char> batchRecords; // Since BeginConstants
+	bool batchOpen;
+	std::vector<ConstantAllocation> allocations;
+	CaptureContext contexts[MaxRecordingContexts];
+};
+
+/*
+	A capture, mapped into memory and indexed by frame. ReplayFrame runs a frame's commands on a
+	device, which should have the eye texture size and multisample count the capture was made
+	with. A frame depends on the ones before it (the scene's vertices are only set once, say), so
+	to get a frame right the ones before it have to be replayed first; after that any frames can
+	be replayed again, as often as needed.
+*/
+class CommandCapture {
+public:
+	CommandCapture();
+
+	// Returns false, leaving the capture empty, if the file can't be read or is not a capture.
+	bool Load(const char* path);
+
+	Size2i GetEyeTextureSize() const;
+	int GetMultisampleCount() const;
+	unsigned int GetFrameCount() const;
+
+	// The bytes of a frame's records, and the eye poses it was drawn with.
+	size_t GetFrameSize(unsigned int frame) const;
+	const Pose* GetEyePoses(unsigned int frame) const;
+
+	// Returns false, having run the commands up to it, if a record doesn't make sense.
+	bool ReplayFrame(unsigned int frame, RenderDevice& device);
+
+private:
+	CommandCapture(const CommandCapture&);
+	CommandCapture& operator=(const CommandCapture&);
+
+	struct CapturedFrame {
+		size_t Begin; // Offsets in the file
+		size_t End;
+		Pose EyePoses[EyeCount];
+	};
+
+	// A batch's allocation as captured and where the replaying device put it.
+	struct ReplayedAllocation {
+		unsigned int CapturedOffset;
+		unsigned int Offset;
+		unsigned int Size;
+	};
+
+	static bool CapturedOffsetLess(const ReplayedAllocation& a, const ReplayedAllocation& b);
+	bool Replay(const unsigned char* records, size_t size, RenderDevice& device);
+	bool ReplayContext(const CaptureRecordHeader& header, const unsigned char* arguments, RenderContext& context) const;
+	bool TranslateOffset(unsigned int capturedOffset, unsigned int& outOffset) const;
+
+	MappedFile file;
+	CommandCaptureHeader header;
+	std::vector<CapturedFrame> frames;
+	std::vector<ReplayedAllocation> replayedAllocations; // Of the last batch
+	DistortionMesh distortionMesh;
+	HiddenAreaMesh hiddenAreaMesh;
+};
@@ -0,0 +1,90 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+
+#include "CommandRecorder.h"
+#include <cstddef>
+
+void CommandRecorder::SetViewport(const Rect2i& viewport) {
+	Add(CommandType_SetViewport, viewport.Pos.x, viewport.Pos.y, viewport.Size.w, viewport.Size.h);
+}
+
+void CommandRecorder::BindConstants(ConstantSlot slot, unsigned int offset, unsigned int size) {
+	Add(CommandType_BindConstants, slot, offset, size, 0);
+}
+
+void CommandRecorder::BindLatchedConstants(ConstantSlot slot, int part) {
+	Add(CommandType_BindLatchedConstants, slot, part, 0, 0);
+}
+
+void CommandRecorder::SetMaterial(int material) {
+	Add(CommandType_SetMaterial, material, 0, 0, 0);
+}
+
+void CommandRecorder::Draw(unsigned int vertexCount, unsigned int startVertex) {
+	Add(CommandType_Draw, vertexCount, startVertex, 0, 0);
+}
+
+void CommandRecorder::DrawInstanced(unsigned int vertexCount, unsigned int instanceCount, unsigned int startVertex) {
+	Add(CommandType_DrawInstanced, vertexCount, instanceCount, startVertex, 0);
+}
+
+unsigned int CommandRecorder::Execute(RenderContext& target) {
+	for (size_t i = 0; i < commands.size(); i++) {
+		const int* a = commands[i].Arguments;
+		switch (commands[i].Type) {
+		case CommandType_SetViewport: {
+			Rect2i viewport = { { a[0], a[1] }, { a[2], a[3] } };
+			target.SetViewport(viewport);
+			break;
+		}
+		case CommandType_BindConstants:
+			target.BindConstants(static_cast<ConstantSlot>(a[0]), a[1], a[2]);
+			break;
+		case CommandType_BindLatchedConstants:
+			target.BindLatchedConstants(static_cast<ConstantSlot>(a[0]), a[1]);
+			break;
+		case CommandType_SetMaterial:
+			target.SetMaterial(a[0]);
+			break;
+		case CommandType_Draw:
+			target.Draw(a[0], a[1]);
+			break;
+		case CommandType_DrawInstanced:
+			target.DrawInstanced(a[0], a[1], a[2]);
+			break;
+		}
+	}
+	unsigned int count = static_cast<unsigned int>(commands.size());
+	commands.clear();
+	return count;
+}
+
+void CommandRecorder::Add(CommandType type, int a, int b, int c, int d) {
+	Command command = { type, { a, b, c, d } };
+	commands.push_back(command);
+}
@@ -0,0 +1,69 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+
+#pragma once
+
+#include "RenderDevice.h"
+#include <vector>
+
+/*
+	A RenderContext that only records what is called on it, for devices that have no command lists
+	of their own. Execute plays the commands back on another context, usually the device itself,
+	like a command list would, and forgets them.
+*/
+class CommandRecorder : public RenderContext {
+public:
+	void SetViewport(const Rect2i& viewport);
+	void BindConstants(ConstantSlot slot, unsigned int offset, unsigned int size);
+	void BindLatchedConstants(ConstantSlot slot, int part);
+	void SetMaterial(int material);
+	void Draw(unsigned int vertexCount, unsigned int startVertex);
+	void DrawInstanced(unsigned int vertexCount, unsigned int instanceCount, unsigned int startVertex);
+
+	// Returns how many commands were played back.
+	unsigned int Execute(RenderContext& target);
+
+private:
+	enum CommandType {
+		CommandType_SetViewport,
+		CommandType_BindConstants,
+		CommandType_BindLatchedConstants,
+		CommandType_SetMaterial,
+		CommandType_Draw,
+		CommandType_DrawInstanced
+	};
+
+	struct Command {
+		CommandType Type;
+		int Arguments[4];
+	};
+
+	void Add(CommandType type, int a, int b, int c, int d);
+
+	std::vector<Command> commands;
+};
@@ -0,0 +1,129 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#include "ConstantRingAllocator.h"
+#include <cstring>
+
+ConstantRingAllocator::ConstantRingAllocator(unsigned int capacity) :
+	capacity(capacity / ConstantAlignment * ConstantAlignment),
+	head(0),
+	usedBytes(0),
+	inFrame(false),
+	currentFrame(0),
+	currentFrameBytes(0)
+{
+	memset(&statistics, 0, sizeof(statistics));
+}
+
+void ConstantRingAllocator::BeginFrame(unsigned long long frame) {
+	if (inFrame) {
+		EndFrame();
+	}
+	inFrame = true;
+	currentFrame = frame;
+	currentFrameBytes = 0;
+}
+
+void ConstantRingAllocator::EndFrame() {
+	if (!inFrame) {
+		return;
+	}
+	inFrame = false;
+
+	// Frames without allocations need no tracking.
+	if (currentFrameBytes > 0) {
+		FrameRange range = { currentFrame, currentFrameBytes };
+		framesInFlight.push_back(range);
+	}
+}
+
+void ConstantRingAllocator::RetireFrames(unsigned long long completedFrame) {
+	while (!framesInFlight.empty() && framesInFlight.front().Frame <= completedFrame) {
+		usedBytes -= framesInFlight.front().Bytes;
+		framesInFlight.pop_front();
+	}
+}
+
+bool ConstantRingAllocator::Allocate(unsigned int size, unsigned int& outOffset) {
+	unsigned int alignedSize = Align(size);
+
+	// Nothing in use, start over from the beginning rather than skipping the end later on.
+	if (usedBytes == 0) {
+		head = 0;
+	}
+
+	// Allocations never straddle the end of the buffer, whatever is left there is skipped.
+	unsigned int offset = head;
+	unsigned int skipped = 0;
+	if (alignedSize > capacity - head) {
+		offset = 0;
+		skipped = capacity - head;
+	}
+
+	if (alignedSize > capacity || usedBytes + skipped + alignedSize > capacity) {
+		statistics.Failures++;
+		return false;
+	}
+
+	if (skipped > 0 || (offset == 0 && head == capacity)) {
+		statistics.Wraps++;
+	}
+	head = offset + alignedSize;
+	usedBytes += skipped + alignedSize;
+	currentFrameBytes += skipped + alignedSize;
+
+	statistics.Allocations++;
+	statistics.AllocatedBytes += alignedSize;
+	statistics.WastedBytes += skipped;
+
+	outOffset = offset;
+	return true;
+}
+
+unsigned int ConstantRingAllocator::GetCapacity() const {
+	return capacity;
+}
+
+unsigned int ConstantRingAllocator::GetUsedBytes() const {
+	return usedBytes;
+}
+
+int ConstantRingAllocator::GetFramesInFlight() const {
+	return static_cast<int>(framesInFlight.size());
+}
+
+unsigned long long ConstantRingAllocator::GetOldestFrameInFlight() const {
+	return framesInFlight.front().Frame;
+}
+
+const ConstantRingAllocator::Statistics& ConstantRingAllocator::GetStatistics() const {
+	return statistics;
+}
+
+unsigned int ConstantRingAllocator::Align(unsigned int size) {
+	return (size + ConstantAlignment - 1) / ConstantAlignment * ConstantAlignment;
+}
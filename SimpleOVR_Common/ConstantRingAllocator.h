@@ -0,0 +1,104 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#pragma once
+
+#include <deque>
+
+/*
+	Sub-allocates per-draw constants from one large buffer that is used as a ring.
+
+	Each frame's allocations are appended after the previous frame's, every one aligned to
+	ConstantAlignment bytes, which is the granularity D3D11.1 can bind constant buffer ranges at.
+	Since nothing written this frame overlaps what the GPU may still be reading, the buffer can be
+	mapped once per frame without discarding it (D3D11_MAP_WRITE_NO_OVERWRITE), avoiding the
+	renaming the driver has to do for every WRITE_DISCARD.
+
+	The allocator itself only deals in offsets, never touching the memory, so the same logic backs
+	the D3D11 buffer and the plain CPU memory of NullRenderDevice. Reuse is tracked per frame: the
+	owner closes each frame with EndFrame, then tells the allocator which frames the GPU is done
+	with through RetireFrames (typically after a fence or event query was signaled). Space
+	belonging to frames that are still in flight is never handed out again.
+*/
+class ConstantRingAllocator {
+public:
+	static const unsigned int ConstantAlignment = 256;
+	static const unsigned int DefaultCapacity = 1024 * 1024;
+
+	struct Statistics {
+		unsigned long long Allocations;
+		unsigned long long AllocatedBytes; // Including alignment padding
+		unsigned long long WastedBytes; // Skipped at the end of the buffer when wrapping around
+		unsigned long long Wraps;
+		unsigned long long Failures; // Allocations that did not fit next to the frames in flight
+	};
+
+	// The capacity is rounded down to a multiple of ConstantAlignment.
+	explicit ConstantRingAllocator(unsigned int capacity);
+
+	// Starts collecting the allocations of frame. Frame numbers must increase.
+	void BeginFrame(unsigned long long frame);
+
+	// Ends the current frame. Its space stays in use until RetireFrames includes it.
+	void EndFrame();
+
+	// The GPU has finished with every frame up to and including completedFrame.
+	void RetireFrames(unsigned long long completedFrame);
+
+	/*
+		Reserves size bytes for the current frame and returns their offset in outOffset.
+		Returns false if the space is still used by frames in flight (or size is larger than the
+		whole buffer). The caller then has to wait for the GPU, retire frames and try again.
+	*/
+	bool Allocate(unsigned int size, unsigned int& outOffset);
+
+	unsigned int GetCapacity() const;
+	unsigned int GetUsedBytes() const; // Current frame and frames in flight
+	int GetFramesInFlight() const; // Ended but not retired
+	unsigned long long GetOldestFrameInFlight() const; // Only valid if GetFramesInFlight() > 0
+	const Statistics& GetStatistics() const;
+
+	// Rounds size up to ConstantAlignment.
+	static unsigned int Align(unsigned int size);
+
+private:
+	struct FrameRange {
+		unsigned long long Frame;
+		unsigned int Bytes;
+	};
+
+	unsigned int capacity;
+	unsigned int head; // Offset of the next allocation
+	unsigned int usedBytes;
+
+	bool inFrame;
+	unsigned long long currentFrame;
+	unsigned int currentFrameBytes;
+	std::deque<FrameRange> framesInFlight;
+
+	Statistics statistics;
+};
@@ -0,0 +1,157 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#include "Culling.h"
+#include "VrMath.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE__)
+#define CULLING_SSE
+#include <xmmintrin.h>
+#endif
+
+namespace {
+	// Plane through point with the given normal (in camera space), rotated into world space.
+	Plane MakePlane(const Quaternion& orientation, const Vector3& point, Vector3 normal) {
+		Plane plane;
+		plane.Normal = Rotate(orientation, Normalized(normal));
+		plane.Distance = -Dot(plane.Normal, point);
+		return plane;
+	}
+}
+
+bool IsSphereVisible(const Frustum& frustum, float x, float y, float z, float r) {
+	for (int i = 0; i < 6; i++) {
+		const Plane& plane = frustum.Planes[i];
+		if (plane.Normal.x * x + plane.Normal.y * y + plane.Normal.z * z + plane.Distance < -r) {
+			return false;
+		}
+	}
+	return true;
+}
+
+Frustum ComputeFrustum(const Pose& pose, const FovPort& fov, float zNear, float zFar) {
+	// In camera space the view direction is -z, so a point at depth d has z = -d and is inside the
+	// left plane if x >= -LeftTan * d, and so on.
+	const Quaternion& q = pose.Orientation;
+	const Vector3& p = pose.Position;
+	Vector3 forward = Rotate(q, Vector3{ 0.0f, 0.0f, -1.0f });
+
+	Frustum frustum;
+	frustum.Planes[0] = MakePlane(q, p, Vector3{ 1.0f, 0.0f, -fov.LeftTan });
+	frustum.Planes[1] = MakePlane(q, p, Vector3{ -1.0f, 0.0f, -fov.RightTan });
+	frustum.Planes[2] = MakePlane(q, p, Vector3{ 0.0f, 1.0f, -fov.DownTan });
+	frustum.Planes[3] = MakePlane(q, p, Vector3{ 0.0f, -1.0f, -fov.UpTan });
+	frustum.Planes[4] = MakePlane(q, p + forward * zNear, Vector3{ 0.0f, 0.0f, -1.0f });
+	frustum.Planes[5] = MakePlane(q, p + forward * zFar, Vector3{ 0.0f, 0.0f, 1.0f });
+	return frustum;
+}
+
+Frustum ComputeStereoCullFrustum(const Pose eyePose[EyeCount], const FovPort eyeFov[EyeCount], float zNear, float zFar) {
+	FovPort fov = eyeFov[0];
+	Vector3 center = { 0.0f, 0.0f, 0.0f };
+	for (int eye = 0; eye < EyeCount; eye++) {
+		fov.LeftTan = std::max(fov.LeftTan, eyeFov[eye].LeftTan);
+		fov.RightTan = std::max(fov.RightTan, eyeFov[eye].RightTan);
+		fov.UpTan = std::max(fov.UpTan, eyeFov[eye].UpTan);
+		fov.DownTan = std::max(fov.DownTan, eyeFov[eye].DownTan);
+		center = center + eyePose[eye].Position * (1.0f / EyeCount);
+	}
+
+	/*
+		Each eye's frustum fits in the combined one if the eye itself does, as its sides are no
+		wider. For an eye at offset o from the center (in head space), that takes an apex at least
+		o.z + |o.x| / tan behind the center for the horizontal sides, and likewise vertically.
+	*/
+	const Quaternion& orientation = eyePose[0].Orientation;
+	Quaternion inverse = Conjugate(orientation);
+	float horizontalTan = std::min(fov.LeftTan, fov.RightTan);
+	float verticalTan = std::min(fov.UpTan, fov.DownTan);
+	float setback = 0.0f;
+	Vector3 offset[EyeCount];
+	for (int eye = 0; eye < EyeCount; eye++) {
+		offset[eye] = Rotate(inverse, eyePose[eye].Position - center);
+		setback = std::max(setback, offset[eye].z + std::fabs(offset[eye].x) / horizontalTan);
+		setback = std::max(setback, offset[eye].z + std::fabs(offset[eye].y) / verticalTan);
+	}
+
+	// The near and far planes go where the nearest and farthest of the eyes' planes are.
+	float nearDepth = zFar;
+	float farDepth = 0.0f;
+	for (int eye = 0; eye < EyeCount; eye++) {
+		nearDepth = std::min(nearDepth, setback - offset[eye].z + zNear);
+		farDepth = std::max(farDepth, setback - offset[eye].z + zFar);
+	}
+
+	Pose apex;
+	apex.Orientation = orientation;
+	apex.Position = center + Rotate(orientation, Vector3{ 0.0f, 0.0f, setback });
+	return ComputeFrustum(apex, fov, nearDepth, farDepth);
+}
+
+void CullSpheres(const Frustum& frustum, const float* centerX, const float* centerY, const float* centerZ, const float* radius,
+	unsigned int count, std::vector<unsigned int>& outVisible)
+{
+	unsigned int i = 0;
+#ifdef CULLING_SSE
+	// Four spheres at a time against every plane, a sphere is out as soon as it's behind one.
+	__m128 planeX[6], planeY[6], planeZ[6], planeD[6];
+	for (int p = 0; p < 6; p++) {
+		planeX[p] = _mm_set1_ps(frustum.Planes[p].Normal.x);
+		planeY[p] = _mm_set1_ps(frustum.Planes[p].Normal.y);
+		planeZ[p] = _mm_set1_ps(frustum.Planes[p].Normal.z);
+		planeD[p] = _mm_set1_ps(frustum.Planes[p].Distance);
+	}
+	__m128 zero = _mm_setzero_ps();
+	for (; i + 4 <= count; i += 4) {
+		__m128 x = _mm_loadu_ps(centerX + i);
+		__m128 y = _mm_loadu_ps(centerY + i);
+		__m128 z = _mm_loadu_ps(centerZ + i);
+		__m128 negativeRadius = _mm_sub_ps(zero, _mm_loadu_ps(radius + i));
+		__m128 outside = _mm_setzero_ps();
+		for (int p = 0; p < 6; p++) {
+			__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX[p], x), _mm_mul_ps(planeY[p], y)), _mm_add_ps(_mm_mul_ps(planeZ[p], z), planeD[p]));
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, negativeRadius));
+		}
+		int visibleMask = ~_mm_movemask_ps(outside) & 0xf;
+		while (visibleMask != 0) {
+			int lane = 0;
+			while ((visibleMask & (1 << lane)) == 0) {
+				lane++;
+			}
+			outVisible.push_back(i + lane);
+			visibleMask &= ~(1 << lane);
+		}
+	}
+#endif
+	for (; i < count; i++) {
+		if (IsSphereVisible(frustum, centerX[i], centerY[i], centerZ[i], radius[i])) {
+			outVisible.push_back(i);
+		}
+	}
+}
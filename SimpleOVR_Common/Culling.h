@@ -0,0 +1,71 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#pragma once
+
+#include "VrTypes.h"
+#include <vector>
+
+/*
+	Frustum culling of bounding spheres.
+
+	A plane keeps the points where Dot(Normal, p) + Distance >= 0, so the normals of a frustum's
+	planes point inwards.
+*/
+
+struct Plane {
+	Vector3 Normal;
+	float Distance;
+};
+
+struct Frustum {
+	// Left, right, bottom, top, near and far.
+	Plane Planes[6];
+};
+
+// Frustum of a camera at pose (in world space) with the given field of view.
+Frustum ComputeFrustum(const Pose& pose, const FovPort& fov, float zNear, float zFar);
+
+/*
+	One frustum that contains both eyes' frusta, so the scene only has to be culled once per frame
+	instead of once per eye. It uses the widest FOV of the two eyes on each side, with its apex
+	moved back from between the eyes just far enough for both eyes' frusta to fit. The eyes are
+	expected to share an orientation, which they do for any HMD with parallel displays.
+
+	The result is slightly conservative: some objects just outside both eyes' frusta pass too.
+*/
+Frustum ComputeStereoCullFrustum(const Pose eyePose[EyeCount], const FovPort eyeFov[EyeCount], float zNear, float zFar);
+
+// Whether a sphere with center x, y, z and radius r is at least partly inside the frustum.
+bool IsSphereVisible(const Frustum& frustum, float x, float y, float z, float r);
+
+/*
+	Appends the index of every sphere that is at least partly inside the frustum to outVisible.
+	The spheres are given as separate arrays of center x, y, z and radius.
+*/
+void CullSpheres(const Frustum& frustum, const float* centerX, const float* centerY, const float* centerZ, const float* radius,
+	unsigned int count, std::vector<unsigned int>& outVisible);
@@ -0,0 +1,415 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#include "Distortion.h"
+#include "VrMath.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+	// Over what the vignette fades in: from the edges of an eye's half of the display, in NDC,
+	// and from the edges of the eye's FOV, in tangents.
+	const float VignetteScreenWidth = 0.02f;
+	const float VignetteTanWidth = 0.1f;
+
+	// Rows of the display each job of DrawDistortionMeshes draws.
+	const int DistortionBandRows = 32;
+
+	short PackSnorm(float value) {
+		value = std::max(-1.0f, std::min(1.0f, value));
+		return static_cast<short>(std::floor(value * 32767.0f + 0.5f));
+	}
+
+	unsigned char PackUnorm(float value) {
+		value = std::max(0.0f, std::min(1.0f, value));
+		return static_cast<unsigned char>(value * 255.0f + 0.5f);
+	}
+
+	Matrix4 RotationMatrix(const Quaternion& q) {
+		const Vector3 axes[3] = { { 1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, { 0.0f, 0.0f, 1.0f } };
+		Matrix4 m = MatrixIdentity();
+		for (int column = 0; column < 3; column++) {
+			Vector3 axis = Rotate(q, axes[column]);
+			m.M[0][column] = axis.x;
+			m.M[1][column] = axis.y;
+			m.M[2][column] = axis.z;
+		}
+		return m;
+	}
+
+	// The rotation part of a transposed matrix applied to v.
+	Vector3 RotateTransposed(const Matrix4& transposed, const Vector3& v) {
+		Vector3 r = {
+			transposed.M[0][0] * v.x + transposed.M[1][0] * v.y + transposed.M[2][0] * v.z,
+			transposed.M[0][1] * v.x + transposed.M[1][1] * v.y + transposed.M[2][1] * v.z,
+			transposed.M[0][2] * v.x + transposed.M[1][2] * v.y + transposed.M[2][2] * v.z
+		};
+		return r;
+	}
+
+	// Filters texels summed over their samples; the caller divides by the sample count.
+	float SampleChannel(const DistortionSource& source, float u, float v, int shift) {
+		float x = std::max(0.0f, std::min(static_cast<float>(source.Size.w - 1), u * source.Size.w - 0.5f));
+		float y = std::max(0.0f, std::min(static_cast<float>(source.Size.h - 1), v * source.Size.h - 0.5f));
+		int x0 = static_cast<int>(x);
+		int y0 = static_cast<int>(y);
+		int x1 = std::min(x0 + 1, source.Size.w - 1);
+		int y1 = std::min(y0 + 1, source.Size.h - 1);
+		float fx = x - x0;
+		float fy = y - y0;
+		unsigned int c00 = 0;
+		unsigned int c10 = 0;
+		unsigned int c01 = 0;
+		unsigned int c11 = 0;
+		for (int sample = 0; sample < source.SampleCount; sample++) {
+			const unsigned int* row0 = source.Pixels + sample * source.PlaneSize + y0 * source.Stride;
+			const unsigned int* row1 = source.Pixels + sample * source.PlaneSize + y1 * source.Stride;
+			c00 += (row0[x0] >> shift) & 0xff;
+			c10 += (row0[x1] >> shift) & 0xff;
+			c01 += (row1[x0] >> shift) & 0xff;
+			c11 += (row1[x1] >> shift) & 0xff;
+		}
+		float top = c00 + (static_cast<float>(c10) - c00) * fx;
+		float bottom = c01 + (static_cast<float>(c11) - c01) * fx;
+		return top + (bottom - top) * fy;
+	}
+
+	// A mesh vertex ready to be rasterized: in pixels, with its texture coordinates.
+	struct WarpedVertex {
+		float X, Y;
+		float Uv[3][2];
+		float Vignette;
+	};
+
+	const int WarpedAttributeCount = 7; // Uv and Vignette
+
+	const float* GetAttributes(const WarpedVertex& vertex) {
+		return &vertex.Uv[0][0];
+	}
+
+	float EdgeFunction(const WarpedVertex& a, const WarpedVertex& b, float x, float y) {
+		return (b.X - a.X) * (y - a.Y) - (b.Y - a.Y) * (x - a.X);
+	}
+
+	// The pixels of rows top to bottom - 1 whose centers are inside the triangle.
+	void DrawTriangle(const DistortionSource& eyeTexture, const WarpedVertex& v0, const WarpedVertex& v1, const WarpedVertex& v2, int top, int bottom, Image& display) {
+		float minY = std::min(v0.Y, std::min(v1.Y, v2.Y));
+		float maxY = std::max(v0.Y, std::max(v1.Y, v2.Y));
+		int firstRow = std::max(top, static_cast<int>(std::ceil(minY - 0.5f)));
+		int lastRow = std::min(bottom - 1, static_cast<int>(std::floor(maxY - 0.5f)));
+		if (firstRow > lastRow) {
+			return;
+		}
+		float minX = std::min(v0.X, std::min(v1.X, v2.X));
+		float maxX = std::max(v0.X, std::max(v1.X, v2.X));
+		int firstColumn = std::max(0, static_cast<int>(std::ceil(minX - 0.5f)));
+		int lastColumn = std::min(display.Size.w - 1, static_cast<int>(std::floor(maxX - 0.5f)));
+		float area = EdgeFunction(v0, v1, v2.X, v2.Y);
+		if (firstColumn > lastColumn || area == 0.0f) {
+			return;
+		}
+
+		// Pixels on an edge shared by two triangles are drawn by both, with the same result.
+		float inverseArea = 1.0f / area;
+		const float* a0 = GetAttributes(v0);
+		const float* a1 = GetAttributes(v1);
+		const float* a2 = GetAttributes(v2);
+		for (int y = firstRow; y <= lastRow; y++) {
+			float py = y + 0.5f;
+			unsigned int* row = &display.Pixels[y * display.Size.w];
+			for (int x = firstColumn; x <= lastColumn; x++) {
+				float px = x + 0.5f;
+				float w0 = EdgeFunction(v1, v2, px, py) * inverseArea;
+				float w1 = EdgeFunction(v2, v0, px, py) * inverseArea;
+				float w2 = 1.0f - w0 - w1;
+				if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f) {
+					continue;
+				}
+				float attributes[WarpedAttributeCount];
+				for (int i = 0; i < WarpedAttributeCount; i++) {
+					attributes[i] = a0[i] * w0 + a1[i] * w1 + a2[i] * w2;
+				}
+				const float(*uv)[2] = reinterpret_cast<const float(*)[2]>(attributes);
+				row[x] = SampleDistortedColor(eyeTexture, uv, attributes[6]);
+			}
+		}
+	}
+}
+
+DistortionVertex PackDistortionVertex(const DistortionPoint& point) {
+	DistortionVertex vertex;
+	vertex.ScreenPosNdc[0] = PackSnorm(point.ScreenPosNdc[0]);
+	vertex.ScreenPosNdc[1] = PackSnorm(point.ScreenPosNdc[1]);
+	for (int color = 0; color < 3; color++) {
+		vertex.TanEyeAngles[color][0] = PackSnorm(point.TanEyeAngles[color][0] / DistortionTanAngleRange);
+		vertex.TanEyeAngles[color][1] = PackSnorm(point.TanEyeAngles[color][1] / DistortionTanAngleRange);
+	}
+	vertex.TimewarpFactor = PackUnorm(point.TimewarpFactor);
+	vertex.Vignette = PackUnorm(point.Vignette);
+	vertex.Padding[0] = vertex.Padding[1] = 0;
+	return vertex;
+}
+
+DistortionPoint UnpackDistortionVertex(const DistortionVertex& vertex) {
+	DistortionPoint point;
+	point.ScreenPosNdc[0] = vertex.ScreenPosNdc[0] / 32767.0f;
+	point.ScreenPosNdc[1] = vertex.ScreenPosNdc[1] / 32767.0f;
+	for (int color = 0; color < 3; color++) {
+		point.TanEyeAngles[color][0] = vertex.TanEyeAngles[color][0] * (DistortionTanAngleRange / 32767.0f);
+		point.TanEyeAngles[color][1] = vertex.TanEyeAngles[color][1] * (DistortionTanAngleRange / 32767.0f);
+	}
+	point.TimewarpFactor = vertex.TimewarpFactor / 255.0f;
+	point.Vignette = vertex.Vignette / 255.0f;
+	return point;
+}
+
+void PackDistortionMesh(const std::vector<DistortionPoint>& points, const std::vector<unsigned short>& indices, DistortionMesh& outMesh) {
+	outMesh.Vertices.resize(points.size());
+	for (size_t i = 0; i < points.size(); i++) {
+		outMesh.Vertices[i] = PackDistortionVertex(points[i]);
+	}
+	outMesh.Indices = indices;
+}
+
+bool IsValidDistortionMesh(const DistortionMesh& mesh) {
+	if (mesh.Indices.size() % 3 != 0) {
+		return false;
+	}
+	for (size_t i = 0; i < mesh.Indices.size(); i++) {
+		if (mesh.Indices[i] >= mesh.Vertices.size()) {
+			return false;
+		}
+	}
+	return true;
+}
+
+DistortionPoint ComputeDistortionPoint(const LensDistortion& lens, int eye, const FovPort& fov, float ndcX, float ndcY) {
+	DistortionPoint point;
+	point.ScreenPosNdc[0] = ndcX;
+	point.ScreenPosNdc[1] = ndcY;
+	point.TimewarpFactor = std::max(0.0f, std::min(1.0f, (ndcX + 1.0f) * 0.5f));
+
+	// Where the point is relative to the lens, in tangents at the center, and how much further
+	// out the lens makes it look for each color.
+	float lensX = (eye == 0 ? -0.5f : 0.5f) * lens.LensSeparationInMeters;
+	float sx = (ndcX * 0.5f * lens.ScreenSizeInMeters[0] - lensX) / lens.MetersPerTanAngleAtCenter;
+	float sy = ndcY * 0.5f * lens.ScreenSizeInMeters[1] / lens.MetersPerTanAngleAtCenter;
+	float r2 = sx * sx + sy * sy;
+	float green = lens.K[0] + r2 * (lens.K[1] + r2 * lens.K[2]);
+	float scale[3] = {
+		green * (1.0f + lens.ChromaticAberration[0] + lens.ChromaticAberration[1] * r2),
+		green,
+		green * (1.0f + lens.ChromaticAberration[2] + lens.ChromaticAberration[3] * r2)
+	};
+	for (int color = 0; color < 3; color++) {
+		point.TanEyeAngles[color][0] = sx * scale[color];
+		point.TanEyeAngles[color][1] = sy * scale[color];
+	}
+
+	// Black outside the eye's half of the display, beyond the lens and outside what was drawn.
+	float halfLeft = eye == 0 ? -1.0f : 0.0f;
+	float screenEdge = std::min(std::min(ndcX - halfLeft, halfLeft + 1.0f - ndcX), 1.0f - std::fabs(ndcY));
+	float lensEdge = lens.MaxRadius - std::sqrt(r2);
+	float tanX = point.TanEyeAngles[1][0];
+	float tanY = point.TanEyeAngles[1][1];
+	float fovEdge = std::min(std::min(fov.RightTan - tanX, fov.LeftTan + tanX), std::min(fov.UpTan - tanY, fov.DownTan + tanY));
+	float vignette = std::min(screenEdge / VignetteScreenWidth, std::min(lensEdge, fovEdge) / VignetteTanWidth);
+	point.Vignette = std::max(0.0f, std::min(1.0f, vignette));
+	return point;
+}
+
+void GenerateDistortionMesh(const LensDistortion& lens, int eye, const FovPort& fov, int columns, int rows, std::vector<DistortionPoint>& outPoints, std::vector<unsigned short>& outIndices) {
+	float halfLeft = eye == 0 ? -1.0f : 0.0f;
+	outPoints.resize((columns + 1) * (rows + 1));
+	for (int row = 0; row <= rows; row++) {
+		for (int column = 0; column <= columns; column++) {
+			float ndcX = halfLeft + static_cast<float>(column) / columns;
+			float ndcY = 1.0f - 2.0f * row / rows;
+			outPoints[row * (columns + 1) + column] = ComputeDistortionPoint(lens, eye, fov, ndcX, ndcY);
+		}
+	}
+
+	outIndices.resize(columns * rows * 6);
+	unsigned short* index = outIndices.data();
+	for (int row = 0; row < rows; row++) {
+		for (int column = 0; column < columns; column++) {
+			unsigned short topLeft = static_cast<unsigned short>(row * (columns + 1) + column);
+			unsigned short bottomLeft = static_cast<unsigned short>(topLeft + columns + 1);
+			*index++ = topLeft;
+			*index++ = static_cast<unsigned short>(topLeft + 1);
+			*index++ = bottomLeft;
+			*index++ = static_cast<unsigned short>(topLeft + 1);
+			*index++ = static_cast<unsigned short>(bottomLeft + 1);
+			*index++ = bottomLeft;
+		}
+	}
+}
+
+DistortionConstants ComputeDistortionConstants(const FovPort& fov, Size2i textureSize, const Rect2i& viewport,
+	const Quaternion& renderOrientation, const Quaternion& startOrientation, const Quaternion& endOrientation)
+{
+	// A tangent's NDC in the eye's projection (see PerspectiveProjection), then its texture
+	// coordinates within the viewport.
+	float xScale = 2.0f / (fov.LeftTan + fov.RightTan);
+	float xOffset = (fov.LeftTan - fov.RightTan) * xScale * 0.5f;
+	float yScale = 2.0f / (fov.UpTan + fov.DownTan);
+	float yOffset = (fov.UpTan - fov.DownTan) * yScale * 0.5f;
+	float width = static_cast<float>(textureSize.w);
+	float height = static_cast<float>(textureSize.h);
+
+	DistortionConstants constants;
+	constants.UvScaleOffset[0] = 0.5f * xScale * viewport.Size.w / width;
+	constants.UvScaleOffset[1] = -0.5f * yScale * viewport.Size.h / height;
+	constants.UvScaleOffset[2] = (viewport.Pos.x + 0.5f * (xOffset + 1.0f) * viewport.Size.w) / width;
+	constants.UvScaleOffset[3] = (viewport.Pos.y + 0.5f * (yOffset + 1.0f) * viewport.Size.h) / height;
+
+	Quaternion inverseRender = Conjugate(renderOrientation);
+	constants.TimewarpStart = Transposed(RotationMatrix(inverseRender * startOrientation));
+	constants.TimewarpEnd = Transposed(RotationMatrix(inverseRender * endOrientation));
+	return constants;
+}
+
+void WarpDistortionPoint(const DistortionPoint& point, const DistortionConstants& constants, float outUv[3][2]) {
+	for (int color = 0; color < 3; color++) {
+		Vector3 direction = { point.TanEyeAngles[color][0], point.TanEyeAngles[color][1], -1.0f };
+		Vector3 start = RotateTransposed(constants.TimewarpStart, direction);
+		Vector3 end = RotateTransposed(constants.TimewarpEnd, direction);
+		Vector3 warped = start + (end - start) * point.TimewarpFactor;
+		float inverseZ = -1.0f / warped.z;
+		outUv[color][0] = warped.x * inverseZ * constants.UvScaleOffset[0] + constants.UvScaleOffset[2];
+		outUv[color][1] = warped.y * inverseZ * constants.UvScaleOffset[1] + constants.UvScaleOffset[3];
+	}
+}
+
+DistortionSource GetDistortionSource(const Image& image) {
+	DistortionSource source;
+	source.Pixels = image.Pixels.data();
+	source.Size = image.Size;
+	source.Stride = image.Size.w;
+	source.PlaneSize = image.Size.w * image.Size.h;
+	source.SampleCount = 1;
+	return source;
+}
+
+unsigned int SampleDistortedColor(const DistortionSource& eyeTexture, const float uv[3][2], float vignette) {
+	unsigned int pixel = 0xff000000u;
+	float scale = vignette / eyeTexture.SampleCount;
+	for (int color = 0; color < 3; color++) {
+		float value = SampleChannel(eyeTexture, uv[color][0], uv[color][1], color * 8) * scale;
+		pixel |= static_cast<unsigned int>(std::max(0.0f, std::min(255.0f, value)) + 0.5f) << (color * 8);
+	}
+	return pixel;
+}
+
+void DrawDistortionMeshes(const DistortionSource& eyeTexture, const DistortionMesh* const meshes[EyeCount], const DistortionConstants constants[EyeCount], Image& display, JobSystem& jobs) {
+	// Every vertex is warped once, as the vertex shader would.
+	std::vector<WarpedVertex> warped[EyeCount];
+	float halfWidth = 0.5f * display.Size.w;
+	float halfHeight = 0.5f * display.Size.h;
+	for (int eye = 0; eye < EyeCount; eye++) {
+		warped[eye].resize(meshes[eye]->Vertices.size());
+		for (size_t i = 0; i < warped[eye].size(); i++) {
+			DistortionPoint point = UnpackDistortionVertex(meshes[eye]->Vertices[i]);
+			WarpedVertex& vertex = warped[eye][i];
+			vertex.X = (point.ScreenPosNdc[0] + 1.0f) * halfWidth;
+			vertex.Y = (1.0f - point.ScreenPosNdc[1]) * halfHeight;
+			WarpDistortionPoint(point, constants[eye], vertex.Uv);
+			vertex.Vignette = point.Vignette;
+		}
+	}
+
+	std::fill(display.Pixels.begin(), display.Pixels.end(), 0xff000000u);
+	unsigned int bandCount = (display.Size.h + DistortionBandRows - 1) / DistortionBandRows;
+	jobs.ParallelFor(bandCount, [&](unsigned int band, int thread) {
+		int top = band * DistortionBandRows;
+		int bottom = std::min(display.Size.h, top + DistortionBandRows);
+		for (int eye = 0; eye < EyeCount; eye++) {
+			const std::vector<unsigned short>& indices = meshes[eye]->Indices;
+			const WarpedVertex* vertices = warped[eye].data();
+			for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+				DrawTriangle(eyeTexture, vertices[indices[i]], vertices[indices[i + 1]], vertices[indices[i + 2]], top, bottom, display);
+			}
+		}
+	});
+}
+
+unsigned long long CountDistortionTexels(const DistortionMesh* const meshes[EyeCount], const DistortionConstants constants[EyeCount], Size2i textureSize) {
+	const int tileSize = DistortionTexelTileSize;
+	int columns = (textureSize.w + tileSize - 1) / tileSize;
+	int rows = (textureSize.h + tileSize - 1) / tileSize;
+	std::vector<unsigned char> touched(columns * rows, 0);
+	std::vector<float> bounds; // Texel rectangle per vertex: left, top, right, bottom
+	for (int eye = 0; eye < EyeCount; eye++) {
+		DistortionConstants unwarped = constants[eye];
+		unwarped.TimewarpStart = MatrixIdentity();
+		unwarped.TimewarpEnd = MatrixIdentity();
+		const DistortionMesh& mesh = *meshes[eye];
+		bounds.resize(mesh.Vertices.size() * 4);
+		for (size_t i = 0; i < mesh.Vertices.size(); i++) {
+			float uv[3][2];
+			WarpDistortionPoint(UnpackDistortionVertex(mesh.Vertices[i]), unwarped, uv);
+			float* rect = &bounds[i * 4];
+			rect[0] = rect[2] = uv[0][0] * textureSize.w - 0.5f;
+			rect[1] = rect[3] = uv[0][1] * textureSize.h - 0.5f;
+			for (int color = 1; color < 3; color++) {
+				rect[0] = std::min(rect[0], uv[color][0] * textureSize.w - 0.5f);
+				rect[2] = std::max(rect[2], uv[color][0] * textureSize.w - 0.5f);
+				rect[1] = std::min(rect[1], uv[color][1] * textureSize.h - 0.5f);
+				rect[3] = std::max(rect[3], uv[color][1] * textureSize.h - 0.5f);
+			}
+		}
+
+		// Each triangle's bounding rectangle, widened to the texels bilinear filtering reads.
+		for (size_t i = 0; i + 2 < mesh.Indices.size(); i += 3) {
+			const float* a = &bounds[mesh.Indices[i] * 4];
+			const float* b = &bounds[mesh.Indices[i + 1] * 4];
+			const float* c = &bounds[mesh.Indices[i + 2] * 4];
+			int left = static_cast<int>(std::floor(std::min(a[0], std::min(b[0], c[0]))));
+			int top = static_cast<int>(std::floor(std::min(a[1], std::min(b[1], c[1]))));
+			int right = static_cast<int>(std::floor(std::max(a[2], std::max(b[2], c[2])))) + 1;
+			int bottom = static_cast<int>(std::floor(std::max(a[3], std::max(b[3], c[3])))) + 1;
+			left = std::max(0, std::min(textureSize.w - 1, left)) / tileSize;
+			right = std::max(0, std::min(textureSize.w - 1, right)) / tileSize;
+			top = std::max(0, std::min(textureSize.h - 1, top)) / tileSize;
+			bottom = std::max(0, std::min(textureSize.h - 1, bottom)) / tileSize;
+			for (int row = top; row <= bottom; row++) {
+				std::fill(touched.begin() + row * columns + left, touched.begin() + row * columns + right + 1, 1);
+			}
+		}
+	}
+
+	unsigned long long texels = 0;
+	for (int row = 0; row < rows; row++) {
+		int height = std::min(tileSize, textureSize.h - row * tileSize);
+		for (int column = 0; column < columns; column++) {
+			if (touched[row * columns + column]) {
+				texels += height * std::min(tileSize, textureSize.w - column * tileSize);
+			}
+		}
+	}
+	return texels;
+}
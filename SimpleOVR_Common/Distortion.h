@@ -0,0 +1,172 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#pragma once
+
+#include "Image.h"
+#include "JobSystem.h"
+#include "VrTypes.h"
+#include <vector>
+
+/*
+	Lens distortion and timewarp done by the application instead of LibOVR.
+
+	Each point of the display is seen through the lens in a direction that depends on where it is
+	relative to the lens, and a little differently for red, green and blue. A distortion mesh
+	samples that mapping on a grid over an eye's half of the display: each vertex has its position
+	on the display and, per color, the tangents of the angle it is seen at (+y up, -z forward).
+	The final pass draws both eyes' meshes, sampling the eye texture at those angles. Only the
+	constants depend on the FOV and viewport the eye was drawn with, so the mesh is made once per
+	eye and kept on the device, however the resolution is scaled.
+
+	DistortionPoint is a vertex as it is made, with the layout of ovrDistortionVertex.
+	DistortionVertex is how the device keeps it, in half the size.
+
+	Timewarp: by the time the frame is scanned out the head has turned a little from the pose the
+	eyes were drawn with. Each direction is rotated from the latest pose into the one drawn with
+	before it is looked up, so the image stays where the head is. Only rotation is corrected. The
+	display scans out over a whole refresh, so the rotation is blended between the poses at the
+	start and the end of scanout by each vertex's TimewarpFactor.
+*/
+
+struct DistortionPoint {
+	float ScreenPosNdc[2]; // Of the whole display
+	float TimewarpFactor; // 0 at the start of scanout, 1 at the end
+	float Vignette; // Fades the image to black at its edges
+	float TanEyeAngles[3][2]; // Red, green and blue
+};
+
+// DistortionPoint packed: angles and positions as snorm16, the factors as unorm8.
+struct DistortionVertex {
+	short ScreenPosNdc[2];
+	short TanEyeAngles[3][2]; // Divided by DistortionTanAngleRange
+	unsigned char TimewarpFactor;
+	unsigned char Vignette;
+	unsigned char Padding[2];
+};
+
+// Largest tangent a DistortionVertex holds, at about 1/8000 tangent precision.
+const float DistortionTanAngleRange = 4.0f;
+
+DistortionVertex PackDistortionVertex(const DistortionPoint& point);
+DistortionPoint UnpackDistortionVertex(const DistortionVertex& vertex);
+
+// An eye's mesh as the device keeps it: triangles listed by index.
+struct DistortionMesh {
+	std::vector<DistortionVertex> Vertices;
+	std::vector<unsigned short> Indices;
+};
+
+void PackDistortionMesh(const std::vector<DistortionPoint>& points, const std::vector<unsigned short>& indices, DistortionMesh& outMesh);
+
+// Whether the indices make whole triangles of the mesh's vertices, which devices rely on.
+bool IsValidDistortionMesh(const DistortionMesh& mesh);
+
+/*
+	A radial lens model, for HMDs that don't make their own meshes. Each eye's lens sits
+	LensSeparationInMeters / 2 left or right of the display's center. A point on the display
+	s = offset from the lens / MetersPerTanAngleAtCenter is seen at the tangent
+	s * (K[0] + K[1] r^2 + K[2] r^4), r = |s|, for green. Red is that times
+	1 + ChromaticAberration[0] + ChromaticAberration[1] r^2, blue times
+	1 + ChromaticAberration[2] + ChromaticAberration[3] r^2. Nothing further from the lens than
+	r = MaxRadius is seen through it.
+*/
+struct LensDistortion {
+	Size2i Resolution; // Of the whole display
+	float ScreenSizeInMeters[2];
+	float LensSeparationInMeters;
+	float MetersPerTanAngleAtCenter;
+	float K[3];
+	float ChromaticAberration[4];
+	float MaxRadius;
+};
+
+// Vertices per row and column of the meshes are one more.
+const int DistortionMeshColumns = 64;
+const int DistortionMeshRows = 64;
+
+// The point at (ndcX, ndcY) on the display, seen by eye through the lens with the eye drawn at fov.
+DistortionPoint ComputeDistortionPoint(const LensDistortion& lens, int eye, const FovPort& fov, float ndcX, float ndcY);
+
+// A grid of columns by rows cells of ComputeDistortionPoint over eye's half of the display.
+void GenerateDistortionMesh(const LensDistortion& lens, int eye, const FovPort& fov, int columns, int rows, std::vector<DistortionPoint>& outPoints, std::vector<unsigned short>& outIndices);
+
+/*
+	The final pass's constants for an eye, laid out for the D3D11 distortion shader. A tangent t
+	is looked up at t * UvScaleOffset.xy + UvScaleOffset.zw in the eye texture. The timewarp
+	matrices take a direction seen with the pose at the start or end of scanout to the direction
+	it had when the eye was drawn; transposed, as the shader expects column-major matrices.
+*/
+struct DistortionConstants {
+	Matrix4 TimewarpStart;
+	Matrix4 TimewarpEnd;
+	float UvScaleOffset[4];
+};
+
+// renderOrientation is the head's when the eye was drawn, the others when scanout starts and ends.
+DistortionConstants ComputeDistortionConstants(const FovPort& fov, Size2i textureSize, const Rect2i& viewport,
+	const Quaternion& renderOrientation, const Quaternion& startOrientation, const Quaternion& endOrientation);
+
+// Where a point looks its colors up in the eye texture, as the distortion vertex shader does.
+void WarpDistortionPoint(const DistortionPoint& point, const DistortionConstants& constants, float outUv[3][2]);
+
+/*
+	The eye texture as the final pass samples it: an Image, or a multisampled target as
+	SoftwareRasterizer keeps it, SampleCount planes of Stride by Size.h pixels one after the other.
+	Sampling a multisampled one averages the samples of each texel it filters, which is what
+	resolving it first would have done, less the rounding.
+*/
+struct DistortionSource {
+	const unsigned int* Pixels;
+	Size2i Size;
+	int Stride; // Pixels per row
+	int PlaneSize; // Pixels per sample plane
+	int SampleCount;
+};
+
+DistortionSource GetDistortionSource(const Image& image);
+
+// The eye texture's color at outUv from WarpDistortionPoint, filtered bilinearly with the
+// coordinates clamped to the texture, times the vignette. Alpha is 255.
+unsigned int SampleDistortedColor(const DistortionSource& eyeTexture, const float uv[3][2], float vignette);
+
+/*
+	The final pass on the CPU: both eyes' meshes drawn into display, which has to be sized
+	already, with the warped coordinates interpolated linearly across each triangle like a GPU
+	would. Pixels no triangle covers are black. The rows are split into bands over jobs' threads.
+*/
+void DrawDistortionMeshes(const DistortionSource& eyeTexture, const DistortionMesh* const meshes[EyeCount], const DistortionConstants constants[EyeCount], Image& display, JobSystem& jobs);
+
+/*
+	Roughly how many texels of the eye texture the final pass reads: those of the
+	DistortionTexelTileSize tiles, which GPUs fetch and cache textures in, that the meshes'
+	triangles reach with their bilinear footprint. The timewarp rotation is left out, it only
+	shifts the footprint a little.
+*/
+const int DistortionTexelTileSize = 8;
+
+unsigned long long CountDistortionTexels(const DistortionMesh* const meshes[EyeCount], const DistortionConstants constants[EyeCount], Size2i textureSize);
@@ -0,0 +1,170 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#include "DrawQueue.h"
+#include <cstring>
+#include <utility>
+
+namespace {
+	const int RadixBits = 8;
+	const int RadixBuckets = 1 << RadixBits;
+	const int RadixRounds = 64 / RadixBits;
+}
+
+unsigned long long MakeDrawKey(unsigned int pass, unsigned int shader, unsigned int material, float depth) {
+	unsigned int depthBits = 0;
+	if (depth > 0.0f) {
+		std::memcpy(&depthBits, &depth, sizeof(depthBits));
+	}
+	unsigned long long key = pass & ((1u << DrawKeyPassBits) - 1);
+	key = key << DrawKeyShaderBits | (shader & ((1u << DrawKeyShaderBits) - 1));
+	key = key << DrawKeyMaterialBits | (material & ((1u << DrawKeyMaterialBits) - 1));
+	key = key << DrawKeyDepthBits | depthBits;
+	return key;
+}
+
+int RadixSortKeys(unsigned long long* keys, unsigned int* values, unsigned long long* scratchKeys, unsigned int* scratchValues, unsigned int count) {
+	if (count < 2) {
+		return 0;
+	}
+
+	// The histograms of all rounds in one go.
+	unsigned int histograms[RadixRounds * RadixBuckets];
+	std::memset(histograms, 0, sizeof(histograms));
+	for (unsigned int i = 0; i < count; i++) {
+		unsigned long long key = keys[i];
+		for (int round = 0; round < RadixRounds; round++) {
+			histograms[round * RadixBuckets + static_cast<unsigned int>(key >> (round * RadixBits) & (RadixBuckets - 1))]++;
+		}
+	}
+
+	unsigned long long* fromKeys = keys;
+	unsigned int* fromValues = values;
+	unsigned long long* toKeys = scratchKeys;
+	unsigned int* toValues = scratchValues;
+	int rounds = 0;
+	for (int round = 0; round < RadixRounds; round++) {
+		unsigned int* histogram = &histograms[round * RadixBuckets];
+		int shift = round * RadixBits;
+		if (histogram[fromKeys[0] >> shift & (RadixBuckets - 1)] == count) {
+			continue;
+		}
+
+		unsigned int offsets[RadixBuckets];
+		unsigned int offset = 0;
+		for (int bucket = 0; bucket < RadixBuckets; bucket++) {
+			offsets[bucket] = offset;
+			offset += histogram[bucket];
+		}
+		for (unsigned int i = 0; i < count; i++) {
+			unsigned int destination = offsets[fromKeys[i] >> shift & (RadixBuckets - 1)]++;
+			toKeys[destination] = fromKeys[i];
+			toValues[destination] = fromValues[i];
+		}
+		std::swap(fromKeys, toKeys);
+		std::swap(fromValues, toValues);
+		rounds++;
+	}
+
+	if (fromKeys != keys) {
+		std::memcpy(keys, fromKeys, count * sizeof(unsigned long long));
+		std::memcpy(values, fromValues, count * sizeof(unsigned int));
+	}
+	return rounds;
+}
+
+DrawQueue::DrawQueue() {
+	ResetStatistics();
+}
+
+void DrawQueue::Clear() {
+	packets.clear();
+	keys.clear();
+	order.clear();
+}
+
+void DrawQueue::Add(const DrawPacket& packet) {
+	order.push_back(static_cast<unsigned int>(packets.size()));
+	keys.push_back(packet.Key);
+	packets.push_back(packet);
+}
+
+void DrawQueue::Sort() {
+	unsigned int count = static_cast<unsigned int>(packets.size());
+	if (count < 2) {
+		return;
+	}
+	if (scratchKeys.size() < count) {
+		scratchKeys.resize(count);
+		scratchOrder.resize(count);
+	}
+	int rounds = RadixSortKeys(&keys[0], &order[0], &scratchKeys[0], &scratchOrder[0], count);
+	statistics.SortRounds += rounds;
+	statistics.SkippedRounds += RadixRounds - rounds;
+}
+
+unsigned int DrawQueue::GetPacketCount() const {
+	return static_cast<unsigned int>(packets.size());
+}
+
+const DrawPacket& DrawQueue::GetPacket(unsigned int index) const {
+	return packets[order[index]];
+}
+
+void DrawQueue::Submit(RenderContext& context, unsigned int instanceCount, const PassBinder& bindPass) {
+	int pass = -1;
+	int material = -1;
+	for (size_t i = 0; i < order.size(); i++) {
+		const DrawPacket& packet = packets[order[i]];
+		if (packet.Pass != pass) {
+			pass = packet.Pass;
+			bindPass(context, pass);
+			statistics.PassChanges++;
+		}
+		if (packet.Material != material) {
+			material = packet.Material;
+			context.SetMaterial(material);
+			statistics.MaterialChanges++;
+		}
+		context.BindConstants(ConstantSlot_Object, packet.ObjectOffset, sizeof(Matrix4));
+		if (instanceCount > 1) {
+			context.DrawInstanced(packet.VertexCount, instanceCount, packet.StartVertex);
+		}
+		else {
+			context.Draw(packet.VertexCount, packet.StartVertex);
+		}
+	}
+	statistics.Packets += order.size();
+}
+
+const DrawQueue::Statistics& DrawQueue::GetStatistics() const {
+	return statistics;
+}
+
+void DrawQueue::ResetStatistics() {
+	std::memset(&statistics, 0, sizeof(statistics));
+}
@@ -0,0 +1,114 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#pragma once
+
+#include "RenderDevice.h"
+#include <functional>
+#include <vector>
+
+/*
+	Draw submission through sorted packets. Instead of drawing objects in whatever order they come
+	in, the frame loop describes each draw as a DrawPacket and DrawQueue issues them ordered by a
+	64-bit key, most significant bits first:
+
+		pass (6 bits) | shader (10 bits) | material (16 bits) | depth (32 bits)
+
+	so draws that share a pass, and within it a pipeline and a material, follow each other and the
+	state between them only changes where it has to. Within a material they go front to back, for
+	the depth test to reject what is hidden early. Depth is a non-negative float, whose bits sort
+	like the number itself. The scene has a single pipeline for now, so shader is 0 there.
+
+	The keys are sorted with an LSD radix sort, a byte per round over (key, packet) pairs. Rounds
+	whose byte is the same in every key would change nothing and are skipped, which with small
+	passes, shaders and materials is most of the upper half.
+*/
+const int DrawKeyPassBits = 6;
+const int DrawKeyShaderBits = 10;
+const int DrawKeyMaterialBits = 16;
+const int DrawKeyDepthBits = 32;
+
+// Negative depths sort as 0.
+unsigned long long MakeDrawKey(unsigned int pass, unsigned int shader, unsigned int material, float depth);
+
+struct DrawPacket {
+	unsigned long long Key;
+	int Pass; // The argument bindPass is called with, see DrawQueue::Submit
+	int Material;
+	unsigned int ObjectOffset; // Of the object constants, a Matrix4
+	unsigned int VertexCount;
+	unsigned int StartVertex;
+};
+
+// Sorts count (key, value) pairs by key in place, keeping pairs with the same key in order, with
+// scratch as room for another count. Returns how many rounds it took.
+int RadixSortKeys(unsigned long long* keys, unsigned int* values, unsigned long long* scratchKeys, unsigned int* scratchValues, unsigned int count);
+
+class DrawQueue {
+public:
+	struct Statistics {
+		unsigned long long Packets;
+		unsigned long long SortRounds;
+		unsigned long long SkippedRounds; // Rounds the sort didn't need
+		unsigned long long PassChanges;
+		unsigned long long MaterialChanges;
+	};
+
+	typedef std::function<void(RenderContext& context, int pass)> PassBinder;
+
+	DrawQueue();
+
+	// Forgets the packets, not the statistics.
+	void Clear();
+	void Add(const DrawPacket& packet);
+
+	// Orders the packets by key. Packets with the same key stay in the order they were added.
+	void Sort();
+
+	unsigned int GetPacketCount() const;
+
+	// In the order they are submitted: by key after Sort, otherwise as added.
+	const DrawPacket& GetPacket(unsigned int index) const;
+
+	/*
+		Draws the packets on context with instanceCount instances each, DrawInstanced if that is
+		more than one. Before the first packet of each pass bindPass binds what the pass needs, and
+		SetMaterial is only called where the material changes.
+	*/
+	void Submit(RenderContext& context, unsigned int instanceCount, const PassBinder& bindPass);
+
+	const Statistics& GetStatistics() const;
+	void ResetStatistics();
+
+private:
+	std::vector<DrawPacket> packets;
+	std::vector<unsigned long long> keys;
+	std::vector<unsigned int> order; // Packet indices, by key once sorted
+	std::vector<unsigned long long> scratchKeys;
+	std::vector<unsigned int> scratchOrder;
+	Statistics statistics;
+};
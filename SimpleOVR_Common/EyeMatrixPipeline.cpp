@@ -0,0 +1,259 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#include "EyeMatrixPipeline.h"
+#include "VrMath.h"
+#include <cstring>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE__)
+#define EYE_MATRIX_PIPELINE_SSE
+#include <xmmintrin.h>
+#endif
+
+namespace {
+	// Structure of arrays for up to four views, one view per lane.
+	struct ViewBatch {
+		float Qx[4], Qy[4], Qz[4], Qw[4];
+		float Px[4], Py[4], Pz[4];
+	};
+
+	/*
+		Rows of the view matrix of each view, three of them as the fourth row is always (0, 0, 0, 1).
+		View[row][column][lane].
+	*/
+	struct ViewMatrixBatch {
+		float View[3][4][4];
+	};
+
+	void LoadBatch(const Pose* poses, int count, ViewBatch& batch) {
+		for (int lane = 0; lane < 4; lane++) {
+			// Unused lanes get an identity pose so they don't produce garbage (or NaNs).
+			Pose pose = { { 0.0f, 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f, 0.0f } };
+			if (lane < count) {
+				pose = poses[lane];
+			}
+			batch.Qx[lane] = pose.Orientation.x;
+			batch.Qy[lane] = pose.Orientation.y;
+			batch.Qz[lane] = pose.Orientation.z;
+			batch.Qw[lane] = pose.Orientation.w;
+			batch.Px[lane] = pose.Position.x;
+			batch.Py[lane] = pose.Position.y;
+			batch.Pz[lane] = pose.Position.z;
+		}
+	}
+
+	/*
+		The view matrix is the inverse of the world pose. For a rotation R and position p that is
+		R transposed in the upper left 3x3 and -R^T * p in the last column, the same thing LookAtRH
+		ends up with when looking along the rotated forward vector. The world pose itself is the
+		body transform applied to the eye pose.
+	*/
+#ifdef EYE_MATRIX_PIPELINE_SSE
+	void ComputeViewMatrices(const ViewBatch& batch, const Quaternion& body, const float bodyRotation[3][3], const Vector3& bodyPosition, ViewMatrixBatch& out) {
+		__m128 ex = _mm_loadu_ps(batch.Qx);
+		__m128 ey = _mm_loadu_ps(batch.Qy);
+		__m128 ez = _mm_loadu_ps(batch.Qz);
+		__m128 ew = _mm_loadu_ps(batch.Qw);
+
+		// World orientation, body * eye.
+		__m128 bx = _mm_set1_ps(body.x);
+		__m128 by = _mm_set1_ps(body.y);
+		__m128 bz = _mm_set1_ps(body.z);
+		__m128 bw = _mm_set1_ps(body.w);
+		__m128 qx = _mm_sub_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(bw, ex), _mm_mul_ps(bx, ew)), _mm_mul_ps(by, ez)), _mm_mul_ps(bz, ey));
+		__m128 qy = _mm_add_ps(_mm_add_ps(_mm_sub_ps(_mm_mul_ps(bw, ey), _mm_mul_ps(bx, ez)), _mm_mul_ps(by, ew)), _mm_mul_ps(bz, ex));
+		__m128 qz = _mm_add_ps(_mm_sub_ps(_mm_add_ps(_mm_mul_ps(bw, ez), _mm_mul_ps(bx, ey)), _mm_mul_ps(by, ex)), _mm_mul_ps(bz, ew));
+		__m128 qw = _mm_sub_ps(_mm_sub_ps(_mm_sub_ps(_mm_mul_ps(bw, ew), _mm_mul_ps(bx, ex)), _mm_mul_ps(by, ey)), _mm_mul_ps(bz, ez));
+
+		// Poses from the tracker are only approximately unit length, LookAtRH normalizes as well.
+		__m128 lengthSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(qx, qx), _mm_mul_ps(qy, qy)), _mm_add_ps(_mm_mul_ps(qz, qz), _mm_mul_ps(qw, qw)));
+		__m128 twoOverLengthSquared = _mm_div_ps(_mm_set1_ps(2.0f), lengthSquared);
+
+		// Rotation matrix of the world orientation.
+		__m128 xx = _mm_mul_ps(qx, qx), yy = _mm_mul_ps(qy, qy), zz = _mm_mul_ps(qz, qz);
+		__m128 xy = _mm_mul_ps(qx, qy), xz = _mm_mul_ps(qx, qz), yz = _mm_mul_ps(qy, qz);
+		__m128 wx = _mm_mul_ps(qw, qx), wy = _mm_mul_ps(qw, qy), wz = _mm_mul_ps(qw, qz);
+		__m128 one = _mm_set1_ps(1.0f);
+		__m128 s = twoOverLengthSquared;
+		__m128 r00 = _mm_sub_ps(one, _mm_mul_ps(s, _mm_add_ps(yy, zz)));
+		__m128 r01 = _mm_mul_ps(s, _mm_sub_ps(xy, wz));
+		__m128 r02 = _mm_mul_ps(s, _mm_add_ps(xz, wy));
+		__m128 r10 = _mm_mul_ps(s, _mm_add_ps(xy, wz));
+		__m128 r11 = _mm_sub_ps(one, _mm_mul_ps(s, _mm_add_ps(xx, zz)));
+		__m128 r12 = _mm_mul_ps(s, _mm_sub_ps(yz, wx));
+		__m128 r20 = _mm_mul_ps(s, _mm_sub_ps(xz, wy));
+		__m128 r21 = _mm_mul_ps(s, _mm_add_ps(yz, wx));
+		__m128 r22 = _mm_sub_ps(one, _mm_mul_ps(s, _mm_add_ps(xx, yy)));
+
+		// World position, body position + body rotation * eye position.
+		__m128 ux = _mm_loadu_ps(batch.Px);
+		__m128 uy = _mm_loadu_ps(batch.Py);
+		__m128 uz = _mm_loadu_ps(batch.Pz);
+		__m128 px = _mm_add_ps(_mm_set1_ps(bodyPosition.x), _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(bodyRotation[0][0]), ux), _mm_mul_ps(_mm_set1_ps(bodyRotation[0][1]), uy)), _mm_mul_ps(_mm_set1_ps(bodyRotation[0][2]), uz)));
+		__m128 py = _mm_add_ps(_mm_set1_ps(bodyPosition.y), _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(bodyRotation[1][0]), ux), _mm_mul_ps(_mm_set1_ps(bodyRotation[1][1]), uy)), _mm_mul_ps(_mm_set1_ps(bodyRotation[1][2]), uz)));
+		__m128 pz = _mm_add_ps(_mm_set1_ps(bodyPosition.z), _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(bodyRotation[2][0]), ux), _mm_mul_ps(_mm_set1_ps(bodyRotation[2][1]), uy)), _mm_mul_ps(_mm_set1_ps(bodyRotation[2][2]), uz)));
+
+		// Row i of the view matrix is column i of the rotation.
+		__m128 zero = _mm_setzero_ps();
+		_mm_storeu_ps(out.View[0][0], r00);
+		_mm_storeu_ps(out.View[0][1], r10);
+		_mm_storeu_ps(out.View[0][2], r20);
+		_mm_storeu_ps(out.View[0][3], _mm_sub_ps(zero, _mm_add_ps(_mm_add_ps(_mm_mul_ps(r00, px), _mm_mul_ps(r10, py)), _mm_mul_ps(r20, pz))));
+		_mm_storeu_ps(out.View[1][0], r01);
+		_mm_storeu_ps(out.View[1][1], r11);
+		_mm_storeu_ps(out.View[1][2], r21);
+		_mm_storeu_ps(out.View[1][3], _mm_sub_ps(zero, _mm_add_ps(_mm_add_ps(_mm_mul_ps(r01, px), _mm_mul_ps(r11, py)), _mm_mul_ps(r21, pz))));
+		_mm_storeu_ps(out.View[2][0], r02);
+		_mm_storeu_ps(out.View[2][1], r12);
+		_mm_storeu_ps(out.View[2][2], r22);
+		_mm_storeu_ps(out.View[2][3], _mm_sub_ps(zero, _mm_add_ps(_mm_add_ps(_mm_mul_ps(r02, px), _mm_mul_ps(r12, py)), _mm_mul_ps(r22, pz))));
+	}
+
+	/*
+		projection * view, written column-major. Column c of the product is the projection's columns
+		weighted by column c of the view matrix, so with the projection stored by column every output
+		column is four multiply-adds and a store.
+	*/
+	void MultiplyColumnMajor(const Matrix4& projectionColumns, const ViewMatrixBatch& views, int lane, Matrix4& out) {
+		__m128 p0 = _mm_loadu_ps(projectionColumns.M[0]);
+		__m128 p1 = _mm_loadu_ps(projectionColumns.M[1]);
+		__m128 p2 = _mm_loadu_ps(projectionColumns.M[2]);
+		__m128 p3 = _mm_loadu_ps(projectionColumns.M[3]);
+		for (int column = 0; column < 4; column++) {
+			__m128 c = _mm_add_ps(_mm_add_ps(
+				_mm_mul_ps(_mm_set1_ps(views.View[0][column][lane]), p0),
+				_mm_mul_ps(_mm_set1_ps(views.View[1][column][lane]), p1)),
+				_mm_mul_ps(_mm_set1_ps(views.View[2][column][lane]), p2));
+			if (column == 3) {
+				c = _mm_add_ps(c, p3);
+			}
+			_mm_storeu_ps(out.M[column], c);
+		}
+	}
+#else
+	void ComputeViewMatrices(const ViewBatch& batch, const Quaternion& body, const float bodyRotation[3][3], const Vector3& bodyPosition, ViewMatrixBatch& out) {
+		for (int lane = 0; lane < 4; lane++) {
+			Quaternion eye = { batch.Qx[lane], batch.Qy[lane], batch.Qz[lane], batch.Qw[lane] };
+			Quaternion q = body * eye;
+			float s = 2.0f / (q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w);
+			float r[3][3] = {
+				{ 1.0f - s * (q.y * q.y + q.z * q.z), s * (q.x * q.y - q.w * q.z), s * (q.x * q.z + q.w * q.y) },
+				{ s * (q.x * q.y + q.w * q.z), 1.0f - s * (q.x * q.x + q.z * q.z), s * (q.y * q.z - q.w * q.x) },
+				{ s * (q.x * q.z - q.w * q.y), s * (q.y * q.z + q.w * q.x), 1.0f - s * (q.x * q.x + q.y * q.y) }
+			};
+
+			float u[3] = { batch.Px[lane], batch.Py[lane], batch.Pz[lane] };
+			float p[3] = { bodyPosition.x, bodyPosition.y, bodyPosition.z };
+			for (int i = 0; i < 3; i++) {
+				p[i] += bodyRotation[i][0] * u[0] + bodyRotation[i][1] * u[1] + bodyRotation[i][2] * u[2];
+			}
+
+			for (int row = 0; row < 3; row++) {
+				out.View[row][0][lane] = r[0][row];
+				out.View[row][1][lane] = r[1][row];
+				out.View[row][2][lane] = r[2][row];
+				out.View[row][3][lane] = -(r[0][row] * p[0] + r[1][row] * p[1] + r[2][row] * p[2]);
+			}
+		}
+	}
+
+	void MultiplyColumnMajor(const Matrix4& projectionColumns, const ViewMatrixBatch& views, int lane, Matrix4& out) {
+		for (int column = 0; column < 4; column++) {
+			for (int row = 0; row < 4; row++) {
+				out.M[column][row] =
+					views.View[0][column][lane] * projectionColumns.M[0][row] +
+					views.View[1][column][lane] * projectionColumns.M[1][row] +
+					views.View[2][column][lane] * projectionColumns.M[2][row] +
+					(column == 3 ? projectionColumns.M[3][row] : 0.0f);
+			}
+		}
+	}
+#endif
+}
+
+EyeMatrixPipeline::EyeMatrixPipeline() : viewCount(0) {
+	const Vector3 zero = { 0.0f, 0.0f, 0.0f };
+	SetBodyTransform(zero, QuaternionIdentity());
+}
+
+void EyeMatrixPipeline::SetViewCount(int viewCount) {
+	this->viewCount = viewCount;
+
+	// Zero FOV marks a view as not set up yet, so the first SetView always computes the projection.
+	ViewParameters unset;
+	memset(&unset, 0, sizeof(unset));
+	parameters.resize(viewCount, unset);
+	projectionColumns.resize(viewCount);
+}
+
+int EyeMatrixPipeline::GetViewCount() const {
+	return viewCount;
+}
+
+void EyeMatrixPipeline::SetView(int view, const FovPort& fov, float zNear, float zFar, const Matrix4& clipTransform) {
+	ViewParameters updated;
+	memset(&updated, 0, sizeof(updated));
+	updated.Fov = fov;
+	updated.ZNear = zNear;
+	updated.ZFar = zFar;
+	updated.ClipTransform = clipTransform;
+	if (memcmp(&updated, &parameters[view], sizeof(updated)) == 0) {
+		return;
+	}
+
+	parameters[view] = updated;
+	projectionColumns[view] = Transposed(clipTransform * PerspectiveProjection(fov, zNear, zFar, true));
+}
+
+void EyeMatrixPipeline::SetBodyTransform(const Vector3& position, const Quaternion& orientation) {
+	bodyPosition = position;
+	bodyOrientation = orientation;
+
+	const Vector3 axes[3] = { { 1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, { 0.0f, 0.0f, 1.0f } };
+	for (int column = 0; column < 3; column++) {
+		Vector3 rotated = Rotate(orientation, axes[column]);
+		bodyRotation[0][column] = rotated.x;
+		bodyRotation[1][column] = rotated.y;
+		bodyRotation[2][column] = rotated.z;
+	}
+}
+
+void EyeMatrixPipeline::Compute(const Pose* viewPoses, Matrix4* outColumnMajor) const {
+	for (int first = 0; first < viewCount; first += 4) {
+		int count = viewCount - first < 4 ? viewCount - first : 4;
+
+		ViewBatch batch;
+		LoadBatch(viewPoses + first, count, batch);
+
+		ViewMatrixBatch views;
+		ComputeViewMatrices(batch, bodyOrientation, bodyRotation, bodyPosition, views);
+
+		for (int lane = 0; lane < count; lane++) {
+			MultiplyColumnMajor(projectionColumns[first + lane], views, lane, outColumnMajor[first + lane]);
+		}
+	}
+}
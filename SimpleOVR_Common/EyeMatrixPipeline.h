@@ -0,0 +1,80 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#pragma once
+
+#include "VrTypes.h"
+#include <vector>
+
+/*
+	Computes the view-projection matrices of any number of views (eyes, or viewports of a
+	multi-view setup) from their poses in one batch.
+
+	The projections only depend on the FOV and clip planes and are cached until SetView is called
+	with different values. The same goes for the body transform. Each Compute call then turns the
+	poses into view matrices four views at a time with SSE (one view per lane) and multiplies them
+	with the cached projections, writing the result straight in column-major order, which is what
+	HLSL constant buffers expect by default. No separate transpose needed.
+
+	The result equals ComputeEyeViewProjection (FrameLoop.h), which follows the OVR math, within
+	floating point precision. Without SSE the same steps run as plain scalar code.
+*/
+class EyeMatrixPipeline {
+public:
+	EyeMatrixPipeline();
+
+	void SetViewCount(int viewCount);
+	int GetViewCount() const;
+
+	/*
+		Projection for one view. The transform is applied after the projection (in clip space) and
+		is typically identity or a viewport remap like the one used for instanced stereo.
+		Cheap when nothing changed.
+	*/
+	void SetView(int view, const FovPort& fov, float zNear, float zFar, const Matrix4& clipTransform);
+
+	// Position and orientation of the player's body, applied to every view pose.
+	void SetBodyTransform(const Vector3& position, const Quaternion& orientation);
+
+	// One pose per view in, one column-major view-projection per view out.
+	void Compute(const Pose* viewPoses, Matrix4* outColumnMajor) const;
+
+private:
+	struct ViewParameters {
+		FovPort Fov;
+		float ZNear;
+		float ZFar;
+		Matrix4 ClipTransform;
+	};
+
+	int viewCount;
+	std::vector<ViewParameters> parameters;
+	std::vector<Matrix4> projectionColumns; // Column-major, so each row of M is a column
+	Vector3 bodyPosition;
+	Quaternion bodyOrientation;
+	float bodyRotation[3][3];
+};
@@ -0,0 +1,143 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#include "FoveatedLayout.h"
+#include <algorithm>
+
+namespace {
+	// Splits size pixels into the periphery, center and periphery, and the same at density.
+	void SplitAxis(int size, const FoveationSettings& settings, int outFull[FoveatedRegionColumns], int outTarget[FoveatedRegionColumns]) {
+		float centerSize = std::max(0.0f, std::min(1.0f, settings.CenterSize));
+		float density = std::max(0.0f, std::min(1.0f, settings.PeripheryDensity));
+		int side = std::min(static_cast<int>(size * (1.0f - centerSize) * 0.5f + 0.5f), size / 2);
+		outFull[0] = side;
+		outFull[1] = size - 2 * side;
+		outFull[2] = side;
+
+		// Every pixel of the periphery keeps at least one pixel in the target.
+		int sideTarget = side > 0 ? std::max(1, static_cast<int>(side * density + 0.5f)) : 0;
+		outTarget[0] = sideTarget;
+		outTarget[1] = outFull[1];
+		outTarget[2] = sideTarget;
+	}
+
+	unsigned long long GetArea(const Rect2i& rect) {
+		return static_cast<unsigned long long>(rect.Size.w) * rect.Size.h;
+	}
+}
+
+FoveationSettings GetDefaultFoveationSettings() {
+	FoveationSettings settings;
+	settings.CenterSize = 0.6f;
+	settings.PeripheryDensity = 0.5f;
+	settings.Visualize = false;
+	return settings;
+}
+
+void ComputeFoveatedLayout(const Rect2i eyeViewport[EyeCount], const FoveationSettings& settings, FoveatedLayout& outLayout) {
+	outLayout.TargetSize.w = 0;
+	outLayout.TargetSize.h = 0;
+	outLayout.Visualize = settings.Visualize;
+
+	for (int eye = 0; eye < EyeCount; eye++) {
+		const Rect2i& viewport = eyeViewport[eye];
+		int fullWidth[FoveatedRegionColumns];
+		int fullHeight[FoveatedRegionColumns];
+		int targetWidth[FoveatedRegionColumns];
+		int targetHeight[FoveatedRegionColumns];
+		SplitAxis(viewport.Size.w, settings, fullWidth, targetWidth);
+		SplitAxis(viewport.Size.h, settings, fullHeight, targetHeight);
+
+		int eyeX = 0;
+		int eyeY = 0;
+		int targetX = outLayout.TargetSize.w;
+		int targetY = 0;
+		for (int row = 0; row < FoveatedRegionColumns; row++) {
+			eyeX = 0;
+			targetX = outLayout.TargetSize.w;
+			for (int column = 0; column < FoveatedRegionColumns; column++) {
+				FoveatedRegion& region = outLayout.Regions[eye][row * FoveatedRegionColumns + column];
+				region.Eye.Pos.x = viewport.Pos.x + eyeX;
+				region.Eye.Pos.y = viewport.Pos.y + eyeY;
+				region.Eye.Size.w = fullWidth[column];
+				region.Eye.Size.h = fullHeight[row];
+				region.Target.Pos.x = targetX;
+				region.Target.Pos.y = targetY;
+				region.Target.Size.w = targetWidth[column];
+				region.Target.Size.h = targetHeight[row];
+
+				// Pixel rows go down, NDC goes up.
+				float width = static_cast<float>(viewport.Size.w);
+				float height = static_cast<float>(viewport.Size.h);
+				region.Ndc[0] = 2.0f * eyeX / width - 1.0f;
+				region.Ndc[1] = 2.0f * (eyeX + fullWidth[column]) / width - 1.0f;
+				region.Ndc[2] = 1.0f - 2.0f * (eyeY + fullHeight[row]) / height;
+				region.Ndc[3] = 1.0f - 2.0f * eyeY / height;
+
+				eyeX += fullWidth[column];
+				targetX += targetWidth[column];
+			}
+			eyeY += fullHeight[row];
+			targetY += targetHeight[row];
+		}
+
+		outLayout.TargetSize.w = targetX;
+		outLayout.TargetSize.h = std::max(outLayout.TargetSize.h, targetY);
+	}
+}
+
+Matrix4 ComputeRegionCrop(const FoveatedRegion& region) {
+	float scaleX = 2.0f / (region.Ndc[1] - region.Ndc[0]);
+	float scaleY = 2.0f / (region.Ndc[3] - region.Ndc[2]);
+	Matrix4 crop = { {
+		{ scaleX, 0.0f, 0.0f, -(region.Ndc[1] + region.Ndc[0]) * 0.5f * scaleX },
+		{ 0.0f, scaleY, 0.0f, -(region.Ndc[3] + region.Ndc[2]) * 0.5f * scaleY },
+		{ 0.0f, 0.0f, 1.0f, 0.0f },
+		{ 0.0f, 0.0f, 0.0f, 1.0f }
+	} };
+	return crop;
+}
+
+unsigned long long GetFoveatedPixelCount(const FoveatedLayout& layout) {
+	unsigned long long pixels = 0;
+	for (int eye = 0; eye < EyeCount; eye++) {
+		for (int i = 0; i < FoveatedRegionCount; i++) {
+			pixels += GetArea(layout.Regions[eye][i].Target);
+		}
+	}
+	return pixels;
+}
+
+unsigned long long GetFullPixelCount(const FoveatedLayout& layout) {
+	unsigned long long pixels = 0;
+	for (int eye = 0; eye < EyeCount; eye++) {
+		for (int i = 0; i < FoveatedRegionCount; i++) {
+			pixels += GetArea(layout.Regions[eye][i].Eye);
+		}
+	}
+	return pixels;
+}
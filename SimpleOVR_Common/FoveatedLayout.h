@@ -0,0 +1,84 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#pragma once
+
+#include "VrTypes.h"
+
+/*
+	Fixed foveated rendering. The lenses squeeze the edges of each eye's view together, so much of
+	the detail rendered there never reaches the display. Each eye's viewport is split into a 3x3
+	grid of regions: the center region is rendered at full density, the columns and rows around
+	it at PeripheryDensity along the axis they are peripheral in (so the corners at
+	PeripheryDensity in both). The regions are packed, each at its own size, into a separate
+	target. Every region is drawn with its own viewport and a projection cropped to its part of
+	the eye's view, and a composite pass then stretches the regions back into the eye texture in
+	the layout LibOVR expects.
+
+	The grid lines are at whole pixels of the eye viewport, and the crop is computed from them, so
+	a point lands on the same spot of the eye texture either way, only blurrier in the periphery.
+*/
+
+const int FoveatedRegionColumns = 3;
+const int FoveatedRegionCount = FoveatedRegionColumns * FoveatedRegionColumns;
+
+struct FoveationSettings {
+	float CenterSize; // Fraction of the eye's width and height rendered at full density, 0 to 1
+	float PeripheryDensity; // Pixel density outside the center relative to it, 0 to 1
+	bool Visualize; // Have the composite tint the regions by density
+};
+
+struct FoveatedRegion {
+	Rect2i Eye; // In the eye texture, at full density
+	Rect2i Target; // In the foveated target, at the region's density
+	float Ndc[4]; // The part of the eye's view covered: left, right, bottom and top in the eye's NDC
+};
+
+// Regions of each eye, row by row from the top left.
+struct FoveatedLayout {
+	FoveatedRegion Regions[EyeCount][FoveatedRegionCount];
+	Size2i TargetSize; // Bounds of all regions in the foveated target
+	bool Visualize;
+};
+
+// Some savings without the periphery getting noticeably blurry on a DK2.
+FoveationSettings GetDefaultFoveationSettings();
+
+/*
+	Splits the eye viewports (within the eye texture) and packs the regions into the foveated
+	target, the eyes side by side. The target never needs to be larger than the eye texture.
+	Regions can be empty (zero size) if CenterSize is 0 or 1.
+*/
+void ComputeFoveatedLayout(const Rect2i eyeViewport[EyeCount], const FoveationSettings& settings, FoveatedLayout& outLayout);
+
+// Clip space transform that maps the region's part of the eye's view onto the whole viewport.
+Matrix4 ComputeRegionCrop(const FoveatedRegion& region);
+
+// Pixels rendered with the layout, and without foveation. The ratio is about what the pixel
+// shading costs; multiply by the sample count for rasterization and depth testing.
+unsigned long long GetFoveatedPixelCount(const FoveatedLayout& layout);
+unsigned long long GetFullPixelCount(const FoveatedLayout& layout);
@@ -0,0 +1,693 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#include "FrameGraph.h"
+#include <cstring>
+
+namespace {
+	FrameGraphState GetWriteState(const RenderTargetDesc& desc) {
+		return desc.Format == RenderTargetFormat_DepthStencil ? FrameGraphState_DepthStencil : FrameGraphState_RenderTarget;
+	}
+}
+
+FrameGraph::FrameGraph() :
+	compiled(false)
+{
+	declaration.ClearValueCount = 0;
+	declaration.MergedClears = 0;
+	declaration.DroppedClears = 0;
+	compiledDeclaration = declaration;
+	std::memset(&statistics, 0, sizeof(statistics));
+}
+
+void FrameGraph::Reset() {
+	declaration.Resources.clear();
+	declaration.ResolveTargets.clear();
+	declaration.Passes.clear();
+	declaration.Outputs.clear();
+	declaration.ClearValueCount = 0;
+	declaration.MergedClears = 0;
+	declaration.DroppedClears = 0;
+	clearValues.clear();
+	pendingClears.clear();
+}
+
+int FrameGraph::AddResource(const RenderTargetDesc& desc) {
+	declaration.Resources.push_back(desc);
+	declaration.ResolveTargets.push_back(-1);
+	pendingClears.push_back(-1);
+	return static_cast<int>(declaration.Resources.size()) - 1;
+}
+
+void FrameGraph::SetResolveTarget(int resource, int destination) {
+	declaration.ResolveTargets[resource] = destination;
+}
+
+int FrameGraph::AddPass(const char* name) {
+	Pass pass;
+	pass.Name = name;
+	declaration.Passes.push_back(pass);
+	return static_cast<int>(declaration.Passes.size()) - 1;
+}
+
+void FrameGraph::ClearTarget(int resource, const FrameGraphClearValue& value) {
+	// Cleared again before anything used the first clear: keep the slot, take the new value.
+	if (pendingClears[resource] >= 0) {
+		clearValues[pendingClears[resource]] = value;
+		declaration.MergedClears++;
+		return;
+	}
+	pendingClears[resource] = static_cast<int>(clearValues.size());
+	clearValues.push_back(value);
+	declaration.ClearValueCount++;
+}
+
+void FrameGraph::WriteTarget(int pass, int resource, FrameGraphLoad load) {
+	Use use;
+	use.Resource = resource;
+	use.Write = true;
+	use.Load = load;
+	use.ClearValue = -1;
+	use.Multisampled = false;
+	if (pendingClears[resource] >= 0) {
+		if (load == FrameGraphLoad_Keep) {
+			use.ClearValue = pendingClears[resource];
+		}
+		else {
+			declaration.DroppedClears++;
+		}
+		pendingClears[resource] = -1;
+	}
+	declaration.Passes[pass].Uses.push_back(use);
+}
+
+void FrameGraph::ReadTexture(int pass, int resource) {
+	Use use;
+	use.Resource = resource;
+	use.Write = false;
+	use.Load = FrameGraphLoad_Keep;
+	use.ClearValue = -1;
+	use.Multisampled = false;
+	declaration.Passes[pass].Uses.push_back(use);
+}
+
+void FrameGraph::ReadOutput(int resource) {
+	Use use;
+	use.Resource = resource;
+	use.Write = false;
+	use.Load = FrameGraphLoad_Keep;
+	use.ClearValue = -1;
+	use.Multisampled = false;
+	declaration.Outputs.push_back(use);
+}
+
+void FrameGraph::ReadMultisampledOutput(int resource) {
+	ReadOutput(resource);
+	declaration.Outputs.back().Multisampled = true;
+}
+
+bool FrameGraph::Compile() {
+	for (size_t resource = 0; resource < pendingClears.size(); resource++) {
+		if (pendingClears[resource] >= 0) {
+			declaration.DroppedClears++;
+			pendingClears[resource] = -1;
+		}
+	}
+
+	if (compiled && SameDeclaration(declaration, compiledDeclaration)) {
+		statistics.CacheHits++;
+		return false;
+	}
+	compiledDeclaration = declaration;
+	CompileDeclaration();
+	compiled = true;
+	statistics.Compilations++;
+	return true;
+}
+
+bool FrameGraph::SameDeclaration(const Declaration& a, const Declaration& b) {
+	if (a.Resources.size() != b.Resources.size() || a.Passes.size() != b.Passes.size() || a.Outputs.size() != b.Outputs.size() ||
+		a.ClearValueCount != b.ClearValueCount || a.ResolveTargets != b.ResolveTargets) {
+		return false;
+	}
+	for (size_t resource = 0; resource < a.Resources.size(); resource++) {
+		if (!(a.Resources[resource] == b.Resources[resource])) {
+			return false;
+		}
+	}
+	for (size_t pass = 0; pass < a.Passes.size(); pass++) {
+		const Pass& passA = a.Passes[pass];
+		const Pass& passB = b.Passes[pass];
+		if (std::strcmp(passA.Name, passB.Name) != 0 || !SameUses(passA.Uses, passB.Uses)) {
+			return false;
+		}
+	}
+	return SameUses(a.Outputs, b.Outputs);
+}
+
+bool FrameGraph::SameUses(const std::vector<Use>& a, const std::vector<Use>& b) {
+	if (a.size() != b.size()) {
+		return false;
+	}
+	for (size_t use = 0; use < a.size(); use++) {
+		if (a[use].Resource != b[use].Resource || a[use].Write != b[use].Write || a[use].Load != b[use].Load || a[use].ClearValue != b[use].ClearValue ||
+			a[use].Multisampled != b[use].Multisampled) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void FrameGraph::CompileDeclaration() {
+	const Declaration& source = compiledDeclaration;
+	int passCount = static_cast<int>(source.Passes.size());
+	resources = source.Resources;
+	std::vector<int> resolveTargets = source.ResolveTargets;
+
+	unsigned long long compilations = statistics.Compilations;
+	unsigned long long cacheHits = statistics.CacheHits;
+	std::memset(&statistics, 0, sizeof(statistics));
+	statistics.Compilations = compilations;
+	statistics.CacheHits = cacheHits;
+	statistics.Passes = passCount;
+	statistics.MergedClears = source.MergedClears;
+	statistics.DroppedClears = source.DroppedClears;
+
+	/*
+		Turn the declaration into nodes, inserting the resolves. Dependencies order a node after
+		the nodes that wrote what it uses and, for writes, after the ones that read the previous
+		contents. Inputs are the nodes whose results it needs, which is what keeps them alive.
+	*/
+	std::vector<Node> nodes;
+	std::vector<int> lastWriter(resources.size(), -1);
+	std::vector<std::vector<int> > readers(resources.size());
+	std::vector<int> resolves(resources.size(), -1); // The resolve of the current contents, by multisampled resource
+	std::vector<int> roots;
+	passUses.assign(passCount, std::vector<FrameGraphUse>());
+	outputResources.assign(resources.size(), -1);
+
+	// Returns what a texture read of resource reads, resolving it first if it is multisampled.
+	auto readTexture = [&](int resource) -> int {
+		if (resources[resource].SampleCount <= 1) {
+			return resource;
+		}
+		if (resolves[resource] < 0) {
+			int destination = resolveTargets[resource];
+			if (destination < 0) {
+				RenderTargetDesc desc = resources[resource];
+				desc.SampleCount = 1;
+				desc.BindFlags = RenderTargetBind_ShaderResource;
+				destination = static_cast<int>(resources.size());
+				resources.push_back(desc);
+				resolveTargets[resource] = destination;
+				resolveTargets.push_back(-1);
+				lastWriter.push_back(-1);
+				readers.push_back(std::vector<int>());
+				resolves.push_back(-1);
+				outputResources.push_back(-1);
+			}
+
+			Node node;
+			node.Pass = -1;
+			node.Source = resource;
+			node.Destination = destination;
+			node.Live = false;
+			if (lastWriter[resource] >= 0) {
+				node.Dependencies.push_back(lastWriter[resource]);
+				node.Inputs.push_back(lastWriter[resource]);
+			}
+			if (lastWriter[destination] >= 0) {
+				node.Dependencies.push_back(lastWriter[destination]);
+			}
+			node.Dependencies.insert(node.Dependencies.end(), readers[destination].begin(), readers[destination].end());
+
+			int index = static_cast<int>(nodes.size());
+			nodes.push_back(node);
+			readers[resource].push_back(index);
+			readers[destination].clear();
+			lastWriter[destination] = index;
+			resolves[resource] = index;
+		}
+		return resolveTargets[resource];
+	};
+
+	for (int pass = 0; pass < passCount; pass++) {
+		const std::vector<Use>& uses = source.Passes[pass].Uses;
+
+		// Resolves go before the pass that needs them.
+		std::vector<int> read(uses.size());
+		for (size_t use = 0; use < uses.size(); use++) {
+			read[use] = uses[use].Write ? uses[use].Resource : readTexture(uses[use].Resource);
+		}
+
+		Node node;
+		node.Pass = pass;
+		node.Source = -1;
+		node.Destination = -1;
+		node.Live = false;
+		int index = static_cast<int>(nodes.size());
+		for (size_t use = 0; use < uses.size(); use++) {
+			int resource = read[use];
+			FrameGraphUse compiledUse = { resource, uses[use].Write };
+			passUses[pass].push_back(compiledUse);
+			if (lastWriter[resource] >= 0) {
+				node.Dependencies.push_back(lastWriter[resource]);
+				// Drawing on top of the contents needs them, clearing or overwriting them doesn't.
+				if (!uses[use].Write || (uses[use].Load == FrameGraphLoad_Keep && uses[use].ClearValue < 0)) {
+					node.Inputs.push_back(lastWriter[resource]);
+				}
+			}
+			if (uses[use].Write) {
+				node.Dependencies.insert(node.Dependencies.end(), readers[resource].begin(), readers[resource].end());
+				node.Targets.push_back(resource);
+			}
+		}
+		nodes.push_back(node);
+
+		for (size_t use = 0; use < uses.size(); use++) {
+			int resource = read[use];
+			if (uses[use].Write) {
+				lastWriter[resource] = index;
+				readers[resource].clear();
+				resolves[resource] = -1;
+				// What was resolved into it is gone too.
+				for (size_t resolved = 0; resolved < resolves.size(); resolved++) {
+					if (resolves[resolved] >= 0 && resolveTargets[resolved] == resource) {
+						resolves[resolved] = -1;
+					}
+				}
+			}
+			else {
+				readers[resource].push_back(index);
+			}
+		}
+	}
+
+	for (size_t output = 0; output < source.Outputs.size(); output++) {
+		int resource = source.Outputs[output].Resource;
+		int read = source.Outputs[output].Multisampled ? resource : readTexture(resource);
+		outputResources[resource] = read;
+		if (lastWriter[read] >= 0) {
+			roots.push_back(lastWriter[read]);
+		}
+	}
+
+	// Cull: only what the outputs need, directly or through other nodes, stays.
+	while (!roots.empty()) {
+		int node = roots.back();
+		roots.pop_back();
+		if (!nodes[node].Live) {
+			nodes[node].Live = true;
+			roots.insert(roots.end(), nodes[node].Inputs.begin(), nodes[node].Inputs.end());
+		}
+	}
+
+	/*
+		Schedule the live nodes. Of the nodes whose dependencies have run, a pass that binds the
+		targets that are bound already goes first, otherwise the one declared first.
+	*/
+	std::vector<int> waiting(nodes.size(), 0);
+	std::vector<std::vector<int> > dependents(nodes.size());
+	std::vector<int> visited(nodes.size(), -1);
+	std::vector<int> stack;
+	for (size_t node = 0; node < nodes.size(); node++) {
+		if (!nodes[node].Live) {
+			continue;
+		}
+		// A culled node still orders the nodes around it, so its dependencies are taken over.
+		stack = nodes[node].Dependencies;
+		while (!stack.empty()) {
+			int on = stack.back();
+			stack.pop_back();
+			if (visited[on] == static_cast<int>(node)) {
+				continue;
+			}
+			visited[on] = static_cast<int>(node);
+			if (nodes[on].Live) {
+				waiting[node]++;
+				dependents[on].push_back(static_cast<int>(node));
+			}
+			else {
+				stack.insert(stack.end(), nodes[on].Dependencies.begin(), nodes[on].Dependencies.end());
+			}
+		}
+	}
+	std::vector<int> ready;
+	for (size_t node = 0; node < nodes.size(); node++) {
+		if (nodes[node].Live && waiting[node] == 0) {
+			ready.push_back(static_cast<int>(node));
+		}
+	}
+
+	std::vector<int> order;
+	std::vector<int> boundTargets;
+	while (!ready.empty()) {
+		size_t pick = 0;
+		bool keepsTargets = false;
+		for (size_t candidate = 0; candidate < ready.size() && !keepsTargets; candidate++) {
+			const Node& node = nodes[ready[candidate]];
+			keepsTargets = node.Pass >= 0 && !boundTargets.empty() && node.Targets == boundTargets;
+			if (keepsTargets || ready[candidate] < ready[pick]) {
+				pick = candidate;
+			}
+		}
+
+		int index = ready[pick];
+		ready.erase(ready.begin() + pick);
+		order.push_back(index);
+		if (nodes[index].Pass >= 0 && nodes[index].Targets != boundTargets) {
+			boundTargets = nodes[index].Targets;
+			statistics.TargetChanges++;
+		}
+		for (size_t dependent = 0; dependent < dependents[index].size(); dependent++) {
+			int node = dependents[index][dependent];
+			if (--waiting[node] == 0) {
+				ready.push_back(node);
+			}
+		}
+	}
+
+	/*
+		Commands, with a barrier wherever a resource is used differently than before. The frame
+		repeats, so the outputs start out the way the previous frame left them, as textures; the
+		other resources are left undefined at the end.
+	*/
+	commands.clear();
+	passCommands.assign(passCount, -1);
+	std::vector<FrameGraphState> states(resources.size(), FrameGraphState_Undefined);
+	for (size_t resource = 0; resource < resources.size(); resource++) {
+		if (outputResources[resource] >= 0) {
+			states[outputResources[resource]] = FrameGraphState_ShaderResource;
+		}
+	}
+
+	FrameGraphCommand command;
+	std::memset(&command, 0, sizeof(command));
+	for (size_t i = 0; i < order.size(); i++) {
+		const Node& node = nodes[order[i]];
+		if (node.Pass < 0) {
+			AddBarrier(states, node.Source, FrameGraphState_ResolveSource);
+			AddBarrier(states, node.Destination, FrameGraphState_ResolveDestination);
+			command.Type = FrameGraphCommand_Resolve;
+			command.Pass = -1;
+			command.Resource = node.Destination;
+			command.Source = node.Source;
+			command.ClearValue = -1;
+			commands.push_back(command);
+			statistics.Resolves++;
+			continue;
+		}
+
+		// The pass's clears right before it, the way a render pass would load them.
+		const std::vector<Use>& uses = source.Passes[node.Pass].Uses;
+		for (size_t use = 0; use < uses.size(); use++) {
+			if (uses[use].ClearValue >= 0) {
+				int resource = passUses[node.Pass][use].Resource;
+				AddBarrier(states, resource, GetWriteState(resources[resource]));
+				command.Type = FrameGraphCommand_Clear;
+				command.Pass = node.Pass;
+				command.Resource = resource;
+				command.Source = -1;
+				command.ClearValue = uses[use].ClearValue;
+				commands.push_back(command);
+				statistics.Clears++;
+			}
+		}
+		for (size_t use = 0; use < uses.size(); use++) {
+			int resource = passUses[node.Pass][use].Resource;
+			AddBarrier(states, resource, uses[use].Write ? GetWriteState(resources[resource]) : FrameGraphState_ShaderResource);
+		}
+		command.Type = FrameGraphCommand_Pass;
+		command.Pass = node.Pass;
+		command.Resource = -1;
+		command.Source = -1;
+		command.ClearValue = -1;
+		passCommands[node.Pass] = static_cast<int>(commands.size());
+		commands.push_back(command);
+	}
+
+	for (size_t resource = 0; resource < resources.size(); resource++) {
+		if (outputResources[resource] >= 0) {
+			AddBarrier(states, outputResources[resource], FrameGraphState_ShaderResource);
+		}
+	}
+	for (size_t resource = 0; resource < resources.size(); resource++) {
+		bool output = false;
+		for (size_t other = 0; other < resources.size(); other++) {
+			output = output || outputResources[other] == static_cast<int>(resource);
+		}
+		if (!output) {
+			AddBarrier(states, static_cast<int>(resource), FrameGraphState_Undefined);
+		}
+	}
+
+	for (int pass = 0; pass < passCount; pass++) {
+		if (passCommands[pass] < 0) {
+			statistics.CulledPasses++;
+			// Its clears go with it.
+			for (size_t use = 0; use < source.Passes[pass].Uses.size(); use++) {
+				statistics.DroppedClears += source.Passes[pass].Uses[use].ClearValue >= 0;
+			}
+		}
+	}
+}
+
+void FrameGraph::AddBarrier(std::vector<FrameGraphState>& states, int resource, FrameGraphState state) {
+	if (states[resource] == state) {
+		return;
+	}
+	FrameGraphCommand command;
+	command.Type = FrameGraphCommand_Barrier;
+	command.Pass = -1;
+	command.Resource = resource;
+	command.Source = -1;
+	command.ClearValue = -1;
+	command.Before = states[resource];
+	command.After = state;
+	commands.push_back(command);
+	states[resource] = state;
+	statistics.Barriers++;
+}
+
+void FrameGraph::Execute(FrameGraphBackend& backend) const {
+	Execute(backend, 0, static_cast<int>(commands.size()));
+}
+
+void FrameGraph::Execute(FrameGraphBackend& backend, int first, int end) const {
+	for (int i = first; i < end; i++) {
+		const FrameGraphCommand& command = commands[i];
+		switch (command.Type) {
+		case FrameGraphCommand_Barrier:
+			backend.Barrier(*this, command.Resource, command.Before, command.After);
+			break;
+		case FrameGraphCommand_Clear:
+			backend.Clear(*this, command.Resource, clearValues[command.ClearValue]);
+			break;
+		case FrameGraphCommand_Resolve:
+			backend.Resolve(*this, command.Source, command.Resource);
+			break;
+		case FrameGraphCommand_Pass:
+			backend.RunPass(*this, command.Pass);
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+int FrameGraph::GetResourceCount() const {
+	return static_cast<int>(resources.size());
+}
+
+const RenderTargetDesc& FrameGraph::GetResourceDesc(int resource) const {
+	return resources[resource];
+}
+
+int FrameGraph::GetOutputResource(int resource) const {
+	return outputResources[resource];
+}
+
+int FrameGraph::GetPassCount() const {
+	return static_cast<int>(compiledDeclaration.Passes.size());
+}
+
+const char* FrameGraph::GetPassName(int pass) const {
+	return compiledDeclaration.Passes[pass].Name;
+}
+
+bool FrameGraph::IsPassCulled(int pass) const {
+	return GetPassCommand(pass) < 0;
+}
+
+int FrameGraph::GetPassUseCount(int pass) const {
+	return static_cast<int>(passUses[pass].size());
+}
+
+const FrameGraphUse& FrameGraph::GetPassUse(int pass, int use) const {
+	return passUses[pass][use];
+}
+
+int FrameGraph::GetCommandCount() const {
+	return static_cast<int>(commands.size());
+}
+
+const FrameGraphCommand& FrameGraph::GetCommand(int command) const {
+	return commands[command];
+}
+
+int FrameGraph::GetPassCommand(int pass) const {
+	return pass < static_cast<int>(passCommands.size()) ? passCommands[pass] : -1;
+}
+
+const FrameGraphClearValue& FrameGraph::GetClearValue(int clearValue) const {
+	return clearValues[clearValue];
+}
+
+void FrameGraph::BuildTargetPlan(RenderTargetPlan& outPlan) const {
+	outPlan.Clear();
+	for (size_t resource = 0; resource < resources.size(); resource++) {
+		outPlan.AddTarget(resources[resource]);
+	}
+	for (size_t i = 0; i < commands.size(); i++) {
+		const FrameGraphCommand& command = commands[i];
+		int pass = static_cast<int>(i);
+		if (command.Type == FrameGraphCommand_Clear) {
+			outPlan.UseTarget(command.Resource, pass);
+		}
+		else if (command.Type == FrameGraphCommand_Resolve) {
+			outPlan.UseTarget(command.Source, pass);
+			outPlan.UseTarget(command.Resource, pass);
+		}
+		else if (command.Type == FrameGraphCommand_Pass) {
+			for (size_t use = 0; use < passUses[command.Pass].size(); use++) {
+				outPlan.UseTarget(passUses[command.Pass][use].Resource, pass);
+			}
+		}
+	}
+	// The outputs are read after the graph.
+	for (size_t resource = 0; resource < resources.size(); resource++) {
+		if (outputResources[resource] >= 0) {
+			outPlan.UseTarget(outputResources[resource], static_cast<int>(commands.size()));
+		}
+	}
+	outPlan.Compile();
+}
+
+const FrameGraph::Statistics& FrameGraph::GetStatistics() const {
+	return statistics;
+}
+
+void FrameGraphRecorder::Barrier(const FrameGraph& graph, int resource, FrameGraphState before, FrameGraphState after) {
+	FrameGraphCommand command = { FrameGraphCommand_Barrier, -1, resource, -1, -1, before, after };
+	commands.push_back(command);
+}
+
+void FrameGraphRecorder::Clear(const FrameGraph& graph, int resource, const FrameGraphClearValue& value) {
+	FrameGraphCommand command = { FrameGraphCommand_Clear, -1, resource, -1, static_cast<int>(clearValues.size()), FrameGraphState_Undefined, FrameGraphState_Undefined };
+	commands.push_back(command);
+	clearValues.push_back(value);
+}
+
+void FrameGraphRecorder::Resolve(const FrameGraph& graph, int source, int destination) {
+	FrameGraphCommand command = { FrameGraphCommand_Resolve, -1, destination, source, -1, FrameGraphState_Undefined, FrameGraphState_Undefined };
+	commands.push_back(command);
+}
+
+void FrameGraphRecorder::RunPass(const FrameGraph& graph, int pass) {
+	FrameGraphCommand command = { FrameGraphCommand_Pass, pass, -1, -1, -1, FrameGraphState_Undefined, FrameGraphState_Undefined };
+	commands.push_back(command);
+}
+
+void FrameGraphRecorder::Reset() {
+	commands.clear();
+	clearValues.clear();
+}
+
+const std::vector<FrameGraphCommand>& FrameGraphRecorder::GetCommands() const {
+	return commands;
+}
+
+const std::vector<FrameGraphClearValue>& FrameGraphRecorder::GetClearValues() const {
+	return clearValues;
+}
+
+void DeclareEyeFrameGraph(Size2i eyeTextureSize, int multisampleCount, bool foveated, bool fusedResolve, const FrameGraphClearValue* colorClear, const FrameGraphClearValue* depthStencilClear, FrameGraph& graph) {
+	const unsigned int colorBind = RenderTargetBind_RenderTarget | RenderTargetBind_ShaderResource;
+	RenderTargetDesc depthStencil = { eyeTextureSize, RenderTargetFormat_DepthStencil, multisampleCount, RenderTargetBind_DepthStencil };
+	RenderTargetDesc eye = { eyeTextureSize, RenderTargetFormat_Color, multisampleCount, colorBind };
+	RenderTargetDesc resolved = { eyeTextureSize, RenderTargetFormat_Color, 1, colorBind };
+	RenderTargetDesc foveatedResolve = { eyeTextureSize, RenderTargetFormat_Color, 1, RenderTargetBind_ShaderResource };
+
+	graph.Reset();
+	graph.AddResource(depthStencil);
+	graph.AddResource(eye);
+	graph.AddResource(resolved);
+	// Created like the eye texture, so it can take the eye texture's place when that isn't used.
+	graph.AddResource(eye);
+	graph.AddResource(foveatedResolve);
+	graph.SetResolveTarget(EyeTarget_Eye, EyeTarget_Intermediary);
+	graph.SetResolveTarget(EyeTarget_Foveated, EyeTarget_FoveatedResolve);
+
+	EyeTarget sceneTarget = foveated ? EyeTarget_Foveated : EyeTarget_Eye;
+	if (colorClear != nullptr) {
+		graph.ClearTarget(sceneTarget, *colorClear);
+	}
+	if (depthStencilClear != nullptr) {
+		graph.ClearTarget(EyeTarget_DepthStencil, *depthStencilClear);
+	}
+
+	graph.AddPass("Scene");
+	graph.WriteTarget(EyeGraphPass_Scene, sceneTarget, FrameGraphLoad_Keep);
+	graph.WriteTarget(EyeGraphPass_Scene, EyeTarget_DepthStencil, FrameGraphLoad_Keep);
+
+	// Without foveation nothing reads what the composite writes, so it is culled.
+	EyeTarget compositeTarget = multisampleCount > 1 ? EyeTarget_Intermediary : EyeTarget_Eye;
+	graph.AddPass("Composite");
+	if (foveated) {
+		graph.ReadTexture(EyeGraphPass_Composite, EyeTarget_Foveated);
+		graph.WriteTarget(EyeGraphPass_Composite, compositeTarget, FrameGraphLoad_DontCare);
+	}
+	if (IsEyeResolveFused(multisampleCount, foveated, fusedResolve)) {
+		graph.ReadMultisampledOutput(EyeTarget_Eye);
+	}
+	else {
+		graph.ReadOutput(foveated ? compositeTarget : EyeTarget_Eye);
+	}
+}
+
+bool IsEyeResolveFused(int multisampleCount, bool foveated, bool fusedResolve) {
+	return fusedResolve && multisampleCount > 1 && !foveated;
+}
+
+void PlanEyeTargets(Size2i eyeTextureSize, int multisampleCount, bool foveated, bool fusedResolve, RenderTargetPlan& outPlan) {
+	FrameGraphClearValue clear;
+	std::memset(&clear, 0, sizeof(clear));
+	FrameGraph graph;
+	DeclareEyeFrameGraph(eyeTextureSize, multisampleCount, foveated, fusedResolve, &clear, &clear, graph);
+	graph.Compile();
+	graph.BuildTargetPlan(outPlan);
+}
@@ -0,0 +1,305 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#pragma once
+
+#include "RenderTargetPool.h"
+#include <vector>
+
+/*
+	A small frame graph. Each frame declares the targets it uses (resources) and the passes that
+	read and write them, in the order they would naively run; Compile then works out what actually
+	has to happen:
+
+	- Passes nothing reads the results of are culled. What is read after the graph, the outputs,
+	  keeps the passes that lead up to it alive.
+	- Clears are declared on their own, like a device's clear calls, and merged into the pass that
+	  next draws to the target. Clearing a target twice before that clears it once, with the last
+	  value, and clears that a pass overwrites anyway or that nothing ends up reading are dropped.
+	- A multisampled target that is read as a texture is resolved, once per time it is written,
+	  right before the first pass reading it. Nothing else is resolved, and neither is an output
+	  read multisampled by something resolving it itself.
+	- The passes are ordered to keep the targets bound from one pass to the next where the
+	  dependencies allow, and barriers are inserted wherever a target is used differently than
+	  before, so a backend knows when to unbind a target before sampling it and the other way round.
+
+	The result is a list of commands that Execute hands to a FrameGraphBackend. The D3D11 device
+	runs them, FrameGraphRecorder only keeps them so the schedule can be checked without a GPU.
+
+	Most frames declare exactly what the previous frame did, so the compiled schedule is kept and
+	Compile only compares the new declaration to the one it was compiled from. Clear values are
+	not part of the comparison, they are looked up when the commands are executed.
+*/
+
+// What a pass does with what was in a target before it writes to it.
+enum FrameGraphLoad {
+	FrameGraphLoad_Keep, // Draws on top, or a pending clear if one was declared
+	FrameGraphLoad_DontCare, // Overwrites all of it; a pending clear is dropped
+	FrameGraphLoadCount
+};
+
+// How a target is used, for the barriers.
+enum FrameGraphState {
+	FrameGraphState_Undefined,
+	FrameGraphState_RenderTarget,
+	FrameGraphState_DepthStencil,
+	FrameGraphState_ShaderResource,
+	FrameGraphState_ResolveSource,
+	FrameGraphState_ResolveDestination,
+	FrameGraphStateCount
+};
+
+enum FrameGraphCommandType {
+	FrameGraphCommand_Barrier,
+	FrameGraphCommand_Clear,
+	FrameGraphCommand_Resolve,
+	FrameGraphCommand_Pass,
+	FrameGraphCommandTypeCount
+};
+
+struct FrameGraphClearValue {
+	float Color[4];
+	float Depth;
+	unsigned char Stencil;
+};
+
+struct FrameGraphCommand {
+	FrameGraphCommandType Type;
+	int Pass; // FrameGraphCommand_Pass
+	int Resource; // Barrier and clear target, resolve destination
+	int Source; // Resolved from
+	int ClearValue; // Index into the declaration's clear values
+	FrameGraphState Before; // Barrier
+	FrameGraphState After;
+};
+
+// A target a compiled pass uses: for a texture read of a multisampled target, the resolved one.
+struct FrameGraphUse {
+	int Resource;
+	bool Write;
+};
+
+class FrameGraph;
+
+class FrameGraphBackend {
+public:
+	virtual ~FrameGraphBackend() {}
+
+	virtual void Barrier(const FrameGraph& graph, int resource, FrameGraphState before, FrameGraphState after) = 0;
+	virtual void Clear(const FrameGraph& graph, int resource, const FrameGraphClearValue& value) = 0;
+	virtual void Resolve(const FrameGraph& graph, int source, int destination) = 0;
+	virtual void RunPass(const FrameGraph& graph, int pass) = 0;
+};
+
+class FrameGraph {
+public:
+	struct Statistics {
+		int Passes; // Of the last compiled declaration
+		int CulledPasses;
+		int Clears;
+		int MergedClears; // Cleared again before being used
+		int DroppedClears; // Never used after the clear, or overwritten
+		int Resolves;
+		int Barriers;
+		int TargetChanges; // Passes that bind different targets than the pass before
+		unsigned long long Compilations;
+		unsigned long long CacheHits;
+	};
+
+	FrameGraph();
+
+	// Starts a new declaration. The compiled schedule stays until Compile finds it out of date.
+	void Reset();
+
+	// Declares a target and returns its index, counting from 0 in the order of declaration.
+	int AddResource(const RenderTargetDesc& desc);
+
+	// Where a multisampled resource is resolved to when something reads it as a texture. Without
+	// one the graph adds a resource of its own for it when compiling.
+	void SetResolveTarget(int resource, int destination);
+
+	// Declares a pass and returns its index, counting from 0. Passes are declared in an order
+	// they could run in; Compile may run them in another one the dependencies allow.
+	int AddPass(const char* name);
+
+	// Clears resource before the next pass that writes to it, like a render pass's load action.
+	// Passes reading it before that still see what was there.
+	void ClearTarget(int resource, const FrameGraphClearValue& value);
+
+	// The last declared pass draws to resource, as a depth stencil if its format is one.
+	void WriteTarget(int pass, int resource, FrameGraphLoad load);
+
+	// The last declared pass samples resource.
+	void ReadTexture(int pass, int resource);
+
+	// Resource is read as a texture after the graph, by LibOVR say. Declared after all passes.
+	void ReadOutput(int resource);
+
+	// Like ReadOutput, but resource is read as it is, multisampled, so it isn't resolved.
+	void ReadMultisampledOutput(int resource);
+
+	// Returns true if the declaration changed and the schedule was compiled again.
+	bool Compile();
+
+	// Runs the compiled commands [first, end) on backend.
+	void Execute(FrameGraphBackend& backend) const;
+	void Execute(FrameGraphBackend& backend, int first, int end) const;
+
+	// Declared resources come first, then the resolve targets the graph added.
+	int GetResourceCount() const;
+	const RenderTargetDesc& GetResourceDesc(int resource) const;
+
+	// What an output is read from after the graph ran: itself, or where it was resolved to.
+	int GetOutputResource(int resource) const;
+
+	int GetPassCount() const;
+	const char* GetPassName(int pass) const;
+	bool IsPassCulled(int pass) const;
+	int GetPassUseCount(int pass) const;
+	const FrameGraphUse& GetPassUse(int pass, int use) const;
+
+	int GetCommandCount() const;
+	const FrameGraphCommand& GetCommand(int command) const;
+	int GetPassCommand(int pass) const; // -1 if the pass was culled
+	const FrameGraphClearValue& GetClearValue(int clearValue) const;
+
+	// The compiled lifetimes as a RenderTargetPlan: a target per resource, in the same order,
+	// used by the commands that touch it. Resources no command touches take no texture.
+	void BuildTargetPlan(RenderTargetPlan& outPlan) const;
+
+	const Statistics& GetStatistics() const;
+
+private:
+	struct Use {
+		int Resource;
+		bool Write;
+		FrameGraphLoad Load;
+		int ClearValue; // -1 if the resource isn't cleared first
+		bool Multisampled; // An output read without resolving it
+	};
+
+	struct Pass {
+		const char* Name;
+		std::vector<Use> Uses;
+	};
+
+	struct Declaration {
+		std::vector<RenderTargetDesc> Resources;
+		std::vector<int> ResolveTargets; // By resource, -1 if not set
+		std::vector<Pass> Passes;
+		std::vector<Use> Outputs;
+		int ClearValueCount;
+		int MergedClears;
+		int DroppedClears;
+	};
+
+	// A pass or an inserted resolve, as the scheduler sees them.
+	struct Node {
+		int Pass; // -1 for a resolve
+		int Source; // Resolves only
+		int Destination;
+		std::vector<int> Dependencies; // Nodes that have to run first
+		std::vector<int> Inputs; // Nodes whose results it needs
+		std::vector<int> Targets; // What the pass binds, to keep consecutive passes on the same ones
+		bool Live;
+	};
+
+	static bool SameDeclaration(const Declaration& a, const Declaration& b);
+	static bool SameUses(const std::vector<Use>& a, const std::vector<Use>& b);
+	void CompileDeclaration();
+	void AddBarrier(std::vector<FrameGraphState>& states, int resource, FrameGraphState state);
+
+	Declaration declaration;
+	std::vector<FrameGraphClearValue> clearValues;
+	std::vector<int> pendingClears; // By resource, while declaring
+
+	// Compiled from compiledDeclaration.
+	Declaration compiledDeclaration;
+	bool compiled;
+	std::vector<RenderTargetDesc> resources;
+	std::vector<int> outputResources; // By resource
+	std::vector<std::vector<FrameGraphUse> > passUses;
+	std::vector<int> passCommands;
+	std::vector<FrameGraphCommand> commands;
+	Statistics statistics;
+};
+
+/*
+	A backend that runs nothing and keeps the commands, for checking what a graph schedules.
+*/
+class FrameGraphRecorder : public FrameGraphBackend {
+public:
+	void Barrier(const FrameGraph& graph, int resource, FrameGraphState before, FrameGraphState after);
+	void Clear(const FrameGraph& graph, int resource, const FrameGraphClearValue& value);
+	void Resolve(const FrameGraph& graph, int source, int destination);
+	void RunPass(const FrameGraph& graph, int pass);
+
+	void Reset();
+	const std::vector<FrameGraphCommand>& GetCommands() const;
+	const std::vector<FrameGraphClearValue>& GetClearValues() const; // For the clears, in order
+
+private:
+	std::vector<FrameGraphCommand> commands;
+	std::vector<FrameGraphClearValue> clearValues;
+};
+
+/*
+	The eye texture's frame graph: the scene is drawn, with foveation into the foveated target
+	which is then composited into the eye texture (through a resolve with multisampling),
+	otherwise into the eye texture. LibOVR distorts from the eye texture, through the
+	intermediary it is resolved to with multisampling; with foveation and multisampling the
+	composite draws straight into the intermediary.
+
+	With a fused resolve, multisampling and no foveation, own distortion samples the multisampled
+	eye texture and resolves it itself, so there is no resolve and no intermediary.
+
+	Every target is declared, in EyeTarget order, so the graph's resources are EyeTargets, and
+	so are the targets of a plan built from it. The distortion source is the first of its desc,
+	so it keeps its texture whatever the configuration. The clears are skipped if null.
+*/
+enum EyeTarget {
+	EyeTarget_DepthStencil,
+	EyeTarget_Eye,
+	EyeTarget_Intermediary,
+	EyeTarget_Foveated,
+	EyeTarget_FoveatedResolve,
+	EyeTargetCount
+};
+
+enum EyeGraphPass {
+	EyeGraphPass_Scene,
+	EyeGraphPass_Composite,
+	EyeGraphPassCount
+};
+
+void DeclareEyeFrameGraph(Size2i eyeTextureSize, int multisampleCount, bool foveated, bool fusedResolve, const FrameGraphClearValue* colorClear, const FrameGraphClearValue* depthStencilClear, FrameGraph& graph);
+
+// Whether the distortion source is the multisampled eye texture in a configuration.
+bool IsEyeResolveFused(int multisampleCount, bool foveated, bool fusedResolve);
+
+// The eye targets a configuration takes, for a frame that clears both.
+void PlanEyeTargets(Size2i eyeTextureSize, int multisampleCount, bool foveated, bool fusedResolve, RenderTargetPlan& outPlan);
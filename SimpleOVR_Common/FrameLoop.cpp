@@ -0,0 +1,799 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#include "FrameLoop.h"
+#include "ConstantRingAllocator.h"
+#include "Profiler.h"
+#include "VrMath.h"
+#include <algorithm>
+#include <cstring>
+
+// Commonly used vectors.
+const Vector3 RightVector = { 1.0f, 0.0f, 0.0f };
+const Vector3 UpVector = { 0.0f, 1.0f, 0.0f };
+const Vector3 ForwardVector = { 0.0f, 0.0f, -1.0f };
+
+// Position and angle of the player's body. In a real project these are probably not constant,
+// but we're keeping things simple here.
+const Vector3 BodyPosition = { 0.5f, 0.5f, 0 };
+const float BodyYaw = 0.9f;
+
+// The vertices of our default scene.
+const Vertex SceneVertices[] = {
+	Vertex{ { -1, -1, -0.5 } },
+	Vertex{ { -1, 1, -1.5 } },
+	Vertex{ { 1, -1, -0.5 } },
+};
+const unsigned int SceneVertexCount = sizeof(SceneVertices) / sizeof(Vertex);
+
+namespace {
+	// Where the eye is in the world, with the body's position and angle applied.
+	Pose ComputeWorldPose(const Pose& eyeRenderPose) {
+		Quaternion quatBodyRotation = QuaternionFromAxisAngle(UpVector, BodyYaw);
+		Pose worldPose;
+		worldPose.Orientation = quatBodyRotation * eyeRenderPose.Orientation;
+		worldPose.Position = BodyPosition + Rotate(quatBodyRotation, eyeRenderPose.Position);
+		return worldPose;
+	}
+
+	// Each object's world matrix is allocated separately, as constants can only be bound at this granularity.
+	const unsigned int ObjectConstantSize = ConstantRingAllocator::ConstantAlignment;
+
+	/*
+		A frame is drawn from up to MaxViews views, eye-major: view = eye * regionCount + region,
+		where regionCount is 1 without foveation. Each draw pass draws every object into one
+		viewport, with the view-projection of one view, or with StereoMode_Instanced those of the
+		same region of both eyes.
+	*/
+	const int MaxViews = EyeCount * FoveatedRegionCount;
+
+	struct DrawPass {
+		Rect2i Viewport;
+		int View[EyeCount]; // With StereoMode_Instanced, otherwise only the first is used
+		unsigned int FrameOffset;
+	};
+
+	// Everything the draws of a batch need, the same for every record job of the batch.
+	struct BatchDraws {
+		unsigned int InstanceCount; // EyeCount with StereoMode_Instanced, otherwise 1
+		unsigned int FrameConstantSize;
+		int PassCount;
+		DrawPass Passes[MaxViews];
+		bool Latched; // Pass i binds latched part i instead of its FrameOffset
+		Vector3 ViewPosition; // Between the eyes, what draws are sorted front to back from
+		unsigned char* ObjectConstants;
+		unsigned int ObjectOffset;
+		const unsigned int* Objects;
+	};
+
+	// Writes the world matrices of objects first to first + count - 1 of the batch.
+	void WriteObjectConstants(const Scene& scene, const BatchDraws& batch, unsigned int first, unsigned int count) {
+		for (unsigned int i = first; i < first + count; i++) {
+			Matrix4* world = reinterpret_cast<Matrix4*>(batch.ObjectConstants + i * ObjectConstantSize);
+			*world = scene.GetObjectTransposedWorld(batch.Objects[i]);
+		}
+	}
+
+	// Draws objects first to first + count - 1 of the batch through queue. Their constants have to
+	// be written, and on the immediate context also unmapped with EndConstants, by then.
+	void RecordObjects(RenderContext& context, const Scene& scene, const BatchDraws& batch, unsigned int first, unsigned int count, DrawQueue& queue) {
+		queue.Clear();
+		for (int pass = 0; pass < batch.PassCount; pass++) {
+			for (unsigned int i = first; i < first + count; i++) {
+				unsigned int object = batch.Objects[i];
+				const Mesh& mesh = scene.GetMesh(scene.GetObjectMesh(object));
+				if (!mesh.Resident) {
+					// Still being streamed in.
+					continue;
+				}
+				DrawPacket packet;
+				packet.Pass = pass;
+				packet.Material = scene.GetObjectMaterial(object);
+				// The square of the distance sorts the same, without the square root.
+				Vector3 offset = scene.GetObjectPosition(object) - batch.ViewPosition;
+				packet.Key = MakeDrawKey(pass, 0, packet.Material, Dot(offset, offset));
+				packet.ObjectOffset = batch.ObjectOffset + i * ObjectConstantSize;
+				packet.VertexCount = mesh.VertexCount;
+				packet.StartVertex = mesh.FirstVertex;
+				queue.Add(packet);
+			}
+		}
+		queue.Sort();
+
+		// With StereoMode_Instanced both eyes are drawn in one go, see RenderDevice.h.
+		queue.Submit(context, batch.InstanceCount, [&](RenderContext& target, int pass) {
+			if (batch.Latched) {
+				target.BindLatchedConstants(ConstantSlot_Frame, pass);
+			}
+			else {
+				target.BindConstants(ConstantSlot_Frame, batch.Passes[pass].FrameOffset, batch.FrameConstantSize);
+			}
+			target.SetViewport(batch.Passes[pass].Viewport);
+		});
+	}
+
+	/*
+		Records objects first to first + count - 1 of a late latched frame, whose object constants
+		were allocated in batches of MaxObjectsPerBatch starting at object frameFirst, as listed in
+		setup.BatchConstants.
+	*/
+	void RecordLatchedObjects(RenderContext& context, const Scene& scene, const StereoSetup& setup, BatchDraws batch, unsigned int frameFirst, unsigned int first, unsigned int count, DrawQueue& queue) {
+		unsigned int end = first + count;
+		while (first < end) {
+			unsigned int index = (first - frameFirst) / MaxObjectsPerBatch;
+			unsigned int batchFirst = frameFirst + index * MaxObjectsPerBatch;
+			batch.Objects = &setup.VisibleObjects[batchFirst];
+			batch.ObjectConstants = setup.BatchConstants[index].first;
+			batch.ObjectOffset = setup.BatchConstants[index].second;
+
+			unsigned int batchCount = std::min(end - first, batchFirst + MaxObjectsPerBatch - first);
+			WriteObjectConstants(scene, batch, first - batchFirst, batchCount);
+			RecordObjects(context, scene, batch, first - batchFirst, batchCount, queue);
+			first += batchCount;
+		}
+	}
+
+	// Hands the scene to the device for GPU driven drawing if it changed since it last did.
+	// Returns whether the device draws it that way.
+	bool UploadSceneInstances(RenderDevice& device, StereoSetup& setup, const Scene& scene) {
+		if (setup.GpuSceneRevision != scene.GetRevision()) {
+			ScopedProfileTimer timer(ProfileStage_Upload);
+			scene.GetInstances(setup.GpuInstances, setup.GpuMeshDraws);
+			setup.GpuSceneAccepted = device.SetSceneInstances(setup.GpuInstances.data(), static_cast<unsigned int>(setup.GpuInstances.size()),
+				setup.GpuMeshDraws.data(), static_cast<unsigned int>(setup.GpuMeshDraws.size()));
+			setup.GpuSceneRevision = scene.GetRevision();
+		}
+		return setup.GpuSceneAccepted;
+	}
+
+	// The tracking state eye poses were sampled at and the head pose they were predicted as.
+	struct PoseSample {
+		PoseState State;
+		Pose Head;
+	};
+
+	/*
+		The eye poses to draw with, predicted by the HMD or by setup.Predictor. A late latched frame
+		samples them twice, so nothing is kept here: once the frame's poses are final, KeepPoseSample
+		hands the sample to the predictor and the log.
+	*/
+	void SampleEyePoses(Hmd& hmd, const StereoSetup& setup, const Vector3 hmdToEyeViewOffset[EyeCount], Pose outEyePoses[EyeCount], PoseSample& outSample) {
+		if (setup.OwnPrediction) {
+			outSample.State = hmd.GetTrackingState();
+			PosePredictor predictor = setup.Predictor;
+			predictor.AddSample(outSample.State);
+			outSample.Head = predictor.Predict(hmd.GetFrameTiming().ScanoutMidpointSeconds);
+			for (int eye = 0; eye < EyeCount; eye++) {
+				outEyePoses[eye].Orientation = outSample.Head.Orientation;
+				outEyePoses[eye].Position = outSample.Head.Position + Rotate(outSample.Head.Orientation, hmdToEyeViewOffset[eye]);
+			}
+		}
+		else {
+			hmd.GetEyePoses(0, hmdToEyeViewOffset, outEyePoses);
+			if (setup.TrackingLog != nullptr) {
+				outSample.State = hmd.GetTrackingState();
+				outSample.Head.Orientation = outEyePoses[0].Orientation;
+				outSample.Head.Position = outEyePoses[0].Position - Rotate(outEyePoses[0].Orientation, hmdToEyeViewOffset[0]);
+			}
+		}
+	}
+
+	// Once per frame, for the poses the frame is drawn with.
+	void KeepPoseSample(StereoSetup& setup, const PoseSample& sample) {
+		if (setup.OwnPrediction) {
+			setup.Predictor.AddSample(sample.State);
+		}
+		if (setup.TrackingLog != nullptr) {
+			setup.TrackingLog->WriteSample(sample.State);
+			setup.TrackingLog->WritePrediction(sample.Head);
+		}
+	}
+
+	// Hands the HMD's distortion meshes for the eyes' FOVs to the device. False if either has none.
+	bool SetDistortionMeshes(const Hmd& hmd, RenderDevice& device, const EyeRenderDesc eyeRenderDesc[EyeCount]) {
+		std::vector<DistortionPoint> points;
+		std::vector<unsigned short> indices;
+		DistortionMesh mesh;
+		for (int eye = 0; eye < EyeCount; eye++) {
+			if (!hmd.GetDistortionMesh(eye, eyeRenderDesc[eye].Fov, points, indices)) {
+				return false;
+			}
+			PackDistortionMesh(points, indices, mesh);
+			if (!device.SetDistortionMesh(eye, mesh)) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// Makes the hidden area meshes from the HMD's distortion meshes for the eyes' FOVs and hands
+	// them to the device. False if the HMD has no distortion meshes or the device can't mask.
+	bool SetHiddenAreaMeshes(const Hmd& hmd, RenderDevice& device, const EyeRenderDesc eyeRenderDesc[EyeCount], HiddenAreaMesh outMeshes[EyeCount]) {
+		std::vector<DistortionPoint> points;
+		std::vector<unsigned short> indices;
+		for (int eye = 0; eye < EyeCount; eye++) {
+			if (!hmd.GetDistortionMesh(eye, eyeRenderDesc[eye].Fov, points, indices)) {
+				return false;
+			}
+			GenerateHiddenAreaMesh(points, indices, eyeRenderDesc[eye].Fov, outMeshes[eye]);
+			if (!device.SetHiddenAreaMesh(eye, outMeshes[eye])) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// The frame constants of a pass: a Matrix4, or StereoConstants with StereoMode_Instanced.
+	void WritePassConstants(const BatchDraws& batch, int pass, const Matrix4 transposedMvp[MaxViews], const float clipRect[MaxViews][4], void* outConstants) {
+		const DrawPass& drawPass = batch.Passes[pass];
+		if (batch.InstanceCount > 1) {
+			StereoConstants* constants = static_cast<StereoConstants*>(outConstants);
+			for (int eye = 0; eye < EyeCount; eye++) {
+				constants->ViewProjection[eye] = transposedMvp[drawPass.View[eye]];
+				memcpy(constants->ClipRect[eye], clipRect[drawPass.View[eye]], sizeof(constants->ClipRect[eye]));
+			}
+		}
+		else {
+			memcpy(outConstants, &transposedMvp[drawPass.View[0]], sizeof(Matrix4));
+		}
+	}
+
+	// Updates the latched frame constants, the ones RecordObjects binds for BatchDraws::Latched.
+	void LatchFrameConstants(RenderDevice& device, const BatchDraws& batch, const Matrix4 transposedMvp[MaxViews], const float clipRect[MaxViews][4]) {
+		for (int pass = 0; pass < batch.PassCount; pass++) {
+			StereoConstants constants;
+			WritePassConstants(batch, pass, transposedMvp, clipRect, &constants);
+			device.LatchConstants(pass, &constants, batch.FrameConstantSize);
+		}
+	}
+
+	/*
+		Maps a view's NDC (-1 to 1) onto [left, right] x [bottom, top], its viewport within the whole
+		target, for StereoMode_Instanced. Applied in clip space, hence the offsets going into the
+		w column. The rectangle itself goes into clipRect, in StereoConstants::ClipRect order.
+	*/
+	Matrix4 ComputeViewportTransform(Size2i targetSize, const Rect2i& viewport, float clipRect[4]) {
+		float width = static_cast<float>(targetSize.w);
+		float height = static_cast<float>(targetSize.h);
+		float left = 2.0f * viewport.Pos.x / width - 1.0f;
+		float right = 2.0f * (viewport.Pos.x + viewport.Size.w) / width - 1.0f;
+		float top = 1.0f - 2.0f * viewport.Pos.y / height;
+		float bottom = 1.0f - 2.0f * (viewport.Pos.y + viewport.Size.h) / height;
+
+		clipRect[0] = left;
+		clipRect[1] = right;
+		clipRect[2] = bottom;
+		clipRect[3] = top;
+
+		Matrix4 viewportTransform = { {
+			{ (right - left) * 0.5f, 0.0f, 0.0f, (right + left) * 0.5f },
+			{ 0.0f, (top - bottom) * 0.5f, 0.0f, (top + bottom) * 0.5f },
+			{ 0.0f, 0.0f, 1.0f, 0.0f },
+			{ 0.0f, 0.0f, 0.0f, 1.0f }
+		} };
+		return viewportTransform;
+	}
+}
+
+StereoSetup CreateStereoSetup(const Hmd& hmd, float pixelsPerDisplayPixel) {
+	StereoSetup setup;
+
+	// Fetch the texture sizes needed for the eye buffers.
+	// We'll be using a single texture for both eyes, so we'll figure out how large that texture needs to be.
+	auto eyeDimsLeft = hmd.GetFovTextureSize(0, hmd.GetDefaultEyeFov(0), pixelsPerDisplayPixel);
+	auto eyeDimsRight = hmd.GetFovTextureSize(1, hmd.GetDefaultEyeFov(0), pixelsPerDisplayPixel);
+
+	// We ARE making an assumption here that both eye buffers have the same width, as this is the case for DK2.
+	setup.RenderTargetSize.w = eyeDimsLeft.w + eyeDimsRight.w;
+	setup.RenderTargetSize.h = std::max(eyeDimsLeft.h, eyeDimsRight.h);
+
+	// View ports for each eye. We'll be using a single a single render target and allocate half of it to each eye.
+	setup.EyeRenderViewport[0].Pos.x = 0;
+	setup.EyeRenderViewport[0].Pos.y = 0;
+	setup.EyeRenderViewport[0].Size.w = setup.RenderTargetSize.w / 2;
+	setup.EyeRenderViewport[0].Size.h = setup.RenderTargetSize.h;
+	setup.EyeRenderViewport[1].Pos.x = (setup.RenderTargetSize.w + 1) / 2;
+	setup.EyeRenderViewport[1].Pos.y = 0;
+	setup.EyeRenderViewport[1].Size = setup.EyeRenderViewport[0].Size;
+	setup.MaxEyeRenderViewport[0] = setup.EyeRenderViewport[0];
+	setup.MaxEyeRenderViewport[1] = setup.EyeRenderViewport[1];
+	setup.AdaptiveResolution = false;
+
+	// FOV for each eye.
+	setup.EyeFov[0] = hmd.GetDefaultEyeFov(0);
+	setup.EyeFov[1] = hmd.GetDefaultEyeFov(1);
+
+	setup.Mode = StereoMode_MultiPass;
+	setup.LateLatch = false;
+	setup.Foveated = false;
+	setup.Foveation = GetDefaultFoveationSettings();
+	setup.GpuDriven = false;
+	setup.GpuSceneRevision = 0;
+	setup.GpuSceneAccepted = false;
+	setup.OwnPrediction = false;
+	setup.TrackingLog = nullptr;
+	setup.FrameIndex = 0;
+	setup.SubmitClock = nullptr;
+	setup.SubmitTime = 0.0;
+	setup.OwnDistortion = false;
+	setup.Timewarp = false;
+	setup.FusedResolve = false;
+	setup.DistortionMeshesSet = false;
+	setup.DistortionAccepted = false;
+	std::memset(setup.Distortion, 0, sizeof(setup.Distortion));
+	setup.HiddenAreaMask = false;
+	setup.HiddenAreaMeshesSet = false;
+	setup.HiddenAreaAccepted = false;
+	setup.CommandCapture = nullptr;
+
+	setup.EyeMatrices.SetViewCount(EyeCount);
+	setup.EyeMatrices.SetBodyTransform(BodyPosition, QuaternionFromAxisAngle(UpVector, BodyYaw));
+
+	return setup;
+}
+
+void SetResolutionScale(StereoSetup& setup, float scale) {
+	for (int eye = 0; eye < EyeCount; eye++) {
+		const Rect2i& maxViewport = setup.MaxEyeRenderViewport[eye];
+		setup.EyeRenderViewport[eye].Pos = maxViewport.Pos;
+		setup.EyeRenderViewport[eye].Size.w = std::max(1, static_cast<int>(maxViewport.Size.w * scale + 0.5f));
+		setup.EyeRenderViewport[eye].Size.h = std::max(1, static_cast<int>(maxViewport.Size.h * scale + 0.5f));
+	}
+}
+
+void AddDefaultSceneContent(Scene& scene) {
+	const Vector3 origin = { 0.0f, 0.0f, 0.0f };
+	int triangle = scene.AddMesh(SceneVertices, SceneVertexCount);
+	scene.AddObject(triangle, origin, QuaternionIdentity(), 1.0f);
+}
+
+Matrix4 ComputeEyeViewProjection(const EyeRenderDesc& eyeRenderDesc, const Pose& eyeRenderPose) {
+	// Calculate projection and view for the current eye. You'll probably replace all of this in
+	// your own project.
+	Matrix4 projection = PerspectiveProjection(eyeRenderDesc.Fov, ZNear, ZFar, true);
+	Quaternion quatBodyRotation = QuaternionFromAxisAngle(UpVector, BodyYaw);
+	Pose worldPose;
+	worldPose.Orientation = quatBodyRotation * eyeRenderPose.Orientation; // Final rotation (body AND head)
+	worldPose.Position = BodyPosition + Rotate(quatBodyRotation, eyeRenderPose.Position); // Final position (body AND eye)
+
+	auto up = Rotate(worldPose.Orientation, UpVector);
+	auto forward = Rotate(worldPose.Orientation, ForwardVector);
+
+	Matrix4 view = LookAtRH(worldPose.Position, worldPose.Position + forward, up);
+
+	return projection * view;
+}
+
+StereoConstants ComputeStereoConstants(const StereoSetup& setup, const EyeRenderDesc eyeRenderDesc[EyeCount], const Pose eyeRenderPose[EyeCount]) {
+	StereoConstants constants;
+	for (int eye = 0; eye < EyeCount; eye++) {
+		Matrix4 viewportTransform = ComputeViewportTransform(setup.RenderTargetSize, setup.EyeRenderViewport[eye], constants.ClipRect[eye]);
+		constants.ViewProjection[eye] = Transposed(viewportTransform * ComputeEyeViewProjection(eyeRenderDesc[eye], eyeRenderPose[eye]));
+	}
+	return constants;
+}
+
+void RenderFrame(Hmd& hmd, RenderDevice& device, StereoSetup& setup, const Scene& scene, JobSystem& jobs) {
+	EyeRenderDesc eyeRenderDesc[EyeCount] = { hmd.GetEyeRenderDesc(0), hmd.GetEyeRenderDesc(1) };
+	Vector3 hmdToEyeViewOffset[EyeCount] = {
+		eyeRenderDesc[0].HmdToEyeViewOffset,
+		eyeRenderDesc[1].HmdToEyeViewOffset
+	};
+
+	ClockTicks frameStart = ReadClock();
+	if (setup.AdaptiveResolution) {
+		SetResolutionScale(setup, setup.Resolution.GetScale());
+		for (int eye = 0; eye < EyeCount; eye++) {
+			hmd.SetEyeRenderViewport(eye, setup.EyeRenderViewport[eye]);
+		}
+	}
+
+	{
+		ScopedProfileTimer timer(ProfileStage_BeginFrame);
+		hmd.BeginFrame(setup.FrameIndex);
+		if (setup.TrackingLog != nullptr) {
+			setup.TrackingLog->WriteFrame(hmd.GetFrameTiming());
+			setup.TrackingLog->WriteSample(hmd.GetTrackingState());
+		}
+	}
+
+	Pose eyeRenderPose[EyeCount];
+	PoseSample poseSample;
+	ClockTicks poseTime;
+	{
+		ScopedProfileTimer timer(ProfileStage_GetEyePoses);
+		SampleEyePoses(hmd, setup, hmdToEyeViewOffset, eyeRenderPose, poseSample);
+		poseTime = ReadClock();
+	}
+
+	// Each eye is one view, or with foveation split into a view per region, see FoveatedLayout.h.
+	int regionCount = setup.Foveated ? FoveatedRegionCount : 1;
+	int viewCount = EyeCount * regionCount;
+	Rect2i viewViewport[MaxViews];
+	Matrix4 viewCrop[MaxViews];
+	if (setup.Foveated) {
+		ComputeFoveatedLayout(setup.EyeRenderViewport, setup.Foveation, setup.FoveatedTargets);
+		for (int eye = 0; eye < EyeCount; eye++) {
+			for (int region = 0; region < regionCount; region++) {
+				const FoveatedRegion& foveatedRegion = setup.FoveatedTargets.Regions[eye][region];
+				viewViewport[eye * regionCount + region] = foveatedRegion.Target;
+				viewCrop[eye * regionCount + region] = foveatedRegion.Eye.Size.w > 0 && foveatedRegion.Eye.Size.h > 0 ? ComputeRegionCrop(foveatedRegion) : MatrixIdentity();
+			}
+		}
+		device.SetFoveatedLayout(&setup.FoveatedTargets);
+	}
+	else {
+		for (int eye = 0; eye < EyeCount; eye++) {
+			viewViewport[eye] = setup.EyeRenderViewport[eye];
+			viewCrop[eye] = MatrixIdentity();
+		}
+		device.SetFoveatedLayout(nullptr);
+	}
+	// Only once the device distorts, the HMD can't sample a multisampled eye texture.
+	device.SetFusedResolve(setup.OwnDistortion && setup.FusedResolve && setup.DistortionAccepted);
+
+	if (setup.AdaptiveResolution) {
+		device.BeginGpuTimer();
+	}
+
+	{
+		ScopedProfileTimer timer(ProfileStage_Clear);
+		if (setup.HiddenAreaMask && !setup.HiddenAreaMeshesSet) {
+			setup.HiddenAreaAccepted = SetHiddenAreaMeshes(hmd, device, eyeRenderDesc, setup.HiddenArea);
+			setup.HiddenAreaMeshesSet = true;
+		}
+		bool masked = setup.HiddenAreaMask && setup.HiddenAreaAccepted && !setup.Foveated;
+		device.SetHiddenAreaViewports(masked ? setup.EyeRenderViewport : nullptr);
+		float clearColor[] = { 0.2f, 0.3f, 0.2f, 1 };
+		device.ClearEyeTexture(clearColor);
+		device.ClearDepthStencil(1, 0);
+
+		// We use one single render target for both eyes.
+		device.BindEyeTexture();
+	}
+
+	// All views' matrices in one batch, already transposed for the shader. The projections are
+	// cached, SetView only recomputes them if the FOV or the view's viewport changed.
+	Matrix4 transposedMvp[MaxViews];
+	float clipRect[MaxViews][4];
+	Pose viewPose[MaxViews];
+	{
+		ScopedProfileTimer timer(ProfileStage_EyeMatrices);
+		if (setup.EyeMatrices.GetViewCount() != viewCount) {
+			setup.EyeMatrices.SetViewCount(viewCount);
+		}
+		for (int view = 0; view < viewCount; view++) {
+			int eye = view / regionCount;
+			Matrix4 clipTransform = ComputeViewportTransform(setup.RenderTargetSize, viewViewport[view], clipRect[view]) * viewCrop[view];
+			if (setup.Mode != StereoMode_Instanced) {
+				clipTransform = viewCrop[view];
+			}
+			setup.EyeMatrices.SetView(view, eyeRenderDesc[eye].Fov, ZNear, ZFar, clipTransform);
+			viewPose[view] = eyeRenderPose[eye];
+		}
+		setup.EyeMatrices.Compute(viewPose, transposedMvp);
+	}
+
+	// One cull for both eyes, by the device itself if it draws the scene GPU driven.
+	bool gpuDriven = setup.GpuDriven && UploadSceneInstances(device, setup, scene);
+	std::vector<unsigned int>& visible = setup.VisibleObjects;
+	Vector3 viewPosition;
+	{
+		ScopedProfileTimer timer(ProfileStage_Cull);
+		Pose worldPose[EyeCount];
+		FovPort eyeFov[EyeCount];
+		for (int eye = 0; eye < EyeCount; eye++) {
+			worldPose[eye] = ComputeWorldPose(eyeRenderPose[eye]);
+			eyeFov[eye] = eyeRenderDesc[eye].Fov;
+			if (setup.LateLatch) {
+				eyeFov[eye].UpTan += LateLatchCullMargin;
+				eyeFov[eye].DownTan += LateLatchCullMargin;
+				eyeFov[eye].LeftTan += LateLatchCullMargin;
+				eyeFov[eye].RightTan += LateLatchCullMargin;
+			}
+		}
+		Frustum frustum = ComputeStereoCullFrustum(worldPose, eyeFov, ZNear, ZFar);
+		viewPosition = (worldPose[0].Position + worldPose[1].Position) * 0.5f;
+
+		visible.clear();
+		if (gpuDriven) {
+			device.SetStereoMode(setup.Mode);
+			device.CullSceneInstances(frustum);
+		}
+
+		unsigned int objectCount = gpuDriven ? 0 : scene.GetObjectCount();
+		unsigned int jobCount = (objectCount + ObjectsPerCullJob - 1) / ObjectsPerCullJob;
+		if (setup.CullJobResults.size() < jobCount) {
+			setup.CullJobResults.resize(jobCount);
+		}
+		jobs.ParallelFor(jobCount, [&](unsigned int job, int thread) {
+			unsigned int first = job * ObjectsPerCullJob;
+			std::vector<unsigned int>& result = setup.CullJobResults[job];
+			result.clear();
+			scene.Cull(frustum, first, std::min(objectCount - first, ObjectsPerCullJob), result);
+		});
+
+		for (unsigned int job = 0; job < jobCount; job++) {
+			visible.insert(visible.end(), setup.CullJobResults[job].begin(), setup.CullJobResults[job].end());
+		}
+	}
+
+	// The passes, skipping the empty regions of a foveated frame.
+	BatchDraws batch;
+	batch.PassCount = 0;
+	if (setup.Mode == StereoMode_Instanced) {
+		batch.InstanceCount = EyeCount;
+		batch.FrameConstantSize = sizeof(StereoConstants);
+		for (int region = 0; region < regionCount; region++) {
+			if (viewViewport[region].Size.w == 0 || viewViewport[region].Size.h == 0) {
+				continue;
+			}
+			DrawPass& pass = batch.Passes[batch.PassCount++];
+			pass.Viewport.Pos.x = 0;
+			pass.Viewport.Pos.y = 0;
+			pass.Viewport.Size = setup.RenderTargetSize;
+			for (int eye = 0; eye < EyeCount; eye++) {
+				pass.View[eye] = eye * regionCount + region;
+			}
+		}
+	}
+	else {
+		batch.InstanceCount = 1;
+		batch.FrameConstantSize = sizeof(Matrix4);
+
+		// We'll assume people have at most two eyes.
+		for (int e = 0; e < EyeCount; e++) {
+			// The HMD might want us to render each eye in a specific order for best result.
+			int eye = hmd.GetEyeRenderOrder(e);
+			for (int region = 0; region < regionCount; region++) {
+				int view = eye * regionCount + region;
+				if (viewViewport[view].Size.w == 0 || viewViewport[view].Size.h == 0) {
+					continue;
+				}
+				DrawPass& pass = batch.Passes[batch.PassCount++];
+				pass.Viewport = viewViewport[view];
+				pass.View[0] = view;
+			}
+		}
+	}
+
+	device.SetStereoMode(setup.Mode);
+	unsigned int visibleCount = static_cast<unsigned int>(visible.size());
+	batch.Latched = setup.LateLatch;
+	batch.ViewPosition = viewPosition;
+	if (setup.DrawQueues.size() < static_cast<size_t>(MaxRecordingContexts)) {
+		setup.DrawQueues.resize(MaxRecordingContexts);
+	}
+	if (gpuDriven) {
+		if (setup.LateLatch) {
+			{
+				ScopedProfileTimer timer(ProfileStage_GetEyePoses);
+				SampleEyePoses(hmd, setup, hmdToEyeViewOffset, eyeRenderPose, poseSample);
+				poseTime = ReadClock();
+			}
+			ScopedProfileTimer timer(ProfileStage_EyeMatrices);
+			for (int view = 0; view < viewCount; view++) {
+				viewPose[view] = eyeRenderPose[view / regionCount];
+			}
+			setup.EyeMatrices.Compute(viewPose, transposedMvp);
+		}
+		{
+			ScopedProfileTimer timer(ProfileStage_ConstantUpload);
+			device.BeginConstants();
+			for (int pass = 0; pass < batch.PassCount; pass++) {
+				void* constants = device.AllocateConstants(batch.FrameConstantSize, batch.Passes[pass].FrameOffset);
+				WritePassConstants(batch, pass, transposedMvp, clipRect, constants);
+			}
+			device.EndConstants();
+		}
+		ScopedProfileTimer timer(ProfileStage_Draw);
+		for (int pass = 0; pass < batch.PassCount; pass++) {
+			device.BindConstants(ConstantSlot_Frame, batch.Passes[pass].FrameOffset, batch.FrameConstantSize);
+			device.SetViewport(batch.Passes[pass].Viewport);
+			device.DrawSceneInstances();
+		}
+	}
+	else if (!setup.LateLatch) {
+		for (unsigned int first = 0; first < visibleCount; first += MaxObjectsPerBatch) {
+			unsigned int objectCount = std::min(visibleCount - first, MaxObjectsPerBatch);
+			batch.Objects = &visible[first];
+
+			// Recording contexts only pay off if there is something to run in parallel.
+			unsigned int jobCount = (objectCount + ObjectsPerRecordJob - 1) / ObjectsPerRecordJob;
+			bool record = jobs.GetThreadCount() > 1 && jobCount > 1;
+
+			// The View-Projection matrices for the Vertex Shader, and room for the world matrices of the
+			// batch's objects, which the record jobs fill in. Drawn directly, the constants have to be
+			// unmapped before the first draw.
+			{
+				ScopedProfileTimer timer(ProfileStage_ConstantUpload);
+				device.BeginConstants();
+				for (int pass = 0; pass < batch.PassCount; pass++) {
+					void* constants = device.AllocateConstants(batch.FrameConstantSize, batch.Passes[pass].FrameOffset);
+					WritePassConstants(batch, pass, transposedMvp, clipRect, constants);
+				}
+				batch.ObjectConstants = static_cast<unsigned char*>(device.AllocateConstants(objectCount * ObjectConstantSize, batch.ObjectOffset));
+				if (!record) {
+					WriteObjectConstants(scene, batch, 0, objectCount);
+					device.EndConstants();
+				}
+			}
+
+			{
+				ScopedProfileTimer timer(ProfileStage_Record);
+				if (record) {
+					jobs.ParallelFor(jobCount, [&](unsigned int job, int thread) {
+						unsigned int firstObject = job * ObjectsPerRecordJob;
+						unsigned int count = std::min(objectCount - firstObject, ObjectsPerRecordJob);
+						WriteObjectConstants(scene, batch, firstObject, count);
+						RecordObjects(device.BeginRecording(job), scene, batch, firstObject, count, setup.DrawQueues[job]);
+						device.EndRecording(job);
+					});
+				}
+				else {
+					RecordObjects(device, scene, batch, 0, objectCount, setup.DrawQueues[0]);
+				}
+			}
+
+			if (record) {
+				ScopedProfileTimer timer(ProfileStage_Draw);
+				device.EndConstants();
+				device.ExecuteRecordings(jobCount);
+			}
+		}
+	}
+	else {
+		bool latched = false;
+		unsigned int first = 0;
+		unsigned int jobCount;
+		for (;;) {
+			// Room for the object constants of as many batches as fit, usually the whole frame.
+			unsigned int end = first;
+			{
+				ScopedProfileTimer timer(ProfileStage_ConstantUpload);
+				device.BeginConstants();
+				setup.BatchConstants.clear();
+				while (end < visibleCount) {
+					unsigned int objectCount = std::min(visibleCount - end, MaxObjectsPerBatch);
+					unsigned int offset;
+					void* constants = device.AllocateConstants(objectCount * ObjectConstantSize, offset);
+					if (constants == nullptr) {
+						break;
+					}
+					setup.BatchConstants.push_back(std::make_pair(static_cast<unsigned char*>(constants), offset));
+					end += objectCount;
+				}
+			}
+
+			// Always on recording contexts, as the draws must not run before the constants are latched.
+			unsigned int objectCount = end - first;
+			jobCount = 1;
+			if (jobs.GetThreadCount() > 1) {
+				jobCount = std::min((objectCount + ObjectsPerRecordJob - 1) / ObjectsPerRecordJob, static_cast<unsigned int>(MaxRecordingContexts));
+			}
+			{
+				ScopedProfileTimer timer(ProfileStage_Record);
+				jobs.ParallelFor(jobCount, [&](unsigned int job, int thread) {
+					unsigned int jobFirst = first + objectCount * job / jobCount;
+					unsigned int jobEnd = first + objectCount * (job + 1) / jobCount;
+					RecordLatchedObjects(device.BeginRecording(job), scene, setup, batch, first, jobFirst, jobEnd - jobFirst, setup.DrawQueues[job]);
+					device.EndRecording(job);
+				});
+			}
+
+			first = end;
+			if (first == visibleCount || setup.BatchConstants.empty()) {
+				break;
+			}
+
+			// The frame doesn't fit, so what has been recorded so far has to be drawn to make room
+			// for the rest. All of it is drawn with the pose the frame was culled with.
+			if (!latched) {
+				LatchFrameConstants(device, batch, transposedMvp, clipRect);
+				latched = true;
+			}
+			ScopedProfileTimer timer(ProfileStage_Draw);
+			device.EndConstants();
+			device.ExecuteRecordings(jobCount);
+		}
+
+		if (!latched) {
+			{
+				ScopedProfileTimer timer(ProfileStage_GetEyePoses);
+				SampleEyePoses(hmd, setup, hmdToEyeViewOffset, eyeRenderPose, poseSample);
+				poseTime = ReadClock();
+			}
+			ScopedProfileTimer timer(ProfileStage_EyeMatrices);
+			for (int view = 0; view < viewCount; view++) {
+				viewPose[view] = eyeRenderPose[view / regionCount];
+			}
+			setup.EyeMatrices.Compute(viewPose, transposedMvp);
+			LatchFrameConstants(device, batch, transposedMvp, clipRect);
+		}
+
+		ScopedProfileTimer timer(ProfileStage_Draw);
+		device.EndConstants();
+		device.ExecuteRecordings(jobCount);
+	}
+	KeepPoseSample(setup, poseSample);
+
+	{
+		ScopedProfileTimer timer(ProfileStage_Resolve);
+		device.ResolveEyeTexture();
+	}
+
+	// The next frame's resolution. EndFrame may wait for vsync, so the CPU time stops here.
+	if (setup.AdaptiveResolution) {
+		device.EndGpuTimer();
+		double frameTime;
+		if (!device.GetGpuFrameTime(frameTime)) {
+			frameTime = ClockTicksToSeconds(ReadClock() - frameStart);
+		}
+		setup.Resolution.Update(frameTime);
+	}
+
+	if (setup.OwnDistortion) {
+		ScopedProfileTimer timer(ProfileStage_Distortion);
+		if (!setup.DistortionMeshesSet) {
+			setup.DistortionAccepted = SetDistortionMeshes(hmd, device, eyeRenderDesc);
+			setup.DistortionMeshesSet = true;
+		}
+		if (setup.DistortionAccepted) {
+			// Without timewarp the frame is shown as it was drawn, both eyes have the head's orientation.
+			Quaternion scanoutStart = eyeRenderPose[0].Orientation;
+			Quaternion scanoutEnd = scanoutStart;
+			if (setup.Timewarp) {
+				PoseState state = hmd.GetTrackingState();
+				double scanoutMidpoint = hmd.GetFrameTiming().ScanoutMidpointSeconds;
+				double halfScanout = 0.5 / hmd.GetRefreshRate();
+				scanoutStart = ExtrapolatePose(state, static_cast<float>(scanoutMidpoint - halfScanout - state.TimeInSeconds), false).Orientation;
+				scanoutEnd = ExtrapolatePose(state, static_cast<float>(scanoutMidpoint + halfScanout - state.TimeInSeconds), false).Orientation;
+			}
+			for (int eye = 0; eye < EyeCount; eye++) {
+				setup.Distortion[eye] = ComputeDistortionConstants(eyeRenderDesc[eye].Fov, setup.RenderTargetSize, setup.EyeRenderViewport[eye],
+					eyeRenderPose[eye].Orientation, scanoutStart, scanoutEnd);
+			}
+			device.PresentDistorted(setup.Distortion);
+		}
+	}
+
+	// Finish the current frame and send it to the HMD.
+	{
+		ScopedProfileTimer timer(ProfileStage_EndFrame);
+		Profiler::Record(ProfileStage_PoseToSubmit, poseTime, ReadClock());
+		if (setup.SubmitClock != nullptr) {
+			setup.SubmitTime = setup.SubmitClock->GetTime();
+		}
+		hmd.EndFrame(eyeRenderPose);
+		if (setup.TrackingLog != nullptr) {
+			setup.TrackingLog->WriteSample(hmd.GetTrackingState());
+		}
+		if (setup.CommandCapture != nullptr) {
+			setup.CommandCapture->EndFrame(eyeRenderPose);
+		}
+	}
+}
@@ -0,0 +1,252 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#pragma once
+
+#include "CommandCapture.h"
+#include "DrawQueue.h"
+#include "EyeMatrixPipeline.h"
+#include "FoveatedLayout.h"
+#include "FrameScheduler.h"
+#include "Hmd.h"
+#include "JobSystem.h"
+#include "PosePrediction.h"
+#include "RenderDevice.h"
+#include "ResolutionController.h"
+#include "Scene.h"
+#include "TrackingLog.h"
+#include <utility>
+
+/*
+	The backend independent part of the sample: how the eye buffers are laid out and what is done
+	each frame. Both the D3D11 sample and the headless runner use this, so whatever is measured on
+	the headless runner is the same code that drives the HMD.
+*/
+
+// Clip planes of the eye projections.
+const float ZNear = 0.01f;
+const float ZFar = 10000.0f;
+
+struct StereoSetup {
+	Size2i RenderTargetSize;
+	Rect2i EyeRenderViewport[EyeCount];
+
+	/*
+		Adaptive resolution: the render target is sized for MaxEyeRenderViewport, and each frame
+		RenderFrame sizes EyeRenderViewport by the scale Resolution picked from the previous
+		frames' GPU times (or CPU times, if the device can't measure the GPU). Off by default.
+	*/
+	Rect2i MaxEyeRenderViewport[EyeCount];
+	bool AdaptiveResolution;
+	ResolutionController Resolution;
+	FovPort EyeFov[EyeCount];
+	StereoMode Mode;
+
+	/*
+		Fixed foveated rendering, see FoveatedLayout.h. Off by default. RenderFrame recomputes
+		FoveatedTargets from EyeRenderViewport and Foveation every frame, so it follows the
+		adaptive resolution, and passes it on to the device.
+	*/
+	bool Foveated;
+	FoveationSettings Foveation;
+	FoveatedLayout FoveatedTargets;
+
+	// Per-view projections and the body transform, kept up to date by RenderFrame.
+	EyeMatrixPipeline EyeMatrices;
+
+	// Result of the last frame's culling, kept around so it is only allocated once. Each cull
+	// job collects its part in CullJobResults first.
+	std::vector<unsigned int> VisibleObjects;
+	std::vector<std::vector<unsigned int> > CullJobResults;
+
+	/*
+		Late latching: the frame is recorded with the view matrices bound indirectly, then the pose
+		is sampled once more and only the view matrices are updated with it right before the
+		recordings are executed. Off by default. See RenderFrame.
+	*/
+	bool LateLatch;
+
+	// Where each batch's object constants went, for late latched frames which record all batches
+	// before any of them is drawn. Pairs of memory and offset, as AllocateConstants returns them.
+	std::vector<std::pair<unsigned char*, unsigned int> > BatchConstants;
+
+	// Where the draws are sorted before they are submitted, one per recording context. The first
+	// is also used when drawing on the device directly.
+	std::vector<DrawQueue> DrawQueues;
+
+	/*
+		GPU driven drawing: the device culls and draws the scene by itself, see
+		RenderDevice::SetSceneInstances, so the frame loop costs the same however many objects
+		there are. The scene is handed to the device again whenever its revision changes. Off by
+		default, and the objects are drawn one by one as usual if the device can't do it.
+	*/
+	bool GpuDriven;
+	unsigned long long GpuSceneRevision; // Of the scene last handed to the device, 0 if none
+	bool GpuSceneAccepted; // Whether the device took it
+	std::vector<SceneInstance> GpuInstances;
+	std::vector<IndirectDrawArgs> GpuMeshDraws;
+
+	/*
+		Pose prediction: with OwnPrediction the eye poses are predicted by Predictor from the HMD's
+		tracking states rather than by the HMD itself. Off by default. Predictor is given one state
+		per frame, the one the poses the frame is drawn with were predicted from, also when late
+		latching samples the poses a second time.
+
+		With a TrackingLog every frame's timing, the tracking states and the pose it was drawn
+		with are written to it, see TrackingLog.h. Not owned, nullptr by default.
+	*/
+	bool OwnPrediction;
+	PosePredictor Predictor;
+	TrackingLogWriter* TrackingLog;
+
+	/*
+		Frame pacing: FrameIndex is passed to Hmd::BeginFrame, 0 by default to let the HMD count
+		the frames itself; a paced loop sets it to the vsync the frame is aimed at. With a
+		SubmitClock, SubmitTime is set to its time right before the frame is handed to the HMD,
+		as EndFrame may block until vsync. See FrameScheduler.h. Not owned, nullptr by default.
+	*/
+	unsigned int FrameIndex;
+	PacingClock* SubmitClock;
+	double SubmitTime;
+
+	/*
+		Own distortion: the device distorts and presents the frame with the HMD's meshes, see
+		Distortion.h, rather than the HMD. The meshes are made for EyeFov and handed to the device
+		with the first frame; if the HMD has none or the device doesn't take them the HMD is left
+		to it after all. With Timewarp each eye is rotated to the latest tracked head orientation,
+		extrapolated to the start and end of scanout. With FusedResolve the distortion resolves the
+		multisampled eye texture itself, see RenderDevice::SetFusedResolve, from the frame after
+		the device took the meshes. All off by default.
+	*/
+	bool OwnDistortion;
+	bool Timewarp;
+	bool FusedResolve;
+	bool DistortionMeshesSet; // Whether the meshes were handed to the device yet
+	bool DistortionAccepted;
+	DistortionConstants Distortion[EyeCount]; // Of the last frame
+
+	/*
+		Hidden area masking: the parts of the eye viewports the lens never shows are masked out of
+		the depth buffer before the scene is drawn, see HiddenArea.h. The meshes are made from the
+		HMD's distortion meshes for the eyes' FOVs with the first frame, whoever distorts; if the
+		HMD has none or the device doesn't take them nothing is masked. Not with foveation. Off by
+		default.
+	*/
+	bool HiddenAreaMask;
+	bool HiddenAreaMeshesSet; // Whether the meshes were made and handed to the device yet
+	bool HiddenAreaAccepted;
+	HiddenAreaMesh HiddenArea[EyeCount];
+
+	/*
+		Command capture: RenderFrame is then given CommandCapture as its device, and ends each
+		frame on it with the eye poses it was drawn with, see CommandCapture.h. Not owned, nullptr
+		by default.
+	*/
+	CommandCaptureDevice* CommandCapture;
+};
+
+// Constant buffer layout for StereoMode_Instanced. Must match the stereo vertex shader.
+struct StereoConstants {
+	// Transposed, as the shader expects column-major matrices.
+	Matrix4 ViewProjection[EyeCount];
+
+	// Left, right, bottom and top of each eye's viewport within the eye texture, in NDC.
+	float ClipRect[EyeCount][4];
+};
+
+// Figures out how large the shared eye texture needs to be and how it is split between the eyes.
+// The stereo mode defaults to StereoMode_MultiPass.
+StereoSetup CreateStereoSetup(const Hmd& hmd, float pixelsPerDisplayPixel);
+
+// Sizes the eye viewports to scale times MaxEyeRenderViewport, keeping their top left corners.
+void SetResolutionScale(StereoSetup& setup, float scale);
+
+// The scene of the original sample: a single triangle. Perhaps not very exciting.
+void AddDefaultSceneContent(Scene& scene);
+
+/*
+	The matrices and clip rectangles a StereoMode_Instanced frame uploads for the given poses.
+	RenderFrame gets the same result through setup.EyeMatrices, this is the plain reference version.
+
+	Each eye's view-projection is followed by a transform that squeezes the eye's clip space into
+	its viewport within the whole eye texture, so a point ends up on exactly the same pixel as it
+	would with the eye's own viewport in StereoMode_MultiPass.
+*/
+StereoConstants ComputeStereoConstants(const StereoSetup& setup, const EyeRenderDesc eyeRenderDesc[EyeCount], const Pose eyeRenderPose[EyeCount]);
+
+// View-projection for one eye, the matrix StereoMode_MultiPass uploads (before transposing).
+// Like ComputeStereoConstants this is the reference that EyeMatrixPipeline is checked against.
+Matrix4 ComputeEyeViewProjection(const EyeRenderDesc& eyeRenderDesc, const Pose& eyeRenderPose);
+
+/*
+	Renders one frame and hands it to the HMD. Each stage is timed, see Profiler.h.
+
+	The scene is culled once for both eyes (see ComputeStereoCullFrustum), split into jobs of
+	ObjectsPerCullJob objects. The visible objects are drawn in batches of MaxObjectsPerBatch, each
+	with its own constant upload. With more than one thread the objects of a batch are split into
+	jobs of ObjectsPerRecordJob that each write their objects' constants and record their draws on
+	a recording context of the device; the recordings are then executed in order, so the result is
+	the same as drawing everything on one thread.
+
+	Whoever draws a set of objects, the device or a record job, submits them through a DrawQueue,
+	sorted by pass, material and distance from the eyes, so each pass binds its constants and
+	viewport once and materials only change where they have to.
+
+	With setup.LateLatch the whole frame is recorded first, split into up to MaxRecordingContexts
+	jobs, with the view matrices bound through RenderDevice::BindLatchedConstants. Only then is
+	the pose sampled again and the new view matrices latched, right before the recordings are
+	executed and the frame is handed to the HMD with the new pose. The cull uses a FOV widened by
+	LateLatchCullMargin to cover the head turning in between. A frame whose object constants don't
+	all fit in the device's constant buffer can't wait that long: the part that fits is drawn
+	first, with the pose the frame was culled with.
+
+	Either way ProfileStage_PoseToSubmit measures how old the pose is when the frame is submitted.
+
+	With setup.GpuDriven the device culls (with the same frustum) and draws the scene by itself,
+	with no per-object work on the CPU, see RenderDevice::SetSceneInstances. setup.VisibleObjects
+	stays empty then. Each pass binds its frame constants and viewport and draws the culled
+	instances; there is nothing to record, so late latching only means sampling the pose again
+	after the cull.
+
+	With setup.Foveated each eye is drawn as FoveatedRegionCount regions, each a pass of its own
+	(or one instanced pass per region for both eyes), into the device's foveated target.
+
+	With setup.AdaptiveResolution the eye viewports are rescaled at the start of the frame and
+	passed on to the HMD, and the frame's time is fed to setup.Resolution at the end.
+
+	With setup.HiddenAreaMask the device masks the hidden area right after clearing, as part of
+	ProfileStage_Clear.
+
+	With setup.OwnDistortion the device distorts and presents the frame right before it is handed
+	to the HMD, timed as ProfileStage_Distortion. That isn't part of the frame time the resolution
+	goes by, as it costs the same at any resolution.
+*/
+const unsigned int MaxObjectsPerBatch = 1024;
+const unsigned int ObjectsPerCullJob = 8192;
+const unsigned int ObjectsPerRecordJob = MaxObjectsPerBatch / MaxRecordingContexts;
+const float LateLatchCullMargin = 0.05f; // Added to the tangents of each eye's FOV
+void RenderFrame(Hmd& hmd, RenderDevice& device, StereoSetup& setup, const Scene& scene, JobSystem& jobs);
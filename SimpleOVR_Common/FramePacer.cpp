@@ -0,0 +1,184 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#include "FramePacer.h"
+#include "ResolutionController.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+	const char* const LateFramePolicyNames[LateFramePolicyCount] = { "reproject", "drop" };
+}
+
+const char* GetLateFramePolicyName(LateFramePolicy policy) {
+	return LateFramePolicyNames[policy];
+}
+
+bool FindLateFramePolicy(const char* name, LateFramePolicy& outPolicy) {
+	for (int policy = 0; policy < LateFramePolicyCount; policy++) {
+		if (std::strcmp(name, LateFramePolicyNames[policy]) == 0) {
+			outPolicy = static_cast<LateFramePolicy>(policy);
+			return true;
+		}
+	}
+	return false;
+}
+
+FramePacer::Settings FramePacer::GetDefaultSettings(double refreshRate) {
+	Settings settings;
+	settings.RefreshRate = refreshRate;
+	settings.VsyncOrigin = 0.0;
+	settings.SubmitMargin = 0.002;
+	settings.Policy = LateFramePolicy_Reproject;
+	settings.Smoothing = 0.1f;
+	return settings;
+}
+
+FramePacer::FramePacer() :
+	settings(GetDefaultSettings(ResolutionController::DefaultRefreshRate)),
+	period(1.0 / ResolutionController::DefaultRefreshRate)
+{
+	Reset();
+}
+
+FramePacer::FramePacer(const Settings& settings) :
+	settings(settings),
+	period(1.0 / settings.RefreshRate)
+{
+	Reset();
+}
+
+PacedFrame FramePacer::BeginFrame(double now) {
+	unsigned long long vsync = GetFirstVsync(now);
+	if (hasShownFrame) {
+		vsync = std::max(vsync, lastShownVsync + 1);
+	}
+	if (settings.Policy == LateFramePolicy_Drop && hasFrameTime) {
+		if (GetStartTime(vsync, now) + smoothedFrameTime > GetVsyncTime(vsync) - settings.SubmitMargin) {
+			unsigned long long reachable = GetFirstVsync(now + smoothedFrameTime);
+			if (reachable > vsync) {
+				statistics.DroppedVsyncs += reachable - vsync;
+				vsync = reachable;
+			}
+		}
+	}
+
+	frame.Vsync = vsync;
+	frame.VsyncTime = GetVsyncTime(vsync);
+	frame.Deadline = frame.VsyncTime - settings.SubmitMargin;
+	frame.StartTime = GetStartTime(vsync, now);
+	return frame;
+}
+
+bool FramePacer::EndFrame(double submitTime) {
+	statistics.Frames++;
+
+	// Only the time spent drawing, not waiting for the start.
+	double frameTime = std::max(0.0, submitTime - frame.StartTime);
+	if (hasFrameTime) {
+		smoothedFrameTime += settings.Smoothing * (frameTime - smoothedFrameTime);
+	}
+	else {
+		smoothedFrameTime = frameTime;
+		hasFrameTime = true;
+	}
+
+	bool onTime = submitTime <= frame.Deadline;
+	unsigned long long shownVsync = frame.Vsync;
+	if (!onTime) {
+		statistics.MissedDeadlines++;
+		shownVsync = GetFirstVsync(submitTime);
+	}
+	if (hasShownFrame) {
+		statistics.RepeatedVsyncs += shownVsync - lastShownVsync - 1;
+		double interval = submitTime - lastSubmitTime;
+		intervalCount++;
+		intervalSum += interval;
+		intervalSquareSum += interval * interval;
+	}
+	hasShownFrame = true;
+	lastShownVsync = shownVsync;
+	lastSubmitTime = submitTime;
+	return onTime;
+}
+
+void FramePacer::Synchronize(double vsyncTime) {
+	double vsyncs = std::floor((vsyncTime - settings.VsyncOrigin) / period + 0.5);
+	settings.VsyncOrigin = vsyncTime - vsyncs * period;
+}
+
+void FramePacer::Reset() {
+	std::memset(&frame, 0, sizeof(frame));
+	hasShownFrame = false;
+	lastShownVsync = 0;
+	smoothedFrameTime = 0.0;
+	hasFrameTime = false;
+	lastSubmitTime = 0.0;
+	intervalCount = 0;
+	intervalSum = 0.0;
+	intervalSquareSum = 0.0;
+	std::memset(&statistics, 0, sizeof(statistics));
+}
+
+double FramePacer::GetVsyncTime(unsigned long long vsync) const {
+	return settings.VsyncOrigin + vsync * period;
+}
+
+double FramePacer::GetSmoothedFrameTime() const {
+	return smoothedFrameTime;
+}
+
+double FramePacer::GetJitter() const {
+	if (intervalCount == 0) {
+		return 0.0;
+	}
+	double mean = intervalSum / intervalCount;
+	return std::sqrt(std::max(0.0, intervalSquareSum / intervalCount - mean * mean));
+}
+
+const FramePacer::Statistics& FramePacer::GetStatistics() const {
+	return statistics;
+}
+
+const FramePacer::Settings& FramePacer::GetSettings() const {
+	return settings;
+}
+
+unsigned long long FramePacer::GetFirstVsync(double time) const {
+	double vsync = std::ceil((time + settings.SubmitMargin - settings.VsyncOrigin) / period);
+	return vsync > 0.0 ? static_cast<unsigned long long>(vsync) : 0;
+}
+
+double FramePacer::GetStartTime(unsigned long long vsync, double now) const {
+	// At the vsync before, or at once if the frame wouldn't make it from there.
+	double previousVsyncTime = GetVsyncTime(vsync) - period;
+	if (previousVsyncTime + smoothedFrameTime > GetVsyncTime(vsync) - settings.SubmitMargin) {
+		return now;
+	}
+	return std::max(now, previousVsyncTime);
+}
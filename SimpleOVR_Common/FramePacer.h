@@ -0,0 +1,139 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#pragma once
+
+/*
+	Decides which vsync each frame is aimed at and keeps count of how well the frames make it.
+
+	Vsync N comes at VsyncOrigin + N / RefreshRate. A frame aimed at it is shown from then on if it
+	is submitted at least SubmitMargin earlier, the time the HMD needs for distortion and timewarp;
+	that is its deadline. Every frame is aimed at a later vsync than the one the frame before was
+	shown at, and doesn't start before the vsync before its own (PacedFrame::StartTime), unless it
+	takes longer than that to draw: a loop that runs ahead waits instead of queueing up frames that
+	would only be older by the time they are shown.
+
+	What becomes of a frame that starts too late to make the next vsync, judging by how long the
+	last frames took (a moving average), is up to the policy:
+
+		LateFramePolicy_Reproject aims it at the next vsync anyway. When it misses, the HMD shows
+		it at the first vsync it does make, reprojected to the newer pose by timewarp. When the estimate was too
+		pessimistic it still makes it, with the least latency.
+
+		LateFramePolicy_Drop gives that vsync up and aims the frame at the first one it can make,
+		so it is drawn for when it will actually be seen. The HMD repeats the previous frame,
+		reprojected, at the vsyncs given up.
+
+	Any frame that misses its deadline is shown late and reprojected, whatever the policy. Jitter
+	is the standard deviation of the time between frames being submitted.
+
+	Like ResolutionController nothing here reads a clock, the times are passed in, so any trace
+	of frame times can be run through it. See FrameScheduler for the loop around it.
+*/
+enum LateFramePolicy {
+	LateFramePolicy_Reproject,
+	LateFramePolicy_Drop,
+	LateFramePolicyCount
+};
+
+// "reproject" and "drop".
+const char* GetLateFramePolicyName(LateFramePolicy policy);
+
+// Returns false if there is no policy by that name.
+bool FindLateFramePolicy(const char* name, LateFramePolicy& outPolicy);
+
+struct PacedFrame {
+	unsigned long long Vsync; // The one the frame is aimed at
+	double VsyncTime;
+	double Deadline;
+	double StartTime; // Don't start drawing before this
+};
+
+class FramePacer {
+public:
+	struct Settings {
+		double RefreshRate; // Hz
+		double VsyncOrigin; // Seconds, time of vsync 0
+		double SubmitMargin; // Seconds
+		LateFramePolicy Policy;
+		float Smoothing; // Weight of the newest frame time in the moving average, 0 to 1
+	};
+
+	struct Statistics {
+		unsigned long long Frames;
+		unsigned long long MissedDeadlines; // Frames shown late, reprojected
+		unsigned long long DroppedVsyncs; // Given up in advance by LateFramePolicy_Drop
+		unsigned long long RepeatedVsyncs; // That showed no new frame, for whatever reason
+	};
+
+	// Settings for a refresh rate in Hz, starting at time 0, with LateFramePolicy_Reproject.
+	static Settings GetDefaultSettings(double refreshRate);
+
+	// The first with the default settings for ResolutionController::DefaultRefreshRate.
+	FramePacer();
+	explicit FramePacer(const Settings& settings);
+
+	// Picks the vsync of the frame starting now.
+	PacedFrame BeginFrame(double now);
+
+	// The frame begun last was submitted at submitTime. Returns whether it made its deadline.
+	bool EndFrame(double submitTime);
+
+	/*
+		Moves the vsyncs so that one of them comes at vsyncTime, when the display's own timing is
+		known. The nearest keeps its number, so it can be called any time to follow the display's
+		clock drifting away from ours.
+	*/
+	void Synchronize(double vsyncTime);
+
+	// Forgets the frames so far, statistics included. The vsyncs stay where they are.
+	void Reset();
+
+	double GetVsyncTime(unsigned long long vsync) const;
+	double GetSmoothedFrameTime() const;
+	double GetJitter() const; // Seconds
+	const Statistics& GetStatistics() const;
+	const Settings& GetSettings() const;
+
+private:
+	// The first vsync whose deadline is not before time.
+	unsigned long long GetFirstVsync(double time) const;
+	double GetStartTime(unsigned long long vsync, double now) const;
+
+	Settings settings;
+	double period;
+	PacedFrame frame; // Begun last
+	bool hasShownFrame;
+	unsigned long long lastShownVsync;
+	double smoothedFrameTime;
+	bool hasFrameTime;
+	double lastSubmitTime;
+	unsigned long long intervalCount;
+	double intervalSum;
+	double intervalSquareSum;
+	Statistics statistics;
+};
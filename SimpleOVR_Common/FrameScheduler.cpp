@@ -0,0 +1,159 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#include "FrameScheduler.h"
+#include "Clock.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+namespace {
+	// Sleeps can overshoot by this much (the default timer resolution on Windows), so the rest of
+	// a wait is spent yielding.
+	const double SleepGranularity = 0.002;
+}
+
+double SystemPacingClock::GetTime() {
+	return GetTimeInSeconds();
+}
+
+void SystemPacingClock::WaitUntil(double time) {
+	for (double now = GetTime(); now < time; now = GetTime()) {
+		double remaining = time - now;
+		if (remaining > SleepGranularity) {
+			std::this_thread::sleep_for(std::chrono::microseconds(static_cast<long long>((remaining - SleepGranularity) * 1e6)));
+		}
+		else {
+			std::this_thread::yield();
+		}
+	}
+}
+
+FakeVsyncClock::FakeVsyncClock(double time) : time(time) {
+}
+
+double FakeVsyncClock::GetTime() {
+	std::lock_guard<std::mutex> lock(mutex);
+	return time;
+}
+
+void FakeVsyncClock::WaitUntil(double time) {
+	std::lock_guard<std::mutex> lock(mutex);
+	this->time = std::max(this->time, time);
+}
+
+void FakeVsyncClock::Advance(double seconds) {
+	std::lock_guard<std::mutex> lock(mutex);
+	time += seconds;
+}
+
+FrameScheduler::FrameScheduler(PacingClock& clock, const FramePacer::Settings& settings) :
+	clock(clock),
+	pacer(settings),
+	stopping(false)
+{
+	std::memset(&state, 0, sizeof(state));
+}
+
+FrameScheduler::~FrameScheduler() {
+	Stop();
+}
+
+void FrameScheduler::Start(const RenderFunction& render) {
+	this->render = render;
+	stopping = false;
+	Publish();
+	renderThread = std::thread(&FrameScheduler::RenderMain, this);
+}
+
+void FrameScheduler::RequestStop() {
+	stopping = true;
+}
+
+bool FrameScheduler::IsStopping() const {
+	return stopping;
+}
+
+void FrameScheduler::Stop() {
+	stopping = true;
+	if (renderThread.joinable()) {
+		renderThread.join();
+	}
+}
+
+SimulationState& FrameScheduler::GetState() {
+	return state;
+}
+
+void FrameScheduler::Publish() {
+	state.Time = clock.GetTime();
+	states.GetWriteBuffer() = state;
+	states.Publish();
+	state.Tick++;
+}
+
+void FrameScheduler::SynchronizeVsync(double vsyncTime) {
+	std::lock_guard<std::mutex> lock(pacerMutex);
+	pacer.Synchronize(vsyncTime);
+}
+
+FramePacer::Statistics FrameScheduler::GetStatistics() const {
+	std::lock_guard<std::mutex> lock(pacerMutex);
+	return pacer.GetStatistics();
+}
+
+double FrameScheduler::GetJitter() const {
+	std::lock_guard<std::mutex> lock(pacerMutex);
+	return pacer.GetJitter();
+}
+
+PacingClock& FrameScheduler::GetClock() {
+	return clock;
+}
+
+void FrameScheduler::RenderMain() {
+	while (!stopping) {
+		PacedFrame frame;
+		{
+			std::lock_guard<std::mutex> lock(pacerMutex);
+			frame = pacer.BeginFrame(clock.GetTime());
+		}
+		{
+			ScopedProfileTimer timer(ProfileStage_PacingWait);
+			clock.WaitUntil(frame.StartTime);
+		}
+
+		// The newest state, as late as possible.
+		states.Update();
+		double submitTime = render(states.GetReadBuffer(), frame);
+
+		std::lock_guard<std::mutex> lock(pacerMutex);
+		pacer.EndFrame(submitTime);
+	}
+	Profiler::ReleaseThread();
+}
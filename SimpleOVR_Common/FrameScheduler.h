@@ -0,0 +1,147 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#pragma once
+
+#include "FramePacer.h"
+#include "TripleBuffer.h"
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+/*
+	Where a paced loop gets the time from and how it waits, in seconds. SystemPacingClock is the
+	real thing. FakeVsyncClock only moves when told to, or when waited on, so a paced loop can be
+	run with made-up frame times, much faster than real time and the same way every run.
+*/
+class PacingClock {
+public:
+	virtual ~PacingClock() {}
+
+	virtual double GetTime() = 0;
+
+	// Returns at once if time has passed.
+	virtual void WaitUntil(double time) = 0;
+};
+
+// GetTimeInSeconds. Sleeps most of the wait and yields the last bit, sleeps are coarse on Windows.
+class SystemPacingClock : public PacingClock {
+public:
+	double GetTime();
+	void WaitUntil(double time);
+};
+
+// Waiting jumps straight to the time waited for. May be shared between threads.
+class FakeVsyncClock : public PacingClock {
+public:
+	explicit FakeVsyncClock(double time);
+
+	double GetTime();
+	void WaitUntil(double time);
+
+	// What drawing a frame would have taken.
+	void Advance(double seconds);
+
+private:
+	std::mutex mutex;
+	double time;
+};
+
+// What the input/simulation thread hands the render thread.
+struct SimulationState {
+	unsigned long long Tick; // States published before this one
+	double Time; // When it was published, by the scheduler's clock
+
+	// Requests made so far. Counted, so none is lost when the render thread skips states.
+	unsigned int RecenterRequests;
+	unsigned int ProfileRequests;
+};
+
+/*
+	Runs a frame loop paced by a FramePacer on a render thread of its own, while the thread that
+	started it handles input and simulation, so neither holds the other up.
+
+	The input/simulation thread fills in SimulationStates and publishes them through a
+	TripleBuffer. The render thread has the pacer pick the next frame's vsync, waits for the
+	frame's start time, and only then takes the newest state, never waiting for one: handling a
+	slow message (a recenter, say) only delays the states, not the frames, and a render thread
+	that falls behind skips states instead of queueing them up.
+
+	The render function draws and submits a frame and returns when it was submitted, by the
+	scheduler's clock; that is what the frame's deadline is checked against, as submitting may
+	block until vsync afterwards.
+
+	The statistics and synchronizing the vsyncs are safe from either thread.
+*/
+class FrameScheduler {
+public:
+	typedef std::function<double(const SimulationState& state, const PacedFrame& frame)> RenderFunction;
+
+	FrameScheduler(PacingClock& clock, const FramePacer::Settings& settings);
+
+	// Stops the render thread.
+	~FrameScheduler();
+
+	// Publishes the state as it is and starts the render thread.
+	void Start(const RenderFunction& render);
+
+	// The render thread stops after the frame it is drawing. Callable from the render function.
+	void RequestStop();
+	bool IsStopping() const;
+
+	// Requests a stop and waits for the render thread to finish. Not from the render function.
+	void Stop();
+
+	// Input/simulation thread only. The state to change and publish next, as published last.
+	SimulationState& GetState();
+
+	// Stamps the state with its tick and the time, and hands it to the render thread.
+	void Publish();
+
+	// See FramePacer::Synchronize.
+	void SynchronizeVsync(double vsyncTime);
+
+	FramePacer::Statistics GetStatistics() const;
+	double GetJitter() const;
+	PacingClock& GetClock();
+
+private:
+	FrameScheduler(const FrameScheduler&);
+	FrameScheduler& operator=(const FrameScheduler&);
+
+	void RenderMain();
+
+	PacingClock& clock;
+	mutable std::mutex pacerMutex;
+	FramePacer pacer;
+	SimulationState state;
+	TripleBuffer<SimulationState> states;
+	RenderFunction render;
+	std::thread renderThread;
+	std::atomic<bool> stopping;
+};
@@ -0,0 +1,166 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#include "HiddenArea.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+	// A point of a distortion triangle: its vignette in 255ths, as the packed vertex has it, and
+	// the tangents each color looks up, all of which the rasterizer interpolates linearly.
+	struct Lookup {
+		float Vignette;
+		float Tan[3][2];
+	};
+
+	// Below half a 255th the vignette scales any color to 0 in an 8 bit display.
+	const float HiddenVignette = 0.5f;
+
+	Lookup GetLookup(const DistortionPoint& point) {
+		Lookup lookup;
+		lookup.Vignette = std::floor(point.Vignette * 255.0f + 0.5f);
+		for (int color = 0; color < 3; color++) {
+			lookup.Tan[color][0] = point.TanEyeAngles[color][0];
+			lookup.Tan[color][1] = point.TanEyeAngles[color][1];
+		}
+		return lookup;
+	}
+
+	Lookup Interpolate(const Lookup& a, const Lookup& b, float t) {
+		Lookup lookup;
+		lookup.Vignette = a.Vignette + (b.Vignette - a.Vignette) * t;
+		for (int color = 0; color < 3; color++) {
+			for (int axis = 0; axis < 2; axis++) {
+				lookup.Tan[color][axis] = a.Tan[color][axis] + (b.Tan[color][axis] - a.Tan[color][axis]) * t;
+			}
+		}
+		return lookup;
+	}
+
+	// Cuts off the part of a triangle vignetted below HiddenVignette, leaving up to 4 corners.
+	int ClipVisible(const Lookup corners[3], Lookup outCorners[4]) {
+		int count = 0;
+		for (int i = 0; i < 3; i++) {
+			const Lookup& a = corners[i];
+			const Lookup& b = corners[(i + 1) % 3];
+			bool aVisible = a.Vignette >= HiddenVignette;
+			bool bVisible = b.Vignette >= HiddenVignette;
+			if (aVisible) {
+				outCorners[count++] = a;
+			}
+			if (aVisible != bVisible) {
+				outCorners[count++] = Interpolate(a, b, (HiddenVignette - a.Vignette) / (b.Vignette - a.Vignette));
+			}
+		}
+		return count;
+	}
+
+	// The cell a coordinate of the eye's NDC is in, along an axis of count cells.
+	int GetCell(float ndc, int count) {
+		int cell = static_cast<int>(std::floor((ndc + 1.0f) * 0.5f * count));
+		return std::max(0, std::min(count - 1, cell));
+	}
+}
+
+void GenerateHiddenAreaMesh(const std::vector<DistortionPoint>& points, const std::vector<unsigned short>& indices, const FovPort& fov, HiddenAreaMesh& outMesh) {
+	// A tangent's NDC in the eye's projection, as in ComputeDistortionConstants.
+	float xScale = 2.0f / (fov.LeftTan + fov.RightTan);
+	float xOffset = (fov.LeftTan - fov.RightTan) * xScale * 0.5f;
+	float yScale = 2.0f / (fov.UpTan + fov.DownTan);
+	float yOffset = (fov.UpTan - fov.DownTan) * yScale * 0.5f;
+
+	// Rows counted from the bottom here, like NDC.
+	std::vector<unsigned char> seen(HiddenAreaColumns * HiddenAreaRows, 0);
+	for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+		Lookup corners[3] = { GetLookup(points[indices[i]]), GetLookup(points[indices[i + 1]]), GetLookup(points[indices[i + 2]]) };
+		Lookup visible[4];
+		int visibleCount = ClipVisible(corners, visible);
+		if (visibleCount == 0) {
+			continue;
+		}
+		float minTan[2] = { visible[0].Tan[0][0], visible[0].Tan[0][1] };
+		float maxTan[2] = { minTan[0], minTan[1] };
+		for (int corner = 0; corner < visibleCount; corner++) {
+			for (int color = 0; color < 3; color++) {
+				for (int axis = 0; axis < 2; axis++) {
+					minTan[axis] = std::min(minTan[axis], visible[corner].Tan[color][axis]);
+					maxTan[axis] = std::max(maxTan[axis], visible[corner].Tan[color][axis]);
+				}
+			}
+		}
+
+		// Lookups beyond the viewport mark the cells along its edge.
+		int left = GetCell((minTan[0] - HiddenAreaMargin) * xScale + xOffset, HiddenAreaColumns);
+		int right = GetCell((maxTan[0] + HiddenAreaMargin) * xScale + xOffset, HiddenAreaColumns);
+		int bottom = GetCell((minTan[1] - HiddenAreaMargin) * yScale + yOffset, HiddenAreaRows);
+		int top = GetCell((maxTan[1] + HiddenAreaMargin) * yScale + yOffset, HiddenAreaRows);
+		for (int row = bottom; row <= top; row++) {
+			std::fill(&seen[row * HiddenAreaColumns + left], &seen[row * HiddenAreaColumns + right] + 1, 1);
+		}
+	}
+
+	outMesh.Rects.clear();
+	for (int row = 0; row < HiddenAreaRows; row++) {
+		int column = 0;
+		while (column < HiddenAreaColumns) {
+			if (seen[row * HiddenAreaColumns + column] != 0) {
+				column++;
+				continue;
+			}
+			int end = column + 1;
+			while (end < HiddenAreaColumns && seen[row * HiddenAreaColumns + end] == 0) {
+				end++;
+			}
+			HiddenAreaRect rect;
+			rect.Ndc[0] = 2.0f * column / HiddenAreaColumns - 1.0f;
+			rect.Ndc[1] = 2.0f * end / HiddenAreaColumns - 1.0f;
+			rect.Ndc[2] = 2.0f * row / HiddenAreaRows - 1.0f;
+			rect.Ndc[3] = 2.0f * (row + 1) / HiddenAreaRows - 1.0f;
+			outMesh.Rects.push_back(rect);
+			column = end;
+		}
+	}
+}
+
+float GetHiddenAreaFraction(const HiddenAreaMesh& mesh) {
+	float area = 0.0f;
+	for (size_t i = 0; i < mesh.Rects.size(); i++) {
+		const float* ndc = mesh.Rects[i].Ndc;
+		area += (ndc[1] - ndc[0]) * (ndc[3] - ndc[2]);
+	}
+	return area * 0.25f;
+}
+
+Rect2i GetHiddenAreaPixels(const HiddenAreaRect& rect, const Rect2i& viewport) {
+	// Pixel centers on the left and top edges are in, on the right and bottom edges out.
+	int left = viewport.Pos.x + static_cast<int>(std::ceil((rect.Ndc[0] + 1.0f) * 0.5f * viewport.Size.w - 0.5f));
+	int right = viewport.Pos.x + static_cast<int>(std::ceil((rect.Ndc[1] + 1.0f) * 0.5f * viewport.Size.w - 0.5f));
+	int top = viewport.Pos.y + static_cast<int>(std::ceil((1.0f - rect.Ndc[3]) * 0.5f * viewport.Size.h - 0.5f));
+	int bottom = viewport.Pos.y + static_cast<int>(std::ceil((1.0f - rect.Ndc[2]) * 0.5f * viewport.Size.h - 0.5f));
+	Rect2i pixels = { { left, top }, { std::max(0, right - left), std::max(0, bottom - top) } };
+	return pixels;
+}
@@ -0,0 +1,71 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#pragma once
+
+#include "Distortion.h"
+#include "VrTypes.h"
+#include <vector>
+
+/*
+	Hidden area masks. The distortion only looks up the part of each eye's view the lens shows,
+	and the corners of the eye's viewport are never seen, so whatever is drawn there is wasted.
+	The mask covers those parts: the device writes it into the depth buffer at the near plane
+	before the scene is drawn, so the scene's pixels there fail the depth test before they are
+	shaded, and leaves them out of the clears where it can.
+
+	The mask is made from the eye's distortion mesh. The eye's viewport is split into a grid of
+	HiddenAreaColumns by HiddenAreaRows cells, and a cell is hidden if no triangle of the mesh
+	looks up any of its colors in it. The parts of triangles vignetted to black don't count, what
+	they show doesn't depend on the eye texture. Each triangle's lookups are widened
+	by HiddenAreaMargin, enough for the bilinear footprint and for the head turning about 3
+	degrees between drawing the eye and timewarp. The hidden cells of a row are merged into
+	rectangles, which the device draws as two triangles each.
+
+	It is in the eye's NDC, so it fits the viewport at any resolution scale.
+*/
+
+const int HiddenAreaColumns = 64;
+const int HiddenAreaRows = 64;
+const float HiddenAreaMargin = 0.05f; // Added to the tangents of each triangle's lookups
+
+struct HiddenAreaRect {
+	float Ndc[4]; // Left, right, bottom and top in the eye's NDC
+};
+
+struct HiddenAreaMesh {
+	std::vector<HiddenAreaRect> Rects;
+};
+
+// The hidden area of an eye drawn at fov, from its distortion mesh as Hmd::GetDistortionMesh makes it.
+void GenerateHiddenAreaMesh(const std::vector<DistortionPoint>& points, const std::vector<unsigned short>& indices, const FovPort& fov, HiddenAreaMesh& outMesh);
+
+// The fraction of the eye's viewport the mesh covers.
+float GetHiddenAreaFraction(const HiddenAreaMesh& mesh);
+
+// The pixels of viewport whose centers a rectangle of the mesh covers, as a GPU would draw it.
+Rect2i GetHiddenAreaPixels(const HiddenAreaRect& rect, const Rect2i& viewport);
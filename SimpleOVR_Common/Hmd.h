@@ -0,0 +1,79 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#pragma once
+
+#include "Distortion.h"
+#include "VrTypes.h"
+#include <vector>
+
+/*
+	The parts of an HMD the frame loop talks to. OvrHmd (SimpleOVR_D3D11) implements it on top of
+	LibOVR, SimulatedHmd implements it without any hardware.
+
+	Frame indices follow the LibOVR convention: passing 0 lets the HMD keep its own counter.
+*/
+class Hmd {
+public:
+	virtual ~Hmd() {}
+
+	virtual Size2i GetResolution() const = 0;
+	virtual double GetRefreshRate() const = 0; // Hz
+	virtual FovPort GetDefaultEyeFov(int eye) const = 0;
+
+	// The HMD might want us to render each eye in a specific order for best result.
+	virtual int GetEyeRenderOrder(int index) const = 0;
+
+	// Same as ovrHmd_GetFovTextureSize.
+	virtual Size2i GetFovTextureSize(int eye, const FovPort& fov, float pixelsPerDisplayPixel) const = 0;
+
+	// Only valid once rendering has been configured.
+	virtual EyeRenderDesc GetEyeRenderDesc(int eye) const = 0;
+
+	// The part of the eye texture an eye was drawn to, for the frames ended from now on.
+	virtual void SetEyeRenderViewport(int eye, const Rect2i& viewport) = 0;
+
+	// An eye's distortion mesh for the application to distort the frames itself, see
+	// Distortion.h. Returns false if the HMD doesn't have one.
+	virtual bool GetDistortionMesh(int eye, const FovPort& fov, std::vector<DistortionPoint>& outPoints, std::vector<unsigned short>& outIndices) const = 0;
+
+	virtual void RecenterPose() = 0;
+
+	virtual void BeginFrame(unsigned int frameIndex) = 0;
+
+	// Of the frame begun last.
+	virtual FrameTiming GetFrameTiming() const = 0;
+
+	// The eye poses predicted for when the frame will be seen, by the HMD's own prediction.
+	virtual void GetEyePoses(unsigned int frameIndex, const Vector3 hmdToEyeViewOffset[EyeCount], Pose outEyePoses[EyeCount]) = 0;
+
+	// The head as tracked right now, recentered like the eye poses. Not predicted any further.
+	virtual PoseState GetTrackingState() = 0;
+
+	// Finishes the frame and sends it to the display. May block until vsync.
+	virtual void EndFrame(const Pose renderPose[EyeCount]) = 0;
+};
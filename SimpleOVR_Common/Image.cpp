@@ -0,0 +1,108 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+
+#include "Image.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+bool WriteImage(const Image& image, const char* path) {
+	FILE* file = std::fopen(path, "wb");
+	if (file == nullptr) {
+		return false;
+	}
+
+	std::fprintf(file, "P6\n%d %d\n255\n", image.Size.w, image.Size.h);
+	std::vector<unsigned char> row(image.Size.w * 3);
+	for (int y = 0; y < image.Size.h; y++) {
+		for (int x = 0; x < image.Size.w; x++) {
+			unsigned int pixel = image.Pixels[y * image.Size.w + x];
+			row[x * 3] = static_cast<unsigned char>(pixel);
+			row[x * 3 + 1] = static_cast<unsigned char>(pixel >> 8);
+			row[x * 3 + 2] = static_cast<unsigned char>(pixel >> 16);
+		}
+		std::fwrite(row.data(), 1, row.size(), file);
+	}
+	bool written = std::ferror(file) == 0;
+	std::fclose(file);
+	return written;
+}
+
+bool ReadImage(const char* path, Image& outImage) {
+	FILE* file = std::fopen(path, "rb");
+	if (file == nullptr) {
+		return false;
+	}
+
+	// Only what WriteImage writes: no comments, 8 bits per channel.
+	int width;
+	int height;
+	int maxValue;
+	if (std::fscanf(file, "P6 %d %d %d", &width, &height, &maxValue) != 3 || maxValue != 255 ||
+		width <= 0 || height <= 0 || std::fgetc(file) == EOF) {
+		std::fclose(file);
+		return false;
+	}
+
+	outImage.Size.w = width;
+	outImage.Size.h = height;
+	outImage.Pixels.resize(width * height);
+	std::vector<unsigned char> row(width * 3);
+	bool complete = true;
+	for (int y = 0; y < height && complete; y++) {
+		complete = std::fread(row.data(), 1, row.size(), file) == row.size();
+		for (int x = 0; x < width; x++) {
+			outImage.Pixels[y * width + x] = row[x * 3] | (row[x * 3 + 1] << 8) | (row[x * 3 + 2] << 16) | 0xff000000u;
+		}
+	}
+	std::fclose(file);
+	return complete;
+}
+
+ImageDifference CompareImages(const Image& a, const Image& b, int channelTolerance) {
+	ImageDifference difference = { 0, 0 };
+	if (a.Size.w != b.Size.w || a.Size.h != b.Size.h) {
+		difference.DifferentPixels = static_cast<unsigned long long>(a.Size.w) * a.Size.h + static_cast<unsigned long long>(b.Size.w) * b.Size.h;
+		difference.MaxChannelDifference = 255;
+		return difference;
+	}
+
+	// The alpha channel isn't saved, so it isn't compared either.
+	for (size_t i = 0; i < a.Pixels.size(); i++) {
+		int pixelDifference = 0;
+		for (int shift = 0; shift < 24; shift += 8) {
+			int channelDifference = std::abs(static_cast<int>((a.Pixels[i] >> shift) & 0xff) - static_cast<int>((b.Pixels[i] >> shift) & 0xff));
+			pixelDifference = std::max(pixelDifference, channelDifference);
+		}
+		if (pixelDifference > channelTolerance) {
+			difference.DifferentPixels++;
+		}
+		difference.MaxChannelDifference = std::max(difference.MaxChannelDifference, pixelDifference);
+	}
+	return difference;
+}
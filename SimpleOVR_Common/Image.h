@@ -0,0 +1,52 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+
+#pragma once
+
+#include "VrTypes.h"
+#include <vector>
+
+/*
+	An RGBA image with 8 bits per channel, red in the lowest byte of each pixel, rows from the top.
+	Saved as binary PPM, which anything can view and needs no library, without the alpha channel.
+*/
+struct Image {
+	Size2i Size;
+	std::vector<unsigned int> Pixels;
+};
+
+struct ImageDifference {
+	unsigned long long DifferentPixels; // Pixels with any channel off by more than the tolerance
+	int MaxChannelDifference;
+};
+
+bool WriteImage(const Image& image, const char* path);
+bool ReadImage(const char* path, Image& outImage);
+
+// Images of different sizes differ in every pixel.
+ImageDifference CompareImages(const Image& a, const Image& b, int channelTolerance);
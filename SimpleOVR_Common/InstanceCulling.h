@@ -0,0 +1,45 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#pragma once
+
+#include "Culling.h"
+#include "RenderDevice.h"
+
+/*
+	The cull of GPU driven drawing (see RenderDevice::SetSceneInstances) on the CPU: what the
+	D3D11 cull shader does, one instance after the other. NullRenderDevice culls with it.
+
+	draws start out as the mesh draws given to SetSceneInstances. Every instance whose bounds are
+	at least partly inside the frustum is listed in outVisible at its mesh draw's
+	StartInstanceLocation plus the number of the mesh's instances listed before it, and adds
+	instanceMultiplier to the draw's InstanceCount. Instances of meshes with no vertices to draw
+	are skipped. The GPU lists a mesh's instances in whatever order its threads get there, here
+	they are in order. Returns the number of visible instances.
+*/
+unsigned int CullInstances(const Frustum& frustum, const SceneInstance* instances, unsigned int instanceCount, unsigned int instanceMultiplier,
+	IndirectDrawArgs* draws, unsigned int* outVisible);
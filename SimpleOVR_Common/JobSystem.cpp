@@ -0,0 +1,192 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+
+#include "JobSystem.h"
+#include "Profiler.h"
+
+namespace {
+	// How long a thread polls before going to sleep. Frames start ParallelFor several times in
+	// quick succession, waking a sleeping thread takes a lot longer than that.
+	const int SpinCount = 2000;
+}
+
+JobSystem::JobSystem(int threadCount) :
+	threadCount(threadCount < 1 ? 1 : threadCount),
+	shares(nullptr),
+	currentJob(nullptr),
+	generation(0),
+	busyWorkers(0),
+	quitting(false)
+{
+	shares = new Share[this->threadCount];
+	for (int thread = 0; thread < this->threadCount; thread++) {
+		shares[thread].Begin = 0;
+		shares[thread].End = 0;
+	}
+	for (int thread = 1; thread < this->threadCount; thread++) {
+		workers.push_back(std::thread(&JobSystem::WorkerMain, this, thread));
+	}
+}
+
+JobSystem::~JobSystem() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		quitting = true;
+		generation++;
+	}
+	wakeCondition.notify_all();
+	for (size_t i = 0; i < workers.size(); i++) {
+		workers[i].join();
+	}
+	delete[] shares;
+}
+
+int JobSystem::GetThreadCount() const {
+	return threadCount;
+}
+
+void JobSystem::ParallelFor(unsigned int count, const Job& job) {
+	if (threadCount == 1 || count <= 1) {
+		for (unsigned int i = 0; i < count; i++) {
+			job(i, 0);
+		}
+		return;
+	}
+
+	// Nobody is running, so the shares can be set up without locking.
+	for (int thread = 0; thread < threadCount; thread++) {
+		shares[thread].Begin = static_cast<unsigned int>(static_cast<unsigned long long>(count) * thread / threadCount);
+		shares[thread].End = static_cast<unsigned int>(static_cast<unsigned long long>(count) * (thread + 1) / threadCount);
+	}
+	currentJob = &job;
+	busyWorkers.store(threadCount - 1);
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		generation++;
+	}
+	wakeCondition.notify_all();
+
+	RunJobs(0);
+
+	// Every worker has to be out of RunJobs before the shares can be reused.
+	for (int spin = 0; spin < SpinCount && busyWorkers.load() != 0; spin++) {
+		std::this_thread::yield();
+	}
+	if (busyWorkers.load() != 0) {
+		std::unique_lock<std::mutex> lock(mutex);
+		while (busyWorkers.load() != 0) {
+			doneCondition.wait(lock);
+		}
+	}
+	currentJob = nullptr;
+}
+
+int JobSystem::GetHardwareThreadCount() {
+	unsigned int count = std::thread::hardware_concurrency();
+	return count > 0 ? static_cast<int>(count) : 1;
+}
+
+void JobSystem::WorkerMain(int thread) {
+	unsigned int seenGeneration = 0;
+	for (;;) {
+		for (int spin = 0; spin < SpinCount && generation.load() == seenGeneration; spin++) {
+			std::this_thread::yield();
+		}
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			while (generation.load() == seenGeneration) {
+				wakeCondition.wait(lock);
+			}
+			seenGeneration = generation.load();
+			if (quitting) {
+				Profiler::ReleaseThread();
+				return;
+			}
+		}
+
+		RunJobs(thread);
+
+		if (busyWorkers.fetch_sub(1) == 1) {
+			// Taking the lock makes sure ParallelFor is either not waiting yet or already waiting.
+			std::lock_guard<std::mutex> lock(mutex);
+			doneCondition.notify_one();
+		}
+	}
+}
+
+void JobSystem::RunJobs(int thread) {
+	const Job& job = *currentJob;
+	unsigned int index;
+	for (;;) {
+		while (TakeIndex(thread, index)) {
+			job(index, thread);
+		}
+		if (!Steal(thread)) {
+			return;
+		}
+	}
+}
+
+bool JobSystem::TakeIndex(int thread, unsigned int& outIndex) {
+	Share& share = shares[thread];
+	std::lock_guard<std::mutex> lock(share.Mutex);
+	if (share.Begin == share.End) {
+		return false;
+	}
+	outIndex = share.Begin++;
+	return true;
+}
+
+/*
+	Moves the back half of another thread's share into this thread's (empty) one. Returns false if
+	every other share was empty. A range being moved by another thief is not visible in any share
+	for a moment, but then that thief runs it, so giving up is still correct.
+*/
+bool JobSystem::Steal(int thread) {
+	for (int i = 1; i < threadCount; i++) {
+		Share& victim = shares[(thread + i) % threadCount];
+		unsigned int begin, end;
+		{
+			std::lock_guard<std::mutex> lock(victim.Mutex);
+			unsigned int left = victim.End - victim.Begin;
+			if (left == 0) {
+				continue;
+			}
+			end = victim.End;
+			begin = victim.End - (left + 1) / 2;
+			victim.End = begin;
+		}
+
+		Share& share = shares[thread];
+		std::lock_guard<std::mutex> lock(share.Mutex);
+		share.Begin = begin;
+		share.End = end;
+		return true;
+	}
+	return false;
+}
@@ -0,0 +1,95 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+	A fixed set of worker threads running parallel loops.
+
+	ParallelFor hands out the indices of a loop in equal shares, one per thread, the calling
+	thread included. Each thread runs through its own share from the front, and once it's out of
+	work steals the back half of what another thread has left. A few slow jobs therefore don't
+	leave the other threads idle, while threads with work of their own rarely touch each other's
+	shares. Every index is run exactly once and ParallelFor returns when all of them are done.
+
+	Jobs must not call ParallelFor themselves.
+*/
+class JobSystem {
+public:
+	typedef std::function<void(unsigned int index, int thread)> Job;
+
+	// threadCount includes the thread calling ParallelFor. With 1 everything runs on that thread.
+	explicit JobSystem(int threadCount);
+	~JobSystem();
+
+	int GetThreadCount() const;
+
+	// Runs job for every index below count. thread is 0 for the calling thread and up to
+	// GetThreadCount() - 1 for the workers, so it can index per-thread scratch data.
+	void ParallelFor(unsigned int count, const Job& job);
+
+	// What std::thread::hardware_concurrency reports, at least 1.
+	static int GetHardwareThreadCount();
+
+private:
+	JobSystem(const JobSystem&);
+	JobSystem& operator=(const JobSystem&);
+
+	// The indices a thread has left, [Begin, End). Padded to keep the shares on separate cache lines.
+	struct Share {
+		std::mutex Mutex;
+		unsigned int Begin;
+		unsigned int End;
+		char Padding[64];
+	};
+
+	void WorkerMain(int thread);
+	void RunJobs(int thread);
+	bool TakeIndex(int thread, unsigned int& outIndex);
+	bool Steal(int thread);
+
+	int threadCount;
+	std::vector<std::thread> workers;
+	Share* shares;
+	const Job* currentJob;
+
+	// Workers wait for generation to change, ParallelFor waits for busyWorkers to reach 0.
+	std::mutex mutex;
+	std::condition_variable wakeCondition;
+	std::condition_variable doneCondition;
+	std::atomic<unsigned int> generation;
+	std::atomic<int> busyWorkers;
+	bool quitting;
+};
@@ -0,0 +1,143 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#include "LatencyHistogram.h"
+#include <algorithm>
+
+namespace {
+	const int SubBucketBits = 5;
+	const int SubBucketCount = 1 << SubBucketBits;
+	const int LinearLimit = SubBucketCount * 2;
+	const int MaxExponent = 40;
+	const int BucketCount = (MaxExponent - SubBucketBits + 2) * SubBucketCount;
+
+	int MostSignificantBit(unsigned long long value) {
+		int bit = 0;
+		while (value >>= 1) {
+			bit++;
+		}
+		return bit;
+	}
+}
+
+LatencyHistogram::LatencyHistogram() : buckets(BucketCount) {
+	Reset();
+}
+
+int LatencyHistogram::GetBucketIndex(unsigned long long nanoseconds) {
+	if (nanoseconds < LinearLimit) {
+		return static_cast<int>(nanoseconds);
+	}
+	int shift = MostSignificantBit(nanoseconds) - SubBucketBits;
+	int index = (shift + 1) * SubBucketCount + static_cast<int>((nanoseconds >> shift) - SubBucketCount);
+	return std::min(index, BucketCount - 1);
+}
+
+unsigned long long LatencyHistogram::GetBucketLowerBound(int bucket) {
+	if (bucket < LinearLimit) {
+		return bucket;
+	}
+	int shift = bucket / SubBucketCount - 1;
+	unsigned long long subBucket = bucket % SubBucketCount + SubBucketCount;
+	return subBucket << shift;
+}
+
+unsigned long long LatencyHistogram::GetBucketUpperBound(int bucket) {
+	if (bucket < LinearLimit) {
+		return bucket;
+	}
+	int shift = bucket / SubBucketCount - 1;
+	unsigned long long subBucket = bucket % SubBucketCount + SubBucketCount;
+	return ((subBucket + 1) << shift) - 1;
+}
+
+void LatencyHistogram::Add(unsigned long long nanoseconds) {
+	buckets[GetBucketIndex(nanoseconds)]++;
+	count++;
+	min = std::min(min, nanoseconds);
+	max = std::max(max, nanoseconds);
+	sum += static_cast<double>(nanoseconds);
+}
+
+void LatencyHistogram::Merge(const LatencyHistogram& other) {
+	for (int i = 0; i < BucketCount; i++) {
+		buckets[i] += other.buckets[i];
+	}
+	count += other.count;
+	min = std::min(min, other.min);
+	max = std::max(max, other.max);
+	sum += other.sum;
+}
+
+void LatencyHistogram::Reset() {
+	std::fill(buckets.begin(), buckets.end(), 0);
+	count = 0;
+	min = ~0ull;
+	max = 0;
+	sum = 0.0;
+}
+
+unsigned long long LatencyHistogram::GetCount() const {
+	return count;
+}
+
+unsigned long long LatencyHistogram::GetMin() const {
+	return count > 0 ? min : 0;
+}
+
+unsigned long long LatencyHistogram::GetMax() const {
+	return max;
+}
+
+double LatencyHistogram::GetMean() const {
+	return count > 0 ? sum / count : 0.0;
+}
+
+unsigned long long LatencyHistogram::GetPercentile(double fraction) const {
+	if (count == 0) {
+		return 0;
+	}
+	unsigned long long target = static_cast<unsigned long long>(fraction * count + 0.5);
+	target = std::max(1ull, std::min(target, count));
+
+	unsigned long long seen = 0;
+	for (int i = 0; i < BucketCount; i++) {
+		seen += buckets[i];
+		if (seen >= target) {
+			return std::min(GetBucketUpperBound(i), max);
+		}
+	}
+	return max;
+}
+
+int LatencyHistogram::GetBucketCount() const {
+	return BucketCount;
+}
+
+unsigned long long LatencyHistogram::GetBucketValueCount(int bucket) const {
+	return buckets[bucket];
+}
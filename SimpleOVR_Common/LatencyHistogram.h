@@ -0,0 +1,67 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#pragma once
+
+#include <vector>
+
+/*
+	Fixed-size histogram of durations in nanoseconds. Buckets are log-linear: exact below 64 ns,
+	after that every power of two is split into 32 buckets, so any recorded value is known within
+	about 3%. Adding a value never allocates and the whole histogram covers up to ~18 minutes.
+*/
+class LatencyHistogram {
+public:
+	LatencyHistogram();
+
+	void Add(unsigned long long nanoseconds);
+	void Merge(const LatencyHistogram& other);
+	void Reset();
+
+	unsigned long long GetCount() const;
+	unsigned long long GetMin() const;
+	unsigned long long GetMax() const;
+	double GetMean() const;
+
+	// Upper bound of the bucket holding the given fraction (0-1) of all values, clamped to the max.
+	unsigned long long GetPercentile(double fraction) const;
+
+	// For exporting the raw histogram. Buckets cover [GetBucketLowerBound(i), GetBucketUpperBound(i)].
+	int GetBucketCount() const;
+	unsigned long long GetBucketValueCount(int bucket) const;
+	static unsigned long long GetBucketLowerBound(int bucket);
+	static unsigned long long GetBucketUpperBound(int bucket);
+
+private:
+	static int GetBucketIndex(unsigned long long nanoseconds);
+
+	std::vector<unsigned long long> buckets;
+	unsigned long long count;
+	unsigned long long min;
+	unsigned long long max;
+	double sum;
+};
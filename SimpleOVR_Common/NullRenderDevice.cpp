@@ -0,0 +1,415 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#include "NullRenderDevice.h"
+#include "InstanceCulling.h"
+#include <algorithm>
+#include <cstring>
+
+NullRenderDevice::NullRenderDevice(Size2i eyeTextureSize, int multisampleCount) :
+	eyeTextureSize(eyeTextureSize),
+	multisampleCount(multisampleCount),
+	stereoMode(StereoMode_MultiPass),
+	material(0),
+	constantAllocator(ConstantRingAllocator::DefaultCapacity),
+	constantMemory(ConstantRingAllocator::DefaultCapacity),
+	constantFrame(0),
+	constantsMapped(false),
+	sceneVertexCount(0),
+	foveated(false),
+	fusedResolve(false),
+	distortionTexels(0),
+	hiddenAreaSet(false),
+	maskedPixelCount(0),
+	clearColor(false),
+	clearDepthStencil(false)
+{
+	for (int slot = 0; slot < ConstantSlotCount; slot++) {
+		boundConstants[slot] = constantMemory.data();
+	}
+	std::memset(latchedConstants, 0, sizeof(latchedConstants));
+	std::memset(&viewport, 0, sizeof(viewport));
+	std::memset(&colorClear, 0, sizeof(colorClear));
+	std::memset(&depthStencilClear, 0, sizeof(depthStencilClear));
+	std::memset(distortionConstants, 0, sizeof(distortionConstants));
+	std::memset(distortionTexelLookup, 0, sizeof(distortionTexelLookup));
+	std::memset(hiddenAreaViewports, 0, sizeof(hiddenAreaViewports));
+	std::memset(&statistics, 0, sizeof(statistics));
+	graphBackend.DeviceStatistics = &statistics;
+}
+
+Size2i NullRenderDevice::GetEyeTextureSize() const {
+	return eyeTextureSize;
+}
+
+int NullRenderDevice::GetMultisampleCount() const {
+	return multisampleCount;
+}
+
+void NullRenderDevice::ClearEyeTexture(const float color[4]) {
+	std::memcpy(colorClear.Color, color, sizeof(colorClear.Color));
+	clearColor = true;
+}
+
+void NullRenderDevice::ClearDepthStencil(float depth, unsigned char stencil) {
+	depthStencilClear.Depth = depth;
+	depthStencilClear.Stencil = stencil;
+	clearDepthStencil = true;
+}
+
+void NullRenderDevice::BindEyeTexture() {
+	DeclareEyeFrameGraph(eyeTextureSize, multisampleCount, foveated, fusedResolve, clearColor ? &colorClear : nullptr, clearDepthStencil ? &depthStencilClear : nullptr, graph);
+	graph.Compile();
+	clearColor = false;
+	clearDepthStencil = false;
+	graph.Execute(graphBackend, 0, graph.GetPassCommand(EyeGraphPass_Scene) + 1);
+
+	if (IsHiddenAreaMasked()) {
+		stateCache.Change(StateSlot_VertexShader, hiddenAreaMeshes);
+		for (int eye = 0; eye < EyeCount; eye++) {
+			stateCache.ChangeViewport(hiddenAreaViewports[eye]);
+			statistics.HiddenAreaDraws++;
+		}
+		statistics.MaskedPixels += maskedPixelCount;
+		stateCache.Change(StateSlot_VertexShader, nullptr, stereoMode);
+	}
+}
+
+void NullRenderDevice::SetViewport(const Rect2i& viewport) {
+	this->viewport = viewport;
+	statistics.ViewportChanges++;
+	stateCache.ChangeViewport(viewport);
+}
+
+void NullRenderDevice::SetStereoMode(StereoMode mode) {
+	stereoMode = mode;
+	stateCache.Change(StateSlot_VertexShader, nullptr, mode);
+}
+
+void NullRenderDevice::SetSceneVertices(const Vertex* vertices, unsigned int vertexCount) {
+	sceneVertexCount = vertexCount;
+}
+
+void NullRenderDevice::UploadSceneVertices(unsigned int firstVertex, const Vertex* vertices, unsigned int vertexCount) {
+	sceneVertexCount = std::max(sceneVertexCount, firstVertex + vertexCount);
+	statistics.Uploads++;
+	statistics.UploadBytes += vertexCount * sizeof(Vertex);
+}
+
+void NullRenderDevice::BeginConstants() {
+	constantAllocator.EndFrame();
+	constantFrame++;
+	if (constantFrame > SimulatedFramesInFlight) {
+		constantAllocator.RetireFrames(constantFrame - SimulatedFramesInFlight - 1);
+	}
+	constantAllocator.BeginFrame(constantFrame);
+	constantsMapped = true;
+	statistics.ConstantMaps++;
+}
+
+void* NullRenderDevice::AllocateConstants(unsigned int size, unsigned int& outOffset) {
+	// When the ring is full, "wait" for the GPU by retiring the oldest frame until it fits.
+	while (!constantAllocator.Allocate(size, outOffset)) {
+		if (constantAllocator.GetFramesInFlight() == 0) {
+			return nullptr;
+		}
+		constantAllocator.RetireFrames(constantAllocator.GetOldestFrameInFlight());
+	}
+	statistics.ConstantUpdates++;
+	statistics.ConstantBytes += size;
+	return constantMemory.data() + outOffset;
+}
+
+void NullRenderDevice::EndConstants() {
+	constantsMapped = false;
+}
+
+void NullRenderDevice::BindConstants(ConstantSlot slot, unsigned int offset, unsigned int size) {
+	boundConstants[slot] = constantMemory.data() + offset;
+	stateCache.Change(static_cast<StateSlot>(StateSlot_VertexConstants + slot), boundConstants[slot], size);
+}
+
+void NullRenderDevice::BindLatchedConstants(ConstantSlot slot, int part) {
+	boundConstants[slot] = latchedConstants[part];
+	stateCache.Change(static_cast<StateSlot>(StateSlot_VertexConstants + slot), boundConstants[slot]);
+}
+
+void NullRenderDevice::SetMaterial(int material) {
+	this->material = material;
+	stateCache.Change(StateSlot_PixelConstants, nullptr, material);
+}
+
+void NullRenderDevice::Draw(unsigned int vertexCount, unsigned int startVertex) {
+	statistics.MappedDraws += constantsMapped ? 1 : 0;
+	statistics.Draws++;
+	statistics.Instances++;
+	statistics.Vertices += vertexCount;
+}
+
+void NullRenderDevice::DrawInstanced(unsigned int vertexCount, unsigned int instanceCount, unsigned int startVertex) {
+	statistics.MappedDraws += constantsMapped ? 1 : 0;
+	statistics.Draws++;
+	statistics.Instances += instanceCount;
+	statistics.Vertices += vertexCount * instanceCount;
+}
+
+RenderContext& NullRenderDevice::BeginRecording(int context) {
+	return recordingContexts[context];
+}
+
+void NullRenderDevice::EndRecording(int context) {
+}
+
+void NullRenderDevice::ExecuteRecordings(int count) {
+	for (int context = 0; context < count; context++) {
+		stateCache.Invalidate();
+		statistics.RecordedCommands += recordingContexts[context].Execute(*this);
+	}
+}
+
+void NullRenderDevice::LatchConstants(int part, const void* data, unsigned int size) {
+	std::memcpy(latchedConstants[part], data, size);
+	statistics.Latches++;
+}
+
+void NullRenderDevice::SetFoveatedLayout(const FoveatedLayout* layout) {
+	foveated = layout != nullptr;
+	if (foveated) {
+		foveatedLayout = *layout;
+	}
+}
+
+bool NullRenderDevice::SetSceneInstances(const SceneInstance* instances, unsigned int instanceCount, const IndirectDrawArgs* meshDraws, unsigned int meshCount) {
+	sceneInstances.assign(instances, instances + instanceCount);
+	this->meshDraws.assign(meshDraws, meshDraws + meshCount);
+	culledDraws = this->meshDraws;
+	visibleInstances.assign(instanceCount, 0);
+	statistics.InstanceUploads++;
+	return true;
+}
+
+void NullRenderDevice::CullSceneInstances(const Frustum& frustum) {
+	culledDraws = meshDraws;
+	if (!sceneInstances.empty()) {
+		unsigned int instanceMultiplier = stereoMode == StereoMode_Instanced ? EyeCount : 1;
+		statistics.VisibleInstances += CullInstances(frustum, sceneInstances.data(), static_cast<unsigned int>(sceneInstances.size()), instanceMultiplier,
+			culledDraws.data(), visibleInstances.data());
+	}
+	statistics.InstanceCulls++;
+}
+
+void NullRenderDevice::DrawSceneInstances() {
+	// The instance shaders and what they read, and afterwards the scene's again, like the D3D11 device.
+	stateCache.Change(StateSlot_VertexShader, &sceneInstances, stereoMode);
+	stateCache.Change(StateSlot_VertexResource, &sceneInstances);
+	stateCache.Change(StateSlot_InstanceBuffer, &visibleInstances);
+	stateCache.Change(StateSlot_PixelConstants, &sceneInstances);
+	for (size_t mesh = 0; mesh < culledDraws.size(); mesh++) {
+		const IndirectDrawArgs& draw = culledDraws[mesh];
+		statistics.IndirectDraws++;
+		statistics.MappedDraws += constantsMapped ? 1 : 0;
+		statistics.Draws++;
+		statistics.Instances += draw.InstanceCount;
+		statistics.Vertices += static_cast<unsigned long long>(draw.VertexCountPerInstance) * draw.InstanceCount;
+	}
+	stateCache.Change(StateSlot_VertexShader, nullptr, stereoMode);
+	stateCache.Change(StateSlot_PixelConstants, nullptr, material);
+}
+
+void NullRenderDevice::ResolveEyeTexture() {
+	graph.Execute(graphBackend, graph.GetPassCommand(EyeGraphPass_Scene) + 1, graph.GetCommandCount());
+}
+
+bool NullRenderDevice::SetDistortionMesh(int eye, const DistortionMesh& mesh) {
+	if (!IsValidDistortionMesh(mesh)) {
+		return false;
+	}
+	distortionMeshes[eye] = mesh;
+	std::memset(distortionTexelLookup, 0, sizeof(distortionTexelLookup));
+	std::memset(hiddenAreaViewports, 0, sizeof(hiddenAreaViewports));
+	return true;
+}
+
+void NullRenderDevice::PresentDistorted(const DistortionConstants constants[EyeCount]) {
+	std::memcpy(distortionConstants, constants, sizeof(distortionConstants));
+	statistics.DistortedPresents++;
+
+	// The texels only change with the meshes and the viewports.
+	bool counted = true;
+	for (int eye = 0; eye < EyeCount; eye++) {
+		counted = counted && std::memcmp(distortionTexelLookup[eye], constants[eye].UvScaleOffset, sizeof(distortionTexelLookup[eye])) == 0;
+	}
+	if (!counted) {
+		const DistortionMesh* meshes[EyeCount] = { &distortionMeshes[0], &distortionMeshes[1] };
+		distortionTexels = CountDistortionTexels(meshes, constants, eyeTextureSize);
+		for (int eye = 0; eye < EyeCount; eye++) {
+			std::memcpy(distortionTexelLookup[eye], constants[eye].UvScaleOffset, sizeof(distortionTexelLookup[eye]));
+		}
+	}
+	unsigned long long samples = IsResolveFused() ? multisampleCount : 1;
+	statistics.DistortionBytes += distortionTexels * samples * 4; // R8G8B8A8
+}
+
+bool NullRenderDevice::SetFusedResolve(bool fused) {
+	fusedResolve = fused;
+	return true;
+}
+
+bool NullRenderDevice::SetHiddenAreaMesh(int eye, const HiddenAreaMesh& mesh) {
+	hiddenAreaMeshes[eye] = mesh;
+	return true;
+}
+
+void NullRenderDevice::SetHiddenAreaViewports(const Rect2i* viewports) {
+	hiddenAreaSet = viewports != nullptr;
+	maskedPixels.clear();
+	maskedPixelCount = 0;
+	if (!hiddenAreaSet) {
+		return;
+	}
+	for (int eye = 0; eye < EyeCount; eye++) {
+		hiddenAreaViewports[eye] = viewports[eye];
+		const std::vector<HiddenAreaRect>& rects = hiddenAreaMeshes[eye].Rects;
+		for (size_t i = 0; i < rects.size(); i++) {
+			Rect2i pixels = GetHiddenAreaPixels(rects[i], viewports[eye]);
+			if (pixels.Size.w > 0 && pixels.Size.h > 0) {
+				maskedPixels.push_back(pixels);
+				maskedPixelCount += pixels.Size.w * pixels.Size.h;
+			}
+		}
+	}
+}
+
+void NullRenderDevice::BeginGpuTimer() {
+}
+
+void NullRenderDevice::EndGpuTimer() {
+}
+
+bool NullRenderDevice::GetGpuFrameTime(double& outSeconds) {
+	// There is no GPU time to speak of.
+	return false;
+}
+
+const NullRenderDevice::Statistics& NullRenderDevice::GetStatistics() const {
+	return statistics;
+}
+
+const Rect2i& NullRenderDevice::GetViewport() const {
+	return viewport;
+}
+
+StereoMode NullRenderDevice::GetStereoMode() const {
+	return stereoMode;
+}
+
+int NullRenderDevice::GetMaterial() const {
+	return material;
+}
+
+const StateCache::Statistics& NullRenderDevice::GetStateStatistics() const {
+	return stateCache.GetStatistics();
+}
+
+const ConstantRingAllocator& NullRenderDevice::GetConstantAllocator() const {
+	return constantAllocator;
+}
+
+const unsigned char* NullRenderDevice::GetConstants(ConstantSlot slot) const {
+	return boundConstants[slot];
+}
+
+const unsigned char* NullRenderDevice::GetLatchedConstants(int part) const {
+	return latchedConstants[part];
+}
+
+unsigned int NullRenderDevice::GetSceneVertexCount() const {
+	return sceneVertexCount;
+}
+
+const FoveatedLayout* NullRenderDevice::GetFoveatedLayout() const {
+	return foveated ? &foveatedLayout : nullptr;
+}
+
+const FrameGraph& NullRenderDevice::GetFrameGraph() const {
+	return graph;
+}
+
+const std::vector<SceneInstance>& NullRenderDevice::GetSceneInstances() const {
+	return sceneInstances;
+}
+
+const std::vector<IndirectDrawArgs>& NullRenderDevice::GetCulledDraws() const {
+	return culledDraws;
+}
+
+const std::vector<unsigned int>& NullRenderDevice::GetVisibleInstances() const {
+	return visibleInstances;
+}
+
+const DistortionMesh& NullRenderDevice::GetDistortionMesh(int eye) const {
+	return distortionMeshes[eye];
+}
+
+const DistortionConstants& NullRenderDevice::GetDistortionConstants(int eye) const {
+	return distortionConstants[eye];
+}
+
+bool NullRenderDevice::IsResolveFused() const {
+	return IsEyeResolveFused(multisampleCount, foveated, fusedResolve);
+}
+
+bool NullRenderDevice::IsHiddenAreaMasked() const {
+	return hiddenAreaSet && !foveated;
+}
+
+const HiddenAreaMesh& NullRenderDevice::GetHiddenAreaMesh(int eye) const {
+	return hiddenAreaMeshes[eye];
+}
+
+const std::vector<Rect2i>& NullRenderDevice::GetMaskedPixels() const {
+	return maskedPixels;
+}
+
+void NullRenderDevice::GraphBackend::Barrier(const FrameGraph& graph, int resource, FrameGraphState before, FrameGraphState after) {
+	DeviceStatistics->Barriers++;
+}
+
+void NullRenderDevice::GraphBackend::Clear(const FrameGraph& graph, int resource, const FrameGraphClearValue& value) {
+	DeviceStatistics->Clears++;
+}
+
+void NullRenderDevice::GraphBackend::Resolve(const FrameGraph& graph, int source, int destination) {
+	DeviceStatistics->Resolves++;
+	DeviceStatistics->ResolveBytes += GetRenderTargetBytes(graph.GetResourceDesc(source)) + GetRenderTargetBytes(graph.GetResourceDesc(destination));
+}
+
+void NullRenderDevice::GraphBackend::RunPass(const FrameGraph& graph, int pass) {
+	if (pass == EyeGraphPass_Composite) {
+		DeviceStatistics->Composites++;
+	}
+}
@@ -0,0 +1,220 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#pragma once
+
+#include "CommandRecorder.h"
+#include "ConstantRingAllocator.h"
+#include "FrameGraph.h"
+#include "RenderDevice.h"
+#include "StateCache.h"
+#include <vector>
+
+/*
+	A render device that draws nothing. It keeps track of the state the frame loop sets and its
+	constants go into a ring in CPU memory managed exactly like the D3D11 one, so the CPU side of
+	the frame loop costs about what it would with a real device minus the driver. Useful for
+	profiling the frame loop and for running it on machines without a GPU.
+
+	The pretend GPU finishes each frame SimulatedFramesInFlight frames after it was submitted, so
+	constant memory is reused on the same schedule as with a real GPU running behind the CPU.
+
+	Recording contexts are CommandRecorders, which ExecuteRecordings plays back through the
+	device's own functions, like a command list. Latched constants are a small array
+	that binding merely points at, so replayed draws see what was latched last. A foveated layout
+	is only kept for inspection.
+
+	The clears, resolves and composite come from the eye frame graph like on the D3D11 device,
+	declared in BindEyeTexture with the clears since the last frame; the commands are counted.
+
+	State changes go through a StateCache like on the D3D11 device, so its statistics tell how
+	many calls a real device would make. Each recording is played back from an unknown state, as
+	a command list would be.
+
+	GPU driven drawing culls with CullInstances (InstanceCulling.h), the same cull the D3D11
+	compute shader does, and counts an indirect draw as a draw of its instances.
+
+	Distortion meshes and constants are only kept for inspection. Resolves count the bytes they
+	read and write, and PresentDistorted the texels CountDistortionTexels (Distortion.h) finds,
+	times the samples when the resolve is fused into it, so both ways can be compared.
+
+	The hidden area meshes are turned into pixels of the viewports they are set for, which
+	BindEyeTexture counts as masked, an eye at a time with its viewport as on the D3D11 device.
+*/
+class NullRenderDevice : public RenderDevice {
+public:
+	struct Statistics {
+		unsigned long long Clears;
+		unsigned long long ViewportChanges;
+		unsigned long long ConstantMaps;
+		unsigned long long ConstantUpdates;
+		unsigned long long ConstantBytes;
+		unsigned long long Draws;
+		unsigned long long Instances;
+		unsigned long long Vertices;
+		unsigned long long Resolves;
+		unsigned long long RecordedCommands;
+		unsigned long long Latches;
+		unsigned long long Composites;
+		unsigned long long Uploads; // UploadSceneVertices calls
+		unsigned long long UploadBytes;
+		unsigned long long Barriers;
+		unsigned long long InstanceUploads; // SetSceneInstances calls
+		unsigned long long InstanceCulls;
+		unsigned long long VisibleInstances; // Added up over every CullSceneInstances
+		unsigned long long IndirectDraws;
+		unsigned long long DistortedPresents;
+		unsigned long long ResolveBytes; // Read and written by resolves
+		unsigned long long DistortionBytes; // Of the eye texture, read by PresentDistorted
+		unsigned long long HiddenAreaDraws; // One per eye
+		unsigned long long MaskedPixels; // Covered by the hidden area draws
+		unsigned long long MappedDraws; // Between BeginConstants and EndConstants, invalid on D3D11
+	};
+
+	static const int SimulatedFramesInFlight = 2;
+
+	NullRenderDevice(Size2i eyeTextureSize, int multisampleCount);
+
+	Size2i GetEyeTextureSize() const;
+	int GetMultisampleCount() const;
+
+	void ClearEyeTexture(const float color[4]);
+	void ClearDepthStencil(float depth, unsigned char stencil);
+	void BindEyeTexture();
+	void SetViewport(const Rect2i& viewport);
+	void SetStereoMode(StereoMode mode);
+	void SetSceneVertices(const Vertex* vertices, unsigned int vertexCount);
+	void UploadSceneVertices(unsigned int firstVertex, const Vertex* vertices, unsigned int vertexCount);
+	void BeginConstants();
+	void* AllocateConstants(unsigned int size, unsigned int& outOffset);
+	void EndConstants();
+	void BindConstants(ConstantSlot slot, unsigned int offset, unsigned int size);
+	void BindLatchedConstants(ConstantSlot slot, int part);
+	void SetMaterial(int material);
+	void Draw(unsigned int vertexCount, unsigned int startVertex);
+	void DrawInstanced(unsigned int vertexCount, unsigned int instanceCount, unsigned int startVertex);
+	RenderContext& BeginRecording(int context);
+	void EndRecording(int context);
+	void ExecuteRecordings(int count);
+	void LatchConstants(int part, const void* data, unsigned int size);
+	void SetFoveatedLayout(const FoveatedLayout* layout);
+	bool SetSceneInstances(const SceneInstance* instances, unsigned int instanceCount, const IndirectDrawArgs* meshDraws, unsigned int meshCount);
+	void CullSceneInstances(const Frustum& frustum);
+	void DrawSceneInstances();
+	void ResolveEyeTexture();
+	bool SetDistortionMesh(int eye, const DistortionMesh& mesh);
+	void PresentDistorted(const DistortionConstants constants[EyeCount]);
+	bool SetFusedResolve(bool fused);
+	bool SetHiddenAreaMesh(int eye, const HiddenAreaMesh& mesh);
+	void SetHiddenAreaViewports(const Rect2i* viewports);
+	void BeginGpuTimer();
+	void EndGpuTimer();
+	bool GetGpuFrameTime(double& outSeconds);
+
+	const Statistics& GetStatistics() const;
+	const Rect2i& GetViewport() const;
+	StereoMode GetStereoMode() const;
+	int GetMaterial() const;
+	const StateCache::Statistics& GetStateStatistics() const;
+	const ConstantRingAllocator& GetConstantAllocator() const;
+
+	// The constants bound to a slot for the last draw.
+	const unsigned char* GetConstants(ConstantSlot slot) const;
+	const unsigned char* GetLatchedConstants(int part) const;
+	unsigned int GetSceneVertexCount() const;
+
+	// The layout the last frame was composited with, nullptr if it wasn't foveated.
+	const FoveatedLayout* GetFoveatedLayout() const;
+
+	const FrameGraph& GetFrameGraph() const;
+
+	// GPU driven drawing: the instances, the mesh draws after the last cull and the instances they draw.
+	const std::vector<SceneInstance>& GetSceneInstances() const;
+	const std::vector<IndirectDrawArgs>& GetCulledDraws() const;
+	const std::vector<unsigned int>& GetVisibleInstances() const;
+
+	// Own distortion: the meshes as set, and the constants of the last PresentDistorted.
+	const DistortionMesh& GetDistortionMesh(int eye) const;
+	const DistortionConstants& GetDistortionConstants(int eye) const;
+
+	// Whether PresentDistorted samples the multisampled eye texture, see SetFusedResolve.
+	bool IsResolveFused() const;
+
+	// Whether BindEyeTexture masks the hidden area, and the pixels of both eyes' masks then.
+	bool IsHiddenAreaMasked() const;
+	const HiddenAreaMesh& GetHiddenAreaMesh(int eye) const;
+	const std::vector<Rect2i>& GetMaskedPixels() const;
+
+private:
+	class GraphBackend : public FrameGraphBackend {
+	public:
+		void Barrier(const FrameGraph& graph, int resource, FrameGraphState before, FrameGraphState after);
+		void Clear(const FrameGraph& graph, int resource, const FrameGraphClearValue& value);
+		void Resolve(const FrameGraph& graph, int source, int destination);
+		void RunPass(const FrameGraph& graph, int pass);
+
+		Statistics* DeviceStatistics;
+	};
+
+	Size2i eyeTextureSize;
+	int multisampleCount;
+	Rect2i viewport;
+	StereoMode stereoMode;
+	int material;
+	StateCache stateCache;
+	ConstantRingAllocator constantAllocator;
+	std::vector<unsigned char> constantMemory;
+	unsigned long long constantFrame;
+	bool constantsMapped; // Between BeginConstants and EndConstants
+	const unsigned char* boundConstants[ConstantSlotCount];
+	unsigned char latchedConstants[LatchedConstantParts][MaxLatchedConstantsSize];
+	unsigned int sceneVertexCount;
+	FoveatedLayout foveatedLayout;
+	bool foveated;
+	CommandRecorder recordingContexts[MaxRecordingContexts];
+	std::vector<SceneInstance> sceneInstances;
+	std::vector<IndirectDrawArgs> meshDraws; // As given to SetSceneInstances
+	std::vector<IndirectDrawArgs> culledDraws;
+	std::vector<unsigned int> visibleInstances;
+	DistortionMesh distortionMeshes[EyeCount];
+	DistortionConstants distortionConstants[EyeCount];
+	bool fusedResolve;
+	unsigned long long distortionTexels; // CountDistortionTexels for distortionTexelLookup
+	float distortionTexelLookup[EyeCount][4]; // UvScaleOffset, all 0 until counted
+	HiddenAreaMesh hiddenAreaMeshes[EyeCount];
+	bool hiddenAreaSet; // Whether there are viewports
+	Rect2i hiddenAreaViewports[EyeCount];
+	std::vector<Rect2i> maskedPixels;
+	unsigned long long maskedPixelCount;
+	FrameGraph graph;
+	GraphBackend graphBackend;
+	FrameGraphClearValue colorClear;
+	FrameGraphClearValue depthStencilClear;
+	bool clearColor;
+	bool clearDepthStencil;
+	Statistics statistics;
+};
@@ -0,0 +1,135 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#include "PosePrediction.h"
+#include "VrMath.h"
+#include <cmath>
+#include <cstring>
+
+namespace {
+	const char* const PredictionMethodNames[PredictionMethodCount] = { "none", "velocity", "acceleration", "filtered" };
+}
+
+const double PosePredictor::DefaultSmoothingTime = 0.015;
+
+const char* GetPredictionMethodName(PredictionMethod method) {
+	return PredictionMethodNames[method];
+}
+
+bool FindPredictionMethod(const char* name, PredictionMethod& outMethod) {
+	for (int method = 0; method < PredictionMethodCount; method++) {
+		if (std::strcmp(name, PredictionMethodNames[method]) == 0) {
+			outMethod = static_cast<PredictionMethod>(method);
+			return true;
+		}
+	}
+	return false;
+}
+
+Pose ExtrapolatePose(const PoseState& state, float dt, bool accelerate) {
+	Vector3 rotation = state.AngularVelocity * dt;
+	Vector3 translation = state.LinearVelocity * dt;
+	if (accelerate) {
+		rotation = rotation + state.AngularAcceleration * (0.5f * dt * dt);
+		translation = translation + state.LinearAcceleration * (0.5f * dt * dt);
+	}
+
+	// The velocities are in world space, so the rotation is applied after the pose's.
+	Pose pose;
+	pose.Orientation = Normalized(QuaternionFromRotationVector(rotation) * state.ThePose.Orientation);
+	pose.Position = state.ThePose.Position + translation;
+	return pose;
+}
+
+PosePredictor::PosePredictor() :
+	method(PredictionMethod_ConstantVelocity),
+	smoothingTime(DefaultSmoothingTime),
+	hasSample(false)
+{
+	std::memset(&latest, 0, sizeof(latest));
+	latest.ThePose.Orientation = QuaternionIdentity();
+}
+
+PosePredictor::PosePredictor(PredictionMethod method, double smoothingTime) :
+	method(method),
+	smoothingTime(smoothingTime),
+	hasSample(false)
+{
+	std::memset(&latest, 0, sizeof(latest));
+	latest.ThePose.Orientation = QuaternionIdentity();
+}
+
+PredictionMethod PosePredictor::GetMethod() const {
+	return method;
+}
+
+double PosePredictor::GetSmoothingTime() const {
+	return smoothingTime;
+}
+
+void PosePredictor::Reset() {
+	hasSample = false;
+	std::memset(&latest, 0, sizeof(latest));
+	latest.ThePose.Orientation = QuaternionIdentity();
+}
+
+void PosePredictor::AddSample(const PoseState& state) {
+	if (hasSample && state.TimeInSeconds <= latest.TimeInSeconds) {
+		return;
+	}
+	if (method != PredictionMethod_Filtered || !hasSample || smoothingTime <= 0.0) {
+		latest = state;
+		hasSample = true;
+		return;
+	}
+
+	// An exponential moving average, weighted by how long ago the previous state was so it
+	// smooths the same however often it is sampled.
+	float weight = static_cast<float>(1.0 - std::exp(-(state.TimeInSeconds - latest.TimeInSeconds) / smoothingTime));
+	Vector3 angularVelocity = latest.AngularVelocity + (state.AngularVelocity - latest.AngularVelocity) * weight;
+	Vector3 linearVelocity = latest.LinearVelocity + (state.LinearVelocity - latest.LinearVelocity) * weight;
+	latest = state;
+	latest.AngularVelocity = angularVelocity;
+	latest.LinearVelocity = linearVelocity;
+}
+
+bool PosePredictor::HasSample() const {
+	return hasSample;
+}
+
+Pose PosePredictor::Predict(double time) const {
+	float dt = static_cast<float>(time - latest.TimeInSeconds);
+	switch (method) {
+	case PredictionMethod_ConstantVelocity:
+	case PredictionMethod_Filtered:
+		return ExtrapolatePose(latest, dt, false);
+	case PredictionMethod_ConstantAcceleration:
+		return ExtrapolatePose(latest, dt, true);
+	default:
+		return latest.ThePose;
+	}
+}
@@ -0,0 +1,87 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#pragma once
+
+#include "VrTypes.h"
+
+/*
+	Head pose prediction from tracking states, done by us instead of by the HMD. See PosePredictor.
+
+	PredictionMethod_None shows the latest pose as it is, which is what no prediction at all
+	looks like. ConstantVelocity and ConstantAcceleration extrapolate the latest state with its
+	derivatives. Filtered extrapolates with velocities smoothed over the last SmoothingTime
+	seconds of states, which lags a little behind quick changes of direction but doesn't pass on
+	the sensor's noise, magnified by the prediction time, as the others do.
+*/
+enum PredictionMethod {
+	PredictionMethod_None,
+	PredictionMethod_ConstantVelocity,
+	PredictionMethod_ConstantAcceleration,
+	PredictionMethod_Filtered,
+	PredictionMethodCount
+};
+
+// "none", "velocity", "acceleration" and "filtered".
+const char* GetPredictionMethodName(PredictionMethod method);
+
+// Returns false if there is no method by that name.
+bool FindPredictionMethod(const char* name, PredictionMethod& outMethod);
+
+// Where state will be dt seconds later, going on with its velocities and, if accelerate is set,
+// its accelerations.
+Pose ExtrapolatePose(const PoseState& state, float dt, bool accelerate);
+
+/*
+	Predicts the head pose for a point in time from the tracking states it was given, which have
+	to come in the order they were sampled. States that are not newer than the latest are
+	ignored. Predicting before the first state gives the identity pose.
+*/
+class PosePredictor {
+public:
+	static const double DefaultSmoothingTime;
+
+	// PredictionMethod_ConstantVelocity.
+	PosePredictor();
+	PosePredictor(PredictionMethod method, double smoothingTime);
+
+	PredictionMethod GetMethod() const;
+	double GetSmoothingTime() const;
+
+	// Forgets the states seen so far.
+	void Reset();
+	void AddSample(const PoseState& state);
+	bool HasSample() const;
+
+	Pose Predict(double time) const;
+
+private:
+	PredictionMethod method;
+	double smoothingTime;
+	bool hasSample;
+	PoseState latest; // With the smoothed velocities for PredictionMethod_Filtered
+};
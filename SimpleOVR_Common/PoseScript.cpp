@@ -0,0 +1,117 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#include "PoseScript.h"
+#include "VrMath.h"
+#include <cmath>
+#include <cstdio>
+
+namespace {
+	const float DegreesToRadians = 3.14159265f / 180.0f;
+
+	PoseKeyframe MakeKeyframe(double time, float yaw, float pitch, float roll, float x, float y, float z) {
+		const Vector3 axisX = { 1.0f, 0.0f, 0.0f };
+		const Vector3 axisY = { 0.0f, 1.0f, 0.0f };
+		const Vector3 axisZ = { 0.0f, 0.0f, 1.0f };
+
+		// Same order as OVR::Quatf::GetEulerAngles<Axis_Y, Axis_X, Axis_Z>: yaw, then pitch, then roll.
+		PoseKeyframe keyframe;
+		keyframe.Time = time;
+		keyframe.HeadPose.Orientation =
+			QuaternionFromAxisAngle(axisY, yaw * DegreesToRadians) *
+			QuaternionFromAxisAngle(axisX, pitch * DegreesToRadians) *
+			QuaternionFromAxisAngle(axisZ, roll * DegreesToRadians);
+		keyframe.HeadPose.Position.x = x;
+		keyframe.HeadPose.Position.y = y;
+		keyframe.HeadPose.Position.z = z;
+		return keyframe;
+	}
+}
+
+PoseScript::PoseScript() {
+	keyframes.push_back(MakeKeyframe(0.0, 0, 0, 0, 0, 0, 0));
+	keyframes.push_back(MakeKeyframe(1.0, 35, 5, 2, 0.02f, 0.0f, 0.01f));
+	keyframes.push_back(MakeKeyframe(2.0, 10, -20, 0, 0.0f, -0.03f, 0.04f));
+	keyframes.push_back(MakeKeyframe(3.0, -40, 0, -3, -0.03f, 0.0f, 0.0f));
+	keyframes.push_back(MakeKeyframe(4.0, 0, 15, 0, 0.0f, 0.02f, -0.02f));
+	keyframes.push_back(MakeKeyframe(5.0, 0, 0, 0, 0, 0, 0));
+}
+
+bool PoseScript::LoadFromFile(const char* path) {
+	FILE* file = std::fopen(path, "r");
+	if (file == nullptr) {
+		return false;
+	}
+
+	std::vector<PoseKeyframe> loaded;
+	char line[256];
+	while (std::fgets(line, sizeof(line), file) != nullptr) {
+		double time;
+		float yaw, pitch, roll, x, y, z;
+		if (line[0] == '#') {
+			continue;
+		}
+		if (std::sscanf(line, "%lf %f %f %f %f %f %f", &time, &yaw, &pitch, &roll, &x, &y, &z) == 7) {
+			loaded.push_back(MakeKeyframe(time, yaw, pitch, roll, x, y, z));
+		}
+	}
+	std::fclose(file);
+
+	if (loaded.empty()) {
+		return false;
+	}
+	keyframes.swap(loaded);
+	return true;
+}
+
+double PoseScript::GetDuration() const {
+	return keyframes.back().Time;
+}
+
+Pose PoseScript::Sample(double time) const {
+	if (keyframes.size() == 1 || GetDuration() <= 0.0) {
+		return keyframes.front().HeadPose;
+	}
+
+	time = std::fmod(time, GetDuration());
+	if (time < 0.0) {
+		time += GetDuration();
+	}
+	size_t next = 1;
+	while (next < keyframes.size() - 1 && keyframes[next].Time < time) {
+		next++;
+	}
+
+	const PoseKeyframe& a = keyframes[next - 1];
+	const PoseKeyframe& b = keyframes[next];
+	float t = b.Time > a.Time ? static_cast<float>((time - a.Time) / (b.Time - a.Time)) : 1.0f;
+
+	Pose pose;
+	pose.Orientation = Slerp(a.HeadPose.Orientation, b.HeadPose.Orientation, t);
+	pose.Position = a.HeadPose.Position + (b.HeadPose.Position - a.HeadPose.Position) * t;
+	return pose;
+}
@@ -0,0 +1,66 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#include "ProcessMemory.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <psapi.h> // In kernel32 since Windows 7, nothing to link
+#elif defined(__linux__)
+#include <cstdio>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+unsigned long long GetProcessMemoryUsage() {
+	PROCESS_MEMORY_COUNTERS counters;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+		return 0;
+	}
+	return counters.WorkingSetSize;
+}
+#elif defined(__linux__)
+unsigned long long GetProcessMemoryUsage() {
+	// The second field is the resident pages.
+	FILE* file = std::fopen("/proc/self/statm", "r");
+	if (file == nullptr) {
+		return 0;
+	}
+	unsigned long long pages = 0;
+	unsigned long long residentPages = 0;
+	bool read = std::fscanf(file, "%llu %llu", &pages, &residentPages) == 2;
+	std::fclose(file);
+	return read ? residentPages * static_cast<unsigned long long>(sysconf(_SC_PAGESIZE)) : 0;
+}
+#else
+unsigned long long GetProcessMemoryUsage() {
+	return 0;
+}
+#endif
@@ -0,0 +1,321 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#include "Profiler.h"
+#include <atomic>
+#include <cstdio>
+
+#ifdef _MSC_VER
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
+
+namespace {
+	const char* StageNames[ProfileStageCount] = {
+		"Frame",
+		"MessagePump",
+		"Upload",
+		"BeginFrame",
+		"GetEyePoses",
+		"Clear",
+		"EyeMatrices",
+		"Cull",
+		"ConstantUpload",
+		"Record",
+		"Draw",
+		"Resolve",
+		"Distortion",
+		"EndFrame",
+		"PacingWait",
+		"PoseToSubmit",
+	};
+
+	const int MaxThreads = 64; // Recording at the same time, see ReleaseThread
+	const unsigned int RingCapacity = 4096; // Must be a power of two
+
+	struct Sample {
+		ProfileStage Stage;
+		ClockTicks Duration;
+	};
+
+	enum RingState {
+		RingState_Recording,
+		RingState_Released, // Its thread is gone, Collect still has to drain it
+		RingState_Free // Drained, for the next thread that registers
+	};
+
+	// Single producer (the owning thread), single consumer (Collect).
+	struct SampleRing {
+		std::atomic<unsigned int> Head;
+		std::atomic<unsigned int> Tail;
+		std::atomic<unsigned int> Dropped;
+		std::atomic<int> State;
+		Sample Samples[RingCapacity];
+	};
+
+	std::atomic<SampleRing*> rings[MaxThreads];
+	std::atomic<int> ringCount(0);
+	THREAD_LOCAL SampleRing* threadRing = nullptr;
+
+	LatencyHistogram histograms[ProfileStageCount];
+	unsigned long long droppedSamples = 0;
+	std::atomic<unsigned int> unregisteredSamples(0);
+	double timerOverhead = -1.0;
+
+	SampleRing* RegisterThread() {
+		// The ring of a thread that has exited, if Collect is done with one.
+		int count = ringCount.load(std::memory_order_acquire);
+		for (int i = 0; i < count; i++) {
+			SampleRing* ring = rings[i].load(std::memory_order_acquire);
+			int expected = RingState_Free;
+			if (ring != nullptr && ring->State.compare_exchange_strong(expected, RingState_Recording, std::memory_order_acquire)) {
+				return ring;
+			}
+		}
+
+		int index = ringCount.load();
+		do {
+			if (index >= MaxThreads) {
+				return nullptr;
+			}
+		} while (!ringCount.compare_exchange_weak(index, index + 1));
+
+		SampleRing* ring = new SampleRing();
+		ring->Head.store(0);
+		ring->Tail.store(0);
+		ring->Dropped.store(0);
+		ring->State.store(RingState_Recording);
+		rings[index].store(ring, std::memory_order_release);
+		return ring;
+	}
+
+	double TicksToNanoseconds(ClockTicks ticks) {
+		return ClockTicksToSeconds(ticks) * 1e9;
+	}
+
+	// Estimated cost of the timers themselves per frame, in microseconds.
+	double GetTimerOverheadPerFrame() {
+		unsigned long long frames = histograms[ProfileStage_Frame].GetCount();
+		if (frames == 0 || timerOverhead < 0.0) {
+			return 0.0;
+		}
+		unsigned long long scopes = 0;
+		for (int i = 0; i < ProfileStageCount; i++) {
+			scopes += histograms[i].GetCount();
+		}
+		return timerOverhead * scopes / frames / 1000.0;
+	}
+}
+
+const char* Profiler::GetStageName(ProfileStage stage) {
+	return StageNames[stage];
+}
+
+void Profiler::Record(ProfileStage stage, ClockTicks start, ClockTicks end) {
+	SampleRing* ring = threadRing;
+	if (ring == nullptr) {
+		ring = threadRing = RegisterThread();
+		if (ring == nullptr) {
+			unregisteredSamples++;
+			return;
+		}
+	}
+
+	unsigned int head = ring->Head.load(std::memory_order_relaxed);
+	unsigned int tail = ring->Tail.load(std::memory_order_acquire);
+	if (head - tail >= RingCapacity) {
+		ring->Dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	Sample& sample = ring->Samples[head & (RingCapacity - 1)];
+	sample.Stage = stage;
+	sample.Duration = end - start;
+	ring->Head.store(head + 1, std::memory_order_release);
+}
+
+void Profiler::ReleaseThread() {
+	SampleRing* ring = threadRing;
+	if (ring == nullptr) {
+		return;
+	}
+	threadRing = nullptr;
+	ring->State.store(RingState_Released, std::memory_order_release);
+}
+
+void Profiler::Collect() {
+	// A thread that is still registering has claimed its slot but not yet published its ring,
+	// in which case it is simply picked up next time.
+	int count = ringCount.load(std::memory_order_acquire);
+	for (int i = 0; i < count; i++) {
+		SampleRing* ring = rings[i].load(std::memory_order_acquire);
+		if (ring == nullptr) {
+			continue;
+		}
+
+		// Read before the head, so a released ring is known to have all its samples in.
+		bool released = ring->State.load(std::memory_order_acquire) == RingState_Released;
+		unsigned int tail = ring->Tail.load(std::memory_order_relaxed);
+		unsigned int head = ring->Head.load(std::memory_order_acquire);
+		for (; tail != head; tail++) {
+			const Sample& sample = ring->Samples[tail & (RingCapacity - 1)];
+			histograms[sample.Stage].Add(static_cast<unsigned long long>(TicksToNanoseconds(sample.Duration)));
+		}
+		ring->Tail.store(tail, std::memory_order_release);
+		droppedSamples += ring->Dropped.exchange(0, std::memory_order_relaxed);
+		if (released) {
+			ring->State.store(RingState_Free, std::memory_order_release);
+		}
+	}
+}
+
+void Profiler::Reset() {
+	Collect();
+	for (int i = 0; i < ProfileStageCount; i++) {
+		histograms[i].Reset();
+	}
+	droppedSamples = 0;
+}
+
+const LatencyHistogram& Profiler::GetHistogram(ProfileStage stage) {
+	return histograms[stage];
+}
+
+unsigned long long Profiler::GetDroppedSampleCount() {
+	return droppedSamples + unregisteredSamples.load();
+}
+
+double Profiler::MeasureTimerOverhead(unsigned int iterations) {
+	// Measured on a private ring so the real histograms are left alone.
+	SampleRing* savedRing = threadRing;
+	SampleRing scratch;
+	scratch.Head.store(0);
+	scratch.Tail.store(0);
+	scratch.Dropped.store(0);
+	scratch.State.store(RingState_Recording);
+	threadRing = &scratch;
+
+	auto start = ReadClock();
+	for (unsigned int i = 0; i < iterations; i++) {
+		ScopedProfileTimer timer(ProfileStage_Frame);
+		if ((i & (RingCapacity - 1)) == RingCapacity - 1) {
+			scratch.Tail.store(scratch.Head.load());
+		}
+	}
+	auto elapsed = ReadClock() - start;
+
+	threadRing = savedRing;
+	timerOverhead = iterations > 0 ? TicksToNanoseconds(elapsed) / iterations : 0.0;
+	return timerOverhead;
+}
+
+void Profiler::PrintSummary() {
+	std::printf("%-16s %10s %10s %10s %10s %10s %10s\n", "Stage", "Count", "Mean us", "p50 us", "p95 us", "p99 us", "Max us");
+	for (int i = 0; i < ProfileStageCount; i++) {
+		const LatencyHistogram& h = histograms[i];
+		if (h.GetCount() == 0) {
+			continue;
+		}
+		std::printf("%-16s %10llu %10.3f %10.3f %10.3f %10.3f %10.3f\n",
+			StageNames[i],
+			h.GetCount(),
+			h.GetMean() / 1000.0,
+			h.GetPercentile(0.50) / 1000.0,
+			h.GetPercentile(0.95) / 1000.0,
+			h.GetPercentile(0.99) / 1000.0,
+			h.GetMax() / 1000.0);
+	}
+	if (timerOverhead >= 0.0) {
+		std::printf("Timer overhead: %.1f ns per scope, %.3f us per frame\n", timerOverhead, GetTimerOverheadPerFrame());
+	}
+	if (GetDroppedSampleCount() > 0) {
+		std::printf("Dropped samples: %llu\n", GetDroppedSampleCount());
+	}
+}
+
+bool Profiler::WriteCsv(const char* path) {
+	FILE* file = std::fopen(path, "w");
+	if (file == nullptr) {
+		return false;
+	}
+
+	std::fprintf(file, "stage,count,mean_us,p50_us,p95_us,p99_us,max_us\n");
+	for (int i = 0; i < ProfileStageCount; i++) {
+		const LatencyHistogram& h = histograms[i];
+		std::fprintf(file, "%s,%llu,%.3f,%.3f,%.3f,%.3f,%.3f\n",
+			StageNames[i],
+			h.GetCount(),
+			h.GetMean() / 1000.0,
+			h.GetPercentile(0.50) / 1000.0,
+			h.GetPercentile(0.95) / 1000.0,
+			h.GetPercentile(0.99) / 1000.0,
+			h.GetMax() / 1000.0);
+	}
+	std::fclose(file);
+	return true;
+}
+
+bool Profiler::WriteJson(const char* path) {
+	FILE* file = std::fopen(path, "w");
+	if (file == nullptr) {
+		return false;
+	}
+
+	std::fprintf(file, "{\n");
+	std::fprintf(file, "  \"timer_overhead_ns\": %.1f,\n", timerOverhead);
+	std::fprintf(file, "  \"timer_overhead_per_frame_us\": %.3f,\n", GetTimerOverheadPerFrame());
+	std::fprintf(file, "  \"dropped_samples\": %llu,\n", GetDroppedSampleCount());
+	std::fprintf(file, "  \"stages\": {\n");
+	for (int i = 0; i < ProfileStageCount; i++) {
+		const LatencyHistogram& h = histograms[i];
+		std::fprintf(file, "    \"%s\": {\n", StageNames[i]);
+		std::fprintf(file, "      \"count\": %llu,\n", h.GetCount());
+		std::fprintf(file, "      \"mean_us\": %.3f,\n", h.GetMean() / 1000.0);
+		std::fprintf(file, "      \"p50_us\": %.3f,\n", h.GetPercentile(0.50) / 1000.0);
+		std::fprintf(file, "      \"p95_us\": %.3f,\n", h.GetPercentile(0.95) / 1000.0);
+		std::fprintf(file, "      \"p99_us\": %.3f,\n", h.GetPercentile(0.99) / 1000.0);
+		std::fprintf(file, "      \"max_us\": %.3f,\n", h.GetMax() / 1000.0);
+
+		// Only the buckets that have values, as [upper bound in us, count] pairs.
+		std::fprintf(file, "      \"histogram\": [");
+		bool first = true;
+		for (int b = 0; b < h.GetBucketCount(); b++) {
+			if (h.GetBucketValueCount(b) == 0) {
+				continue;
+			}
+			std::fprintf(file, "%s[%.3f, %llu]", first ? "" : ", ", LatencyHistogram::GetBucketUpperBound(b) / 1000.0, h.GetBucketValueCount(b));
+			first = false;
+		}
+		std::fprintf(file, "]\n");
+		std::fprintf(file, "    }%s\n", i + 1 < ProfileStageCount ? "," : "");
+	}
+	std::fprintf(file, "  }\n");
+	std::fprintf(file, "}\n");
+	std::fclose(file);
+	return true;
+}
@@ -0,0 +1,116 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#pragma once
+
+#include "Clock.h"
+#include "LatencyHistogram.h"
+
+/*
+	Low-overhead CPU timing of the stages of a frame.
+
+	Samples are written to a ring buffer owned by the recording thread, without locks or
+	allocations (the very first sample of a thread allocates its ring). Collect() drains all rings
+	into one histogram per stage; call it once per frame from a single thread, outside anything
+	being timed. If a ring fills up before being collected the sample is dropped and counted
+	rather than blocking the recording thread.
+
+	A thread that records and then exits calls ReleaseThread() last. Its ring is reused by the
+	next thread that records, once Collect() has drained it, so starting threads again and again
+	doesn't run out of rings.
+
+	Typical use:
+
+		{
+			ScopedProfileTimer timer(ProfileStage_BeginFrame);
+			hmd.BeginFrame(0);
+		}
+*/
+
+enum ProfileStage {
+	ProfileStage_Frame,
+	ProfileStage_MessagePump,
+	ProfileStage_Upload,
+	ProfileStage_BeginFrame,
+	ProfileStage_GetEyePoses,
+	ProfileStage_Clear,
+	ProfileStage_EyeMatrices,
+	ProfileStage_Cull,
+	ProfileStage_ConstantUpload,
+	ProfileStage_Record,
+	ProfileStage_Draw,
+	ProfileStage_Resolve,
+	ProfileStage_Distortion, // Own distortion and timewarp, see Distortion.h
+	ProfileStage_EndFrame,
+	ProfileStage_PacingWait, // Of a paced render thread for its frame's start, see FrameScheduler
+	ProfileStage_PoseToSubmit, // Not a stage: from sampling the pose a frame is drawn with until EndFrame
+	ProfileStageCount
+};
+
+namespace Profiler {
+	const char* GetStageName(ProfileStage stage);
+
+	void Record(ProfileStage stage, ClockTicks start, ClockTicks end);
+
+	// Gives up the calling thread's ring. It must not record anything after this.
+	void ReleaseThread();
+
+	// Drains the per-thread rings into the histograms.
+	void Collect();
+	void Reset();
+
+	const LatencyHistogram& GetHistogram(ProfileStage stage);
+	unsigned long long GetDroppedSampleCount();
+
+	/*
+		Cost of one ScopedProfileTimer in nanoseconds, measured by timing a large number of empty
+		scopes. The result is also included in the exported files.
+	*/
+	double MeasureTimerOverhead(unsigned int iterations);
+
+	// Summary table (count, mean, p50, p95, p99, max in microseconds) for each stage.
+	void PrintSummary();
+	bool WriteCsv(const char* path);
+	bool WriteJson(const char* path);
+}
+
+class ScopedProfileTimer {
+public:
+	explicit ScopedProfileTimer(ProfileStage stage) : stage(stage), start(ReadClock()) {
+	}
+
+	~ScopedProfileTimer() {
+		Profiler::Record(stage, start, ReadClock());
+	}
+
+private:
+	ScopedProfileTimer(const ScopedProfileTimer&);
+	ScopedProfileTimer& operator=(const ScopedProfileTimer&);
+
+	ProfileStage stage;
+	ClockTicks start;
+};
@@ -0,0 +1,274 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#pragma once
+
+#include "Culling.h"
+#include "Distortion.h"
+#include "FoveatedLayout.h"
+#include "HiddenArea.h"
+#include "VrTypes.h"
+
+/*
+	The graphics operations the frame loop performs each frame. Each call maps more or less
+	directly to a D3D11 call in D3D11RenderDevice; NullRenderDevice implements them on the CPU.
+
+	Both eyes share a single eye texture, the device owns it along with its depth buffer and, when
+	multisampling, the intermediary texture it is resolved into.
+*/
+
+/*
+	How the two eyes are drawn.
+
+	MultiPass: one viewport, one constant upload and one draw per eye.
+
+	Instanced: a single viewport covering the whole eye texture and every draw is instanced twice.
+	The vertex shader picks the eye's matrix with SV_InstanceID and clips against the eye's part of
+	the texture with SV_ClipDistance. The constants are a StereoConstants (FrameLoop.h), uploaded
+	once per frame for both eyes.
+*/
+enum StereoMode {
+	StereoMode_MultiPass,
+	StereoMode_Instanced
+};
+
+/*
+	Constant buffer slots of the scene's vertex shaders. The frame slot holds the view-projection
+	(a Matrix4 per eye for StereoMode_MultiPass, a StereoConstants for StereoMode_Instanced) and
+	the object slot the object's world matrix. Matrices are transposed, as the shaders expect
+	column-major matrices.
+*/
+enum ConstantSlot {
+	ConstantSlot_Frame,
+	ConstantSlot_Object,
+	ConstantSlotCount
+};
+
+struct Vertex {
+	float Position[3];
+};
+
+/*
+	Materials, for now just the color the scene's pixel shader outputs. Every device knows the same
+	MaxMaterials, so a material is only an index; material 0 is the color the sample always used.
+*/
+const int MaxMaterials = 16;
+const float MaterialColors[MaxMaterials][4] = {
+	{ 1.0f, 0.8f, 0.8f, 1.0f },
+	{ 0.8f, 1.0f, 0.8f, 1.0f },
+	{ 0.8f, 0.8f, 1.0f, 1.0f },
+	{ 1.0f, 1.0f, 0.8f, 1.0f },
+	{ 0.8f, 1.0f, 1.0f, 1.0f },
+	{ 1.0f, 0.8f, 1.0f, 1.0f },
+	{ 0.9f, 0.9f, 0.9f, 1.0f },
+	{ 1.0f, 0.6f, 0.4f, 1.0f },
+	{ 0.4f, 1.0f, 0.6f, 1.0f },
+	{ 0.6f, 0.4f, 1.0f, 1.0f },
+	{ 1.0f, 0.9f, 0.4f, 1.0f },
+	{ 0.4f, 0.9f, 1.0f, 1.0f },
+	{ 1.0f, 0.4f, 0.9f, 1.0f },
+	{ 0.7f, 0.7f, 0.5f, 1.0f },
+	{ 0.5f, 0.7f, 0.7f, 1.0f },
+	{ 0.7f, 0.5f, 0.7f, 1.0f }
+};
+
+/*
+	An object of the scene for GPU driven drawing, see RenderDevice::SetSceneInstances. Laid out
+	as the D3D11 shaders read it from the instance buffer.
+*/
+struct SceneInstance {
+	Matrix4 TransposedWorld;
+	float BoundsCenter[3]; // The bounding sphere, in world space
+	float BoundsRadius;
+	unsigned int Mesh;
+	unsigned int Material;
+	unsigned int Padding[2];
+};
+
+// The arguments of an indirect draw, laid out as D3D11_DRAW_INSTANCED_INDIRECT_ARGS.
+struct IndirectDrawArgs {
+	unsigned int VertexCountPerInstance;
+	unsigned int InstanceCount;
+	unsigned int StartVertexLocation;
+	unsigned int StartInstanceLocation;
+};
+
+/*
+	The commands that draw the scene. The device runs them right away; the contexts handed out by
+	RenderDevice::BeginRecording record them on other threads, to be run later.
+*/
+class RenderContext {
+public:
+	virtual ~RenderContext() {}
+
+	virtual void SetViewport(const Rect2i& viewport) = 0;
+	virtual void BindConstants(ConstantSlot slot, unsigned int offset, unsigned int size) = 0;
+
+	// Binds a part of the late latched constants, see RenderDevice::LatchConstants.
+	virtual void BindLatchedConstants(ConstantSlot slot, int part) = 0;
+
+	// Selects the material of the following draws. Material 0 until set.
+	virtual void SetMaterial(int material) = 0;
+
+	virtual void Draw(unsigned int vertexCount, unsigned int startVertex) = 0;
+	virtual void DrawInstanced(unsigned int vertexCount, unsigned int instanceCount, unsigned int startVertex) = 0;
+};
+
+// How many contexts can record at the same time.
+const int MaxRecordingContexts = 16;
+
+// Late latched constants: one part per draw pass, each up to MaxLatchedConstantsSize bytes. A
+// foveated frame drawn in StereoMode_MultiPass has a pass per eye and region.
+const int LatchedConstantParts = EyeCount * FoveatedRegionCount;
+const unsigned int MaxLatchedConstantsSize = 256;
+
+class RenderDevice : public RenderContext {
+public:
+
+	virtual Size2i GetEyeTextureSize() const = 0;
+	virtual int GetMultisampleCount() const = 0;
+
+	virtual void ClearEyeTexture(const float color[4]) = 0;
+	virtual void ClearDepthStencil(float depth, unsigned char stencil) = 0;
+	virtual void BindEyeTexture() = 0;
+
+	// Selects the shaders matching the stereo mode.
+	virtual void SetStereoMode(StereoMode mode) = 0;
+
+	// Replaces the vertices all meshes of the scene are drawn from.
+	virtual void SetSceneVertices(const Vertex* vertices, unsigned int vertexCount) = 0;
+
+	// Replaces vertices firstVertex to firstVertex + vertexCount - 1 of the scene, growing the
+	// scene's vertices if they end before that. Used to stream meshes in, see ResourceStreamer.
+	virtual void UploadSceneVertices(unsigned int firstVertex, const Vertex* vertices, unsigned int vertexCount) = 0;
+
+	/*
+		Constants for the scene's vertex shaders are sub-allocated from one buffer per device, see
+		ConstantRingAllocator. For each batch of draws (at least one per frame) call BeginConstants,
+		then AllocateConstants for everything the batch needs and write the constants into the
+		returned memory, and then EndConstants. The memory is only valid until EndConstants. The
+		allocations can only be used by the draws of the same batch: before each draw,
+		BindConstants selects the allocation (by the offset AllocateConstants returned) for a slot.
+		Returns nullptr if size is larger than the whole buffer. The returned memory may be written
+		from any thread.
+	*/
+	virtual void BeginConstants() = 0;
+	virtual void* AllocateConstants(unsigned int size, unsigned int& outOffset) = 0;
+	virtual void EndConstants() = 0;
+
+	/*
+		Recording commands on several threads at once. BeginRecording returns context number
+		context (below MaxRecordingContexts), set up as if BindEyeTexture and SetStereoMode with
+		the current mode had been called on it. Each context may be used by one thread at a time,
+		different contexts by different threads. Once all are done with EndRecording,
+		ExecuteRecordings runs contexts 0 to count - 1 in order and forgets what they recorded.
+
+		Recorded commands may only use constants of the current batch, and ExecuteRecordings has to
+		be called after EndConstants.
+	*/
+	virtual RenderContext& BeginRecording(int context) = 0;
+	virtual void EndRecording(int context) = 0;
+	virtual void ExecuteRecordings(int count) = 0;
+
+	/*
+		Late latching. Draws that bind a part of the latched constants with BindLatchedConstants
+		see whatever the last LatchConstants before their execution wrote to it, not what was
+		there when they were recorded. That way the view can be updated with a newer pose after
+		the frame has been recorded, right before ExecuteRecordings.
+	*/
+	virtual void LatchConstants(int part, const void* data, unsigned int size) = 0;
+
+	/*
+		Fixed foveated rendering, see FoveatedLayout.h. With a layout set ClearEyeTexture,
+		BindEyeTexture and the recording contexts use a separate foveated target instead of the eye
+		texture, and ResolveEyeTexture composites its regions into the eye texture (or the
+		intermediary) where LibOVR expects them. nullptr switches back to drawing into the eye
+		texture directly. The layout is copied, and has to be set before ClearEyeTexture.
+	*/
+	virtual void SetFoveatedLayout(const FoveatedLayout* layout) = 0;
+
+	/*
+		GPU driven drawing. SetSceneInstances hands the device every object of the scene and a
+		draw per mesh: VertexCountPerInstance (0 for a mesh that can't be drawn yet) and
+		StartVertexLocation as for Draw, InstanceCount 0, and StartInstanceLocation where the
+		mesh's visible instances are listed, with room for every instance of the mesh. Both are
+		copied. Returns false if the device can't draw this way, and then forgets the instances.
+
+		Each frame CullSceneInstances tests every instance's bounds against the frustum and lists
+		the visible ones by mesh, each counting as EyeCount instances with StereoMode_Instanced.
+		DrawSceneInstances then draws them into the bound viewport with the bound frame constants,
+		an indirect draw per mesh, the world matrices and materials coming from the instances. On
+		a GPU the cull is a compute pass, so neither call costs the CPU more with more objects.
+		Only on the device, not on recording contexts; the stereo mode has to be set before the
+		cull.
+	*/
+	virtual bool SetSceneInstances(const SceneInstance* instances, unsigned int instanceCount, const IndirectDrawArgs* meshDraws, unsigned int meshCount) = 0;
+	virtual void CullSceneInstances(const Frustum& frustum) = 0;
+	virtual void DrawSceneInstances() = 0;
+
+	// Resolves the multisampled eye texture into the intermediary, compositing the foveated target
+	// first if there is one. Does nothing without multisampling or foveation.
+	virtual void ResolveEyeTexture() = 0;
+
+	/*
+		Distorting the frame ourselves rather than leaving it to the HMD, see Distortion.h.
+		SetDistortionMesh hands the device an eye's mesh once, copied; returns false if the device
+		can't distort or the mesh isn't valid (see IsValidDistortionMesh). PresentDistorted then
+		draws the resolved eye texture through both meshes onto the display, with the given
+		constants, and presents it. After ResolveEyeTexture.
+	*/
+	virtual bool SetDistortionMesh(int eye, const DistortionMesh& mesh) = 0;
+	virtual void PresentDistorted(const DistortionConstants constants[EyeCount]) = 0;
+
+	/*
+		Fusing the resolve into the distortion. With multisampling and no foveation
+		PresentDistorted then samples the multisampled eye texture and averages its samples itself,
+		only where the meshes look, so ResolveEyeTexture does nothing and there is no intermediary
+		(see DeclareEyeFrameGraph). Only for PresentDistorted, LibOVR can't sample a multisampled
+		texture. Returns false if the device can't; takes effect with the next BindEyeTexture.
+	*/
+	virtual bool SetFusedResolve(bool fused) = 0;
+
+	/*
+		Hidden area masking, see HiddenArea.h. SetHiddenAreaMesh hands the device an eye's mesh
+		once, copied; returns false if the device can't mask. With viewports set, BindEyeTexture
+		writes each eye's mesh into its viewport of the depth buffer at depth 0 after the clears,
+		and ClearEyeTexture may leave the hidden area as it was. nullptr stops masking. Has to be
+		set before ClearEyeTexture, and is ignored with a foveated layout.
+	*/
+	virtual bool SetHiddenAreaMesh(int eye, const HiddenAreaMesh& mesh) = 0;
+	virtual void SetHiddenAreaViewports(const Rect2i* viewports) = 0;
+
+	/*
+		Measuring how long the GPU takes for the work between BeginGpuTimer and EndGpuTimer, once
+		per frame. The result takes a few frames to come back, GetGpuFrameTime returns the latest
+		one in seconds. Returns false if the device can't measure it or nothing came back yet.
+	*/
+	virtual void BeginGpuTimer() = 0;
+	virtual void EndGpuTimer() = 0;
+	virtual bool GetGpuFrameTime(double& outSeconds) = 0;
+};
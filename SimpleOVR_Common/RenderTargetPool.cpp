@@ -0,0 +1,232 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#include "RenderTargetPool.h"
+#include <algorithm>
+#include <cstring>
+
+bool operator==(const RenderTargetDesc& a, const RenderTargetDesc& b) {
+	return a.Size.w == b.Size.w && a.Size.h == b.Size.h && a.Format == b.Format && a.SampleCount == b.SampleCount && a.BindFlags == b.BindFlags;
+}
+
+unsigned long long GetRenderTargetBytes(const RenderTargetDesc& desc) {
+	return static_cast<unsigned long long>(desc.Size.w) * desc.Size.h * desc.SampleCount * 4;
+}
+
+RenderTargetPlan::RenderTargetPlan() {
+	std::memset(&statistics, 0, sizeof(statistics));
+}
+
+void RenderTargetPlan::Clear() {
+	targets.clear();
+	textures.clear();
+	std::memset(&statistics, 0, sizeof(statistics));
+}
+
+int RenderTargetPlan::AddTarget(const RenderTargetDesc& desc) {
+	Target target;
+	target.Desc = desc;
+	target.FirstPass = -1;
+	target.LastPass = -1;
+	target.Texture = -1;
+	targets.push_back(target);
+	return static_cast<int>(targets.size()) - 1;
+}
+
+void RenderTargetPlan::UseTarget(int target, int pass) {
+	Target& used = targets[target];
+	if (used.FirstPass < 0) {
+		used.FirstPass = pass;
+		used.LastPass = pass;
+	}
+	else {
+		used.FirstPass = std::min(used.FirstPass, pass);
+		used.LastPass = std::max(used.LastPass, pass);
+	}
+}
+
+void RenderTargetPlan::Compile() {
+	textures.clear();
+	std::memset(&statistics, 0, sizeof(statistics));
+
+	// By first pass, ties in the order of declaration.
+	std::vector<int> order;
+	int lastPass = -1;
+	for (size_t i = 0; i < targets.size(); i++) {
+		targets[i].Texture = -1;
+		if (targets[i].FirstPass >= 0) {
+			order.push_back(static_cast<int>(i));
+			lastPass = std::max(lastPass, targets[i].LastPass);
+			statistics.RequestedBytes += GetRenderTargetBytes(targets[i].Desc);
+		}
+	}
+	std::stable_sort(order.begin(), order.end(), [this](int a, int b) {
+		return targets[a].FirstPass < targets[b].FirstPass;
+	});
+
+	// Every target goes into the first alike texture that's free by then.
+	for (size_t i = 0; i < order.size(); i++) {
+		Target& target = targets[order[i]];
+		for (size_t t = 0; t < textures.size() && target.Texture < 0; t++) {
+			if (textures[t].Desc == target.Desc && textures[t].LastPass < target.FirstPass) {
+				target.Texture = static_cast<int>(t);
+			}
+		}
+		if (target.Texture < 0) {
+			Texture texture;
+			texture.Desc = target.Desc;
+			textures.push_back(texture);
+			target.Texture = static_cast<int>(textures.size()) - 1;
+			statistics.AllocatedBytes += GetRenderTargetBytes(target.Desc);
+		}
+		textures[target.Texture].LastPass = target.LastPass;
+	}
+
+	for (int pass = 0; pass <= lastPass; pass++) {
+		unsigned long long liveBytes = 0;
+		for (size_t i = 0; i < targets.size(); i++) {
+			if (targets[i].FirstPass >= 0 && targets[i].FirstPass <= pass && pass <= targets[i].LastPass) {
+				liveBytes += GetRenderTargetBytes(targets[i].Desc);
+			}
+		}
+		statistics.PeakBytes = std::max(statistics.PeakBytes, liveBytes);
+	}
+	statistics.AliasedBytes = statistics.RequestedBytes - statistics.AllocatedBytes;
+	statistics.Textures = static_cast<int>(textures.size());
+}
+
+int RenderTargetPlan::GetTargetCount() const {
+	return static_cast<int>(targets.size());
+}
+
+const RenderTargetDesc& RenderTargetPlan::GetTargetDesc(int target) const {
+	return targets[target].Desc;
+}
+
+bool RenderTargetPlan::IsTargetUsed(int target) const {
+	return targets[target].FirstPass >= 0;
+}
+
+int RenderTargetPlan::GetFirstPass(int target) const {
+	return targets[target].FirstPass;
+}
+
+int RenderTargetPlan::GetLastPass(int target) const {
+	return targets[target].LastPass;
+}
+
+int RenderTargetPlan::GetTexture(int target) const {
+	return targets[target].Texture;
+}
+
+int RenderTargetPlan::GetTextureCount() const {
+	return static_cast<int>(textures.size());
+}
+
+const RenderTargetDesc& RenderTargetPlan::GetTextureDesc(int texture) const {
+	return textures[texture].Desc;
+}
+
+const RenderTargetPlan::Statistics& RenderTargetPlan::GetStatistics() const {
+	return statistics;
+}
+
+RenderTargetPool::RenderTargetPool() {
+	std::memset(&statistics, 0, sizeof(statistics));
+}
+
+void RenderTargetPool::Apply(const RenderTargetPlan& plan, std::vector<int>& outCreated, std::vector<int>& outReleased) {
+	outCreated.clear();
+	outReleased.clear();
+
+	std::vector<bool> taken(slots.size(), false);
+	textureSlots.assign(plan.GetTextureCount(), -1);
+	for (int target = 0; target < plan.GetTargetCount(); target++) {
+		int texture = plan.GetTexture(target);
+		if (texture < 0 || textureSlots[texture] >= 0) {
+			continue;
+		}
+		const RenderTargetDesc& desc = plan.GetTextureDesc(texture);
+		for (size_t slot = 0; slot < slots.size() && textureSlots[texture] < 0; slot++) {
+			if (slots[slot].Used && !taken[slot] && slots[slot].Desc == desc) {
+				textureSlots[texture] = static_cast<int>(slot);
+				taken[slot] = true;
+				statistics.Reuses++;
+			}
+		}
+	}
+
+	// What's left over goes, then the textures without a slot get one, empty ones first.
+	for (size_t slot = 0; slot < slots.size(); slot++) {
+		if (slots[slot].Used && !taken[slot]) {
+			slots[slot].Used = false;
+			outReleased.push_back(static_cast<int>(slot));
+			statistics.Releases++;
+			statistics.Bytes -= GetRenderTargetBytes(slots[slot].Desc);
+			statistics.Textures--;
+		}
+	}
+	for (int texture = 0; texture < plan.GetTextureCount(); texture++) {
+		if (textureSlots[texture] >= 0) {
+			continue;
+		}
+		int slot = 0;
+		while (slot < static_cast<int>(slots.size()) && slots[slot].Used) {
+			slot++;
+		}
+		if (slot == static_cast<int>(slots.size())) {
+			slots.push_back(Slot());
+		}
+		slots[slot].Desc = plan.GetTextureDesc(texture);
+		slots[slot].Used = true;
+		textureSlots[texture] = slot;
+		outCreated.push_back(slot);
+		statistics.Creations++;
+		statistics.Bytes += GetRenderTargetBytes(slots[slot].Desc);
+		statistics.Textures++;
+	}
+}
+
+int RenderTargetPool::GetSlot(int texture) const {
+	return textureSlots[texture];
+}
+
+int RenderTargetPool::GetSlotCount() const {
+	return static_cast<int>(slots.size());
+}
+
+bool RenderTargetPool::IsSlotUsed(int slot) const {
+	return slots[slot].Used;
+}
+
+const RenderTargetDesc& RenderTargetPool::GetSlotDesc(int slot) const {
+	return slots[slot].Desc;
+}
+
+const RenderTargetPool::Statistics& RenderTargetPool::GetStatistics() const {
+	return statistics;
+}
@@ -0,0 +1,166 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#pragma once
+
+#include "VrTypes.h"
+#include <vector>
+
+/*
+	Render targets planned the way a frame graph does it. Each frame declares the targets it
+	draws through and the passes that use them, and RenderTargetPlan works out how many textures
+	that actually takes: a target is live from its first to its last pass, and targets that are
+	never live at the same time share a texture if they are created alike (same size, format,
+	sample count and bind flags). D3D11 can't place differently created textures in the same
+	memory, so that is as far as aliasing goes. Targets that no pass uses take nothing.
+
+	RenderTargetPool keeps the textures between plans, keyed by how they are created. Applying a
+	new plan (foveation switched on, a new eye texture size) reuses the textures that match and
+	only creates and releases the difference.
+
+	Neither touches a device; the device creates and releases the textures the pool tells it to.
+	FrameGraph builds plans from the passes it schedules.
+*/
+
+enum RenderTargetFormat {
+	RenderTargetFormat_Color, // R8G8B8A8_UNORM
+	RenderTargetFormat_DepthStencil, // D24_UNORM_S8_UINT
+	RenderTargetFormatCount
+};
+
+enum RenderTargetBindFlags {
+	RenderTargetBind_RenderTarget = 1,
+	RenderTargetBind_ShaderResource = 2,
+	RenderTargetBind_DepthStencil = 4
+};
+
+struct RenderTargetDesc {
+	Size2i Size;
+	RenderTargetFormat Format;
+	int SampleCount;
+	unsigned int BindFlags; // RenderTargetBindFlags
+};
+
+bool operator==(const RenderTargetDesc& a, const RenderTargetDesc& b);
+
+// What a target takes in video memory, roughly: every format used is 4 bytes per sample.
+unsigned long long GetRenderTargetBytes(const RenderTargetDesc& desc);
+
+class RenderTargetPlan {
+public:
+	struct Statistics {
+		unsigned long long RequestedBytes; // Every used target in a texture of its own
+		unsigned long long PeakBytes; // The most that is live during any one pass
+		unsigned long long AllocatedBytes; // The textures the plan takes
+		unsigned long long AliasedBytes; // Saved by sharing, RequestedBytes - AllocatedBytes
+		int Textures;
+	};
+
+	RenderTargetPlan();
+
+	// Forgets all targets.
+	void Clear();
+
+	// Declares a target and returns its index, counting from 0 in the order of declaration.
+	int AddTarget(const RenderTargetDesc& desc);
+
+	// Pass pass reads or writes target. Passes are numbered in the order they run.
+	void UseTarget(int target, int pass);
+
+	// Assigns the targets to textures. Until the next Clear or AddTarget.
+	void Compile();
+
+	int GetTargetCount() const;
+	const RenderTargetDesc& GetTargetDesc(int target) const;
+	bool IsTargetUsed(int target) const;
+	int GetFirstPass(int target) const; // -1 if unused
+	int GetLastPass(int target) const;
+
+	// The texture a target was assigned, -1 if no pass uses it.
+	int GetTexture(int target) const;
+	int GetTextureCount() const;
+	const RenderTargetDesc& GetTextureDesc(int texture) const;
+
+	const Statistics& GetStatistics() const;
+
+private:
+	struct Target {
+		RenderTargetDesc Desc;
+		int FirstPass; // -1 if unused
+		int LastPass;
+		int Texture;
+	};
+
+	struct Texture {
+		RenderTargetDesc Desc;
+		int LastPass;
+	};
+
+	std::vector<Target> targets;
+	std::vector<Texture> textures;
+	Statistics statistics;
+};
+
+class RenderTargetPool {
+public:
+	struct Statistics {
+		int Textures;
+		unsigned long long Bytes;
+		unsigned long long Creations;
+		unsigned long long Releases;
+		unsigned long long Reuses; // Textures kept from the previous plan
+	};
+
+	RenderTargetPool();
+
+	/*
+		Gives every texture of the plan a slot of the pool: a slot with the same desc that the
+		previous plan had, or a new one. The plan's textures get slots in the order of the first
+		target using them, each the lowest matching one, so a target that is declared first
+		keeps its texture as long as its desc stays the same. The slots the device has to create
+		textures for and the ones it has to release (before creating any) are returned.
+	*/
+	void Apply(const RenderTargetPlan& plan, std::vector<int>& outCreated, std::vector<int>& outReleased);
+
+	// The slot a texture of the last applied plan is in.
+	int GetSlot(int texture) const;
+	int GetSlotCount() const;
+	bool IsSlotUsed(int slot) const;
+	const RenderTargetDesc& GetSlotDesc(int slot) const;
+
+	const Statistics& GetStatistics() const;
+
+private:
+	struct Slot {
+		RenderTargetDesc Desc;
+		bool Used;
+	};
+
+	std::vector<Slot> slots;
+	std::vector<int> textureSlots;
+	Statistics statistics;
+};
@@ -0,0 +1,114 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#include "ResolutionController.h"
+#include <algorithm>
+
+ResolutionController::Settings ResolutionController::GetDefaultSettings(double refreshRate) {
+	Settings settings;
+	settings.TargetFrameTime = 0.85 / refreshRate;
+	settings.MinScale = 0.5f;
+	settings.MaxScale = 1.0f;
+	settings.Headroom = 0.1f;
+	settings.Smoothing = 0.25f;
+	settings.ProportionalGain = 0.25f;
+	settings.IntegralGain = 0.02f;
+	settings.MaxIncrease = 0.02f;
+	settings.MaxDecrease = 0.1f;
+	return settings;
+}
+
+ResolutionController::ResolutionController() :
+	settings(GetDefaultSettings(DefaultRefreshRate))
+{
+	Reset(settings.MaxScale);
+}
+
+ResolutionController::ResolutionController(const Settings& settings) :
+	settings(settings)
+{
+	Reset(settings.MaxScale);
+}
+
+float ResolutionController::Update(double frameTime) {
+	// A moving average, so a single slow frame doesn't throw the scale around.
+	if (hasFrameTime) {
+		smoothedFrameTime += settings.Smoothing * (frameTime - smoothedFrameTime);
+	}
+	else {
+		smoothedFrameTime = frameTime;
+		hasFrameTime = true;
+	}
+
+	// Relative error against the edge of the band we are outside of. Inside it nothing changes
+	// and the integral starts over, so old errors don't push the scale out of the band again.
+	double target = settings.TargetFrameTime;
+	double growBelow = target * (1.0 - settings.Headroom);
+	double error;
+	if (smoothedFrameTime > target) {
+		error = (target - smoothedFrameTime) / target;
+	}
+	else if (smoothedFrameTime < growBelow) {
+		error = (growBelow - smoothedFrameTime) / target;
+	}
+	else {
+		integral = 0.0;
+		return scale;
+	}
+
+	// Don't wind up the integral against a limit the scale is already at.
+	bool atLimit = (error > 0.0 && scale >= settings.MaxScale) || (error < 0.0 && scale <= settings.MinScale);
+	if (!atLimit) {
+		integral += error;
+	}
+
+	// The frame time goes with the square of the scale, so half the relative error is about
+	// the relative change of the scale that would fix it in one go.
+	double step = scale * 0.5 * (settings.ProportionalGain * error + settings.IntegralGain * integral);
+	step = std::max(-static_cast<double>(settings.MaxDecrease), std::min(static_cast<double>(settings.MaxIncrease), step));
+	scale = static_cast<float>(std::max(static_cast<double>(settings.MinScale), std::min(static_cast<double>(settings.MaxScale), scale + step)));
+	return scale;
+}
+
+void ResolutionController::Reset(float scale) {
+	this->scale = std::max(settings.MinScale, std::min(settings.MaxScale, scale));
+	smoothedFrameTime = 0.0;
+	integral = 0.0;
+	hasFrameTime = false;
+}
+
+float ResolutionController::GetScale() const {
+	return scale;
+}
+
+double ResolutionController::GetSmoothedFrameTime() const {
+	return smoothedFrameTime;
+}
+
+const ResolutionController::Settings& ResolutionController::GetSettings() const {
+	return settings;
+}
@@ -0,0 +1,85 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#pragma once
+
+/*
+	Picks the resolution of the eye buffers from measured frame times, so the GPU keeps up with the
+	HMD's refresh rate. The eye textures are allocated at the largest size and the frame loop draws
+	into a viewport of Scale times that size, see RenderFrame.
+
+	The cost of a frame is assumed to grow with the number of pixels, i.e. with the square of the
+	scale. The scale follows a PI controller on the relative error of the (smoothed) frame time,
+	with a band of hysteresis below the target: above the target the scale drops, below
+	(1 - Headroom) * target it grows, and in between it stays put. That keeps it from hunting
+	back and forth over a single step while the load is steady, and leaves some room for the load
+	to vary before the target is missed. Decreases are allowed to be larger than increases, since
+	missing the target is worse than rendering a bit blurrier for a while.
+
+	Nothing here depends on the clock or the GPU, so it can be driven by any frame-time trace.
+*/
+class ResolutionController {
+public:
+	struct Settings {
+		double TargetFrameTime; // Seconds
+		float MinScale;
+		float MaxScale;
+		float Headroom; // Fraction of the target the frame time has to stay below before growing
+		float Smoothing; // Weight of the newest frame time in the moving average, 0 to 1
+		float ProportionalGain;
+		float IntegralGain;
+		float MaxIncrease; // Largest change of the scale per frame
+		float MaxDecrease;
+	};
+
+	// The DK2's.
+	static const int DefaultRefreshRate = 75;
+
+	// Settings that work for a refresh rate in Hz, leaving a little time for distortion.
+	static Settings GetDefaultSettings(double refreshRate);
+
+	// Both start at the largest scale, the first with the default settings for DefaultRefreshRate.
+	ResolutionController();
+	explicit ResolutionController(const Settings& settings);
+
+	// Takes the time of the latest frame in seconds and returns the scale for the next one.
+	float Update(double frameTime);
+
+	// Forgets the history and continues from scale.
+	void Reset(float scale);
+
+	float GetScale() const;
+	double GetSmoothedFrameTime() const;
+	const Settings& GetSettings() const;
+
+private:
+	Settings settings;
+	float scale;
+	double smoothedFrameTime;
+	double integral;
+	bool hasFrameTime;
+};
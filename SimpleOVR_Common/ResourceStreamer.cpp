@@ -0,0 +1,345 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#include "ResourceStreamer.h"
+#include <algorithm>
+#include <cstring>
+
+const unsigned int ResourceStreamer::BlockSize;
+
+ResourceStreamer::ResourceStreamer(int threadCount, unsigned int stagingCapacity, unsigned int bytesPerFrame) :
+	stagingCapacity(std::max(stagingCapacity, 2 * BlockSize)),
+	bytesPerFrame(bytesPerFrame),
+	stagingHead(0),
+	stageRequest(0),
+	stageMesh(0),
+	stageVertex(0),
+	quitting(false)
+{
+	std::memset(&statistics, 0, sizeof(statistics));
+	staging.resize(this->stagingCapacity);
+	for (int i = 0; i < std::max(threadCount, 1); i++) {
+		workers.push_back(std::thread(&ResourceStreamer::WorkerMain, this));
+	}
+}
+
+ResourceStreamer::~ResourceStreamer() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		quitting = true;
+	}
+	workCondition.notify_all();
+	for (size_t i = 0; i < workers.size(); i++) {
+		workers[i].join();
+	}
+}
+
+int ResourceStreamer::RequestMeshFile(const char* path) {
+	std::unique_ptr<FileRequest> request(new FileRequest);
+	request->Path = path;
+	request->RequestState = State_Queued;
+	request->VertexData = nullptr;
+	request->ResidentMeshes = 0;
+	request->Registered = false;
+
+	int handle;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		requests.push_back(std::move(request));
+		handle = static_cast<int>(requests.size()) - 1;
+	}
+	workCondition.notify_all();
+	return handle;
+}
+
+void ResourceStreamer::CommitUploads(Scene& scene, RenderDevice& device) {
+	std::unique_lock<std::mutex> lock(mutex);
+	statistics.Commits++;
+
+	for (size_t i = 0; i < requests.size(); i++) {
+		if (requests[i]->RequestState == State_Ready && !requests[i]->Registered) {
+			RegisterMeshes(*requests[i], scene);
+		}
+	}
+
+	// Staged blocks from the front of the ring, up to the budget.
+	committing.clear();
+	unsigned int committedBytes = 0;
+	for (size_t i = 0; i < blocks.size() && blocks[i].Staged; i++) {
+		unsigned int size = blocks[i].VertexCount * sizeof(Vertex);
+		if (!committing.empty() && committedBytes + size > bytesPerFrame) {
+			statistics.BudgetStalls++;
+			break;
+		}
+		committing.push_back(blocks[i]);
+		committedBytes += size;
+	}
+	lock.unlock();
+
+	// The workers only append to the ring, so the memory of these blocks stays put. The requests
+	// and their meshes are only changed by this thread.
+	for (size_t i = 0; i < committing.size(); i++) {
+		const StagedBlock& block = committing[i];
+		int sceneMesh = requests[block.Request]->Meshes[block.Mesh].SceneMesh;
+		const Vertex* vertices = reinterpret_cast<const Vertex*>(&staging[block.Offset]);
+		scene.SetMeshVertices(sceneMesh, block.FirstVertex, vertices, block.VertexCount);
+		device.UploadSceneVertices(scene.GetMesh(sceneMesh).FirstVertex + block.FirstVertex, vertices, block.VertexCount);
+	}
+
+	lock.lock();
+	for (size_t i = 0; i < committing.size(); i++) {
+		const StagedBlock& block = committing[i];
+		FileRequest& request = *requests[block.Request];
+		MeshLoad& mesh = request.Meshes[block.Mesh];
+		mesh.CommittedVertices += block.VertexCount;
+		if (mesh.CommittedVertices == mesh.Entry.VertexCount) {
+			FinishMesh(request, mesh, scene);
+		}
+		statistics.StagingBytes -= block.VertexCount * sizeof(Vertex);
+		blocks.pop_front();
+	}
+	statistics.Uploads += committing.size();
+	statistics.LastFrameBytes = committedBytes;
+	statistics.CommittedBytes += committedBytes;
+	lock.unlock();
+
+	if (!committing.empty()) {
+		// There is staging space again.
+		workCondition.notify_all();
+	}
+}
+
+int ResourceStreamer::GetMeshCount(int request) const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return requests[request]->Registered ? static_cast<int>(requests[request]->Meshes.size()) : 0;
+}
+
+int ResourceStreamer::GetSceneMesh(int request, int mesh) const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return requests[request]->Meshes[mesh].SceneMesh;
+}
+
+bool ResourceStreamer::IsComplete(int request) const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return requests[request]->RequestState == State_Done;
+}
+
+bool ResourceStreamer::IsFailed(int request) const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return requests[request]->RequestState == State_Failed;
+}
+
+unsigned int ResourceStreamer::GetStagingCapacity() const {
+	return stagingCapacity;
+}
+
+unsigned int ResourceStreamer::GetBytesPerFrame() const {
+	return bytesPerFrame;
+}
+
+ResourceStreamer::Statistics ResourceStreamer::GetStatistics() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	Statistics current = statistics;
+	current.QueueDepth = static_cast<unsigned int>(blocks.size());
+	current.PendingFiles = 0;
+	for (size_t i = 0; i < requests.size(); i++) {
+		if (requests[i]->RequestState != State_Done && requests[i]->RequestState != State_Failed) {
+			current.PendingFiles++;
+		}
+	}
+	return current;
+}
+
+void ResourceStreamer::WorkerMain() {
+	std::unique_lock<std::mutex> lock(mutex);
+	while (!quitting) {
+		// Headers come first, so the meshes are known (and can be placed) as early as possible.
+		FileRequest* opening = nullptr;
+		for (size_t i = 0; i < requests.size() && opening == nullptr; i++) {
+			if (requests[i]->RequestState == State_Queued) {
+				opening = requests[i].get();
+			}
+		}
+		if (opening != nullptr) {
+			opening->RequestState = State_Opening;
+			lock.unlock();
+			bool opened = OpenFile(*opening);
+			lock.lock();
+			if (opened) {
+				opening->RequestState = State_Ready;
+			}
+			else {
+				opening->RequestState = State_Failed;
+				statistics.Failures++;
+			}
+			workCondition.notify_all();
+			continue;
+		}
+
+		StagedBlock* block;
+		bool outOfSpace;
+		if (!ClaimBlock(block, outOfSpace)) {
+			if (outOfSpace) {
+				statistics.StagingStalls++;
+			}
+			workCondition.wait(lock);
+			continue;
+		}
+
+		// Reading from the mapping is what pulls the file in from the disk.
+		const FileRequest& request = *requests[block->Request];
+		const MeshLoad& mesh = request.Meshes[block->Mesh];
+		const unsigned char* source = request.VertexData + (mesh.Entry.FirstVertex + block->FirstVertex) * sizeof(Vertex);
+		unsigned char* destination = &staging[block->Offset];
+		size_t size = block->VertexCount * sizeof(Vertex);
+		lock.unlock();
+		std::memcpy(destination, source, size);
+		lock.lock();
+		block->Staged = true;
+	}
+}
+
+bool ResourceStreamer::OpenFile(FileRequest& request) {
+	MeshFileHeader header;
+	std::vector<MeshFileEntry> entries;
+	if (!request.File.Open(request.Path.c_str()) || !ReadMeshFileHeader(request.File.GetData(), request.File.GetSize(), header, entries)) {
+		request.File.Close();
+		return false;
+	}
+
+	request.VertexData = request.File.GetData() + sizeof(MeshFileHeader) + entries.size() * sizeof(MeshFileEntry);
+	request.Meshes.resize(entries.size());
+	for (size_t i = 0; i < entries.size(); i++) {
+		request.Meshes[i].Entry = entries[i];
+		request.Meshes[i].SceneMesh = -1;
+		request.Meshes[i].CommittedVertices = 0;
+	}
+	return true;
+}
+
+bool ResourceStreamer::ClaimBlock(StagedBlock*& outBlock, bool& outOutOfSpace) {
+	outOutOfSpace = false;
+	const unsigned int blockVertices = BlockSize / sizeof(Vertex);
+	while (stageRequest < static_cast<int>(requests.size())) {
+		const FileRequest& request = *requests[stageRequest];
+		if (request.RequestState == State_Queued || request.RequestState == State_Opening) {
+			// Files are staged in order, this one's header isn't read yet.
+			return false;
+		}
+		if (request.RequestState == State_Failed || stageMesh == static_cast<int>(request.Meshes.size())) {
+			stageRequest++;
+			stageMesh = 0;
+			stageVertex = 0;
+			continue;
+		}
+		const MeshLoad& mesh = request.Meshes[stageMesh];
+		if (stageVertex == mesh.Entry.VertexCount) {
+			stageMesh++;
+			stageVertex = 0;
+			continue;
+		}
+
+		StagedBlock block;
+		block.Request = stageRequest;
+		block.Mesh = stageMesh;
+		block.FirstVertex = stageVertex;
+		block.VertexCount = std::min(mesh.Entry.VertexCount - stageVertex, blockVertices);
+		block.Staged = false;
+		if (!AllocateStaging(block.VertexCount * sizeof(Vertex), block.Offset)) {
+			outOutOfSpace = true;
+			return false;
+		}
+		statistics.StagingBytes += block.VertexCount * sizeof(Vertex);
+		stageVertex += block.VertexCount;
+
+		// Elements of a deque stay where they are as others are added and removed at the ends.
+		blocks.push_back(block);
+		outBlock = &blocks.back();
+		return true;
+	}
+	return false;
+}
+
+bool ResourceStreamer::AllocateStaging(unsigned int size, unsigned int& outOffset) {
+	if (blocks.empty()) {
+		outOffset = 0;
+	}
+	else {
+		unsigned int tail = blocks.front().Offset;
+		if (stagingHead > tail) {
+			// In use: [tail, head). Wrapping around leaves the end of the ring unused.
+			if (stagingCapacity - stagingHead >= size) {
+				outOffset = stagingHead;
+			}
+			else if (tail > size) {
+				outOffset = 0;
+			}
+			else {
+				return false;
+			}
+		}
+		else {
+			// In use: [tail, capacity) and [0, head). The head never catches up with the tail, or
+			// a full ring would look the same as an empty one.
+			if (tail - stagingHead > size) {
+				outOffset = stagingHead;
+			}
+			else {
+				return false;
+			}
+		}
+	}
+	stagingHead = outOffset + size;
+	return true;
+}
+
+void ResourceStreamer::RegisterMeshes(FileRequest& request, Scene& scene) {
+	request.Registered = true;
+	for (size_t i = 0; i < request.Meshes.size(); i++) {
+		MeshLoad& mesh = request.Meshes[i];
+		const MeshFileEntry& entry = mesh.Entry;
+		Vector3 boundsCenter = { entry.BoundsCenter[0], entry.BoundsCenter[1], entry.BoundsCenter[2] };
+		mesh.SceneMesh = scene.ReserveMesh(entry.VertexCount, boundsCenter, entry.BoundsRadius);
+		if (entry.VertexCount == 0) {
+			FinishMesh(request, mesh, scene);
+		}
+	}
+	if (request.Meshes.empty()) {
+		request.RequestState = State_Done;
+		request.File.Close();
+	}
+}
+
+void ResourceStreamer::FinishMesh(FileRequest& request, MeshLoad& mesh, Scene& scene) {
+	scene.MakeMeshResident(mesh.SceneMesh);
+	request.ResidentMeshes++;
+	if (request.ResidentMeshes == request.Meshes.size()) {
+		// Nothing reads the mapping anymore.
+		request.RequestState = State_Done;
+		request.File.Close();
+	}
+}
@@ -0,0 +1,164 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#pragma once
+
+#include "MappedFile.h"
+#include "Scene.h"
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+	Streams meshes in from mesh files without the frame loop ever waiting for the disk.
+
+	Background threads map the requested files, check their headers and copy the vertices out of
+	the mapping (which is where the pages are actually read) into a staging buffer, a block of at
+	most BlockSize bytes at a time. The staging buffer is allocated once and used as a ring; when
+	it is full the threads wait for the render thread to drain it, so a large file never takes
+	more memory than that.
+
+	CommitUploads, called once per frame on the render thread, takes what has been staged so far:
+	it adds the meshes of files whose headers have been read to the scene (not resident yet, see
+	Scene::ReserveMesh) and uploads staged blocks, in order, to the scene and the device until
+	bytesPerFrame is used up. At least one block goes per frame so a small budget still makes
+	progress. A mesh becomes resident once its last block is committed. CommitUploads only takes
+	the lock for bookkeeping and never waits for the threads, if nothing is staged yet it
+	simply returns.
+
+	All functions are meant to be called from the render thread. The scene and the device are
+	only touched by CommitUploads, never by the background threads.
+*/
+class ResourceStreamer {
+public:
+	static const unsigned int BlockSize = 64 * 1024;
+
+	struct Statistics {
+		unsigned int QueueDepth; // Blocks staged or being read, waiting to be committed
+		unsigned int PendingFiles; // Requested but not completely committed
+		unsigned int StagingBytes; // Staging memory in use
+		unsigned int LastFrameBytes; // Committed by the last CommitUploads
+		unsigned long long CommittedBytes;
+		unsigned long long Commits; // CommitUploads calls
+		unsigned long long Uploads; // Blocks committed
+		unsigned long long StagingStalls; // Times a thread had to wait for staging space
+		unsigned long long BudgetStalls; // Commits that left staged blocks for the next frame
+		unsigned long long Failures; // Files that could not be loaded
+	};
+
+	// stagingCapacity is raised to at least two blocks.
+	ResourceStreamer(int threadCount, unsigned int stagingCapacity, unsigned int bytesPerFrame);
+	~ResourceStreamer();
+
+	// Queues a mesh file and returns a handle for the functions below. Files are read in order.
+	int RequestMeshFile(const char* path);
+
+	// Adds what has been staged to scene and device, see above.
+	void CommitUploads(Scene& scene, RenderDevice& device);
+
+	// 0 until CommitUploads added the file's meshes to the scene.
+	int GetMeshCount(int request) const;
+	int GetSceneMesh(int request, int mesh) const;
+
+	// Every mesh of the file is resident.
+	bool IsComplete(int request) const;
+
+	// The file couldn't be opened or is not a valid mesh file. Its meshes never show up.
+	bool IsFailed(int request) const;
+
+	unsigned int GetStagingCapacity() const;
+	unsigned int GetBytesPerFrame() const;
+	Statistics GetStatistics() const;
+
+private:
+	ResourceStreamer(const ResourceStreamer&);
+	ResourceStreamer& operator=(const ResourceStreamer&);
+
+	enum State {
+		State_Queued,
+		State_Opening,
+		State_Ready, // Header read, blocks are being staged
+		State_Done, // Every mesh resident
+		State_Failed
+	};
+
+	struct MeshLoad {
+		MeshFileEntry Entry;
+		int SceneMesh; // -1 until added to the scene
+		unsigned int CommittedVertices;
+	};
+
+	struct FileRequest {
+		std::string Path;
+		State RequestState;
+		MappedFile File;
+		const unsigned char* VertexData; // In the mapping
+		std::vector<MeshLoad> Meshes;
+		unsigned int ResidentMeshes;
+		bool Registered; // Meshes added to the scene
+	};
+
+	// Part of a mesh's vertices in the staging ring.
+	struct StagedBlock {
+		int Request;
+		int Mesh;
+		unsigned int FirstVertex; // From the start of the mesh
+		unsigned int VertexCount;
+		unsigned int Offset; // In the staging ring
+		bool Staged; // Copied in, ready to commit
+	};
+
+	void WorkerMain();
+	bool OpenFile(FileRequest& request);
+	bool ClaimBlock(StagedBlock*& outBlock, bool& outOutOfSpace);
+	bool AllocateStaging(unsigned int size, unsigned int& outOffset);
+	void RegisterMeshes(FileRequest& request, Scene& scene);
+	void FinishMesh(FileRequest& request, MeshLoad& mesh, Scene& scene);
+
+	unsigned int stagingCapacity;
+	unsigned int bytesPerFrame;
+	std::vector<unsigned char> staging;
+	unsigned int stagingHead;
+	std::vector<StagedBlock> committing; // Blocks taken by the current CommitUploads
+
+	// Guards everything below. Workers wait on workCondition for files, blocks to stage and space.
+	mutable std::mutex mutex;
+	std::condition_variable workCondition;
+	std::vector<std::unique_ptr<FileRequest> > requests;
+	std::deque<StagedBlock> blocks; // In staging ring order
+	int stageRequest; // Where staging continues: request, mesh and vertex within the mesh
+	int stageMesh;
+	unsigned int stageVertex;
+	Statistics statistics;
+	bool quitting;
+
+	std::vector<std::thread> workers;
+};
@@ -0,0 +1,340 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#include "Scene.h"
+#include "MappedFile.h"
+#include "VrMath.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+const char MeshFileMagic[8] = { 'S', 'O', 'V', 'R', 'M', 'E', 'S', 'H' };
+
+Scene::Scene() :
+	revision(1)
+{
+}
+
+int Scene::AddMesh(const Vertex* meshVertices, unsigned int vertexCount) {
+	Mesh mesh;
+	mesh.FirstVertex = static_cast<unsigned int>(vertices.size());
+	mesh.VertexCount = vertexCount;
+
+	// Sphere around the center of the bounding box. Not the tightest, but good enough.
+	Vector3 low = { 0.0f, 0.0f, 0.0f };
+	Vector3 high = { 0.0f, 0.0f, 0.0f };
+	for (unsigned int i = 0; i < vertexCount; i++) {
+		const float* p = meshVertices[i].Position;
+		if (i == 0) {
+			low.x = high.x = p[0];
+			low.y = high.y = p[1];
+			low.z = high.z = p[2];
+		}
+		low.x = std::min(low.x, p[0]); high.x = std::max(high.x, p[0]);
+		low.y = std::min(low.y, p[1]); high.y = std::max(high.y, p[1]);
+		low.z = std::min(low.z, p[2]); high.z = std::max(high.z, p[2]);
+	}
+	mesh.BoundsCenter = (low + high) * 0.5f;
+	mesh.BoundsRadius = 0.0f;
+	for (unsigned int i = 0; i < vertexCount; i++) {
+		const float* p = meshVertices[i].Position;
+		Vector3 position = { p[0], p[1], p[2] };
+		Vector3 fromCenter = position - mesh.BoundsCenter;
+		mesh.BoundsRadius = std::max(mesh.BoundsRadius, std::sqrt(Dot(fromCenter, fromCenter)));
+	}
+
+	mesh.Resident = true;
+
+	vertices.insert(vertices.end(), meshVertices, meshVertices + vertexCount);
+	meshes.push_back(mesh);
+	revision++;
+	return static_cast<int>(meshes.size()) - 1;
+}
+
+bool Scene::LoadMeshFile(const char* path) {
+	MappedFile file;
+	MeshFileHeader header;
+	std::vector<MeshFileEntry> entries;
+	if (!file.Open(path) || !ReadMeshFileHeader(file.GetData(), file.GetSize(), header, entries)) {
+		return false;
+	}
+
+	// The file is valid, everything goes in with one copy straight from the mapping.
+	const unsigned char* vertexData = file.GetData() + sizeof(MeshFileHeader) + entries.size() * sizeof(MeshFileEntry);
+	unsigned int firstVertex = static_cast<unsigned int>(vertices.size());
+	vertices.resize(vertices.size() + header.VertexCount);
+	if (header.VertexCount > 0) {
+		memcpy(&vertices[firstVertex], vertexData, header.VertexCount * sizeof(Vertex));
+	}
+	for (size_t i = 0; i < entries.size(); i++) {
+		const MeshFileEntry& entry = entries[i];
+		Mesh mesh;
+		mesh.FirstVertex = firstVertex + entry.FirstVertex;
+		mesh.VertexCount = entry.VertexCount;
+		mesh.BoundsCenter.x = entry.BoundsCenter[0];
+		mesh.BoundsCenter.y = entry.BoundsCenter[1];
+		mesh.BoundsCenter.z = entry.BoundsCenter[2];
+		mesh.BoundsRadius = entry.BoundsRadius;
+		mesh.Resident = true;
+		meshes.push_back(mesh);
+	}
+	revision++;
+	return true;
+}
+
+int Scene::ReserveMesh(unsigned int vertexCount, const Vector3& boundsCenter, float boundsRadius) {
+	Mesh mesh;
+	mesh.FirstVertex = static_cast<unsigned int>(vertices.size());
+	mesh.VertexCount = vertexCount;
+	mesh.BoundsCenter = boundsCenter;
+	mesh.BoundsRadius = boundsRadius;
+	mesh.Resident = false;
+
+	Vertex zero = { { 0.0f, 0.0f, 0.0f } };
+	vertices.resize(vertices.size() + vertexCount, zero);
+	meshes.push_back(mesh);
+	revision++;
+	return static_cast<int>(meshes.size()) - 1;
+}
+
+void Scene::SetMeshVertices(int mesh, unsigned int firstVertex, const Vertex* meshVertices, unsigned int vertexCount) {
+	if (vertexCount > 0) {
+		memcpy(&vertices[meshes[mesh].FirstVertex + firstVertex], meshVertices, vertexCount * sizeof(Vertex));
+	}
+}
+
+void Scene::MakeMeshResident(int mesh) {
+	meshes[mesh].Resident = true;
+	revision++;
+}
+
+unsigned int Scene::AddObject(int mesh, const Vector3& position, const Quaternion& orientation, float objectScale) {
+	objectMesh.push_back(mesh);
+	objectMaterial.push_back(0);
+	positionX.push_back(0.0f); positionY.push_back(0.0f); positionZ.push_back(0.0f);
+	orientationX.push_back(0.0f); orientationY.push_back(0.0f); orientationZ.push_back(0.0f); orientationW.push_back(1.0f);
+	scale.push_back(1.0f);
+	boundsX.push_back(0.0f); boundsY.push_back(0.0f); boundsZ.push_back(0.0f); boundsRadius.push_back(0.0f);
+
+	unsigned int object = static_cast<unsigned int>(objectMesh.size()) - 1;
+	SetObjectTransform(object, position, orientation, objectScale);
+	return object;
+}
+
+void Scene::SetObjectTransform(unsigned int object, const Vector3& position, const Quaternion& orientation, float objectScale) {
+	positionX[object] = position.x;
+	positionY[object] = position.y;
+	positionZ[object] = position.z;
+	orientationX[object] = orientation.x;
+	orientationY[object] = orientation.y;
+	orientationZ[object] = orientation.z;
+	orientationW[object] = orientation.w;
+	scale[object] = objectScale;
+	UpdateBounds(object);
+	revision++;
+}
+
+void Scene::SetObjectMaterial(unsigned int object, int material) {
+	objectMaterial[object] = material;
+	revision++;
+}
+
+int Scene::GetMeshCount() const {
+	return static_cast<int>(meshes.size());
+}
+
+const Mesh& Scene::GetMesh(int mesh) const {
+	return meshes[mesh];
+}
+
+const std::vector<Vertex>& Scene::GetVertices() const {
+	return vertices;
+}
+
+unsigned int Scene::GetObjectCount() const {
+	return static_cast<unsigned int>(objectMesh.size());
+}
+
+int Scene::GetObjectMesh(unsigned int object) const {
+	return objectMesh[object];
+}
+
+int Scene::GetObjectMaterial(unsigned int object) const {
+	return objectMaterial[object];
+}
+
+Vector3 Scene::GetObjectPosition(unsigned int object) const {
+	Vector3 position = { positionX[object], positionY[object], positionZ[object] };
+	return position;
+}
+
+Matrix4 Scene::GetObjectTransposedWorld(unsigned int object) const {
+	Quaternion q = { orientationX[object], orientationY[object], orientationZ[object], orientationW[object] };
+	const Vector3 axes[3] = { { 1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, { 0.0f, 0.0f, 1.0f } };
+	float s = scale[object];
+
+	// Translation * rotation * scale. Transposed, each row is the image of an axis.
+	Matrix4 m;
+	for (int axis = 0; axis < 3; axis++) {
+		Vector3 column = Rotate(q, axes[axis]) * s;
+		m.M[axis][0] = column.x;
+		m.M[axis][1] = column.y;
+		m.M[axis][2] = column.z;
+		m.M[axis][3] = 0.0f;
+	}
+	m.M[3][0] = positionX[object];
+	m.M[3][1] = positionY[object];
+	m.M[3][2] = positionZ[object];
+	m.M[3][3] = 1.0f;
+	return m;
+}
+
+void Scene::GetInstances(std::vector<SceneInstance>& outInstances, std::vector<IndirectDrawArgs>& outMeshDraws) const {
+	// Count each mesh's objects first, then give each mesh that much room.
+	outMeshDraws.resize(meshes.size());
+	for (size_t mesh = 0; mesh < meshes.size(); mesh++) {
+		IndirectDrawArgs& draw = outMeshDraws[mesh];
+		draw.VertexCountPerInstance = meshes[mesh].Resident ? meshes[mesh].VertexCount : 0;
+		draw.InstanceCount = 0;
+		draw.StartVertexLocation = meshes[mesh].FirstVertex;
+		draw.StartInstanceLocation = 0;
+	}
+	for (size_t object = 0; object < objectMesh.size(); object++) {
+		outMeshDraws[objectMesh[object]].StartInstanceLocation++;
+	}
+	unsigned int start = 0;
+	for (size_t mesh = 0; mesh < meshes.size(); mesh++) {
+		unsigned int count = outMeshDraws[mesh].StartInstanceLocation;
+		outMeshDraws[mesh].StartInstanceLocation = start;
+		start += count;
+	}
+
+	outInstances.resize(objectMesh.size());
+	for (unsigned int object = 0; object < GetObjectCount(); object++) {
+		SceneInstance& instance = outInstances[object];
+		instance.TransposedWorld = GetObjectTransposedWorld(object);
+		instance.BoundsCenter[0] = boundsX[object];
+		instance.BoundsCenter[1] = boundsY[object];
+		instance.BoundsCenter[2] = boundsZ[object];
+		instance.BoundsRadius = boundsRadius[object];
+		instance.Mesh = objectMesh[object];
+		instance.Material = objectMaterial[object];
+		instance.Padding[0] = 0;
+		instance.Padding[1] = 0;
+	}
+}
+
+unsigned long long Scene::GetRevision() const {
+	return revision;
+}
+
+void Scene::Cull(const Frustum& frustum, std::vector<unsigned int>& outVisible) const {
+	Cull(frustum, 0, GetObjectCount(), outVisible);
+}
+
+void Scene::Cull(const Frustum& frustum, unsigned int firstObject, unsigned int objectCount, std::vector<unsigned int>& outVisible) const {
+	if (objectCount == 0) {
+		return;
+	}
+
+	size_t first = outVisible.size();
+	CullSpheres(frustum, &boundsX[firstObject], &boundsY[firstObject], &boundsZ[firstObject], &boundsRadius[firstObject], objectCount, outVisible);
+	if (firstObject != 0) {
+		for (size_t i = first; i < outVisible.size(); i++) {
+			outVisible[i] += firstObject;
+		}
+	}
+}
+
+void Scene::UpdateBounds(unsigned int object) {
+	const Mesh& mesh = meshes[objectMesh[object]];
+	Quaternion q = { orientationX[object], orientationY[object], orientationZ[object], orientationW[object] };
+	Vector3 position = { positionX[object], positionY[object], positionZ[object] };
+	Vector3 center = position + Rotate(q, mesh.BoundsCenter * scale[object]);
+	boundsX[object] = center.x;
+	boundsY[object] = center.y;
+	boundsZ[object] = center.z;
+	boundsRadius[object] = mesh.BoundsRadius * std::fabs(scale[object]);
+}
+
+bool ReadMeshFileHeader(const unsigned char* data, size_t size, MeshFileHeader& outHeader, std::vector<MeshFileEntry>& outEntries) {
+	if (size < sizeof(MeshFileHeader)) {
+		return false;
+	}
+	memcpy(&outHeader, data, sizeof(outHeader));
+	if (memcmp(outHeader.Magic, MeshFileMagic, sizeof(MeshFileMagic)) != 0 || outHeader.Version != MeshFileVersion) {
+		return false;
+	}
+
+	// Sizes are checked in 64 bits so a corrupt header can't overflow them into looking valid.
+	unsigned long long entriesSize = static_cast<unsigned long long>(outHeader.MeshCount) * sizeof(MeshFileEntry);
+	unsigned long long verticesSize = static_cast<unsigned long long>(outHeader.VertexCount) * sizeof(Vertex);
+	if (sizeof(MeshFileHeader) + entriesSize + verticesSize != size) {
+		return false;
+	}
+	outEntries.resize(outHeader.MeshCount);
+	if (outHeader.MeshCount > 0) {
+		memcpy(&outEntries[0], data + sizeof(MeshFileHeader), static_cast<size_t>(entriesSize));
+	}
+	for (size_t i = 0; i < outEntries.size(); i++) {
+		const MeshFileEntry& entry = outEntries[i];
+		if (entry.FirstVertex > outHeader.VertexCount || entry.VertexCount > outHeader.VertexCount - entry.FirstVertex) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool SaveMeshFile(const char* path, const Scene& scene) {
+	FILE* file = fopen(path, "wb");
+	if (file == nullptr) {
+		return false;
+	}
+
+	MeshFileHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.Magic, MeshFileMagic, sizeof(MeshFileMagic));
+	header.Version = MeshFileVersion;
+	header.MeshCount = scene.GetMeshCount();
+	header.VertexCount = static_cast<unsigned int>(scene.GetVertices().size());
+	bool written = fwrite(&header, sizeof(header), 1, file) == 1;
+
+	for (int i = 0; i < scene.GetMeshCount() && written; i++) {
+		const Mesh& mesh = scene.GetMesh(i);
+		MeshFileEntry entry = {
+			mesh.FirstVertex, mesh.VertexCount,
+			{ mesh.BoundsCenter.x, mesh.BoundsCenter.y, mesh.BoundsCenter.z }, mesh.BoundsRadius
+		};
+		written = fwrite(&entry, sizeof(entry), 1, file) == 1;
+	}
+	if (written && header.VertexCount > 0) {
+		written = fwrite(&scene.GetVertices()[0], sizeof(Vertex), header.VertexCount, file) == header.VertexCount;
+	}
+
+	return fclose(file) == 0 && written;
+}
@@ -0,0 +1,159 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#pragma once
+
+#include "Culling.h"
+#include "RenderDevice.h"
+#include <cstddef>
+#include <vector>
+
+/*
+	A mesh is a range of the scene's vertices, drawn as a triangle list, along with a bounding
+	sphere in the mesh's own space. A mesh that is being streamed in isn't resident until all of its
+	vertices are there, and objects using it aren't drawn until then.
+*/
+struct Mesh {
+	unsigned int FirstVertex;
+	unsigned int VertexCount;
+	Vector3 BoundsCenter;
+	float BoundsRadius;
+	bool Resident;
+};
+
+/*
+	Binary mesh file, little endian:
+
+		MeshFileHeader
+		MeshFileEntry[MeshCount]
+		Vertex[VertexCount]
+
+	Every mesh's vertices are a range of the one vertex array, so the whole file ends up in a single
+	vertex buffer. The layout is what the loader uses directly, there is no parsing involved.
+*/
+struct MeshFileHeader {
+	char Magic[8]; // MeshFileMagic
+	unsigned int Version; // MeshFileVersion
+	unsigned int MeshCount;
+	unsigned int VertexCount;
+	unsigned int Reserved;
+};
+
+struct MeshFileEntry {
+	unsigned int FirstVertex;
+	unsigned int VertexCount;
+	float BoundsCenter[3];
+	float BoundsRadius;
+};
+
+extern const char MeshFileMagic[8];
+const unsigned int MeshFileVersion = 1;
+
+/*
+	Meshes and the objects placed in the world using them.
+
+	Per-object data is kept as structure of arrays, one array per component, which is what the
+	culling loop wants: it streams through the bounding spheres only, four objects at a time.
+	Bounds are kept in world space and are updated whenever an object is moved.
+*/
+class Scene {
+public:
+	Scene();
+
+	// Adds a mesh made of the given triangle list and returns its index. Bounds are computed here.
+	int AddMesh(const Vertex* vertices, unsigned int vertexCount);
+
+	// Adds every mesh in a mesh file. Returns false, leaving the scene unchanged, if the file
+	// can't be opened or is not a valid mesh file.
+	bool LoadMeshFile(const char* path);
+
+	/*
+		Streaming a mesh in, see ResourceStreamer. ReserveMesh adds a mesh that is not resident
+		yet, with its bounds known up front and a range of vertexCount zeroed vertices at the end of
+		the vertex array. SetMeshVertices fills in part of the range, firstVertex counting from the
+		start of the mesh, and MakeMeshResident marks the mesh ready to be drawn.
+	*/
+	int ReserveMesh(unsigned int vertexCount, const Vector3& boundsCenter, float boundsRadius);
+	void SetMeshVertices(int mesh, unsigned int firstVertex, const Vertex* vertices, unsigned int vertexCount);
+	void MakeMeshResident(int mesh);
+
+	unsigned int AddObject(int mesh, const Vector3& position, const Quaternion& orientation, float scale);
+	void SetObjectTransform(unsigned int object, const Vector3& position, const Quaternion& orientation, float scale);
+
+	int GetMeshCount() const;
+	const Mesh& GetMesh(int mesh) const;
+	const std::vector<Vertex>& GetVertices() const;
+
+	// Which of the MaxMaterials materials an object is drawn with, 0 unless set.
+	void SetObjectMaterial(unsigned int object, int material);
+
+	unsigned int GetObjectCount() const;
+	int GetObjectMesh(unsigned int object) const;
+	int GetObjectMaterial(unsigned int object) const;
+	Vector3 GetObjectPosition(unsigned int object) const;
+
+	// World matrix of an object, transposed for the shader.
+	Matrix4 GetObjectTransposedWorld(unsigned int object) const;
+
+	/*
+		The scene as GPU driven drawing wants it, see RenderDevice::SetSceneInstances: an instance
+		per object and a draw per mesh, whose instances are listed from its StartInstanceLocation
+		on in the order of the meshes. Meshes that aren't resident have no vertices to draw.
+	*/
+	void GetInstances(std::vector<SceneInstance>& outInstances, std::vector<IndirectDrawArgs>& outMeshDraws) const;
+
+	// Goes up whenever a mesh or an object is added or changed, other than by SetMeshVertices.
+	// Never 0.
+	unsigned long long GetRevision() const;
+
+	// Appends the objects that may be visible in the frustum to outVisible.
+	void Cull(const Frustum& frustum, std::vector<unsigned int>& outVisible) const;
+
+	// Same for objects firstObject to firstObject + objectCount - 1 only, to split culling into jobs.
+	void Cull(const Frustum& frustum, unsigned int firstObject, unsigned int objectCount, std::vector<unsigned int>& outVisible) const;
+
+private:
+	void UpdateBounds(unsigned int object);
+
+	unsigned long long revision;
+	std::vector<Mesh> meshes;
+	std::vector<Vertex> vertices;
+
+	// Objects.
+	std::vector<int> objectMesh;
+	std::vector<int> objectMaterial;
+	std::vector<float> positionX, positionY, positionZ;
+	std::vector<float> orientationX, orientationY, orientationZ, orientationW;
+	std::vector<float> scale;
+	std::vector<float> boundsX, boundsY, boundsZ, boundsRadius;
+};
+
+// Checks that the size bytes at data are a valid mesh file and returns its header and entries.
+bool ReadMeshFileHeader(const unsigned char* data, size_t size, MeshFileHeader& outHeader, std::vector<MeshFileEntry>& outEntries);
+
+// Writes meshes (with their bounds as computed by Scene::AddMesh) and vertices to a mesh file.
+bool SaveMeshFile(const char* path, const Scene& scene);
@@ -0,0 +1,184 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+
+#include "ShaderCache.h"
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+namespace {
+	const char Magic[4] = { 'S', 'O', 'S', 'C' };
+
+	// Bump when the file layout changes.
+	const unsigned int FormatVersion = 1;
+
+	struct FileHeader {
+		char Magic[4];
+		unsigned int Version;
+		unsigned long long KeyHash;
+		unsigned long long BytecodeHash;
+		unsigned long long BytecodeSize;
+	};
+
+	// 64-bit FNV-1a.
+	const unsigned long long HashBasis = 14695981039346656037ull;
+
+	unsigned long long Hash(unsigned long long hash, const void* data, size_t size) {
+		const unsigned char* bytes = static_cast<const unsigned char*>(data);
+		for (size_t i = 0; i < size; i++) {
+			hash = (hash ^ bytes[i]) * 1099511628211ull;
+		}
+		return hash;
+	}
+
+	// Strings are hashed with their terminator so that fields can't run into each other.
+	unsigned long long Hash(unsigned long long hash, const char* text) {
+		if (text == nullptr) {
+			text = "";
+		}
+		return Hash(hash, text, std::strlen(text) + 1);
+	}
+
+	void EnsureDirectory(const std::string& path) {
+#ifdef _WIN32
+		_mkdir(path.c_str());
+#else
+		mkdir(path.c_str(), 0755);
+#endif
+	}
+}
+
+ShaderCache::ShaderCache(const char* directory, const char* compilerTag) :
+	directory(directory),
+	compilerTag(compilerTag)
+{
+	std::memset(&statistics, 0, sizeof(statistics));
+}
+
+unsigned long long ShaderCache::GetHash(const ShaderKey& key) const {
+	unsigned long long hash = Hash(HashBasis, &FormatVersion, sizeof(FormatVersion));
+	hash = Hash(hash, compilerTag.c_str());
+	hash = Hash(hash, key.Source);
+	hash = Hash(hash, key.EntryPoint);
+	hash = Hash(hash, key.Profile);
+	hash = Hash(hash, key.Defines);
+	return Hash(hash, &key.Flags, sizeof(key.Flags));
+}
+
+std::string ShaderCache::GetPath(const ShaderKey& key) const {
+	char name[32];
+	std::sprintf(name, "%016llx.cso", GetHash(key));
+	return directory + "/" + name;
+}
+
+bool ShaderCache::Find(const ShaderKey& key, ShaderBytecode& outBytecode) {
+	std::unique_ptr<MappedFile> file(new MappedFile());
+	if (!file->Open(GetPath(key).c_str())) {
+		return false;
+	}
+
+	FileHeader header;
+	bool valid = file->GetSize() > sizeof(header);
+	if (valid) {
+		std::memcpy(&header, file->GetData(), sizeof(header));
+		const unsigned char* bytecode = file->GetData() + sizeof(header);
+		valid = std::memcmp(header.Magic, Magic, sizeof(Magic)) == 0 && header.Version == FormatVersion &&
+			header.KeyHash == GetHash(key) && header.BytecodeSize == file->GetSize() - sizeof(header) &&
+			header.BytecodeHash == Hash(HashBasis, bytecode, static_cast<size_t>(header.BytecodeSize));
+	}
+	if (!valid) {
+		statistics.Invalid++;
+		return false;
+	}
+
+	outBytecode.Data = file->GetData() + sizeof(header);
+	outBytecode.Size = static_cast<size_t>(header.BytecodeSize);
+	mappedFiles.push_back(std::move(file));
+	statistics.Hits++;
+	return true;
+}
+
+bool ShaderCache::Store(const ShaderKey& key, const void* bytecode, size_t size) {
+	FileHeader header;
+	std::memcpy(header.Magic, Magic, sizeof(Magic));
+	header.Version = FormatVersion;
+	header.KeyHash = GetHash(key);
+	header.BytecodeHash = Hash(HashBasis, bytecode, size);
+	header.BytecodeSize = size;
+
+	// Written under another name and renamed, so a crash or another instance writing the same
+	// shader never leaves a half written file under the real name.
+	EnsureDirectory(directory);
+	std::string path = GetPath(key);
+	std::string temporaryPath = path + ".tmp";
+	FILE* file = std::fopen(temporaryPath.c_str(), "wb");
+	bool written = file != nullptr &&
+		std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+		(size == 0 || std::fwrite(bytecode, size, 1, file) == 1);
+	if (file != nullptr) {
+		written = std::fclose(file) == 0 && written;
+	}
+	std::remove(path.c_str());
+	if (!written || std::rename(temporaryPath.c_str(), path.c_str()) != 0) {
+		std::remove(temporaryPath.c_str());
+		statistics.StoreFailures++;
+		return false;
+	}
+	statistics.Stores++;
+	return true;
+}
+
+bool ShaderCache::GetOrCompile(const ShaderKey& key, const Compiler& compile, ShaderBytecode& outBytecode) {
+	unsigned int invalid = statistics.Invalid;
+	if (Find(key, outBytecode)) {
+		return true;
+	}
+	if (statistics.Invalid == invalid) {
+		statistics.Misses++;
+	}
+
+	std::unique_ptr<std::vector<unsigned char> > bytecode(new std::vector<unsigned char>());
+	if (!compile(key, *bytecode)) {
+		return false;
+	}
+	// Failing to store only costs the next start a compile.
+	Store(key, bytecode->data(), bytecode->size());
+	outBytecode.Data = bytecode->data();
+	outBytecode.Size = bytecode->size();
+	compiled.push_back(std::move(bytecode));
+	return true;
+}
+
+const ShaderCache::Statistics& ShaderCache::GetStatistics() const {
+	return statistics;
+}
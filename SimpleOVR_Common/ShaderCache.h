@@ -0,0 +1,104 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+
+#pragma once
+
+#include "MappedFile.h"
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+/*
+	Everything that decides what a shader compiles to. Defines are "NAME=VALUE" pairs separated
+	by semicolons, or nullptr. Flags are passed on to the compiler as they are.
+*/
+struct ShaderKey {
+	const char* Source;
+	const char* EntryPoint;
+	const char* Profile;
+	const char* Defines;
+	unsigned int Flags;
+};
+
+struct ShaderBytecode {
+	const void* Data;
+	size_t Size;
+};
+
+/*
+	Compiled shaders on disk, one file per shader named after the hash of its key and the compiler
+	tag (which should change with the compiler's version), so editing a shader or upgrading the
+	compiler simply misses the old files. Each file starts with a header repeating the hash and
+	holding a checksum of the bytecode, anything that doesn't match is compiled again and
+	overwritten.
+
+	Hits are memory mapped and stay mapped until the cache is destroyed, so the bytecode can be
+	handed to the driver without a copy. Nothing here depends on the compiler: it is passed to
+	GetOrCompile, which only calls it on a miss.
+*/
+class ShaderCache {
+public:
+	typedef std::function<bool(const ShaderKey& key, std::vector<unsigned char>& outBytecode)> Compiler;
+
+	struct Statistics {
+		unsigned int Hits;
+		unsigned int Misses; // No file, compiled
+		unsigned int Invalid; // A file that didn't match, compiled
+		unsigned int Stores;
+		unsigned int StoreFailures;
+	};
+
+	// The directory is created when the first shader is stored.
+	ShaderCache(const char* directory, const char* compilerTag);
+
+	/*
+		Returns the bytecode from the cache or, failing that, compiles it and stores it. The
+		bytecode stays valid as long as the cache. Returns false only if compiling failed.
+	*/
+	bool GetOrCompile(const ShaderKey& key, const Compiler& compile, ShaderBytecode& outBytecode);
+
+	// Only looks in the cache.
+	bool Find(const ShaderKey& key, ShaderBytecode& outBytecode);
+	bool Store(const ShaderKey& key, const void* bytecode, size_t size);
+
+	unsigned long long GetHash(const ShaderKey& key) const;
+	std::string GetPath(const ShaderKey& key) const;
+	const Statistics& GetStatistics() const;
+
+private:
+	ShaderCache(const ShaderCache&);
+	ShaderCache& operator=(const ShaderCache&);
+
+	std::string directory;
+	std::string compilerTag;
+	std::vector<std::unique_ptr<MappedFile> > mappedFiles;
+	std::vector<std::unique_ptr<std::vector<unsigned char> > > compiled;
+	Statistics statistics;
+};
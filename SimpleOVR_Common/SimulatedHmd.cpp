@@ -0,0 +1,182 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#include "SimulatedHmd.h"
+#include "VrMath.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+	// Roughly what LibOVR 0.4.3 reports for a DK2.
+	const Size2i Resolution = { 1920, 1080 };
+	const double RefreshRate = 75.0;
+	const float PixelsPerTanAngleAtCenter = 549.6f;
+	const float InterpupillaryDistance = 0.064f;
+	const FovPort DefaultEyeFov[EyeCount] = {
+		{ 1.3316f, 1.3316f, 1.0586f, 1.0924f },
+		{ 1.3316f, 1.3316f, 1.0924f, 1.0586f }
+	};
+	const int EyeRenderOrder[EyeCount] = { 0, 1 };
+
+	// Step of the numerical derivatives of the script.
+	const double DerivativeStep = 0.001;
+}
+
+const double SimulatedHmd::PredictionLatency = 1.5 / RefreshRate;
+
+// A DK2's screen and lens separation, with a lens roughly like its A cups. The center of the lens
+// has the DK2's PixelsPerTanAngleAtCenter.
+const LensDistortion SimulatedHmd::LensModel = {
+	Resolution,
+	{ 0.12576f, 0.07074f },
+	0.0635f,
+	PixelsPerTanAngleAtCenter * 0.12576f / Resolution.w,
+	{ 1.0f, 0.22f, 0.24f },
+	{ -0.0112f, -0.015f, 0.0187f, 0.015f },
+	0.875f
+};
+
+SimulatedHmd::SimulatedHmd(const PoseScript& script) : script(script), frameIndex(0) {
+	recenterPose.Orientation = QuaternionIdentity();
+	recenterPose.Position.x = recenterPose.Position.y = recenterPose.Position.z = 0.0f;
+
+	for (int eye = 0; eye < EyeCount; eye++) {
+		eyeRenderDesc[eye].Fov = DefaultEyeFov[eye];
+		eyeRenderDesc[eye].HmdToEyeViewOffset.x = (eye == 0 ? -0.5f : 0.5f) * InterpupillaryDistance;
+		eyeRenderDesc[eye].HmdToEyeViewOffset.y = 0.0f;
+		eyeRenderDesc[eye].HmdToEyeViewOffset.z = 0.0f;
+		eyeRenderViewport[eye].Pos.x = eyeRenderViewport[eye].Pos.y = 0;
+		eyeRenderViewport[eye].Size.w = eyeRenderViewport[eye].Size.h = 0;
+	}
+}
+
+Size2i SimulatedHmd::GetResolution() const {
+	return Resolution;
+}
+
+double SimulatedHmd::GetRefreshRate() const {
+	return RefreshRate;
+}
+
+FovPort SimulatedHmd::GetDefaultEyeFov(int eye) const {
+	return DefaultEyeFov[eye];
+}
+
+int SimulatedHmd::GetEyeRenderOrder(int index) const {
+	return EyeRenderOrder[index];
+}
+
+Size2i SimulatedHmd::GetFovTextureSize(int eye, const FovPort& fov, float pixelsPerDisplayPixel) const {
+	Size2i size;
+	size.w = std::max(1, static_cast<int>(PixelsPerTanAngleAtCenter * (fov.LeftTan + fov.RightTan) * pixelsPerDisplayPixel + 0.5f));
+	size.h = std::max(1, static_cast<int>(PixelsPerTanAngleAtCenter * (fov.UpTan + fov.DownTan) * pixelsPerDisplayPixel + 0.5f));
+	return size;
+}
+
+EyeRenderDesc SimulatedHmd::GetEyeRenderDesc(int eye) const {
+	return eyeRenderDesc[eye];
+}
+
+void SimulatedHmd::SetEyeRenderViewport(int eye, const Rect2i& viewport) {
+	eyeRenderViewport[eye] = viewport;
+}
+
+bool SimulatedHmd::GetDistortionMesh(int eye, const FovPort& fov, std::vector<DistortionPoint>& outPoints, std::vector<unsigned short>& outIndices) const {
+	GenerateDistortionMesh(LensModel, eye, fov, DistortionMeshColumns, DistortionMeshRows, outPoints, outIndices);
+	return true;
+}
+
+void SimulatedHmd::RecenterPose() {
+	// Like LibOVR, recentering only resets yaw and position.
+	Pose current = script.Sample(GetFrameTime(frameIndex));
+	const Vector3 up = { 0.0f, 1.0f, 0.0f };
+	const Vector3 forward = { 0.0f, 0.0f, -1.0f };
+	Vector3 currentForward = Rotate(current.Orientation, forward);
+	recenterPose.Orientation = QuaternionFromAxisAngle(up, std::atan2(-currentForward.x, -currentForward.z));
+	recenterPose.Position = current.Position;
+}
+
+void SimulatedHmd::BeginFrame(unsigned int frameIndex) {
+	if (frameIndex != 0) {
+		this->frameIndex = frameIndex;
+	}
+}
+
+FrameTiming SimulatedHmd::GetFrameTiming() const {
+	FrameTiming timing;
+	timing.ScanoutMidpointSeconds = GetFrameTime(frameIndex);
+	timing.ThisFrameSeconds = timing.ScanoutMidpointSeconds - PredictionLatency;
+	return timing;
+}
+
+void SimulatedHmd::GetEyePoses(unsigned int frameIndex, const Vector3 hmdToEyeViewOffset[EyeCount], Pose outEyePoses[EyeCount]) {
+	Pose head = SampleHead(GetFrameTime(frameIndex != 0 ? frameIndex : this->frameIndex));
+	for (int eye = 0; eye < EyeCount; eye++) {
+		outEyePoses[eye].Orientation = head.Orientation;
+		outEyePoses[eye].Position = head.Position + Rotate(head.Orientation, hmdToEyeViewOffset[eye]);
+	}
+}
+
+PoseState SimulatedHmd::GetTrackingState() {
+	// Central differences, world space like the poses.
+	PoseState state;
+	state.TimeInSeconds = GetFrameTiming().ThisFrameSeconds;
+	state.ThePose = SampleHead(state.TimeInSeconds);
+	Pose before = SampleHead(state.TimeInSeconds - DerivativeStep);
+	Pose after = SampleHead(state.TimeInSeconds + DerivativeStep);
+	const float step = static_cast<float>(DerivativeStep);
+	state.AngularVelocity = RotationVector(after.Orientation * Conjugate(before.Orientation)) * (0.5f / step);
+	state.LinearVelocity = (after.Position - before.Position) * (0.5f / step);
+	state.AngularAcceleration = (RotationVector(after.Orientation * Conjugate(state.ThePose.Orientation)) -
+		RotationVector(state.ThePose.Orientation * Conjugate(before.Orientation))) * (1.0f / (step * step));
+	state.LinearAcceleration = (after.Position - state.ThePose.Position * 2.0f + before.Position) * (1.0f / (step * step));
+	return state;
+}
+
+void SimulatedHmd::EndFrame(const Pose renderPose[EyeCount]) {
+	frameIndex++;
+}
+
+unsigned int SimulatedHmd::GetFrameIndex() const {
+	return frameIndex;
+}
+
+const Rect2i& SimulatedHmd::GetEyeRenderViewport(int eye) const {
+	return eyeRenderViewport[eye];
+}
+
+double SimulatedHmd::GetFrameTime(unsigned int frameIndex) const {
+	return frameIndex / RefreshRate;
+}
+
+Pose SimulatedHmd::SampleHead(double time) const {
+	Pose head = script.Sample(time);
+	Quaternion inverseRecenter = Conjugate(recenterPose.Orientation);
+	head.Orientation = inverseRecenter * head.Orientation;
+	head.Position = Rotate(inverseRecenter, head.Position - recenterPose.Position);
+	return head;
+}
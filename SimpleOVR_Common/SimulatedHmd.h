@@ -0,0 +1,86 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#pragma once
+
+#include "Hmd.h"
+#include "PoseScript.h"
+
+/*
+	An HMD that does not exist. It reports DK2-like properties and feeds the frame loop poses from a
+	PoseScript, so a run is fully reproducible.
+
+	Time is derived from the frame index rather than a real clock: frame N is displayed at
+	N / RefreshRate seconds. EndFrame does not wait for vsync, so the frame loop runs as fast as
+	the CPU allows, which is what we want when profiling it.
+
+	The HMD's own prediction is perfect: the eye poses are the script's at the time the frame is
+	displayed. Each frame begins PredictionLatency earlier, which is when GetTrackingState
+	samples the script, with the derivatives taken numerically.
+
+	Its lens is LensModel, and the distortion meshes are made from it. EndFrame doesn't distort
+	anything either way.
+*/
+class SimulatedHmd : public Hmd {
+public:
+	explicit SimulatedHmd(const PoseScript& script);
+
+	Size2i GetResolution() const;
+	double GetRefreshRate() const;
+	FovPort GetDefaultEyeFov(int eye) const;
+	int GetEyeRenderOrder(int index) const;
+	Size2i GetFovTextureSize(int eye, const FovPort& fov, float pixelsPerDisplayPixel) const;
+	EyeRenderDesc GetEyeRenderDesc(int eye) const;
+	void SetEyeRenderViewport(int eye, const Rect2i& viewport);
+	bool GetDistortionMesh(int eye, const FovPort& fov, std::vector<DistortionPoint>& outPoints, std::vector<unsigned short>& outIndices) const;
+
+	void RecenterPose();
+
+	void BeginFrame(unsigned int frameIndex);
+	FrameTiming GetFrameTiming() const;
+	void GetEyePoses(unsigned int frameIndex, const Vector3 hmdToEyeViewOffset[EyeCount], Pose outEyePoses[EyeCount]);
+	PoseState GetTrackingState();
+	void EndFrame(const Pose renderPose[EyeCount]);
+
+	// From the beginning of a frame to when it is displayed, in seconds.
+	static const double PredictionLatency;
+
+	static const LensDistortion LensModel;
+
+	unsigned int GetFrameIndex() const;
+	const Rect2i& GetEyeRenderViewport(int eye) const;
+
+private:
+	double GetFrameTime(unsigned int frameIndex) const;
+	Pose SampleHead(double time) const; // Recentered
+
+	PoseScript script;
+	Pose recenterPose;
+	unsigned int frameIndex;
+	EyeRenderDesc eyeRenderDesc[EyeCount];
+	Rect2i eyeRenderViewport[EyeCount];
+};
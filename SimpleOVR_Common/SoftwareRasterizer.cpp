@@ -0,0 +1,500 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+
+#include "SoftwareRasterizer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <utility>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#define SOFTWARE_RASTERIZER_SSE
+#include <emmintrin.h>
+#endif
+
+namespace {
+	const int Subpixels = 1 << SoftwareRasterizer::SubpixelBits;
+
+	// Sample positions in 1/16 pixels from the top left corner of the pixel, the standard D3D11 patterns.
+	const int SinglePosition[1][2] = { { 8, 8 } };
+	const int QuadPositions[4][2] = { { 6, 2 }, { 14, 6 }, { 2, 10 }, { 10, 14 } };
+
+	/*
+		Triangles are clipped to the guard band, GuardBand times the viewport in each direction in
+		NDC, and to 0 <= z <= w. Within MaxSize that keeps every vertex within 8192 pixels of the
+		origin, 2^17 in 1/16 pixels.
+	*/
+	const float GuardBand = 3.0f;
+	const int ClipPlaneCount = 6;
+	const int MaxClippedVertices = 3 + ClipPlaneCount;
+
+	// Edge functions are clamped to this per row, far outside anything a row of a tile can step over.
+	const long long EdgeClamp = 1 << 30;
+
+	float ClipDistance(const float* v, int plane) {
+		switch (plane) {
+		case 0: return v[2];
+		case 1: return v[3] - v[2];
+		case 2: return v[0] + GuardBand * v[3];
+		case 3: return GuardBand * v[3] - v[0];
+		case 4: return v[1] + GuardBand * v[3];
+		default: return GuardBand * v[3] - v[1];
+		}
+	}
+
+	const int (*GetSamplePositions(int sampleCount))[2] {
+		return sampleCount == 4 ? QuadPositions : SinglePosition;
+	}
+
+	Rect2i Intersect(const Rect2i& a, const Rect2i& b) {
+		int left = std::max(a.Pos.x, b.Pos.x);
+		int top = std::max(a.Pos.y, b.Pos.y);
+		int right = std::min(a.Pos.x + a.Size.w, b.Pos.x + b.Size.w);
+		int bottom = std::min(a.Pos.y + a.Size.h, b.Pos.y + b.Size.h);
+		Rect2i rect = { { left, top }, { std::max(0, right - left), std::max(0, bottom - top) } };
+		return rect;
+	}
+}
+
+const int SoftwareRasterizer::MaxSize;
+
+SoftwareRasterizer::SoftwareRasterizer(Size2i size, int sampleCount, int targetCount, JobSystem* jobs) :
+	size(size),
+	sampleCount(sampleCount == 4 ? 4 : 1),
+	target(0),
+	reference(false),
+	jobs(jobs)
+{
+	this->size.w = std::max(1, std::min(size.w, MaxSize));
+	this->size.h = std::max(1, std::min(size.h, MaxSize));
+	stride = (this->size.w + 3) & ~3;
+	planeSize = stride * this->size.h;
+	colors.resize(targetCount);
+	colors[0].resize(planeSize * this->sampleCount, 0);
+	depths.resize(planeSize * this->sampleCount, 1.0f);
+	tileColumns = (this->size.w + TileSize - 1) / TileSize;
+	tileRows = (this->size.h + TileSize - 1) / TileSize;
+	tileTriangles.resize(tileColumns * tileRows);
+	std::memset(&statistics, 0, sizeof(statistics));
+}
+
+Size2i SoftwareRasterizer::GetSize() const {
+	return size;
+}
+
+int SoftwareRasterizer::GetSampleCount() const {
+	return sampleCount;
+}
+
+void SoftwareRasterizer::SetTarget(int target) {
+	if (target != this->target) {
+		Flush();
+		this->target = target;
+		if (colors[target].empty()) {
+			colors[target].resize(planeSize * sampleCount, 0);
+		}
+	}
+}
+
+void SoftwareRasterizer::ClearTarget(unsigned int color) {
+	Flush();
+	std::fill(colors[target].begin(), colors[target].end(), color);
+}
+
+void SoftwareRasterizer::ClearDepth(float depth) {
+	Flush();
+	std::fill(depths.begin(), depths.end(), depth);
+}
+
+void SoftwareRasterizer::ClearTarget(unsigned int color, const std::vector<Rect2i>& keep) {
+	Flush();
+	std::vector<std::pair<int, int> > spans; // Kept pixels of the row, from and to
+	for (int y = 0; y < size.h; y++) {
+		spans.clear();
+		for (size_t i = 0; i < keep.size(); i++) {
+			const Rect2i& rect = keep[i];
+			if (y >= rect.Pos.y && y < rect.Pos.y + rect.Size.h) {
+				spans.push_back(std::make_pair(rect.Pos.x, rect.Pos.x + rect.Size.w));
+			}
+		}
+		std::sort(spans.begin(), spans.end());
+		for (int s = 0; s < sampleCount; s++) {
+			unsigned int* row = &colors[target][s * planeSize + y * stride];
+			int x = 0;
+			for (size_t i = 0; i < spans.size(); i++) {
+				int from = std::max(x, std::min(stride, spans[i].first));
+				std::fill(row + x, row + from, color);
+				x = std::max(from, std::min(stride, spans[i].second));
+			}
+			std::fill(row + x, row + stride, color);
+		}
+	}
+}
+
+void SoftwareRasterizer::FillDepth(const Rect2i& rect, float depth) {
+	Flush();
+	Rect2i whole = { { 0, 0 }, size };
+	Rect2i area = Intersect(rect, whole);
+	for (int s = 0; s < sampleCount; s++) {
+		for (int y = area.Pos.y; y < area.Pos.y + area.Size.h; y++) {
+			float* row = &depths[s * planeSize + y * stride];
+			std::fill(row + area.Pos.x, row + area.Pos.x + area.Size.w, depth);
+		}
+	}
+}
+
+void SoftwareRasterizer::DrawTriangle(const float clip[3][4], const Rect2i& viewport, const Rect2i& scissor, unsigned int color) {
+	statistics.Triangles++;
+
+	// Most triangles are entirely inside every plane and need no clipping.
+	bool inside = true;
+	for (int plane = 0; plane < ClipPlaneCount && inside; plane++) {
+		inside = ClipDistance(clip[0], plane) >= 0.0f && ClipDistance(clip[1], plane) >= 0.0f && ClipDistance(clip[2], plane) >= 0.0f;
+	}
+	if (inside) {
+		const float* vertices[3] = { clip[0], clip[1], clip[2] };
+		SetupTriangle(vertices, viewport, scissor, color);
+		return;
+	}
+
+	// Sutherland-Hodgman, plane by plane.
+	float polygon[2][MaxClippedVertices][4];
+	int count = 3;
+	std::memcpy(polygon[0], clip, sizeof(float) * 12);
+	int current = 0;
+	for (int plane = 0; plane < ClipPlaneCount && count >= 3; plane++) {
+		const float (*in)[4] = polygon[current];
+		float (*out)[4] = polygon[1 - current];
+		int outCount = 0;
+		for (int i = 0; i < count; i++) {
+			const float* a = in[i];
+			const float* b = in[(i + 1) % count];
+			float da = ClipDistance(a, plane);
+			float db = ClipDistance(b, plane);
+			if (da >= 0.0f) {
+				std::memcpy(out[outCount++], a, sizeof(float) * 4);
+			}
+			if ((da >= 0.0f) != (db >= 0.0f)) {
+				float t = da / (da - db);
+				for (int c = 0; c < 4; c++) {
+					out[outCount][c] = a[c] + (b[c] - a[c]) * t;
+				}
+				outCount++;
+			}
+		}
+		count = outCount;
+		current = 1 - current;
+	}
+
+	if (count < 3) {
+		statistics.CulledTriangles++;
+		return;
+	}
+	statistics.ClippedTriangles += count - 3;
+	for (int i = 1; i + 1 < count; i++) {
+		const float* vertices[3] = { polygon[current][0], polygon[current][i], polygon[current][i + 1] };
+		SetupTriangle(vertices, viewport, scissor, color);
+	}
+}
+
+void SoftwareRasterizer::SetupTriangle(const float* vertices[3], const Rect2i& viewport, const Rect2i& scissor, unsigned int color) {
+	Triangle triangle;
+	float z[3];
+	for (int i = 0; i < 3; i++) {
+		const float* v = vertices[i];
+		if (v[3] <= 0.0f) {
+			statistics.CulledTriangles++;
+			return;
+		}
+		float invW = 1.0f / v[3];
+		float x = viewport.Pos.x + (v[0] * invW + 1.0f) * 0.5f * viewport.Size.w;
+		float y = viewport.Pos.y + (1.0f - v[1] * invW) * 0.5f * viewport.Size.h;
+		triangle.X[i] = static_cast<int>(std::floor(x * Subpixels + 0.5f));
+		triangle.Y[i] = static_cast<int>(std::floor(y * Subpixels + 0.5f));
+		z[i] = v[2] * invW;
+	}
+
+	// Twice the area, positive if clockwise on screen (y goes down), the front face in D3D11.
+	const int* X = triangle.X;
+	const int* Y = triangle.Y;
+	long long area = static_cast<long long>(X[1] - X[0]) * (Y[2] - Y[0]) - static_cast<long long>(X[2] - X[0]) * (Y[1] - Y[0]);
+	if (area <= 0) {
+		statistics.CulledTriangles++;
+		return;
+	}
+
+	int minX = std::min(X[0], std::min(X[1], X[2])) >> SubpixelBits;
+	int minY = std::min(Y[0], std::min(Y[1], Y[2])) >> SubpixelBits;
+	int maxX = (std::max(X[0], std::max(X[1], X[2])) + Subpixels - 1) >> SubpixelBits;
+	int maxY = (std::max(Y[0], std::max(Y[1], Y[2])) + Subpixels - 1) >> SubpixelBits;
+	Rect2i bounds = { { minX, minY }, { maxX - minX, maxY - minY } };
+	Rect2i targetRect = { { 0, 0 }, size };
+	triangle.Bounds = Intersect(Intersect(bounds, scissor), targetRect);
+	if (triangle.Bounds.Size.w == 0 || triangle.Bounds.Size.h == 0) {
+		statistics.CulledTriangles++;
+		return;
+	}
+
+	for (int i = 0; i < 3; i++) {
+		int j = (i + 1) % 3;
+		int dx = X[j] - X[i];
+		int dy = Y[j] - Y[i];
+		triangle.TopLeft[i] = dy < 0 || (dy == 0 && dx > 0) ? 1 : 0;
+	}
+
+	float areaF = static_cast<float>(area);
+	float dz1 = z[1] - z[0];
+	float dz2 = z[2] - z[0];
+	triangle.Z0 = z[0];
+	triangle.DzDx = (dz1 * (Y[2] - Y[0]) - dz2 * (Y[1] - Y[0])) / areaF;
+	triangle.DzDy = (dz2 * (X[1] - X[0]) - dz1 * (X[2] - X[0])) / areaF;
+	triangle.Color = color;
+
+	unsigned int index = static_cast<unsigned int>(triangles.size());
+	triangles.push_back(triangle);
+	if (!reference) {
+		const Rect2i& b = triangle.Bounds;
+		for (int row = b.Pos.y / TileSize; row <= (b.Pos.y + b.Size.h - 1) / TileSize; row++) {
+			for (int column = b.Pos.x / TileSize; column <= (b.Pos.x + b.Size.w - 1) / TileSize; column++) {
+				tileTriangles[row * tileColumns + column].push_back(index);
+				statistics.TileTriangles++;
+			}
+		}
+	}
+}
+
+void SoftwareRasterizer::Flush() {
+	if (triangles.empty()) {
+		return;
+	}
+	statistics.Flushes++;
+
+	if (reference) {
+		for (size_t i = 0; i < triangles.size(); i++) {
+			RasterizeReference(triangles[i]);
+		}
+	}
+	else {
+		auto rasterizeTile = [this](unsigned int tile, int thread) {
+			std::vector<unsigned int>& indices = tileTriangles[tile];
+			Rect2i rect = { { static_cast<int>(tile % tileColumns) * TileSize, static_cast<int>(tile / tileColumns) * TileSize }, { TileSize, TileSize } };
+			for (size_t i = 0; i < indices.size(); i++) {
+				RasterizeTile(triangles[indices[i]], rect);
+			}
+			indices.clear();
+		};
+		unsigned int tileCount = static_cast<unsigned int>(tileTriangles.size());
+		if (jobs != nullptr) {
+			jobs->ParallelFor(tileCount, rasterizeTile);
+		}
+		else {
+			for (unsigned int tile = 0; tile < tileCount; tile++) {
+				rasterizeTile(tile, 0);
+			}
+		}
+	}
+	triangles.clear();
+}
+
+void SoftwareRasterizer::RasterizeTile(const Triangle& triangle, const Rect2i& tile) {
+	Rect2i area = Intersect(triangle.Bounds, tile);
+	if (area.Size.w == 0 || area.Size.h == 0) {
+		return;
+	}
+
+	// Groups of four pixels start at multiples of four, as the planes' rows do.
+	int left = area.Pos.x;
+	int right = area.Pos.x + area.Size.w;
+	int groupStart = left & ~3;
+	const int* X = triangle.X;
+	const int* Y = triangle.Y;
+	const int (*positions)[2] = GetSamplePositions(sampleCount);
+
+	// Stepping one pixel to the right changes edge i by pixelStep[i].
+	int pixelStep[3];
+	for (int i = 0; i < 3; i++) {
+		pixelStep[i] = -(Y[(i + 1) % 3] - Y[i]) * Subpixels;
+	}
+
+	for (int y = area.Pos.y; y < area.Pos.y + area.Size.h; y++) {
+		for (int s = 0; s < sampleCount; s++) {
+			int sx = groupStart * Subpixels + positions[s][0];
+			int sy = y * Subpixels + positions[s][1];
+
+			// The edge functions at the row's first group, exact in 64 bits and clamped to 32.
+			int rowEdge[3];
+			for (int i = 0; i < 3; i++) {
+				int j = (i + 1) % 3;
+				long long edge = static_cast<long long>(X[j] - X[i]) * (sy - Y[i]) - static_cast<long long>(Y[j] - Y[i]) * (sx - X[i]) - (1 - triangle.TopLeft[i]);
+				rowEdge[i] = static_cast<int>(std::max(-EdgeClamp, std::min(EdgeClamp, edge)));
+			}
+			float fy = static_cast<float>(sy - Y[0]);
+			unsigned int* colorRow = &colors[target][s * planeSize + y * stride];
+			float* depthRow = &depths[s * planeSize + y * stride];
+
+#ifdef SOFTWARE_RASTERIZER_SSE
+			__m128i edge[3];
+			__m128i groupStep[3];
+			for (int i = 0; i < 3; i++) {
+				edge[i] = _mm_setr_epi32(rowEdge[i], rowEdge[i] + pixelStep[i], rowEdge[i] + 2 * pixelStep[i], rowEdge[i] + 3 * pixelStep[i]);
+				groupStep[i] = _mm_set1_epi32(4 * pixelStep[i]);
+			}
+			__m128i minusOne = _mm_set1_epi32(-1);
+			__m128i pixelX = _mm_setr_epi32(groupStart, groupStart + 1, groupStart + 2, groupStart + 3);
+			__m128i four = _mm_set1_epi32(4);
+			__m128i leftMinusOne = _mm_set1_epi32(left - 1);
+			__m128i rightEdge = _mm_set1_epi32(right);
+			__m128i sampleX = _mm_setr_epi32(sx - X[0], sx - X[0] + Subpixels, sx - X[0] + 2 * Subpixels, sx - X[0] + 3 * Subpixels);
+			__m128i sampleStep = _mm_set1_epi32(4 * Subpixels);
+			__m128 z0 = _mm_set1_ps(triangle.Z0);
+			__m128 dzdx = _mm_set1_ps(triangle.DzDx);
+			__m128 dzdyTimesY = _mm_set1_ps(triangle.DzDy * fy);
+			__m128i color = _mm_set1_epi32(static_cast<int>(triangle.Color));
+			for (int x = groupStart; x < right; x += 4) {
+				__m128i inside = _mm_cmpgt_epi32(_mm_or_si128(_mm_or_si128(edge[0], edge[1]), edge[2]), minusOne);
+				inside = _mm_and_si128(inside, _mm_and_si128(_mm_cmpgt_epi32(pixelX, leftMinusOne), _mm_cmplt_epi32(pixelX, rightEdge)));
+				if (_mm_movemask_epi8(inside) != 0) {
+					__m128 z = _mm_add_ps(_mm_add_ps(z0, _mm_mul_ps(dzdx, _mm_cvtepi32_ps(sampleX))), dzdyTimesY);
+					__m128 oldDepth = _mm_loadu_ps(depthRow + x);
+					__m128i pass = _mm_and_si128(inside, _mm_castps_si128(_mm_cmplt_ps(z, oldDepth)));
+					__m128 passF = _mm_castsi128_ps(pass);
+					_mm_storeu_ps(depthRow + x, _mm_or_ps(_mm_and_ps(passF, z), _mm_andnot_ps(passF, oldDepth)));
+					__m128i* colorGroup = reinterpret_cast<__m128i*>(colorRow + x);
+					__m128i oldColor = _mm_loadu_si128(colorGroup);
+					_mm_storeu_si128(colorGroup, _mm_or_si128(_mm_and_si128(pass, color), _mm_andnot_si128(pass, oldColor)));
+				}
+				for (int i = 0; i < 3; i++) {
+					edge[i] = _mm_add_epi32(edge[i], groupStep[i]);
+				}
+				pixelX = _mm_add_epi32(pixelX, four);
+				sampleX = _mm_add_epi32(sampleX, sampleStep);
+			}
+#else
+			float dzdyTimesY = triangle.DzDy * fy;
+			for (int x = groupStart; x < right; x++) {
+				int offset = x - groupStart;
+				bool inside = x >= left &&
+					rowEdge[0] + offset * pixelStep[0] >= 0 &&
+					rowEdge[1] + offset * pixelStep[1] >= 0 &&
+					rowEdge[2] + offset * pixelStep[2] >= 0;
+				if (inside) {
+					float z = triangle.Z0 + triangle.DzDx * static_cast<float>(sx - X[0] + offset * Subpixels) + dzdyTimesY;
+					if (z < depthRow[x]) {
+						depthRow[x] = z;
+						colorRow[x] = triangle.Color;
+					}
+				}
+			}
+#endif
+		}
+	}
+}
+
+void SoftwareRasterizer::RasterizeReference(const Triangle& triangle) {
+	const int* X = triangle.X;
+	const int* Y = triangle.Y;
+	const int (*positions)[2] = GetSamplePositions(sampleCount);
+	const Rect2i& b = triangle.Bounds;
+	for (int y = b.Pos.y; y < b.Pos.y + b.Size.h; y++) {
+		for (int x = b.Pos.x; x < b.Pos.x + b.Size.w; x++) {
+			for (int s = 0; s < sampleCount; s++) {
+				int sx = x * Subpixels + positions[s][0];
+				int sy = y * Subpixels + positions[s][1];
+				bool inside = true;
+				for (int i = 0; i < 3 && inside; i++) {
+					int j = (i + 1) % 3;
+					long long edge = static_cast<long long>(X[j] - X[i]) * (sy - Y[i]) - static_cast<long long>(Y[j] - Y[i]) * (sx - X[i]);
+					inside = edge > 0 || (edge == 0 && triangle.TopLeft[i] != 0);
+				}
+				if (!inside) {
+					continue;
+				}
+				float z = triangle.Z0 + triangle.DzDx * static_cast<float>(sx - X[0]) + triangle.DzDy * static_cast<float>(sy - Y[0]);
+				int index = s * planeSize + y * stride + x;
+				if (z < depths[index]) {
+					depths[index] = z;
+					colors[target][index] = triangle.Color;
+				}
+			}
+		}
+	}
+}
+
+void SoftwareRasterizer::Resolve(int target, Image& outImage) {
+	Flush();
+	outImage.Size = size;
+	outImage.Pixels.assign(size.w * size.h, 0);
+	if (colors[target].empty()) {
+		return;
+	}
+
+	const std::vector<unsigned int>& samples = colors[target];
+	auto resolveRow = [&](unsigned int y, int thread) {
+		for (int x = 0; x < size.w; x++) {
+			unsigned int pixel = 0;
+			for (int shift = 0; shift < 32; shift += 8) {
+				unsigned int sum = 0;
+				for (int s = 0; s < sampleCount; s++) {
+					sum += (samples[s * planeSize + y * stride + x] >> shift) & 0xff;
+				}
+				pixel |= ((sum + sampleCount / 2) / sampleCount) << shift;
+			}
+			outImage.Pixels[y * size.w + x] = pixel;
+		}
+	};
+	if (jobs != nullptr) {
+		jobs->ParallelFor(size.h, resolveRow);
+	}
+	else {
+		for (int y = 0; y < size.h; y++) {
+			resolveRow(y, 0);
+		}
+	}
+}
+
+const unsigned int* SoftwareRasterizer::GetSamples(int target) {
+	Flush();
+	return colors[target].empty() ? nullptr : colors[target].data();
+}
+
+int SoftwareRasterizer::GetStride() const {
+	return stride;
+}
+
+int SoftwareRasterizer::GetPlaneSize() const {
+	return planeSize;
+}
+
+void SoftwareRasterizer::SetReferenceMode(bool reference) {
+	Flush();
+	this->reference = reference;
+}
+
+const SoftwareRasterizer::Statistics& SoftwareRasterizer::GetStatistics() const {
+	return statistics;
+}
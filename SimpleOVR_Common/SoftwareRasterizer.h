@@ -0,0 +1,144 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+
+#pragma once
+
+#include "Image.h"
+#include "JobSystem.h"
+#include "VrTypes.h"
+#include <vector>
+
+/*
+	Triangle rasterization on the CPU, following the D3D11 rules for the little the sample uses:
+	clip space triangles are clipped to 0 <= z <= w, back faces (counterclockwise on screen) are
+	culled, vertices snap to 1/16 pixel, coverage follows the top-left rule at the standard sample
+	positions, and depth is tested with LESS.
+
+	Triangles are only queued by DrawTriangle. Flush bins them into tiles of TileSize pixels and
+	rasterizes the tiles in parallel, each tile going through its triangles in the order they were
+	drawn, so the result doesn't depend on the number of threads. Within a tile four pixels are
+	tested at a time with SSE2, with 32-bit edge functions stepped from a 64-bit value per row.
+	There is a scalar fallback for other CPUs with exactly the same results.
+
+	With reference mode on, Flush instead rasterizes each triangle over its bounding box, pixel by
+	pixel and with 64-bit edge functions, on one thread. It is the plain version the tiled one is
+	checked against.
+
+	Render targets hold sampleCount color samples per pixel and share the depth buffer, like the
+	foveated target and the eye texture of the D3D11 device do. Target 0 is allocated up front, the
+	others when first set.
+*/
+class SoftwareRasterizer {
+public:
+	static const int TileSize = 64;
+	static const int SubpixelBits = 4;
+	static const int MaxSampleCount = 4;
+
+	// At most MaxSize pixels along each side, so everything fits in the edge functions' range.
+	static const int MaxSize = 4096;
+
+	struct Statistics {
+		unsigned long long Triangles; // Drawn, before clipping
+		unsigned long long CulledTriangles; // Back facing, degenerate or entirely clipped
+		unsigned long long ClippedTriangles; // Extra triangles made by clipping
+		unsigned long long TileTriangles; // Triangles times the tiles they were binned into
+		unsigned long long Flushes;
+	};
+
+	// sampleCount is 1 or 4. Flushes and resolves run on jobs if given, else on the calling thread.
+	SoftwareRasterizer(Size2i size, int sampleCount, int targetCount, JobSystem* jobs);
+
+	Size2i GetSize() const;
+	int GetSampleCount() const;
+
+	// These flush what was drawn to the previous target first.
+	void SetTarget(int target);
+	void ClearTarget(unsigned int color);
+	void ClearDepth(float depth);
+
+	// Clears all pixels but those within the rectangles, which must not overlap.
+	void ClearTarget(unsigned int color, const std::vector<Rect2i>& keep);
+
+	// Sets every sample of the pixels within rect to depth.
+	void FillDepth(const Rect2i& rect, float depth);
+
+	/*
+		Queues a triangle, given in clip space, for the current target. The viewport maps NDC to
+		pixels, and only pixels within the scissor rectangle are touched.
+	*/
+	void DrawTriangle(const float clip[3][4], const Rect2i& viewport, const Rect2i& scissor, unsigned int color);
+
+	// Rasterizes everything queued.
+	void Flush();
+
+	// Averages the samples of a target into an image of the same size, after flushing.
+	void Resolve(int target, Image& outImage);
+
+	// A target's samples as they are, after flushing: sample plane after sample plane, each
+	// GetPlaneSize pixels in rows of GetStride. nullptr if the target was never set.
+	const unsigned int* GetSamples(int target);
+	int GetStride() const;
+	int GetPlaneSize() const;
+
+	void SetReferenceMode(bool reference);
+	const Statistics& GetStatistics() const;
+
+private:
+	struct Triangle {
+		int X[3]; // In 1/16 pixels, clockwise on screen
+		int Y[3];
+		int TopLeft[3]; // 1 if edge i to i + 1 is a top or left edge, else 0
+		float Z0; // Depth at the first vertex
+		float DzDx; // Depth change per 1/16 pixel
+		float DzDy;
+		Rect2i Bounds; // Pixels that may be covered, within the scissor rectangle
+		unsigned int Color;
+	};
+
+	void SetupTriangle(const float* vertices[3], const Rect2i& viewport, const Rect2i& scissor, unsigned int color);
+	void RasterizeTile(const Triangle& triangle, const Rect2i& tile);
+	void RasterizeReference(const Triangle& triangle);
+
+	Size2i size;
+	int sampleCount;
+	int stride; // Pixels per row of a sample plane, a multiple of 4
+	int planeSize; // stride * size.h
+	int target;
+	bool reference;
+	JobSystem* jobs;
+
+	// Sample plane after sample plane, for every target.
+	std::vector<std::vector<unsigned int> > colors;
+	std::vector<float> depths;
+
+	std::vector<Triangle> triangles;
+	int tileColumns;
+	int tileRows;
+	std::vector<std::vector<unsigned int> > tileTriangles; // Indices into triangles, per tile
+	Statistics statistics;
+};
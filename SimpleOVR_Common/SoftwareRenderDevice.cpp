@@ -0,0 +1,340 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+
+#include "SoftwareRenderDevice.h"
+#include "Clock.h"
+#include "FrameLoop.h"
+#include "VrMath.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE__)
+#define SOFTWARE_RENDER_DEVICE_SSE
+#include <xmmintrin.h>
+#endif
+
+namespace {
+	unsigned int PackColor(const float color[4]) {
+		unsigned int packed = 0;
+		for (int channel = 0; channel < 4; channel++) {
+			float value = std::max(0.0f, std::min(1.0f, color[channel]));
+			packed |= static_cast<unsigned int>(value * 255.0f + 0.5f) << (channel * 8);
+		}
+		return packed;
+	}
+
+	// The pixels within a rectangle given in the viewport's NDC, rounded to the nearest pixel edge.
+	Rect2i NdcToPixels(const Rect2i& viewport, const float ndc[4]) {
+		int left = viewport.Pos.x + static_cast<int>(std::floor((ndc[0] + 1.0f) * 0.5f * viewport.Size.w + 0.5f));
+		int right = viewport.Pos.x + static_cast<int>(std::floor((ndc[1] + 1.0f) * 0.5f * viewport.Size.w + 0.5f));
+		int top = viewport.Pos.y + static_cast<int>(std::floor((1.0f - ndc[3]) * 0.5f * viewport.Size.h + 0.5f));
+		int bottom = viewport.Pos.y + static_cast<int>(std::floor((1.0f - ndc[2]) * 0.5f * viewport.Size.h + 0.5f));
+		Rect2i rect = { { left, top }, { std::max(0, right - left), std::max(0, bottom - top) } };
+		return rect;
+	}
+
+	unsigned int SampleChannel(const Image& source, int x0, int y0, int x1, int y1, float fx, float fy, int shift) {
+		float c00 = static_cast<float>((source.Pixels[y0 * source.Size.w + x0] >> shift) & 0xff);
+		float c10 = static_cast<float>((source.Pixels[y0 * source.Size.w + x1] >> shift) & 0xff);
+		float c01 = static_cast<float>((source.Pixels[y1 * source.Size.w + x0] >> shift) & 0xff);
+		float c11 = static_cast<float>((source.Pixels[y1 * source.Size.w + x1] >> shift) & 0xff);
+		float top = c00 + (c10 - c00) * fx;
+		float bottom = c01 + (c11 - c01) * fx;
+		return static_cast<unsigned int>(top + (bottom - top) * fy);
+	}
+}
+
+SoftwareRenderDevice::SoftwareRenderDevice(Size2i displaySize, Size2i eyeTextureSize, int multisampleCount, JobSystem& jobs) :
+	NullRenderDevice(eyeTextureSize, multisampleCount),
+	jobs(jobs),
+	rasterizer(eyeTextureSize, multisampleCount > 1 ? 4 : 1, TargetCount, &jobs),
+	gpuTimerRunning(false),
+	gpuTime(0.0),
+	gpuFrameTime(-1.0)
+{
+	image.Size = rasterizer.GetSize();
+	image.Pixels.resize(image.Size.w * image.Size.h, 0);
+	displayImage.Size = displaySize;
+	displayImage.Pixels.resize(displaySize.w * displaySize.h, 0xff000000u);
+}
+
+SoftwareRenderDevice::Target SoftwareRenderDevice::GetSceneTarget() const {
+	return GetFoveatedLayout() != nullptr ? Target_Foveated : Target_Eye;
+}
+
+void SoftwareRenderDevice::ClearEyeTexture(const float color[4]) {
+	NullRenderDevice::ClearEyeTexture(color);
+	ClockTicks start = ReadClock();
+	rasterizer.SetTarget(GetSceneTarget());
+	if (IsHiddenAreaMasked()) {
+		rasterizer.ClearTarget(PackColor(color), GetMaskedPixels());
+	}
+	else {
+		rasterizer.ClearTarget(PackColor(color));
+	}
+	gpuTime += ClockTicksToSeconds(ReadClock() - start);
+}
+
+void SoftwareRenderDevice::ClearDepthStencil(float depth, unsigned char stencil) {
+	NullRenderDevice::ClearDepthStencil(depth, stencil);
+	ClockTicks start = ReadClock();
+	rasterizer.ClearDepth(depth);
+	gpuTime += ClockTicksToSeconds(ReadClock() - start);
+}
+
+void SoftwareRenderDevice::BindEyeTexture() {
+	NullRenderDevice::BindEyeTexture();
+	rasterizer.SetTarget(GetSceneTarget());
+	if (IsHiddenAreaMasked()) {
+		ClockTicks start = ReadClock();
+		const std::vector<Rect2i>& hidden = GetMaskedPixels();
+		for (size_t i = 0; i < hidden.size(); i++) {
+			rasterizer.FillDepth(hidden[i], 0.0f);
+		}
+		gpuTime += ClockTicksToSeconds(ReadClock() - start);
+	}
+}
+
+void SoftwareRenderDevice::SetSceneVertices(const Vertex* vertices, unsigned int vertexCount) {
+	NullRenderDevice::SetSceneVertices(vertices, vertexCount);
+	sceneVertices.assign(vertices, vertices + vertexCount);
+}
+
+void SoftwareRenderDevice::UploadSceneVertices(unsigned int firstVertex, const Vertex* vertices, unsigned int vertexCount) {
+	NullRenderDevice::UploadSceneVertices(firstVertex, vertices, vertexCount);
+	if (sceneVertices.size() < firstVertex + vertexCount) {
+		sceneVertices.resize(firstVertex + vertexCount);
+	}
+	std::copy(vertices, vertices + vertexCount, sceneVertices.begin() + firstVertex);
+}
+
+void SoftwareRenderDevice::TransformVertices(const Matrix4& transposed, unsigned int vertexCount, unsigned int startVertex) {
+	// The shaders multiply column vectors by the matrices, so with the transposed matrices a
+	// vertex in clip space is the sum of the rows weighted by its coordinates.
+	clipVertices.resize(vertexCount * 4);
+	const Vertex* vertices = &sceneVertices[startVertex];
+	float* clip = clipVertices.data();
+#ifdef SOFTWARE_RENDER_DEVICE_SSE
+	__m128 rows[4];
+	for (int row = 0; row < 4; row++) {
+		rows[row] = _mm_loadu_ps(transposed.M[row]);
+	}
+	for (unsigned int i = 0; i < vertexCount; i++) {
+		const float* p = vertices[i].Position;
+		__m128 v = _mm_add_ps(_mm_mul_ps(rows[0], _mm_set1_ps(p[0])), _mm_mul_ps(rows[1], _mm_set1_ps(p[1])));
+		v = _mm_add_ps(v, _mm_add_ps(_mm_mul_ps(rows[2], _mm_set1_ps(p[2])), rows[3]));
+		_mm_storeu_ps(clip + i * 4, v);
+	}
+#else
+	for (unsigned int i = 0; i < vertexCount; i++) {
+		const float* p = vertices[i].Position;
+		for (int c = 0; c < 4; c++) {
+			clip[i * 4 + c] = (transposed.M[0][c] * p[0] + transposed.M[1][c] * p[1]) + (transposed.M[2][c] * p[2] + transposed.M[3][c]);
+		}
+	}
+#endif
+}
+
+void SoftwareRenderDevice::DrawTriangles(unsigned int vertexCount, const Rect2i& scissor, unsigned int color) {
+	const float (*clip)[4] = reinterpret_cast<const float (*)[4]>(clipVertices.data());
+	for (unsigned int i = 0; i + 2 < vertexCount; i += 3) {
+		rasterizer.DrawTriangle(clip + i, GetViewport(), scissor, color);
+	}
+}
+
+void SoftwareRenderDevice::DrawMesh(const Matrix4& world, int material, unsigned int vertexCount, unsigned int startVertex, unsigned int eyeInstances) {
+	unsigned int color = PackColor(MaterialColors[material]);
+	if (eyeInstances == 0) {
+		const Matrix4& viewProjection = *reinterpret_cast<const Matrix4*>(GetConstants(ConstantSlot_Frame));
+		TransformVertices(world * viewProjection, vertexCount, startVertex);
+		DrawTriangles(vertexCount, GetViewport(), color);
+		return;
+	}
+	const StereoConstants& stereo = *reinterpret_cast<const StereoConstants*>(GetConstants(ConstantSlot_Frame));
+	for (unsigned int instance = 0; instance < eyeInstances && instance < EyeCount; instance++) {
+		TransformVertices(world * stereo.ViewProjection[instance], vertexCount, startVertex);
+		DrawTriangles(vertexCount, NdcToPixels(GetViewport(), stereo.ClipRect[instance]), color);
+	}
+}
+
+void SoftwareRenderDevice::Draw(unsigned int vertexCount, unsigned int startVertex) {
+	NullRenderDevice::Draw(vertexCount, startVertex);
+	ClockTicks start = ReadClock();
+	const Matrix4& world = *reinterpret_cast<const Matrix4*>(GetConstants(ConstantSlot_Object));
+	DrawMesh(world, GetMaterial(), vertexCount, startVertex, 0);
+	gpuTime += ClockTicksToSeconds(ReadClock() - start);
+}
+
+void SoftwareRenderDevice::DrawInstanced(unsigned int vertexCount, unsigned int instanceCount, unsigned int startVertex) {
+	NullRenderDevice::DrawInstanced(vertexCount, instanceCount, startVertex);
+	ClockTicks start = ReadClock();
+	const Matrix4& world = *reinterpret_cast<const Matrix4*>(GetConstants(ConstantSlot_Object));
+	DrawMesh(world, GetMaterial(), vertexCount, startVertex, instanceCount);
+	gpuTime += ClockTicksToSeconds(ReadClock() - start);
+}
+
+void SoftwareRenderDevice::DrawSceneInstances() {
+	NullRenderDevice::DrawSceneInstances();
+	ClockTicks start = ReadClock();
+	unsigned int eyeInstances = GetStereoMode() == StereoMode_Instanced ? EyeCount : 0;
+	const std::vector<SceneInstance>& instances = GetSceneInstances();
+	const std::vector<IndirectDrawArgs>& draws = GetCulledDraws();
+	const std::vector<unsigned int>& visible = GetVisibleInstances();
+	for (size_t mesh = 0; mesh < draws.size(); mesh++) {
+		const IndirectDrawArgs& draw = draws[mesh];
+		unsigned int count = draw.InstanceCount / (eyeInstances > 0 ? eyeInstances : 1);
+		for (unsigned int i = 0; i < count; i++) {
+			const SceneInstance& instance = instances[visible[draw.StartInstanceLocation + i]];
+			DrawMesh(instance.TransposedWorld, instance.Material, draw.VertexCountPerInstance, draw.StartVertexLocation, eyeInstances);
+		}
+	}
+	gpuTime += ClockTicksToSeconds(ReadClock() - start);
+}
+
+void SoftwareRenderDevice::CompositeFoveatedTarget() {
+	const FoveatedLayout& layout = *GetFoveatedLayout();
+	rasterizer.Resolve(Target_Foveated, foveatedImage);
+	std::fill(image.Pixels.begin(), image.Pixels.end(), 0);
+
+	// As the composite pass: the center of each eye texture pixel is mapped into the region in the
+	// foveated target, clamped half a texel inside it and sampled bilinearly.
+	jobs.ParallelFor(EyeCount * FoveatedRegionCount, [&](unsigned int index, int thread) {
+		const FoveatedRegion& region = layout.Regions[index / FoveatedRegionCount][index % FoveatedRegionCount];
+		if (region.Eye.Size.w == 0 || region.Eye.Size.h == 0 || region.Target.Size.w == 0 || region.Target.Size.h == 0) {
+			return;
+		}
+		float tint[3] = { 1.0f, 1.0f, 1.0f };
+		if (layout.Visualize) {
+			bool reducedX = region.Target.Size.w < region.Eye.Size.w;
+			bool reducedY = region.Target.Size.h < region.Eye.Size.h;
+			if (reducedX && reducedY) {
+				tint[0] = 0.5f;
+				tint[1] = 0.5f;
+			}
+			else if (reducedX || reducedY) {
+				tint[1] = 0.5f;
+				tint[2] = 0.5f;
+			}
+		}
+		float scaleX = static_cast<float>(region.Target.Size.w) / region.Eye.Size.w;
+		float scaleY = static_cast<float>(region.Target.Size.h) / region.Eye.Size.h;
+		float minX = region.Target.Pos.x + 0.5f;
+		float maxX = region.Target.Pos.x + region.Target.Size.w - 0.5f;
+		float minY = region.Target.Pos.y + 0.5f;
+		float maxY = region.Target.Pos.y + region.Target.Size.h - 0.5f;
+		int lastX = region.Target.Pos.x + region.Target.Size.w - 1;
+		int lastY = region.Target.Pos.y + region.Target.Size.h - 1;
+		for (int y = 0; y < region.Eye.Size.h; y++) {
+			float sy = std::max(minY, std::min(maxY, region.Target.Pos.y + (y + 0.5f) * scaleY)) - 0.5f;
+			int y0 = static_cast<int>(sy);
+			int y1 = std::min(y0 + 1, lastY);
+			float fy = sy - y0;
+			unsigned int* row = &image.Pixels[(region.Eye.Pos.y + y) * image.Size.w + region.Eye.Pos.x];
+			for (int x = 0; x < region.Eye.Size.w; x++) {
+				float sx = std::max(minX, std::min(maxX, region.Target.Pos.x + (x + 0.5f) * scaleX)) - 0.5f;
+				int x0 = static_cast<int>(sx);
+				int x1 = std::min(x0 + 1, lastX);
+				float fx = sx - x0;
+				unsigned int pixel = 0;
+				for (int channel = 0; channel < 4; channel++) {
+					float value = static_cast<float>(SampleChannel(foveatedImage, x0, y0, x1, y1, fx, fy, channel * 8));
+					if (channel < 3) {
+						value *= tint[channel];
+					}
+					pixel |= static_cast<unsigned int>(value + 0.5f) << (channel * 8);
+				}
+				row[x] = pixel;
+			}
+		}
+	});
+}
+
+void SoftwareRenderDevice::ResolveEyeTexture() {
+	NullRenderDevice::ResolveEyeTexture();
+	ClockTicks start = ReadClock();
+	if (GetFoveatedLayout() != nullptr) {
+		CompositeFoveatedTarget();
+	}
+	else if (!IsResolveFused()) {
+		rasterizer.Resolve(Target_Eye, image);
+	}
+	gpuTime += ClockTicksToSeconds(ReadClock() - start);
+}
+
+void SoftwareRenderDevice::PresentDistorted(const DistortionConstants constants[EyeCount]) {
+	NullRenderDevice::PresentDistorted(constants);
+	ClockTicks start = ReadClock();
+	const DistortionMesh* meshes[EyeCount] = { &GetDistortionMesh(0), &GetDistortionMesh(1) };
+	DistortionSource source = GetDistortionSource(image);
+	if (IsResolveFused()) {
+		source.Pixels = rasterizer.GetSamples(Target_Eye);
+		source.Stride = rasterizer.GetStride();
+		source.PlaneSize = rasterizer.GetPlaneSize();
+		source.SampleCount = rasterizer.GetSampleCount();
+	}
+	if (source.Pixels != nullptr) {
+		DrawDistortionMeshes(source, meshes, constants, displayImage, jobs);
+	}
+	gpuTime += ClockTicksToSeconds(ReadClock() - start);
+}
+
+void SoftwareRenderDevice::BeginGpuTimer() {
+	gpuTimerRunning = true;
+	gpuTime = 0.0;
+}
+
+void SoftwareRenderDevice::EndGpuTimer() {
+	if (gpuTimerRunning) {
+		gpuFrameTime = gpuTime;
+		gpuTimerRunning = false;
+	}
+}
+
+bool SoftwareRenderDevice::GetGpuFrameTime(double& outSeconds) {
+	if (gpuFrameTime < 0.0) {
+		return false;
+	}
+	outSeconds = gpuFrameTime;
+	return true;
+}
+
+const Image& SoftwareRenderDevice::GetImage() const {
+	return image;
+}
+
+const Image& SoftwareRenderDevice::GetDisplayImage() const {
+	return displayImage;
+}
+
+void SoftwareRenderDevice::SetReferenceMode(bool reference) {
+	rasterizer.SetReferenceMode(reference);
+}
+
+const SoftwareRasterizer::Statistics& SoftwareRenderDevice::GetRasterizerStatistics() const {
+	return rasterizer.GetStatistics();
+}
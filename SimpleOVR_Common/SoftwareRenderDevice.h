@@ -0,0 +1,124 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+
+#pragma once
+
+#include "Image.h"
+#include "JobSystem.h"
+#include "NullRenderDevice.h"
+#include "SoftwareRasterizer.h"
+#include <vector>
+
+/*
+	A NullRenderDevice that actually draws, with SoftwareRasterizer. Everything but the drawing,
+	constants, recording and latching included, is left to NullRenderDevice, so the frame loop
+	runs exactly as it does there and the statistics are the same.
+
+	Draws transform the scene's vertices by the bound constants as the D3D11 vertex shaders do and
+	shade every pixel with the material's color like the pixel shader. StereoMode_Instanced clips
+	each instance to its eye's ClipRect with the scissor rectangle rather than clip distances,
+	which only differs for triangles crossing the clip rectangle within a pixel's width.
+	DrawSceneInstances draws each visible instance with its own world matrix and material, mesh by
+	mesh in the order NullRenderDevice culled them.
+	Multisampling is 4x for any multisampleCount above 1.
+
+	ResolveEyeTexture produces the image LibOVR would get, the eye texture or the intermediary,
+	composited from the foveated target with bilinear filtering like the D3D11 composite pass if
+	there is a layout. It can be saved and compared with Image.h, so a frame can be checked
+	against a known good one without a GPU.
+
+	The hidden area is masked by setting the depth of its pixels to 0, and ClearEyeTexture
+	leaves those pixels alone.
+
+	PresentDistorted draws that image through the distortion meshes into the display image, of
+	displaySize, with DrawDistortionMeshes (Distortion.h). With a fused resolve there is no such
+	image: ResolveEyeTexture leaves it as it was, and PresentDistorted samples the rasterizer's
+	samples instead.
+
+	The "GPU" time is the time spent rasterizing, flushing and resolving between BeginGpuTimer and
+	EndGpuTimer, available right away.
+*/
+class SoftwareRenderDevice : public NullRenderDevice {
+public:
+	// The device doesn't own jobs, which has to outlive it. Its threads rasterize and resolve.
+	SoftwareRenderDevice(Size2i displaySize, Size2i eyeTextureSize, int multisampleCount, JobSystem& jobs);
+
+	void ClearEyeTexture(const float color[4]);
+	void ClearDepthStencil(float depth, unsigned char stencil);
+	void BindEyeTexture();
+	void SetSceneVertices(const Vertex* vertices, unsigned int vertexCount);
+	void UploadSceneVertices(unsigned int firstVertex, const Vertex* vertices, unsigned int vertexCount);
+	void Draw(unsigned int vertexCount, unsigned int startVertex);
+	void DrawInstanced(unsigned int vertexCount, unsigned int instanceCount, unsigned int startVertex);
+	void DrawSceneInstances();
+	void ResolveEyeTexture();
+	void PresentDistorted(const DistortionConstants constants[EyeCount]);
+	void BeginGpuTimer();
+	void EndGpuTimer();
+	bool GetGpuFrameTime(double& outSeconds);
+
+	// The result of the last ResolveEyeTexture that resolved.
+	const Image& GetImage() const;
+
+	// The result of the last PresentDistorted, black until then.
+	const Image& GetDisplayImage() const;
+
+	// See SoftwareRasterizer::SetReferenceMode.
+	void SetReferenceMode(bool reference);
+	const SoftwareRasterizer::Statistics& GetRasterizerStatistics() const;
+
+private:
+	enum Target {
+		Target_Eye,
+		Target_Foveated,
+		TargetCount
+	};
+
+	Target GetSceneTarget() const;
+
+	// Transforms vertexCount vertices from startVertex by the transposed matrix into clipVertices.
+	void TransformVertices(const Matrix4& transposed, unsigned int vertexCount, unsigned int startVertex);
+	void DrawTriangles(unsigned int vertexCount, const Rect2i& scissor, unsigned int color);
+
+	// A draw with the given world matrix and material: with the bound Matrix4 if eyeInstances is
+	// 0, otherwise with the bound StereoConstants, as that many instances for the eyes.
+	void DrawMesh(const Matrix4& world, int material, unsigned int vertexCount, unsigned int startVertex, unsigned int eyeInstances);
+	void CompositeFoveatedTarget();
+
+	JobSystem& jobs;
+	SoftwareRasterizer rasterizer;
+	std::vector<Vertex> sceneVertices;
+	std::vector<float> clipVertices; // 4 floats per vertex
+	Image foveatedImage;
+	Image image;
+	Image displayImage;
+
+	bool gpuTimerRunning;
+	double gpuTime; // Of the frame being timed
+	double gpuFrameTime; // Negative until a frame has been timed
+};
@@ -0,0 +1,105 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#include "StateCache.h"
+#include <cstring>
+
+namespace {
+	const char* StateSlotNames[StateSlotCount] = {
+		"InputLayout",
+		"VertexBuffer",
+		"InstanceBuffer",
+		"Topology",
+		"VertexShader",
+		"PixelShader",
+		"VertexConstants.Frame",
+		"VertexConstants.Object",
+		"VertexResource",
+		"PixelConstants",
+		"PixelResource",
+		"PixelSampler",
+		"RenderTargets",
+		"Viewport"
+	};
+}
+
+const char* GetStateSlotName(StateSlot slot) {
+	return StateSlotNames[slot];
+}
+
+StateCache::StateCache() {
+	Invalidate();
+	ResetStatistics();
+}
+
+bool StateCache::Change(StateSlot slot, const void* object, unsigned long long value) {
+	State& state = states[slot];
+	if (state.Known && state.Object == object && state.Value == value) {
+		statistics.Filtered[slot]++;
+		statistics.TotalFiltered++;
+		return false;
+	}
+	state.Known = true;
+	state.Object = object;
+	state.Value = value;
+	statistics.Issued[slot]++;
+	statistics.TotalIssued++;
+	return true;
+}
+
+bool StateCache::ChangeViewport(const Rect2i& viewport) {
+	// Positions and sizes fit in 16 bits each.
+	unsigned long long value =
+		static_cast<unsigned long long>(viewport.Pos.x & 0xffff) |
+		static_cast<unsigned long long>(viewport.Pos.y & 0xffff) << 16 |
+		static_cast<unsigned long long>(viewport.Size.w & 0xffff) << 32 |
+		static_cast<unsigned long long>(viewport.Size.h & 0xffff) << 48;
+	return Change(StateSlot_Viewport, nullptr, value);
+}
+
+void StateCache::Invalidate() {
+	for (int slot = 0; slot < StateSlotCount; slot++) {
+		states[slot].Known = false;
+	}
+}
+
+const StateCache::Statistics& StateCache::GetStatistics() const {
+	return statistics;
+}
+
+void StateCache::ResetStatistics() {
+	std::memset(&statistics, 0, sizeof(statistics));
+}
+
+void AddStateStatistics(StateCache::Statistics& a, const StateCache::Statistics& b) {
+	for (int slot = 0; slot < StateSlotCount; slot++) {
+		a.Issued[slot] += b.Issued[slot];
+		a.Filtered[slot] += b.Filtered[slot];
+	}
+	a.TotalIssued += b.TotalIssued;
+	a.TotalFiltered += b.TotalFiltered;
+}
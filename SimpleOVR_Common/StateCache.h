@@ -0,0 +1,95 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#pragma once
+
+#include "RenderDevice.h"
+
+/*
+	A shadow copy of the pipeline state a device has set, so it can skip the calls that would set
+	what is already there. Each call the device is about to make goes through Change first, with
+	the object it binds and whatever else the call takes packed into value; Change returns
+	whether the call is needed, and counts it as issued or filtered.
+
+	The slots are the ones the scene and the composite use, each an IASet*, VSSet*, PSSet*, OMSet*
+	or RSSet* call that binds a single thing. A cache belongs to one context: D3D11 deferred
+	contexts start from the default state and the immediate context goes back to it after
+	executing a command list, so their caches are invalidated then.
+*/
+enum StateSlot {
+	StateSlot_InputLayout,
+	StateSlot_VertexBuffer,
+	StateSlot_InstanceBuffer, // The second vertex buffer
+	StateSlot_Topology,
+	StateSlot_VertexShader,
+	StateSlot_PixelShader,
+	StateSlot_VertexConstants, // One per ConstantSlot
+	StateSlot_VertexResource = StateSlot_VertexConstants + ConstantSlotCount,
+	StateSlot_PixelConstants,
+	StateSlot_PixelResource,
+	StateSlot_PixelSampler,
+	StateSlot_RenderTargets,
+	StateSlot_Viewport,
+	StateSlotCount
+};
+
+const char* GetStateSlotName(StateSlot slot);
+
+class StateCache {
+public:
+	struct Statistics {
+		unsigned long long Issued[StateSlotCount];
+		unsigned long long Filtered[StateSlotCount];
+		unsigned long long TotalIssued;
+		unsigned long long TotalFiltered;
+	};
+
+	StateCache();
+
+	// Whether binding object (with value) to slot changes anything.
+	bool Change(StateSlot slot, const void* object, unsigned long long value = 0);
+	bool ChangeViewport(const Rect2i& viewport);
+
+	// Forgets the state, so the next change to every slot is issued.
+	void Invalidate();
+
+	const Statistics& GetStatistics() const;
+	void ResetStatistics();
+
+private:
+	struct State {
+		bool Known;
+		const void* Object;
+		unsigned long long Value;
+	};
+
+	State states[StateSlotCount];
+	Statistics statistics;
+};
+
+// Adds b's counts to a.
+void AddStateStatistics(StateCache::Statistics& a, const StateCache::Statistics& b);
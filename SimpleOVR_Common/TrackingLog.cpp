@@ -0,0 +1,193 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#include "TrackingLog.h"
+#include "MappedFile.h"
+#include "VrMath.h"
+#include <algorithm>
+#include <cstring>
+
+const char TrackingLogMagic[8] = { 'S', 'O', 'V', 'R', 'T', 'R', 'A', 'K' };
+
+namespace {
+	const size_t RecordSizes[TrackingRecordTypeCount] = { sizeof(FrameTiming), sizeof(PoseState), sizeof(Pose) };
+
+	bool SampleTimeLess(const PoseState& a, double time) {
+		return a.TimeInSeconds < time;
+	}
+}
+
+TrackingLogWriter::TrackingLogWriter() :
+	file(nullptr),
+	failed(false),
+	wroteSample(false),
+	lastSampleTime(0.0)
+{
+}
+
+TrackingLogWriter::~TrackingLogWriter() {
+	Close();
+}
+
+bool TrackingLogWriter::Open(const char* path) {
+	Close();
+	file = std::fopen(path, "wb");
+	if (file == nullptr) {
+		return false;
+	}
+	failed = false;
+	wroteSample = false;
+
+	TrackingLogHeader header;
+	std::memcpy(header.Magic, TrackingLogMagic, sizeof(header.Magic));
+	header.Version = TrackingLogVersion;
+	header.Reserved = 0;
+	failed = std::fwrite(&header, sizeof(header), 1, file) != 1;
+	return true;
+}
+
+bool TrackingLogWriter::Close() {
+	if (file == nullptr) {
+		return !failed;
+	}
+	failed = std::fclose(file) != 0 || failed;
+	file = nullptr;
+	return !failed;
+}
+
+bool TrackingLogWriter::IsOpen() const {
+	return file != nullptr;
+}
+
+void TrackingLogWriter::WriteFrame(const FrameTiming& timing) {
+	Write(TrackingRecord_Frame, &timing, sizeof(timing));
+}
+
+void TrackingLogWriter::WriteSample(const PoseState& state) {
+	if (wroteSample && state.TimeInSeconds <= lastSampleTime) {
+		return;
+	}
+	wroteSample = true;
+	lastSampleTime = state.TimeInSeconds;
+	Write(TrackingRecord_Sample, &state, sizeof(state));
+}
+
+void TrackingLogWriter::WritePrediction(const Pose& headPose) {
+	Write(TrackingRecord_Prediction, &headPose, sizeof(headPose));
+}
+
+void TrackingLogWriter::Write(TrackingRecordType type, const void* data, size_t size) {
+	if (file == nullptr) {
+		return;
+	}
+	// Buffered by the C library, a few hundred bytes a frame cost next to nothing.
+	unsigned int tag = type;
+	if (std::fwrite(&tag, sizeof(tag), 1, file) != 1 || std::fwrite(data, size, 1, file) != 1) {
+		failed = true;
+	}
+}
+
+bool TrackingLog::Load(const char* path) {
+	samples.clear();
+	frames.clear();
+
+	MappedFile file;
+	if (!file.Open(path) || file.GetSize() < sizeof(TrackingLogHeader)) {
+		return false;
+	}
+	TrackingLogHeader header;
+	std::memcpy(&header, file.GetData(), sizeof(header));
+	if (std::memcmp(header.Magic, TrackingLogMagic, sizeof(TrackingLogMagic)) != 0 || header.Version != TrackingLogVersion) {
+		return false;
+	}
+
+	// Records aren't aligned, so everything is copied out.
+	const unsigned char* data = file.GetData();
+	size_t offset = sizeof(header);
+	while (offset + sizeof(unsigned int) <= file.GetSize()) {
+		unsigned int type;
+		std::memcpy(&type, data + offset, sizeof(type));
+		if (type >= TrackingRecordTypeCount) {
+			samples.clear();
+			frames.clear();
+			return false;
+		}
+		if (offset + sizeof(type) + RecordSizes[type] > file.GetSize()) {
+			break;
+		}
+		const unsigned char* record = data + offset + sizeof(type);
+		offset += sizeof(type) + RecordSizes[type];
+
+		if (type == TrackingRecord_Frame) {
+			TrackedFrame frame;
+			std::memcpy(&frame.Timing, record, sizeof(frame.Timing));
+			frame.Predicted = false;
+			frame.PredictedHeadPose.Orientation = QuaternionIdentity();
+			frame.PredictedHeadPose.Position.x = frame.PredictedHeadPose.Position.y = frame.PredictedHeadPose.Position.z = 0.0f;
+			frame.PredictionSample = 0;
+			frames.push_back(frame);
+		}
+		else if (type == TrackingRecord_Sample) {
+			PoseState state;
+			std::memcpy(&state, record, sizeof(state));
+			if (samples.empty() || state.TimeInSeconds > samples.back().TimeInSeconds) {
+				samples.push_back(state);
+			}
+		}
+		else if (!frames.empty() && !samples.empty()) {
+			std::memcpy(&frames.back().PredictedHeadPose, record, sizeof(Pose));
+			frames.back().Predicted = true;
+			frames.back().PredictionSample = static_cast<unsigned int>(samples.size()) - 1;
+		}
+	}
+	return true;
+}
+
+const std::vector<PoseState>& TrackingLog::GetSamples() const {
+	return samples;
+}
+
+const std::vector<TrackedFrame>& TrackingLog::GetFrames() const {
+	return frames;
+}
+
+bool TrackingLog::GetHeadPose(double time, Pose& outPose) const {
+	if (samples.empty() || time < samples.front().TimeInSeconds || time > samples.back().TimeInSeconds) {
+		return false;
+	}
+	size_t next = std::lower_bound(samples.begin(), samples.end(), time, SampleTimeLess) - samples.begin();
+	if (next == 0) {
+		outPose = samples[0].ThePose;
+		return true;
+	}
+	const PoseState& a = samples[next - 1];
+	const PoseState& b = samples[next];
+	float t = static_cast<float>((time - a.TimeInSeconds) / (b.TimeInSeconds - a.TimeInSeconds));
+	outPose.Orientation = Slerp(a.ThePose.Orientation, b.ThePose.Orientation, t);
+	outPose.Position = a.ThePose.Position + (b.ThePose.Position - a.ThePose.Position) * t;
+	return true;
+}
@@ -0,0 +1,118 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#pragma once
+
+#include "VrTypes.h"
+#include <cstdio>
+#include <vector>
+
+/*
+	Binary tracking log, little endian, written while the frame loop runs (see
+	StereoSetup::TrackingLog) and read back offline:
+
+		TrackingLogHeader
+		Records until the end of the file, each a TrackingRecordType followed by
+			TrackingRecord_Frame: FrameTiming. A frame began, the records after it belong to it.
+			TrackingRecord_Sample: PoseState. The head as tracked at some point during the frame.
+			TrackingRecord_Prediction: Pose. The head pose the frame was drawn with, predicted for
+			its scanout midpoint. One per frame, with late latching the latched one.
+
+	The tracking states are sampled at the beginning and end of each frame and for the pose it is
+	drawn with, so the head's actual path can be interpolated between them to see how good a prediction
+	was. A log cut off in the middle of a record, by a crash say, reads up to that record.
+*/
+struct TrackingLogHeader {
+	char Magic[8]; // TrackingLogMagic
+	unsigned int Version; // TrackingLogVersion
+	unsigned int Reserved;
+};
+
+enum TrackingRecordType {
+	TrackingRecord_Frame,
+	TrackingRecord_Sample,
+	TrackingRecord_Prediction,
+	TrackingRecordTypeCount
+};
+
+extern const char TrackingLogMagic[8];
+const unsigned int TrackingLogVersion = 1;
+
+class TrackingLogWriter {
+public:
+	TrackingLogWriter();
+	~TrackingLogWriter();
+
+	// Returns false if the file can't be created.
+	bool Open(const char* path);
+
+	// Returns false if anything failed to be written.
+	bool Close();
+	bool IsOpen() const;
+
+	void WriteFrame(const FrameTiming& timing);
+
+	// States no newer than the last one written are skipped, they add nothing.
+	void WriteSample(const PoseState& state);
+	void WritePrediction(const Pose& headPose);
+
+private:
+	TrackingLogWriter(const TrackingLogWriter&);
+	TrackingLogWriter& operator=(const TrackingLogWriter&);
+
+	void Write(TrackingRecordType type, const void* data, size_t size);
+
+	FILE* file;
+	bool failed;
+	bool wroteSample;
+	double lastSampleTime;
+};
+
+struct TrackedFrame {
+	FrameTiming Timing;
+	bool Predicted; // Whether the log has the pose it was drawn with
+	Pose PredictedHeadPose;
+	unsigned int PredictionSample; // The latest of the samples when the pose was predicted
+};
+
+class TrackingLog {
+public:
+	// Returns false, leaving the log empty, if the file can't be read or is not a tracking log.
+	bool Load(const char* path);
+
+	// In the order they were sampled.
+	const std::vector<PoseState>& GetSamples() const;
+	const std::vector<TrackedFrame>& GetFrames() const;
+
+	// The head pose at a time between the first and the last sample, interpolated between the
+	// samples around it. Returns false outside of that.
+	bool GetHeadPose(double time, Pose& outPose) const;
+
+private:
+	std::vector<PoseState> samples;
+	std::vector<TrackedFrame> frames;
+};
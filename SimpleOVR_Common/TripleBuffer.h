@@ -0,0 +1,90 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#pragma once
+
+#include <atomic>
+
+/*
+	Hands the newest value from one producer thread to one consumer thread without locks, and
+	without either of them ever waiting for the other.
+
+	There are three copies: the one the producer writes, the one the consumer reads and the one
+	published last. Publish swaps the producer's copy with the published one and Update swaps the
+	consumer's with it if something was published since, each with a single atomic exchange. The
+	consumer therefore always gets a complete value, the newest one, and values it doesn't get to
+	in time are simply overwritten.
+
+	The copy the producer gets after publishing holds an old value, not the one it just published,
+	so it has to be written in full every time.
+*/
+template<typename T>
+class TripleBuffer {
+public:
+	TripleBuffer() : shared(1), writeIndex(0), readIndex(2) {
+	}
+
+	// Producer only.
+	T& GetWriteBuffer() {
+		return slots[writeIndex].Value;
+	}
+
+	void Publish() {
+		writeIndex = shared.exchange(writeIndex | NewBit) & IndexMask;
+	}
+
+	// Consumer only. Takes the newest value, returns false if nothing was published since the last call.
+	bool Update() {
+		if ((shared.load() & NewBit) == 0) {
+			return false;
+		}
+		readIndex = shared.exchange(readIndex) & IndexMask;
+		return true;
+	}
+
+	const T& GetReadBuffer() const {
+		return slots[readIndex].Value;
+	}
+
+private:
+	TripleBuffer(const TripleBuffer&);
+	TripleBuffer& operator=(const TripleBuffer&);
+
+	static const unsigned int IndexMask = 3;
+	static const unsigned int NewBit = 4; // Set when the shared copy hasn't been taken yet
+
+	// Padded so the threads don't write to the same cache line.
+	struct Slot {
+		T Value;
+		char Padding[64];
+	};
+
+	Slot slots[3];
+	std::atomic<unsigned int> shared; // Index of the shared copy, plus NewBit
+	unsigned int writeIndex;
+	unsigned int readIndex;
+};
@@ -0,0 +1,224 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#pragma once
+
+/*
+	Small scalar math library for the types in VrTypes.h.
+
+	The functions follow OVR_Math.h and OVR_Stereo.cpp (LibOVR 0.4.3) operation for operation, so
+	the results match what the original sample computed with OVR::Matrix4f and friends. Only what
+	the frame loop needs is here.
+*/
+
+#include "VrTypes.h"
+#include <cmath>
+
+inline Vector3 operator+(const Vector3& a, const Vector3& b) {
+	Vector3 r = { a.x + b.x, a.y + b.y, a.z + b.z };
+	return r;
+}
+
+inline Vector3 operator-(const Vector3& a, const Vector3& b) {
+	Vector3 r = { a.x - b.x, a.y - b.y, a.z - b.z };
+	return r;
+}
+
+inline Vector3 operator*(const Vector3& a, float s) {
+	Vector3 r = { a.x * s, a.y * s, a.z * s };
+	return r;
+}
+
+inline float Dot(const Vector3& a, const Vector3& b) {
+	return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+inline Vector3 Cross(const Vector3& a, const Vector3& b) {
+	Vector3 r = {
+		a.y * b.z - a.z * b.y,
+		a.z * b.x - a.x * b.z,
+		a.x * b.y - a.y * b.x
+	};
+	return r;
+}
+
+inline Vector3 Normalized(const Vector3& v) {
+	float length = std::sqrt(Dot(v, v));
+	return length > 0.0f ? v * (1.0f / length) : v;
+}
+
+inline Quaternion QuaternionIdentity() {
+	Quaternion q = { 0.0f, 0.0f, 0.0f, 1.0f };
+	return q;
+}
+
+// Rotation of angle radians around a normalized axis.
+inline Quaternion QuaternionFromAxisAngle(const Vector3& axis, float angle) {
+	float sinHalfAngle = std::sin(angle * 0.5f);
+	Quaternion q = { axis.x * sinHalfAngle, axis.y * sinHalfAngle, axis.z * sinHalfAngle, std::cos(angle * 0.5f) };
+	return q;
+}
+
+inline Quaternion operator*(const Quaternion& a, const Quaternion& b) {
+	Quaternion r = {
+		a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y,
+		a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x,
+		a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w,
+		a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z
+	};
+	return r;
+}
+
+inline Quaternion Conjugate(const Quaternion& q) {
+	Quaternion r = { -q.x, -q.y, -q.z, q.w };
+	return r;
+}
+
+inline Quaternion Normalized(const Quaternion& q) {
+	float length = std::sqrt(q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w);
+	Quaternion r = { q.x / length, q.y / length, q.z / length, q.w / length };
+	return r;
+}
+
+// Rotates v by the unit quaternion q.
+inline Vector3 Rotate(const Quaternion& q, const Vector3& v) {
+	Quaternion p = { v.x, v.y, v.z, 0.0f };
+	Quaternion r = q * p * Conjugate(q);
+	Vector3 result = { r.x, r.y, r.z };
+	return result;
+}
+
+// Spherical linear interpolation between two unit quaternions, taking the shortest path.
+inline Quaternion Slerp(const Quaternion& a, Quaternion b, float t) {
+	float cosTheta = a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w;
+	if (cosTheta < 0.0f) {
+		b.x = -b.x; b.y = -b.y; b.z = -b.z; b.w = -b.w;
+		cosTheta = -cosTheta;
+	}
+
+	float wa = 1.0f - t;
+	float wb = t;
+	if (cosTheta < 0.9995f) {
+		float theta = std::acos(cosTheta);
+		float sinTheta = std::sin(theta);
+		wa = std::sin((1.0f - t) * theta) / sinTheta;
+		wb = std::sin(t * theta) / sinTheta;
+	}
+	Quaternion r = { a.x * wa + b.x * wb, a.y * wa + b.y * wb, a.z * wa + b.z * wb, a.w * wa + b.w * wb };
+	return Normalized(r);
+}
+
+/*
+	Rotation vectors: the axis scaled by the angle in radians, which is how angular velocities and
+	accelerations are given. QuaternionFromRotationVector(RotationVector(q)) is q, give or take the
+	sign.
+*/
+inline Quaternion QuaternionFromRotationVector(const Vector3& v) {
+	float angle = std::sqrt(Dot(v, v));
+	return angle > 0.0f ? QuaternionFromAxisAngle(v * (1.0f / angle), angle) : QuaternionIdentity();
+}
+
+inline Vector3 RotationVector(Quaternion q) {
+	if (q.w < 0.0f) {
+		q.x = -q.x; q.y = -q.y; q.z = -q.z; q.w = -q.w;
+	}
+	Vector3 axis = { q.x, q.y, q.z };
+	float sinHalfAngle = std::sqrt(Dot(axis, axis));
+	if (sinHalfAngle <= 0.0f) {
+		return axis;
+	}
+	return axis * (2.0f * std::atan2(sinHalfAngle, q.w) / sinHalfAngle);
+}
+
+// The angle in radians between two orientations given as unit quaternions.
+inline float AngleBetween(const Quaternion& a, const Quaternion& b) {
+	// Not acos of the dot product, which loses small angles to rounding.
+	Quaternion difference = a * Conjugate(b);
+	Vector3 axis = { difference.x, difference.y, difference.z };
+	return 2.0f * std::atan2(std::sqrt(Dot(axis, axis)), std::fabs(difference.w));
+}
+
+inline Matrix4 MatrixIdentity() {
+	Matrix4 m = { {
+		{ 1.0f, 0.0f, 0.0f, 0.0f },
+		{ 0.0f, 1.0f, 0.0f, 0.0f },
+		{ 0.0f, 0.0f, 1.0f, 0.0f },
+		{ 0.0f, 0.0f, 0.0f, 1.0f }
+	} };
+	return m;
+}
+
+inline Matrix4 operator*(const Matrix4& a, const Matrix4& b) {
+	Matrix4 r;
+	for (int i = 0; i < 4; i++) {
+		for (int j = 0; j < 4; j++) {
+			r.M[i][j] = a.M[i][0] * b.M[0][j] + a.M[i][1] * b.M[1][j] + a.M[i][2] * b.M[2][j] + a.M[i][3] * b.M[3][j];
+		}
+	}
+	return r;
+}
+
+inline Matrix4 Transposed(const Matrix4& m) {
+	Matrix4 r;
+	for (int i = 0; i < 4; i++) {
+		for (int j = 0; j < 4; j++) {
+			r.M[i][j] = m.M[j][i];
+		}
+	}
+	return r;
+}
+
+// Same as OVR::Matrix4f::LookAtRH.
+inline Matrix4 LookAtRH(const Vector3& eye, const Vector3& at, const Vector3& up) {
+	Vector3 z = Normalized(eye - at);
+	Vector3 x = Normalized(Cross(up, z));
+	Vector3 y = Cross(z, x);
+	Matrix4 m = { {
+		{ x.x, x.y, x.z, -Dot(x, eye) },
+		{ y.x, y.y, y.z, -Dot(y, eye) },
+		{ z.x, z.y, z.z, -Dot(z, eye) },
+		{ 0.0f, 0.0f, 0.0f, 1.0f }
+	} };
+	return m;
+}
+
+// Same as ovrMatrix4f_Projection: D3D-style depth range (0 to 1).
+inline Matrix4 PerspectiveProjection(const FovPort& fov, float zNear, float zFar, bool rightHanded) {
+	float xScale = 2.0f / (fov.LeftTan + fov.RightTan);
+	float xOffset = (fov.LeftTan - fov.RightTan) * xScale * 0.5f;
+	float yScale = 2.0f / (fov.UpTan + fov.DownTan);
+	float yOffset = (fov.UpTan - fov.DownTan) * yScale * 0.5f;
+	float handednessScale = rightHanded ? -1.0f : 1.0f;
+
+	Matrix4 m = { {
+		{ xScale, 0.0f, handednessScale * xOffset, 0.0f },
+		{ 0.0f, yScale, handednessScale * -1.0f * yOffset, 0.0f },
+		{ 0.0f, 0.0f, -handednessScale * zFar / (zNear - zFar), (zFar * zNear) / (zNear - zFar) },
+		{ 0.0f, 0.0f, handednessScale, 0.0f }
+	} };
+	return m;
+}
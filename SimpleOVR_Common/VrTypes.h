@@ -0,0 +1,105 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#pragma once
+
+/*
+	Plain data types shared by every backend.
+
+	They have the same layout as their LibOVR counterparts (ovrVector3f, ovrQuatf, ovrPosef and so
+	on), which keeps the conversion in the LibOVR backend trivial, but they do not need any of the
+	Oculus SDK headers. This is what allows the frame loop to be built and run on machines without
+	LibOVR, a headset or even a GPU.
+*/
+
+struct Vector2i {
+	int x, y;
+};
+
+struct Size2i {
+	int w, h;
+};
+
+struct Rect2i {
+	Vector2i Pos;
+	Size2i Size;
+};
+
+struct Vector3 {
+	float x, y, z;
+};
+
+struct Quaternion {
+	float x, y, z, w;
+};
+
+struct Pose {
+	Quaternion Orientation;
+	Vector3 Position;
+};
+
+/*
+	A tracked pose with its derivatives at a point in time, same as ovrPoseStatef. Velocities and
+	accelerations are in the same space as the pose, the angular ones as rotation vectors (axis
+	times radians per second, or per second squared). Time is in seconds, on the HMD's clock.
+*/
+struct PoseState {
+	Pose ThePose;
+	Vector3 AngularVelocity;
+	Vector3 LinearVelocity;
+	Vector3 AngularAcceleration;
+	Vector3 LinearAcceleration;
+	double TimeInSeconds;
+};
+
+// Tangents of the half-angles of a field of view, same as ovrFovPort.
+struct FovPort {
+	float UpTan;
+	float DownTan;
+	float LeftTan;
+	float RightTan;
+};
+
+// Row-major matrix used with column vectors, the same convention as OVR::Matrix4f.
+struct Matrix4 {
+	float M[4][4];
+};
+
+// The subset of ovrEyeRenderDesc that the frame loop actually uses.
+struct EyeRenderDesc {
+	FovPort Fov;
+	Vector3 HmdToEyeViewOffset;
+};
+
+// The subset of ovrFrameTiming that the frame loop uses: when the frame began and when it will be
+// half scanned out, which is when it is seen on average. Seconds, on the HMD's clock.
+struct FrameTiming {
+	double ThisFrameSeconds;
+	double ScanoutMidpointSeconds;
+};
+
+const int EyeCount = 2;
@@ -0,0 +1,1513 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#include "D3D11RenderDevice.h"
+#include "FrameLoop.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+D3D11RenderDevice::D3D11RenderDevice(HWND hwnd, Size2i backBufferSize, Size2i eyeTextureSize, int multisampleCount, ShaderCache& shaderCache) :
+	eyeTextureSize(eyeTextureSize),
+	multisampleCount(multisampleCount),
+	stereoMode(StereoMode_MultiPass),
+	shaderCache(shaderCache),
+	d3dDevice(nullptr),
+	d3dContext(nullptr),
+	d3dContext1(nullptr),
+	featureLevel(D3D_FEATURE_LEVEL_10_1),
+	d3dSwapChain(nullptr),
+	d3dBackBufferRenderTargetView(nullptr),
+	backBufferSize(backBufferSize),
+	clearColor(false),
+	clearDepthStencil(false),
+	d3dCompositeVertexShader(nullptr),
+	d3dCompositePixelShader(nullptr),
+	d3dCompositeSampler(nullptr),
+	d3dCompositeConstantBuffer(nullptr),
+	foveated(false),
+	d3dCullShader(nullptr),
+	d3dInstanceVertexShader(nullptr),
+	d3dStereoInstanceVertexShader(nullptr),
+	d3dInstancePixelShader(nullptr),
+	d3dInstanceInputLayout(nullptr),
+	d3dStereoInstanceInputLayout(nullptr),
+	d3dCullConstantBuffer(nullptr),
+	d3dMaterialColorBuffer(nullptr),
+	d3dInstanceBuffer(nullptr),
+	d3dInstanceView(nullptr),
+	d3dMeshDrawBuffer(nullptr),
+	d3dMeshDrawView(nullptr),
+	d3dDrawArgsBuffer(nullptr),
+	d3dDrawArgsView(nullptr),
+	d3dVisibleBuffer(nullptr),
+	d3dVisibleView(nullptr),
+	sceneInstanceCount(0),
+	sceneMeshCount(0),
+	d3dDistortionVertexShader(nullptr),
+	d3dDistortionPixelShader(nullptr),
+	d3dDistortionResolvePixelShader(nullptr),
+	d3dDistortionInputLayout(nullptr),
+	d3dDistortionSampler(nullptr),
+	d3dDistortionConstantBuffer(nullptr),
+	fusedResolve(false),
+	d3dHiddenAreaVertexShader(nullptr),
+	d3dHiddenAreaInputLayout(nullptr),
+	hiddenAreaSet(false),
+	d3dSceneRenderTargetView(nullptr),
+	d3dDepthStencilView(nullptr),
+	d3dInputLayout(nullptr),
+	d3dVertexShader(nullptr),
+	d3dStereoVertexShader(nullptr),
+	d3dPixelShader(nullptr),
+	d3dVertexBuffer(nullptr),
+	vertexBufferCapacity(0),
+	material(0),
+	d3dConstantBuffer(nullptr),
+	constantAllocator(ConstantRingAllocator::DefaultCapacity),
+	mappedConstants(nullptr),
+	constantFrame(0),
+	fencedFrame(0),
+	completedFrame(0),
+	issuedQueries(0),
+	completedQueries(0),
+	gpuTimersIssued(0),
+	gpuTimersRead(0),
+	gpuTimerRunning(false),
+	gpuFrameTime(-1.0)
+{
+	for (int i = 0; i < FrameQueryCount; i++) {
+		d3dFrameQueries[i] = nullptr;
+		queryFrames[i] = 0;
+	}
+	for (int slot = 0; slot < ConstantSlotCount; slot++) {
+		d3dFallbackConstantBuffers[slot] = nullptr;
+	}
+	for (int part = 0; part < LatchedConstantParts; part++) {
+		d3dLatchedConstantBuffers[part] = nullptr;
+	}
+	for (int i = 0; i < MaxMaterials; i++) {
+		d3dMaterialConstantBuffers[i] = nullptr;
+	}
+	for (int eye = 0; eye < EyeCount; eye++) {
+		d3dDistortionVertexBuffers[eye] = nullptr;
+		d3dDistortionIndexBuffers[eye] = nullptr;
+		distortionIndexCounts[eye] = 0;
+		d3dHiddenAreaVertexBuffers[eye] = nullptr;
+		hiddenAreaVertexCounts[eye] = 0;
+	}
+	std::memset(hiddenAreaViewports, 0, sizeof(hiddenAreaViewports));
+	std::memset(gpuTimers, 0, sizeof(gpuTimers));
+
+
+	/*
+		D3D11 initialization.
+		This example uses no fancy features, so we only require Direct3D 10.1 capable hardware.
+		If you attempt to target anything less you might start getting crashes in LibOVR or various
+		D3D-related errors.
+	*/
+	D3D_FEATURE_LEVEL requestedLevels[] = { D3D_FEATURE_LEVEL_11_0, D3D_FEATURE_LEVEL_10_1 };
+	D3D_FEATURE_LEVEL obtainedLevel;
+
+	DXGI_SWAP_CHAIN_DESC scd;
+	ZeroMemory(&scd, sizeof(scd));
+	scd.BufferCount = 1;
+	scd.BufferDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	scd.BufferDesc.Scaling = DXGI_MODE_SCALING_UNSPECIFIED;
+	scd.BufferDesc.ScanlineOrdering = DXGI_MODE_SCANLINE_ORDER_UNSPECIFIED;
+	scd.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
+
+	scd.Flags = DXGI_SWAP_CHAIN_FLAG_ALLOW_MODE_SWITCH;
+	scd.OutputWindow = hwnd;
+	scd.SampleDesc.Count = multisampleCount;
+	scd.SwapEffect = DXGI_SWAP_EFFECT_DISCARD;
+	scd.Windowed = false;
+
+	// NOTE: LibOVR 0.4.3 requires that the width and height for the backbuffer is set even if
+	// you use windowed mode, despite being optional according to the D3D11 documentation.
+	scd.BufferDesc.Width = backBufferSize.w;
+	scd.BufferDesc.Height = backBufferSize.h;
+	scd.BufferDesc.RefreshRate.Numerator = 0;
+	scd.BufferDesc.RefreshRate.Denominator = 1;
+
+	UINT createFlags = 0;
+#ifdef _DEBUG
+	// This flag gives you some quite wonderful debug text. Not wonderful for performance, though!
+	createFlags |= D3D11_CREATE_DEVICE_DEBUG;
+#endif
+
+	D3D11CreateDeviceAndSwapChain(
+		nullptr,
+		D3D_DRIVER_TYPE_HARDWARE,
+		nullptr,
+		createFlags,
+		requestedLevels,
+		sizeof(requestedLevels) / sizeof(D3D_FEATURE_LEVEL),
+		D3D11_SDK_VERSION,
+		&scd,
+		&d3dSwapChain,
+		&d3dDevice,
+		&obtainedLevel,
+		&d3dContext);
+	featureLevel = obtainedLevel;
+	immediate.D3DContext = d3dContext;
+
+	// Create a render target view for the backbuffer. This will be used during rendering when we
+	// actually render the eye buffers to the HMD.
+	ID3D11Texture2D* pBackBuffer = nullptr;
+	d3dSwapChain->GetBuffer(0, __uuidof(ID3D11Texture2D), (LPVOID*)&pBackBuffer);
+	d3dDevice->CreateRenderTargetView(pBackBuffer, nullptr, &d3dBackBufferRenderTargetView);
+	pBackBuffer->Release();
+
+	// We don't get a depth buffer by default, and you'll probably want one of those. It and the
+	// texture that will hold both (undistorted) eye views come from the target pool.
+	std::memset(&noTarget, 0, sizeof(noTarget));
+	std::memset(&colorClear, 0, sizeof(colorClear));
+	std::memset(&depthStencilClear, 0, sizeof(depthStencilClear));
+	graphBackend.Device = this;
+	PlanTargets();
+
+	SetupScene();
+}
+
+D3D11RenderDevice::~D3D11RenderDevice() {
+	ReleaseSceneInstances();
+	ID3D11DeviceChild* d3dGpuDrivenObjects[] = {
+		d3dMaterialColorBuffer, d3dCullConstantBuffer, d3dStereoInstanceInputLayout, d3dInstanceInputLayout, d3dInstancePixelShader,
+		d3dStereoInstanceVertexShader, d3dInstanceVertexShader, d3dCullShader
+	};
+	for (size_t i = 0; i < sizeof(d3dGpuDrivenObjects) / sizeof(d3dGpuDrivenObjects[0]); i++) {
+		if (d3dGpuDrivenObjects[i] != nullptr) {
+			d3dGpuDrivenObjects[i]->Release();
+		}
+	}
+	ID3D11DeviceChild* d3dDistortionObjects[] = {
+		d3dDistortionIndexBuffers[1], d3dDistortionVertexBuffers[1], d3dDistortionIndexBuffers[0], d3dDistortionVertexBuffers[0],
+		d3dDistortionConstantBuffer, d3dDistortionSampler, d3dDistortionInputLayout, d3dDistortionResolvePixelShader, d3dDistortionPixelShader,
+		d3dDistortionVertexShader
+	};
+	for (size_t i = 0; i < sizeof(d3dDistortionObjects) / sizeof(d3dDistortionObjects[0]); i++) {
+		if (d3dDistortionObjects[i] != nullptr) {
+			d3dDistortionObjects[i]->Release();
+		}
+	}
+	ID3D11DeviceChild* d3dHiddenAreaObjects[] = {
+		d3dHiddenAreaVertexBuffers[1], d3dHiddenAreaVertexBuffers[0], d3dHiddenAreaInputLayout, d3dHiddenAreaVertexShader
+	};
+	for (size_t i = 0; i < sizeof(d3dHiddenAreaObjects) / sizeof(d3dHiddenAreaObjects[0]); i++) {
+		if (d3dHiddenAreaObjects[i] != nullptr) {
+			d3dHiddenAreaObjects[i]->Release();
+		}
+	}
+	DestroyScene();
+	if (d3dCompositeVertexShader != nullptr) {
+		d3dCompositeConstantBuffer->Release();
+		d3dCompositeSampler->Release();
+		d3dCompositePixelShader->Release();
+		d3dCompositeVertexShader->Release();
+	}
+	for (size_t slot = 0; slot < pooledTargets.size(); slot++) {
+		ReleaseTarget(pooledTargets[slot]);
+	}
+	d3dBackBufferRenderTargetView->Release();
+	d3dSwapChain->Release();
+	d3dContext->Release();
+	d3dDevice->Release();
+}
+
+ID3D11Device* D3D11RenderDevice::GetDevice() const {
+	return d3dDevice;
+}
+
+ID3D11DeviceContext* D3D11RenderDevice::GetContext() const {
+	return d3dContext;
+}
+
+IDXGISwapChain* D3D11RenderDevice::GetSwapChain() const {
+	return d3dSwapChain;
+}
+
+ID3D11RenderTargetView* D3D11RenderDevice::GetBackBufferRenderTargetView() const {
+	return d3dBackBufferRenderTargetView;
+}
+
+ID3D11Texture2D* D3D11RenderDevice::GetDistortionSourceTexture() const {
+	return GetTarget(GetDistortionSourceTarget()).D3DTexture;
+}
+
+ID3D11ShaderResourceView* D3D11RenderDevice::GetDistortionSourceShaderResourceView() const {
+	return GetTarget(GetDistortionSourceTarget()).D3DShaderResourceView;
+}
+
+const FrameGraph& D3D11RenderDevice::GetFrameGraph() const {
+	return graph;
+}
+
+const RenderTargetPlan& D3D11RenderDevice::GetTargetPlan() const {
+	return targetPlan;
+}
+
+const RenderTargetPool& D3D11RenderDevice::GetTargetPool() const {
+	return targetPool;
+}
+
+Size2i D3D11RenderDevice::GetEyeTextureSize() const {
+	return eyeTextureSize;
+}
+
+int D3D11RenderDevice::GetMultisampleCount() const {
+	return multisampleCount;
+}
+
+StateCache::Statistics D3D11RenderDevice::GetStateStatistics() const {
+	StateCache::Statistics statistics = immediate.State.GetStatistics();
+	for (int context = 0; context < MaxRecordingContexts; context++) {
+		AddStateStatistics(statistics, recordingContexts[context].Target.State.GetStatistics());
+	}
+	return statistics;
+}
+
+void D3D11RenderDevice::ClearEyeTexture(const float color[4]) {
+	std::memcpy(colorClear.Color, color, sizeof(colorClear.Color));
+	clearColor = true;
+}
+
+void D3D11RenderDevice::ClearDepthStencil(float depth, unsigned char stencil) {
+	depthStencilClear.Depth = depth;
+	depthStencilClear.Stencil = stencil;
+	clearDepthStencil = true;
+}
+
+void D3D11RenderDevice::BindEyeTexture() {
+	// LibOVR's distortion rendering changed the state behind our back since the last frame.
+	immediate.State.Invalidate();
+	BindSceneState(immediate, material);
+
+	PlanTargets();
+	clearColor = false;
+	clearDepthStencil = false;
+	graph.Execute(graphBackend, 0, graph.GetPassCommand(EyeGraphPass_Scene) + 1);
+	if (hiddenAreaSet && !foveated) {
+		DrawHiddenArea();
+	}
+}
+
+void D3D11RenderDevice::BindSceneTargets() {
+	immediate.SetRenderTargets(d3dSceneRenderTargetView, d3dDepthStencilView);
+}
+
+void D3D11RenderDevice::SetViewport(const Rect2i& viewport) {
+	immediate.SetViewport(viewport);
+}
+
+void D3D11RenderDevice::SetStereoMode(StereoMode mode) {
+	stereoMode = mode;
+	immediate.SetVertexShader(mode == StereoMode_Instanced ? d3dStereoVertexShader : d3dVertexShader);
+}
+
+void D3D11RenderDevice::SetSceneVertices(const Vertex* vertices, unsigned int vertexCount) {
+	if (d3dVertexBuffer != nullptr) {
+		d3dVertexBuffer->Release();
+		d3dVertexBuffer = nullptr;
+	}
+	vertexBufferCapacity = 0;
+	if (vertexCount == 0) {
+		return;
+	}
+
+	// Default rather than immutable usage, UploadSceneVertices updates it.
+	D3D11_BUFFER_DESC vbDesc;
+	ZeroMemory(&vbDesc, sizeof(vbDesc));
+	vbDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+	vbDesc.ByteWidth = sizeof(Vertex) * vertexCount;
+	vbDesc.Usage = D3D11_USAGE_DEFAULT;
+
+	D3D11_SUBRESOURCE_DATA initialData;
+	ZeroMemory(&initialData, sizeof(initialData));
+	initialData.pSysMem = vertices;
+
+	if (SUCCEEDED(d3dDevice->CreateBuffer(&vbDesc, &initialData, &d3dVertexBuffer))) {
+		vertexBufferCapacity = vertexCount;
+	}
+
+	immediate.SetVertexBuffer(d3dVertexBuffer, sizeof(Vertex));
+}
+
+void D3D11RenderDevice::UploadSceneVertices(unsigned int firstVertex, const Vertex* vertices, unsigned int vertexCount) {
+	if (vertexCount == 0) {
+		return;
+	}
+
+	unsigned int endVertex = firstVertex + vertexCount;
+	if (endVertex > vertexBufferCapacity) {
+		// Grow geometrically, so streaming in one mesh after another doesn't copy the buffer each time.
+		unsigned int capacity = std::max(endVertex, vertexBufferCapacity * 2);
+		D3D11_BUFFER_DESC vbDesc;
+		ZeroMemory(&vbDesc, sizeof(vbDesc));
+		vbDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+		vbDesc.ByteWidth = sizeof(Vertex) * capacity;
+		vbDesc.Usage = D3D11_USAGE_DEFAULT;
+
+		ID3D11Buffer* d3dGrownBuffer = nullptr;
+		if (FAILED(d3dDevice->CreateBuffer(&vbDesc, nullptr, &d3dGrownBuffer))) {
+			return;
+		}
+		if (d3dVertexBuffer != nullptr) {
+			D3D11_BOX oldVertices = { 0, 0, 0, static_cast<UINT>(sizeof(Vertex) * vertexBufferCapacity), 1, 1 };
+			d3dContext->CopySubresourceRegion(d3dGrownBuffer, 0, 0, 0, 0, d3dVertexBuffer, 0, &oldVertices);
+			d3dVertexBuffer->Release();
+		}
+		d3dVertexBuffer = d3dGrownBuffer;
+		vertexBufferCapacity = capacity;
+		immediate.SetVertexBuffer(d3dVertexBuffer, sizeof(Vertex));
+	}
+
+	// The copy is queued on the immediate context, ahead of any draws recorded after this.
+	D3D11_BOX range = { static_cast<UINT>(sizeof(Vertex) * firstVertex), 0, 0, static_cast<UINT>(sizeof(Vertex) * endVertex), 1, 1 };
+	d3dContext->UpdateSubresource(d3dVertexBuffer, 0, &range, vertices, 0, 0);
+}
+
+void D3D11RenderDevice::BeginConstants() {
+	if (d3dContext1 == nullptr) {
+		// Nothing but the CPU reads the fallback ring, so a frame is done as soon as it ends.
+		constantAllocator.EndFrame();
+		constantAllocator.RetireFrames(constantFrame);
+		constantAllocator.BeginFrame(++constantFrame);
+		return;
+	}
+
+	RetireConstantFrames(0);
+	constantAllocator.BeginFrame(++constantFrame);
+
+	// The very first map of a dynamic buffer has to discard, after that we never overwrite
+	// anything the GPU still needs.
+	D3D11_MAPPED_SUBRESOURCE d3dMappedStatus;
+	d3dContext->Map(d3dConstantBuffer, 0, constantFrame == 1 ? D3D11_MAP_WRITE_DISCARD : D3D11_MAP_WRITE_NO_OVERWRITE, 0, &d3dMappedStatus);
+	mappedConstants = static_cast<unsigned char*>(d3dMappedStatus.pData);
+}
+
+void* D3D11RenderDevice::AllocateConstants(unsigned int size, unsigned int& outOffset) {
+	// If the ring is full we have to wait for the GPU to finish the oldest batch still using it.
+	// When that is one of this frame's, the frame doesn't fit, and its batches so far are fenced
+	// now rather than once it ends.
+	while (!constantAllocator.Allocate(size, outOffset)) {
+		if (constantAllocator.GetFramesInFlight() == 0) {
+			return nullptr;
+		}
+		unsigned long long oldestFrame = constantAllocator.GetOldestFrameInFlight();
+		if (oldestFrame > fencedFrame) {
+			FenceConstantFrames();
+		}
+		RetireConstantFrames(oldestFrame);
+	}
+	return (d3dContext1 != nullptr ? mappedConstants : fallbackConstants.data()) + outOffset;
+}
+
+void D3D11RenderDevice::EndConstants() {
+	if (d3dContext1 != nullptr) {
+		d3dContext->Unmap(d3dConstantBuffer, 0);
+		mappedConstants = nullptr;
+		constantAllocator.EndFrame();
+	}
+}
+
+void D3D11RenderDevice::BindConstants(ConstantSlot slot, unsigned int offset, unsigned int size) {
+	BindConstants(immediate, slot, offset, size);
+}
+
+void D3D11RenderDevice::BindConstants(FilteredContext& target, ConstantSlot slot, unsigned int offset, unsigned int size) {
+	if (target.D3DContext1 != nullptr) {
+		// Offsets and sizes are in shader constants (16 bytes), and have to be multiples of 16 of them.
+		UINT firstConstant = offset / 16;
+		UINT constantCount = ConstantRingAllocator::Align(size) / 16;
+		target.SetVertexConstants(slot, d3dConstantBuffer, firstConstant, constantCount);
+	}
+	else {
+		// Deferred contexts can map dynamic buffers too, as long as they discard.
+		D3D11_MAPPED_SUBRESOURCE d3dMappedStatus;
+		target.D3DContext->Map(d3dFallbackConstantBuffers[slot], 0, D3D11_MAP_WRITE_DISCARD, 0, &d3dMappedStatus);
+		std::memcpy(d3dMappedStatus.pData, fallbackConstants.data() + offset, size);
+		target.D3DContext->Unmap(d3dFallbackConstantBuffers[slot], 0);
+		target.SetVertexConstants(slot, d3dFallbackConstantBuffers[slot]);
+	}
+}
+
+void D3D11RenderDevice::BindLatchedConstants(ConstantSlot slot, int part) {
+	immediate.SetVertexConstants(slot, d3dLatchedConstantBuffers[part]);
+}
+
+void D3D11RenderDevice::SetMaterial(int material) {
+	this->material = material;
+	immediate.SetPixelConstants(d3dMaterialConstantBuffers[material]);
+}
+
+void D3D11RenderDevice::LatchConstants(int part, const void* data, unsigned int size) {
+	D3D11_MAPPED_SUBRESOURCE d3dMappedStatus;
+	d3dContext->Map(d3dLatchedConstantBuffers[part], 0, D3D11_MAP_WRITE_DISCARD, 0, &d3dMappedStatus);
+	std::memcpy(d3dMappedStatus.pData, data, size);
+	d3dContext->Unmap(d3dLatchedConstantBuffers[part], 0);
+}
+
+/*
+	Has the GPU tell when it is through with the constants of every batch that has ended since the
+	last query. Their draws have all been submitted by then.
+*/
+void D3D11RenderDevice::FenceConstantFrames() {
+	unsigned long long endedFrame = mappedConstants != nullptr ? constantFrame - 1 : constantFrame;
+	if (d3dContext1 == nullptr || endedFrame <= fencedFrame) {
+		return;
+	}
+
+	// The query was last used FrameQueryCount queries ago, which has to be finished before it
+	// can be issued again.
+	unsigned long long query = issuedQueries + 1;
+	if (query > FrameQueryCount) {
+		RetireConstantFrames(queryFrames[query % FrameQueryCount]);
+	}
+	d3dContext->End(d3dFrameQueries[query % FrameQueryCount]);
+	queryFrames[query % FrameQueryCount] = endedFrame;
+	issuedQueries = query;
+	fencedFrame = endedFrame;
+}
+
+/*
+	Checks which batches the GPU has finished and releases their constants. Blocks until at least
+	constant frame waitForFrame is finished, 0 only picks up what is already done.
+*/
+void D3D11RenderDevice::RetireConstantFrames(unsigned long long waitForFrame) {
+	while (completedQueries < issuedQueries) {
+		unsigned long long query = completedQueries + 1;
+		bool wait = queryFrames[query % FrameQueryCount] <= waitForFrame;
+		ID3D11Query* d3dQuery = d3dFrameQueries[query % FrameQueryCount];
+		HRESULT result = d3dContext->GetData(d3dQuery, nullptr, 0, wait ? 0 : D3D11_ASYNC_GETDATA_DONOTFLUSH);
+		while (wait && result == S_FALSE) {
+			result = d3dContext->GetData(d3dQuery, nullptr, 0, 0);
+		}
+		if (result != S_OK) {
+			break;
+		}
+		completedQueries = query;
+		completedFrame = queryFrames[query % FrameQueryCount];
+	}
+	constantAllocator.RetireFrames(completedFrame);
+}
+
+void D3D11RenderDevice::Draw(unsigned int vertexCount, unsigned int startVertex) {
+	d3dContext->Draw(vertexCount, startVertex);
+}
+
+void D3D11RenderDevice::DrawInstanced(unsigned int vertexCount, unsigned int instanceCount, unsigned int startVertex) {
+	d3dContext->DrawInstanced(vertexCount, instanceCount, startVertex, 0);
+}
+
+RenderContext& D3D11RenderDevice::BeginRecording(int context) {
+	// ID3D11Device is thread safe, so each thread can create its own context.
+	RecordingContext& recording = recordingContexts[context];
+	FilteredContext& target = recording.Target;
+	if (target.D3DContext == nullptr) {
+		recording.Device = this;
+		d3dDevice->CreateDeferredContext(0, &target.D3DContext);
+		if (d3dContext1 != nullptr) {
+			target.D3DContext->QueryInterface(__uuidof(ID3D11DeviceContext1), reinterpret_cast<void**>(&target.D3DContext1));
+		}
+	}
+
+	// A deferred context starts every recording with the default state.
+	target.State.Invalidate();
+	target.SetRenderTargets(d3dSceneRenderTargetView, d3dDepthStencilView);
+	BindSceneState(target, 0);
+	return recording;
+}
+
+void D3D11RenderDevice::EndRecording(int context) {
+	RecordingContext& recording = recordingContexts[context];
+	recording.Target.D3DContext->FinishCommandList(FALSE, &recording.D3DCommandList);
+}
+
+void D3D11RenderDevice::ExecuteRecordings(int count) {
+	for (int context = 0; context < count; context++) {
+		RecordingContext& recording = recordingContexts[context];
+		d3dContext->ExecuteCommandList(recording.D3DCommandList, FALSE);
+		recording.D3DCommandList->Release();
+		recording.D3DCommandList = nullptr;
+	}
+
+	// Not restoring the state for each command list is cheaper, but leaves the immediate context
+	// with the default state.
+	immediate.State.Invalidate();
+	BindSceneTargets();
+	BindSceneState(immediate, material);
+}
+
+D3D11RenderDevice::FilteredContext::FilteredContext() :
+	D3DContext(nullptr),
+	D3DContext1(nullptr)
+{
+}
+
+void D3D11RenderDevice::FilteredContext::SetInputLayout(ID3D11InputLayout* d3dInputLayout) {
+	if (State.Change(StateSlot_InputLayout, d3dInputLayout)) {
+		D3DContext->IASetInputLayout(d3dInputLayout);
+	}
+}
+
+void D3D11RenderDevice::FilteredContext::SetVertexBuffer(ID3D11Buffer* d3dBuffer, UINT stride) {
+	if (State.Change(StateSlot_VertexBuffer, d3dBuffer, stride)) {
+		UINT offset = 0;
+		D3DContext->IASetVertexBuffers(0, 1, &d3dBuffer, &stride, &offset);
+	}
+}
+
+void D3D11RenderDevice::FilteredContext::SetInstanceBuffer(ID3D11Buffer* d3dBuffer, UINT stride) {
+	if (State.Change(StateSlot_InstanceBuffer, d3dBuffer, stride)) {
+		UINT offset = 0;
+		D3DContext->IASetVertexBuffers(1, 1, &d3dBuffer, &stride, &offset);
+	}
+}
+
+void D3D11RenderDevice::FilteredContext::SetTopology(D3D11_PRIMITIVE_TOPOLOGY topology) {
+	if (State.Change(StateSlot_Topology, nullptr, topology)) {
+		D3DContext->IASetPrimitiveTopology(topology);
+	}
+}
+
+void D3D11RenderDevice::FilteredContext::SetVertexShader(ID3D11VertexShader* d3dShader) {
+	if (State.Change(StateSlot_VertexShader, d3dShader)) {
+		D3DContext->VSSetShader(d3dShader, nullptr, 0);
+	}
+}
+
+void D3D11RenderDevice::FilteredContext::SetPixelShader(ID3D11PixelShader* d3dShader) {
+	if (State.Change(StateSlot_PixelShader, d3dShader)) {
+		D3DContext->PSSetShader(d3dShader, nullptr, 0);
+	}
+}
+
+void D3D11RenderDevice::FilteredContext::SetVertexConstants(int slot, ID3D11Buffer* d3dBuffer) {
+	// The whole buffer, which no part the other overload binds can be mistaken for.
+	if (State.Change(static_cast<StateSlot>(StateSlot_VertexConstants + slot), d3dBuffer, ~0ull)) {
+		D3DContext->VSSetConstantBuffers(slot, 1, &d3dBuffer);
+	}
+}
+
+void D3D11RenderDevice::FilteredContext::SetVertexConstants(int slot, ID3D11Buffer* d3dBuffer, UINT firstConstant, UINT constantCount) {
+	if (State.Change(static_cast<StateSlot>(StateSlot_VertexConstants + slot), d3dBuffer, static_cast<unsigned long long>(firstConstant) << 32 | constantCount)) {
+		D3DContext1->VSSetConstantBuffers1(slot, 1, &d3dBuffer, &firstConstant, &constantCount);
+	}
+}
+
+void D3D11RenderDevice::FilteredContext::SetVertexResource(ID3D11ShaderResourceView* d3dView) {
+	if (State.Change(StateSlot_VertexResource, d3dView)) {
+		D3DContext->VSSetShaderResources(0, 1, &d3dView);
+	}
+}
+
+void D3D11RenderDevice::FilteredContext::SetPixelConstants(ID3D11Buffer* d3dBuffer) {
+	if (State.Change(StateSlot_PixelConstants, d3dBuffer)) {
+		D3DContext->PSSetConstantBuffers(0, 1, &d3dBuffer);
+	}
+}
+
+void D3D11RenderDevice::FilteredContext::SetPixelResource(ID3D11ShaderResourceView* d3dView) {
+	if (State.Change(StateSlot_PixelResource, d3dView)) {
+		D3DContext->PSSetShaderResources(0, 1, &d3dView);
+	}
+}
+
+void D3D11RenderDevice::FilteredContext::SetPixelSampler(ID3D11SamplerState* d3dSampler) {
+	if (State.Change(StateSlot_PixelSampler, d3dSampler)) {
+		D3DContext->PSSetSamplers(0, 1, &d3dSampler);
+	}
+}
+
+void D3D11RenderDevice::FilteredContext::SetRenderTargets(ID3D11RenderTargetView* d3dRenderTargetView, ID3D11DepthStencilView* d3dDepthStencilView) {
+	if (State.Change(StateSlot_RenderTargets, d3dRenderTargetView, reinterpret_cast<size_t>(d3dDepthStencilView))) {
+		D3DContext->OMSetRenderTargets(d3dRenderTargetView != nullptr ? 1 : 0, &d3dRenderTargetView, d3dDepthStencilView);
+	}
+}
+
+void D3D11RenderDevice::FilteredContext::SetViewport(const Rect2i& viewport) {
+	if (State.ChangeViewport(viewport)) {
+		D3D11_VIEWPORT vp;
+		vp.Width = static_cast<float>(viewport.Size.w);
+		vp.Height = static_cast<float>(viewport.Size.h);
+		vp.TopLeftX = static_cast<float>(viewport.Pos.x);
+		vp.TopLeftY = static_cast<float>(viewport.Pos.y);
+		vp.MinDepth = 0.0f;
+		vp.MaxDepth = 1.0f;
+		D3DContext->RSSetViewports(1, &vp);
+	}
+}
+
+D3D11RenderDevice::RecordingContext::RecordingContext() :
+	Device(nullptr),
+	D3DCommandList(nullptr)
+{
+}
+
+void D3D11RenderDevice::RecordingContext::SetViewport(const Rect2i& viewport) {
+	Target.SetViewport(viewport);
+}
+
+void D3D11RenderDevice::RecordingContext::BindConstants(ConstantSlot slot, unsigned int offset, unsigned int size) {
+	Device->BindConstants(Target, slot, offset, size);
+}
+
+void D3D11RenderDevice::RecordingContext::BindLatchedConstants(ConstantSlot slot, int part) {
+	Target.SetVertexConstants(slot, Device->d3dLatchedConstantBuffers[part]);
+}
+
+void D3D11RenderDevice::RecordingContext::SetMaterial(int material) {
+	Target.SetPixelConstants(Device->d3dMaterialConstantBuffers[material]);
+}
+
+void D3D11RenderDevice::RecordingContext::Draw(unsigned int vertexCount, unsigned int startVertex) {
+	Target.D3DContext->Draw(vertexCount, startVertex);
+}
+
+void D3D11RenderDevice::RecordingContext::DrawInstanced(unsigned int vertexCount, unsigned int instanceCount, unsigned int startVertex) {
+	Target.D3DContext->DrawInstanced(vertexCount, instanceCount, startVertex, 0);
+}
+
+void D3D11RenderDevice::SetFoveatedLayout(const FoveatedLayout* layout) {
+	foveated = layout != nullptr;
+	if (foveated) {
+		foveatedLayout = *layout;
+		if (d3dCompositeVertexShader == nullptr) {
+			SetupComposite();
+		}
+	}
+}
+
+bool D3D11RenderDevice::SetSceneInstances(const SceneInstance* instances, unsigned int instanceCount, const IndirectDrawArgs* meshDraws, unsigned int meshCount) {
+	ReleaseSceneInstances();
+	if (featureLevel < D3D_FEATURE_LEVEL_11_0) {
+		return false;
+	}
+	if (d3dCullShader == nullptr) {
+		SetupGpuDriven();
+	}
+	if (d3dCullShader == nullptr || d3dInstanceVertexShader == nullptr || d3dStereoInstanceVertexShader == nullptr || d3dInstancePixelShader == nullptr ||
+		d3dInstanceInputLayout == nullptr || d3dStereoInstanceInputLayout == nullptr || d3dCullConstantBuffer == nullptr || d3dMaterialColorBuffer == nullptr) {
+		return false;
+	}
+
+	// One thread per instance, in groups of 64, and a single dispatch can only have so many groups.
+	if ((instanceCount + 63) / 64 > D3D11_CS_DISPATCH_MAX_THREAD_GROUPS_PER_DIMENSION) {
+		return false;
+	}
+	if (instanceCount == 0 || meshCount == 0) {
+		// Nothing to draw, which CullSceneInstances and DrawSceneInstances handle by doing nothing.
+		return true;
+	}
+
+	D3D11_BUFFER_DESC desc;
+	ZeroMemory(&desc, sizeof(desc));
+	D3D11_SUBRESOURCE_DATA initialData;
+	ZeroMemory(&initialData, sizeof(initialData));
+	bool created = true;
+
+	desc.Usage = D3D11_USAGE_IMMUTABLE;
+	desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	desc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+	desc.StructureByteStride = sizeof(SceneInstance);
+	desc.ByteWidth = sizeof(SceneInstance) * instanceCount;
+	initialData.pSysMem = instances;
+	created = created && SUCCEEDED(d3dDevice->CreateBuffer(&desc, &initialData, &d3dInstanceBuffer));
+	created = created && SUCCEEDED(d3dDevice->CreateShaderResourceView(d3dInstanceBuffer, nullptr, &d3dInstanceView));
+
+	// What each frame's draw arguments start out as, read by the cull shader as well.
+	desc.StructureByteStride = sizeof(IndirectDrawArgs);
+	desc.ByteWidth = sizeof(IndirectDrawArgs) * meshCount;
+	initialData.pSysMem = meshDraws;
+	created = created && SUCCEEDED(d3dDevice->CreateBuffer(&desc, &initialData, &d3dMeshDrawBuffer));
+	created = created && SUCCEEDED(d3dDevice->CreateShaderResourceView(d3dMeshDrawBuffer, nullptr, &d3dMeshDrawView));
+
+	// The cull shader counts into the draw arguments with atomics, which needs a raw view.
+	desc.Usage = D3D11_USAGE_DEFAULT;
+	desc.BindFlags = D3D11_BIND_UNORDERED_ACCESS;
+	desc.MiscFlags = D3D11_RESOURCE_MISC_DRAWINDIRECT_ARGS | D3D11_RESOURCE_MISC_BUFFER_ALLOW_RAW_VIEWS;
+	desc.StructureByteStride = 0;
+	created = created && SUCCEEDED(d3dDevice->CreateBuffer(&desc, nullptr, &d3dDrawArgsBuffer));
+	D3D11_UNORDERED_ACCESS_VIEW_DESC uavDesc;
+	ZeroMemory(&uavDesc, sizeof(uavDesc));
+	uavDesc.ViewDimension = D3D11_UAV_DIMENSION_BUFFER;
+	uavDesc.Format = DXGI_FORMAT_R32_TYPELESS;
+	uavDesc.Buffer.NumElements = meshCount * sizeof(IndirectDrawArgs) / 4;
+	uavDesc.Buffer.Flags = D3D11_BUFFER_UAV_FLAG_RAW;
+	created = created && SUCCEEDED(d3dDevice->CreateUnorderedAccessView(d3dDrawArgsBuffer, &uavDesc, &d3dDrawArgsView));
+
+	desc.BindFlags = D3D11_BIND_UNORDERED_ACCESS | D3D11_BIND_VERTEX_BUFFER;
+	desc.MiscFlags = 0;
+	desc.ByteWidth = sizeof(unsigned int) * instanceCount;
+	created = created && SUCCEEDED(d3dDevice->CreateBuffer(&desc, nullptr, &d3dVisibleBuffer));
+	uavDesc.Format = DXGI_FORMAT_R32_UINT;
+	uavDesc.Buffer.NumElements = instanceCount;
+	uavDesc.Buffer.Flags = 0;
+	created = created && SUCCEEDED(d3dDevice->CreateUnorderedAccessView(d3dVisibleBuffer, &uavDesc, &d3dVisibleView));
+
+	if (!created) {
+		ReleaseSceneInstances();
+		return false;
+	}
+	sceneInstanceCount = instanceCount;
+	sceneMeshCount = meshCount;
+	return true;
+}
+
+void D3D11RenderDevice::CullSceneInstances(const Frustum& frustum) {
+	if (sceneInstanceCount == 0) {
+		return;
+	}
+
+	// Must match CullShaderCode in D3D11Shaders.cpp.
+	struct CullConstants {
+		float Planes[6][4];
+		unsigned int InstanceCount;
+		unsigned int InstanceMultiplier;
+		unsigned int Padding[2];
+	};
+	D3D11_MAPPED_SUBRESOURCE d3dMappedStatus;
+	d3dContext->Map(d3dCullConstantBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &d3dMappedStatus);
+	CullConstants* constants = static_cast<CullConstants*>(d3dMappedStatus.pData);
+	for (int i = 0; i < 6; i++) {
+		const Plane& plane = frustum.Planes[i];
+		constants->Planes[i][0] = plane.Normal.x;
+		constants->Planes[i][1] = plane.Normal.y;
+		constants->Planes[i][2] = plane.Normal.z;
+		constants->Planes[i][3] = plane.Distance;
+	}
+	constants->InstanceCount = sceneInstanceCount;
+	constants->InstanceMultiplier = stereoMode == StereoMode_Instanced ? EyeCount : 1;
+	constants->Padding[0] = 0;
+	constants->Padding[1] = 0;
+	d3dContext->Unmap(d3dCullConstantBuffer, 0);
+
+	// The list can't be written while it is bound as a vertex buffer. The runtime would unbind it
+	// behind the state cache's back otherwise.
+	immediate.SetInstanceBuffer(nullptr, 0);
+	d3dContext->CopyResource(d3dDrawArgsBuffer, d3dMeshDrawBuffer);
+
+	ID3D11ShaderResourceView* d3dViews[] = { d3dInstanceView, d3dMeshDrawView };
+	ID3D11UnorderedAccessView* d3dUnorderedViews[] = { d3dDrawArgsView, d3dVisibleView };
+	d3dContext->CSSetShader(d3dCullShader, nullptr, 0);
+	d3dContext->CSSetConstantBuffers(0, 1, &d3dCullConstantBuffer);
+	d3dContext->CSSetShaderResources(0, 2, d3dViews);
+	d3dContext->CSSetUnorderedAccessViews(0, 2, d3dUnorderedViews, nullptr);
+	d3dContext->Dispatch((sceneInstanceCount + 63) / 64, 1, 1);
+
+	// Unbound right away, so the draws can read what was written.
+	ID3D11UnorderedAccessView* d3dNoUnorderedViews[] = { nullptr, nullptr };
+	d3dContext->CSSetUnorderedAccessViews(0, 2, d3dNoUnorderedViews, nullptr);
+}
+
+void D3D11RenderDevice::DrawSceneInstances() {
+	if (sceneInstanceCount == 0) {
+		return;
+	}
+
+	bool stereo = stereoMode == StereoMode_Instanced;
+	immediate.SetInputLayout(stereo ? d3dStereoInstanceInputLayout : d3dInstanceInputLayout);
+	immediate.SetInstanceBuffer(d3dVisibleBuffer, sizeof(unsigned int));
+	immediate.SetVertexShader(stereo ? d3dStereoInstanceVertexShader : d3dInstanceVertexShader);
+	immediate.SetVertexResource(d3dInstanceView);
+	immediate.SetVertexConstants(ConstantSlot_Object, d3dMaterialColorBuffer);
+	immediate.SetPixelShader(d3dInstancePixelShader);
+	for (unsigned int mesh = 0; mesh < sceneMeshCount; mesh++) {
+		d3dContext->DrawInstancedIndirect(d3dDrawArgsBuffer, mesh * sizeof(IndirectDrawArgs));
+	}
+
+	// Back to what Draw expects.
+	BindSceneState(immediate, material);
+}
+
+void D3D11RenderDevice::ResolveEyeTexture() {
+	// All of the frame's draws are in, so this is where its constants are fenced.
+	FenceConstantFrames();
+	graph.Execute(graphBackend, graph.GetPassCommand(EyeGraphPass_Scene) + 1, graph.GetCommandCount());
+}
+
+bool D3D11RenderDevice::SetDistortionMesh(int eye, const DistortionMesh& mesh) {
+	if (!IsValidDistortionMesh(mesh)) {
+		return false;
+	}
+	if (d3dDistortionVertexShader == nullptr) {
+		SetupDistortion();
+	}
+	if (d3dDistortionVertexBuffers[eye] != nullptr) {
+		d3dDistortionVertexBuffers[eye]->Release();
+		d3dDistortionIndexBuffers[eye]->Release();
+		d3dDistortionVertexBuffers[eye] = nullptr;
+		d3dDistortionIndexBuffers[eye] = nullptr;
+	}
+	distortionIndexCounts[eye] = 0;
+
+	D3D11_BUFFER_DESC bufferDesc;
+	ZeroMemory(&bufferDesc, sizeof(bufferDesc));
+	bufferDesc.Usage = D3D11_USAGE_IMMUTABLE;
+	D3D11_SUBRESOURCE_DATA initialData;
+	ZeroMemory(&initialData, sizeof(initialData));
+	bufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+	bufferDesc.ByteWidth = static_cast<UINT>(mesh.Vertices.size() * sizeof(DistortionVertex));
+	initialData.pSysMem = mesh.Vertices.data();
+	if (FAILED(d3dDevice->CreateBuffer(&bufferDesc, &initialData, &d3dDistortionVertexBuffers[eye]))) {
+		return false;
+	}
+	bufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
+	bufferDesc.ByteWidth = static_cast<UINT>(mesh.Indices.size() * sizeof(unsigned short));
+	initialData.pSysMem = mesh.Indices.data();
+	if (FAILED(d3dDevice->CreateBuffer(&bufferDesc, &initialData, &d3dDistortionIndexBuffers[eye]))) {
+		d3dDistortionVertexBuffers[eye]->Release();
+		d3dDistortionVertexBuffers[eye] = nullptr;
+		return false;
+	}
+	distortionIndexCounts[eye] = static_cast<unsigned int>(mesh.Indices.size());
+	return true;
+}
+
+void D3D11RenderDevice::PresentDistorted(const DistortionConstants constants[EyeCount]) {
+	immediate.SetRenderTargets(d3dBackBufferRenderTargetView, nullptr);
+	Rect2i viewport = { { 0, 0 }, backBufferSize };
+	immediate.SetViewport(viewport);
+	const float black[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+	d3dContext->ClearRenderTargetView(d3dBackBufferRenderTargetView, black);
+	immediate.SetInputLayout(d3dDistortionInputLayout);
+	immediate.SetTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	immediate.SetVertexShader(d3dDistortionVertexShader);
+	immediate.SetPixelShader(IsEyeResolveFused(multisampleCount, foveated, fusedResolve) ? d3dDistortionResolvePixelShader : d3dDistortionPixelShader);
+	immediate.SetVertexConstants(0, d3dDistortionConstantBuffer);
+	immediate.SetPixelResource(GetDistortionSourceShaderResourceView());
+	immediate.SetPixelSampler(d3dDistortionSampler);
+	for (int eye = 0; eye < EyeCount; eye++) {
+		if (distortionIndexCounts[eye] == 0) {
+			continue;
+		}
+		D3D11_MAPPED_SUBRESOURCE d3dMappedStatus;
+		d3dContext->Map(d3dDistortionConstantBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &d3dMappedStatus);
+		std::memcpy(d3dMappedStatus.pData, &constants[eye], sizeof(DistortionConstants));
+		d3dContext->Unmap(d3dDistortionConstantBuffer, 0);
+		immediate.SetVertexBuffer(d3dDistortionVertexBuffers[eye], sizeof(DistortionVertex));
+		d3dContext->IASetIndexBuffer(d3dDistortionIndexBuffers[eye], DXGI_FORMAT_R16_UINT, 0);
+		d3dContext->DrawIndexed(distortionIndexCounts[eye], 0, 0);
+	}
+
+	// The eye texture is drawn into again next frame, so it can't stay bound for sampling.
+	immediate.SetPixelResource(nullptr);
+	immediate.SetRenderTargets(nullptr, nullptr);
+	d3dSwapChain->Present(1, 0);
+	BindSceneState(immediate, material);
+}
+
+bool D3D11RenderDevice::SetFusedResolve(bool fused) {
+	fusedResolve = fused;
+	return true;
+}
+
+bool D3D11RenderDevice::SetHiddenAreaMesh(int eye, const HiddenAreaMesh& mesh) {
+	if (d3dHiddenAreaVertexShader == nullptr) {
+		ShaderBytecode vertexShader = GetShaderBytecode(Shader_HiddenAreaVertex);
+		d3dDevice->CreateVertexShader(vertexShader.Data, vertexShader.Size, nullptr, &d3dHiddenAreaVertexShader);
+		D3D11_INPUT_ELEMENT_DESC inputElement = { "POSITION", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 };
+		d3dDevice->CreateInputLayout(&inputElement, 1, vertexShader.Data, vertexShader.Size, &d3dHiddenAreaInputLayout);
+	}
+	if (d3dHiddenAreaVertexBuffers[eye] != nullptr) {
+		d3dHiddenAreaVertexBuffers[eye]->Release();
+		d3dHiddenAreaVertexBuffers[eye] = nullptr;
+	}
+	hiddenAreaVertexCounts[eye] = 0;
+	if (mesh.Rects.empty()) {
+		return true;
+	}
+
+	// Clockwise, so they aren't culled: top left, top right, bottom left and the other half.
+	std::vector<float> positions;
+	positions.reserve(mesh.Rects.size() * 12);
+	for (size_t i = 0; i < mesh.Rects.size(); i++) {
+		const float* ndc = mesh.Rects[i].Ndc;
+		float corners[] = {
+			ndc[0], ndc[3], ndc[1], ndc[3], ndc[0], ndc[2],
+			ndc[1], ndc[3], ndc[1], ndc[2], ndc[0], ndc[2]
+		};
+		positions.insert(positions.end(), corners, corners + 12);
+	}
+	D3D11_BUFFER_DESC bufferDesc;
+	ZeroMemory(&bufferDesc, sizeof(bufferDesc));
+	bufferDesc.Usage = D3D11_USAGE_IMMUTABLE;
+	bufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+	bufferDesc.ByteWidth = static_cast<UINT>(positions.size() * sizeof(float));
+	D3D11_SUBRESOURCE_DATA initialData;
+	ZeroMemory(&initialData, sizeof(initialData));
+	initialData.pSysMem = positions.data();
+	if (FAILED(d3dDevice->CreateBuffer(&bufferDesc, &initialData, &d3dHiddenAreaVertexBuffers[eye]))) {
+		return false;
+	}
+	hiddenAreaVertexCounts[eye] = static_cast<unsigned int>(positions.size() / 2);
+	return true;
+}
+
+void D3D11RenderDevice::SetHiddenAreaViewports(const Rect2i* viewports) {
+	hiddenAreaSet = viewports != nullptr;
+	if (hiddenAreaSet) {
+		std::memcpy(hiddenAreaViewports, viewports, sizeof(hiddenAreaViewports));
+	}
+}
+
+void D3D11RenderDevice::DrawHiddenArea() {
+	// Only depth is written, with the usual LESS test against the cleared depth.
+	immediate.SetInputLayout(d3dHiddenAreaInputLayout);
+	immediate.SetTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	immediate.SetVertexShader(d3dHiddenAreaVertexShader);
+	immediate.SetPixelShader(nullptr);
+	for (int eye = 0; eye < EyeCount; eye++) {
+		if (hiddenAreaVertexCounts[eye] == 0) {
+			continue;
+		}
+		immediate.SetViewport(hiddenAreaViewports[eye]);
+		immediate.SetVertexBuffer(d3dHiddenAreaVertexBuffers[eye], 2 * sizeof(float));
+		d3dContext->Draw(hiddenAreaVertexCounts[eye], 0);
+	}
+	BindSceneState(immediate, material);
+}
+
+void D3D11RenderDevice::BeginGpuTimer() {
+	gpuTimerRunning = gpuTimersIssued - gpuTimersRead < GpuTimerCount;
+	if (gpuTimerRunning) {
+		GpuTimer& timer = gpuTimers[gpuTimersIssued % GpuTimerCount];
+		d3dContext->Begin(timer.D3DDisjoint);
+		d3dContext->End(timer.D3DBegin);
+	}
+}
+
+void D3D11RenderDevice::EndGpuTimer() {
+	if (gpuTimerRunning) {
+		GpuTimer& timer = gpuTimers[gpuTimersIssued % GpuTimerCount];
+		d3dContext->End(timer.D3DEnd);
+		d3dContext->End(timer.D3DDisjoint);
+		gpuTimersIssued++;
+		gpuTimerRunning = false;
+	}
+}
+
+bool D3D11RenderDevice::GetGpuFrameTime(double& outSeconds) {
+	while (gpuTimersRead < gpuTimersIssued) {
+		GpuTimer& timer = gpuTimers[gpuTimersRead % GpuTimerCount];
+		D3D11_QUERY_DATA_TIMESTAMP_DISJOINT disjoint;
+		UINT64 begin;
+		UINT64 end;
+		if (d3dContext->GetData(timer.D3DDisjoint, &disjoint, sizeof(disjoint), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK ||
+			d3dContext->GetData(timer.D3DBegin, &begin, sizeof(begin), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK ||
+			d3dContext->GetData(timer.D3DEnd, &end, sizeof(end), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK) {
+			break;
+		}
+
+		// Timestamps of a disjoint interval (the GPU clock changed in between) are meaningless.
+		if (!disjoint.Disjoint) {
+			gpuFrameTime = static_cast<double>(end - begin) / disjoint.Frequency;
+		}
+		gpuTimersRead++;
+	}
+
+	outSeconds = gpuFrameTime;
+	return gpuFrameTime >= 0.0;
+}
+
+/*
+
+	Below is a bunch of code that prepares the scene. It has very little to do with the actual VR,
+	but this example would be fairly boring without anything to look at.
+
+*/
+
+ShaderBytecode D3D11RenderDevice::GetShaderBytecode(Shader shader) {
+	ShaderBytecode bytecode = { nullptr, 0 };
+	shaderCache.GetOrCompile(GetShaderKey(shader), CompileShader, bytecode);
+	return bytecode;
+}
+
+void D3D11RenderDevice::SetupScene() {
+	ShaderBytecode vertexShader = GetShaderBytecode(Shader_SceneVertex);
+	ShaderBytecode stereoVertexShader = GetShaderBytecode(Shader_StereoVertex);
+	ShaderBytecode pixelShader = GetShaderBytecode(Shader_ScenePixel);
+	d3dDevice->CreateVertexShader(vertexShader.Data, vertexShader.Size, nullptr, &d3dVertexShader);
+	d3dDevice->CreateVertexShader(stereoVertexShader.Data, stereoVertexShader.Size, nullptr, &d3dStereoVertexShader);
+	d3dDevice->CreatePixelShader(pixelShader.Data, pixelShader.Size, nullptr, &d3dPixelShader);
+
+	D3D11_INPUT_ELEMENT_DESC inputElements[] = {
+		{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 }
+	};
+	d3dDevice->CreateInputLayout(inputElements, 1, vertexShader.Data, vertexShader.Size, &d3dInputLayout);
+
+	// The vertex buffer is created once the scene is known, see SetSceneVertices.
+
+	// Binding part of a constant buffer and NO_OVERWRITE maps of constant buffers need D3D11.1
+	// (Windows 8, or Windows 7 with the platform update) and a driver that supports them.
+	if (SUCCEEDED(d3dContext->QueryInterface(__uuidof(ID3D11DeviceContext1), (void**)&d3dContext1))) {
+		D3D11_FEATURE_DATA_D3D11_OPTIONS d3dOptions;
+		ZeroMemory(&d3dOptions, sizeof(d3dOptions));
+		d3dDevice->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS, &d3dOptions, sizeof(d3dOptions));
+		if (!d3dOptions.ConstantBufferOffsetting || !d3dOptions.MapNoOverwriteOnDynamicConstantBuffer) {
+			d3dContext1->Release();
+			d3dContext1 = nullptr;
+		}
+	}
+	immediate.D3DContext1 = d3dContext1;
+
+	D3D11_BUFFER_DESC cbDesc;
+	ZeroMemory(&cbDesc, sizeof(cbDesc));
+	cbDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	cbDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	cbDesc.Usage = D3D11_USAGE_DYNAMIC;
+	if (d3dContext1 != nullptr) {
+		cbDesc.ByteWidth = constantAllocator.GetCapacity();
+		d3dDevice->CreateBuffer(&cbDesc, nullptr, &d3dConstantBuffer);
+
+		D3D11_QUERY_DESC queryDesc;
+		ZeroMemory(&queryDesc, sizeof(queryDesc));
+		queryDesc.Query = D3D11_QUERY_EVENT;
+		for (int i = 0; i < FrameQueryCount; i++) {
+			d3dDevice->CreateQuery(&queryDesc, &d3dFrameQueries[i]);
+		}
+	}
+	else {
+		cbDesc.ByteWidth = sizeof(StereoConstants); // Large enough for any slot in either stereo mode.
+		fallbackConstants.resize(constantAllocator.GetCapacity());
+		for (int slot = 0; slot < ConstantSlotCount; slot++) {
+			d3dDevice->CreateBuffer(&cbDesc, nullptr, &d3dFallbackConstantBuffers[slot]);
+		}
+	}
+
+	cbDesc.ByteWidth = MaxLatchedConstantsSize;
+	for (int part = 0; part < LatchedConstantParts; part++) {
+		d3dDevice->CreateBuffer(&cbDesc, nullptr, &d3dLatchedConstantBuffers[part]);
+	}
+
+	// The materials never change.
+	D3D11_BUFFER_DESC materialDesc;
+	ZeroMemory(&materialDesc, sizeof(materialDesc));
+	materialDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	materialDesc.Usage = D3D11_USAGE_IMMUTABLE;
+	materialDesc.ByteWidth = sizeof(MaterialColors[0]);
+	for (int i = 0; i < MaxMaterials; i++) {
+		D3D11_SUBRESOURCE_DATA initialData;
+		ZeroMemory(&initialData, sizeof(initialData));
+		initialData.pSysMem = MaterialColors[i];
+		d3dDevice->CreateBuffer(&materialDesc, &initialData, &d3dMaterialConstantBuffers[i]);
+	}
+
+	D3D11_QUERY_DESC timerDesc;
+	ZeroMemory(&timerDesc, sizeof(timerDesc));
+	for (int i = 0; i < GpuTimerCount; i++) {
+		timerDesc.Query = D3D11_QUERY_TIMESTAMP_DISJOINT;
+		d3dDevice->CreateQuery(&timerDesc, &gpuTimers[i].D3DDisjoint);
+		timerDesc.Query = D3D11_QUERY_TIMESTAMP;
+		d3dDevice->CreateQuery(&timerDesc, &gpuTimers[i].D3DBegin);
+		d3dDevice->CreateQuery(&timerDesc, &gpuTimers[i].D3DEnd);
+	}
+
+	BindSceneState(immediate, material);
+}
+
+// Everything drawing the scene needs, other than the render targets, viewport and vertex
+// constants. Only what differs from what the target has bound is set.
+void D3D11RenderDevice::BindSceneState(FilteredContext& target, int material) {
+	target.SetInputLayout(d3dInputLayout);
+	target.SetVertexBuffer(d3dVertexBuffer, sizeof(Vertex));
+	target.SetTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	target.SetVertexShader(stereoMode == StereoMode_Instanced ? d3dStereoVertexShader : d3dVertexShader);
+	target.SetPixelShader(d3dPixelShader);
+	target.SetPixelConstants(d3dMaterialConstantBuffers[material]);
+}
+
+void D3D11RenderDevice::DestroyScene() {
+	for (int i = 0; i < FrameQueryCount; i++) {
+		if (d3dFrameQueries[i] != nullptr) {
+			d3dFrameQueries[i]->Release();
+		}
+	}
+	if (d3dContext1 != nullptr) {
+		d3dContext1->Release();
+	}
+	for (int context = 0; context < MaxRecordingContexts; context++) {
+		FilteredContext& target = recordingContexts[context].Target;
+		if (target.D3DContext1 != nullptr) {
+			target.D3DContext1->Release();
+		}
+		if (target.D3DContext != nullptr) {
+			target.D3DContext->Release();
+		}
+	}
+	for (int slot = 0; slot < ConstantSlotCount; slot++) {
+		if (d3dFallbackConstantBuffers[slot] != nullptr) {
+			d3dFallbackConstantBuffers[slot]->Release();
+		}
+	}
+	for (int part = 0; part < LatchedConstantParts; part++) {
+		d3dLatchedConstantBuffers[part]->Release();
+	}
+	for (int i = 0; i < MaxMaterials; i++) {
+		d3dMaterialConstantBuffers[i]->Release();
+	}
+	for (int i = 0; i < GpuTimerCount; i++) {
+		gpuTimers[i].D3DDisjoint->Release();
+		gpuTimers[i].D3DBegin->Release();
+		gpuTimers[i].D3DEnd->Release();
+	}
+	if (d3dConstantBuffer != nullptr) {
+		d3dConstantBuffer->Release();
+	}
+	if (d3dVertexBuffer != nullptr) {
+		d3dVertexBuffer->Release();
+	}
+	d3dInputLayout->Release();
+	d3dVertexShader->Release();
+	d3dStereoVertexShader->Release();
+	d3dPixelShader->Release();
+}
+
+// Must match CompositeShaderCode in D3D11Shaders.cpp.
+struct CompositeConstants {
+	float Destination[EyeCount * FoveatedRegionCount][4];
+	float Source[EyeCount * FoveatedRegionCount][4];
+	float SourceClamp[EyeCount * FoveatedRegionCount][4];
+	float Tint[EyeCount * FoveatedRegionCount][4];
+};
+
+void D3D11RenderDevice::PlanTargets() {
+	DeclareEyeFrameGraph(eyeTextureSize, multisampleCount, foveated, fusedResolve, clearColor ? &colorClear : nullptr, clearDepthStencil ? &depthStencilClear : nullptr, graph);
+	if (!graph.Compile()) {
+		return;
+	}
+
+	graph.BuildTargetPlan(targetPlan);
+	std::vector<int> created;
+	std::vector<int> released;
+	targetPool.Apply(targetPlan, created, released);
+
+	// Releasing first keeps the peak down when a texture is swapped for one of a different kind.
+	for (size_t i = 0; i < released.size(); i++) {
+		ReleaseTarget(pooledTargets[released[i]]);
+	}
+	if (pooledTargets.size() < static_cast<size_t>(targetPool.GetSlotCount())) {
+		pooledTargets.resize(targetPool.GetSlotCount(), noTarget);
+	}
+	for (size_t i = 0; i < created.size(); i++) {
+		CreateTarget(pooledTargets[created[i]], targetPool.GetSlotDesc(created[i]));
+	}
+
+	d3dSceneRenderTargetView = GetTarget(foveated ? EyeTarget_Foveated : EyeTarget_Eye).D3DRenderTargetView;
+	d3dDepthStencilView = GetTarget(EyeTarget_DepthStencil).D3DDepthStencilView;
+
+	const RenderTargetPlan::Statistics& statistics = targetPlan.GetStatistics();
+	char message[256];
+	std::sprintf(message, "Render targets: %d textures, %llu KB (%llu KB peak, %llu KB aliased), %d created, %d released\n",
+		statistics.Textures, statistics.AllocatedBytes / 1024, statistics.PeakBytes / 1024, statistics.AliasedBytes / 1024,
+		static_cast<int>(created.size()), static_cast<int>(released.size()));
+	OutputDebugStringA(message);
+}
+
+void D3D11RenderDevice::CreateTarget(PooledTarget& target, const RenderTargetDesc& desc) {
+	D3D11_TEXTURE2D_DESC texdesc;
+	ZeroMemory(&texdesc, sizeof(texdesc));
+	texdesc.Width = desc.Size.w;
+	texdesc.Height = desc.Size.h;
+	texdesc.MipLevels = 1;
+	texdesc.ArraySize = 1;
+	texdesc.Format = desc.Format == RenderTargetFormat_DepthStencil ? DXGI_FORMAT_D24_UNORM_S8_UINT : DXGI_FORMAT_R8G8B8A8_UNORM;
+	texdesc.SampleDesc.Count = desc.SampleCount;
+	texdesc.Usage = D3D11_USAGE_DEFAULT;
+	if (desc.BindFlags & RenderTargetBind_RenderTarget) {
+		texdesc.BindFlags |= D3D11_BIND_RENDER_TARGET;
+	}
+	if (desc.BindFlags & RenderTargetBind_ShaderResource) {
+		texdesc.BindFlags |= D3D11_BIND_SHADER_RESOURCE;
+	}
+	if (desc.BindFlags & RenderTargetBind_DepthStencil) {
+		texdesc.BindFlags |= D3D11_BIND_DEPTH_STENCIL;
+	}
+	target = noTarget;
+	d3dDevice->CreateTexture2D(&texdesc, nullptr, &target.D3DTexture);
+
+	if (desc.BindFlags & RenderTargetBind_RenderTarget) {
+		d3dDevice->CreateRenderTargetView(target.D3DTexture, nullptr, &target.D3DRenderTargetView);
+	}
+	if (desc.BindFlags & RenderTargetBind_ShaderResource) {
+		d3dDevice->CreateShaderResourceView(target.D3DTexture, nullptr, &target.D3DShaderResourceView);
+	}
+	if (desc.BindFlags & RenderTargetBind_DepthStencil) {
+		D3D11_DEPTH_STENCIL_VIEW_DESC dsvDesc;
+		ZeroMemory(&dsvDesc, sizeof(dsvDesc));
+		dsvDesc.Format = texdesc.Format;
+		dsvDesc.ViewDimension = desc.SampleCount > 1 ? D3D11_DSV_DIMENSION_TEXTURE2DMS : D3D11_DSV_DIMENSION_TEXTURE2D;
+		d3dDevice->CreateDepthStencilView(target.D3DTexture, &dsvDesc, &target.D3DDepthStencilView);
+	}
+}
+
+void D3D11RenderDevice::ReleaseTarget(PooledTarget& target) {
+	if (target.D3DDepthStencilView != nullptr) {
+		target.D3DDepthStencilView->Release();
+	}
+	if (target.D3DShaderResourceView != nullptr) {
+		target.D3DShaderResourceView->Release();
+	}
+	if (target.D3DRenderTargetView != nullptr) {
+		target.D3DRenderTargetView->Release();
+	}
+	if (target.D3DTexture != nullptr) {
+		target.D3DTexture->Release();
+	}
+	target.D3DTexture = nullptr;
+	target.D3DRenderTargetView = nullptr;
+	target.D3DShaderResourceView = nullptr;
+	target.D3DDepthStencilView = nullptr;
+}
+
+const D3D11RenderDevice::PooledTarget& D3D11RenderDevice::GetTarget(int target) const {
+	int texture = targetPlan.GetTexture(target);
+	return texture >= 0 ? pooledTargets[targetPool.GetSlot(texture)] : noTarget;
+}
+
+void D3D11RenderDevice::SetupComposite() {
+	ShaderBytecode vertexShader = GetShaderBytecode(Shader_CompositeVertex);
+	ShaderBytecode pixelShader = GetShaderBytecode(Shader_CompositePixel);
+	d3dDevice->CreateVertexShader(vertexShader.Data, vertexShader.Size, nullptr, &d3dCompositeVertexShader);
+	d3dDevice->CreatePixelShader(pixelShader.Data, pixelShader.Size, nullptr, &d3dCompositePixelShader);
+
+	D3D11_SAMPLER_DESC samplerDesc;
+	ZeroMemory(&samplerDesc, sizeof(samplerDesc));
+	samplerDesc.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
+	samplerDesc.AddressU = D3D11_TEXTURE_ADDRESS_CLAMP;
+	samplerDesc.AddressV = D3D11_TEXTURE_ADDRESS_CLAMP;
+	samplerDesc.AddressW = D3D11_TEXTURE_ADDRESS_CLAMP;
+	samplerDesc.ComparisonFunc = D3D11_COMPARISON_NEVER;
+	samplerDesc.MaxLOD = D3D11_FLOAT32_MAX;
+	d3dDevice->CreateSamplerState(&samplerDesc, &d3dCompositeSampler);
+
+	D3D11_BUFFER_DESC cbDesc;
+	ZeroMemory(&cbDesc, sizeof(cbDesc));
+	cbDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	cbDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	cbDesc.Usage = D3D11_USAGE_DYNAMIC;
+	cbDesc.ByteWidth = sizeof(CompositeConstants);
+	d3dDevice->CreateBuffer(&cbDesc, nullptr, &d3dCompositeConstantBuffer);
+}
+
+void D3D11RenderDevice::SetupGpuDriven() {
+	ShaderBytecode cullShader = GetShaderBytecode(Shader_CullCompute);
+	ShaderBytecode vertexShader = GetShaderBytecode(Shader_InstanceVertex);
+	ShaderBytecode stereoVertexShader = GetShaderBytecode(Shader_StereoInstanceVertex);
+	ShaderBytecode pixelShader = GetShaderBytecode(Shader_InstancePixel);
+	d3dDevice->CreateComputeShader(cullShader.Data, cullShader.Size, nullptr, &d3dCullShader);
+	d3dDevice->CreateVertexShader(vertexShader.Data, vertexShader.Size, nullptr, &d3dInstanceVertexShader);
+	d3dDevice->CreateVertexShader(stereoVertexShader.Data, stereoVertexShader.Size, nullptr, &d3dStereoInstanceVertexShader);
+	d3dDevice->CreatePixelShader(pixelShader.Data, pixelShader.Size, nullptr, &d3dInstancePixelShader);
+
+	// The instance comes from the list of visible instances, see InstanceShaderCode.
+	D3D11_INPUT_ELEMENT_DESC inputElements[] = {
+		{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "INSTANCE", 0, DXGI_FORMAT_R32_UINT, 1, 0, D3D11_INPUT_PER_INSTANCE_DATA, 1 }
+	};
+	d3dDevice->CreateInputLayout(inputElements, 2, vertexShader.Data, vertexShader.Size, &d3dInstanceInputLayout);
+	inputElements[1].InstanceDataStepRate = EyeCount;
+	d3dDevice->CreateInputLayout(inputElements, 2, stereoVertexShader.Data, stereoVertexShader.Size, &d3dStereoInstanceInputLayout);
+
+	D3D11_BUFFER_DESC cbDesc;
+	ZeroMemory(&cbDesc, sizeof(cbDesc));
+	cbDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	cbDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	cbDesc.Usage = D3D11_USAGE_DYNAMIC;
+	cbDesc.ByteWidth = 112; // CullConstants
+	d3dDevice->CreateBuffer(&cbDesc, nullptr, &d3dCullConstantBuffer);
+
+	D3D11_SUBRESOURCE_DATA initialData;
+	ZeroMemory(&initialData, sizeof(initialData));
+	initialData.pSysMem = MaterialColors;
+	cbDesc.CPUAccessFlags = 0;
+	cbDesc.Usage = D3D11_USAGE_IMMUTABLE;
+	cbDesc.ByteWidth = sizeof(MaterialColors);
+	d3dDevice->CreateBuffer(&cbDesc, &initialData, &d3dMaterialColorBuffer);
+}
+
+void D3D11RenderDevice::SetupDistortion() {
+	ShaderBytecode vertexShader = GetShaderBytecode(Shader_DistortionVertex);
+	ShaderBytecode pixelShader = GetShaderBytecode(Shader_DistortionPixel);
+	ShaderBytecode resolvePixelShader = GetShaderBytecode(Shader_DistortionResolvePixel);
+	d3dDevice->CreateVertexShader(vertexShader.Data, vertexShader.Size, nullptr, &d3dDistortionVertexShader);
+	d3dDevice->CreatePixelShader(pixelShader.Data, pixelShader.Size, nullptr, &d3dDistortionPixelShader);
+	d3dDevice->CreatePixelShader(resolvePixelShader.Data, resolvePixelShader.Size, nullptr, &d3dDistortionResolvePixelShader);
+
+	// A DistortionVertex.
+	D3D11_INPUT_ELEMENT_DESC inputElements[] = {
+		{ "POSITION", 0, DXGI_FORMAT_R16G16_SNORM, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "TEXCOORD", 0, DXGI_FORMAT_R16G16_SNORM, 0, 4, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "TEXCOORD", 1, DXGI_FORMAT_R16G16_SNORM, 0, 8, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "TEXCOORD", 2, DXGI_FORMAT_R16G16_SNORM, 0, 12, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "COLOR", 0, DXGI_FORMAT_R8G8B8A8_UNORM, 0, 16, D3D11_INPUT_PER_VERTEX_DATA, 0 }
+	};
+	d3dDevice->CreateInputLayout(inputElements, 5, vertexShader.Data, vertexShader.Size, &d3dDistortionInputLayout);
+
+	D3D11_SAMPLER_DESC samplerDesc;
+	ZeroMemory(&samplerDesc, sizeof(samplerDesc));
+	samplerDesc.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
+	samplerDesc.AddressU = D3D11_TEXTURE_ADDRESS_CLAMP;
+	samplerDesc.AddressV = D3D11_TEXTURE_ADDRESS_CLAMP;
+	samplerDesc.AddressW = D3D11_TEXTURE_ADDRESS_CLAMP;
+	samplerDesc.ComparisonFunc = D3D11_COMPARISON_NEVER;
+	samplerDesc.MaxLOD = D3D11_FLOAT32_MAX;
+	d3dDevice->CreateSamplerState(&samplerDesc, &d3dDistortionSampler);
+
+	D3D11_BUFFER_DESC cbDesc;
+	ZeroMemory(&cbDesc, sizeof(cbDesc));
+	cbDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	cbDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	cbDesc.Usage = D3D11_USAGE_DYNAMIC;
+	cbDesc.ByteWidth = sizeof(DistortionConstants);
+	d3dDevice->CreateBuffer(&cbDesc, nullptr, &d3dDistortionConstantBuffer);
+}
+
+EyeTarget D3D11RenderDevice::GetDistortionSourceTarget() const {
+	if (multisampleCount > 1 && !IsEyeResolveFused(multisampleCount, foveated, fusedResolve)) {
+		return EyeTarget_Intermediary;
+	}
+	return EyeTarget_Eye;
+}
+
+void D3D11RenderDevice::ReleaseSceneInstances() {
+	ID3D11DeviceChild* d3dObjects[] = {
+		d3dVisibleView, d3dVisibleBuffer, d3dDrawArgsView, d3dDrawArgsBuffer, d3dMeshDrawView, d3dMeshDrawBuffer, d3dInstanceView, d3dInstanceBuffer
+	};
+	for (size_t i = 0; i < sizeof(d3dObjects) / sizeof(d3dObjects[0]); i++) {
+		if (d3dObjects[i] != nullptr) {
+			d3dObjects[i]->Release();
+		}
+	}
+	d3dVisibleView = nullptr;
+	d3dVisibleBuffer = nullptr;
+	d3dDrawArgsView = nullptr;
+	d3dDrawArgsBuffer = nullptr;
+	d3dMeshDrawView = nullptr;
+	d3dMeshDrawBuffer = nullptr;
+	d3dInstanceView = nullptr;
+	d3dInstanceBuffer = nullptr;
+	sceneInstanceCount = 0;
+	sceneMeshCount = 0;
+}
+
+void D3D11RenderDevice::CompositeFoveatedTarget(const PooledTarget& source, const PooledTarget& destination) {
+	// Both textures are the size of the eye texture.
+	float width = static_cast<float>(eyeTextureSize.w);
+	float height = static_cast<float>(eyeTextureSize.h);
+	D3D11_MAPPED_SUBRESOURCE d3dMappedStatus;
+	d3dContext->Map(d3dCompositeConstantBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &d3dMappedStatus);
+	CompositeConstants* constants = static_cast<CompositeConstants*>(d3dMappedStatus.pData);
+	for (int eye = 0; eye < EyeCount; eye++) {
+		for (int i = 0; i < FoveatedRegionCount; i++) {
+			const FoveatedRegion& region = foveatedLayout.Regions[eye][i];
+			int index = eye * FoveatedRegionCount + i;
+			constants->Destination[index][0] = 2.0f * region.Eye.Pos.x / width - 1.0f;
+			constants->Destination[index][1] = 1.0f - 2.0f * region.Eye.Pos.y / height;
+			constants->Destination[index][2] = 2.0f * (region.Eye.Pos.x + region.Eye.Size.w) / width - 1.0f;
+			constants->Destination[index][3] = 1.0f - 2.0f * (region.Eye.Pos.y + region.Eye.Size.h) / height;
+			constants->Source[index][0] = region.Target.Pos.x / width;
+			constants->Source[index][1] = region.Target.Pos.y / height;
+			constants->Source[index][2] = (region.Target.Pos.x + region.Target.Size.w) / width;
+			constants->Source[index][3] = (region.Target.Pos.y + region.Target.Size.h) / height;
+			constants->SourceClamp[index][0] = (region.Target.Pos.x + 0.5f) / width;
+			constants->SourceClamp[index][1] = (region.Target.Pos.y + 0.5f) / height;
+			constants->SourceClamp[index][2] = (region.Target.Pos.x + region.Target.Size.w - 0.5f) / width;
+			constants->SourceClamp[index][3] = (region.Target.Pos.y + region.Target.Size.h - 0.5f) / height;
+
+			// Visualized, the full density center stays as it is, regions reduced along one axis
+			// turn red and the corners, reduced along both, blue.
+			float tint[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+			if (foveatedLayout.Visualize) {
+				bool reducedX = region.Target.Size.w < region.Eye.Size.w;
+				bool reducedY = region.Target.Size.h < region.Eye.Size.h;
+				if (reducedX && reducedY) {
+					tint[0] = 0.5f;
+					tint[1] = 0.5f;
+				}
+				else if (reducedX || reducedY) {
+					tint[1] = 0.5f;
+					tint[2] = 0.5f;
+				}
+			}
+			std::memcpy(constants->Tint[index], tint, sizeof(tint));
+		}
+	}
+	d3dContext->Unmap(d3dCompositeConstantBuffer, 0);
+
+	immediate.SetRenderTargets(destination.D3DRenderTargetView, nullptr);
+	Rect2i viewport = { { 0, 0 }, eyeTextureSize };
+	immediate.SetViewport(viewport);
+	immediate.SetInputLayout(nullptr);
+	immediate.SetTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
+	immediate.SetVertexShader(d3dCompositeVertexShader);
+	immediate.SetPixelShader(d3dCompositePixelShader);
+	immediate.SetVertexConstants(0, d3dCompositeConstantBuffer);
+	immediate.SetPixelConstants(d3dCompositeConstantBuffer);
+	immediate.SetPixelResource(source.D3DShaderResourceView);
+	immediate.SetPixelSampler(d3dCompositeSampler);
+	d3dContext->DrawInstanced(4, EyeCount * FoveatedRegionCount, 0, 0);
+
+	// The graph's barriers unbind the targets, the scene's state is ours to restore.
+	BindSceneState(immediate, material);
+}
+
+void D3D11RenderDevice::GraphBackend::Barrier(const FrameGraph& graph, int resource, FrameGraphState before, FrameGraphState after) {
+	// D3D11 tracks the hazards itself, but a texture can't be bound for drawing to and sampling
+	// at once, so what it was bound as is unbound before it is used as something else.
+	if (before == FrameGraphState_RenderTarget || before == FrameGraphState_DepthStencil) {
+		Device->immediate.SetRenderTargets(nullptr, nullptr);
+	}
+	else if (before == FrameGraphState_ShaderResource) {
+		Device->immediate.SetPixelResource(nullptr);
+	}
+}
+
+void D3D11RenderDevice::GraphBackend::Clear(const FrameGraph& graph, int resource, const FrameGraphClearValue& value) {
+	const PooledTarget& target = Device->GetTarget(resource);
+	if (target.D3DDepthStencilView != nullptr) {
+		Device->d3dContext->ClearDepthStencilView(target.D3DDepthStencilView, D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, value.Depth, value.Stencil);
+	}
+	else {
+		Device->d3dContext->ClearRenderTargetView(target.D3DRenderTargetView, value.Color);
+	}
+}
+
+void D3D11RenderDevice::GraphBackend::Resolve(const FrameGraph& graph, int source, int destination) {
+	Device->d3dContext->ResolveSubresource(Device->GetTarget(destination).D3DTexture, 0, Device->GetTarget(source).D3DTexture, 0, DXGI_FORMAT_R8G8B8A8_UNORM);
+}
+
+void D3D11RenderDevice::GraphBackend::RunPass(const FrameGraph& graph, int pass) {
+	// The scene pass only binds its targets, the frame loop draws it.
+	if (pass == EyeGraphPass_Scene) {
+		Device->BindSceneTargets();
+	}
+	else if (pass == EyeGraphPass_Composite) {
+		Device->CompositeFoveatedTarget(Device->GetTarget(graph.GetPassUse(pass, 0).Resource), Device->GetTarget(graph.GetPassUse(pass, 1).Resource));
+	}
+}
@@ -0,0 +1,383 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#pragma once
+
+// Prevent windows.h from breaking std::min and std::max.
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <d3d11_1.h>
+#include "ConstantRingAllocator.h"
+#include "D3D11Shaders.h"
+#include "FrameGraph.h"
+#include "RenderDevice.h"
+#include "StateCache.h"
+#include <vector>
+
+/*
+	RenderDevice implementation for Direct3D 11. Creates the device and swap chain for a window,
+	the eye texture shared by both eyes, its depth buffer and the scene. The resources LibOVR needs
+	for its configuration are available through the getters. Shaders come from shaderCache, which
+	has to outlive the device.
+
+	Every IASet*, VSSet*, PSSet*, OMSet* and RSSet* call goes through a StateCache per context, so
+	binding what is already bound costs nothing but the comparison. GetStateStatistics adds up
+	what the caches issued and filtered.
+
+	GPU driven drawing needs feature level 11_0, SetSceneInstances fails below that.
+
+	PresentDistorted draws into the back buffer and presents the swap chain itself, for when
+	LibOVR only times the frames (OvrHmd::ConfigureOwnDistortion). With a fused resolve it samples
+	the multisampled eye texture with a pixel shader of its own.
+
+	The hidden area is drawn into the depth buffer by BindEyeTexture, but the color clear stays a
+	clear of the whole texture: most GPUs clear it by marking its compressed tiles, which a clear
+	of the visible part only (ClearView with rectangles) would lose.
+*/
+class D3D11RenderDevice : public RenderDevice {
+public:
+	D3D11RenderDevice(HWND hwnd, Size2i backBufferSize, Size2i eyeTextureSize, int multisampleCount, ShaderCache& shaderCache);
+	~D3D11RenderDevice();
+
+	ID3D11Device* GetDevice() const;
+	ID3D11DeviceContext* GetContext() const;
+	IDXGISwapChain* GetSwapChain() const;
+	ID3D11RenderTargetView* GetBackBufferRenderTargetView() const;
+
+	// The texture LibOVR should sample when distorting: the intermediary if we use multisampling,
+	// otherwise the eye texture itself. The multisampled eye texture with a fused resolve.
+	ID3D11Texture2D* GetDistortionSourceTexture() const;
+	ID3D11ShaderResourceView* GetDistortionSourceShaderResourceView() const;
+
+	// How the eye texture and the targets around it are currently laid out, see PlanTargets.
+	const FrameGraph& GetFrameGraph() const;
+	const RenderTargetPlan& GetTargetPlan() const;
+	const RenderTargetPool& GetTargetPool() const;
+
+	Size2i GetEyeTextureSize() const;
+	int GetMultisampleCount() const;
+	StateCache::Statistics GetStateStatistics() const;
+
+	void ClearEyeTexture(const float color[4]);
+	void ClearDepthStencil(float depth, unsigned char stencil);
+	void BindEyeTexture();
+	void SetViewport(const Rect2i& viewport);
+	void SetStereoMode(StereoMode mode);
+	void SetSceneVertices(const Vertex* vertices, unsigned int vertexCount);
+	void UploadSceneVertices(unsigned int firstVertex, const Vertex* vertices, unsigned int vertexCount);
+	void BeginConstants();
+	void* AllocateConstants(unsigned int size, unsigned int& outOffset);
+	void EndConstants();
+	void BindConstants(ConstantSlot slot, unsigned int offset, unsigned int size);
+	void BindLatchedConstants(ConstantSlot slot, int part);
+	void SetMaterial(int material);
+	void Draw(unsigned int vertexCount, unsigned int startVertex);
+	void DrawInstanced(unsigned int vertexCount, unsigned int instanceCount, unsigned int startVertex);
+	RenderContext& BeginRecording(int context);
+	void EndRecording(int context);
+	void ExecuteRecordings(int count);
+	void LatchConstants(int part, const void* data, unsigned int size);
+	void SetFoveatedLayout(const FoveatedLayout* layout);
+	bool SetSceneInstances(const SceneInstance* instances, unsigned int instanceCount, const IndirectDrawArgs* meshDraws, unsigned int meshCount);
+	void CullSceneInstances(const Frustum& frustum);
+	void DrawSceneInstances();
+	void ResolveEyeTexture();
+	bool SetDistortionMesh(int eye, const DistortionMesh& mesh);
+	void PresentDistorted(const DistortionConstants constants[EyeCount]);
+	bool SetFusedResolve(bool fused);
+	bool SetHiddenAreaMesh(int eye, const HiddenAreaMesh& mesh);
+	void SetHiddenAreaViewports(const Rect2i* viewports);
+	void BeginGpuTimer();
+	void EndGpuTimer();
+	bool GetGpuFrameTime(double& outSeconds);
+
+private:
+	// A context and the StateCache in front of it. Each call only reaches the context if it
+	// changes the state.
+	struct FilteredContext {
+		FilteredContext();
+
+		void SetInputLayout(ID3D11InputLayout* d3dInputLayout);
+		void SetVertexBuffer(ID3D11Buffer* d3dBuffer, UINT stride);
+		void SetInstanceBuffer(ID3D11Buffer* d3dBuffer, UINT stride);
+		void SetTopology(D3D11_PRIMITIVE_TOPOLOGY topology);
+		void SetVertexShader(ID3D11VertexShader* d3dShader);
+		void SetPixelShader(ID3D11PixelShader* d3dShader);
+		void SetVertexConstants(int slot, ID3D11Buffer* d3dBuffer);
+		void SetVertexConstants(int slot, ID3D11Buffer* d3dBuffer, UINT firstConstant, UINT constantCount); // Needs D3DContext1
+		void SetVertexResource(ID3D11ShaderResourceView* d3dView);
+		void SetPixelConstants(ID3D11Buffer* d3dBuffer);
+		void SetPixelResource(ID3D11ShaderResourceView* d3dView);
+		void SetPixelSampler(ID3D11SamplerState* d3dSampler);
+		void SetRenderTargets(ID3D11RenderTargetView* d3dRenderTargetView, ID3D11DepthStencilView* d3dDepthStencilView);
+		void SetViewport(const Rect2i& viewport);
+
+		ID3D11DeviceContext* D3DContext;
+		ID3D11DeviceContext1* D3DContext1; // Only if constant buffer offsetting is supported
+		StateCache State;
+	};
+
+	// A deferred context and the command list it last recorded.
+	class RecordingContext : public RenderContext {
+	public:
+		RecordingContext();
+
+		void SetViewport(const Rect2i& viewport);
+		void BindConstants(ConstantSlot slot, unsigned int offset, unsigned int size);
+		void BindLatchedConstants(ConstantSlot slot, int part);
+		void SetMaterial(int material);
+		void Draw(unsigned int vertexCount, unsigned int startVertex);
+		void DrawInstanced(unsigned int vertexCount, unsigned int instanceCount, unsigned int startVertex);
+
+		D3D11RenderDevice* Device;
+		FilteredContext Target; // Its D3DContext1 only if the device's immediate context has one
+		ID3D11CommandList* D3DCommandList;
+	};
+
+	// Runs the eye frame graph's commands on the immediate context.
+	class GraphBackend : public FrameGraphBackend {
+	public:
+		void Barrier(const FrameGraph& graph, int resource, FrameGraphState before, FrameGraphState after);
+		void Clear(const FrameGraph& graph, int resource, const FrameGraphClearValue& value);
+		void Resolve(const FrameGraph& graph, int source, int destination);
+		void RunPass(const FrameGraph& graph, int pass);
+
+		D3D11RenderDevice* Device;
+	};
+
+	// A texture of the target pool with the views its bind flags allow.
+	struct PooledTarget {
+		ID3D11Texture2D* D3DTexture;
+		ID3D11RenderTargetView* D3DRenderTargetView;
+		ID3D11ShaderResourceView* D3DShaderResourceView;
+		ID3D11DepthStencilView* D3DDepthStencilView;
+	};
+
+	// From the cache, or compiled if it isn't there.
+	ShaderBytecode GetShaderBytecode(Shader shader);
+	void SetupScene();
+	void DestroyScene();
+	void PlanTargets();
+	void CreateTarget(PooledTarget& target, const RenderTargetDesc& desc);
+	static void ReleaseTarget(PooledTarget& target);
+	const PooledTarget& GetTarget(int target) const; // All null if the target isn't used
+	void BindSceneTargets();
+	void SetupComposite();
+	void CompositeFoveatedTarget(const PooledTarget& source, const PooledTarget& destination);
+	void SetupGpuDriven();
+	void SetupDistortion();
+	EyeTarget GetDistortionSourceTarget() const;
+	void DrawHiddenArea();
+	void ReleaseSceneInstances();
+	void FenceConstantFrames();
+	void RetireConstantFrames(unsigned long long waitForFrame);
+
+	// Shared by the immediate context and the recording contexts.
+	void BindSceneState(FilteredContext& target, int material);
+	void BindConstants(FilteredContext& target, ConstantSlot slot, unsigned int offset, unsigned int size);
+
+	Size2i eyeTextureSize;
+	int multisampleCount;
+	StereoMode stereoMode;
+	ShaderCache& shaderCache;
+
+	ID3D11Device* d3dDevice;
+	ID3D11DeviceContext* d3dContext;
+	ID3D11DeviceContext1* d3dContext1; // Only if constant buffer offsetting is supported
+	D3D_FEATURE_LEVEL featureLevel;
+	FilteredContext immediate; // d3dContext and d3dContext1 with their state cache
+	IDXGISwapChain* d3dSwapChain;
+	ID3D11RenderTargetView* d3dBackBufferRenderTargetView;
+	Size2i backBufferSize;
+
+	/*
+		Each frame is a frame graph, see DeclareEyeFrameGraph, declared in BindEyeTexture with the
+		clears asked for since the last frame. Its commands up to the scene pass run there, the
+		rest in ResolveEyeTexture. Whenever it compiles anew the targets are planned again.
+
+		The eye texture, its depth buffer and the targets between them and LibOVR all come from
+		targetPool, laid out by the graph for the current settings. Targets the settings don't
+		use have no texture. LibOVR uses the eye texture as the source when rendering the final
+		distorted view to the HMD, unless we use multisampling. Then we need an intermediary:
+
+			Geometry ----> Eye texture ----> Intermediary ----> Back buffer
+
+		Unless the distortion is ours and resolves the eye texture itself, see SetFusedResolve:
+
+			Geometry ----> Multisampled eye texture ----> Back buffer
+
+		With a foveated layout the scene goes into the foveated target instead of the eye texture.
+		It has the same size and sample count, so it shares the depth buffer. The composite pass
+		then draws a quad per region that stretches it into the eye texture, or into the
+		intermediary if we use multisampling, after resolving it into a texture of its own:
+
+			Geometry ----> Foveated target (----> Foveated resolve) ----> Eye texture or intermediary
+
+		With multisampling nothing draws into the eye texture then, so the foveated target takes
+		its texture. The plan is made again whenever foveation is switched on or off.
+	*/
+	FrameGraph graph;
+	GraphBackend graphBackend;
+	FrameGraphClearValue colorClear;
+	FrameGraphClearValue depthStencilClear;
+	bool clearColor; // Since the last BindEyeTexture
+	bool clearDepthStencil;
+	RenderTargetPlan targetPlan;
+	RenderTargetPool targetPool;
+	std::vector<PooledTarget> pooledTargets; // By pool slot
+	PooledTarget noTarget;
+
+	// The foveated composite, created the first time a layout is set.
+	ID3D11VertexShader* d3dCompositeVertexShader;
+	ID3D11PixelShader* d3dCompositePixelShader;
+	ID3D11SamplerState* d3dCompositeSampler;
+	ID3D11Buffer* d3dCompositeConstantBuffer;
+	FoveatedLayout foveatedLayout;
+	bool foveated;
+
+	/*
+		GPU driven drawing. The shaders are created by the first SetSceneInstances, the buffers
+		by each one: the scene changes rarely enough for that.
+
+		Each frame the mesh draws as given are copied into the draw arguments, which the cull
+		shader then counts the visible instances into while listing them. The list is bound as
+		the per-instance vertex buffer of the indirect draws, and as a UAV only during the cull.
+	*/
+	ID3D11ComputeShader* d3dCullShader;
+	ID3D11VertexShader* d3dInstanceVertexShader;
+	ID3D11VertexShader* d3dStereoInstanceVertexShader;
+	ID3D11PixelShader* d3dInstancePixelShader;
+	ID3D11InputLayout* d3dInstanceInputLayout;
+	ID3D11InputLayout* d3dStereoInstanceInputLayout; // Each listed instance twice, once per eye
+	ID3D11Buffer* d3dCullConstantBuffer;
+	ID3D11Buffer* d3dMaterialColorBuffer; // All MaterialColors, for the instance vertex shaders
+	ID3D11Buffer* d3dInstanceBuffer;
+	ID3D11ShaderResourceView* d3dInstanceView;
+	ID3D11Buffer* d3dMeshDrawBuffer;
+	ID3D11ShaderResourceView* d3dMeshDrawView;
+	ID3D11Buffer* d3dDrawArgsBuffer;
+	ID3D11UnorderedAccessView* d3dDrawArgsView;
+	ID3D11Buffer* d3dVisibleBuffer;
+	ID3D11UnorderedAccessView* d3dVisibleView;
+	unsigned int sceneInstanceCount;
+	unsigned int sceneMeshCount;
+
+	/*
+		Own distortion, drawn into the back buffer instead of by LibOVR. The shaders are created by
+		the first SetDistortionMesh, each eye's mesh is a pair of immutable buffers.
+	*/
+	ID3D11VertexShader* d3dDistortionVertexShader;
+	ID3D11PixelShader* d3dDistortionPixelShader;
+	ID3D11PixelShader* d3dDistortionResolvePixelShader;
+	ID3D11InputLayout* d3dDistortionInputLayout;
+	ID3D11SamplerState* d3dDistortionSampler;
+	ID3D11Buffer* d3dDistortionConstantBuffer;
+	ID3D11Buffer* d3dDistortionVertexBuffers[EyeCount];
+	ID3D11Buffer* d3dDistortionIndexBuffers[EyeCount];
+	unsigned int distortionIndexCounts[EyeCount];
+	bool fusedResolve;
+
+	/*
+		The hidden area, each eye's mesh an immutable buffer of two triangles per rectangle. The
+		shader is created by the first SetHiddenAreaMesh.
+	*/
+	ID3D11VertexShader* d3dHiddenAreaVertexShader;
+	ID3D11InputLayout* d3dHiddenAreaInputLayout;
+	ID3D11Buffer* d3dHiddenAreaVertexBuffers[EyeCount];
+	unsigned int hiddenAreaVertexCounts[EyeCount];
+	bool hiddenAreaSet; // Whether there are viewports
+	Rect2i hiddenAreaViewports[EyeCount];
+
+	// Where the scene is drawn: the eye texture, or the foveated target. Set by PlanTargets.
+	ID3D11RenderTargetView* d3dSceneRenderTargetView;
+	ID3D11DepthStencilView* d3dDepthStencilView;
+
+	// Scene resources.
+	ID3D11InputLayout* d3dInputLayout;
+	ID3D11VertexShader* d3dVertexShader;
+	ID3D11VertexShader* d3dStereoVertexShader; // For StereoMode_Instanced
+	ID3D11PixelShader* d3dPixelShader;
+	ID3D11Buffer* d3dVertexBuffer;
+	unsigned int vertexBufferCapacity; // In vertices
+
+	// A constant buffer per material with its color, for the pixel shader.
+	ID3D11Buffer* d3dMaterialConstantBuffers[MaxMaterials];
+	int material; // Of the immediate context
+
+	/*
+		Per-draw constants live in one large ring buffer, see ConstantRingAllocator. It is mapped
+		once per batch with NO_OVERWRITE and each draw binds its part with VSSetConstantBuffers1.
+		Each batch is a frame of the allocator, but the event queries that tell when the GPU is
+		done with them are only issued once per rendered frame, by ResolveEyeTexture, for all the
+		batches since the last one. Only a frame whose constants don't fit into the ring at all is
+		fenced before it ends, see AllocateConstants.
+
+		Without D3D11.1 (or a driver that can't do it) the constants are written to a ring in CPU
+		memory instead and copied into a small buffer per slot with a WRITE_DISCARD map for each bind.
+	*/
+	static const int FrameQueryCount = 4;
+	ID3D11Buffer* d3dConstantBuffer;
+	ID3D11Buffer* d3dFallbackConstantBuffers[ConstantSlotCount];
+
+	ID3D11Query* d3dFrameQueries[FrameQueryCount];
+	ConstantRingAllocator constantAllocator;
+	std::vector<unsigned char> fallbackConstants;
+	unsigned char* mappedConstants;
+	unsigned long long constantFrame; // Of the allocator, one per batch
+	unsigned long long fencedFrame; // Last one an event query has been issued for
+	unsigned long long completedFrame; // Last one the GPU is known to be done with
+	unsigned long long issuedQueries;
+	unsigned long long completedQueries;
+	unsigned long long queryFrames[FrameQueryCount]; // Last constant frame each query covers
+
+	/*
+		The late latched constants, a small dynamic buffer per part. Command lists reference the
+		buffer rather than its contents at the time of recording, so a WRITE_DISCARD map before
+		ExecuteCommandList is what their draws read.
+	*/
+	ID3D11Buffer* d3dLatchedConstantBuffers[LatchedConstantParts];
+
+	// Created as they are first needed.
+	RecordingContext recordingContexts[MaxRecordingContexts];
+
+	/*
+		GPU frame timing: a pair of timestamps inside a disjoint query per frame. They are read
+		back without waiting, so a few frames can be in flight; if all are, the frame goes untimed.
+	*/
+	struct GpuTimer {
+		ID3D11Query* D3DDisjoint;
+		ID3D11Query* D3DBegin;
+		ID3D11Query* D3DEnd;
+	};
+	static const int GpuTimerCount = 4;
+	GpuTimer gpuTimers[GpuTimerCount];
+	unsigned long long gpuTimersIssued;
+	unsigned long long gpuTimersRead;
+	bool gpuTimerRunning;
+	double gpuFrameTime; // Negative until the first result is back
+};
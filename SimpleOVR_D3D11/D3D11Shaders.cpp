@@ -0,0 +1,409 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+
+// Prevent windows.h from breaking std::min and std::max.
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include "D3D11Shaders.h"
+#include <windows.h>
+#include <d3dcompiler.h>
+#include <cstring>
+
+#define SHADER_STRINGIFY(x) #x
+#define SHADER_COMPILER_TAG(version) "d3dcompiler_" SHADER_STRINGIFY(version)
+
+namespace {
+	const char* VertexShaderCode =
+		"struct VS_INPUT {"
+		"	float3 coord : POSITION;"
+		"};"
+		"struct PS_INPUT {"
+		"	float4 pos : SV_Position;"
+		"};"
+		"cbuffer FrameConstants : register(b0) {"
+		"	float4x4 viewProjection;"
+		"};"
+		"cbuffer ObjectConstants : register(b1) {"
+		"	float4x4 world;"
+		"};"
+		"PS_INPUT main(VS_INPUT v) {"
+		"	PS_INPUT pi;"
+		"	pi.pos = mul(viewProjection, mul(world, float4(v.coord, 1.0)));"
+		"	return pi;"
+		"}";
+
+	/*
+		Vertex shader for StereoMode_Instanced. Instance 0 is the left eye and instance 1 the right eye.
+		The matrices already place each eye in its half of the eye texture, the clip distances make
+		sure nothing spills over into the other eye. See ComputeStereoConstants in FrameLoop.cpp.
+	*/
+	const char* StereoVertexShaderCode =
+		"struct VS_INPUT {"
+		"	float3 coord : POSITION;"
+		"};"
+		"struct PS_INPUT {"
+		"	float4 pos : SV_Position;"
+		"	float4 clip : SV_ClipDistance0;"
+		"};"
+		"cbuffer FrameConstants : register(b0) {"
+		"	float4x4 viewProjection[2];"
+		"	float4 clipRect[2];"
+		"};"
+		"cbuffer ObjectConstants : register(b1) {"
+		"	float4x4 world;"
+		"};"
+		"PS_INPUT main(VS_INPUT v, uint instance : SV_InstanceID) {"
+		"	PS_INPUT pi;"
+		"	pi.pos = mul(viewProjection[instance], mul(world, float4(v.coord, 1.0)));"
+		"	float4 r = clipRect[instance] * pi.pos.w;"
+		"	pi.clip = float4(pi.pos.x - r.x, r.y - pi.pos.x, pi.pos.y - r.z, r.w - pi.pos.y);"
+		"	return pi;"
+		"}";
+
+	// The material's color, see MaterialColors in RenderDevice.h.
+	const char* PixelShaderCode =
+		"struct PS_INPUT {"
+		"	float4 pos : SV_Position;"
+		"};"
+		"cbuffer MaterialConstants : register(b0) {"
+		"	float4 color;"
+		"};"
+		"float4 main(PS_INPUT pi) :SV_Target{"
+		"	return color;"
+		"}";
+
+	/*
+		The foveated composite. One instance per region, the quad's corners made up from the vertex
+		ID, so it needs no vertex buffer. The source coordinates are clamped half a texel inside the
+		region, as linear filtering would otherwise blend in its neighbours in the foveated target.
+	*/
+	const char* CompositeShaderCode =
+		"cbuffer CompositeConstants : register(b0) {"
+		"	float4 destination[18];" // Left, top, right and bottom in the eye texture's NDC
+		"	float4 source[18];" // The same in the foveated target's texture coordinates
+		"	float4 sourceClamp[18];"
+		"	float4 tint[18];"
+		"};"
+		"struct PS_INPUT {"
+		"	float4 pos : SV_Position;"
+		"	float2 uv : TEXCOORD0;"
+		"	nointerpolation uint region : REGION;"
+		"};"
+		"Texture2D foveatedTarget : register(t0);"
+		"SamplerState linearClamp : register(s0);"
+		"PS_INPUT VSMain(uint vertex : SV_VertexID, uint region : SV_InstanceID) {"
+		"	float2 corner = float2(vertex & 1, vertex >> 1);"
+		"	PS_INPUT pi;"
+		"	pi.pos = float4(lerp(destination[region].xy, destination[region].zw, corner), 0, 1);"
+		"	pi.uv = lerp(source[region].xy, source[region].zw, corner);"
+		"	pi.region = region;"
+		"	return pi;"
+		"}"
+		"float4 PSMain(PS_INPUT pi) : SV_Target {"
+		"	float2 uv = clamp(pi.uv, sourceClamp[pi.region].xy, sourceClamp[pi.region].zw);"
+		"	return foveatedTarget.Sample(linearClamp, uv) * tint[pi.region];"
+		"}";
+
+	/*
+		GPU driven drawing. The instances are SceneInstances (RenderDevice.h) in a structured
+		buffer. The cull shader tests each one's bounds against the frustum's planes and, if it is
+		visible, counts it into its mesh's draw arguments and lists it in that mesh's part of the
+		visible instances, as CullInstances (InstanceCulling.h) does on the CPU.
+	*/
+	const char* CullShaderCode =
+		"struct Instance {"
+		"	float4x4 world;"
+		"	float4 bounds;"
+		"	uint mesh;"
+		"	uint material;"
+		"	uint2 padding;"
+		"};"
+		"cbuffer CullConstants : register(b0) {"
+		"	float4 planes[6];"
+		"	uint instanceCount;"
+		"	uint instanceMultiplier;"
+		"};"
+		"StructuredBuffer<Instance> instances : register(t0);"
+		"StructuredBuffer<uint4> meshDraws : register(t1);"
+		"RWByteAddressBuffer draws : register(u0);"
+		"RWBuffer<uint> visible : register(u1);"
+		"[numthreads(64, 1, 1)]"
+		"void main(uint3 thread : SV_DispatchThreadID) {"
+		"	if (thread.x >= instanceCount) {"
+		"		return;"
+		"	}"
+		"	Instance instance = instances[thread.x];"
+		"	uint4 meshDraw = meshDraws[instance.mesh];"
+		"	if (meshDraw.x == 0) {"
+		"		return;"
+		"	}"
+		"	for (int i = 0; i < 6; i++) {"
+		"		if (dot(planes[i].xyz, instance.bounds.xyz) + planes[i].w < -instance.bounds.w) {"
+		"			return;"
+		"		}"
+		"	}"
+		"	uint listed;"
+		"	draws.InterlockedAdd(instance.mesh * 16 + 4, instanceMultiplier, listed);"
+		"	visible[meshDraw.w + listed / instanceMultiplier] = thread.x;"
+		"}";
+
+	/*
+		Drawing the culled instances. The visible instances are also the per-instance vertex
+		buffer, whose part for the mesh StartInstanceLocation selects: SV_InstanceID always starts
+		at 0, the element fetched doesn't. With STEREO each instance is drawn twice (the input
+		layout steps through the list at half the rate), instance 0 and 1 being the eyes as in the
+		stereo vertex shader. The material colors take the place of the object constants.
+	*/
+	const char* InstanceShaderCode =
+		"struct Instance {"
+		"	float4x4 world;"
+		"	float4 bounds;"
+		"	uint mesh;"
+		"	uint material;"
+		"	uint2 padding;"
+		"};"
+		"StructuredBuffer<Instance> instances : register(t0);"
+		"cbuffer MaterialColors : register(b1) {"
+		"	float4 colors[16];" // MaxMaterials
+		"};"
+		"struct VS_INPUT {"
+		"	float3 coord : POSITION;"
+		"	uint instance : INSTANCE;"
+		"};"
+		"struct PS_INPUT {"
+		"	float4 pos : SV_Position;"
+		"	nointerpolation float4 color : COLOR;"
+		"\n#ifdef STEREO\n"
+		"	float4 clip : SV_ClipDistance0;"
+		"\n#endif\n"
+		"};"
+		"\n#ifdef STEREO\n"
+		"cbuffer FrameConstants : register(b0) {"
+		"	float4x4 viewProjection[2];"
+		"	float4 clipRect[2];"
+		"};"
+		"PS_INPUT VSMain(VS_INPUT v, uint instance : SV_InstanceID) {"
+		"	uint eye = instance & 1;"
+		"	PS_INPUT pi;"
+		"	pi.pos = mul(viewProjection[eye], mul(instances[v.instance].world, float4(v.coord, 1.0)));"
+		"	pi.color = colors[instances[v.instance].material];"
+		"	float4 r = clipRect[eye] * pi.pos.w;"
+		"	pi.clip = float4(pi.pos.x - r.x, r.y - pi.pos.x, pi.pos.y - r.z, r.w - pi.pos.y);"
+		"	return pi;"
+		"}"
+		"\n#else\n"
+		"cbuffer FrameConstants : register(b0) {"
+		"	float4x4 viewProjection;"
+		"};"
+		"PS_INPUT VSMain(VS_INPUT v) {"
+		"	PS_INPUT pi;"
+		"	pi.pos = mul(viewProjection, mul(instances[v.instance].world, float4(v.coord, 1.0)));"
+		"	pi.color = colors[instances[v.instance].material];"
+		"	return pi;"
+		"}"
+		"\n#endif\n"
+		"float4 PSMain(PS_INPUT pi) : SV_Target {"
+		"	return pi.color;"
+		"}";
+
+	/*
+		Own distortion, see Distortion.h. The vertex shader timewarps each color's direction and
+		turns it into texture coordinates like WarpDistortionPoint, the pixel shader looks each
+		color up at its own coordinates. The tangents come in as snorm, divided by
+		DistortionTanAngleRange. With FUSED_RESOLVE the eye texture is multisampled and filtered
+		by hand, each of the four texels the average of its samples, like DrawDistortionMeshes.
+	*/
+	const char* DistortionShaderCode =
+		"cbuffer DistortionConstants : register(b0) {"
+		"	float4x4 timewarpStart;"
+		"	float4x4 timewarpEnd;"
+		"	float4 uvScaleOffset;"
+		"};"
+		"struct VS_INPUT {"
+		"	float2 pos : POSITION;"
+		"	float2 tanRed : TEXCOORD0;"
+		"	float2 tanGreen : TEXCOORD1;"
+		"	float2 tanBlue : TEXCOORD2;"
+		"	float4 factors : COLOR0;" // Timewarp factor and vignette
+		"};"
+		"struct PS_INPUT {"
+		"	float4 pos : SV_Position;"
+		"	float2 uvRed : TEXCOORD0;"
+		"	float2 uvGreen : TEXCOORD1;"
+		"	float2 uvBlue : TEXCOORD2;"
+		"	float vignette : VIGNETTE;"
+		"};"
+		"float2 Warp(float2 tan, float factor) {"
+		"	float3 direction = float3(tan * 4.0, -1.0);"
+		"	float3 start = mul((float3x3)timewarpStart, direction);"
+		"	float3 end = mul((float3x3)timewarpEnd, direction);"
+		"	float3 warped = lerp(start, end, factor);"
+		"	return warped.xy / -warped.z * uvScaleOffset.xy + uvScaleOffset.zw;"
+		"}"
+		"PS_INPUT VSMain(VS_INPUT v) {"
+		"	PS_INPUT pi;"
+		"	pi.pos = float4(v.pos, 0.5, 1.0);"
+		"	pi.uvRed = Warp(v.tanRed, v.factors.x);"
+		"	pi.uvGreen = Warp(v.tanGreen, v.factors.x);"
+		"	pi.uvBlue = Warp(v.tanBlue, v.factors.x);"
+		"	pi.vignette = v.factors.y;"
+		"	return pi;"
+		"}"
+		"\n#ifdef FUSED_RESOLVE\n"
+		"Texture2DMS<float4> eyeTexture : register(t0);"
+		"float4 Fetch(int2 texel, uint samples) {"
+		"	float4 sum = 0.0;"
+		"	for (uint s = 0; s < samples; s++) {"
+		"		sum += eyeTexture.Load(texel, s);"
+		"	}"
+		"	return sum;"
+		"}"
+		"float4 SampleEye(float2 uv) {"
+		"	uint width, height, samples;"
+		"	eyeTexture.GetDimensions(width, height, samples);"
+		"	float2 last = float2(width - 1, height - 1);"
+		"	float2 texel = clamp(uv * float2(width, height) - 0.5, 0.0, last);"
+		"	int2 t0 = int2(texel);"
+		"	int2 t1 = int2(min(t0 + 1, last));"
+		"	float2 f = texel - t0;"
+		"	float4 top = lerp(Fetch(t0, samples), Fetch(int2(t1.x, t0.y), samples), f.x);"
+		"	float4 bottom = lerp(Fetch(int2(t0.x, t1.y), samples), Fetch(t1, samples), f.x);"
+		"	return lerp(top, bottom, f.y) / samples;"
+		"}"
+		"\n#else\n"
+		"Texture2D eyeTexture : register(t0);"
+		"SamplerState linearClamp : register(s0);"
+		"float4 SampleEye(float2 uv) {"
+		"	return eyeTexture.Sample(linearClamp, uv);"
+		"}"
+		"\n#endif\n"
+		"float4 PSMain(PS_INPUT pi) : SV_Target {"
+		"	float red = SampleEye(pi.uvRed).r;"
+		"	float green = SampleEye(pi.uvGreen).g;"
+		"	float blue = SampleEye(pi.uvBlue).b;"
+		"	return float4(float3(red, green, blue) * pi.vignette, 1.0);"
+		"}";
+
+	// The hidden area mask, drawn at the near plane into the depth buffer only, with no pixel shader.
+	const char* HiddenAreaShaderCode =
+		"float4 main(float2 pos : POSITION) : SV_Position {"
+		"	return float4(pos, 0.0, 1.0);"
+		"}";
+
+	// Shader models 4.0 work on every D3D11 GPU, GPU driven drawing needs 5.0 (feature level 11_0).
+	// The fused resolve needs 4.1 for the sample count, which the device asks for at least.
+	const ShaderKey ShaderKeys[ShaderCount] = {
+		{ VertexShaderCode, "main", "vs_4_0", nullptr, 0 },
+		{ StereoVertexShaderCode, "main", "vs_4_0", nullptr, 0 },
+		{ PixelShaderCode, "main", "ps_4_0", nullptr, 0 },
+		{ CompositeShaderCode, "VSMain", "vs_4_0", nullptr, 0 },
+		{ CompositeShaderCode, "PSMain", "ps_4_0", nullptr, 0 },
+		{ InstanceShaderCode, "VSMain", "vs_5_0", nullptr, 0 },
+		{ InstanceShaderCode, "VSMain", "vs_5_0", "STEREO", 0 },
+		{ InstanceShaderCode, "PSMain", "ps_5_0", nullptr, 0 },
+		{ CullShaderCode, "main", "cs_5_0", nullptr, 0 },
+		{ DistortionShaderCode, "VSMain", "vs_4_0", nullptr, 0 },
+		{ DistortionShaderCode, "PSMain", "ps_4_0", nullptr, 0 },
+		{ DistortionShaderCode, "PSMain", "ps_4_1", "FUSED_RESOLVE", 0 },
+		{ HiddenAreaShaderCode, "main", "vs_4_0", nullptr, 0 },
+	};
+
+	const char* CompilerTag = SHADER_COMPILER_TAG(D3D_COMPILER_VERSION);
+}
+
+ShaderKey GetShaderKey(Shader shader) {
+	return ShaderKeys[shader];
+}
+
+const char* GetShaderCompilerTag() {
+	return CompilerTag;
+}
+
+bool CompileShader(const ShaderKey& key, std::vector<unsigned char>& outBytecode) {
+	// "A=1;B=2" into the null terminated macro array D3DCompile wants.
+	std::string defines = key.Defines != nullptr ? key.Defines : "";
+	std::vector<D3D_SHADER_MACRO> macros;
+	size_t start = 0;
+	while (start < defines.size()) {
+		size_t end = defines.find(';', start);
+		if (end == std::string::npos) {
+			end = defines.size();
+		}
+		else {
+			defines[end] = '\0';
+		}
+		if (end > start) {
+			D3D_SHADER_MACRO macro = { &defines[start], "1" };
+			size_t equals = defines.find('=', start);
+			if (equals < end) {
+				defines[equals] = '\0';
+				macro.Definition = &defines[equals + 1];
+			}
+			macros.push_back(macro);
+		}
+		start = end + 1;
+	}
+	D3D_SHADER_MACRO terminator = { nullptr, nullptr };
+	macros.push_back(terminator);
+
+	ID3DBlob* d3dBlob = nullptr;
+	ID3DBlob* d3dErrors = nullptr;
+	HRESULT result = D3DCompile(key.Source, strlen(key.Source), nullptr, macros.data(), nullptr, key.EntryPoint, key.Profile, key.Flags, 0, &d3dBlob, &d3dErrors);
+	if (d3dErrors != nullptr) {
+		OutputDebugStringA(static_cast<const char*>(d3dErrors->GetBufferPointer()));
+		d3dErrors->Release();
+	}
+	if (FAILED(result)) {
+		return false;
+	}
+	const unsigned char* bytecode = static_cast<const unsigned char*>(d3dBlob->GetBufferPointer());
+	outBytecode.assign(bytecode, bytecode + d3dBlob->GetBufferSize());
+	d3dBlob->Release();
+	return true;
+}
+
+std::string GetDefaultShaderCacheDirectory() {
+	char path[MAX_PATH];
+	DWORD length = GetModuleFileNameA(nullptr, path, MAX_PATH);
+	std::string directory(path, length);
+	size_t separator = directory.find_last_of("\\/");
+	directory.resize(separator == std::string::npos ? 0 : separator + 1);
+	return directory + "ShaderCache";
+}
+
+bool PrecompileShaders(ShaderCache& cache) {
+	bool compiled = true;
+	for (int shader = 0; shader < ShaderCount; shader++) {
+		ShaderBytecode bytecode;
+		if (!cache.GetOrCompile(ShaderKeys[shader], CompileShader, bytecode)) {
+			compiled = false;
+		}
+	}
+	return compiled;
+}
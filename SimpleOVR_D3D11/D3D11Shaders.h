@@ -0,0 +1,70 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+
+#pragma once
+
+#include "ShaderCache.h"
+#include <string>
+#include <vector>
+
+/*
+	The sample's HLSL. Shaders are looked up in a ShaderCache and only compiled with D3DCompile
+	if they aren't there, so a start with a warm cache compiles nothing. The build warms it: the
+	project's post-build step runs the sample with --precompile-shaders, which compiles every
+	shader into the cache next to the executable and exits.
+*/
+enum Shader {
+	Shader_SceneVertex,
+	Shader_StereoVertex, // For StereoMode_Instanced
+	Shader_ScenePixel,
+	Shader_CompositeVertex,
+	Shader_CompositePixel,
+	Shader_InstanceVertex, // GPU driven drawing, see D3D11RenderDevice::CullSceneInstances
+	Shader_StereoInstanceVertex,
+	Shader_InstancePixel,
+	Shader_CullCompute,
+	Shader_DistortionVertex, // Own distortion, see D3D11RenderDevice::PresentDistorted
+	Shader_DistortionPixel,
+	Shader_DistortionResolvePixel, // Samples the multisampled eye texture, see SetFusedResolve
+	Shader_HiddenAreaVertex, // See D3D11RenderDevice::SetHiddenAreaMesh
+	ShaderCount
+};
+
+ShaderKey GetShaderKey(Shader shader);
+
+// Identifies the compiler in the cache, so bytecode of another version isn't used.
+const char* GetShaderCompilerTag();
+
+// D3DCompile, for ShaderCache::GetOrCompile.
+bool CompileShader(const ShaderKey& key, std::vector<unsigned char>& outBytecode);
+
+// The ShaderCache directory next to the executable.
+std::string GetDefaultShaderCacheDirectory();
+
+// Makes sure every shader is in the cache. Returns false if any failed to compile.
+bool PrecompileShaders(ShaderCache& cache);
@@ -0,0 +1,222 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#include "OvrHmd.h"
+#include <cstring>
+
+namespace {
+	// The types in VrTypes.h have the same layout as their LibOVR counterparts, these just spell out
+	// the conversions.
+	FovPort FromOvr(const ovrFovPort& fov) {
+		FovPort r = { fov.UpTan, fov.DownTan, fov.LeftTan, fov.RightTan };
+		return r;
+	}
+
+	ovrFovPort ToOvr(const FovPort& fov) {
+		ovrFovPort r = { fov.UpTan, fov.DownTan, fov.LeftTan, fov.RightTan };
+		return r;
+	}
+
+	Vector3 FromOvr(const ovrVector3f& v) {
+		Vector3 r = { v.x, v.y, v.z };
+		return r;
+	}
+
+	ovrVector3f ToOvr(const Vector3& v) {
+		ovrVector3f r = { v.x, v.y, v.z };
+		return r;
+	}
+
+	Pose FromOvr(const ovrPosef& pose) {
+		Pose r;
+		r.Orientation.x = pose.Orientation.x;
+		r.Orientation.y = pose.Orientation.y;
+		r.Orientation.z = pose.Orientation.z;
+		r.Orientation.w = pose.Orientation.w;
+		r.Position = FromOvr(pose.Position);
+		return r;
+	}
+
+	PoseState FromOvr(const ovrPoseStatef& state) {
+		PoseState r;
+		r.ThePose = FromOvr(state.ThePose);
+		r.AngularVelocity = FromOvr(state.AngularVelocity);
+		r.LinearVelocity = FromOvr(state.LinearVelocity);
+		r.AngularAcceleration = FromOvr(state.AngularAcceleration);
+		r.LinearAcceleration = FromOvr(state.LinearAcceleration);
+		r.TimeInSeconds = state.TimeInSeconds;
+		return r;
+	}
+
+	ovrPosef ToOvr(const Pose& pose) {
+		ovrPosef r;
+		r.Orientation.x = pose.Orientation.x;
+		r.Orientation.y = pose.Orientation.y;
+		r.Orientation.z = pose.Orientation.z;
+		r.Orientation.w = pose.Orientation.w;
+		r.Position = ToOvr(pose.Position);
+		return r;
+	}
+}
+
+OvrHmd::OvrHmd(ovrHmd hmd) : hmd(hmd), ownDistortion(false) {
+	std::memset(eyeRenderDesc, 0, sizeof(eyeRenderDesc));
+	std::memset(eyeTexture, 0, sizeof(eyeTexture));
+	std::memset(&frameTiming, 0, sizeof(frameTiming));
+}
+
+ovrHmd OvrHmd::GetHandle() const {
+	return hmd;
+}
+
+bool OvrHmd::ConfigureRendering(const ovrRenderAPIConfig* config, unsigned int distortionCaps, const FovPort eyeFov[EyeCount], const ovrTexture eyeTexture[EyeCount]) {
+	ovrFovPort vrEyeFov[EyeCount] = { ToOvr(eyeFov[0]), ToOvr(eyeFov[1]) };
+	this->eyeTexture[0] = eyeTexture[0];
+	this->eyeTexture[1] = eyeTexture[1];
+	return ovrHmd_ConfigureRendering(hmd, config, distortionCaps, vrEyeFov, eyeRenderDesc) != 0;
+}
+
+void OvrHmd::ConfigureOwnDistortion(const FovPort eyeFov[EyeCount]) {
+	for (int eye = 0; eye < EyeCount; eye++) {
+		eyeRenderDesc[eye] = ovrHmd_GetRenderDesc(hmd, static_cast<ovrEyeType>(eye), ToOvr(eyeFov[eye]));
+	}
+	ownDistortion = true;
+}
+
+Size2i OvrHmd::GetResolution() const {
+	Size2i r = { hmd->Resolution.w, hmd->Resolution.h };
+	return r;
+}
+
+double OvrHmd::GetRefreshRate() const {
+	// LibOVR 0.4.3 doesn't tell, but the DK2 is the only HMD it drives in Direct mode.
+	return 75.0;
+}
+
+FovPort OvrHmd::GetDefaultEyeFov(int eye) const {
+	return FromOvr(hmd->DefaultEyeFov[eye]);
+}
+
+int OvrHmd::GetEyeRenderOrder(int index) const {
+	return hmd->EyeRenderOrder[index];
+}
+
+Size2i OvrHmd::GetFovTextureSize(int eye, const FovPort& fov, float pixelsPerDisplayPixel) const {
+	auto size = ovrHmd_GetFovTextureSize(hmd, static_cast<ovrEyeType>(eye), ToOvr(fov), pixelsPerDisplayPixel);
+	Size2i r = { size.w, size.h };
+	return r;
+}
+
+EyeRenderDesc OvrHmd::GetEyeRenderDesc(int eye) const {
+	EyeRenderDesc r;
+	r.Fov = FromOvr(eyeRenderDesc[eye].Fov);
+	r.HmdToEyeViewOffset = FromOvr(eyeRenderDesc[eye].HmdToEyeViewOffset);
+	return r;
+}
+
+void OvrHmd::SetEyeRenderViewport(int eye, const Rect2i& viewport) {
+	// Read by ovrHmd_EndFrame, so the distortion samples the right part of the texture.
+	eyeTexture[eye].Header.RenderViewport.Pos.x = viewport.Pos.x;
+	eyeTexture[eye].Header.RenderViewport.Pos.y = viewport.Pos.y;
+	eyeTexture[eye].Header.RenderViewport.Size.w = viewport.Size.w;
+	eyeTexture[eye].Header.RenderViewport.Size.h = viewport.Size.h;
+}
+
+bool OvrHmd::GetDistortionMesh(int eye, const FovPort& fov, std::vector<DistortionPoint>& outPoints, std::vector<unsigned short>& outIndices) const {
+	ovrDistortionMesh mesh;
+	unsigned int distortionCaps = ovrDistortionCap_Chromatic | ovrDistortionCap_TimeWarp | ovrDistortionCap_Vignette;
+	if (!ovrHmd_CreateDistortionMesh(hmd, static_cast<ovrEyeType>(eye), ToOvr(fov), distortionCaps, &mesh)) {
+		return false;
+	}
+
+	// LibOVR's tangents have +y down, ours up.
+	outPoints.resize(mesh.VertexCount);
+	for (unsigned int i = 0; i < mesh.VertexCount; i++) {
+		const ovrDistortionVertex& vertex = mesh.pVertexData[i];
+		DistortionPoint& point = outPoints[i];
+		point.ScreenPosNdc[0] = vertex.ScreenPosNDC.x;
+		point.ScreenPosNdc[1] = vertex.ScreenPosNDC.y;
+		point.TimewarpFactor = vertex.TimeWarpFactor;
+		point.Vignette = vertex.VignetteFactor;
+		const ovrVector2f* angles[3] = { &vertex.TanEyeAnglesR, &vertex.TanEyeAnglesG, &vertex.TanEyeAnglesB };
+		for (int color = 0; color < 3; color++) {
+			point.TanEyeAngles[color][0] = angles[color]->x;
+			point.TanEyeAngles[color][1] = -angles[color]->y;
+		}
+	}
+	outIndices.assign(mesh.pIndexData, mesh.pIndexData + mesh.IndexCount);
+	ovrHmd_DestroyDistortionMesh(&mesh);
+	return true;
+}
+
+void OvrHmd::RecenterPose() {
+	ovrHmd_RecenterPose(hmd);
+}
+
+void OvrHmd::BeginFrame(unsigned int frameIndex) {
+	frameTiming = ownDistortion ? ovrHmd_BeginFrameTiming(hmd, frameIndex) : ovrHmd_BeginFrame(hmd, frameIndex);
+}
+
+FrameTiming OvrHmd::GetFrameTiming() const {
+	FrameTiming r = { frameTiming.ThisFrameSeconds, frameTiming.ScanoutMidpointSeconds };
+	return r;
+}
+
+void OvrHmd::GetEyePoses(unsigned int frameIndex, const Vector3 hmdToEyeViewOffset[EyeCount], Pose outEyePoses[EyeCount]) {
+	ovrVector3f vrHmdToEyeViewOffset[EyeCount] = { ToOvr(hmdToEyeViewOffset[0]), ToOvr(hmdToEyeViewOffset[1]) };
+	ovrPosef vrEyeRenderPose[EyeCount];
+	ovrTrackingState hmdTrackingState;
+	ovrHmd_GetEyePoses(hmd, frameIndex, vrHmdToEyeViewOffset, vrEyeRenderPose, &hmdTrackingState);
+	outEyePoses[0] = FromOvr(vrEyeRenderPose[0]);
+	outEyePoses[1] = FromOvr(vrEyeRenderPose[1]);
+}
+
+PoseState OvrHmd::GetTrackingState() {
+	// Asking for the state as of now brings the latest sensor sample up to now, and no further.
+	ovrTrackingState hmdTrackingState = ovrHmd_GetTrackingState(hmd, ovr_GetTimeInSeconds());
+	return FromOvr(hmdTrackingState.HeadPose);
+}
+
+void OvrHmd::EndFrame(const Pose renderPose[EyeCount]) {
+	if (ownDistortion) {
+		// The frame has been presented already.
+		ovrHmd_EndFrameTiming(hmd);
+		return;
+	}
+
+	ovrPosef vrEyeRenderPose[EyeCount] = { ToOvr(renderPose[0]), ToOvr(renderPose[1]) };
+
+	/*
+		Finish the current frame and send it to the HMD. swapChain->Present is called
+		automatically inside this function.
+	*/
+	ovrHmd_EndFrame(hmd, vrEyeRenderPose, eyeTexture);
+}
+
+double OvrPacingClock::GetTime() {
+	return ovr_GetTimeInSeconds();
+}
@@ -0,0 +1,87 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#pragma once
+
+#include <OVR.h>
+#include "FrameScheduler.h"
+#include "Hmd.h"
+
+/*
+	Hmd implementation on top of LibOVR. The frame loop only sees the Hmd interface, anything
+	specific to LibOVR (attaching to the window, dismissing the health warning and so on) is done
+	through GetHandle().
+*/
+class OvrHmd : public Hmd {
+public:
+	explicit OvrHmd(ovrHmd hmd);
+
+	ovrHmd GetHandle() const;
+
+	/*
+		Wraps ovrHmd_ConfigureRendering. The eye textures are remembered and handed to
+		ovrHmd_EndFrame every frame.
+	*/
+	bool ConfigureRendering(const ovrRenderAPIConfig* config, unsigned int distortionCaps, const FovPort eyeFov[EyeCount], const ovrTexture eyeTexture[EyeCount]);
+
+	/*
+		Instead of ConfigureRendering, when the application distorts the frames itself (see
+		Distortion.h). LibOVR then only times the frames: BeginFrame and EndFrame wrap
+		ovrHmd_BeginFrameTiming and ovrHmd_EndFrameTiming, and presenting is up to the application.
+	*/
+	void ConfigureOwnDistortion(const FovPort eyeFov[EyeCount]);
+
+	Size2i GetResolution() const;
+	double GetRefreshRate() const;
+	FovPort GetDefaultEyeFov(int eye) const;
+	int GetEyeRenderOrder(int index) const;
+	Size2i GetFovTextureSize(int eye, const FovPort& fov, float pixelsPerDisplayPixel) const;
+	EyeRenderDesc GetEyeRenderDesc(int eye) const;
+	void SetEyeRenderViewport(int eye, const Rect2i& viewport);
+	bool GetDistortionMesh(int eye, const FovPort& fov, std::vector<DistortionPoint>& outPoints, std::vector<unsigned short>& outIndices) const;
+
+	void RecenterPose();
+
+	void BeginFrame(unsigned int frameIndex);
+	FrameTiming GetFrameTiming() const;
+	void GetEyePoses(unsigned int frameIndex, const Vector3 hmdToEyeViewOffset[EyeCount], Pose outEyePoses[EyeCount]);
+	PoseState GetTrackingState();
+	void EndFrame(const Pose renderPose[EyeCount]);
+
+private:
+	ovrHmd hmd;
+	ovrEyeRenderDesc eyeRenderDesc[EyeCount];
+	ovrTexture eyeTexture[EyeCount];
+	ovrFrameTiming frameTiming; // From ovrHmd_BeginFrame
+	bool ownDistortion;
+};
+
+// Paces by LibOVR's clock, which the frame timing is given in.
+class OvrPacingClock : public SystemPacingClock {
+public:
+	double GetTime();
+};
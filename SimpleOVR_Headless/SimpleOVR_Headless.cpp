@@ -0,0 +1,639 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+/*
+	Runs the frame loop of the sample without a headset or a GPU, using SimulatedHmd and
+	NullRenderDevice. The simulated HMD is driven by a scripted pose stream, so every run renders
+	exactly the same frames and the CPU cost per frame can be profiled and compared between runs.
+
+	https://github.com/poppeman/SimpleOVR
+
+	Building:
+
+	Visual Studio 2013:
+		Build the SimpleOVR_Headless project. It does not need LibOVR.
+
+	Linux (or anything else with a C++11 compiler):
+		g++ -std=c++11 -O2 -pthread -I../SimpleOVR_Common -o SimpleOVR_Headless SimpleOVR_Headless.cpp ../SimpleOVR_Common/[A-Z]*.cpp
+
+	Usage:
+		SimpleOVR_Headless [--frames N] [--pose-script FILE] [--stereo multipass|instanced] [--mesh-file FILE] [--stream] [--objects N] [--materials N] [--threads N] [--gpu-driven] [--late-latch] [--predict none|velocity|acceleration|filtered] [--record-tracking FILE] [--paced reproject|drop] [--adaptive-resolution] [--foveation CENTER,DENSITY] [--own-distortion] [--timewarp] [--fused-resolve] [--hidden-area] [--capture FILE] [--software] [--write-image FILE] [--compare-image FILE] [--profile-csv FILE] [--profile-json FILE]
+
+	Without --objects the scene is the sample's single triangle. With it, N objects using the
+	meshes of --mesh-file (or the triangle) are scattered around the viewer, always the same way,
+	so culling and per-object costs can be measured with a realistic amount of objects.
+
+	--materials gives the scattered objects one of the first N materials each (1 by default), so the
+	draws have state to sort by. The State line shows how many state changes that took and how
+	many of the calls the device filtered as redundant.
+
+	--stream loads --mesh-file with ResourceStreamer instead of all at once before the first frame.
+	The objects are scattered as soon as the file's meshes are known and each shows up once its
+	mesh is resident, with at most StreamingBytesPerFrame uploaded per frame.
+
+	--threads sets how many threads (this one included) cull and record, 1 by default.
+
+	--gpu-driven has the device cull and draw the scene from the instances it was given, see
+	RenderDevice::SetSceneInstances, the way a GPU would with a compute pass and indirect draws.
+	NullRenderDevice runs the same cull on the CPU. The GPU line shows what the device did.
+
+	--late-latch samples the pose again after recording the frame and draws with that one, see
+	RenderFrame. The PoseToSubmit line of the timings shows how old the pose is on submission.
+
+	--predict has the frame loop predict the eye poses with PosePredictor instead of leaving it to
+	the HMD, see PosePrediction.h. --record-tracking writes the frames' timing, the tracking
+	states and the poses the frames were drawn with to FILE, see TrackingLog.h, which
+	SimpleOVR_PoseReplay replays. The simulated HMD predicts perfectly, so what can be learned
+	from its logs is how much worse the predictors are on the same head motion.
+
+	--paced runs the frame loop on a render thread of its own, paced in real time to the simulated
+	HMD's vsyncs, while this thread publishes simulation states at SimulationRate, see
+	FrameScheduler.h. Frames too late for the next vsync are reprojected or dropped, see
+	FramePacer.h. The Pacing line counts the deadlines missed and shows the jitter.
+
+	--adaptive-resolution lets ResolutionController scale the eye viewports. There is no GPU here,
+	so it goes by the CPU time of the frames, which doesn't depend on the resolution. With
+	--software it goes by the time spent rasterizing, which does.
+
+	--foveation renders the center CENTER (0 to 1) of each eye at full density and the rest at
+	DENSITY, see FoveatedLayout.h, and prints the regions and how many pixels that saves.
+
+	--own-distortion distorts the frames with the simulated HMD's distortion meshes on the device,
+	see Distortion.h, and --timewarp (which implies it) rotates them to the latest head pose too.
+	The Distortion line shows the meshes' size. With --software the display image is drawn, and
+	it is what --write-image and --compare-image use. --fused-resolve (which implies
+	--own-distortion) has the distortion resolve the multisampled eye texture itself, see
+	RenderDevice::SetFusedResolve; the Eye texture traffic line and the render targets show what
+	that saves.
+
+	--hidden-area masks the parts of the eye viewports the lens never shows out of the depth
+	buffer and the clears, see HiddenArea.h. The Hidden area line shows how much of each eye that
+	is and how many pixels were masked per frame. Not with --foveation.
+
+	--capture writes every command the frame loop gives the device to FILE, frame by frame, see
+	CommandCapture.h, which SimpleOVR_CommandReplay replays on any device. The Capture line shows
+	how big the frames were.
+
+	--software draws the frames with SoftwareRenderDevice instead of NullRenderDevice. The GPU time
+	is then the time spent rasterizing. --write-image saves the last frame's eye texture as PPM,
+	--compare-image compares it with a saved one and fails if any pixel differs; both imply
+	--software.
+
+	The per-stage timings (see Profiler.h) are printed on exit and optionally written as CSV/JSON.
+*/
+
+#include "Clock.h"
+#include "CommandCapture.h"
+#include "FrameGraph.h"
+#include "FrameLoop.h"
+#include "NullRenderDevice.h"
+#include "Profiler.h"
+#include "ResourceStreamer.h"
+#include "SimulatedHmd.h"
+#include "SoftwareRenderDevice.h"
+#include "VrMath.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+
+// Same settings as the D3D11 sample.
+const float PixelsPerDisplayPixel = 1.0f;
+const int MultisampleCount = 4;
+
+// For --paced. There is nothing to simulate really, the states only carry the time.
+const double SimulationRate = 1000.0;
+
+// For --stream.
+const int StreamingThreads = 2;
+const unsigned int StreamingStagingCapacity = 1024 * 1024;
+const unsigned int StreamingBytesPerFrame = 256 * 1024;
+
+namespace {
+	// Radius of the area around the viewer that --objects fills.
+	const float ScatterRadius = 50.0f;
+
+	// Fixed seed linear congruential generator, rand() differs between platforms.
+	float NextRandom(unsigned int& state) {
+		state = state * 1664525u + 1013904223u;
+		return (state >> 8) * (1.0f / 16777216.0f);
+	}
+
+	// Uses meshes firstMesh to firstMesh + meshCount - 1 and materials 0 to materialCount - 1.
+	void ScatterObjects(Scene& scene, unsigned int count, int firstMesh, int meshCount, int materialCount) {
+		unsigned int state = 12345;
+		unsigned int materialState = 54321; // Apart, so the objects are where they always were
+		const Vector3 up = { 0.0f, 1.0f, 0.0f };
+		for (unsigned int i = 0; i < count; i++) {
+			int mesh = firstMesh + static_cast<int>(NextRandom(state) * meshCount) % meshCount;
+			Vector3 position = {
+				(NextRandom(state) * 2.0f - 1.0f) * ScatterRadius,
+				(NextRandom(state) * 2.0f - 1.0f) * ScatterRadius * 0.2f,
+				(NextRandom(state) * 2.0f - 1.0f) * ScatterRadius
+			};
+			Quaternion orientation = QuaternionFromAxisAngle(up, NextRandom(state) * 6.2831853f);
+			unsigned int object = scene.AddObject(mesh, position, orientation, 0.5f + NextRandom(state));
+			scene.SetObjectMaterial(object, static_cast<int>(NextRandom(materialState) * materialCount) % materialCount);
+		}
+	}
+
+	void PrintUsage(const char* program) {
+		std::fprintf(stderr, "Usage: %s [--frames N] [--pose-script FILE] [--stereo multipass|instanced] [--mesh-file FILE] [--stream] [--objects N] [--materials N] [--threads N] [--gpu-driven] [--late-latch] [--predict none|velocity|acceleration|filtered] [--record-tracking FILE] [--paced reproject|drop] [--adaptive-resolution] [--foveation CENTER,DENSITY] [--own-distortion] [--timewarp] [--fused-resolve] [--hidden-area] [--capture FILE] [--software] [--write-image FILE] [--compare-image FILE] [--profile-csv FILE] [--profile-json FILE]\n", program);
+	}
+}
+
+int main(int argc, char* argv[]) {
+	unsigned int frameCount = 1000;
+	const char* profileCsvPath = nullptr;
+	const char* profileJsonPath = nullptr;
+	StereoMode stereoMode = StereoMode_MultiPass;
+	PoseScript poseScript;
+	Scene scene;
+	const char* meshFilePath = nullptr;
+	bool stream = false;
+	unsigned int objectCount = 0;
+	int materialCount = 1;
+	int threadCount = 1;
+	bool gpuDriven = false;
+	bool lateLatch = false;
+	bool ownPrediction = false;
+	PredictionMethod predictionMethod = PredictionMethod_ConstantVelocity;
+	const char* trackingLogPath = nullptr;
+	bool paced = false;
+	LateFramePolicy lateFramePolicy = LateFramePolicy_Reproject;
+	bool adaptiveResolution = false;
+	bool foveated = false;
+	FoveationSettings foveation = GetDefaultFoveationSettings();
+	bool ownDistortion = false;
+	bool timewarp = false;
+	bool fusedResolve = false;
+	bool hiddenArea = false;
+	const char* capturePath = nullptr;
+	bool software = false;
+	const char* writeImagePath = nullptr;
+	const char* compareImagePath = nullptr;
+
+	for (int i = 1; i < argc; i++) {
+		if (std::strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+			frameCount = static_cast<unsigned int>(std::strtoul(argv[++i], nullptr, 10));
+		}
+		else if (std::strcmp(argv[i], "--pose-script") == 0 && i + 1 < argc) {
+			if (!poseScript.LoadFromFile(argv[++i])) {
+				std::fprintf(stderr, "Failed loading pose script %s\n", argv[i]);
+				return EXIT_FAILURE;
+			}
+		}
+		else if (std::strcmp(argv[i], "--stereo") == 0 && i + 1 < argc) {
+			const char* mode = argv[++i];
+			if (std::strcmp(mode, "multipass") == 0) {
+				stereoMode = StereoMode_MultiPass;
+			}
+			else if (std::strcmp(mode, "instanced") == 0) {
+				stereoMode = StereoMode_Instanced;
+			}
+			else {
+				std::fprintf(stderr, "Unknown stereo mode %s\n", mode);
+				PrintUsage(argv[0]);
+				return EXIT_FAILURE;
+			}
+		}
+		else if (std::strcmp(argv[i], "--mesh-file") == 0 && i + 1 < argc) {
+			meshFilePath = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "--stream") == 0) {
+			stream = true;
+		}
+		else if (std::strcmp(argv[i], "--objects") == 0 && i + 1 < argc) {
+			objectCount = static_cast<unsigned int>(std::strtoul(argv[++i], nullptr, 10));
+		}
+		else if (std::strcmp(argv[i], "--materials") == 0 && i + 1 < argc) {
+			materialCount = std::max(1, std::min(MaxMaterials, std::atoi(argv[++i])));
+		}
+		else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+			threadCount = std::atoi(argv[++i]);
+		}
+		else if (std::strcmp(argv[i], "--gpu-driven") == 0) {
+			gpuDriven = true;
+		}
+		else if (std::strcmp(argv[i], "--late-latch") == 0) {
+			lateLatch = true;
+		}
+		else if (std::strcmp(argv[i], "--predict") == 0 && i + 1 < argc) {
+			if (!FindPredictionMethod(argv[++i], predictionMethod)) {
+				std::fprintf(stderr, "Unknown prediction method %s\n", argv[i]);
+				return EXIT_FAILURE;
+			}
+			ownPrediction = true;
+		}
+		else if (std::strcmp(argv[i], "--record-tracking") == 0 && i + 1 < argc) {
+			trackingLogPath = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "--paced") == 0 && i + 1 < argc) {
+			if (!FindLateFramePolicy(argv[++i], lateFramePolicy)) {
+				std::fprintf(stderr, "Unknown late frame policy %s\n", argv[i]);
+				return EXIT_FAILURE;
+			}
+			paced = true;
+		}
+		else if (std::strcmp(argv[i], "--adaptive-resolution") == 0) {
+			adaptiveResolution = true;
+		}
+		else if (std::strcmp(argv[i], "--foveation") == 0 && i + 1 < argc) {
+			if (std::sscanf(argv[++i], "%f,%f", &foveation.CenterSize, &foveation.PeripheryDensity) != 2) {
+				std::fprintf(stderr, "Expected CENTER,DENSITY after --foveation, got %s\n", argv[i]);
+				return EXIT_FAILURE;
+			}
+			foveated = true;
+		}
+		else if (std::strcmp(argv[i], "--own-distortion") == 0) {
+			ownDistortion = true;
+		}
+		else if (std::strcmp(argv[i], "--timewarp") == 0) {
+			ownDistortion = true;
+			timewarp = true;
+		}
+		else if (std::strcmp(argv[i], "--fused-resolve") == 0) {
+			ownDistortion = true;
+			fusedResolve = true;
+		}
+		else if (std::strcmp(argv[i], "--hidden-area") == 0) {
+			hiddenArea = true;
+		}
+		else if (std::strcmp(argv[i], "--capture") == 0 && i + 1 < argc) {
+			capturePath = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "--software") == 0) {
+			software = true;
+		}
+		else if (std::strcmp(argv[i], "--write-image") == 0 && i + 1 < argc) {
+			writeImagePath = argv[++i];
+			software = true;
+		}
+		else if (std::strcmp(argv[i], "--compare-image") == 0 && i + 1 < argc) {
+			compareImagePath = argv[++i];
+			software = true;
+		}
+		else if (std::strcmp(argv[i], "--profile-csv") == 0 && i + 1 < argc) {
+			profileCsvPath = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "--profile-json") == 0 && i + 1 < argc) {
+			profileJsonPath = argv[++i];
+		}
+		else {
+			PrintUsage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	bool streaming = stream && meshFilePath != nullptr;
+	if (meshFilePath != nullptr && !streaming && !scene.LoadMeshFile(meshFilePath)) {
+		std::fprintf(stderr, "Failed loading mesh file %s\n", meshFilePath);
+		return EXIT_FAILURE;
+	}
+
+	SimulatedHmd hmd(poseScript);
+	StereoSetup setup = CreateStereoSetup(hmd, PixelsPerDisplayPixel);
+	setup.Mode = stereoMode;
+	setup.LateLatch = lateLatch;
+	setup.GpuDriven = gpuDriven;
+	setup.AdaptiveResolution = adaptiveResolution;
+	setup.Foveated = foveated;
+	setup.Foveation = foveation;
+	setup.OwnPrediction = ownPrediction;
+	setup.Predictor = PosePredictor(predictionMethod, PosePredictor::DefaultSmoothingTime);
+	setup.OwnDistortion = ownDistortion;
+	setup.Timewarp = timewarp;
+	setup.FusedResolve = fusedResolve;
+	setup.HiddenAreaMask = hiddenArea;
+	TrackingLogWriter trackingLog;
+	if (trackingLogPath != nullptr) {
+		if (!trackingLog.Open(trackingLogPath)) {
+			std::fprintf(stderr, "Failed creating %s\n", trackingLogPath);
+			return EXIT_FAILURE;
+		}
+		setup.TrackingLog = &trackingLog;
+	}
+	JobSystem jobs(threadCount);
+	std::unique_ptr<NullRenderDevice> deviceOwner;
+	SoftwareRenderDevice* softwareDevice = nullptr;
+	if (software) {
+		softwareDevice = new SoftwareRenderDevice(hmd.GetResolution(), setup.RenderTargetSize, MultisampleCount, jobs);
+		deviceOwner.reset(softwareDevice);
+	}
+	else {
+		deviceOwner.reset(new NullRenderDevice(setup.RenderTargetSize, MultisampleCount));
+	}
+	NullRenderDevice& device = *deviceOwner;
+
+	// With --capture the frame loop goes through the capture, which passes everything on.
+	CommandCaptureDevice capture(device);
+	RenderDevice* frameDevice = &device;
+	if (capturePath != nullptr) {
+		if (!capture.Open(capturePath)) {
+			std::fprintf(stderr, "Failed creating %s\n", capturePath);
+			return EXIT_FAILURE;
+		}
+		frameDevice = &capture;
+		setup.CommandCapture = &capture;
+	}
+
+	std::unique_ptr<ResourceStreamer> streamer;
+	int meshRequest = -1;
+	bool scattered = false;
+	int streamedFrames = -1;
+	if (objectCount == 0) {
+		AddDefaultSceneContent(scene);
+	}
+	else if (streaming) {
+		// The objects are scattered once the meshes are known, the scene starts out empty.
+		streamer.reset(new ResourceStreamer(StreamingThreads, StreamingStagingCapacity, StreamingBytesPerFrame));
+		meshRequest = streamer->RequestMeshFile(meshFilePath);
+	}
+	else {
+		if (scene.GetMeshCount() == 0) {
+			AddDefaultSceneContent(scene);
+		}
+		ScatterObjects(scene, objectCount, 0, scene.GetMeshCount(), materialCount);
+	}
+	if (!scene.GetVertices().empty()) {
+		frameDevice->SetSceneVertices(&scene.GetVertices()[0], static_cast<unsigned int>(scene.GetVertices().size()));
+	}
+
+	unsigned long long visibleObjects = 0;
+	double resolutionScales = 0.0;
+
+	Profiler::MeasureTimerOverhead(100000);
+
+	// One frame, paced or not. Returns false if streaming failed.
+	auto renderOneFrame = [&](unsigned int frame) -> bool {
+		{
+			ScopedProfileTimer timer(ProfileStage_Frame);
+			if (streamer) {
+				ScopedProfileTimer uploadTimer(ProfileStage_Upload);
+				streamer->CommitUploads(scene, *frameDevice);
+				if (!scattered && streamer->GetMeshCount(meshRequest) > 0) {
+					ScatterObjects(scene, objectCount, streamer->GetSceneMesh(meshRequest, 0), streamer->GetMeshCount(meshRequest), materialCount);
+					scattered = true;
+				}
+			}
+			RenderFrame(hmd, *frameDevice, setup, scene, jobs);
+		}
+		if (streamer) {
+			if (streamer->IsFailed(meshRequest)) {
+				return false;
+			}
+			if (streamedFrames < 0 && streamer->IsComplete(meshRequest)) {
+				streamedFrames = static_cast<int>(frame) + 1;
+			}
+		}
+		visibleObjects += setup.VisibleObjects.size();
+		resolutionScales += setup.Resolution.GetScale();
+		Profiler::Collect();
+		return true;
+	};
+
+	bool streamingFailed = false;
+	SystemPacingClock pacingClock;
+	std::unique_ptr<FrameScheduler> scheduler;
+	auto start = ReadClock();
+	if (paced && frameCount > 0) {
+		FramePacer::Settings pacing = FramePacer::GetDefaultSettings(hmd.GetRefreshRate());
+		pacing.VsyncOrigin = pacingClock.GetTime();
+		pacing.Policy = lateFramePolicy;
+		scheduler.reset(new FrameScheduler(pacingClock, pacing));
+		setup.SubmitClock = &pacingClock;
+		unsigned int renderedFrames = 0;
+		scheduler->Start([&](const SimulationState& state, const PacedFrame& frame) -> double {
+			// The simulated HMD shows frame N at vsync N.
+			setup.FrameIndex = static_cast<unsigned int>(frame.Vsync);
+			if (!renderOneFrame(renderedFrames)) {
+				streamingFailed = true;
+			}
+			if (++renderedFrames == frameCount || streamingFailed) {
+				scheduler->RequestStop();
+			}
+			return setup.SubmitTime;
+		});
+
+		// This thread is the simulation now.
+		for (double tick = pacingClock.GetTime(); !scheduler->IsStopping(); tick += 1.0 / SimulationRate) {
+			pacingClock.WaitUntil(tick);
+			scheduler->Publish();
+		}
+		scheduler->Stop();
+	}
+	else {
+		for (unsigned int frame = 0; frame < frameCount && !streamingFailed; frame++) {
+			streamingFailed = !renderOneFrame(frame);
+		}
+	}
+	auto elapsed = ClockTicksToSeconds(ReadClock() - start);
+	if (streamingFailed) {
+		std::fprintf(stderr, "Failed streaming mesh file %s\n", meshFilePath);
+		return EXIT_FAILURE;
+	}
+
+	const NullRenderDevice::Statistics& statistics = device.GetStatistics();
+	if (gpuDriven) {
+		// The frame loop never sees what is visible then, only the device does.
+		visibleObjects = statistics.VisibleInstances;
+	}
+	std::printf("Eye texture: %dx%d, %dx MSAA, %s stereo, %d threads%s%s%s\n", setup.RenderTargetSize.w, setup.RenderTargetSize.h, MultisampleCount,
+		stereoMode == StereoMode_Instanced ? "instanced" : "multi-pass", jobs.GetThreadCount(), gpuDriven ? ", GPU driven" : "",
+		lateLatch ? ", late latching" : "", software ? ", software rasterizer" : "");
+	std::printf("Frames: %u\n", frameCount);
+	std::printf("Total: %.3f ms\n", elapsed * 1000.0);
+	if (frameCount > 0) {
+		std::printf("Per frame: %.3f us\n", elapsed * 1e6 / frameCount);
+	}
+	std::printf("Scene: %d meshes, %u vertices, %u objects", scene.GetMeshCount(),
+		static_cast<unsigned int>(scene.GetVertices().size()), scene.GetObjectCount());
+	if (frameCount > 0) {
+		std::printf(", %.1f visible per frame", static_cast<double>(visibleObjects) / frameCount);
+	}
+	std::printf("\n");
+	if (streamer) {
+		ResourceStreamer::Statistics streamingStatistics = streamer->GetStatistics();
+		if (streamedFrames >= 0) {
+			std::printf("Streaming: resident after %d frames", streamedFrames);
+		}
+		else {
+			std::printf("Streaming: incomplete, %u blocks queued", streamingStatistics.QueueDepth);
+		}
+		std::printf(", %llu KB in %llu uploads (%u KB per frame at most), %u KB staging, %llu staging stalls, %llu budget stalls\n",
+			streamingStatistics.CommittedBytes / 1024, streamingStatistics.Uploads, streamer->GetBytesPerFrame() / 1024, streamer->GetStagingCapacity() / 1024,
+			streamingStatistics.StagingStalls, streamingStatistics.BudgetStalls);
+	}
+	if (ownPrediction || trackingLogPath != nullptr) {
+		if (ownPrediction) {
+			std::printf("Tracking: poses predicted by PosePredictor (%s)", GetPredictionMethodName(predictionMethod));
+		}
+		else {
+			std::printf("Tracking: poses predicted by the HMD");
+		}
+		if (trackingLogPath != nullptr) {
+			std::printf(", %u frames logged to %s", frameCount, trackingLogPath);
+		}
+		std::printf("\n");
+	}
+	if (scheduler) {
+		FramePacer::Statistics pacingStatistics = scheduler->GetStatistics();
+		std::printf("Pacing: %s at %.0f Hz, %llu missed deadlines, %llu vsyncs dropped, %llu repeated, %.3f ms jitter, %llu states published\n",
+			GetLateFramePolicyName(lateFramePolicy), hmd.GetRefreshRate(), pacingStatistics.MissedDeadlines, pacingStatistics.DroppedVsyncs,
+			pacingStatistics.RepeatedVsyncs, scheduler->GetJitter() * 1000.0, scheduler->GetState().Tick);
+	}
+	if (adaptiveResolution && frameCount > 0) {
+		std::printf("Resolution scale: %.3f mean, %.3f last\n", resolutionScales / frameCount, setup.Resolution.GetScale());
+	}
+	if (foveated && frameCount > 0) {
+		// The layout of the last frame.
+		const FoveatedLayout& layout = setup.FoveatedTargets;
+		std::printf("Foveation: center %.2f, periphery density %.2f, target %dx%d\n", foveation.CenterSize, foveation.PeripheryDensity,
+			layout.TargetSize.w, layout.TargetSize.h);
+		for (int eye = 0; eye < EyeCount; eye++) {
+			for (int i = 0; i < FoveatedRegionCount; i++) {
+				const FoveatedRegion& region = layout.Regions[eye][i];
+				std::printf("  Eye %d region %d: %4dx%-4d at %4d,%-4d -> %4dx%-4d at %4d,%-4d\n", eye, i,
+					region.Eye.Size.w, region.Eye.Size.h, region.Eye.Pos.x, region.Eye.Pos.y,
+					region.Target.Size.w, region.Target.Size.h, region.Target.Pos.x, region.Target.Pos.y);
+			}
+		}
+		unsigned long long fullPixels = GetFullPixelCount(layout);
+		unsigned long long foveatedPixels = GetFoveatedPixelCount(layout);
+		std::printf("Pixels shaded: %llu of %llu (%.1f%%), %llu samples with %dx MSAA, composites: %llu\n", foveatedPixels, fullPixels,
+			fullPixels > 0 ? 100.0 * foveatedPixels / fullPixels : 0.0, foveatedPixels * MultisampleCount, MultisampleCount, statistics.Composites);
+	}
+	if (ownDistortion) {
+		// Both eyes' meshes as the device keeps them, and as LibOVR's ovrDistortionVertex would.
+		unsigned long long vertices = 0;
+		unsigned long long indices = 0;
+		for (int eye = 0; eye < EyeCount; eye++) {
+			vertices += device.GetDistortionMesh(eye).Vertices.size();
+			indices += device.GetDistortionMesh(eye).Indices.size();
+		}
+		unsigned long long indexBytes = indices * sizeof(unsigned short);
+		std::printf("Distortion: %s, %llu vertices, %llu triangles, %llu KB (%llu KB as LibOVR's vertices), %llu presents\n",
+			timewarp ? "timewarped" : "no timewarp", vertices, indices / 3, (vertices * sizeof(DistortionVertex) + indexBytes) / 1024,
+			(vertices * sizeof(DistortionPoint) + indexBytes) / 1024, statistics.DistortedPresents);
+	}
+	if (hiddenArea) {
+		std::printf("Hidden area: %.1f%% of the left eye, %.1f%% of the right eye, %llu pixels masked per frame, %s\n",
+			100.0f * GetHiddenAreaFraction(setup.HiddenArea[0]), 100.0f * GetHiddenAreaFraction(setup.HiddenArea[1]),
+			frameCount > 0 ? statistics.MaskedPixels / frameCount : 0, setup.HiddenAreaAccepted ? "accepted" : "not accepted");
+	}
+	if (capturePath != nullptr) {
+		std::printf("Capture: %u frames, %llu KB (%.1f KB per frame) written to %s\n", capture.GetFrameCount(), capture.GetCapturedBytes() / 1024,
+			capture.GetFrameCount() > 0 ? capture.GetCapturedBytes() / 1024.0 / capture.GetFrameCount() : 0.0, capturePath);
+	}
+	if (frameCount > 0) {
+		// What a GPU would move through the eye textures, not counting drawing the scene.
+		std::printf("Eye texture traffic: %llu KB resolved, %llu KB sampled by the distortion per frame, resolve %s\n",
+			statistics.ResolveBytes / frameCount / 1024, statistics.DistortionBytes / frameCount / 1024,
+			device.IsResolveFused() ? "fused" : "separate");
+	}
+	std::printf("Draws: %llu (%llu instances), constant uploads: %llu (%llu bytes, %llu maps), resolves: %llu, recorded commands: %llu, latches: %llu\n",
+		statistics.Draws, statistics.Instances, statistics.ConstantUpdates, statistics.ConstantBytes, statistics.ConstantMaps, statistics.Resolves,
+		statistics.RecordedCommands, statistics.Latches);
+	if (gpuDriven) {
+		std::printf("GPU: %llu instance uploads, %llu culls, %llu indirect draws\n", statistics.InstanceUploads, statistics.InstanceCulls,
+			statistics.IndirectDraws);
+	}
+	const StateCache::Statistics& stateStatistics = device.GetStateStatistics();
+	DrawQueue::Statistics queueStatistics;
+	std::memset(&queueStatistics, 0, sizeof(queueStatistics));
+	for (size_t i = 0; i < setup.DrawQueues.size(); i++) {
+		const DrawQueue::Statistics& jobStatistics = setup.DrawQueues[i].GetStatistics();
+		queueStatistics.Packets += jobStatistics.Packets;
+		queueStatistics.SortRounds += jobStatistics.SortRounds;
+		queueStatistics.SkippedRounds += jobStatistics.SkippedRounds;
+		queueStatistics.MaterialChanges += jobStatistics.MaterialChanges;
+	}
+	std::printf("State: %llu calls issued, %llu filtered; %llu draw packets, %llu material changes, %llu sort rounds (%llu skipped)\n",
+		stateStatistics.TotalIssued, stateStatistics.TotalFiltered, queueStatistics.Packets, queueStatistics.MaterialChanges,
+		queueStatistics.SortRounds, queueStatistics.SkippedRounds);
+	if (softwareDevice != nullptr) {
+		const SoftwareRasterizer::Statistics& rasterizerStatistics = softwareDevice->GetRasterizerStatistics();
+		std::printf("Rasterizer: %llu triangles, %llu culled, %llu added by clipping, %llu binned into tiles, %llu flushes\n",
+			rasterizerStatistics.Triangles, rasterizerStatistics.CulledTriangles, rasterizerStatistics.ClippedTriangles,
+			rasterizerStatistics.TileTriangles, rasterizerStatistics.Flushes);
+	}
+	const ConstantRingAllocator::Statistics& ringStatistics = device.GetConstantAllocator().GetStatistics();
+	std::printf("Constant ring: %u KB, %llu wraps, %llu bytes skipped, %llu stalls\n",
+		device.GetConstantAllocator().GetCapacity() / 1024, ringStatistics.Wraps, ringStatistics.WastedBytes, ringStatistics.Failures);
+	const FrameGraph& graph = device.GetFrameGraph();
+	const FrameGraph::Statistics& graphStatistics = graph.GetStatistics();
+	std::printf("Frame graph: %d passes (%d culled), %d clears (%d merged, %d dropped), %d resolves, %d barriers, %llu compilations, %llu cached\n",
+		graphStatistics.Passes, graphStatistics.CulledPasses, graphStatistics.Clears, graphStatistics.MergedClears, graphStatistics.DroppedClears,
+		graphStatistics.Resolves, graphStatistics.Barriers, graphStatistics.Compilations, graphStatistics.CacheHits);
+	RenderTargetPlan targetPlan;
+	graph.BuildTargetPlan(targetPlan);
+	const RenderTargetPlan::Statistics& targetStatistics = targetPlan.GetStatistics();
+	std::printf("Render targets on a GPU: %d textures, %llu KB (%llu KB peak, %llu KB aliased)\n", targetStatistics.Textures,
+		targetStatistics.AllocatedBytes / 1024, targetStatistics.PeakBytes / 1024, targetStatistics.AliasedBytes / 1024);
+	std::printf("\n");
+	Profiler::PrintSummary();
+
+	if (trackingLogPath != nullptr && !trackingLog.Close()) {
+		std::fprintf(stderr, "Failed writing %s\n", trackingLogPath);
+		return EXIT_FAILURE;
+	}
+	if (capturePath != nullptr && !capture.Close()) {
+		std::fprintf(stderr, "Failed writing %s\n", capturePath);
+		return EXIT_FAILURE;
+	}
+	if (profileCsvPath != nullptr && !Profiler::WriteCsv(profileCsvPath)) {
+		std::fprintf(stderr, "Failed writing %s\n", profileCsvPath);
+	}
+	if (profileJsonPath != nullptr && !Profiler::WriteJson(profileJsonPath)) {
+		std::fprintf(stderr, "Failed writing %s\n", profileJsonPath);
+	}
+
+	// With own distortion what is checked is what the display shows.
+	const Image* finalImage = nullptr;
+	if (softwareDevice != nullptr) {
+		finalImage = ownDistortion && statistics.DistortedPresents > 0 ? &softwareDevice->GetDisplayImage() : &softwareDevice->GetImage();
+	}
+	if (writeImagePath != nullptr && !WriteImage(*finalImage, writeImagePath)) {
+		std::fprintf(stderr, "Failed writing %s\n", writeImagePath);
+		return EXIT_FAILURE;
+	}
+	if (compareImagePath != nullptr) {
+		Image expected;
+		if (!ReadImage(compareImagePath, expected)) {
+			std::fprintf(stderr, "Failed reading %s\n", compareImagePath);
+			return EXIT_FAILURE;
+		}
+		ImageDifference difference = CompareImages(*finalImage, expected, 0);
+		std::printf("Compared with %s: %llu pixels differ, by up to %d\n", compareImagePath, difference.DifferentPixels, difference.MaxChannelDifference);
+		if (difference.DifferentPixels > 0) {
+			return EXIT_FAILURE;
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
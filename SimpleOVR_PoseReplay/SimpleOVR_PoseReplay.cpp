@@ -0,0 +1,240 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+/*
+	Replays tracking logs (see TrackingLog.h) through the pose predictors of PosePrediction.h and
+	reports how far off their predictions were, so prediction can be evaluated and tuned offline,
+	on recordings of real head motion, without a headset.
+
+	Building:
+
+	Visual Studio 2013:
+		Build the SimpleOVR_PoseReplay project. It does not need LibOVR.
+
+	Linux (or anything else with a C++11 compiler):
+		g++ -std=c++11 -O2 -I../SimpleOVR_Common -o SimpleOVR_PoseReplay SimpleOVR_PoseReplay.cpp ../SimpleOVR_Common/MappedFile.cpp ../SimpleOVR_Common/PosePrediction.cpp ../SimpleOVR_Common/TrackingLog.cpp
+
+	Usage:
+		SimpleOVR_PoseReplay [--latencies MS,MS,...] [--smoothing SECONDS] FILE...
+
+	Logs are recorded by the D3D11 sample (TrackingLogPath) and by SimpleOVR_Headless
+	(--record-tracking).
+
+	Where the head actually was is interpolated between the logged tracking states, so the error
+	of a prediction is only known for times between the first and the last of them.
+
+	The Frames table is what the frames would have looked like: each method is given the states
+	up to the one the pose was sampled with and predicts for the frame's scanout midpoint. "hmd"
+	is the pose the frame was drawn with, whatever predicted it.
+
+	The Latency table predicts from every logged state as it came in for each of the given
+	latencies (10 to 60 ms by default) later, which shows how the error grows with the latency.
+	--smoothing sets the time constant of the filtered method, 0.015 seconds by default.
+*/
+
+#include "PosePrediction.h"
+#include "TrackingLog.h"
+#include "VrMath.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace {
+	const double DefaultLatencies[] = { 0.010, 0.020, 0.030, 0.040, 0.050, 0.060 };
+	const float RadiansToDegrees = 180.0f / 3.14159265f;
+
+	// Errors of one method, in degrees and millimeters.
+	struct PredictionErrors {
+		std::vector<float> Angles;
+		std::vector<float> Distances;
+
+		void Add(const Pose& predicted, const Pose& actual) {
+			Angles.push_back(AngleBetween(predicted.Orientation, actual.Orientation) * RadiansToDegrees);
+			Vector3 offset = predicted.Position - actual.Position;
+			Distances.push_back(std::sqrt(Dot(offset, offset)) * 1000.0f);
+		}
+	};
+
+	struct ErrorSummary {
+		float Mean;
+		float P95;
+		float Max;
+	};
+
+	ErrorSummary Summarize(std::vector<float> errors) {
+		ErrorSummary summary = { 0.0f, 0.0f, 0.0f };
+		if (errors.empty()) {
+			return summary;
+		}
+		std::sort(errors.begin(), errors.end());
+		double sum = 0.0;
+		for (size_t i = 0; i < errors.size(); i++) {
+			sum += errors[i];
+		}
+		summary.Mean = static_cast<float>(sum / errors.size());
+		summary.P95 = errors[std::min(errors.size() - 1, errors.size() * 95 / 100)];
+		summary.Max = errors.back();
+		return summary;
+	}
+
+	void PrintErrors(const char* name, const PredictionErrors& errors) {
+		ErrorSummary angles = Summarize(errors.Angles);
+		ErrorSummary distances = Summarize(errors.Distances);
+		std::printf("  %-14s %8.3f %8.3f %8.3f   %8.2f %8.2f %8.2f\n", name, angles.Mean, angles.P95, angles.Max,
+			distances.Mean, distances.P95, distances.Max);
+	}
+
+	// Every method over the frames, each starting from the state the frame's pose was sampled with.
+	void ReplayFrames(const TrackingLog& log, double smoothingTime) {
+		const std::vector<PoseState>& samples = log.GetSamples();
+		const std::vector<TrackedFrame>& frames = log.GetFrames();
+		PredictionErrors hmdErrors;
+		PredictionErrors methodErrors[PredictionMethodCount];
+		PosePredictor predictors[PredictionMethodCount];
+		for (int method = 0; method < PredictionMethodCount; method++) {
+			predictors[method] = PosePredictor(static_cast<PredictionMethod>(method), smoothingTime);
+		}
+
+		unsigned int nextSample = 0;
+		double horizon = 0.0;
+		for (size_t i = 0; i < frames.size(); i++) {
+			const TrackedFrame& frame = frames[i];
+			Pose actual;
+			if (!frame.Predicted || !log.GetHeadPose(frame.Timing.ScanoutMidpointSeconds, actual)) {
+				continue;
+			}
+			for (; nextSample <= frame.PredictionSample; nextSample++) {
+				for (int method = 0; method < PredictionMethodCount; method++) {
+					predictors[method].AddSample(samples[nextSample]);
+				}
+			}
+			hmdErrors.Add(frame.PredictedHeadPose, actual);
+			for (int method = 0; method < PredictionMethodCount; method++) {
+				methodErrors[method].Add(predictors[method].Predict(frame.Timing.ScanoutMidpointSeconds), actual);
+			}
+			horizon += frame.Timing.ScanoutMidpointSeconds - samples[frame.PredictionSample].TimeInSeconds;
+		}
+
+		unsigned int evaluated = static_cast<unsigned int>(hmdErrors.Angles.size());
+		std::printf("Frames: %u evaluated, predicted %.1f ms ahead on average\n", evaluated, evaluated > 0 ? horizon * 1000.0 / evaluated : 0.0);
+		if (evaluated == 0) {
+			return;
+		}
+		std::printf("  %-14s %8s %8s %8s   %8s %8s %8s\n", "method", "deg mean", "p95", "max", "mm mean", "p95", "max");
+		PrintErrors("hmd", hmdErrors);
+		for (int method = 0; method < PredictionMethodCount; method++) {
+			PrintErrors(GetPredictionMethodName(static_cast<PredictionMethod>(method)), methodErrors[method]);
+		}
+	}
+
+	// Every method from every state, for each latency.
+	void ReplayLatencies(const TrackingLog& log, const std::vector<double>& latencies, double smoothingTime) {
+		const std::vector<PoseState>& samples = log.GetSamples();
+		std::printf("Latency: mean (p95) error in degrees, predicting from every state\n");
+		std::printf("  %8s", "ms");
+		for (int method = 0; method < PredictionMethodCount; method++) {
+			std::printf(" %18s", GetPredictionMethodName(static_cast<PredictionMethod>(method)));
+		}
+		std::printf("\n");
+		for (size_t l = 0; l < latencies.size(); l++) {
+			PredictionErrors errors[PredictionMethodCount];
+			for (int method = 0; method < PredictionMethodCount; method++) {
+				PosePredictor predictor(static_cast<PredictionMethod>(method), smoothingTime);
+				for (size_t i = 0; i < samples.size(); i++) {
+					predictor.AddSample(samples[i]);
+					double time = samples[i].TimeInSeconds + latencies[l];
+					Pose actual;
+					if (log.GetHeadPose(time, actual)) {
+						errors[method].Add(predictor.Predict(time), actual);
+					}
+				}
+			}
+			std::printf("  %8.1f", latencies[l] * 1000.0);
+			for (int method = 0; method < PredictionMethodCount; method++) {
+				ErrorSummary angles = Summarize(errors[method].Angles);
+				std::printf("   %7.3f (%7.3f)", angles.Mean, angles.P95);
+			}
+			std::printf("\n");
+		}
+	}
+}
+
+int main(int argc, char* argv[]) {
+	std::vector<double> latencies(DefaultLatencies, DefaultLatencies + sizeof(DefaultLatencies) / sizeof(DefaultLatencies[0]));
+	double smoothingTime = PosePredictor::DefaultSmoothingTime;
+	std::vector<const char*> paths;
+
+	for (int i = 1; i < argc; i++) {
+		if (std::strcmp(argv[i], "--latencies") == 0 && i + 1 < argc) {
+			latencies.clear();
+			const char* list = argv[++i];
+			while (*list != '\0') {
+				char* end;
+				double milliseconds = std::strtod(list, &end);
+				if (end == list || milliseconds < 0.0) {
+					std::fprintf(stderr, "Expected milliseconds separated by commas after --latencies, got %s\n", argv[i]);
+					return EXIT_FAILURE;
+				}
+				latencies.push_back(milliseconds / 1000.0);
+				list = *end == ',' ? end + 1 : end;
+			}
+		}
+		else if (std::strcmp(argv[i], "--smoothing") == 0 && i + 1 < argc) {
+			smoothingTime = std::atof(argv[++i]);
+		}
+		else if (argv[i][0] != '-') {
+			paths.push_back(argv[i]);
+		}
+		else {
+			paths.clear();
+			break;
+		}
+	}
+	if (paths.empty()) {
+		std::fprintf(stderr, "Usage: %s [--latencies MS,MS,...] [--smoothing SECONDS] FILE...\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	for (size_t i = 0; i < paths.size(); i++) {
+		TrackingLog log;
+		if (!log.Load(paths[i])) {
+			std::fprintf(stderr, "Failed loading tracking log %s\n", paths[i]);
+			return EXIT_FAILURE;
+		}
+		const std::vector<PoseState>& samples = log.GetSamples();
+		double duration = samples.size() > 1 ? samples.back().TimeInSeconds - samples.front().TimeInSeconds : 0.0;
+		std::printf("%s: %u frames, %u tracking states over %.2f s (%.0f per second)\n", paths[i], static_cast<unsigned int>(log.GetFrames().size()),
+			static_cast<unsigned int>(samples.size()), duration, duration > 0.0 ? samples.size() / duration : 0.0);
+		ReplayFrames(log, smoothingTime);
+		ReplayLatencies(log, latencies, smoothingTime);
+		std::printf("\n");
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,508 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#include "ScenarioResults.h"
+#include "MappedFile.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+
+namespace {
+	const int MaxJsonDepth = 32;
+
+	// A number, string or boolean of a JSON document, with the keys and array indices leading to it.
+	struct JsonField {
+		std::vector<std::string> Path;
+		bool IsString;
+		double Number;
+		std::string String;
+	};
+
+	// Just enough JSON to read results back: every value is flattened to a JsonField, nulls are dropped.
+	class JsonReader {
+	public:
+		JsonReader(const char* text, size_t size) : position(text), end(text + size), fields(nullptr) {
+		}
+
+		bool Read(std::vector<JsonField>& outFields) {
+			outFields.clear();
+			fields = &outFields;
+			path.clear();
+			if (!ReadValue(0)) {
+				return false;
+			}
+			SkipSpace();
+			return position == end;
+		}
+
+	private:
+		void SkipSpace() {
+			while (position < end && (*position == ' ' || *position == '\t' || *position == '\n' || *position == '\r')) {
+				position++;
+			}
+		}
+
+		bool Expect(char c) {
+			SkipSpace();
+			if (position == end || *position != c) {
+				return false;
+			}
+			position++;
+			return true;
+		}
+
+		bool ReadString(std::string& out) {
+			out.clear();
+			if (!Expect('"')) {
+				return false;
+			}
+			while (position < end && *position != '"') {
+				char c = *position++;
+				if (c == '\\') {
+					if (position == end) {
+						return false;
+					}
+					c = *position++;
+					switch (c) {
+					case 'b': c = '\b'; break;
+					case 'f': c = '\f'; break;
+					case 'n': c = '\n'; break;
+					case 'r': c = '\r'; break;
+					case 't': c = '\t'; break;
+					case 'u':
+						// Nothing written has them, so they need not come out right.
+						if (end - position < 4) {
+							return false;
+						}
+						position += 4;
+						c = '?';
+						break;
+					}
+				}
+				out.push_back(c);
+			}
+			return Expect('"');
+		}
+
+		bool ReadLiteral(const char* literal) {
+			size_t length = std::strlen(literal);
+			if (static_cast<size_t>(end - position) < length || std::strncmp(position, literal, length) != 0) {
+				return false;
+			}
+			position += length;
+			return true;
+		}
+
+		void AddField(bool isString, double number, const std::string& string) {
+			JsonField field;
+			field.Path = path;
+			field.IsString = isString;
+			field.Number = number;
+			field.String = string;
+			fields->push_back(field);
+		}
+
+		bool ReadValue(int depth) {
+			SkipSpace();
+			if (position == end || depth > MaxJsonDepth) {
+				return false;
+			}
+			char c = *position;
+			if (c == '{') {
+				position++;
+				SkipSpace();
+				if (position < end && *position == '}') {
+					position++;
+					return true;
+				}
+				do {
+					std::string key;
+					if (!ReadString(key) || !Expect(':')) {
+						return false;
+					}
+					path.push_back(key);
+					if (!ReadValue(depth + 1)) {
+						return false;
+					}
+					path.pop_back();
+				} while (Expect(','));
+				return Expect('}');
+			}
+			if (c == '[') {
+				position++;
+				SkipSpace();
+				if (position < end && *position == ']') {
+					position++;
+					return true;
+				}
+				int index = 0;
+				do {
+					path.push_back(std::to_string(index++));
+					if (!ReadValue(depth + 1)) {
+						return false;
+					}
+					path.pop_back();
+				} while (Expect(','));
+				return Expect(']');
+			}
+			if (c == '"') {
+				std::string string;
+				if (!ReadString(string)) {
+					return false;
+				}
+				AddField(true, 0.0, string);
+				return true;
+			}
+			if (ReadLiteral("true")) {
+				AddField(false, 1.0, std::string());
+				return true;
+			}
+			if (ReadLiteral("false")) {
+				AddField(false, 0.0, std::string());
+				return true;
+			}
+			if (ReadLiteral("null")) {
+				return true;
+			}
+
+			// The mapped file doesn't end in a 0, so strtod gets a copy.
+			char number[64];
+			size_t length = 0;
+			while (position < end && length + 1 < sizeof(number) && std::strchr("+-.0123456789eE", *position) != nullptr) {
+				number[length++] = *position++;
+			}
+			number[length] = 0;
+			char* numberEnd = nullptr;
+			double value = std::strtod(number, &numberEnd);
+			if (length == 0 || numberEnd != number + length) {
+				return false;
+			}
+			AddField(false, value, std::string());
+			return true;
+		}
+
+		const char* position;
+		const char* end;
+		std::vector<std::string> path;
+		std::vector<JsonField>* fields;
+	};
+
+	void ClearScenarioResult(ScenarioResult& result) {
+		result.Name.clear();
+		result.ObjectCount = 0;
+		result.ResolutionScale = 0.0f;
+		result.MultisampleCount = 0;
+		result.Mode = StereoMode_MultiPass;
+		result.ThreadCount = 0;
+		result.EyeTextureSize.w = 0;
+		result.EyeTextureSize.h = 0;
+		result.DrawsPerFrame = 0.0;
+		std::memset(result.Stages, 0, sizeof(result.Stages));
+		result.ProcessMemoryPeak = 0;
+		result.ConstantMemoryPeak = 0;
+		result.RenderTargetMemoryPeak = 0;
+	}
+
+	bool FindStage(const std::string& name, int& outStage) {
+		for (int i = 0; i < ProfileStageCount; i++) {
+			if (name == Profiler::GetStageName(static_cast<ProfileStage>(i))) {
+				outStage = i;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void SetStageValue(StageResult& stage, const std::string& key, double value) {
+		if (key == "count") {
+			stage.Count = static_cast<unsigned long long>(value);
+		}
+		else if (key == "mean_us") {
+			stage.Mean = value;
+		}
+		else if (key == "p50_us") {
+			stage.Median = value;
+		}
+		else if (key == "p95_us") {
+			stage.P95 = value;
+		}
+		else if (key == "p99_us") {
+			stage.P99 = value;
+		}
+		else if (key == "max_us") {
+			stage.Max = value;
+		}
+	}
+
+	void SetScenarioValue(ScenarioResult& scenario, const JsonField& field) {
+		const std::vector<std::string>& path = field.Path;
+		const std::string& key = path[2];
+		if (field.IsString) {
+			if (key == "stereo") {
+				FindStereoMode(field.String.c_str(), scenario.Mode);
+			}
+			return;
+		}
+		double value = field.Number;
+		if (key == "objects") {
+			scenario.ObjectCount = static_cast<unsigned int>(value);
+		}
+		else if (key == "resolution_scale") {
+			scenario.ResolutionScale = static_cast<float>(value);
+		}
+		else if (key == "msaa") {
+			scenario.MultisampleCount = static_cast<int>(value);
+		}
+		else if (key == "threads") {
+			scenario.ThreadCount = static_cast<int>(value);
+		}
+		else if (key == "eye_texture" && path.size() == 4) {
+			(path[3] == "0" ? scenario.EyeTextureSize.w : scenario.EyeTextureSize.h) = static_cast<int>(value);
+		}
+		else if (key == "draws_per_frame") {
+			scenario.DrawsPerFrame = value;
+		}
+		else if (key == "stages" && path.size() == 5) {
+			int stage;
+			if (FindStage(path[3], stage)) {
+				SetStageValue(scenario.Stages[stage], path[4], value);
+			}
+		}
+		else if (key == "memory_bytes" && path.size() == 4) {
+			unsigned long long bytes = static_cast<unsigned long long>(value);
+			if (path[3] == "process_peak") {
+				scenario.ProcessMemoryPeak = bytes;
+			}
+			else if (path[3] == "constants_peak") {
+				scenario.ConstantMemoryPeak = bytes;
+			}
+			else if (path[3] == "render_targets_peak") {
+				scenario.RenderTargetMemoryPeak = bytes;
+			}
+		}
+	}
+
+	const ScenarioResult* FindScenario(const ScenarioResults& results, const std::string& name) {
+		for (size_t i = 0; i < results.Scenarios.size(); i++) {
+			if (results.Scenarios[i].Name == name) {
+				return &results.Scenarios[i];
+			}
+		}
+		return nullptr;
+	}
+
+	void CompareValue(const std::string& scenario, const std::string& value, double baseline, double current, double fraction, double minimum,
+		bool memory, ScenarioComparison& comparison) {
+		comparison.ComparedValues++;
+		double margin = std::max(baseline * fraction, minimum);
+		if (std::fabs(current - baseline) <= margin) {
+			return;
+		}
+		ScenarioChange change;
+		change.Scenario = scenario;
+		change.Value = value;
+		change.Baseline = baseline;
+		change.Current = current;
+		change.Memory = memory;
+		change.Regressed = current > baseline;
+		comparison.Changes.push_back(change);
+		if (change.Regressed) {
+			comparison.Regressions++;
+		}
+	}
+}
+
+RegressionThresholds GetDefaultRegressionThresholds() {
+	RegressionThresholds thresholds;
+	thresholds.Median = 0.10;
+	thresholds.Tail = 0.25;
+	thresholds.Memory = 0.10;
+	thresholds.MinTime = 2.0;
+	thresholds.MinProcessMemory = 1024.0 * 1024.0;
+	thresholds.AllStages = false;
+	return thresholds;
+}
+
+std::string GetScenarioName(unsigned int objectCount, float resolutionScale, int multisampleCount, StereoMode mode, int threadCount) {
+	char name[128];
+	std::sprintf(name, "objects=%u scale=%.2f msaa=%d stereo=%s threads=%d", objectCount, resolutionScale, multisampleCount,
+		GetStereoModeName(mode), threadCount);
+	return name;
+}
+
+const char* GetStereoModeName(StereoMode mode) {
+	return mode == StereoMode_Instanced ? "instanced" : "multipass";
+}
+
+bool FindStereoMode(const char* name, StereoMode& outMode) {
+	if (std::strcmp(name, "multipass") == 0) {
+		outMode = StereoMode_MultiPass;
+		return true;
+	}
+	if (std::strcmp(name, "instanced") == 0) {
+		outMode = StereoMode_Instanced;
+		return true;
+	}
+	return false;
+}
+
+bool WriteScenarioResults(const char* path, const ScenarioResults& results) {
+	FILE* file = std::fopen(path, "w");
+	if (file == nullptr) {
+		return false;
+	}
+
+	std::fprintf(file, "{\n");
+	std::fprintf(file, "  \"frames\": %u,\n", results.Frames);
+	std::fprintf(file, "  \"warmup_frames\": %u,\n", results.WarmupFrames);
+	std::fprintf(file, "  \"timer_overhead_ns\": %.1f,\n", results.TimerOverhead);
+	std::fprintf(file, "  \"scenarios\": {\n");
+	for (size_t i = 0; i < results.Scenarios.size(); i++) {
+		const ScenarioResult& scenario = results.Scenarios[i];
+		std::fprintf(file, "    \"%s\": {\n", scenario.Name.c_str());
+		std::fprintf(file, "      \"objects\": %u,\n", scenario.ObjectCount);
+		std::fprintf(file, "      \"resolution_scale\": %.3f,\n", scenario.ResolutionScale);
+		std::fprintf(file, "      \"msaa\": %d,\n", scenario.MultisampleCount);
+		std::fprintf(file, "      \"stereo\": \"%s\",\n", GetStereoModeName(scenario.Mode));
+		std::fprintf(file, "      \"threads\": %d,\n", scenario.ThreadCount);
+		std::fprintf(file, "      \"eye_texture\": [%d, %d],\n", scenario.EyeTextureSize.w, scenario.EyeTextureSize.h);
+		std::fprintf(file, "      \"draws_per_frame\": %.1f,\n", scenario.DrawsPerFrame);
+
+		// Only the stages that recorded anything.
+		std::fprintf(file, "      \"stages\": {");
+		bool first = true;
+		for (int s = 0; s < ProfileStageCount; s++) {
+			const StageResult& stage = scenario.Stages[s];
+			if (stage.Count == 0) {
+				continue;
+			}
+			std::fprintf(file, "%s\n        \"%s\": { \"count\": %llu, \"mean_us\": %.3f, \"p50_us\": %.3f, \"p95_us\": %.3f, \"p99_us\": %.3f, \"max_us\": %.3f }",
+				first ? "" : ",", Profiler::GetStageName(static_cast<ProfileStage>(s)), stage.Count, stage.Mean, stage.Median, stage.P95, stage.P99, stage.Max);
+			first = false;
+		}
+		std::fprintf(file, "\n      },\n");
+		std::fprintf(file, "      \"memory_bytes\": { \"process_peak\": %llu, \"constants_peak\": %llu, \"render_targets_peak\": %llu }\n",
+			scenario.ProcessMemoryPeak, scenario.ConstantMemoryPeak, scenario.RenderTargetMemoryPeak);
+		std::fprintf(file, "    }%s\n", i + 1 < results.Scenarios.size() ? "," : "");
+	}
+	std::fprintf(file, "  }\n");
+	std::fprintf(file, "}\n");
+	return std::fclose(file) == 0;
+}
+
+bool ReadScenarioResults(const char* path, ScenarioResults& outResults) {
+	outResults.Frames = 0;
+	outResults.WarmupFrames = 0;
+	outResults.TimerOverhead = 0.0;
+	outResults.Scenarios.clear();
+
+	MappedFile file;
+	std::vector<JsonField> fields;
+	if (!file.Open(path) || !JsonReader(reinterpret_cast<const char*>(file.GetData()), file.GetSize()).Read(fields)) {
+		return false;
+	}
+
+	std::map<std::string, size_t> scenarioIndices;
+	for (size_t i = 0; i < fields.size(); i++) {
+		const JsonField& field = fields[i];
+		const std::vector<std::string>& fieldPath = field.Path;
+		if (fieldPath.size() == 1 && !field.IsString) {
+			if (fieldPath[0] == "frames") {
+				outResults.Frames = static_cast<unsigned int>(field.Number);
+			}
+			else if (fieldPath[0] == "warmup_frames") {
+				outResults.WarmupFrames = static_cast<unsigned int>(field.Number);
+			}
+			else if (fieldPath[0] == "timer_overhead_ns") {
+				outResults.TimerOverhead = field.Number;
+			}
+		}
+		else if (fieldPath.size() >= 3 && fieldPath[0] == "scenarios") {
+			std::map<std::string, size_t>::iterator found = scenarioIndices.find(fieldPath[1]);
+			if (found == scenarioIndices.end()) {
+				found = scenarioIndices.insert(std::make_pair(fieldPath[1], outResults.Scenarios.size())).first;
+				outResults.Scenarios.push_back(ScenarioResult());
+				ClearScenarioResult(outResults.Scenarios.back());
+				outResults.Scenarios.back().Name = fieldPath[1];
+			}
+			SetScenarioValue(outResults.Scenarios[found->second], field);
+		}
+	}
+	return true;
+}
+
+void CompareScenarioResults(const ScenarioResults& baseline, const ScenarioResults& current, const RegressionThresholds& thresholds,
+	ScenarioComparison& outComparison) {
+	outComparison.ComparedScenarios = 0;
+	outComparison.ComparedValues = 0;
+	outComparison.Regressions = 0;
+	outComparison.Changes.clear();
+	outComparison.NewScenarios.clear();
+	outComparison.MissingScenarios.clear();
+
+	for (size_t i = 0; i < current.Scenarios.size(); i++) {
+		const ScenarioResult& scenario = current.Scenarios[i];
+		const ScenarioResult* before = FindScenario(baseline, scenario.Name);
+		if (before == nullptr) {
+			outComparison.NewScenarios.push_back(scenario.Name);
+			continue;
+		}
+		outComparison.ComparedScenarios++;
+		for (int s = 0; s < ProfileStageCount; s++) {
+			const StageResult& stage = scenario.Stages[s];
+			const StageResult& stageBefore = before->Stages[s];
+			if (stage.Count == 0 || stageBefore.Count == 0 || (s != ProfileStage_Frame && !thresholds.AllStages)) {
+				continue;
+			}
+			std::string stageName = Profiler::GetStageName(static_cast<ProfileStage>(s));
+			CompareValue(scenario.Name, stageName + " p50", stageBefore.Median, stage.Median, thresholds.Median, thresholds.MinTime, false, outComparison);
+			CompareValue(scenario.Name, stageName + " p99", stageBefore.P99, stage.P99, thresholds.Tail, thresholds.MinTime, false, outComparison);
+		}
+
+		// A peak the baseline didn't have (0) can't be compared, the platform couldn't tell.
+		const unsigned long long peaks[3][2] = {
+			{ before->ProcessMemoryPeak, scenario.ProcessMemoryPeak },
+			{ before->ConstantMemoryPeak, scenario.ConstantMemoryPeak },
+			{ before->RenderTargetMemoryPeak, scenario.RenderTargetMemoryPeak },
+		};
+		const char* peakNames[3] = { "process memory peak", "constant memory peak", "render target memory peak" };
+		for (int p = 0; p < 3; p++) {
+			if (peaks[p][0] > 0 && peaks[p][1] > 0) {
+				CompareValue(scenario.Name, peakNames[p], static_cast<double>(peaks[p][0]), static_cast<double>(peaks[p][1]), thresholds.Memory,
+					p == 0 ? thresholds.MinProcessMemory : 0.0, true, outComparison);
+			}
+		}
+	}
+	for (size_t i = 0; i < baseline.Scenarios.size(); i++) {
+		if (FindScenario(current, baseline.Scenarios[i].Name) == nullptr) {
+			outComparison.MissingScenarios.push_back(baseline.Scenarios[i].Name);
+		}
+	}
+}
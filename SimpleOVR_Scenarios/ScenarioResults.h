@@ -0,0 +1,135 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#pragma once
+
+#include "Profiler.h"
+#include "RenderDevice.h"
+#include <string>
+#include <vector>
+
+/*
+	What SimpleOVR_Scenarios measured, written to and read back from JSON, and the comparison of
+	two runs that decides whether one regressed against the other.
+
+	The file holds one object per scenario, keyed by its name, with its settings, the
+	distribution of each ProfileStage that recorded anything (in microseconds, as in
+	Profiler::WriteJson) and the memory peaks in bytes. Reading only needs what comparing does; a
+	file written by another version of the tool reads as long as it is valid JSON, with whatever
+	it lacks left 0 and whatever it has extra ignored.
+*/
+
+// One ProfileStage over the measured frames, in microseconds.
+struct StageResult {
+	unsigned long long Count;
+	double Mean;
+	double Median;
+	double P95;
+	double P99;
+	double Max;
+};
+
+struct ScenarioResult {
+	std::string Name;
+	unsigned int ObjectCount;
+	float ResolutionScale; // Pixels per display pixel
+	int MultisampleCount;
+	StereoMode Mode;
+	int ThreadCount;
+	Size2i EyeTextureSize;
+	double DrawsPerFrame;
+	StageResult Stages[ProfileStageCount];
+
+	// Peaks over the measured frames, in bytes. Process memory is what was resident, constants
+	// what the ring had in use between frames, render targets what the frame graph's would take
+	// on a GPU.
+	unsigned long long ProcessMemoryPeak;
+	unsigned long long ConstantMemoryPeak;
+	unsigned long long RenderTargetMemoryPeak;
+};
+
+struct ScenarioResults {
+	unsigned int Frames; // Measured per scenario
+	unsigned int WarmupFrames;
+	double TimerOverhead; // Nanoseconds per ScopedProfileTimer
+	std::vector<ScenarioResult> Scenarios;
+};
+
+/*
+	A value regresses when it grew by more than its fraction of the baseline, and times and the
+	process memory also by more than an absolute minimum, which keeps stages of a few
+	microseconds from failing on timer noise and the process from failing on the C runtime's
+	whims. The constant and render target peaks are exact, so any change beyond the fraction
+	counts. Improvements are reported by the same rule the other way around.
+
+	Only the whole frame is compared unless AllStages is set: the stages that run on several
+	threads vary a lot more from run to run than the frame they add up to.
+*/
+struct RegressionThresholds {
+	double Median; // 0.1 is 10% slower
+	double Tail; // 99th percentile
+	double Memory; // Each of the peaks
+	double MinTime; // Microseconds
+	double MinProcessMemory; // Bytes
+	bool AllStages;
+};
+
+struct ScenarioChange {
+	std::string Scenario;
+	std::string Value; // "Frame p50", "process memory peak", ...
+	double Baseline; // Microseconds or bytes
+	double Current;
+	bool Memory;
+	bool Regressed; // Otherwise improved
+};
+
+struct ScenarioComparison {
+	unsigned int ComparedScenarios;
+	unsigned int ComparedValues;
+	unsigned int Regressions;
+	std::vector<ScenarioChange> Changes;
+	std::vector<std::string> NewScenarios; // Not in the baseline
+	std::vector<std::string> MissingScenarios; // Only in the baseline
+};
+
+RegressionThresholds GetDefaultRegressionThresholds();
+
+// "objects=1000 scale=1.00 msaa=4 stereo=instanced threads=4", the key of the scenario's results.
+std::string GetScenarioName(unsigned int objectCount, float resolutionScale, int multisampleCount, StereoMode mode, int threadCount);
+
+// "multipass" or "instanced", as SimpleOVR_Headless' --stereo takes them.
+const char* GetStereoModeName(StereoMode mode);
+bool FindStereoMode(const char* name, StereoMode& outMode);
+
+bool WriteScenarioResults(const char* path, const ScenarioResults& results);
+
+// Returns false if the file can't be read or isn't JSON.
+bool ReadScenarioResults(const char* path, ScenarioResults& outResults);
+
+// Compares the scenarios current and baseline both have.
+void CompareScenarioResults(const ScenarioResults& baseline, const ScenarioResults& current, const RegressionThresholds& thresholds,
+	ScenarioComparison& outComparison);
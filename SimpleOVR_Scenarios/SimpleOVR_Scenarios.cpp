@@ -0,0 +1,387 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+/*
+	Runs the frame loop headlessly, on SimulatedHmd and NullRenderDevice like SimpleOVR_Headless,
+	for every combination of a matrix of scenarios, and measures each: the distribution of every
+	profiled stage's time, the draws and the memory peaks. The results can be written as JSON and
+	compared against those of an earlier run, failing if anything got slower or bigger than the
+	thresholds allow, so a nightly build can keep the results of a known good run as its baseline
+	and fail on frame time regressions.
+
+	Building:
+
+	Visual Studio 2013:
+		Build the SimpleOVR_Scenarios project. It does not need LibOVR.
+
+	Linux (or anything else with a C++11 compiler):
+		g++ -std=c++11 -O2 -pthread -I../SimpleOVR_Common -o SimpleOVR_Scenarios [A-Z]*.cpp ../SimpleOVR_Common/[A-Z]*.cpp
+
+	Usage:
+		SimpleOVR_Scenarios [--objects N,N,...] [--scales S,S,...] [--msaa N,N,...] [--stereo multipass|instanced,...] [--threads N,N,...] [--frames N] [--warmup N] [--repeat N] [--results FILE] [--baseline FILE] [--threshold PERCENT] [--tail-threshold PERCENT] [--memory-threshold PERCENT] [--min-time US] [--min-process-memory KB] [--all-stages]
+
+	The matrix is every combination of the object counts (0, 1000 and 5000 by default), the
+	resolution scales in pixels per display pixel (1 and 1.5), the MSAA levels (1 and 4), the
+	stereo modes (both) and the thread counts (1 and 4). 0 objects is the sample's triangle, more
+	are scattered around the viewer the way SimpleOVR_Headless' --objects does, with 4 materials.
+
+	Each scenario renders --warmup frames (50) that aren't measured, then --frames frames (500)
+	that are. With --repeat N every scenario runs N times and each of its values is the best any
+	of the runs had, which takes out much of the noise of a busy machine.
+
+	--results writes the results as JSON, see ScenarioResults.h. --baseline compares them with
+	the results of an earlier run: the median frame may be --threshold percent slower (10), its
+	99th percentile --tail-threshold percent (25) and each memory peak --memory-threshold percent
+	bigger (10), except that time differences below --min-time microseconds (2) and process
+	memory ones below --min-process-memory KB (1024) never count. --all-stages holds every stage
+	to the time thresholds, not just the frame. Everything beyond the thresholds is listed,
+	improvements too, and the exit code is 1 if anything regressed. Scenarios the baseline lacks
+	are listed and not compared.
+*/
+
+#include "FrameLoop.h"
+#include "NullRenderDevice.h"
+#include "ProcessMemory.h"
+#include "Profiler.h"
+#include "ScenarioResults.h"
+#include "SimulatedHmd.h"
+#include "VrMath.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+
+namespace {
+	const unsigned int DefaultObjectCounts[] = { 0, 1000, 5000 };
+	const float DefaultResolutionScales[] = { 1.0f, 1.5f };
+	const int DefaultMultisampleCounts[] = { 1, 4 };
+	const StereoMode DefaultStereoModes[] = { StereoMode_MultiPass, StereoMode_Instanced };
+	const int DefaultThreadCounts[] = { 1, 4 };
+	const int SceneMaterials = 4;
+
+	// Radius of the area around the viewer the objects fill, as in SimpleOVR_Headless.
+	const float ScatterRadius = 50.0f;
+
+	float NextRandom(unsigned int& state) {
+		state = state * 1664525u + 1013904223u;
+		return (state >> 8) * (1.0f / 16777216.0f);
+	}
+
+	// The same objects SimpleOVR_Headless --objects scatters with the triangle as their mesh.
+	void ScatterObjects(Scene& scene, unsigned int count) {
+		unsigned int state = 12345;
+		unsigned int materialState = 54321;
+		const Vector3 up = { 0.0f, 1.0f, 0.0f };
+		for (unsigned int i = 0; i < count; i++) {
+			int mesh = static_cast<int>(NextRandom(state) * scene.GetMeshCount()) % scene.GetMeshCount();
+			Vector3 position = {
+				(NextRandom(state) * 2.0f - 1.0f) * ScatterRadius,
+				(NextRandom(state) * 2.0f - 1.0f) * ScatterRadius * 0.2f,
+				(NextRandom(state) * 2.0f - 1.0f) * ScatterRadius
+			};
+			Quaternion orientation = QuaternionFromAxisAngle(up, NextRandom(state) * 6.2831853f);
+			unsigned int object = scene.AddObject(mesh, position, orientation, 0.5f + NextRandom(state));
+			scene.SetObjectMaterial(object, static_cast<int>(NextRandom(materialState) * SceneMaterials) % SceneMaterials);
+		}
+	}
+
+	// Comma separated numbers. Returns false, if any of them isn't one.
+	template <typename T>
+	bool ParseList(const char* text, std::vector<T>& outValues) {
+		outValues.clear();
+		while (*text != 0) {
+			char* end = nullptr;
+			double value = std::strtod(text, &end);
+			if (end == text || (*end != ',' && *end != 0)) {
+				return false;
+			}
+			outValues.push_back(static_cast<T>(value));
+			text = *end == ',' ? end + 1 : end;
+		}
+		return !outValues.empty();
+	}
+
+	bool ParseStereoModes(const char* text, std::vector<StereoMode>& outModes) {
+		outModes.clear();
+		std::string list = text;
+		size_t begin = 0;
+		while (begin <= list.size()) {
+			size_t end = std::min(list.find(',', begin), list.size());
+			StereoMode mode;
+			if (!FindStereoMode(list.substr(begin, end - begin).c_str(), mode)) {
+				return false;
+			}
+			outModes.push_back(mode);
+			begin = end + 1;
+		}
+		return true;
+	}
+
+	StageResult GetStageResult(ProfileStage stage) {
+		const LatencyHistogram& histogram = Profiler::GetHistogram(stage);
+		StageResult result;
+		result.Count = histogram.GetCount();
+		result.Mean = histogram.GetMean() / 1000.0;
+		result.Median = histogram.GetPercentile(0.50) / 1000.0;
+		result.P95 = histogram.GetPercentile(0.95) / 1000.0;
+		result.P99 = histogram.GetPercentile(0.99) / 1000.0;
+		result.Max = histogram.GetMax() / 1000.0;
+		return result;
+	}
+
+	// Every value of best that run did better on.
+	void KeepBest(const ScenarioResult& run, ScenarioResult& best) {
+		for (int s = 0; s < ProfileStageCount; s++) {
+			StageResult& stage = best.Stages[s];
+			const StageResult& runStage = run.Stages[s];
+			stage.Mean = std::min(stage.Mean, runStage.Mean);
+			stage.Median = std::min(stage.Median, runStage.Median);
+			stage.P95 = std::min(stage.P95, runStage.P95);
+			stage.P99 = std::min(stage.P99, runStage.P99);
+			stage.Max = std::min(stage.Max, runStage.Max);
+		}
+		best.ProcessMemoryPeak = std::min(best.ProcessMemoryPeak, run.ProcessMemoryPeak);
+		best.ConstantMemoryPeak = std::min(best.ConstantMemoryPeak, run.ConstantMemoryPeak);
+		best.RenderTargetMemoryPeak = std::min(best.RenderTargetMemoryPeak, run.RenderTargetMemoryPeak);
+	}
+
+	// One run of a scenario, everything but the name and settings filled in.
+	void RunScenario(const Scene& scene, float resolutionScale, int multisampleCount, StereoMode mode, JobSystem& jobs, unsigned int warmupFrames,
+		unsigned int frames, ScenarioResult& outResult) {
+		PoseScript script;
+		SimulatedHmd hmd(script);
+		StereoSetup setup = CreateStereoSetup(hmd, resolutionScale);
+		setup.Mode = mode;
+		NullRenderDevice device(setup.RenderTargetSize, multisampleCount);
+		device.SetSceneVertices(&scene.GetVertices()[0], static_cast<unsigned int>(scene.GetVertices().size()));
+
+		for (unsigned int frame = 0; frame < warmupFrames; frame++) {
+			RenderFrame(hmd, device, setup, scene, jobs);
+		}
+		Profiler::Collect();
+		Profiler::Reset();
+		unsigned long long warmupDraws = device.GetStatistics().Draws;
+
+		unsigned long long processPeak = GetProcessMemoryUsage();
+		unsigned int constantPeak = 0;
+		for (unsigned int frame = 0; frame < frames; frame++) {
+			{
+				ScopedProfileTimer timer(ProfileStage_Frame);
+				RenderFrame(hmd, device, setup, scene, jobs);
+			}
+			Profiler::Collect();
+			processPeak = std::max(processPeak, GetProcessMemoryUsage());
+			constantPeak = std::max(constantPeak, device.GetConstantAllocator().GetUsedBytes());
+		}
+
+		outResult.EyeTextureSize = setup.RenderTargetSize;
+		outResult.DrawsPerFrame = frames > 0 ? static_cast<double>(device.GetStatistics().Draws - warmupDraws) / frames : 0.0;
+		for (int s = 0; s < ProfileStageCount; s++) {
+			outResult.Stages[s] = GetStageResult(static_cast<ProfileStage>(s));
+		}
+		RenderTargetPlan targetPlan;
+		device.GetFrameGraph().BuildTargetPlan(targetPlan);
+		outResult.ProcessMemoryPeak = processPeak;
+		outResult.ConstantMemoryPeak = constantPeak;
+		outResult.RenderTargetMemoryPeak = targetPlan.GetStatistics().PeakBytes;
+	}
+}
+
+int main(int argc, char* argv[]) {
+	std::vector<unsigned int> objectCounts(DefaultObjectCounts, DefaultObjectCounts + sizeof(DefaultObjectCounts) / sizeof(DefaultObjectCounts[0]));
+	std::vector<float> resolutionScales(DefaultResolutionScales, DefaultResolutionScales + sizeof(DefaultResolutionScales) / sizeof(DefaultResolutionScales[0]));
+	std::vector<int> multisampleCounts(DefaultMultisampleCounts, DefaultMultisampleCounts + sizeof(DefaultMultisampleCounts) / sizeof(DefaultMultisampleCounts[0]));
+	std::vector<StereoMode> stereoModes(DefaultStereoModes, DefaultStereoModes + sizeof(DefaultStereoModes) / sizeof(DefaultStereoModes[0]));
+	std::vector<int> threadCounts(DefaultThreadCounts, DefaultThreadCounts + sizeof(DefaultThreadCounts) / sizeof(DefaultThreadCounts[0]));
+	unsigned int frames = 500;
+	unsigned int warmupFrames = 50;
+	unsigned int repeat = 1;
+	const char* resultsPath = nullptr;
+	const char* baselinePath = nullptr;
+	RegressionThresholds thresholds = GetDefaultRegressionThresholds();
+
+	bool valid = true;
+	for (int i = 1; i < argc && valid; i++) {
+		if (std::strcmp(argv[i], "--objects") == 0 && i + 1 < argc) {
+			valid = ParseList(argv[++i], objectCounts);
+		}
+		else if (std::strcmp(argv[i], "--scales") == 0 && i + 1 < argc) {
+			valid = ParseList(argv[++i], resolutionScales);
+		}
+		else if (std::strcmp(argv[i], "--msaa") == 0 && i + 1 < argc) {
+			valid = ParseList(argv[++i], multisampleCounts);
+		}
+		else if (std::strcmp(argv[i], "--stereo") == 0 && i + 1 < argc) {
+			valid = ParseStereoModes(argv[++i], stereoModes);
+		}
+		else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+			valid = ParseList(argv[++i], threadCounts);
+		}
+		else if (std::strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+			frames = std::max(1u, static_cast<unsigned int>(std::strtoul(argv[++i], nullptr, 10)));
+		}
+		else if (std::strcmp(argv[i], "--warmup") == 0 && i + 1 < argc) {
+			warmupFrames = static_cast<unsigned int>(std::strtoul(argv[++i], nullptr, 10));
+		}
+		else if (std::strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+			repeat = std::max(1u, static_cast<unsigned int>(std::strtoul(argv[++i], nullptr, 10)));
+		}
+		else if (std::strcmp(argv[i], "--results") == 0 && i + 1 < argc) {
+			resultsPath = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "--baseline") == 0 && i + 1 < argc) {
+			baselinePath = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "--threshold") == 0 && i + 1 < argc) {
+			thresholds.Median = std::atof(argv[++i]) / 100.0;
+		}
+		else if (std::strcmp(argv[i], "--tail-threshold") == 0 && i + 1 < argc) {
+			thresholds.Tail = std::atof(argv[++i]) / 100.0;
+		}
+		else if (std::strcmp(argv[i], "--memory-threshold") == 0 && i + 1 < argc) {
+			thresholds.Memory = std::atof(argv[++i]) / 100.0;
+		}
+		else if (std::strcmp(argv[i], "--min-time") == 0 && i + 1 < argc) {
+			thresholds.MinTime = std::atof(argv[++i]);
+		}
+		else if (std::strcmp(argv[i], "--min-process-memory") == 0 && i + 1 < argc) {
+			thresholds.MinProcessMemory = std::atof(argv[++i]) * 1024.0;
+		}
+		else if (std::strcmp(argv[i], "--all-stages") == 0) {
+			thresholds.AllStages = true;
+		}
+		else {
+			valid = false;
+		}
+	}
+	for (size_t i = 0; i < multisampleCounts.size(); i++) {
+		valid = valid && multisampleCounts[i] >= 1;
+	}
+	for (size_t i = 0; i < threadCounts.size(); i++) {
+		valid = valid && threadCounts[i] >= 1;
+	}
+	for (size_t i = 0; i < resolutionScales.size(); i++) {
+		valid = valid && resolutionScales[i] > 0.0f;
+	}
+	if (!valid) {
+		std::fprintf(stderr, "Usage: %s [--objects N,N,...] [--scales S,S,...] [--msaa N,N,...] [--stereo multipass|instanced,...] [--threads N,N,...] [--frames N] [--warmup N] [--repeat N] [--results FILE] [--baseline FILE] [--threshold PERCENT] [--tail-threshold PERCENT] [--memory-threshold PERCENT] [--min-time US] [--min-process-memory KB] [--all-stages]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	// Read first, so a missing baseline fails before the scenarios take their time.
+	ScenarioResults baseline;
+	if (baselinePath != nullptr && !ReadScenarioResults(baselinePath, baseline)) {
+		std::fprintf(stderr, "Failed reading %s\n", baselinePath);
+		return EXIT_FAILURE;
+	}
+
+	ScenarioResults results;
+	results.Frames = frames;
+	results.WarmupFrames = warmupFrames;
+	results.TimerOverhead = Profiler::MeasureTimerOverhead(100000);
+
+	// The scenes are shared by the scenarios using them.
+	std::vector<std::unique_ptr<Scene>> scenes;
+	for (size_t i = 0; i < objectCounts.size(); i++) {
+		scenes.push_back(std::unique_ptr<Scene>(new Scene()));
+		AddDefaultSceneContent(*scenes.back());
+		ScatterObjects(*scenes.back(), objectCounts[i]);
+	}
+
+	std::printf("%u frames per scenario after %u warmup frames, best of %u\n\n", frames, warmupFrames, repeat);
+	std::printf("%-58s %9s %9s %9s %9s %9s %10s %10s %10s\n", "Scenario", "Draws", "Mean us", "p50 us", "p99 us", "Max us", "Process KB",
+		"Consts KB", "Targets KB");
+	for (size_t o = 0; o < objectCounts.size(); o++) {
+		for (size_t r = 0; r < resolutionScales.size(); r++) {
+			for (size_t m = 0; m < multisampleCounts.size(); m++) {
+				for (size_t s = 0; s < stereoModes.size(); s++) {
+					for (size_t t = 0; t < threadCounts.size(); t++) {
+						ScenarioResult result;
+						result.Name = GetScenarioName(objectCounts[o], resolutionScales[r], multisampleCounts[m], stereoModes[s], threadCounts[t]);
+						result.ObjectCount = objectCounts[o];
+						result.ResolutionScale = resolutionScales[r];
+						result.MultisampleCount = multisampleCounts[m];
+						result.Mode = stereoModes[s];
+						result.ThreadCount = threadCounts[t];
+						JobSystem jobs(threadCounts[t]);
+						for (unsigned int run = 0; run < repeat; run++) {
+							ScenarioResult attempt = result;
+							RunScenario(*scenes[o], resolutionScales[r], multisampleCounts[m], stereoModes[s], jobs, warmupFrames, frames, attempt);
+							if (run == 0) {
+								result = attempt;
+							}
+							else {
+								KeepBest(attempt, result);
+							}
+						}
+						const StageResult& frame = result.Stages[ProfileStage_Frame];
+						std::printf("%-58s %9.1f %9.2f %9.2f %9.2f %9.2f %10llu %10llu %10llu\n", result.Name.c_str(), result.DrawsPerFrame, frame.Mean,
+							frame.Median, frame.P99, frame.Max, result.ProcessMemoryPeak / 1024, result.ConstantMemoryPeak / 1024,
+							result.RenderTargetMemoryPeak / 1024);
+						results.Scenarios.push_back(result);
+					}
+				}
+			}
+		}
+	}
+	if (Profiler::GetDroppedSampleCount() > 0) {
+		std::printf("\n%llu profiler samples dropped\n", Profiler::GetDroppedSampleCount());
+	}
+
+	if (resultsPath != nullptr) {
+		if (!WriteScenarioResults(resultsPath, results)) {
+			std::fprintf(stderr, "Failed writing %s\n", resultsPath);
+			return EXIT_FAILURE;
+		}
+		std::printf("\nResults written to %s\n", resultsPath);
+	}
+	if (baselinePath == nullptr) {
+		return EXIT_SUCCESS;
+	}
+
+	ScenarioComparison comparison;
+	CompareScenarioResults(baseline, results, thresholds, comparison);
+	std::printf("\nCompared with %s: %u scenarios, %u values, %u regressed, %u improved\n", baselinePath, comparison.ComparedScenarios,
+		comparison.ComparedValues, comparison.Regressions, static_cast<unsigned int>(comparison.Changes.size()) - comparison.Regressions);
+	for (size_t i = 0; i < comparison.Changes.size(); i++) {
+		const ScenarioChange& change = comparison.Changes[i];
+		double scale = change.Memory ? 1.0 / 1024.0 : 1.0;
+		std::printf("  %-9s %s, %s: %.2f -> %.2f %s (%+.1f%%)\n", change.Regressed ? "REGRESSED" : "improved", change.Scenario.c_str(),
+			change.Value.c_str(), change.Baseline * scale, change.Current * scale, change.Memory ? "KB" : "us",
+			change.Baseline > 0.0 ? (change.Current / change.Baseline - 1.0) * 100.0 : 0.0);
+	}
+	for (size_t i = 0; i < comparison.NewScenarios.size(); i++) {
+		std::printf("  Not in the baseline: %s\n", comparison.NewScenarios[i].c_str());
+	}
+	if (!comparison.MissingScenarios.empty()) {
+		// Usually the matrix was narrowed down on purpose.
+		std::printf("  %u scenarios of the baseline not run\n", static_cast<unsigned int>(comparison.MissingScenarios.size()));
+	}
+
+	return comparison.Regressions > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}